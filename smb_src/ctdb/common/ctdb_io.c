@@ -25,16 +25,24 @@
 #include "lib/util/dlinklist.h"
 #include "system/network.h"
 #include "system/filesys.h"
+#include "system/select.h"
 #include "../include/ctdb_private.h"
 #include "../include/ctdb_client.h"
 #include <stdarg.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #define QUEUE_BUFFER_SIZE	(16*1024)
 
+/* maximum number of queued packets written with one writev */
+#define QUEUE_IOV_MAX		64
+
 /* structures for packet queueing - see common/ctdb_io.c */
 struct ctdb_buffer {
 	uint8_t *data;
-	uint32_t length;
+	uint32_t offset; /* start of unprocessed data */
+	uint32_t length; /* unprocessed data from offset on */
 	uint32_t size;
 	uint32_t extend;
 };
@@ -47,6 +55,8 @@ struct ctdb_queue_pkt {
 	uint8_t buf[];
 };
 
+struct ctdb_queue_thread;
+
 struct ctdb_queue {
 	struct ctdb_context *ctdb;
 	struct tevent_immediate *im;
@@ -60,12 +70,353 @@ struct ctdb_queue {
 	ctdb_queue_cb_fn_t callback;
 	bool *destroyed;
 	const char *name;
+	bool threaded; /* start a writer thread when an fd is set */
+	struct ctdb_queue_thread *thread;
 };
 
+static void queue_dead(struct event_context *ev, struct tevent_immediate *im,
+		       void *private_data);
+
+#ifdef HAVE_PTHREAD
+
+/*
+ * With ctdbd --transport-threads, a thread of its own writes the packets
+ * of a queue. The main loop hands them over through a singly linked list
+ * with exactly one producer (the main thread, appending at tail) and one
+ * consumer (the writer thread, removing behind head), so no locks are
+ * needed. Whatever piles up while the writer is busy goes out with one
+ * writev.
+ *
+ * The writer thread must not touch talloc memory or log: Packets are
+ * malloc'ed and a write error is only reported to the main loop through
+ * dead_fds.
+ */
+
+struct ctdb_queue_tpkt {
+	struct ctdb_queue_tpkt *next;
+	uint32_t length;
+	uint8_t buf[];
+};
+
+struct ctdb_queue_thread {
+	struct ctdb_queue *queue;
+	pthread_t id;
+	pid_t pid; /* process that runs the thread */
+	bool started;
+	int fd;
+	int wakeup_fds[2];
+	int dead_fds[2];
+	struct tevent_fd *dead_fde;
+
+	struct ctdb_queue_tpkt *tail; /* main thread only */
+	uint32_t num_queued;	      /* main thread only */
+
+	/*
+	 * head has been written already, head->next is the next packet
+	 * to write, offset bytes of which are gone. Writer thread only.
+	 */
+	struct ctdb_queue_tpkt *head;
+	uint32_t offset;
+
+	uint32_t num_sent;
+	int sleeping;
+	int stop;
+	int error;
+};
+
+static void queue_thread_wait(struct ctdb_queue_thread *t, bool for_write)
+{
+	struct pollfd pfd[2];
+	char buf[16];
+
+	pfd[0].fd = t->wakeup_fds[0];
+	pfd[0].events = POLLIN;
+	pfd[0].revents = 0;
+	pfd[1].fd = t->fd;
+	pfd[1].events = POLLOUT;
+	pfd[1].revents = 0;
+
+	poll(pfd, for_write ? 2 : 1, -1);
+
+	if (pfd[0].revents & POLLIN) {
+		while (read(t->wakeup_fds[0], buf, sizeof(buf)) > 0) {
+			;
+		}
+	}
+}
+
+static void queue_thread_advance(struct ctdb_queue_thread *t, size_t n)
+{
+	while (n > 0) {
+		struct ctdb_queue_tpkt *pkt = t->head->next;
+		size_t left = pkt->length - t->offset;
+
+		if (n < left) {
+			t->offset += n;
+			return;
+		}
+		n -= left;
+
+		free(t->head);
+		t->head = pkt;
+		t->offset = 0;
+		__atomic_add_fetch(&t->num_sent, 1, __ATOMIC_RELAXED);
+	}
+}
+
+static void *queue_thread_fn(void *private_data)
+{
+	struct ctdb_queue_thread *t = private_data;
+
+	while (__atomic_load_n(&t->stop, __ATOMIC_SEQ_CST) == 0) {
+		struct iovec iov[QUEUE_IOV_MAX];
+		struct ctdb_queue_tpkt *pkt;
+		uint32_t offset = t->offset;
+		int niov = 0;
+		ssize_t n;
+
+		pkt = __atomic_load_n(&t->head->next, __ATOMIC_SEQ_CST);
+
+		while ((pkt != NULL) && (niov < QUEUE_IOV_MAX)) {
+			iov[niov].iov_base = pkt->buf + offset;
+			iov[niov].iov_len = pkt->length - offset;
+			niov += 1;
+			offset = 0;
+			pkt = __atomic_load_n(&pkt->next, __ATOMIC_ACQUIRE);
+		}
+
+		if (niov == 0) {
+			/*
+			 * Announce that we're going to sleep before the
+			 * final look at the list, queue_thread_send
+			 * appends before it looks at "sleeping".
+			 */
+			__atomic_store_n(&t->sleeping, 1, __ATOMIC_SEQ_CST);
+			if (__atomic_load_n(&t->head->next,
+					    __ATOMIC_SEQ_CST) == NULL) {
+				queue_thread_wait(t, false);
+			}
+			__atomic_store_n(&t->sleeping, 0, __ATOMIC_SEQ_CST);
+			continue;
+		}
+
+		n = writev(t->fd, iov, niov);
+		if (n == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				queue_thread_wait(t, true);
+				continue;
+			}
+			t->error = errno;
+			sys_write(t->dead_fds[1], "", 1);
+			break;
+		}
+
+		queue_thread_advance(t, n);
+	}
+
+	return NULL;
+}
+
+static int queue_thread_destructor(struct ctdb_queue_thread *t)
+{
+	struct ctdb_queue_tpkt *pkt, *next;
+
+	/*
+	 * A forked child has a copy of the queue, but not the thread
+	 */
+	if (t->started && (t->pid == getpid())) {
+		__atomic_store_n(&t->stop, 1, __ATOMIC_SEQ_CST);
+		sys_write(t->wakeup_fds[1], "", 1);
+		pthread_join(t->id, NULL);
+	}
+
+	for (pkt = t->head; pkt != NULL; pkt = next) {
+		next = pkt->next;
+		free(pkt);
+	}
+	t->head = t->tail = NULL;
+
+	TALLOC_FREE(t->dead_fde);
+
+	if (t->wakeup_fds[0] != -1) {
+		close(t->wakeup_fds[0]);
+		close(t->wakeup_fds[1]);
+	}
+	if (t->dead_fds[0] != -1) {
+		close(t->dead_fds[0]);
+		close(t->dead_fds[1]);
+	}
+	return 0;
+}
+
+static int queue_thread_send(struct ctdb_queue_thread *t,
+			     uint8_t *data, uint32_t length)
+{
+	struct ctdb_queue_tpkt *pkt;
+
+	pkt = malloc(offsetof(struct ctdb_queue_tpkt, buf) + length);
+	CTDB_NO_MEMORY(t->queue->ctdb, pkt);
+
+	pkt->next = NULL;
+	pkt->length = length;
+	memcpy(pkt->buf, data, length);
+
+	__atomic_store_n(&t->tail->next, pkt, __ATOMIC_SEQ_CST);
+	t->tail = pkt;
+	t->num_queued += 1;
+
+	if (__atomic_exchange_n(&t->sleeping, 0, __ATOMIC_SEQ_CST) != 0) {
+		sys_write(t->wakeup_fds[1], "", 1);
+	}
+	return 0;
+}
+
+static uint32_t queue_thread_length(struct ctdb_queue_thread *t)
+{
+	return t->num_queued - __atomic_load_n(&t->num_sent, __ATOMIC_RELAXED);
+}
+
+/*
+  stop the writer thread, packets it has not started on are queued
+  again for the next fd
+*/
+static void queue_thread_stop(struct ctdb_queue *queue)
+{
+	struct ctdb_queue_thread *t = queue->thread;
+	struct ctdb_queue_tpkt *pkt;
+	int fd = queue->fd;
+
+	queue->thread = NULL;
+
+	__atomic_store_n(&t->stop, 1, __ATOMIC_SEQ_CST);
+	sys_write(t->wakeup_fds[1], "", 1);
+	pthread_join(t->id, NULL);
+	t->started = false;
+
+	pkt = t->head->next;
+	if ((pkt != NULL) && (t->offset != 0)) {
+		/* partial packet sent - we have to drop it */
+		pkt = pkt->next;
+	}
+
+	queue->fd = -1;
+	for (; pkt != NULL; pkt = pkt->next) {
+		ctdb_queue_send(queue, pkt->buf, pkt->length);
+	}
+	queue->fd = fd;
+
+	TALLOC_FREE(t);
+}
+
+/*
+  called in the main loop when the writer thread failed
+*/
+static void queue_thread_dead(struct tevent_context *ev,
+			      struct tevent_fd *fde,
+			      uint16_t flags, void *private_data)
+{
+	struct ctdb_queue *queue = talloc_get_type_abort(
+		private_data, struct ctdb_queue);
+
+	DEBUG(DEBUG_NOTICE, ("%s: write failed: %s\n", queue->name,
+			     strerror(queue->thread->error)));
+
+	queue_thread_stop(queue);
+
+	talloc_free(queue->fde);
+	queue->fde = NULL;
+	queue->fd = -1;
+	tevent_schedule_immediate(queue->im, queue->ctdb->ev,
+				  queue_dead, queue);
+}
+
+/*
+  start the writer thread for the queue's current fd and hand over what
+  has been queued so far
+*/
+static void queue_thread_start(struct ctdb_queue *queue)
+{
+	struct ctdb_queue_thread *t;
+	int ret;
+
+	t = talloc_zero(queue, struct ctdb_queue_thread);
+	if (t == NULL) {
+		DEBUG(DEBUG_ERR, (__location__ " out of memory\n"));
+		return;
+	}
+	t->queue = queue;
+	t->fd = queue->fd;
+	t->pid = getpid();
+	t->wakeup_fds[0] = t->wakeup_fds[1] = -1;
+	t->dead_fds[0] = t->dead_fds[1] = -1;
+	talloc_set_destructor(t, queue_thread_destructor);
+
+	t->head = calloc(1, sizeof(struct ctdb_queue_tpkt));
+	if (t->head == NULL) {
+		DEBUG(DEBUG_ERR, (__location__ " out of memory\n"));
+		goto fail;
+	}
+	t->tail = t->head;
+
+	if ((pipe(t->wakeup_fds) != 0) || (pipe(t->dead_fds) != 0)) {
+		DEBUG(DEBUG_ERR, ("%s: pipe failed: %s\n", queue->name,
+				  strerror(errno)));
+		goto fail;
+	}
+	set_nonblocking(t->wakeup_fds[0]);
+	set_nonblocking(t->wakeup_fds[1]);
+	set_close_on_exec(t->wakeup_fds[0]);
+	set_close_on_exec(t->wakeup_fds[1]);
+	set_close_on_exec(t->dead_fds[0]);
+	set_close_on_exec(t->dead_fds[1]);
+
+	t->dead_fde = tevent_add_fd(queue->ctdb->ev, t, t->dead_fds[0],
+				    TEVENT_FD_READ, queue_thread_dead, queue);
+	if (t->dead_fde == NULL) {
+		DEBUG(DEBUG_ERR, (__location__ " out of memory\n"));
+		goto fail;
+	}
+
+	ret = pthread_create(&t->id, NULL, queue_thread_fn, t);
+	if (ret != 0) {
+		DEBUG(DEBUG_ERR, ("%s: pthread_create failed: %s\n",
+				  queue->name, strerror(ret)));
+		goto fail;
+	}
+	t->started = true;
+	queue->thread = t;
+
+	while (queue->out_queue != NULL) {
+		struct ctdb_queue_pkt *pkt = queue->out_queue;
+
+		if (pkt->length == pkt->full_length) {
+			queue_thread_send(t, pkt->data, pkt->length);
+		}
+		DLIST_REMOVE(queue->out_queue, pkt);
+		queue->out_queue_length--;
+		talloc_free(pkt);
+	}
+	return;
+
+fail:
+	DEBUG(DEBUG_WARNING, ("%s: writing from the main loop\n",
+			      queue->name));
+	TALLOC_FREE(t);
+}
 
+#endif /* HAVE_PTHREAD */
 
 int ctdb_queue_length(struct ctdb_queue *queue)
 {
+#ifdef HAVE_PTHREAD
+	if (queue->thread != NULL) {
+		return queue->out_queue_length +
+			queue_thread_length(queue->thread);
+	}
+#endif
 	return queue->out_queue_length;
 }
 
@@ -95,7 +446,7 @@ static void queue_process(struct ctdb_queue *queue)
 		return;
 	}
 
-	pkt_size = *(uint32_t *)queue->buffer.data;
+	pkt_size = *(uint32_t *)(queue->buffer.data + queue->buffer.offset);
 	if (pkt_size == 0) {
 		DEBUG(DEBUG_CRIT, ("Invalid packet of length 0\n"));
 		goto failed;
@@ -114,14 +465,13 @@ static void queue_process(struct ctdb_queue *queue)
 		DEBUG(DEBUG_ERR, ("read error alloc failed for %u\n", pkt_size));
 		return;
 	}
-	memcpy(data, queue->buffer.data, pkt_size);
+	memcpy(data, queue->buffer.data + queue->buffer.offset, pkt_size);
 
-	/* Shift packet out from buffer */
-	if (queue->buffer.length > pkt_size) {
-		memmove(queue->buffer.data,
-			queue->buffer.data + pkt_size,
-			queue->buffer.length - pkt_size);
-	}
+	/*
+	 * Skip the packet, the remaining data is moved to the front of
+	 * the buffer only before the next read
+	 */
+	queue->buffer.offset += pkt_size;
 	queue->buffer.length -= pkt_size;
 
 	if (queue->buffer.length > 0) {
@@ -129,6 +479,7 @@ static void queue_process(struct ctdb_queue *queue)
 		tevent_schedule_immediate(queue->im, queue->ctdb->ev,
 					  queue_process_event, queue);
 	} else {
+		queue->buffer.offset = 0;
 		if (queue->buffer.size > QUEUE_BUFFER_SIZE) {
 			TALLOC_FREE(queue->buffer.data);
 			queue->buffer.size = 0;
@@ -170,6 +521,13 @@ static void queue_io_read(struct ctdb_queue *queue)
 		goto failed;
 	}
 
+	if (queue->buffer.offset > 0) {
+		memmove(queue->buffer.data,
+			queue->buffer.data + queue->buffer.offset,
+			queue->buffer.length);
+		queue->buffer.offset = 0;
+	}
+
 	if (queue->buffer.data == NULL) {
 		/* starting fresh, allocate buf to read data */
 		queue->buffer.data = talloc_size(queue, QUEUE_BUFFER_SIZE);
@@ -234,7 +592,19 @@ static void queue_io_write(struct ctdb_queue *queue)
 		if (queue->ctdb->flags & CTDB_FLAG_TORTURE) {
 			n = write(queue->fd, pkt->data, 1);
 		} else {
-			n = write(queue->fd, pkt->data, pkt->length);
+			struct iovec iov[QUEUE_IOV_MAX];
+			int niov = 0;
+
+			/* send as many queued packets as we can in one go */
+			for (; (pkt != NULL) && (niov < QUEUE_IOV_MAX);
+			     pkt = pkt->next) {
+				iov[niov].iov_base = pkt->data;
+				iov[niov].iov_len = pkt->length;
+				niov += 1;
+			}
+			pkt = queue->out_queue;
+
+			n = writev(queue->fd, iov, niov);
 		}
 
 		if (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
@@ -252,16 +622,21 @@ static void queue_io_write(struct ctdb_queue *queue)
 			return;
 		}
 		if (n <= 0) return;
-		
-		if (n != pkt->length) {
-			pkt->length -= n;
-			pkt->data += n;
-			return;
-		}
 
-		DLIST_REMOVE(queue->out_queue, pkt);
-		queue->out_queue_length--;
-		talloc_free(pkt);
+		while (n > 0) {
+			pkt = queue->out_queue;
+
+			if (n < pkt->length) {
+				pkt->length -= n;
+				pkt->data += n;
+				return;
+			}
+			n -= pkt->length;
+
+			DLIST_REMOVE(queue->out_queue, pkt);
+			queue->out_queue_length--;
+			talloc_free(pkt);
+		}
 	}
 
 	EVENT_FD_NOT_WRITEABLE(queue->fde);
@@ -305,7 +680,13 @@ int ctdb_queue_send(struct ctdb_queue *queue, uint8_t *data, uint32_t length)
 	}
 
 	full_length = length2;
-	
+
+#ifdef HAVE_PTHREAD
+	if (queue->thread != NULL) {
+		return queue_thread_send(queue->thread, data, length2);
+	}
+#endif
+
 	/* if the queue is empty then try an immediate write, avoiding
 	   queue overhead. This relies on non-blocking sockets */
 	if (queue->out_queue == NULL && queue->fd != -1 &&
@@ -378,6 +759,13 @@ int ctdb_queue_send(struct ctdb_queue *queue, uint8_t *data, uint32_t length)
  */
 int ctdb_queue_set_fd(struct ctdb_queue *queue, int fd)
 {
+#ifdef HAVE_PTHREAD
+	/* the writer thread must be gone before the old fd is closed */
+	if (queue->thread != NULL) {
+		queue_thread_stop(queue);
+	}
+#endif
+
 	queue->fd = fd;
 	talloc_free(queue->fde);
 	queue->fde = NULL;
@@ -390,6 +778,13 @@ int ctdb_queue_set_fd(struct ctdb_queue *queue, int fd)
 		}
 		tevent_fd_set_auto_close(queue->fde);
 
+#ifdef HAVE_PTHREAD
+		if (queue->threaded &&
+		    !(queue->ctdb->flags & CTDB_FLAG_TORTURE)) {
+			queue_thread_start(queue);
+		}
+#endif
+
 		if (queue->out_queue) {
 			EVENT_FD_WRITEABLE(queue->fde);		
 		}
@@ -401,6 +796,8 @@ int ctdb_queue_set_fd(struct ctdb_queue *queue, int fd)
 /* If someone sets up this pointer, they want to know if the queue is freed */
 static int queue_destructor(struct ctdb_queue *queue)
 {
+	/* stop the writer thread before the fde closes the fd */
+	TALLOC_FREE(queue->thread);
 	TALLOC_FREE(queue->buffer.data);
 	queue->buffer.length = 0;
 	queue->buffer.size = 0;
@@ -409,6 +806,21 @@ static int queue_destructor(struct ctdb_queue *queue)
 	return 0;
 }
 
+/*
+  have the packets of the queue written by a separate thread, takes
+  effect with the next ctdb_queue_set_fd
+ */
+int ctdb_queue_set_threaded(struct ctdb_queue *queue)
+{
+#ifdef HAVE_PTHREAD
+	queue->threaded = true;
+	return 0;
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
 /*
   setup a packet queue on a socket
  */
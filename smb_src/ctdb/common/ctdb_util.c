@@ -297,6 +297,41 @@ TDB_DATA ctdb_marshall_finish(struct ctdb_marshall_buffer *m)
 	return data;
 }
 
+/*
+  check that a marshall buffer received from another node is complete,
+  so that it can be walked with ctdb_marshall_loop_next
+ */
+bool ctdb_marshall_buf_valid(TDB_DATA data)
+{
+	struct ctdb_marshall_buffer *m;
+	struct ctdb_rec_data *r;
+	size_t ofs;
+	uint32_t i;
+
+	if (data.dsize < offsetof(struct ctdb_marshall_buffer, data)) {
+		return false;
+	}
+	m = (struct ctdb_marshall_buffer *)data.dptr;
+
+	ofs = offsetof(struct ctdb_marshall_buffer, data);
+	for (i=0; i<m->count; i++) {
+		if (data.dsize - ofs < offsetof(struct ctdb_rec_data, data)) {
+			return false;
+		}
+		r = (struct ctdb_rec_data *)(data.dptr + ofs);
+		if (r->length > data.dsize - ofs) {
+			return false;
+		}
+		if (r->length < offsetof(struct ctdb_rec_data, data) +
+				(size_t)r->keylen + (size_t)r->datalen) {
+			return false;
+		}
+		ofs += r->length;
+	}
+
+	return true;
+}
+
 /* 
    loop over a marshalling buffer 
    
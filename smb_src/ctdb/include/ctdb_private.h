@@ -128,6 +128,12 @@ struct ctdb_tunable {
 	uint32_t samba3_hack;
 	uint32_t mutex_enabled;
 	uint32_t lock_processes_per_db;
+	uint32_t repack_incremental;
+	uint32_t rec_buffer_size_limit;
+	uint32_t parallel_recovery_dbs;
+	uint32_t hot_record_interval;
+	uint32_t hot_record_migrations;
+	uint32_t hot_record_ro_requests;
 };
 
 /*
@@ -521,6 +527,7 @@ struct ctdb_context {
 	int start_as_disabled;
 	int start_as_stopped;
 	bool valgrinding;
+	bool transport_threads; /* node queues are written by threads */
 	uint32_t event_script_timeouts; /* counting how many consecutive times an eventscript has timedout */
 	uint32_t *recd_ping_count;
 	TALLOC_CTX *recd_ctx; /* a context used to track recoverd monitoring events */
@@ -601,6 +608,23 @@ struct ctdb_db_context {
 	struct lock_context *lock_current;
 	struct lock_context *lock_pending;
 	int lock_num_current;
+
+	/* streaming push in progress during recovery */
+	struct db_push_state *push_state;
+
+	/* freeze of this database only, used by parallel recovery */
+	enum ctdb_freeze_mode freeze_mode;
+	struct ctdb_db_freeze_handle *freeze_handle;
+	bool freeze_transaction_started;
+	uint32_t freeze_transaction_id;
+	/* thawed by parallel recovery while the recovery is still active */
+	bool recovered;
+
+	/* observation window of the adaptive hot record policy */
+	struct timeval hot_window_start;
+	struct ctdb_hot_record_slot *hot_window_slots;
+	uint32_t hot_window_migrations;
+	uint32_t hot_window_ro_wanted;
 };
 
 
@@ -791,6 +815,11 @@ int ctdb_queue_send(struct ctdb_queue *queue, uint8_t *data, uint32_t length);
  */
 int ctdb_queue_set_fd(struct ctdb_queue *queue, int fd);
 
+/*
+  write the packets of a queue from a separate thread
+ */
+int ctdb_queue_set_threaded(struct ctdb_queue *queue);
+
 /*
   setup a packet queue on a socket
  */
@@ -955,6 +984,14 @@ struct ctdb_control_pulldb {
 	uint32_t lmaster;
 };
 
+/* structure used for the streaming db_pull and db_push_start controls,
+   the records are sent as messages to srvid */
+struct ctdb_control_pulldb_ext {
+	uint32_t db_id;
+	uint32_t lmaster;
+	uint64_t srvid;
+};
+
 /* structure used for sending lists of records */
 struct ctdb_marshall_buffer {
 	uint32_t db_id;
@@ -1005,6 +1042,11 @@ struct ctdb_control_wipe_database {
 	uint32_t transaction_id;
 };
 
+struct ctdb_control_transdb {
+	uint32_t db_id;
+	uint32_t transaction_id;
+};
+
 /*
   state of a in-progress ctdb call in client
 */
@@ -1052,9 +1094,17 @@ struct ctdb_rec_data *ctdb_marshall_loop_next(struct ctdb_marshall_buffer *m, st
 					      uint32_t *reqid,
 					      struct ctdb_ltdb_header *header,
 					      TDB_DATA *key, TDB_DATA *data);
+bool ctdb_marshall_buf_valid(TDB_DATA data);
 
 int32_t ctdb_control_pull_db(struct ctdb_context *ctdb, TDB_DATA indata, TDB_DATA *outdata);
 int32_t ctdb_control_push_db(struct ctdb_context *ctdb, TDB_DATA indata);
+int32_t ctdb_control_db_pull(struct ctdb_context *ctdb,
+			     struct ctdb_req_control *c,
+			     TDB_DATA indata, TDB_DATA *outdata);
+int32_t ctdb_control_db_push_start(struct ctdb_context *ctdb,
+				   TDB_DATA indata);
+int32_t ctdb_control_db_push_confirm(struct ctdb_context *ctdb,
+				     TDB_DATA indata, TDB_DATA *outdata);
 
 int32_t ctdb_control_set_recmode(struct ctdb_context *ctdb, 
 				 struct ctdb_req_control *c,
@@ -1066,6 +1116,11 @@ void ctdb_request_control_reply(struct ctdb_context *ctdb, struct ctdb_req_contr
 int32_t ctdb_control_freeze(struct ctdb_context *ctdb, struct ctdb_req_control *c, bool *async_reply);
 int32_t ctdb_control_thaw(struct ctdb_context *ctdb, uint32_t priority,
 			  bool check_recmode);
+int32_t ctdb_control_db_freeze(struct ctdb_context *ctdb,
+			       struct ctdb_req_control *c,
+			       uint32_t db_id, bool *async_reply);
+int32_t ctdb_control_db_thaw(struct ctdb_context *ctdb, uint32_t db_id);
+bool ctdb_db_frozen(struct ctdb_db_context *ctdb_db);
 
 int ctdb_start_recoverd(struct ctdb_context *ctdb);
 void ctdb_stop_recoverd(struct ctdb_context *ctdb);
@@ -1359,6 +1414,12 @@ void ctdb_persistent_finish_trans3_commits(struct ctdb_context *ctdb);
 int32_t ctdb_control_transaction_start(struct ctdb_context *ctdb, uint32_t id);
 int32_t ctdb_control_transaction_commit(struct ctdb_context *ctdb, uint32_t id);
 int32_t ctdb_control_transaction_cancel(struct ctdb_context *ctdb);
+int32_t ctdb_control_db_transaction_start(struct ctdb_context *ctdb,
+					  TDB_DATA indata);
+int32_t ctdb_control_db_transaction_commit(struct ctdb_context *ctdb,
+					   TDB_DATA indata);
+int32_t ctdb_control_db_transaction_cancel(struct ctdb_context *ctdb,
+					   uint32_t db_id);
 int32_t ctdb_control_wipe_database(struct ctdb_context *ctdb, TDB_DATA indata);
 int32_t ctdb_control_db_set_healthy(struct ctdb_context *ctdb, TDB_DATA indata);
 int32_t ctdb_control_db_get_health(struct ctdb_context *ctdb,
@@ -1553,6 +1614,8 @@ int32_t ctdb_control_get_db_statistics(struct ctdb_context *ctdb,
 
 int ctdb_set_db_sticky(struct ctdb_context *ctdb, struct ctdb_db_context *ctdb_db);
 
+void ctdb_hot_record_ro_wanted(struct ctdb_db_context *ctdb_db);
+
 /*
   description for a message to reload all ips via recovery master/daemon
  */
@@ -1570,6 +1633,8 @@ struct lock_request;
 
 int ctdb_lockall_mark_prio(struct ctdb_context *ctdb, uint32_t priority);
 int ctdb_lockall_unmark_prio(struct ctdb_context *ctdb, uint32_t priority);
+int ctdb_lockdb_mark(struct ctdb_db_context *ctdb_db);
+int ctdb_lockdb_unmark(struct ctdb_db_context *ctdb_db);
 
 struct lock_request *ctdb_lock_record(TALLOC_CTX *mem_ctx,
 				      struct ctdb_db_context *ctdb_db,
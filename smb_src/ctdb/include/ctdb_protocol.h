@@ -198,6 +198,11 @@ struct ctdb_call_info {
 /* Range of ports reserved for traversals */
 #define CTDB_SRVID_TRAVERSE_RANGE  0xBE00000000000000LL
 
+/* Range of ports reserved for streaming database contents during
+ * recovery (DB_PULL, DB_PUSH_START)
+ */
+#define CTDB_SRVID_RECOVERY_RANGE  0xAE00000000000000LL
+
 /* used on the domain socket, send a pdu to the local daemon */
 #define CTDB_CURRENT_NODE     0xF0000001
 /* send a broadcast to all nodes in the cluster, active or not */
@@ -409,6 +414,14 @@ enum ctdb_controls {CTDB_CONTROL_PROCESS_EXISTS          = 0,
 		    CTDB_CONTROL_IPREALLOCATED		 = 137,
 		    CTDB_CONTROL_GET_RUNSTATE		 = 138,
 		    CTDB_CONTROL_DB_DETACH		 = 139,
+		    CTDB_CONTROL_DB_PULL		 = 140,
+		    CTDB_CONTROL_DB_PUSH_START		 = 141,
+		    CTDB_CONTROL_DB_PUSH_CONFIRM	 = 142,
+		    CTDB_CONTROL_DB_FREEZE		 = 143,
+		    CTDB_CONTROL_DB_THAW		 = 144,
+		    CTDB_CONTROL_DB_TRANSACTION_START	 = 145,
+		    CTDB_CONTROL_DB_TRANSACTION_COMMIT	 = 146,
+		    CTDB_CONTROL_DB_TRANSACTION_CANCEL	 = 147,
 };
 
 /*
@@ -722,6 +735,15 @@ struct ctdb_db_statistics {
 	} vacuum;
 	uint32_t db_ro_delegations;
 	uint32_t db_ro_revokes;
+	struct {
+		uint32_t migrations;
+		uint32_t migration_rate;
+		uint32_t ro_wanted;
+		uint32_t sticky_records;
+		uint32_t pinned_down;
+		uint32_t auto_readonly;
+		uint32_t auto_sticky;
+	} hot_records;
 	uint32_t hop_count_bucket[MAX_COUNT_BUCKETS];
 	uint32_t num_hot_keys;
 	struct {
@@ -699,6 +699,7 @@ ctdb_make_record_sticky(struct ctdb_context *ctdb, struct ctdb_db_context *ctdb_
 			 ctdb_db->db_name, ctdb_hash(&key)));
 
 	trbt_insertarray32_callback(ctdb_db->sticky_records, k[0], &k[0], ctdb_make_sticky_record_callback, sr);
+	CTDB_INCREMENT_DB_STAT(ctdb_db, hot_records.sticky_records);
 
 	event_add_timed(ctdb->ev, sr, timeval_current_ofs(ctdb->tunable.sticky_duration, 0), ctdb_sticky_record_timeout, sr);
 
@@ -843,6 +844,173 @@ sort_keys:
 	}
 }
 
+/*
+  The adaptive hot record policy: records that keep migrating between
+  the nodes are the most expensive thing a clustered database does. Over
+  windows of HotRecordInterval seconds we count how often each record
+  was migrated off this node and how many readonly copies local clients
+  asked for. A record that migrates HotRecordMigrations times within a
+  window is made sticky, a database whose clients asked for
+  HotRecordReadOnlyRequests readonly copies gets readonly delegations.
+  The database property is set on all connected nodes, just like
+  "ctdb setdbsticky" and "ctdb setdbreadonly" do.
+
+  The migrations are counted in a small table indexed by the key hash.
+  A key that finds its slot taken by another key decrements the count
+  and takes over the slot when it drops to zero, so only the records
+  that migrate often keep their slot.
+ */
+#define CTDB_HOT_RECORD_SLOTS 1024
+
+struct ctdb_hot_record_slot {
+	uint32_t hash;
+	uint32_t count;
+};
+
+static bool ctdb_hot_record_window(struct ctdb_db_context *ctdb_db)
+{
+	struct ctdb_context *ctdb = ctdb_db->ctdb;
+	uint32_t interval = ctdb->tunable.hot_record_interval;
+	double elapsed;
+
+	if (interval == 0 || ctdb_db->persistent) {
+		return false;
+	}
+
+	if (ctdb_db->hot_window_slots == NULL) {
+		ctdb_db->hot_window_slots = talloc_zero_array(
+			ctdb_db, struct ctdb_hot_record_slot,
+			CTDB_HOT_RECORD_SLOTS);
+		if (ctdb_db->hot_window_slots == NULL) {
+			DEBUG(DEBUG_ERR,("Failed to allocate hot record window\n"));
+			return false;
+		}
+	} else {
+		elapsed = timeval_elapsed(&ctdb_db->hot_window_start);
+		if (elapsed < interval) {
+			return true;
+		}
+
+		ctdb_db->statistics.hot_records.migration_rate =
+			ctdb_db->hot_window_migrations / elapsed;
+		memset(ctdb_db->hot_window_slots, 0,
+		       sizeof(struct ctdb_hot_record_slot) *
+		       CTDB_HOT_RECORD_SLOTS);
+	}
+
+	ctdb_db->hot_window_start = timeval_current();
+	ctdb_db->hot_window_migrations = 0;
+	ctdb_db->hot_window_ro_wanted = 0;
+
+	return true;
+}
+
+static void ctdb_hot_record_set_db_flag(struct ctdb_db_context *ctdb_db,
+					uint32_t opcode)
+{
+	struct ctdb_context *ctdb = ctdb_db->ctdb;
+	TDB_DATA indata;
+	int ret;
+
+	if (opcode == CTDB_CONTROL_SET_DB_STICKY) {
+		ret = ctdb_set_db_sticky(ctdb, ctdb_db);
+	} else {
+		ret = ctdb_set_db_readonly(ctdb, ctdb_db);
+	}
+	if (ret != 0) {
+		return;
+	}
+
+	if (opcode == CTDB_CONTROL_SET_DB_STICKY) {
+		ctdb_db->statistics.hot_records.auto_sticky = 1;
+	} else {
+		ctdb_db->statistics.hot_records.auto_readonly = 1;
+	}
+
+	DEBUG(DEBUG_NOTICE,("Hot records in db %s, enabling %s on all nodes\n",
+			    ctdb_db->db_name,
+			    opcode == CTDB_CONTROL_SET_DB_STICKY ?
+			    "sticky records" : "readonly delegations"));
+
+	indata.dptr  = (uint8_t *)&ctdb_db->db_id;
+	indata.dsize = sizeof(ctdb_db->db_id);
+
+	ctdb_daemon_send_control(ctdb, CTDB_BROADCAST_CONNECTED, 0,
+				 opcode, 0, CTDB_CTRL_FLAG_NOREPLY,
+				 indata, NULL, NULL);
+}
+
+/*
+  a record is hot, make it sticky
+ */
+static void ctdb_hot_record_make_sticky(struct ctdb_db_context *ctdb_db,
+					TDB_DATA key)
+{
+	if (!ctdb_db->sticky) {
+		if (!ctdb_hot_record_window(ctdb_db)) {
+			return;
+		}
+		ctdb_hot_record_set_db_flag(ctdb_db, CTDB_CONTROL_SET_DB_STICKY);
+		if (!ctdb_db->sticky) {
+			return;
+		}
+	}
+
+	ctdb_make_record_sticky(ctdb_db->ctdb, ctdb_db, key);
+}
+
+/*
+  we are about to migrate a record off this node
+ */
+static void ctdb_hot_record_migrated(struct ctdb_db_context *ctdb_db,
+				     TDB_DATA key)
+{
+	struct ctdb_context *ctdb = ctdb_db->ctdb;
+	struct ctdb_hot_record_slot *slot;
+	uint32_t hash;
+
+	CTDB_INCREMENT_DB_STAT(ctdb_db, hot_records.migrations);
+
+	if (!ctdb_hot_record_window(ctdb_db)) {
+		return;
+	}
+	ctdb_db->hot_window_migrations++;
+
+	hash = ctdb_hash(&key);
+	slot = &ctdb_db->hot_window_slots[hash % CTDB_HOT_RECORD_SLOTS];
+
+	if (slot->count != 0 && slot->hash != hash) {
+		slot->count--;
+		return;
+	}
+
+	slot->hash = hash;
+	slot->count++;
+	if (slot->count == ctdb->tunable.hot_record_migrations) {
+		ctdb_hot_record_make_sticky(ctdb_db, key);
+	}
+}
+
+/*
+  a local client asked for a readonly copy of a record, but this
+  database does not do readonly delegations
+ */
+void ctdb_hot_record_ro_wanted(struct ctdb_db_context *ctdb_db)
+{
+	struct ctdb_context *ctdb = ctdb_db->ctdb;
+
+	CTDB_INCREMENT_DB_STAT(ctdb_db, hot_records.ro_wanted);
+
+	if (!ctdb_hot_record_window(ctdb_db)) {
+		return;
+	}
+
+	ctdb_db->hot_window_ro_wanted++;
+	if (ctdb_db->hot_window_ro_wanted == ctdb->tunable.hot_record_ro_requests) {
+		ctdb_hot_record_set_db_flag(ctdb_db, CTDB_CONTROL_SET_DB_READONLY);
+	}
+}
+
 /*
   called when a CTDB_REQ_CALL packet comes in
 */
@@ -890,6 +1058,7 @@ void ctdb_request_call(struct ctdb_context *ctdb, struct ctdb_req_header *hdr)
 		if (ctdb_defer_pinned_down_request(ctdb, ctdb_db, call->key, hdr) == 0) {
 			DEBUG(DEBUG_WARNING,
 			      ("Defer request for pinned down record in %s\n", ctdb_db->db_name));
+			CTDB_INCREMENT_DB_STAT(ctdb_db, hot_records.pinned_down);
 			talloc_free(call);
 			return;
 		}
@@ -1058,12 +1227,12 @@ void ctdb_request_call(struct ctdb_context *ctdb, struct ctdb_req_header *hdr)
 	CTDB_INCREMENT_DB_STAT(ctdb_db, hop_count_bucket[bucket]);
 	ctdb_update_db_stat_hot_keys(ctdb_db, call->key, c->hopcount);
 
-	/* If this database supports sticky records, then check if the
-	   hopcount is big. If it is it means the record is hot and we
-	   should make it sticky.
+	/* If the hopcount is big it means the record is hot and we
+	   should make it sticky. Databases that do not support sticky
+	   records get it from the hot record policy.
 	*/
-	if (ctdb_db->sticky && c->hopcount >= ctdb->tunable.hopcount_make_sticky) {
-		ctdb_make_record_sticky(ctdb, ctdb_db, call->key);
+	if (c->hopcount >= ctdb->tunable.hopcount_make_sticky) {
+		ctdb_hot_record_make_sticky(ctdb_db, call->key);
 	}
 
 
@@ -1079,6 +1248,7 @@ void ctdb_request_call(struct ctdb_context *ctdb, struct ctdb_req_header *hdr)
 		} else {
 			DEBUG(DEBUG_DEBUG,("pnn %u starting migration of %08x to %u\n",
 				 ctdb->pnn, ctdb_hash(&(call->key)), c->hdr.srcnode));
+			ctdb_hot_record_migrated(ctdb_db, call->key);
 			ctdb_call_send_dmaster(ctdb_db, c, &header, &(call->key), &data);
 			talloc_free(data.dptr);
 
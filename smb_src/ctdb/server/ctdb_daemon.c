@@ -658,9 +658,13 @@ static void daemon_request_call_from_client(struct ctdb_client *client,
 		}
 	}
 
-	/* Dont do READONLY if we dont have a tracking database */
+	/* Dont do READONLY if we dont have a tracking database, the
+	   hot record policy might enable it though */
 	if ((c->flags & CTDB_WANT_READONLY) && !ctdb_db->readonly) {
-		c->flags &= ~CTDB_WANT_READONLY;
+		ctdb_hot_record_ro_wanted(ctdb_db);
+		if (!ctdb_db->readonly) {
+			c->flags &= ~CTDB_WANT_READONLY;
+		}
 	}
 
 	if (header.flags & CTDB_REC_RO_REVOKE_COMPLETE) {
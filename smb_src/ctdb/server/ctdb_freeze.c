@@ -46,6 +46,33 @@ struct ctdb_freeze_handle {
 	struct ctdb_freeze_waiter *waiters;
 };
 
+/* a handle to a lock child process freezing a single database */
+struct ctdb_db_freeze_handle {
+	struct ctdb_db_context *ctdb_db;
+	struct lock_request *lreq;
+	struct ctdb_freeze_waiter *waiters;
+};
+
+/*
+  cancel the recovery transaction of a single database
+ */
+static void ctdb_db_transaction_cancel(struct ctdb_db_context *ctdb_db)
+{
+	if (!ctdb_db->freeze_transaction_started) {
+		return;
+	}
+
+	tdb_add_flags(ctdb_db->ltdb->tdb, TDB_NOLOCK);
+	if (tdb_transaction_cancel(ctdb_db->ltdb->tdb) != 0) {
+		DEBUG(DEBUG_ERR,(__location__ " Failed to cancel transaction for db '%s'\n",
+			 ctdb_db->db_name));
+	}
+	tdb_remove_flags(ctdb_db->ltdb->tdb, TDB_NOLOCK);
+
+	ctdb_db->freeze_transaction_started = false;
+	ctdb_db->freeze_transaction_id = 0;
+}
+
 /*
   destroy a freeze handle
  */	
@@ -72,6 +99,13 @@ static int ctdb_freeze_handle_destructor(struct ctdb_freeze_handle *h)
 		ctdb->freeze_transaction_started = false;
 	}
 
+	for (ctdb_db=ctdb->db_list;ctdb_db;ctdb_db=ctdb_db->next) {
+		if (ctdb_db->priority == h->priority &&
+		    ctdb_db->freeze_handle == NULL) {
+			ctdb_db_transaction_cancel(ctdb_db);
+		}
+	}
+
 	ctdb->freeze_mode[h->priority]    = CTDB_FREEZE_NONE;
 	ctdb->freeze_handles[h->priority] = NULL;
 
@@ -128,6 +162,7 @@ static int ctdb_freeze_waiter_destructor(struct ctdb_freeze_waiter *w)
 void ctdb_start_freeze(struct ctdb_context *ctdb, uint32_t priority)
 {
 	struct ctdb_freeze_handle *h;
+	struct ctdb_db_context *ctdb_db;
 
 	if ((priority < 1) || (priority > NUM_DB_PRIORITIES)) {
 		DEBUG(DEBUG_ERR,(__location__ " Invalid db priority : %u\n", priority));
@@ -144,6 +179,15 @@ void ctdb_start_freeze(struct ctdb_context *ctdb, uint32_t priority)
 	/* Stop any vacuuming going on: we don't want to wait. */
 	ctdb_stop_vacuuming(ctdb);
 
+	/* The databases of this priority are locked together now. A
+	   freeze of a single database would block the freeze child. */
+	for (ctdb_db=ctdb->db_list;ctdb_db;ctdb_db=ctdb_db->next) {
+		if (ctdb_db->priority == priority) {
+			TALLOC_FREE(ctdb_db->freeze_handle);
+			ctdb_db->recovered = false;
+		}
+	}
+
 	/* if there isn't a freeze lock child then create one */
 	if (ctdb->freeze_handles[priority] == NULL) {
 		h = talloc_zero(ctdb, struct ctdb_freeze_handle);
@@ -229,14 +273,181 @@ bool ctdb_blocking_freeze(struct ctdb_context *ctdb)
 }
 
 
+/*
+  destroy a freeze handle of a single database
+ */
+static int ctdb_db_freeze_handle_destructor(struct ctdb_db_freeze_handle *h)
+{
+	struct ctdb_db_context *ctdb_db = h->ctdb_db;
+
+	DEBUG(DEBUG_ERR,("Release freeze handler for db %s\n",
+			 ctdb_db->db_name));
+
+	/* cancel any pending transaction */
+	ctdb_db_transaction_cancel(ctdb_db);
+
+	ctdb_db->freeze_mode   = CTDB_FREEZE_NONE;
+	ctdb_db->freeze_handle = NULL;
+
+	return 0;
+}
+
+/*
+  called when the lock child of a single database freeze writes its status
+ */
+static void ctdb_db_freeze_lock_handler(void *private_data, bool locked)
+{
+	struct ctdb_db_freeze_handle *h = talloc_get_type_abort(
+		private_data, struct ctdb_db_freeze_handle);
+	struct ctdb_freeze_waiter *w;
+
+	if (h->ctdb_db->freeze_mode == CTDB_FREEZE_FROZEN) {
+		DEBUG(DEBUG_INFO,("freeze child died - unfreezing\n"));
+		talloc_free(h);
+		return;
+	}
+
+	if (!locked) {
+		DEBUG(DEBUG_ERR,("Failed to get lock on db %s\n",
+				 h->ctdb_db->db_name));
+		talloc_free(h);
+		return;
+	}
+
+	h->ctdb_db->freeze_mode = CTDB_FREEZE_FROZEN;
+
+	/* notify the waiters */
+	while ((w = h->waiters)) {
+		w->status = 0;
+		DLIST_REMOVE(h->waiters, w);
+		talloc_free(w);
+	}
+}
+
+/*
+  a database is frozen if it is frozen on its own or if its whole
+  priority is frozen
+ */
+bool ctdb_db_frozen(struct ctdb_db_context *ctdb_db)
+{
+	struct ctdb_context *ctdb = ctdb_db->ctdb;
+
+	if (ctdb->freeze_mode[ctdb_db->priority] == CTDB_FREEZE_FROZEN) {
+		return true;
+	}
+
+	return (ctdb_db->freeze_mode == CTDB_FREEZE_FROZEN);
+}
+
+/*
+  freeze a single database, used by parallel recovery
+ */
+int32_t ctdb_control_db_freeze(struct ctdb_context *ctdb,
+			       struct ctdb_req_control *c,
+			       uint32_t db_id, bool *async_reply)
+{
+	struct ctdb_db_context *ctdb_db;
+	struct ctdb_freeze_waiter *w;
+	struct ctdb_freeze_waiter **waiters;
+	TALLOC_CTX *waiter_ctx;
+
+	ctdb_db = find_ctdb_db(ctdb, db_id);
+	if (ctdb_db == NULL) {
+		DEBUG(DEBUG_ERR,(__location__ " Unknown db 0x%08x\n", db_id));
+		return -1;
+	}
+
+	ctdb_db->recovered = false;
+
+	if (ctdb_db_frozen(ctdb_db)) {
+		/* we're already frozen */
+		return 0;
+	}
+
+	if (ctdb->freeze_handles[ctdb_db->priority] != NULL) {
+		/* the whole priority is being frozen, wait for that */
+		waiter_ctx = ctdb->freeze_handles[ctdb_db->priority];
+		waiters = &ctdb->freeze_handles[ctdb_db->priority]->waiters;
+	} else {
+		struct ctdb_db_freeze_handle *h = ctdb_db->freeze_handle;
+
+		if (h == NULL) {
+			DEBUG(DEBUG_ERR, ("Freeze db: %s\n", ctdb_db->db_name));
+
+			/* Stop any vacuuming going on: we don't want to wait. */
+			ctdb_stop_vacuuming(ctdb);
+
+			h = talloc_zero(ctdb_db, struct ctdb_db_freeze_handle);
+			CTDB_NO_MEMORY(ctdb, h);
+			h->ctdb_db = ctdb_db;
+			talloc_set_destructor(h, ctdb_db_freeze_handle_destructor);
+
+			h->lreq = ctdb_lock_db(h, ctdb_db, false,
+					       ctdb_db_freeze_lock_handler, h);
+			if (h->lreq == NULL) {
+				talloc_free(h);
+				return -1;
+			}
+			ctdb_db->freeze_handle = h;
+			ctdb_db->freeze_mode = CTDB_FREEZE_PENDING;
+		}
+		waiter_ctx = h;
+		waiters = &h->waiters;
+	}
+
+	/* add ourselves to list of waiters */
+	w = talloc(waiter_ctx, struct ctdb_freeze_waiter);
+	CTDB_NO_MEMORY(ctdb, w);
+	w->ctdb     = ctdb;
+	w->c        = talloc_steal(w, c);
+	w->priority = ctdb_db->priority;
+	w->status   = -1;
+	talloc_set_destructor(w, ctdb_freeze_waiter_destructor);
+	DLIST_ADD(*waiters, w);
+
+	/* we won't reply till later */
+	*async_reply = true;
+	return 0;
+}
+
+/*
+  thaw a single database. This is allowed during recovery, the
+  recovery master thaws each database as soon as it has been
+  recovered.
+ */
+int32_t ctdb_control_db_thaw(struct ctdb_context *ctdb, uint32_t db_id)
+{
+	struct ctdb_db_context *ctdb_db;
+
+	ctdb_db = find_ctdb_db(ctdb, db_id);
+	if (ctdb_db == NULL) {
+		DEBUG(DEBUG_ERR,(__location__ " Unknown db 0x%08x\n", db_id));
+		return -1;
+	}
+
+	DEBUG(DEBUG_ERR, ("Thaw db: %s\n", ctdb_db->db_name));
+
+	/* If the whole priority is frozen, the database stays frozen
+	   until the priority is thawed */
+	TALLOC_FREE(ctdb_db->freeze_handle);
+
+	/* Persistent writes to this database are allowed again before
+	   the recovery mode is back to normal */
+	ctdb_db->recovered = !ctdb_db_frozen(ctdb_db);
+
+	ctdb_call_resend_all(ctdb);
+	return 0;
+}
+
+
 static void thaw_priority(struct ctdb_context *ctdb, uint32_t priority)
 {
+	struct ctdb_db_context *ctdb_db;
+
 	DEBUG(DEBUG_ERR,("Thawing priority %u\n", priority));
 
 	/* cancel any pending transactions */
 	if (ctdb->freeze_transaction_started) {
-		struct ctdb_db_context *ctdb_db;
-
 		for (ctdb_db=ctdb->db_list;ctdb_db;ctdb_db=ctdb_db->next) {
 			tdb_add_flags(ctdb_db->ltdb->tdb, TDB_NOLOCK);
 			if (tdb_transaction_cancel(ctdb_db->ltdb->tdb) != 0) {
@@ -248,6 +459,12 @@ static void thaw_priority(struct ctdb_context *ctdb, uint32_t priority)
 	}
 	ctdb->freeze_transaction_started = false;
 
+	for (ctdb_db=ctdb->db_list;ctdb_db;ctdb_db=ctdb_db->next) {
+		if (ctdb_db->priority == priority) {
+			TALLOC_FREE(ctdb_db->freeze_handle);
+		}
+	}
+
 #if 0
 	/* this hack can be used to get a copy of the databases at the end of a recovery */
 	system("mkdir -p /var/ctdb.saved; /usr/bin/rsync --delete -a /var/ctdb/ /var/ctdb.saved/$$ 2>&1 > /dev/null");
@@ -314,6 +531,9 @@ int32_t ctdb_control_transaction_start(struct ctdb_context *ctdb, uint32_t id)
 	for (ctdb_db=ctdb->db_list;ctdb_db;ctdb_db=ctdb_db->next) {
 		int ret;
 
+		/* left over from an interrupted parallel recovery */
+		ctdb_db_transaction_cancel(ctdb_db);
+
 		tdb_add_flags(ctdb_db->ltdb->tdb, TDB_NOLOCK);
 
 		if (ctdb->freeze_transaction_started) {
@@ -366,6 +586,24 @@ int32_t ctdb_control_transaction_cancel(struct ctdb_context *ctdb)
 	return 0;
 }
 
+static int count_healthy_nodes(struct ctdb_context *ctdb)
+{
+	int i;
+	int healthy_nodes = 0;
+
+	DEBUG(DEBUG_DEBUG,(__location__ " num_nodes[%d]\n", ctdb->num_nodes));
+	for (i=0; i < ctdb->num_nodes; i++) {
+		DEBUG(DEBUG_DEBUG,(__location__ " node[%d].flags[0x%X]\n",
+				   i, ctdb->nodes[i]->flags));
+		if (ctdb->nodes[i]->flags == 0) {
+			healthy_nodes++;
+		}
+	}
+	DEBUG(DEBUG_INFO,(__location__ " healthy_nodes[%d]\n", healthy_nodes));
+
+	return healthy_nodes;
+}
+
 /*
   commit transactions on all databases
  */
@@ -373,7 +611,7 @@ int32_t ctdb_control_transaction_commit(struct ctdb_context *ctdb, uint32_t id)
 {
 	struct ctdb_db_context *ctdb_db;
 	int i;
-	int healthy_nodes = 0;
+	int healthy_nodes;
 
 	for (i=1;i<=NUM_DB_PRIORITIES; i++) {
 		if (ctdb->freeze_mode[i] != CTDB_FREEZE_FROZEN) {
@@ -392,15 +630,7 @@ int32_t ctdb_control_transaction_commit(struct ctdb_context *ctdb, uint32_t id)
 		return -1;
 	}
 
-	DEBUG(DEBUG_DEBUG,(__location__ " num_nodes[%d]\n", ctdb->num_nodes));
-	for (i=0; i < ctdb->num_nodes; i++) {
-		DEBUG(DEBUG_DEBUG,(__location__ " node[%d].flags[0x%X]\n",
-				   i, ctdb->nodes[i]->flags));
-		if (ctdb->nodes[i]->flags == 0) {
-			healthy_nodes++;
-		}
-	}
-	DEBUG(DEBUG_INFO,(__location__ " healthy_nodes[%d]\n", healthy_nodes));
+	healthy_nodes = count_healthy_nodes(ctdb);
 
 	for (ctdb_db=ctdb->db_list;ctdb_db;ctdb_db=ctdb_db->next) {
 		int ret;
@@ -443,6 +673,130 @@ fail:
 	return -1;
 }
 
+/*
+  start a transaction on a single database - used for parallel recovery
+ */
+int32_t ctdb_control_db_transaction_start(struct ctdb_context *ctdb,
+					  TDB_DATA indata)
+{
+	struct ctdb_control_transdb *t = (struct ctdb_control_transdb *)indata.dptr;
+	struct ctdb_db_context *ctdb_db;
+	int ret;
+
+	ctdb_db = find_ctdb_db(ctdb, t->db_id);
+	if (ctdb_db == NULL) {
+		DEBUG(DEBUG_ERR,(__location__ " Unknown db 0x%08x\n", t->db_id));
+		return -1;
+	}
+
+	if (!ctdb_db_frozen(ctdb_db)) {
+		DEBUG(DEBUG_ERR,(__location__ " Failed transaction_start while not frozen\n"));
+		return -1;
+	}
+
+	if (ctdb->freeze_transaction_started) {
+		/* left over from an interrupted recovery */
+		ctdb_control_transaction_cancel(ctdb);
+	}
+
+	ctdb_db_transaction_cancel(ctdb_db);
+
+	tdb_add_flags(ctdb_db->ltdb->tdb, TDB_NOLOCK);
+	ret = tdb_transaction_start(ctdb_db->ltdb->tdb);
+	tdb_remove_flags(ctdb_db->ltdb->tdb, TDB_NOLOCK);
+
+	if (ret != 0) {
+		DEBUG(DEBUG_ERR,(__location__ " Failed to start transaction for db '%s'\n",
+			 ctdb_db->db_name));
+		return -1;
+	}
+
+	ctdb_db->freeze_transaction_started = true;
+	ctdb_db->freeze_transaction_id = t->transaction_id;
+
+	return 0;
+}
+
+/*
+  cancel the transaction on a single database - used for parallel recovery
+ */
+int32_t ctdb_control_db_transaction_cancel(struct ctdb_context *ctdb,
+					   uint32_t db_id)
+{
+	struct ctdb_db_context *ctdb_db;
+
+	ctdb_db = find_ctdb_db(ctdb, db_id);
+	if (ctdb_db == NULL) {
+		DEBUG(DEBUG_ERR,(__location__ " Unknown db 0x%08x\n", db_id));
+		return -1;
+	}
+
+	DEBUG(DEBUG_ERR,(__location__ " recovery transaction cancelled for db '%s'\n",
+			 ctdb_db->db_name));
+
+	ctdb_db_transaction_cancel(ctdb_db);
+
+	return 0;
+}
+
+/*
+  commit the transaction on a single database - used for parallel recovery
+ */
+int32_t ctdb_control_db_transaction_commit(struct ctdb_context *ctdb,
+					   TDB_DATA indata)
+{
+	struct ctdb_control_transdb *t = (struct ctdb_control_transdb *)indata.dptr;
+	struct ctdb_db_context *ctdb_db;
+	int healthy_nodes;
+	int ret;
+
+	ctdb_db = find_ctdb_db(ctdb, t->db_id);
+	if (ctdb_db == NULL) {
+		DEBUG(DEBUG_ERR,(__location__ " Unknown db 0x%08x\n", t->db_id));
+		return -1;
+	}
+
+	if (!ctdb_db_frozen(ctdb_db)) {
+		DEBUG(DEBUG_ERR,(__location__ " Failed transaction_commit while not frozen\n"));
+		return -1;
+	}
+
+	if (!ctdb_db->freeze_transaction_started) {
+		DEBUG(DEBUG_ERR,(__location__ " transaction not started\n"));
+		return -1;
+	}
+
+	if (t->transaction_id != ctdb_db->freeze_transaction_id) {
+		DEBUG(DEBUG_ERR,(__location__ " incorrect transaction id 0x%x in commit\n",
+			 t->transaction_id));
+		return -1;
+	}
+
+	healthy_nodes = count_healthy_nodes(ctdb);
+
+	tdb_add_flags(ctdb_db->ltdb->tdb, TDB_NOLOCK);
+	ret = tdb_transaction_commit(ctdb_db->ltdb->tdb);
+	tdb_remove_flags(ctdb_db->ltdb->tdb, TDB_NOLOCK);
+	if (ret != 0) {
+		DEBUG(DEBUG_ERR,(__location__ " Failed to commit transaction for db '%s'\n",
+			 ctdb_db->db_name));
+		ctdb_db_transaction_cancel(ctdb_db);
+		return -1;
+	}
+
+	ctdb_db->freeze_transaction_started = false;
+	ctdb_db->freeze_transaction_id = 0;
+
+	ret = ctdb_update_persistent_health(ctdb, ctdb_db, NULL, healthy_nodes);
+	if (ret != 0) {
+		DEBUG(DEBUG_CRIT,(__location__ " Failed to update persistent health for db '%s'\n",
+				  ctdb_db->db_name));
+		return -1;
+	}
+
+	return 0;
+}
+
 /*
   wipe a database - only possible when in a frozen transaction
  */
@@ -457,19 +811,26 @@ int32_t ctdb_control_wipe_database(struct ctdb_context *ctdb, TDB_DATA indata)
 		return -1;
 	}
 
-	if (ctdb->freeze_mode[ctdb_db->priority] != CTDB_FREEZE_FROZEN) {
+	if (!ctdb_db_frozen(ctdb_db)) {
 		DEBUG(DEBUG_ERR,(__location__ " Failed transaction_start while not frozen\n"));
 		return -1;
 	}
 
-	if (!ctdb->freeze_transaction_started) {
-		DEBUG(DEBUG_ERR,(__location__ " transaction not started\n"));
-		return -1;
-	}
+	if (ctdb_db->freeze_transaction_started) {
+		if (w.transaction_id != ctdb_db->freeze_transaction_id) {
+			DEBUG(DEBUG_ERR,(__location__ " incorrect transaction id 0x%x in commit\n", w.transaction_id));
+			return -1;
+		}
+	} else {
+		if (!ctdb->freeze_transaction_started) {
+			DEBUG(DEBUG_ERR,(__location__ " transaction not started\n"));
+			return -1;
+		}
 
-	if (w.transaction_id != ctdb->freeze_transaction_id) {
-		DEBUG(DEBUG_ERR,(__location__ " incorrect transaction id 0x%x in commit\n", w.transaction_id));
-		return -1;
+		if (w.transaction_id != ctdb->freeze_transaction_id) {
+			DEBUG(DEBUG_ERR,(__location__ " incorrect transaction id 0x%x in commit\n", w.transaction_id));
+			return -1;
+		}
 	}
 
 	if (tdb_wipe_all(ctdb_db->ltdb->tdb) != 0) {
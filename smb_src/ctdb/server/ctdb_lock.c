@@ -251,6 +251,33 @@ int ctdb_lockall_unmark_prio(struct ctdb_context *ctdb, uint32_t priority)
 	return ctdb_db_iterator(ctdb, priority, db_lock_unmark_handler, NULL);
 }
 
+int ctdb_lockdb_mark(struct ctdb_db_context *ctdb_db)
+{
+	/*
+	 * Same as ctdb_lockall_mark_prio() for a single database, which
+	 * is either frozen on its own or together with its priority.
+	 */
+
+	if (!ctdb_db_frozen(ctdb_db)) {
+		DEBUG(DEBUG_ERR, ("Attempt to mark database %s locked when not frozen\n",
+				  ctdb_db->db_name));
+		return -1;
+	}
+
+	return db_lock_mark_handler(ctdb_db, ctdb_db->priority, NULL);
+}
+
+int ctdb_lockdb_unmark(struct ctdb_db_context *ctdb_db)
+{
+	if (!ctdb_db_frozen(ctdb_db)) {
+		DEBUG(DEBUG_ERR, ("Attempt to unmark database %s locked when not frozen\n",
+				  ctdb_db->db_name));
+		return -1;
+	}
+
+	return db_lock_unmark_handler(ctdb_db, ctdb_db->priority, NULL);
+}
+
 static int ctdb_lockall_unmark(struct ctdb_context *ctdb)
 {
 	uint32_t priority;
@@ -169,11 +169,6 @@ int32_t ctdb_control_trans3_commit(struct ctdb_context *ctdb,
 	struct ctdb_marshall_buffer *m = (struct ctdb_marshall_buffer *)recdata.dptr;
 	struct ctdb_db_context *ctdb_db;
 
-	if (ctdb->recovery_mode != CTDB_RECOVERY_NORMAL) {
-		DEBUG(DEBUG_INFO,("rejecting ctdb_control_trans3_commit when recovery active\n"));
-		return -1;
-	}
-
 	client = ctdb_reqid_find(ctdb, c->client_id, struct ctdb_client);
 	if (client == NULL) {
 		DEBUG(DEBUG_ERR,(__location__ " can not match persistent_store "
@@ -196,6 +191,16 @@ int32_t ctdb_control_trans3_commit(struct ctdb_context *ctdb,
 		return -1;
 	}
 
+	/*
+	 * Databases are thawed one by one during a parallel recovery,
+	 * a database that has been thawed accepts commits again.
+	 */
+	if (ctdb->recovery_mode != CTDB_RECOVERY_NORMAL &&
+	    !ctdb_db->recovered) {
+		DEBUG(DEBUG_INFO,("rejecting ctdb_control_trans3_commit when recovery active\n"));
+		return -1;
+	}
+
 	if (ctdb_db->persistent_state != NULL) {
 		DEBUG(DEBUG_ERR, (__location__ " Error: "
 				  "ctdb_control_trans3_commit "
@@ -54,10 +54,10 @@ int
 ctdb_control_setvnnmap(struct ctdb_context *ctdb, uint32_t opcode, TDB_DATA indata, TDB_DATA *outdata)
 {
 	struct ctdb_vnn_map_wire *map = (struct ctdb_vnn_map_wire *)indata.dptr;
-	int i;
+	struct ctdb_db_context *ctdb_db;
 
-	for(i=1; i<=NUM_DB_PRIORITIES; i++) {
-		if (ctdb->freeze_mode[i] != CTDB_FREEZE_FROZEN) {
+	for (ctdb_db = ctdb->db_list; ctdb_db != NULL; ctdb_db = ctdb_db->next) {
+		if (!ctdb_db_frozen(ctdb_db)) {
 			DEBUG(DEBUG_ERR,("Attempt to set vnnmap when not frozen\n"));
 			return -1;
 		}
@@ -315,7 +315,7 @@ int32_t ctdb_control_pull_db(struct ctdb_context *ctdb, TDB_DATA indata, TDB_DAT
 		return -1;
 	}
 
-	if (ctdb->freeze_mode[ctdb_db->priority] != CTDB_FREEZE_FROZEN) {
+	if (!ctdb_db_frozen(ctdb_db)) {
 		DEBUG(DEBUG_DEBUG,("rejecting ctdb_control_pull_db when not frozen\n"));
 		return -1;
 	}
@@ -338,19 +338,19 @@ int32_t ctdb_control_pull_db(struct ctdb_context *ctdb, TDB_DATA indata, TDB_DAT
 				     ctdb_db->db_name, ctdb_db->unhealthy_reason));
 	}
 
-	if (ctdb_lockall_mark_prio(ctdb, ctdb_db->priority) != 0) {
+	if (ctdb_lockdb_mark(ctdb_db) != 0) {
 		DEBUG(DEBUG_ERR,(__location__ " Failed to get lock on entired db - failing\n"));
 		return -1;
 	}
 
 	if (tdb_traverse_read(ctdb_db->ltdb->tdb, traverse_pulldb, &params) == -1) {
 		DEBUG(DEBUG_ERR,(__location__ " Failed to get traverse db '%s'\n", ctdb_db->db_name));
-		ctdb_lockall_unmark_prio(ctdb, ctdb_db->priority);
+		ctdb_lockdb_unmark(ctdb_db);
 		talloc_free(params.pulldata);
 		return -1;
 	}
 
-	ctdb_lockall_unmark_prio(ctdb, ctdb_db->priority);
+	ctdb_lockdb_unmark(ctdb_db);
 
 	outdata->dptr = (uint8_t *)params.pulldata;
 	outdata->dsize = params.len;
@@ -366,6 +366,60 @@ int32_t ctdb_control_pull_db(struct ctdb_context *ctdb, TDB_DATA indata, TDB_DAT
 	return 0;
 }
 
+/*
+  store one record pushed by the recovery master
+ */
+static int ctdb_push_db_store_record(struct ctdb_db_context *ctdb_db,
+				     TDB_DATA key, TDB_DATA data)
+{
+	struct ctdb_ltdb_header *hdr;
+	int ret;
+
+	if (data.dsize < sizeof(struct ctdb_ltdb_header)) {
+		DEBUG(DEBUG_CRIT,(__location__ " bad ltdb record\n"));
+		return -1;
+	}
+	hdr = (struct ctdb_ltdb_header *)data.dptr;
+	/* strip off any read only record flags. All readonly records
+	   are revoked implicitely by a recovery
+	*/
+	hdr->flags &= ~CTDB_REC_RO_FLAGS;
+
+	data.dptr += sizeof(*hdr);
+	data.dsize -= sizeof(*hdr);
+
+	ret = ctdb_ltdb_store(ctdb_db, key, hdr, data);
+	if (ret != 0) {
+		DEBUG(DEBUG_CRIT, (__location__ " Unable to store record\n"));
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+  a recovery revokes all read-only delegations of a db
+ */
+static void ctdb_db_clear_readonly_tracking(struct ctdb_db_context *ctdb_db)
+{
+	if (!ctdb_db->readonly) {
+		return;
+	}
+
+	DEBUG(DEBUG_CRIT,("Clearing the tracking database for dbid 0x%x\n",
+			  ctdb_db->db_id));
+	if (tdb_wipe_all(ctdb_db->rottdb) != 0) {
+		DEBUG(DEBUG_ERR,("Failed to wipe tracking database for 0x%x. Dropping read-only delegation support\n", ctdb_db->db_id));
+		ctdb_db->readonly = false;
+		tdb_close(ctdb_db->rottdb);
+		ctdb_db->rottdb = NULL;
+		ctdb_db->readonly = false;
+	}
+	while (ctdb_db->revokechild_active != NULL) {
+		talloc_free(ctdb_db->revokechild_active);
+	}
+}
+
 /*
   push a bunch of records into a ltdb, filtering by rsn
  */
@@ -387,12 +441,12 @@ int32_t ctdb_control_push_db(struct ctdb_context *ctdb, TDB_DATA indata)
 		return -1;
 	}
 
-	if (ctdb->freeze_mode[ctdb_db->priority] != CTDB_FREEZE_FROZEN) {
+	if (!ctdb_db_frozen(ctdb_db)) {
 		DEBUG(DEBUG_DEBUG,("rejecting ctdb_control_push_db when not frozen\n"));
 		return -1;
 	}
 
-	if (ctdb_lockall_mark_prio(ctdb, ctdb_db->priority) != 0) {
+	if (ctdb_lockdb_mark(ctdb_db) != 0) {
 		DEBUG(DEBUG_ERR,(__location__ " Failed to get lock on entired db - failing\n"));
 		return -1;
 	}
@@ -404,29 +458,14 @@ int32_t ctdb_control_push_db(struct ctdb_context *ctdb, TDB_DATA indata)
 
 	for (i=0;i<reply->count;i++) {
 		TDB_DATA key, data;
-		struct ctdb_ltdb_header *hdr;
 
 		key.dptr = &rec->data[0];
 		key.dsize = rec->keylen;
 		data.dptr = &rec->data[key.dsize];
 		data.dsize = rec->datalen;
 
-		if (data.dsize < sizeof(struct ctdb_ltdb_header)) {
-			DEBUG(DEBUG_CRIT,(__location__ " bad ltdb record\n"));
-			goto failed;
-		}
-		hdr = (struct ctdb_ltdb_header *)data.dptr;
-		/* strip off any read only record flags. All readonly records
-		   are revoked implicitely by a recovery
-		*/
-		hdr->flags &= ~CTDB_REC_RO_FLAGS;
-
-		data.dptr += sizeof(*hdr);
-		data.dsize -= sizeof(*hdr);
-
-		ret = ctdb_ltdb_store(ctdb_db, key, hdr, data);
+		ret = ctdb_push_db_store_record(ctdb_db, key, data);
 		if (ret != 0) {
-			DEBUG(DEBUG_CRIT, (__location__ " Unable to store record\n"));
 			goto failed;
 		}
 
@@ -436,27 +475,370 @@ int32_t ctdb_control_push_db(struct ctdb_context *ctdb, TDB_DATA indata)
 	DEBUG(DEBUG_DEBUG,("finished push of %u records for dbid 0x%x\n",
 		 reply->count, reply->db_id));
 
-	if (ctdb_db->readonly) {
-		DEBUG(DEBUG_CRIT,("Clearing the tracking database for dbid 0x%x\n",
-				  ctdb_db->db_id));
-		if (tdb_wipe_all(ctdb_db->rottdb) != 0) {
-			DEBUG(DEBUG_ERR,("Failed to wipe tracking database for 0x%x. Dropping read-only delegation support\n", ctdb_db->db_id));
-			ctdb_db->readonly = false;
-			tdb_close(ctdb_db->rottdb);
-			ctdb_db->rottdb = NULL;
-			ctdb_db->readonly = false;
+	ctdb_db_clear_readonly_tracking(ctdb_db);
+
+	ctdb_lockdb_unmark(ctdb_db);
+	return 0;
+
+failed:
+	ctdb_lockdb_unmark(ctdb_db);
+	return -1;
+}
+
+/*
+  a traverse function for streaming all records of a db to the
+  recovery master in batches
+ */
+struct db_pull_state {
+	struct ctdb_context *ctdb;
+	struct ctdb_db_context *ctdb_db;
+	struct ctdb_marshall_buffer *recs;
+	uint32_t pnn;
+	uint64_t srvid;
+	uint32_t num_records;
+	uint64_t num_bytes;
+	bool failed;
+};
+
+static int db_pull_send_batch(struct db_pull_state *state)
+{
+	struct ctdb_context *ctdb = state->ctdb;
+	TDB_DATA data;
+	int ret;
+
+	data = ctdb_marshall_finish(state->recs);
+
+	if (state->pnn == ctdb->pnn) {
+		/*
+		 * The recovery daemon on this node is pulling. Hand the
+		 * batch to its client queue right away instead of
+		 * deferring all batches until the traverse is done.
+		 */
+		ret = ctdb_dispatch_message(ctdb, state->srvid, data);
+	} else {
+		ret = ctdb_daemon_send_message(ctdb, state->pnn,
+					       state->srvid, data);
+	}
+	if (ret != 0) {
+		DEBUG(DEBUG_ERR, (__location__ " Failed to send records of "
+				  "db %s to node %u\n",
+				  state->ctdb_db->db_name, state->pnn));
+	}
+
+	state->num_bytes += data.dsize;
+	TALLOC_FREE(state->recs);
+
+	return ret;
+}
+
+static int traverse_db_pull(struct tdb_context *tdb, TDB_DATA key,
+			    TDB_DATA data, void *private_data)
+{
+	struct db_pull_state *state = (struct db_pull_state *)private_data;
+	struct ctdb_context *ctdb = state->ctdb;
+	struct ctdb_db_context *ctdb_db = state->ctdb_db;
+
+	state->recs = ctdb_marshall_add(state, state->recs, ctdb_db->db_id,
+					0, key, NULL, data);
+	if (state->recs == NULL) {
+		DEBUG(DEBUG_ERR, (__location__ " Failed to marshall record "
+				  "of db %s\n", ctdb_db->db_name));
+		state->failed = true;
+		return -1;
+	}
+	state->num_records += 1;
+
+	if (ctdb->tunable.db_record_size_warn != 0 &&
+	    data.dsize > ctdb->tunable.db_record_size_warn) {
+		DEBUG(DEBUG_ERR,("Data record in %s is big. Record size is %d bytes\n",
+				 ctdb_db->db_name, (int)data.dsize));
+	}
+
+	if (talloc_get_size(state->recs) >= ctdb->tunable.rec_buffer_size_limit) {
+		if (db_pull_send_batch(state) != 0) {
+			state->failed = true;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+  stream all records of a ltdb to the requesting node as messages to
+  the given srvid. The reply contains the number of records sent.
+ */
+int32_t ctdb_control_db_pull(struct ctdb_context *ctdb,
+			     struct ctdb_req_control *c,
+			     TDB_DATA indata, TDB_DATA *outdata)
+{
+	struct ctdb_control_pulldb_ext *pulldb_ext;
+	struct ctdb_db_context *ctdb_db;
+	struct db_pull_state *state;
+	uint32_t *num_records;
+	int ret;
+
+	pulldb_ext = (struct ctdb_control_pulldb_ext *)indata.dptr;
+
+	ctdb_db = find_ctdb_db(ctdb, pulldb_ext->db_id);
+	if (ctdb_db == NULL) {
+		DEBUG(DEBUG_ERR,(__location__ " Unknown db 0x%08x\n",
+				 pulldb_ext->db_id));
+		return -1;
+	}
+
+	if (!ctdb_db_frozen(ctdb_db)) {
+		DEBUG(DEBUG_DEBUG,("rejecting ctdb_control_db_pull when not frozen\n"));
+		return -1;
+	}
+
+	if (ctdb_db->unhealthy_reason) {
+		/* this is just a warning, as the tdb should be empty anyway */
+		DEBUG(DEBUG_WARNING,("db(%s) unhealty in ctdb_control_db_pull: %s\n",
+				     ctdb_db->db_name, ctdb_db->unhealthy_reason));
+	}
+
+	state = talloc_zero(ctdb, struct db_pull_state);
+	CTDB_NO_MEMORY(ctdb, state);
+
+	state->ctdb = ctdb;
+	state->ctdb_db = ctdb_db;
+	state->pnn = c->hdr.srcnode;
+	state->srvid = pulldb_ext->srvid;
+
+	if (ctdb_lockdb_mark(ctdb_db) != 0) {
+		DEBUG(DEBUG_ERR,(__location__ " Failed to get lock on entired db - failing\n"));
+		talloc_free(state);
+		return -1;
+	}
+
+	ret = tdb_traverse_read(ctdb_db->ltdb->tdb, traverse_db_pull, state);
+	if (ret == -1 || state->failed) {
+		DEBUG(DEBUG_ERR,(__location__ " Failed to get traverse db '%s'\n",
+				 ctdb_db->db_name));
+		ctdb_lockdb_unmark(ctdb_db);
+		talloc_free(state);
+		return -1;
+	}
+
+	/* Last few records */
+	if (state->recs != NULL) {
+		if (db_pull_send_batch(state) != 0) {
+			ctdb_lockdb_unmark(ctdb_db);
+			talloc_free(state);
+			return -1;
 		}
-		while (ctdb_db->revokechild_active != NULL) {
-			talloc_free(ctdb_db->revokechild_active);
+	}
+
+	ctdb_lockdb_unmark(ctdb_db);
+
+	if (ctdb->tunable.db_record_count_warn != 0 &&
+	    state->num_records > ctdb->tunable.db_record_count_warn) {
+		DEBUG(DEBUG_ERR,("Database %s is big. Contains %u records\n",
+				 ctdb_db->db_name, state->num_records));
+	}
+	if (ctdb->tunable.db_size_warn != 0 &&
+	    state->num_bytes > ctdb->tunable.db_size_warn) {
+		DEBUG(DEBUG_ERR,("Database %s is big. Contains %llu bytes\n",
+				 ctdb_db->db_name,
+				 (unsigned long long)state->num_bytes));
+	}
+
+	DEBUG(DEBUG_INFO, ("Sent %u records for db %s to node %u\n",
+			   state->num_records, ctdb_db->db_name, state->pnn));
+
+	num_records = talloc(outdata, uint32_t);
+	if (num_records == NULL) {
+		talloc_free(state);
+		return -1;
+	}
+	*num_records = state->num_records;
+	outdata->dptr = (uint8_t *)num_records;
+	outdata->dsize = sizeof(uint32_t);
+
+	talloc_free(state);
+	return 0;
+}
+
+/*
+  state of a streaming push: the records arrive as messages between
+  DB_PUSH_START and DB_PUSH_CONFIRM
+ */
+struct db_push_state {
+	struct ctdb_context *ctdb;
+	struct ctdb_db_context *ctdb_db;
+	uint64_t srvid;
+	uint32_t num_records;
+	bool failed;
+};
+
+static int db_push_state_destructor(struct db_push_state *state)
+{
+	ctdb_deregister_message_handler(state->ctdb, state->srvid, state);
+	state->ctdb_db->push_state = NULL;
+	return 0;
+}
+
+static void db_push_msg_handler(struct ctdb_context *ctdb, uint64_t srvid,
+				TDB_DATA indata, void *private_data)
+{
+	struct db_push_state *state = talloc_get_type(
+		private_data, struct db_push_state);
+	struct ctdb_db_context *ctdb_db = state->ctdb_db;
+	struct ctdb_marshall_buffer *recs;
+	struct ctdb_rec_data *rec;
+	int i, ret;
+
+	if (state->failed) {
+		return;
+	}
+
+	recs = (struct ctdb_marshall_buffer *)indata.dptr;
+	if (!ctdb_marshall_buf_valid(indata) ||
+	    recs->db_id != ctdb_db->db_id) {
+		DEBUG(DEBUG_ERR, (__location__ " invalid records for db %s "
+				  "in push\n", ctdb_db->db_name));
+		state->failed = true;
+		return;
+	}
+
+	if (!ctdb_db_frozen(ctdb_db)) {
+		DEBUG(DEBUG_ERR, ("Received push records for db %s when "
+				  "not frozen\n", ctdb_db->db_name));
+		state->failed = true;
+		return;
+	}
+
+	if (ctdb_lockdb_mark(ctdb_db) != 0) {
+		DEBUG(DEBUG_ERR,(__location__ " Failed to get lock on entired db - failing\n"));
+		state->failed = true;
+		return;
+	}
+
+	rec = NULL;
+	for (i=0; i<recs->count; i++) {
+		TDB_DATA key, data;
+
+		rec = ctdb_marshall_loop_next(recs, rec, NULL, NULL,
+					      &key, &data);
+
+		ret = ctdb_push_db_store_record(ctdb_db, key, data);
+		if (ret != 0) {
+			state->failed = true;
+			break;
 		}
+		state->num_records += 1;
+	}
+
+	ctdb_lockdb_unmark(ctdb_db);
+}
+
+/*
+  start receiving records for a db from the recovery master
+ */
+int32_t ctdb_control_db_push_start(struct ctdb_context *ctdb,
+				   TDB_DATA indata)
+{
+	struct ctdb_control_pulldb_ext *pulldb_ext;
+	struct ctdb_db_context *ctdb_db;
+	struct db_push_state *state;
+	int ret;
+
+	pulldb_ext = (struct ctdb_control_pulldb_ext *)indata.dptr;
+
+	ctdb_db = find_ctdb_db(ctdb, pulldb_ext->db_id);
+	if (ctdb_db == NULL) {
+		DEBUG(DEBUG_ERR,(__location__ " Unknown db 0x%08x\n",
+				 pulldb_ext->db_id));
+		return -1;
+	}
+
+	if (!ctdb_db_frozen(ctdb_db)) {
+		DEBUG(DEBUG_DEBUG,("rejecting ctdb_control_db_push_start when not frozen\n"));
+		return -1;
+	}
+
+	if (ctdb_db->push_state != NULL) {
+		/* A previous recovery was interrupted */
+		DEBUG(DEBUG_NOTICE, ("Discarding unfinished push for db %s\n",
+				     ctdb_db->db_name));
+		talloc_free(ctdb_db->push_state);
 	}
 
-	ctdb_lockall_unmark_prio(ctdb, ctdb_db->priority);
+	state = talloc_zero(ctdb_db, struct db_push_state);
+	CTDB_NO_MEMORY(ctdb, state);
+
+	state->ctdb = ctdb;
+	state->ctdb_db = ctdb_db;
+	state->srvid = pulldb_ext->srvid;
+
+	ret = ctdb_register_message_handler(ctdb, state, state->srvid,
+					    db_push_msg_handler, state);
+	if (ret != 0) {
+		DEBUG(DEBUG_ERR, (__location__ " Failed to register message "
+				  "handler for push of db %s\n",
+				  ctdb_db->db_name));
+		talloc_free(state);
+		return -1;
+	}
+
+	ctdb_db->push_state = state;
+	talloc_set_destructor(state, db_push_state_destructor);
+
+	DEBUG(DEBUG_INFO, ("Started push for db %s\n", ctdb_db->db_name));
+
 	return 0;
+}
 
-failed:
-	ctdb_lockall_unmark_prio(ctdb, ctdb_db->priority);
-	return -1;
+/*
+  finish a streaming push. The reply contains the number of records
+  stored, so the recovery master can check that nothing was lost.
+ */
+int32_t ctdb_control_db_push_confirm(struct ctdb_context *ctdb,
+				     TDB_DATA indata, TDB_DATA *outdata)
+{
+	struct ctdb_db_context *ctdb_db;
+	struct db_push_state *state;
+	uint32_t db_id, *num_records;
+
+	db_id = *(uint32_t *)indata.dptr;
+
+	ctdb_db = find_ctdb_db(ctdb, db_id);
+	if (ctdb_db == NULL) {
+		DEBUG(DEBUG_ERR,(__location__ " Unknown db 0x%08x\n", db_id));
+		return -1;
+	}
+
+	state = ctdb_db->push_state;
+	if (state == NULL) {
+		DEBUG(DEBUG_ERR, ("Push confirm for db %s without push "
+				  "start\n", ctdb_db->db_name));
+		return -1;
+	}
+
+	if (state->failed) {
+		DEBUG(DEBUG_ERR, ("Push for db %s failed\n",
+				  ctdb_db->db_name));
+		talloc_free(state);
+		return -1;
+	}
+
+	num_records = talloc(outdata, uint32_t);
+	if (num_records == NULL) {
+		talloc_free(state);
+		return -1;
+	}
+	*num_records = state->num_records;
+	outdata->dptr = (uint8_t *)num_records;
+	outdata->dsize = sizeof(uint32_t);
+
+	DEBUG(DEBUG_INFO, ("Finished push of %u records for db %s\n",
+			   state->num_records, ctdb_db->db_name));
+
+	ctdb_db_clear_readonly_tracking(ctdb_db);
+
+	talloc_free(state);
+	return 0;
 }
 
 struct ctdb_set_recmode_state {
@@ -594,6 +976,7 @@ int32_t ctdb_control_set_recmode(struct ctdb_context *ctdb,
 	uint32_t recmode = *(uint32_t *)indata.dptr;
 	int i, ret;
 	struct ctdb_set_recmode_state *state;
+	struct ctdb_db_context *ctdb_db;
 	pid_t parent = getpid();
 
 	/* if we enter recovery but stay in recovery for too long
@@ -606,6 +989,10 @@ int32_t ctdb_control_set_recmode(struct ctdb_context *ctdb,
 		if (ctdb_deferred_drop_all_ips(ctdb) != 0) {
 			DEBUG(DEBUG_ERR,("Failed to set up deferred drop all ips\n"));
 		}
+		/* a new recovery has to thaw the databases again */
+		for (ctdb_db = ctdb->db_list; ctdb_db != NULL; ctdb_db = ctdb_db->next) {
+			ctdb_db->recovered = false;
+		}
 	}
 
 	if (recmode != ctdb->recovery_mode) {
@@ -627,6 +1014,11 @@ int32_t ctdb_control_set_recmode(struct ctdb_context *ctdb,
 			ctdb_control_thaw(ctdb, i, false);
 		}
 	}
+	for (ctdb_db = ctdb->db_list; ctdb_db != NULL; ctdb_db = ctdb_db->next) {
+		if (ctdb_db->freeze_handle != NULL) {
+			ctdb_control_db_thaw(ctdb, ctdb_db->db_id);
+		}
+	}
 
 	state = talloc(ctdb, struct ctdb_set_recmode_state);
 	CTDB_NO_MEMORY(ctdb, state);
@@ -370,7 +370,7 @@ static void transaction_start_fail_callback(struct ctdb_context *ctdb, uint32_t
 /*
   change recovery mode on all nodes
  */
-static int set_recovery_mode(struct ctdb_context *ctdb, struct ctdb_recoverd *rec, struct ctdb_node_map *nodemap, uint32_t rec_mode)
+static int set_recovery_mode(struct ctdb_context *ctdb, struct ctdb_recoverd *rec, struct ctdb_node_map *nodemap, uint32_t rec_mode, bool freeze)
 {
 	TDB_DATA data;
 	uint32_t *nodes;
@@ -396,7 +396,7 @@ static int set_recovery_mode(struct ctdb_context *ctdb, struct ctdb_recoverd *re
 	}
 
 	/* freeze all nodes */
-	if (rec_mode == CTDB_RECOVERY_ACTIVE) {
+	if (freeze && rec_mode == CTDB_RECOVERY_ACTIVE) {
 		int i;
 
 		for (i=1; i<=NUM_DB_PRIORITIES; i++) {
@@ -616,6 +616,50 @@ static int create_missing_local_databases(struct ctdb_context *ctdb, struct ctdb
 }
 
 
+/*
+  merge one record pulled from a node into the recdb, keeping the
+  copy with the highest rsn
+ */
+static int recdb_merge_record(struct ctdb_context *ctdb,
+			      struct tdb_wrap *recdb,
+			      TDB_DATA key, TDB_DATA data)
+{
+	struct ctdb_ltdb_header *hdr;
+	TDB_DATA existing;
+
+	if (data.dsize < sizeof(struct ctdb_ltdb_header)) {
+		DEBUG(DEBUG_CRIT,(__location__ " bad ltdb record\n"));
+		return -1;
+	}
+	hdr = (struct ctdb_ltdb_header *)data.dptr;
+
+	/* fetch the existing record, if any */
+	existing = tdb_fetch(recdb->tdb, key);
+
+	if (existing.dptr != NULL) {
+		struct ctdb_ltdb_header header;
+		if (existing.dsize < sizeof(struct ctdb_ltdb_header)) {
+			DEBUG(DEBUG_CRIT,(__location__ " Bad record size %u in recdb\n",
+				 (unsigned)existing.dsize));
+			free(existing.dptr);
+			return -1;
+		}
+		header = *(struct ctdb_ltdb_header *)existing.dptr;
+		free(existing.dptr);
+		if (!(header.rsn < hdr->rsn ||
+		      (header.dmaster != ctdb->recovery_master && header.rsn == hdr->rsn))) {
+			return 0;
+		}
+	}
+
+	if (tdb_store(recdb->tdb, key, data, TDB_REPLACE) != 0) {
+		DEBUG(DEBUG_CRIT,(__location__ " Failed to store record\n"));
+		return -1;
+	}
+
+	return 0;
+}
+
 /*
   pull the remote database contents from one node into the recdb
  */
@@ -651,54 +695,278 @@ static int pull_one_remote_database(struct ctdb_context *ctdb, uint32_t srcnode,
 	     i<reply->count;
 	     rec = (struct ctdb_rec_data *)(rec->length + (uint8_t *)rec), i++) {
 		TDB_DATA key, data;
-		struct ctdb_ltdb_header *hdr;
-		TDB_DATA existing;
 		
 		key.dptr = &rec->data[0];
 		key.dsize = rec->keylen;
 		data.dptr = &rec->data[key.dsize];
 		data.dsize = rec->datalen;
-		
-		hdr = (struct ctdb_ltdb_header *)data.dptr;
 
-		if (data.dsize < sizeof(struct ctdb_ltdb_header)) {
-			DEBUG(DEBUG_CRIT,(__location__ " bad ltdb record\n"));
+		if (recdb_merge_record(ctdb, recdb, key, data) != 0) {
 			talloc_free(tmp_ctx);
 			return -1;
 		}
+	}
 
-		/* fetch the existing record, if any */
-		existing = tdb_fetch(recdb->tdb, key);
-		
-		if (existing.dptr != NULL) {
-			struct ctdb_ltdb_header header;
-			if (existing.dsize < sizeof(struct ctdb_ltdb_header)) {
-				DEBUG(DEBUG_CRIT,(__location__ " Bad record size %u from node %u\n", 
-					 (unsigned)existing.dsize, srcnode));
-				free(existing.dptr);
-				talloc_free(tmp_ctx);
-				return -1;
-			}
-			header = *(struct ctdb_ltdb_header *)existing.dptr;
-			free(existing.dptr);
-			if (!(header.rsn < hdr->rsn ||
-			      (header.dmaster != ctdb->recovery_master && header.rsn == hdr->rsn))) {
-				continue;
-			}
+	talloc_free(tmp_ctx);
+
+	return 0;
+}
+
+/*
+  srvid used to stream the records of one database during one recovery
+ */
+static uint64_t recovery_srvid(uint32_t dbid, uint32_t generation, bool push)
+{
+	return CTDB_SRVID_RECOVERY_RANGE |
+		((uint64_t)(generation & 0x7fffff) << 33) |
+		((uint64_t)(push ? 1 : 0) << 32) |
+		(uint64_t)dbid;
+}
+
+/*
+  pull the database contents from a set of nodes at the same time.
+
+  The nodes send their records in batches of at most
+  RecBufferSizeLimit bytes as messages, each batch is merged into the
+  recdb as it arrives. The DB_PULL reply carries the number of records
+  a node has sent, we are done once that many records have arrived.
+ */
+struct pull_stream_state {
+	struct ctdb_context *ctdb;
+	struct ctdb_recoverd *rec;
+	struct ctdb_node_map *nodemap;
+	struct tdb_wrap *recdb;
+	struct client_async_data *async;
+	uint32_t dbid;
+	uint64_t srvid;
+	uint32_t num_expected;
+	uint32_t num_received;
+	bool failed;
+	bool timed_out;
+};
+
+static void pull_stream_msg_handler(struct ctdb_context *ctdb, uint64_t srvid,
+				    TDB_DATA data, void *private_data)
+{
+	struct pull_stream_state *state = talloc_get_type(
+		private_data, struct pull_stream_state);
+	struct ctdb_marshall_buffer *recs;
+	struct ctdb_rec_data *r;
+	int i;
+
+	if (state->failed) {
+		return;
+	}
+
+	recs = (struct ctdb_marshall_buffer *)data.dptr;
+	if (!ctdb_marshall_buf_valid(data) || recs->db_id != state->dbid) {
+		DEBUG(DEBUG_ERR, (__location__ " invalid records in pull of "
+				  "db 0x%08x\n", state->dbid));
+		state->failed = true;
+		return;
+	}
+
+	r = NULL;
+	for (i=0; i<recs->count; i++) {
+		TDB_DATA key, rec_data;
+
+		r = ctdb_marshall_loop_next(recs, r, NULL, NULL,
+					    &key, &rec_data);
+		if (recdb_merge_record(ctdb, state->recdb, key,
+				       rec_data) != 0) {
+			state->failed = true;
+			return;
 		}
-		
-		if (tdb_store(recdb->tdb, key, data, TDB_REPLACE) != 0) {
-			DEBUG(DEBUG_CRIT,(__location__ " Failed to store record\n"));
-			talloc_free(tmp_ctx);
-			return -1;				
+	}
+
+	state->num_received += recs->count;
+}
+
+static void pull_stream_timeout(struct event_context *ev,
+				struct timed_event *te,
+				struct timeval t, void *private_data)
+{
+	struct pull_stream_state *state = talloc_get_type(
+		private_data, struct pull_stream_state);
+
+	state->timed_out = true;
+}
+
+static void pull_stream_cb(struct ctdb_context *ctdb, uint32_t node_pnn,
+			   int32_t res, TDB_DATA outdata, void *callback_data)
+{
+	struct pull_stream_state *state = talloc_get_type(
+		callback_data, struct pull_stream_state);
+
+	if (outdata.dsize != sizeof(uint32_t)) {
+		DEBUG(DEBUG_ERR, ("Invalid DB_PULL reply from node %u\n",
+				  node_pnn));
+		ctdb_set_culprit_count(state->rec, node_pnn,
+				       state->nodemap->num);
+		state->failed = true;
+		return;
+	}
+
+	state->num_expected += *(uint32_t *)outdata.dptr;
+
+	/*
+	 * Batches from the local node and batches still in flight on the
+	 * unix socket may arrive after the last control reply
+	 */
+	if (state->async->count == 0) {
+		event_add_timed(ctdb->ev, state, CONTROL_TIMEOUT(),
+				pull_stream_timeout, state);
+	}
+}
+
+static void pull_stream_fail_cb(struct ctdb_context *ctdb, uint32_t node_pnn,
+				int32_t res, TDB_DATA outdata,
+				void *callback_data)
+{
+	struct pull_stream_state *state = talloc_get_type(
+		callback_data, struct pull_stream_state);
+
+	DEBUG(DEBUG_ERR, ("Failed to pull db 0x%08x from node %u\n",
+			  state->dbid, node_pnn));
+	ctdb_set_culprit_count(state->rec, node_pnn, state->nodemap->num);
+	state->failed = true;
+}
+
+/*
+  start pulling a database from a set of nodes without waiting for the
+  records to arrive
+ */
+static struct pull_stream_state *pull_stream_send(struct ctdb_context *ctdb,
+						  struct ctdb_recoverd *rec,
+						  struct ctdb_node_map *nodemap,
+						  uint32_t *nodes,
+						  struct tdb_wrap *recdb,
+						  uint32_t dbid,
+						  uint32_t generation)
+{
+	struct pull_stream_state *state;
+	struct ctdb_control_pulldb_ext pulldb_ext;
+	struct ctdb_client_control_state *cstate;
+	struct timeval timeout;
+	TDB_DATA data;
+	uint32_t i, num_nodes;
+	int ret;
+
+	state = talloc_zero(recdb, struct pull_stream_state);
+	if (state == NULL) {
+		DEBUG(DEBUG_ERR, (__location__ " Out of memory\n"));
+		return NULL;
+	}
+	state->ctdb = ctdb;
+	state->rec = rec;
+	state->nodemap = nodemap;
+	state->recdb = recdb;
+	state->dbid = dbid;
+	state->srvid = recovery_srvid(dbid, generation, false);
+
+	state->async = talloc_zero(state, struct client_async_data);
+	if (state->async == NULL) {
+		DEBUG(DEBUG_ERR, (__location__ " Out of memory\n"));
+		talloc_free(state);
+		return NULL;
+	}
+	state->async->opcode = CTDB_CONTROL_DB_PULL;
+	state->async->callback = pull_stream_cb;
+	state->async->fail_callback = pull_stream_fail_cb;
+	state->async->callback_data = state;
+
+	ret = ctdb_client_set_message_handler(ctdb, state->srvid,
+					      pull_stream_msg_handler, state);
+	if (ret != 0) {
+		DEBUG(DEBUG_ERR, (__location__ " Failed to register handler "
+				  "for pull of db 0x%08x\n", dbid));
+		talloc_free(state);
+		return NULL;
+	}
+
+	pulldb_ext.db_id = dbid;
+	pulldb_ext.lmaster = CTDB_LMASTER_ANY;
+	pulldb_ext.srvid = state->srvid;
+
+	data.dptr = (uint8_t *)&pulldb_ext;
+	data.dsize = sizeof(pulldb_ext);
+
+	timeout = CONTROL_TIMEOUT();
+	num_nodes = talloc_array_length(nodes);
+
+	for (i=0; i<num_nodes; i++) {
+		cstate = ctdb_control_send(ctdb, nodes[i], 0,
+					   CTDB_CONTROL_DB_PULL, 0, data,
+					   state->async, &timeout, NULL);
+		if (cstate == NULL) {
+			DEBUG(DEBUG_ERR, (__location__ " Failed to send DB_PULL "
+					  "to node %u\n", nodes[i]));
+			state->failed = true;
+			break;
 		}
+		ctdb_client_async_add(state->async, cstate);
 	}
 
-	talloc_free(tmp_ctx);
+	return state;
+}
+
+static bool pull_stream_done(struct pull_stream_state *state)
+{
+	if (state->async->count > 0) {
+		return false;
+	}
+
+	return (state->failed || state->timed_out ||
+		state->num_received >= state->num_expected);
+}
+
+/*
+  finish a pull once pull_stream_done() returns true, this frees the
+  pull state
+ */
+static int pull_stream_recv(struct pull_stream_state *state)
+{
+	struct ctdb_context *ctdb = state->ctdb;
+	uint32_t dbid = state->dbid;
+
+	ctdb_client_remove_message_handler(ctdb, state->srvid, state);
+
+	if (state->failed || state->num_received != state->num_expected) {
+		DEBUG(DEBUG_ERR, (__location__ " Failed to pull db 0x%08x, "
+				  "received %u of %u records\n", dbid,
+				  state->num_received, state->num_expected));
+		talloc_free(state);
+		return -1;
+	}
+
+	DEBUG(DEBUG_INFO, (__location__ " Pulled %u records for db 0x%08x\n",
+			   state->num_received, dbid));
 
+	talloc_free(state);
 	return 0;
 }
 
+static int pull_stream_database(struct ctdb_context *ctdb,
+				struct ctdb_recoverd *rec,
+				struct ctdb_node_map *nodemap,
+				uint32_t *nodes,
+				struct tdb_wrap *recdb, uint32_t dbid,
+				uint32_t generation)
+{
+	struct pull_stream_state *state;
+
+	state = pull_stream_send(ctdb, rec, nodemap, nodes, recdb, dbid,
+				 generation);
+	if (state == NULL) {
+		return -1;
+	}
+
+	while (!pull_stream_done(state)) {
+		event_loop_once(ctdb->ev);
+	}
+
+	return pull_stream_recv(state);
+}
 
 struct pull_seqnum_cbdata {
 	int failed;
@@ -748,13 +1016,15 @@ static void pull_seqnum_fail_cb(struct ctdb_context *ctdb, uint32_t node_pnn, in
 static int pull_highest_seqnum_pdb(struct ctdb_context *ctdb,
 				struct ctdb_recoverd *rec, 
 				struct ctdb_node_map *nodemap, 
-				struct tdb_wrap *recdb, uint32_t dbid)
+				struct tdb_wrap *recdb, uint32_t dbid,
+				uint32_t generation)
 {
 	TALLOC_CTX *tmp_ctx = talloc_new(NULL);
 	uint32_t *nodes;
 	TDB_DATA data;
 	uint32_t outdata[2];
 	struct pull_seqnum_cbdata *cb_data;
+	int ret;
 
 	DEBUG(DEBUG_NOTICE, ("Scan for highest seqnum pdb for db:0x%08x\n", dbid));
 
@@ -802,7 +1072,20 @@ static int pull_highest_seqnum_pdb(struct ctdb_context *ctdb,
 
 	DEBUG(DEBUG_NOTICE, ("Pull persistent db:0x%08x from node %d with highest seqnum:%lld\n", dbid, cb_data->pnn, (long long)cb_data->seqnum)); 
 
-	if (pull_one_remote_database(ctdb, cb_data->pnn, recdb, dbid) != 0) {
+	if (ctdb->tunable.rec_buffer_size_limit != 0) {
+		nodes = talloc_array(tmp_ctx, uint32_t, 1);
+		if (nodes == NULL) {
+			talloc_free(tmp_ctx);
+			return -1;
+		}
+		nodes[0] = cb_data->pnn;
+		ret = pull_stream_database(ctdb, rec, nodemap, nodes,
+					   recdb, dbid, generation);
+	} else {
+		ret = pull_one_remote_database(ctdb, cb_data->pnn, recdb,
+					       dbid);
+	}
+	if (ret != 0) {
 		DEBUG(DEBUG_ERR, ("Failed to pull higest seqnum database 0x%08x from node %d\n", dbid, cb_data->pnn));
 		talloc_free(tmp_ctx);
 		return -1;
@@ -820,18 +1103,33 @@ static int pull_remote_database(struct ctdb_context *ctdb,
 				struct ctdb_recoverd *rec, 
 				struct ctdb_node_map *nodemap, 
 				struct tdb_wrap *recdb, uint32_t dbid,
-				bool persistent)
+				bool persistent, uint32_t generation)
 {
 	int j;
 
 	if (persistent && ctdb->tunable.recover_pdb_by_seqnum != 0) {
 		int ret;
-		ret = pull_highest_seqnum_pdb(ctdb, rec, nodemap, recdb, dbid);
+		ret = pull_highest_seqnum_pdb(ctdb, rec, nodemap, recdb, dbid,
+					      generation);
 		if (ret == 0) {
 			return 0;
 		}
 	}
 
+	if (ctdb->tunable.rec_buffer_size_limit != 0) {
+		uint32_t *nodes;
+		int ret;
+
+		nodes = list_of_active_nodes(ctdb, nodemap, recdb, true);
+		if (nodes == NULL) {
+			return -1;
+		}
+		ret = pull_stream_database(ctdb, rec, nodemap, nodes,
+					   recdb, dbid, generation);
+		talloc_free(nodes);
+		return ret;
+	}
+
 	/* pull all records from all other nodes across onto this node
 	   (this merges based on rsn)
 	*/
@@ -1264,16 +1562,17 @@ static uint32_t new_generation(void)
 /*
   create a temporary working database
  */
-static struct tdb_wrap *create_recdb(struct ctdb_context *ctdb, TALLOC_CTX *mem_ctx)
+static struct tdb_wrap *create_recdb(struct ctdb_context *ctdb, TALLOC_CTX *mem_ctx,
+				     uint32_t dbid)
 {
 	char *name;
 	struct tdb_wrap *recdb;
 	unsigned tdb_flags;
 
 	/* open up the temporary recovery database */
-	name = talloc_asprintf(mem_ctx, "%s/recdb.tdb.%u",
+	name = talloc_asprintf(mem_ctx, "%s/recdb.%08x.tdb.%u",
 			       ctdb->db_directory_state,
-			       ctdb->pnn);
+			       dbid, ctdb->pnn);
 	if (name == NULL) {
 		return NULL;
 	}
@@ -1289,6 +1588,10 @@ static struct tdb_wrap *create_recdb(struct ctdb_context *ctdb, TALLOC_CTX *mem_
 			      tdb_flags, O_RDWR|O_CREAT|O_EXCL, 0600);
 	if (recdb == NULL) {
 		DEBUG(DEBUG_CRIT,(__location__ " Failed to create temp recovery database '%s'\n", name));
+	} else {
+		/* nobody else opens it, don't leave one file per
+		   database behind in the state directory */
+		unlink(name);
 	}
 
 	talloc_free(name);
@@ -1309,10 +1612,13 @@ struct recdb_data {
 	bool persistent;
 };
 
-static int traverse_recdb(struct tdb_context *tdb, TDB_DATA key, TDB_DATA data, void *p)
+/*
+  prepare a recdb record for pushing it out to the nodes. Returns false
+  if the record is to be skipped.
+ */
+static bool recdb_prepare_record(struct ctdb_context *ctdb, bool persistent,
+				 TDB_DATA data)
 {
-	struct recdb_data *params = (struct recdb_data *)p;
-	struct ctdb_rec_data *rec;
 	struct ctdb_ltdb_header *hdr;
 
 	/*
@@ -1345,17 +1651,29 @@ static int traverse_recdb(struct tdb_context *tdb, TDB_DATA key, TDB_DATA data,
 	 * On databases like Samba's registry, this can damage the higher-level
 	 * data structures built from the various tdb-level records.
 	 */
-	if (!params->persistent && data.dsize <= sizeof(struct ctdb_ltdb_header)) {
-		return 0;
+	if (!persistent && data.dsize <= sizeof(struct ctdb_ltdb_header)) {
+		return false;
 	}
 
 	/* update the dmaster field to point to us */
 	hdr = (struct ctdb_ltdb_header *)data.dptr;
-	if (!params->persistent) {
-		hdr->dmaster = params->ctdb->pnn;
+	if (!persistent) {
+		hdr->dmaster = ctdb->pnn;
 		hdr->flags |= CTDB_REC_FLAG_MIGRATED_WITH_DATA;
 	}
 
+	return true;
+}
+
+static int traverse_recdb(struct tdb_context *tdb, TDB_DATA key, TDB_DATA data, void *p)
+{
+	struct recdb_data *params = (struct recdb_data *)p;
+	struct ctdb_rec_data *rec;
+
+	if (!recdb_prepare_record(params->ctdb, params->persistent, data)) {
+		return 0;
+	}
+
 	/* add the record to the blob ready to send to the nodes */
 	rec = ctdb_marshall_record(params->recdata, 0, key, NULL, data);
 	if (rec == NULL) {
@@ -1450,76 +1768,772 @@ static int push_recdb_database(struct ctdb_context *ctdb, uint32_t dbid,
 
 
 /*
-  go through a full recovery on one database 
+  push the recdb database out to all nodes in batches.
+
+  DB_PUSH_START makes the nodes accept batches of records as messages,
+  the records are stored as they arrive. DB_PUSH_CONFIRM returns the
+  number of records a node has stored.
  */
-static int recover_database(struct ctdb_recoverd *rec, 
-			    TALLOC_CTX *mem_ctx,
-			    uint32_t dbid,
-			    bool persistent,
-			    uint32_t pnn, 
-			    struct ctdb_node_map *nodemap,
-			    uint32_t transaction_id)
+struct push_stream_state {
+	struct ctdb_context *ctdb;
+	uint32_t *nodes;
+	uint32_t num_nodes;
+	uint32_t dbid;
+	uint64_t srvid;
+	bool persistent;
+	struct ctdb_marshall_buffer *recs;
+	uint32_t num_records;
+	bool failed;
+};
+
+static int push_stream_send_batch(struct push_stream_state *state)
 {
-	struct tdb_wrap *recdb;
-	int ret;
-	struct ctdb_context *ctdb = rec->ctdb;
+	struct ctdb_context *ctdb = state->ctdb;
 	TDB_DATA data;
-	struct ctdb_control_wipe_database w;
-	uint32_t *nodes;
+	uint32_t i;
+	int ret;
 
-	recdb = create_recdb(ctdb, mem_ctx);
-	if (recdb == NULL) {
-		return -1;
-	}
+	data = ctdb_marshall_finish(state->recs);
 
-	/* pull all remote databases onto the recdb */
-	ret = pull_remote_database(ctdb, rec, nodemap, recdb, dbid, persistent);
-	if (ret != 0) {
-		DEBUG(DEBUG_ERR, (__location__ " Unable to pull remote database 0x%x\n", dbid));
-		return -1;
+	for (i=0; i<state->num_nodes; i++) {
+		ret = ctdb_client_send_message(ctdb, state->nodes[i],
+					       state->srvid, data);
+		if (ret != 0) {
+			DEBUG(DEBUG_ERR, (__location__ " Failed to push records "
+					  "for db 0x%08x to node %u\n",
+					  state->dbid, state->nodes[i]));
+			return -1;
+		}
 	}
 
-	DEBUG(DEBUG_NOTICE, (__location__ " Recovery - pulled remote database 0x%x\n", dbid));
+	TALLOC_FREE(state->recs);
 
-	/* wipe all the remote databases. This is safe as we are in a transaction */
-	w.db_id = dbid;
-	w.transaction_id = transaction_id;
+	/*
+	 * Don't queue up the whole database for the local daemon, wait
+	 * until the previous batch has been written out.
+	 */
+	while (ctdb_queue_length(ctdb->daemon.queue) > state->num_nodes) {
+		event_loop_once(ctdb->ev);
+	}
 
-	data.dptr = (void *)&w;
-	data.dsize = sizeof(w);
+	return 0;
+}
 
-	nodes = list_of_active_nodes(ctdb, nodemap, recdb, true);
-	if (ctdb_client_async_control(ctdb, CTDB_CONTROL_WIPE_DATABASE,
-					nodes, 0,
-					CONTROL_TIMEOUT(), false, data,
-					NULL, NULL,
-					NULL) != 0) {
-		DEBUG(DEBUG_ERR, (__location__ " Unable to wipe database. Recovery failed.\n"));
-		talloc_free(recdb);
-		return -1;
+static int traverse_recdb_stream(struct tdb_context *tdb, TDB_DATA key,
+				 TDB_DATA data, void *private_data)
+{
+	struct push_stream_state *state = talloc_get_type(
+		private_data, struct push_stream_state);
+	struct ctdb_context *ctdb = state->ctdb;
+
+	if (!recdb_prepare_record(ctdb, state->persistent, data)) {
+		return 0;
 	}
-	
-	/* push out the correct database. This sets the dmaster and skips 
-	   the empty records */
-	ret = push_recdb_database(ctdb, dbid, persistent, recdb, nodemap);
-	if (ret != 0) {
-		talloc_free(recdb);
+
+	state->recs = ctdb_marshall_add(state, state->recs, state->dbid, 0,
+					key, NULL, data);
+	if (state->recs == NULL) {
+		DEBUG(DEBUG_ERR, (__location__ " Failed to marshall record\n"));
+		state->failed = true;
 		return -1;
 	}
+	state->num_records += 1;
 
-	/* all done with this database */
-	talloc_free(recdb);
+	if (talloc_get_size(state->recs) >= ctdb->tunable.rec_buffer_size_limit) {
+		if (push_stream_send_batch(state) != 0) {
+			state->failed = true;
+			return -1;
+		}
+	}
 
 	return 0;
 }
 
-static int ctdb_reload_remote_public_ips(struct ctdb_context *ctdb,
-					 struct ctdb_recoverd *rec,
-					 struct ctdb_node_map *nodemap,
-					 uint32_t *culprit)
+static void push_stream_confirm_cb(struct ctdb_context *ctdb,
+				   uint32_t node_pnn, int32_t res,
+				   TDB_DATA outdata, void *callback_data)
 {
-	int j;
-	int ret;
+	struct push_stream_state *state = talloc_get_type(
+		callback_data, struct push_stream_state);
+	uint32_t num_records;
+
+	if (outdata.dsize != sizeof(uint32_t)) {
+		DEBUG(DEBUG_ERR, ("Invalid DB_PUSH_CONFIRM reply from node "
+				  "%u\n", node_pnn));
+		state->failed = true;
+		return;
+	}
+
+	num_records = *(uint32_t *)outdata.dptr;
+	if (num_records != state->num_records) {
+		DEBUG(DEBUG_ERR, ("Node %u stored %u of %u records for db "
+				  "0x%08x\n", node_pnn, num_records,
+				  state->num_records, state->dbid));
+		state->failed = true;
+	}
+}
+
+static int push_stream_database(struct ctdb_context *ctdb, uint32_t dbid,
+				bool persistent, struct tdb_wrap *recdb,
+				struct ctdb_node_map *nodemap,
+				uint32_t generation)
+{
+	struct push_stream_state *state;
+	struct ctdb_control_pulldb_ext pulldb_ext;
+	TDB_DATA data;
+	int ret;
+
+	state = talloc_zero(recdb, struct push_stream_state);
+	if (state == NULL) {
+		DEBUG(DEBUG_ERR, (__location__ " Out of memory\n"));
+		return -1;
+	}
+	state->ctdb = ctdb;
+	state->dbid = dbid;
+	state->persistent = persistent;
+	state->srvid = recovery_srvid(dbid, generation, true);
+
+	state->nodes = list_of_active_nodes(ctdb, nodemap, state, true);
+	if (state->nodes == NULL) {
+		talloc_free(state);
+		return -1;
+	}
+	state->num_nodes = talloc_array_length(state->nodes);
+
+	pulldb_ext.db_id = dbid;
+	pulldb_ext.lmaster = CTDB_LMASTER_ANY;
+	pulldb_ext.srvid = state->srvid;
+
+	data.dptr = (uint8_t *)&pulldb_ext;
+	data.dsize = sizeof(pulldb_ext);
+
+	if (ctdb_client_async_control(ctdb, CTDB_CONTROL_DB_PUSH_START,
+				      state->nodes, 0,
+				      CONTROL_TIMEOUT(), false, data,
+				      NULL, NULL,
+				      NULL) != 0) {
+		DEBUG(DEBUG_ERR, (__location__ " Failed to start push of db "
+				  "0x%08x\n", dbid));
+		talloc_free(state);
+		return -1;
+	}
+
+	ret = tdb_traverse_read(recdb->tdb, traverse_recdb_stream, state);
+	if (ret == -1 || state->failed) {
+		DEBUG(DEBUG_ERR,(__location__ " Failed to traverse recdb database\n"));
+		talloc_free(state);
+		return -1;
+	}
+
+	if (state->recs != NULL) {
+		if (push_stream_send_batch(state) != 0) {
+			talloc_free(state);
+			return -1;
+		}
+	}
+
+	data.dptr = (uint8_t *)&dbid;
+	data.dsize = sizeof(dbid);
+
+	if (ctdb_client_async_control(ctdb, CTDB_CONTROL_DB_PUSH_CONFIRM,
+				      state->nodes, 0,
+				      CONTROL_TIMEOUT(), false, data,
+				      push_stream_confirm_cb, NULL,
+				      state) != 0 || state->failed) {
+		DEBUG(DEBUG_ERR, (__location__ " Failed to confirm push of "
+				  "db 0x%08x\n", dbid));
+		talloc_free(state);
+		return -1;
+	}
+
+	DEBUG(DEBUG_NOTICE, (__location__ " Recovery - pushed remote database 0x%x of size %u\n", 
+		  dbid, state->num_records));
+
+	talloc_free(state);
+	return 0;
+}
+
+/*
+  go through a full recovery on one database 
+ */
+static int recover_database(struct ctdb_recoverd *rec, 
+			    TALLOC_CTX *mem_ctx,
+			    uint32_t dbid,
+			    bool persistent,
+			    uint32_t pnn, 
+			    struct ctdb_node_map *nodemap,
+			    uint32_t transaction_id)
+{
+	struct tdb_wrap *recdb;
+	int ret;
+	struct ctdb_context *ctdb = rec->ctdb;
+	TDB_DATA data;
+	struct ctdb_control_wipe_database w;
+	uint32_t *nodes;
+
+	recdb = create_recdb(ctdb, mem_ctx, dbid);
+	if (recdb == NULL) {
+		return -1;
+	}
+
+	/* pull all remote databases onto the recdb */
+	ret = pull_remote_database(ctdb, rec, nodemap, recdb, dbid, persistent,
+				   transaction_id);
+	if (ret != 0) {
+		DEBUG(DEBUG_ERR, (__location__ " Unable to pull remote database 0x%x\n", dbid));
+		return -1;
+	}
+
+	DEBUG(DEBUG_NOTICE, (__location__ " Recovery - pulled remote database 0x%x\n", dbid));
+
+	/* wipe all the remote databases. This is safe as we are in a transaction */
+	w.db_id = dbid;
+	w.transaction_id = transaction_id;
+
+	data.dptr = (void *)&w;
+	data.dsize = sizeof(w);
+
+	nodes = list_of_active_nodes(ctdb, nodemap, recdb, true);
+	if (ctdb_client_async_control(ctdb, CTDB_CONTROL_WIPE_DATABASE,
+					nodes, 0,
+					CONTROL_TIMEOUT(), false, data,
+					NULL, NULL,
+					NULL) != 0) {
+		DEBUG(DEBUG_ERR, (__location__ " Unable to wipe database. Recovery failed.\n"));
+		talloc_free(recdb);
+		return -1;
+	}
+	
+	/* push out the correct database. This sets the dmaster and skips 
+	   the empty records */
+	if (ctdb->tunable.rec_buffer_size_limit != 0) {
+		ret = push_stream_database(ctdb, dbid, persistent, recdb,
+					   nodemap, transaction_id);
+	} else {
+		ret = push_recdb_database(ctdb, dbid, persistent, recdb,
+					  nodemap);
+	}
+	if (ret != 0) {
+		talloc_free(recdb);
+		return -1;
+	}
+
+	/* all done with this database */
+	talloc_free(recdb);
+
+	return 0;
+}
+
+/*
+  freeze all databases on all nodes, each database on its own.
+
+  Databases are frozen in order of their priority, the same way
+  set_recovery_mode() freezes the priorities. All databases of one
+  priority are frozen at the same time, the freezes of the next
+  priority start only when they are done. Otherwise a freeze of a
+  database could deadlock with a client that holds a lock of a lower
+  priority database and waits for the higher one.
+ */
+static int freeze_databases(struct ctdb_recoverd *rec,
+			    struct ctdb_node_map *nodemap,
+			    struct ctdb_dbid_map *dbmap)
+{
+	struct ctdb_context *ctdb = rec->ctdb;
+	TALLOC_CTX *tmp_ctx;
+	struct client_async_data *async_data;
+	struct ctdb_client_control_state *state;
+	struct timeval timeout;
+	uint32_t *nodes, *priorities;
+	uint32_t j, num_nodes, prio;
+	TDB_DATA data;
+	int i, ret;
+
+	tmp_ctx = talloc_new(ctdb);
+	CTDB_NO_MEMORY(ctdb, tmp_ctx);
+
+	priorities = talloc_array(tmp_ctx, uint32_t, dbmap->num);
+	if (priorities == NULL) {
+		talloc_free(tmp_ctx);
+		return -1;
+	}
+
+	/* update_db_priority_on_remote_nodes() has pushed our
+	   priorities to all nodes */
+	for (i=0; i<dbmap->num; i++) {
+		ret = ctdb_ctrl_get_db_priority(ctdb, CONTROL_TIMEOUT(),
+						CTDB_CURRENT_NODE,
+						dbmap->dbs[i].dbid,
+						&priorities[i]);
+		if (ret != 0) {
+			DEBUG(DEBUG_ERR, (__location__ " Failed to read "
+					  "priority of db 0x%08x\n",
+					  dbmap->dbs[i].dbid));
+			talloc_free(tmp_ctx);
+			return -1;
+		}
+	}
+
+	nodes = list_of_active_nodes(ctdb, nodemap, tmp_ctx, true);
+	num_nodes = talloc_array_length(nodes);
+
+	for (prio=1; prio<=NUM_DB_PRIORITIES; prio++) {
+		async_data = talloc_zero(tmp_ctx, struct client_async_data);
+		if (async_data == NULL) {
+			talloc_free(tmp_ctx);
+			return -1;
+		}
+		async_data->opcode = CTDB_CONTROL_DB_FREEZE;
+		async_data->fail_callback = set_recmode_fail_callback;
+		async_data->callback_data = rec;
+
+		timeout = CONTROL_TIMEOUT();
+
+		for (i=0; i<dbmap->num; i++) {
+			if (priorities[i] != prio) {
+				continue;
+			}
+
+			data.dptr = (uint8_t *)&dbmap->dbs[i].dbid;
+			data.dsize = sizeof(uint32_t);
+
+			for (j=0; j<num_nodes; j++) {
+				state = ctdb_control_send(ctdb, nodes[j], 0,
+							  CTDB_CONTROL_DB_FREEZE,
+							  0, data, async_data,
+							  &timeout, NULL);
+				if (state == NULL) {
+					DEBUG(DEBUG_ERR, (__location__ " Failed "
+							  "to send DB_FREEZE to "
+							  "node %u\n", nodes[j]));
+					async_data->fail_count++;
+					break;
+				}
+				ctdb_client_async_add(async_data, state);
+			}
+		}
+
+		ret = ctdb_client_async_wait(ctdb, async_data);
+		if (ret != 0) {
+			DEBUG(DEBUG_ERR, (__location__ " Unable to freeze "
+					  "databases of priority %u. "
+					  "Recovery failed.\n", prio));
+			talloc_free(tmp_ctx);
+			return -1;
+		}
+		talloc_free(async_data);
+	}
+
+	talloc_free(tmp_ctx);
+	return 0;
+}
+
+/*
+  recover databases in parallel.
+
+  All databases are frozen and the new vnnmap is in place. Up to
+  ParallelRecoveryDBs databases are recovered at the same time, each
+  one moving through the phases below as the controls of the previous
+  phase complete. A database is thawed as soon as it has been committed
+  on all nodes, so clients can use it while other databases are still
+  being recovered.
+ */
+enum db_recovery_phase {
+	DB_RECOVERY_INIT,
+	DB_RECOVERY_TRANSACTION_START,
+	DB_RECOVERY_SEQNUM,
+	DB_RECOVERY_PULL,
+	DB_RECOVERY_WIPE,
+	DB_RECOVERY_COMMIT,
+	DB_RECOVERY_THAW,
+	DB_RECOVERY_DONE,
+};
+
+struct db_recovery_state {
+	struct ctdb_recoverd *rec;
+	struct ctdb_node_map *nodemap;
+	uint32_t *nodes;
+	uint32_t dbid;
+	bool persistent;
+	uint32_t generation;
+	enum db_recovery_phase phase;
+	struct client_async_data *async;
+	struct pull_seqnum_cbdata *seqnum;
+	struct pull_stream_state *pull;
+	struct tdb_wrap *recdb;
+	struct timeval start_time;
+	bool failed;
+};
+
+/*
+  send a control for the current phase to a set of nodes, without
+  waiting for the replies
+ */
+static bool db_recovery_control_send(struct db_recovery_state *state,
+				     enum ctdb_controls opcode,
+				     uint32_t *nodes, TDB_DATA data,
+				     client_async_callback callback,
+				     client_async_callback fail_callback,
+				     void *callback_data)
+{
+	struct ctdb_context *ctdb = state->rec->ctdb;
+	struct ctdb_client_control_state *cstate;
+	struct timeval timeout;
+	uint32_t i, num_nodes;
+
+	TALLOC_FREE(state->async);
+
+	state->async = talloc_zero(state, struct client_async_data);
+	if (state->async == NULL) {
+		DEBUG(DEBUG_ERR, (__location__ " Out of memory\n"));
+		return false;
+	}
+	state->async->opcode = opcode;
+	state->async->callback = callback;
+	state->async->fail_callback = fail_callback;
+	state->async->callback_data = callback_data;
+
+	timeout = CONTROL_TIMEOUT();
+	num_nodes = talloc_array_length(nodes);
+
+	for (i=0; i<num_nodes; i++) {
+		cstate = ctdb_control_send(ctdb, nodes[i], 0, opcode, 0, data,
+					   state->async, &timeout, NULL);
+		if (cstate == NULL) {
+			DEBUG(DEBUG_ERR, (__location__ " Failed to send "
+					  "control %u to node %u\n",
+					  (unsigned)opcode, nodes[i]));
+			return false;
+		}
+		ctdb_client_async_add(state->async, cstate);
+	}
+
+	return true;
+}
+
+static bool db_recovery_ready(struct db_recovery_state *state)
+{
+	if (state->async != NULL && state->async->count > 0) {
+		return false;
+	}
+
+	if (state->pull != NULL) {
+		return pull_stream_done(state->pull);
+	}
+
+	return true;
+}
+
+static void db_recovery_pull(struct db_recovery_state *state,
+			     uint32_t *nodes)
+{
+	struct ctdb_recoverd *rec = state->rec;
+
+	TALLOC_FREE(state->async);
+
+	state->pull = pull_stream_send(rec->ctdb, rec, state->nodemap, nodes,
+				       state->recdb, state->dbid,
+				       state->generation);
+	if (state->pull == NULL) {
+		state->failed = true;
+		return;
+	}
+
+	state->phase = DB_RECOVERY_PULL;
+}
+
+/*
+  move a database to its next recovery phase, called once the
+  controls of the current phase have completed
+ */
+static void db_recovery_step(struct db_recovery_state *state)
+{
+	struct ctdb_recoverd *rec = state->rec;
+	struct ctdb_context *ctdb = rec->ctdb;
+	struct ctdb_control_transdb t;
+	struct ctdb_control_wipe_database w;
+	uint32_t *nodes;
+	TDB_DATA data;
+	int ret;
+
+	if (state->phase != DB_RECOVERY_SEQNUM &&
+	    state->async != NULL && state->async->fail_count != 0) {
+		state->failed = true;
+	}
+
+	if (state->pull != NULL) {
+		ret = pull_stream_recv(state->pull);
+		state->pull = NULL;
+		if (ret != 0) {
+			state->failed = true;
+		}
+	}
+
+	if (state->failed) {
+		DEBUG(DEBUG_ERR, (__location__ " Failed to recover database "
+				  "0x%08x\n", state->dbid));
+		TALLOC_FREE(state->async);
+		TALLOC_FREE(state->recdb);
+		state->phase = DB_RECOVERY_DONE;
+		return;
+	}
+
+	t.db_id = state->dbid;
+	t.transaction_id = state->generation;
+
+	switch (state->phase) {
+	case DB_RECOVERY_INIT:
+		data.dptr = (uint8_t *)&t;
+		data.dsize = sizeof(t);
+
+		if (!db_recovery_control_send(state,
+					      CTDB_CONTROL_DB_TRANSACTION_START,
+					      state->nodes, data, NULL,
+					      transaction_start_fail_callback,
+					      rec)) {
+			state->failed = true;
+		}
+		state->phase = DB_RECOVERY_TRANSACTION_START;
+		break;
+
+	case DB_RECOVERY_TRANSACTION_START:
+		if (state->persistent &&
+		    ctdb->tunable.recover_pdb_by_seqnum != 0) {
+			uint32_t indata[2] = { state->dbid, 0 };
+
+			state->seqnum = talloc_zero(state,
+						    struct pull_seqnum_cbdata);
+			if (state->seqnum == NULL) {
+				state->failed = true;
+				break;
+			}
+			state->seqnum->pnn = -1;
+
+			data.dptr = (uint8_t *)indata;
+			data.dsize = sizeof(indata);
+
+			if (!db_recovery_control_send(state,
+						      CTDB_CONTROL_GET_DB_SEQNUM,
+						      state->nodes, data,
+						      pull_seqnum_cb,
+						      pull_seqnum_fail_cb,
+						      state->seqnum)) {
+				state->failed = true;
+			}
+			state->phase = DB_RECOVERY_SEQNUM;
+			break;
+		}
+
+		db_recovery_pull(state, state->nodes);
+		break;
+
+	case DB_RECOVERY_SEQNUM:
+		nodes = state->nodes;
+		if (state->seqnum->failed == 0 && state->seqnum->pnn != -1) {
+			DEBUG(DEBUG_NOTICE, ("Pull persistent db:0x%08x from "
+					     "node %d with highest seqnum:%lld\n",
+					     state->dbid, state->seqnum->pnn,
+					     (long long)state->seqnum->seqnum));
+			nodes = talloc_array(state, uint32_t, 1);
+			if (nodes == NULL) {
+				state->failed = true;
+				break;
+			}
+			nodes[0] = state->seqnum->pnn;
+		} else {
+			DEBUG(DEBUG_NOTICE, ("Failed to find the node with "
+					     "the highest seqnum for db "
+					     "0x%08x, pulling from all "
+					     "nodes\n", state->dbid));
+		}
+		TALLOC_FREE(state->seqnum);
+
+		db_recovery_pull(state, nodes);
+		break;
+
+	case DB_RECOVERY_PULL:
+		DEBUG(DEBUG_NOTICE, (__location__ " Recovery - pulled remote "
+				     "database 0x%x\n", state->dbid));
+
+		/* wipe all the remote databases. This is safe as we
+		   are in a transaction */
+		w.db_id = state->dbid;
+		w.transaction_id = state->generation;
+
+		data.dptr = (uint8_t *)&w;
+		data.dsize = sizeof(w);
+
+		if (!db_recovery_control_send(state,
+					      CTDB_CONTROL_WIPE_DATABASE,
+					      state->nodes, data,
+					      NULL, NULL, NULL)) {
+			state->failed = true;
+		}
+		state->phase = DB_RECOVERY_WIPE;
+		break;
+
+	case DB_RECOVERY_WIPE:
+		/* push out the correct database. While this runs,
+		   the controls and records of other databases are
+		   processed from the nested event loop */
+		ret = push_stream_database(ctdb, state->dbid,
+					   state->persistent, state->recdb,
+					   state->nodemap, state->generation);
+		TALLOC_FREE(state->recdb);
+		if (ret != 0) {
+			state->failed = true;
+			break;
+		}
+
+		data.dptr = (uint8_t *)&t;
+		data.dsize = sizeof(t);
+
+		if (!db_recovery_control_send(state,
+					      CTDB_CONTROL_DB_TRANSACTION_COMMIT,
+					      state->nodes, data,
+					      NULL, NULL, NULL)) {
+			state->failed = true;
+		}
+		state->phase = DB_RECOVERY_COMMIT;
+		break;
+
+	case DB_RECOVERY_COMMIT:
+		data.dptr = (uint8_t *)&state->dbid;
+		data.dsize = sizeof(uint32_t);
+
+		if (!db_recovery_control_send(state, CTDB_CONTROL_DB_THAW,
+					      state->nodes, data,
+					      NULL, NULL, NULL)) {
+			state->failed = true;
+		}
+		state->phase = DB_RECOVERY_THAW;
+		break;
+
+	case DB_RECOVERY_THAW:
+		DEBUG(DEBUG_NOTICE, (__location__ " Recovery - recovered "
+				     "database 0x%08x in %.3f seconds\n",
+				     state->dbid,
+				     timeval_elapsed(&state->start_time)));
+		TALLOC_FREE(state->async);
+		state->phase = DB_RECOVERY_DONE;
+		break;
+
+	case DB_RECOVERY_DONE:
+		break;
+	}
+}
+
+static int recover_databases_parallel(struct ctdb_recoverd *rec,
+				      TALLOC_CTX *mem_ctx,
+				      struct ctdb_node_map *nodemap,
+				      struct ctdb_dbid_map *dbmap,
+				      uint32_t generation)
+{
+	struct ctdb_context *ctdb = rec->ctdb;
+	struct db_recovery_state **states;
+	uint32_t *nodes;
+	uint32_t max_active = ctdb->tunable.parallel_recovery_dbs;
+	uint32_t num_active = 0;
+	int i, pass, num_states = 0, next = 0;
+	bool failed = false;
+
+	states = talloc_zero_array(mem_ctx, struct db_recovery_state *,
+				   dbmap->num);
+	CTDB_NO_MEMORY(ctdb, states);
+
+	nodes = list_of_active_nodes(ctdb, nodemap, states, true);
+
+	/* persistent databases are usually small and clients need
+	   them first, recover them before the volatile ones */
+	for (pass=0; pass<2; pass++) {
+		for (i=0; i<dbmap->num; i++) {
+			struct db_recovery_state *state;
+			bool persistent;
+
+			persistent = (dbmap->dbs[i].flags &
+				      CTDB_DB_FLAGS_PERSISTENT);
+			if (persistent != (pass == 0)) {
+				continue;
+			}
+
+			state = talloc_zero(states, struct db_recovery_state);
+			CTDB_NO_MEMORY(ctdb, state);
+			state->dbid = dbmap->dbs[i].dbid;
+			state->persistent = persistent;
+			states[num_states++] = state;
+		}
+	}
+
+	while (true) {
+		bool progress = false;
+
+		/* start recovering more databases */
+		while (!failed && num_active < max_active &&
+		       next < num_states) {
+			struct db_recovery_state *state = states[next++];
+
+			state->rec = rec;
+			state->nodemap = nodemap;
+			state->nodes = nodes;
+			state->generation = generation;
+			state->phase = DB_RECOVERY_INIT;
+			state->start_time = timeval_current();
+
+			state->recdb = create_recdb(ctdb, state, state->dbid);
+			if (state->recdb == NULL) {
+				state->failed = true;
+			}
+			num_active++;
+		}
+
+		if (num_active == 0) {
+			break;
+		}
+
+		for (i=0; i<next; i++) {
+			struct db_recovery_state *state = states[i];
+
+			if (state->phase == DB_RECOVERY_DONE ||
+			    !db_recovery_ready(state)) {
+				continue;
+			}
+
+			db_recovery_step(state);
+			progress = true;
+
+			if (state->phase == DB_RECOVERY_DONE) {
+				num_active--;
+				if (state->failed) {
+					/* let the databases already in
+					   progress finish */
+					failed = true;
+				}
+			}
+		}
+
+		if (!progress) {
+			event_loop_once(ctdb->ev);
+		}
+	}
+
+	talloc_free(states);
+
+	if (failed) {
+		return -1;
+	}
+
+	DEBUG(DEBUG_NOTICE, (__location__ " Recovery - recovered %u "
+			     "databases, %u at a time\n",
+			     dbmap->num, max_active));
+	return 0;
+}
+
+static int ctdb_reload_remote_public_ips(struct ctdb_context *ctdb,
+					 struct ctdb_recoverd *rec,
+					 struct ctdb_node_map *nodemap,
+					 uint32_t *culprit)
+{
+	int j;
+	int ret;
 
 	if (ctdb->num_nodes != nodemap->num) {
 		DEBUG(DEBUG_ERR, (__location__ " ctdb->num_nodes (%d) != nodemap->num (%d) invalid param\n",
@@ -1790,6 +2804,7 @@ static int do_recovery(struct ctdb_recoverd *rec,
 	struct timeval start_time;
 	uint32_t culprit = (uint32_t)-1;
 	bool self_ban;
+	bool parallel;
 
 	DEBUG(DEBUG_NOTICE, (__location__ " Starting do_recovery\n"));
 
@@ -1872,8 +2887,15 @@ static int do_recovery(struct ctdb_recoverd *rec,
 	*/
 	sync_recovery_lock_file_across_cluster(rec);
 
+	/* Databases are frozen and recovered one by one, each of them
+	   is thawed as soon as it has been recovered. This needs the
+	   streaming pull and push. */
+	parallel = (ctdb->tunable.parallel_recovery_dbs != 0 &&
+		    ctdb->tunable.rec_buffer_size_limit != 0);
+
 	/* set recovery mode to active on all nodes */
-	ret = set_recovery_mode(ctdb, rec, nodemap, CTDB_RECOVERY_ACTIVE);
+	ret = set_recovery_mode(ctdb, rec, nodemap, CTDB_RECOVERY_ACTIVE,
+				!parallel);
 	if (ret != 0) {
 		DEBUG(DEBUG_ERR, (__location__ " Unable to set recovery mode to active on cluster\n"));
 		return -1;
@@ -1907,75 +2929,84 @@ static int do_recovery(struct ctdb_recoverd *rec,
 
 	DEBUG(DEBUG_NOTICE, (__location__ " Recovery - updated flags\n"));
 
-	/* pick a new generation number */
-	generation = new_generation();
+	if (parallel) {
+		/* freeze all databases before the vnnmap changes */
+		ret = freeze_databases(rec, nodemap, dbmap);
+		if (ret != 0) {
+			return -1;
+		}
 
-	/* change the vnnmap on this node to use the new generation 
-	   number but not on any other nodes.
-	   this guarantees that if we abort the recovery prematurely
-	   for some reason (a node stops responding?)
-	   that we can just return immediately and we will reenter
-	   recovery shortly again.
-	   I.e. we deliberately leave the cluster with an inconsistent
-	   generation id to allow us to abort recovery at any stage and
-	   just restart it from scratch.
-	 */
-	vnnmap->generation = generation;
-	ret = ctdb_ctrl_setvnnmap(ctdb, CONTROL_TIMEOUT(), pnn, mem_ctx, vnnmap);
-	if (ret != 0) {
-		DEBUG(DEBUG_ERR, (__location__ " Unable to set vnnmap for node %u\n", pnn));
-		return -1;
-	}
+		DEBUG(DEBUG_NOTICE, (__location__ " Recovery - froze databases\n"));
+	} else {
+		/* pick a new generation number */
+		generation = new_generation();
+
+		/* change the vnnmap on this node to use the new generation 
+		   number but not on any other nodes.
+		   this guarantees that if we abort the recovery prematurely
+		   for some reason (a node stops responding?)
+		   that we can just return immediately and we will reenter
+		   recovery shortly again.
+		   I.e. we deliberately leave the cluster with an inconsistent
+		   generation id to allow us to abort recovery at any stage and
+		   just restart it from scratch.
+		 */
+		vnnmap->generation = generation;
+		ret = ctdb_ctrl_setvnnmap(ctdb, CONTROL_TIMEOUT(), pnn, mem_ctx, vnnmap);
+		if (ret != 0) {
+			DEBUG(DEBUG_ERR, (__location__ " Unable to set vnnmap for node %u\n", pnn));
+			return -1;
+		}
 
-	data.dptr = (void *)&generation;
-	data.dsize = sizeof(uint32_t);
+		data.dptr = (void *)&generation;
+		data.dsize = sizeof(uint32_t);
 
-	nodes = list_of_active_nodes(ctdb, nodemap, mem_ctx, true);
-	if (ctdb_client_async_control(ctdb, CTDB_CONTROL_TRANSACTION_START,
-					nodes, 0,
-					CONTROL_TIMEOUT(), false, data,
-					NULL,
-					transaction_start_fail_callback,
-					rec) != 0) {
-		DEBUG(DEBUG_ERR, (__location__ " Unable to start transactions. Recovery failed.\n"));
-		if (ctdb_client_async_control(ctdb, CTDB_CONTROL_TRANSACTION_CANCEL,
-					nodes, 0,
-					CONTROL_TIMEOUT(), false, tdb_null,
-					NULL,
-					NULL,
-					NULL) != 0) {
-			DEBUG(DEBUG_ERR,("Failed to cancel recovery transaction\n"));
+		nodes = list_of_active_nodes(ctdb, nodemap, mem_ctx, true);
+		if (ctdb_client_async_control(ctdb, CTDB_CONTROL_TRANSACTION_START,
+						nodes, 0,
+						CONTROL_TIMEOUT(), false, data,
+						NULL,
+						transaction_start_fail_callback,
+						rec) != 0) {
+			DEBUG(DEBUG_ERR, (__location__ " Unable to start transactions. Recovery failed.\n"));
+			if (ctdb_client_async_control(ctdb, CTDB_CONTROL_TRANSACTION_CANCEL,
+						nodes, 0,
+						CONTROL_TIMEOUT(), false, tdb_null,
+						NULL,
+						NULL,
+						NULL) != 0) {
+				DEBUG(DEBUG_ERR,("Failed to cancel recovery transaction\n"));
+			}
+			return -1;
 		}
-		return -1;
-	}
 
-	DEBUG(DEBUG_NOTICE,(__location__ " started transactions on all nodes\n"));
+		DEBUG(DEBUG_NOTICE,(__location__ " started transactions on all nodes\n"));
 
-	for (i=0;i<dbmap->num;i++) {
-		ret = recover_database(rec, mem_ctx,
-				       dbmap->dbs[i].dbid,
-				       dbmap->dbs[i].flags & CTDB_DB_FLAGS_PERSISTENT,
-				       pnn, nodemap, generation);
-		if (ret != 0) {
-			DEBUG(DEBUG_ERR, (__location__ " Failed to recover database 0x%x\n", dbmap->dbs[i].dbid));
-			return -1;
+		for (i=0;i<dbmap->num;i++) {
+			ret = recover_database(rec, mem_ctx,
+					       dbmap->dbs[i].dbid,
+					       dbmap->dbs[i].flags & CTDB_DB_FLAGS_PERSISTENT,
+					       pnn, nodemap, generation);
+			if (ret != 0) {
+				DEBUG(DEBUG_ERR, (__location__ " Failed to recover database 0x%x\n", dbmap->dbs[i].dbid));
+				return -1;
+			}
 		}
-	}
 
-	DEBUG(DEBUG_NOTICE, (__location__ " Recovery - starting database commits\n"));
+		DEBUG(DEBUG_NOTICE, (__location__ " Recovery - starting database commits\n"));
 
-	/* commit all the changes */
-	if (ctdb_client_async_control(ctdb, CTDB_CONTROL_TRANSACTION_COMMIT,
-					nodes, 0,
-					CONTROL_TIMEOUT(), false, data,
-					NULL, NULL,
-					NULL) != 0) {
-		DEBUG(DEBUG_ERR, (__location__ " Unable to commit recovery changes. Recovery failed.\n"));
-		return -1;
-	}
+		/* commit all the changes */
+		if (ctdb_client_async_control(ctdb, CTDB_CONTROL_TRANSACTION_COMMIT,
+						nodes, 0,
+						CONTROL_TIMEOUT(), false, data,
+						NULL, NULL,
+						NULL) != 0) {
+			DEBUG(DEBUG_ERR, (__location__ " Unable to commit recovery changes. Recovery failed.\n"));
+			return -1;
+		}
 
-	DEBUG(DEBUG_NOTICE, (__location__ " Recovery - committed databases\n"));
-	
+		DEBUG(DEBUG_NOTICE, (__location__ " Recovery - committed databases\n"));
+	}
 
 	/* update the capabilities for all nodes */
 	ret = update_capabilities(ctdb, nodemap);
@@ -2026,6 +3057,15 @@ static int do_recovery(struct ctdb_recoverd *rec,
 
 	DEBUG(DEBUG_NOTICE, (__location__ " Recovery - updated vnnmap\n"));
 
+	if (parallel) {
+		ret = recover_databases_parallel(rec, mem_ctx, nodemap, dbmap,
+						 vnnmap->generation);
+		if (ret != 0) {
+			DEBUG(DEBUG_ERR, (__location__ " Failed to recover databases\n"));
+			return -1;
+		}
+	}
+
 	/* update recmaster to point to us for all nodes */
 	ret = set_recovery_master(ctdb, nodemap, pnn);
 	if (ret!=0) {
@@ -2036,7 +3076,7 @@ static int do_recovery(struct ctdb_recoverd *rec,
 	DEBUG(DEBUG_NOTICE, (__location__ " Recovery - updated recmaster\n"));
 
 	/* disable recovery mode */
-	ret = set_recovery_mode(ctdb, rec, nodemap, CTDB_RECOVERY_NORMAL);
+	ret = set_recovery_mode(ctdb, rec, nodemap, CTDB_RECOVERY_NORMAL, false);
 	if (ret != 0) {
 		DEBUG(DEBUG_ERR, (__location__ " Unable to set recovery mode to normal on cluster\n"));
 		return -1;
@@ -2720,7 +3760,7 @@ static void force_election(struct ctdb_recoverd *rec, uint32_t pnn,
 	DEBUG(DEBUG_INFO,(__location__ " Force an election\n"));
 
 	/* set all nodes to recovery mode to stop all internode traffic */
-	ret = set_recovery_mode(ctdb, rec, nodemap, CTDB_RECOVERY_ACTIVE);
+	ret = set_recovery_mode(ctdb, rec, nodemap, CTDB_RECOVERY_ACTIVE, true);
 	if (ret != 0) {
 		DEBUG(DEBUG_ERR, (__location__ " Unable to set recovery mode to active on cluster\n"));
 		return;
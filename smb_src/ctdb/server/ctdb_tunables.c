@@ -84,6 +84,12 @@ static const struct {
 	{ "Samba3AvoidDeadlocks", 0, offsetof(struct ctdb_tunable, samba3_hack), false },
 	{ "TDBMutexEnabled", 0, offsetof(struct ctdb_tunable, mutex_enabled), false },
 	{ "LockProcessesPerDB", 200, offsetof(struct ctdb_tunable, lock_processes_per_db), false },
+	{ "RepackIncremental", 0, offsetof(struct ctdb_tunable, repack_incremental), false },
+	{ "RecBufferSizeLimit", 1000000, offsetof(struct ctdb_tunable, rec_buffer_size_limit), false },
+	{ "ParallelRecoveryDBs", 4, offsetof(struct ctdb_tunable, parallel_recovery_dbs), false },
+	{ "HotRecordInterval", 10, offsetof(struct ctdb_tunable, hot_record_interval), false },
+	{ "HotRecordMigrations", 100, offsetof(struct ctdb_tunable, hot_record_migrations), false },
+	{ "HotRecordReadOnlyRequests", 100, offsetof(struct ctdb_tunable, hot_record_ro_requests), false },
 };
 
 /*
@@ -302,17 +302,18 @@ int32_t ctdb_control_update_record(struct ctdb_context *ctdb,
 	struct childwrite_handle *handle;
 	struct ctdb_marshall_buffer *m = (struct ctdb_marshall_buffer *)recdata.dptr;
 
-	if (ctdb->recovery_mode != CTDB_RECOVERY_NORMAL) {
-		DEBUG(DEBUG_INFO,("rejecting ctdb_control_update_record when recovery active\n"));
-		return -1;
-	}
-
 	ctdb_db = find_ctdb_db(ctdb, m->db_id);
 	if (ctdb_db == NULL) {
 		DEBUG(DEBUG_ERR,("Unknown database 0x%08x in ctdb_control_update_record\n", m->db_id));
 		return -1;
 	}
 
+	if (ctdb->recovery_mode != CTDB_RECOVERY_NORMAL &&
+	    !ctdb_db->recovered) {
+		DEBUG(DEBUG_INFO,("rejecting ctdb_control_update_record when recovery active\n"));
+		return -1;
+	}
+
 	if (ctdb_db->unhealthy_reason) {
 		DEBUG(DEBUG_ERR,("db(%s) unhealty in ctdb_control_update_record: %s\n",
 				 ctdb_db->db_name, ctdb_db->unhealthy_reason));
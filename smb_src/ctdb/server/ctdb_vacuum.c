@@ -1301,6 +1301,34 @@ static int ctdb_vacuum_db(struct ctdb_db_context *ctdb_db,
 	return 0;
 }
 
+/*
+ * repack a db chain by chain, only ever holding a single chain lock
+ */
+static int ctdb_repack_db_incremental(struct ctdb_db_context *ctdb_db)
+{
+	struct tdb_context *tdb = ctdb_db->ltdb->tdb;
+	struct tdb_repack_stats stats;
+	int next = 0;
+
+	ZERO_STRUCT(stats);
+
+	do {
+		next = tdb_repack_chains(tdb, next, 1000, &stats);
+	} while (next > 0);
+
+	if (next == -1) {
+		return -1;
+	}
+
+	DEBUG(DEBUG_INFO, ("Repacked %s: %u chains (%u busy), "
+			   "%u records moved, %u trimmed, %u purged, "
+			   "%llu bytes reclaimed\n", ctdb_db->db_name,
+			   stats.chains, stats.chains_busy, stats.moved,
+			   stats.trimmed, stats.purged,
+			   (unsigned long long)stats.bytes_reclaimed));
+	return 0;
+}
+
 /*
  * repack and vaccum a db
  * called from the child context
@@ -1334,7 +1362,11 @@ static int ctdb_vacuum_and_repack_db(struct ctdb_db_context *ctdb_db,
 	DEBUG(DEBUG_INFO, ("Repacking %s with %u freelist entries\n",
 			   name, freelist_size));
 
-	ret = tdb_repack(ctdb_db->ltdb->tdb);
+	if (ctdb_db->ctdb->tunable.repack_incremental != 0) {
+		ret = ctdb_repack_db_incremental(ctdb_db);
+	} else {
+		ret = tdb_repack(ctdb_db->ltdb->tdb);
+	}
 	if (ret != 0) {
 		DEBUG(DEBUG_ERR,(__location__ " Failed to repack '%s'\n", name));
 		return -1;
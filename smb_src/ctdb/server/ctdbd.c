@@ -51,6 +51,7 @@ static struct {
 	int	    script_log_level;
 	int         no_publicipcheck;
 	int         max_persistent_check_errors;
+	int         transport_threads;
 } options = {
 	.nlist = NULL,
 	.public_address_list = NULL,
@@ -116,6 +117,7 @@ int main(int argc, const char *argv[])
 		{ "notification-script", 0, POPT_ARG_STRING, &options.notification_script, 0, "notification script", "filename" },
 		{ "listen", 0, POPT_ARG_STRING, &options.myaddress, 0, "address to listen on", "address" },
 		{ "transport", 0, POPT_ARG_STRING, &options.transport, 0, "protocol transport", NULL },
+		{ "transport-threads", 0, POPT_ARG_NONE, &options.transport_threads, 0, "write packets to other nodes from separate threads", NULL },
 		{ "dbdir", 0, POPT_ARG_STRING, &options.db_dir, 0, "directory for the tdb files", NULL },
 		{ "dbdir-persistent", 0, POPT_ARG_STRING, &options.db_dir_persistent, 0, "directory for persistent tdb files", NULL },
 		{ "dbdir-state", 0, POPT_ARG_STRING, &options.db_dir_state, 0, "directory for internal state tdb files", NULL },
@@ -302,6 +304,7 @@ int main(int argc, const char *argv[])
 	}
 
 	ctdb->valgrinding = options.valgrinding;
+	ctdb->transport_threads = (options.transport_threads != 0);
 	if (options.valgrinding || options.nosetsched) {
 		ctdb->do_setsched = 0;
 	} else {
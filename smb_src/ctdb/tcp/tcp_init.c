@@ -51,7 +51,15 @@ static int ctdb_tcp_add_node(struct ctdb_node *node)
 
 	tnode->out_queue = ctdb_queue_setup(node->ctdb, node, tnode->fd, CTDB_TCP_ALIGNMENT,
 					    ctdb_tcp_tnode_cb, node, "to-node-%s", node->name);
-	
+	CTDB_NO_MEMORY(node->ctdb, tnode->out_queue);
+
+	if (node->ctdb->transport_threads &&
+	    ctdb_queue_set_threaded(tnode->out_queue) != 0) {
+		DEBUG(DEBUG_WARNING, ("Transport threads not supported, "
+				      "writing to node %s from the main "
+				      "loop\n", node->name));
+	}
+
 	return 0;
 }
 
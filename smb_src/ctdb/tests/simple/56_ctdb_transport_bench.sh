@@ -0,0 +1,73 @@
+#!/bin/bash
+
+test_info()
+{
+    cat <<EOF
+Measure the internode packet rate with packets written from the main
+event loop (default) and from separate threads (--transport-threads).
+
+This doesn't test for performance regressions.  It prints the message
+rates of ctdb_bench with many messages in flight and checks that the
+ring works in both transport modes.
+
+Prerequisites:
+
+* An active CTDB cluster with at least 2 active nodes.
+
+Steps:
+
+1. Verify that the status on all of the ctdb nodes is 'OK'.
+2. Run ctdb_bench on all nodes with many messages in flight.
+3. Restart the cluster with ctdbd --transport-threads.
+4. Run ctdb_bench again.
+
+Expected results:
+
+* ctdb_bench passes messages around the ring in both modes.
+EOF
+}
+
+. "${TEST_SCRIPTS_DIR}/integration.bash"
+
+ctdb_test_init "$@"
+
+set -e
+
+cluster_is_healthy
+
+# Reset configuration
+ctdb_restart_when_done
+
+num_messages=${CTDB_TEST_TRANSPORT_BENCH_MESSAGES:-100}
+timelimit=${CTDB_TEST_TRANSPORT_BENCH_TIME:-10}
+
+try_command_on_node 0 "$CTDB listnodes"
+num_nodes=$(echo "$out" | wc -l)
+
+run_bench ()
+{
+    local mode="$1"
+
+    echo "Running ctdb_bench on all $num_nodes nodes ($mode)..."
+    try_command_on_node -p all $CTDB_TEST_WRAPPER $VALGRIND \
+	ctdb_bench -n $num_nodes -m $num_messages -t $timelimit
+
+    # Every node prints its own rate, report the last one
+    local line=$(tr '\r' '\n' <<<"$out" | grep '^Ring: ' | tail -n 1)
+    local stuff="${line##*Ring: }"
+    local mps="${stuff% msgs/sec*}"
+
+    if [ -n "$mps" ] && [ ${mps%.*} -ge 10 ] ; then
+	echo "$mode: $mps msgs/sec"
+    else
+	echo "BAD: $mode: ${mps:-no} msgs/sec"
+	echo "$out"
+	exit 1
+    fi
+}
+
+run_bench "main loop"
+
+restart_ctdb --transport-threads
+
+run_bench "transport threads"
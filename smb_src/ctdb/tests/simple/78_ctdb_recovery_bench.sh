@@ -0,0 +1,125 @@
+#!/bin/bash
+
+test_info()
+{
+    cat <<EOF
+Measure the time a recovery of several large databases takes: with
+the records sent as one blob per node (RecBufferSizeLimit=0), streamed
+in batches one database after the other (ParallelRecoveryDBs=0) and
+streamed with several databases recovered in parallel (defaults).
+
+This doesn't test for performance regressions.  It prints the
+recovery times and checks that no records are lost or duplicated.
+
+Prerequisites:
+
+* An active CTDB cluster with at least 2 active nodes.
+
+Steps:
+
+1. Verify that the status on all of the ctdb nodes is 'OK'.
+2. Create persistent test databases and fill them with many
+   records using 'ctdb ptrans'.
+3. Set RecoverPDBBySeqNum=0, so that the databases are pulled from all
+   nodes.
+4. Force a recovery with RecBufferSizeLimit=0 and measure its duration.
+5. Force a recovery with ParallelRecoveryDBs=0 and measure its duration.
+6. Force a recovery with the default settings and measure its duration.
+7. After each recovery, verify that all nodes have all records.
+
+Expected results:
+
+* All recoveries succeed and preserve the database contents.
+EOF
+}
+
+. "${TEST_SCRIPTS_DIR}/integration.bash"
+
+ctdb_test_init "$@"
+
+set -e
+
+cluster_is_healthy
+
+# Reset configuration
+ctdb_restart_when_done
+
+num_records=${CTDB_TEST_RECOVERY_BENCH_RECORDS:-20000}
+value_size=${CTDB_TEST_RECOVERY_BENCH_VALUE_SIZE:-200}
+
+num_dbs=${CTDB_TEST_RECOVERY_BENCH_DBS:-3}
+
+TESTDBS=""
+for i in $(seq 1 $num_dbs) ; do
+    TESTDBS="${TESTDBS}${TESTDBS:+ }recovery_bench${i}.tdb"
+done
+
+for TESTDB in $TESTDBS ; do
+    echo "create persistent test database $TESTDB"
+    try_command_on_node 0 $CTDB attach $TESTDB persistent
+
+    echo "wipe test database $TESTDB"
+    try_command_on_node 0 $CTDB wipedb $TESTDB
+
+    echo "Adding $num_records records of $value_size bytes to $TESTDB"
+    awk -v n=$num_records -v size=$value_size 'BEGIN {
+	v = ""
+	for (i = 0; i < size; i++) { v = v "x" }
+	for (i = 0; i < n; i++) { printf("\"key-%08d\" \"%s\"\n", i, v) }
+    }' | try_command_on_node -i 0 $CTDB ptrans "$TESTDB"
+done
+
+# ptrans also stores __db_sequence_number__
+expected=$(($num_records + 1))
+
+check_records ()
+{
+    local n
+    for TESTDB in $TESTDBS ; do
+	for n in $(seq 0 $(($num_nodes - 1))) ; do
+	    try_command_on_node $n "$CTDB catdb $TESTDB | tail -n 1"
+	    if [ "$out" != "Dumped $expected records" ] ; then
+		echo "BAD: node $n: $TESTDB: expected $expected records, got: $out"
+		exit 1
+	    fi
+	done
+    done
+    echo "GOOD: all nodes have $expected records in $num_dbs databases"
+}
+
+timed_recovery ()
+{
+    local limit="$1"
+    local parallel="$2"
+
+    try_command_on_node all $CTDB setvar RecBufferSizeLimit $limit
+    try_command_on_node all $CTDB setvar ParallelRecoveryDBs $parallel
+
+    local start=$(date '+%s.%N')
+    try_command_on_node 0 $CTDB recover
+    local end=$(date '+%s.%N')
+
+    wait_until_ready
+
+    local secs=$(echo "$start $end" | awk '{ printf("%.3f", $2 - $1) }')
+    echo "Recovery with RecBufferSizeLimit=$limit ParallelRecoveryDBs=$parallel took $secs seconds"
+
+    check_records
+}
+
+try_command_on_node 0 "$CTDB listnodes"
+num_nodes=$(echo "$out" | wc -l)
+
+try_command_on_node all $CTDB setvar RecoverPDBBySeqNum 0
+
+try_command_on_node 0 $CTDB getvar RecBufferSizeLimit
+default_limit="${out#* = }"
+
+try_command_on_node 0 $CTDB getvar ParallelRecoveryDBs
+default_parallel="${out#* = }"
+
+check_records
+
+timed_recovery 0 $default_parallel
+timed_recovery $default_limit 0
+timed_recovery $default_limit $default_parallel
@@ -0,0 +1,107 @@
+#!/bin/bash
+
+test_info()
+{
+    cat <<EOF
+Verify that the adaptive hot record policy enables readonly
+delegations and sticky records for databases with hot records.
+
+Prerequisites:
+
+* An active CTDB cluster with at least 2 active nodes.
+
+Steps:
+
+1. Verify that the status on all of the ctdb nodes is 'OK'.
+2. Lower HotRecordReadOnlyRequests and HotRecordMigrations.
+3. Create a test database with some records and alternately ask for
+   readonly copies of a record on nodes 0 and 1.
+4. Verify that the database now supports readonly delegations and
+   that 'ctdb dbstatistics' reports it.
+5. Run ctdb_fetch on all nodes so that a record keeps migrating.
+6. Verify that the database is now sticky and that 'ctdb dbstatistics'
+   reports the sticky records.
+
+Expected results:
+
+* The policy sets the READONLY and STICKY flags on the test database.
+EOF
+}
+
+. "${TEST_SCRIPTS_DIR}/integration.bash"
+
+ctdb_test_init "$@"
+
+set -e
+
+cluster_is_healthy
+
+# Reset configuration
+ctdb_restart_when_done
+
+testdb="test.tdb"
+
+check_db_flag ()
+{
+    local flag="$1"
+
+    try_command_on_node 0 $CTDB getdbmap
+    local db_details=$(awk -v db="$testdb" '$2 == foo="name:" db { print }' <<<"$out")
+    if grep -q "$flag" <<<"$db_details" ; then
+	echo "GOOD: $flag is set on $testdb"
+    else
+	echo "BAD: $flag is not set on $testdb"
+	echo "$db_details"
+	exit 1
+    fi
+}
+
+check_dbstatistics ()
+{
+    local counter="$1"
+
+    local n
+    for n in $all_nodes ; do
+	try_command_on_node $n $CTDB dbstatistics $testdb
+	local value=$(awk -v c="$counter" '$1 == c { print $2 }' <<<"$out")
+	if [ "${value:-0}" -gt 0 ] ; then
+	    echo "GOOD: node $n reports $counter $value"
+	    return 0
+	fi
+    done
+
+    echo "BAD: no node reports $counter"
+    echo "$out"
+    exit 1
+}
+
+try_command_on_node any $CTDB -X listnodes
+all_nodes=$(awk -F'|' '{print $2}' <<<"$out")
+num_nodes=$(echo "$all_nodes" | wc -l)
+
+try_command_on_node all $CTDB setvar HotRecordReadOnlyRequests 3
+try_command_on_node all $CTDB setvar HotRecordMigrations 10
+
+echo "Create test database \"${testdb}\""
+try_command_on_node 0 $CTDB attach $testdb
+
+echo "Create some records..."
+try_command_on_node all $CTDB_TEST_WRAPPER ctdb_update_record
+
+echo "Ask for readonly copies on nodes 0 and 1..."
+for i in $(seq 1 8) ; do
+    try_command_on_node $(($i % 2)) $CTDB_TEST_WRAPPER \
+	"ctdb_fetch_readonly_once </dev/null"
+done
+
+check_db_flag "READONLY"
+check_dbstatistics "ro_wanted"
+check_dbstatistics "auto_readonly"
+
+echo "Running ctdb_fetch on all $num_nodes nodes..."
+try_command_on_node -p all $CTDB_TEST_WRAPPER $VALGRIND ctdb_fetch -n $num_nodes
+
+check_db_flag "STICKY"
+check_dbstatistics "migrations"
+check_dbstatistics "sticky_records"
+check_dbstatistics "auto_sticky"
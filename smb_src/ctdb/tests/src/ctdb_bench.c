@@ -45,6 +45,7 @@ static double end_timer(void)
 static int timelimit = 10;
 static int num_records = 10;
 static int num_nodes;
+static int num_messages = 1;
 
 enum my_functions {FUNC_INCR=1, FUNC_FETCH=2};
 
@@ -104,16 +105,18 @@ static void ring_message_handler(struct ctdb_context *ctdb, uint64_t srvid,
 
 static void send_start_messages(struct ctdb_context *ctdb, int incr)
 {
-	/* two messages are injected into the ring, moving
-	   in opposite directions */
-	int dest;
+	/* num_messages messages are injected into the ring in
+	   each direction */
+	int dest, i;
 	TDB_DATA data;
 		
 	data.dptr = (uint8_t *)&incr;
 	data.dsize = sizeof(incr);
 
 	dest = (ctdb_get_pnn(ctdb) + num_nodes + incr) % num_nodes;
-	ctdb_client_send_message(ctdb, dest, 0, data);
+	for (i=0; i<num_messages; i++) {
+		ctdb_client_send_message(ctdb, dest, 0, data);
+	}
 }
 
 static void each_second(struct event_context *ev, struct timed_event *te, 
@@ -186,6 +189,7 @@ int main(int argc, const char *argv[])
 		{ "timelimit", 't', POPT_ARG_INT, &timelimit, 0, "timelimit", "integer" },
 		{ "num-records", 'r', POPT_ARG_INT, &num_records, 0, "num_records", "integer" },
 		{ NULL, 'n', POPT_ARG_INT, &num_nodes, 0, "num_nodes", "integer" },
+		{ "messages", 'm', POPT_ARG_INT, &num_messages, 0, "messages in flight in each direction", "integer" },
 		POPT_TABLEEND
 	};
 	int opt;
@@ -721,7 +721,22 @@ static int control_dbstatistics(struct ctdb_context *ctdb, int argc, const char
 	printf(" %*s%-22s%*s%10u\n", 0, "", "ro_delegations", 4, "",
 		dbstat->db_ro_delegations);
 	printf(" %*s%-22s%*s%10u\n", 0, "", "ro_revokes", 4, "",
-		dbstat->db_ro_delegations);
+		dbstat->db_ro_revokes);
+	printf(" %s\n", "hot_records");
+	printf(" %*s%-22s%*s%10u\n", 4, "", "migrations", 0, "",
+		dbstat->hot_records.migrations);
+	printf(" %*s%-22s%*s%10u\n", 4, "", "migration_rate", 0, "",
+		dbstat->hot_records.migration_rate);
+	printf(" %*s%-22s%*s%10u\n", 4, "", "ro_wanted", 0, "",
+		dbstat->hot_records.ro_wanted);
+	printf(" %*s%-22s%*s%10u\n", 4, "", "sticky_records", 0, "",
+		dbstat->hot_records.sticky_records);
+	printf(" %*s%-22s%*s%10u\n", 4, "", "pinned_down", 0, "",
+		dbstat->hot_records.pinned_down);
+	printf(" %*s%-22s%*s%10u\n", 4, "", "auto_readonly", 0, "",
+		dbstat->hot_records.auto_readonly);
+	printf(" %*s%-22s%*s%10u\n", 4, "", "auto_sticky", 0, "",
+		dbstat->hot_records.auto_sticky);
 	printf(" %s\n", "locks");
 	printf(" %*s%-22s%*s%10u\n", 4, "", "total", 0, "",
 		dbstat->locks.num_calls);
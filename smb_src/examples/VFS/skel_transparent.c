@@ -425,6 +425,99 @@ static int skel_lstat(vfs_handle_struct *handle,
 	return SMB_VFS_NEXT_LSTAT(handle, smb_fname);
 }
 
+struct skel_stat_state {
+	int ret;
+	int err;
+};
+
+static void skel_stat_done(struct tevent_req *subreq);
+
+static struct tevent_req *skel_stat_send(struct vfs_handle_struct *handle,
+					 TALLOC_CTX *mem_ctx,
+					 struct tevent_context *ev,
+					 struct smb_filename *smb_fname)
+{
+	struct tevent_req *req, *subreq;
+	struct skel_stat_state *state;
+
+	req = tevent_req_create(mem_ctx, &state, struct skel_stat_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	subreq = SMB_VFS_NEXT_STAT_SEND(state, ev, handle, smb_fname);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, skel_stat_done, req);
+	return req;
+}
+
+static struct tevent_req *skel_fstat_send(struct vfs_handle_struct *handle,
+					  TALLOC_CTX *mem_ctx,
+					  struct tevent_context *ev,
+					  struct files_struct *fsp,
+					  SMB_STRUCT_STAT *sbuf)
+{
+	struct tevent_req *req, *subreq;
+	struct skel_stat_state *state;
+
+	req = tevent_req_create(mem_ctx, &state, struct skel_stat_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	subreq = SMB_VFS_NEXT_FSTAT_SEND(state, ev, handle, fsp, sbuf);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, skel_stat_done, req);
+	return req;
+}
+
+static struct tevent_req *skel_lstat_send(struct vfs_handle_struct *handle,
+					  TALLOC_CTX *mem_ctx,
+					  struct tevent_context *ev,
+					  struct smb_filename *smb_fname)
+{
+	struct tevent_req *req, *subreq;
+	struct skel_stat_state *state;
+
+	req = tevent_req_create(mem_ctx, &state, struct skel_stat_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	subreq = SMB_VFS_NEXT_LSTAT_SEND(state, ev, handle, smb_fname);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, skel_stat_done, req);
+	return req;
+}
+
+static void skel_stat_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req =
+	    tevent_req_callback_data(subreq, struct tevent_req);
+	struct skel_stat_state *state =
+	    tevent_req_data(req, struct skel_stat_state);
+
+	/* The stat, fstat and lstat recv functions are interchangeable */
+	state->ret = SMB_VFS_STAT_RECV(subreq, &state->err);
+	TALLOC_FREE(subreq);
+	tevent_req_done(req);
+}
+
+static int skel_stat_recv(struct tevent_req *req, int *err)
+{
+	struct skel_stat_state *state =
+	    tevent_req_data(req, struct skel_stat_state);
+
+	if (tevent_req_is_unix_error(req, err)) {
+		return -1;
+	}
+	*err = state->err;
+	return state->ret;
+}
+
 static uint64_t skel_get_alloc_size(struct vfs_handle_struct *handle,
 				    struct files_struct *fsp,
 				    const SMB_STRUCT_STAT *sbuf)
@@ -861,6 +954,60 @@ static ssize_t skel_getxattr(vfs_handle_struct *handle, const char *path,
 	return SMB_VFS_NEXT_GETXATTR(handle, path, name, value, size);
 }
 
+struct skel_getxattr_state {
+	ssize_t ret;
+	int err;
+};
+
+static void skel_getxattr_done(struct tevent_req *subreq);
+
+static struct tevent_req *skel_getxattr_send(struct vfs_handle_struct *handle,
+					     TALLOC_CTX *mem_ctx,
+					     struct tevent_context *ev,
+					     const char *path,
+					     const char *name,
+					     void *value, size_t size)
+{
+	struct tevent_req *req, *subreq;
+	struct skel_getxattr_state *state;
+
+	req = tevent_req_create(mem_ctx, &state, struct skel_getxattr_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	subreq = SMB_VFS_NEXT_GETXATTR_SEND(state, ev, handle, path, name,
+					    value, size);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, skel_getxattr_done, req);
+	return req;
+}
+
+static void skel_getxattr_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req =
+	    tevent_req_callback_data(subreq, struct tevent_req);
+	struct skel_getxattr_state *state =
+	    tevent_req_data(req, struct skel_getxattr_state);
+
+	state->ret = SMB_VFS_GETXATTR_RECV(subreq, &state->err);
+	TALLOC_FREE(subreq);
+	tevent_req_done(req);
+}
+
+static ssize_t skel_getxattr_recv(struct tevent_req *req, int *err)
+{
+	struct skel_getxattr_state *state =
+	    tevent_req_data(req, struct skel_getxattr_state);
+
+	if (tevent_req_is_unix_error(req, err)) {
+		return -1;
+	}
+	*err = state->err;
+	return state->ret;
+}
+
 static ssize_t skel_fgetxattr(vfs_handle_struct *handle,
 			      struct files_struct *fsp, const char *name,
 			      void *value, size_t size)
@@ -977,6 +1124,12 @@ struct vfs_fn_pointers skel_transparent_fns = {
 	.stat_fn = skel_stat,
 	.fstat_fn = skel_fstat,
 	.lstat_fn = skel_lstat,
+	.stat_send_fn = skel_stat_send,
+	.stat_recv_fn = skel_stat_recv,
+	.fstat_send_fn = skel_fstat_send,
+	.fstat_recv_fn = skel_stat_recv,
+	.lstat_send_fn = skel_lstat_send,
+	.lstat_recv_fn = skel_stat_recv,
 	.get_alloc_size_fn = skel_get_alloc_size,
 	.unlink_fn = skel_unlink,
 	.chmod_fn = skel_chmod,
@@ -1039,6 +1192,8 @@ struct vfs_fn_pointers skel_transparent_fns = {
 
 	/* EA operations. */
 	.getxattr_fn = skel_getxattr,
+	.getxattr_send_fn = skel_getxattr_send,
+	.getxattr_recv_fn = skel_getxattr_recv,
 	.fgetxattr_fn = skel_fgetxattr,
 	.listxattr_fn = skel_listxattr,
 	.flistxattr_fn = skel_flistxattr,
@@ -35,6 +35,17 @@ static inline void aes_ccm_128_xor(const uint8_t in1[AES_BLOCK_SIZE],
 	}
 }
 
+static inline void aes_ccm_128_encrypt(const struct aes_ccm_128_context *ctx,
+				       const uint8_t in[AES_BLOCK_SIZE],
+				       uint8_t out[AES_BLOCK_SIZE])
+{
+	if (ctx->use_ni) {
+		samba_aesni_128_encrypt(ctx->ni_rk, in, out);
+		return;
+	}
+	AES_encrypt(in, out, &ctx->aes_key);
+}
+
 void aes_ccm_128_init(struct aes_ccm_128_context *ctx,
 		      const uint8_t K[AES_BLOCK_SIZE],
 		      const uint8_t N[AES_CCM_128_NONCE_SIZE],
@@ -44,7 +55,12 @@ void aes_ccm_128_init(struct aes_ccm_128_context *ctx,
 
 	ZERO_STRUCTP(ctx);
 
-	AES_set_encrypt_key(K, 128, &ctx->aes_key);
+	if (samba_crypto_have_aesni()) {
+		samba_aesni_128_set_encrypt_key(K, ctx->ni_rk);
+		ctx->use_ni = true;
+	} else {
+		AES_set_encrypt_key(K, 128, &ctx->aes_key);
+	}
 	memcpy(ctx->nonce, N, AES_CCM_128_NONCE_SIZE);
 	ctx->a_remain = a_total;
 	ctx->m_remain = m_total;
@@ -63,7 +79,7 @@ void aes_ccm_128_init(struct aes_ccm_128_context *ctx,
 	/*
 	 * prepare X_1
 	 */
-	AES_encrypt(B_0, ctx->X_i, &ctx->aes_key);
+	aes_ccm_128_encrypt(ctx, B_0, ctx->X_i);
 
 	/*
 	 * prepare B_1
@@ -99,6 +115,24 @@ void aes_ccm_128_update(struct aes_ccm_128_context *ctx,
 		size_t n = MIN(AES_BLOCK_SIZE - ctx->B_i_ofs, v_len);
 		bool more = true;
 
+		if (ctx->use_ni && ctx->B_i_ofs == 0 &&
+		    v_len >= AES_BLOCK_SIZE)
+		{
+			size_t num_blocks = v_len / AES_BLOCK_SIZE;
+
+			/*
+			 * Full blocks are chained without
+			 * copying them to B_i.
+			 */
+			samba_aesni_128_cbc_mac(ctx->ni_rk, ctx->X_i,
+						v, num_blocks);
+			n = num_blocks * AES_BLOCK_SIZE;
+			v += n;
+			v_len -= n;
+			*remain -= n;
+			continue;
+		}
+
 		memcpy(&ctx->B_i[ctx->B_i_ofs], v, n);
 		v += n;
 		v_len -= n;
@@ -116,7 +150,7 @@ void aes_ccm_128_update(struct aes_ccm_128_context *ctx,
 		}
 
 		aes_ccm_128_xor(ctx->X_i, ctx->B_i, ctx->B_i);
-		AES_encrypt(ctx->B_i, ctx->X_i, &ctx->aes_key);
+		aes_ccm_128_encrypt(ctx, ctx->B_i, ctx->X_i);
 
 		ZERO_STRUCT(ctx->B_i);
 		ctx->B_i_ofs = 0;
@@ -133,13 +167,31 @@ static void aes_ccm_128_S_i(struct aes_ccm_128_context *ctx,
 	memcpy(&A_i[1], ctx->nonce, AES_CCM_128_NONCE_SIZE);
 	RSIVAL(A_i, (AES_BLOCK_SIZE - AES_CCM_128_L), i);
 
-	AES_encrypt(A_i, S_i, &ctx->aes_key);
+	aes_ccm_128_encrypt(ctx, A_i, S_i);
 }
 
 void aes_ccm_128_crypt(struct aes_ccm_128_context *ctx,
 		       uint8_t *m, size_t m_len)
 {
 	while (m_len > 0) {
+		if (ctx->use_ni && ctx->S_i_ofs == AES_BLOCK_SIZE &&
+		    m_len >= AES_BLOCK_SIZE)
+		{
+			size_t num_blocks = m_len / AES_BLOCK_SIZE;
+			uint8_t A_i[AES_BLOCK_SIZE];
+
+			A_i[0]  = L_;
+			memcpy(&A_i[1], ctx->nonce, AES_CCM_128_NONCE_SIZE);
+			RSIVAL(A_i, (AES_BLOCK_SIZE - AES_CCM_128_L),
+			       ctx->S_i_ctr + 1);
+
+			samba_aesni_128_ctr32(ctx->ni_rk, A_i, m, num_blocks);
+			ctx->S_i_ctr += num_blocks;
+			m += num_blocks * AES_BLOCK_SIZE;
+			m_len -= num_blocks * AES_BLOCK_SIZE;
+			continue;
+		}
+
 		if (ctx->S_i_ofs == AES_BLOCK_SIZE) {
 			ctx->S_i_ctr += 1;
 			aes_ccm_128_S_i(ctx, ctx->S_i, ctx->S_i_ctr);
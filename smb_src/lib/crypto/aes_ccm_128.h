@@ -26,6 +26,14 @@
 
 struct aes_ccm_128_context {
 	AES_KEY aes_key;
+
+	/*
+	 * round keys for the AES-NI implementation,
+	 * only valid if use_ni is true.
+	 */
+	uint8_t ni_rk[AESNI_128_ROUND_KEYS][AES_BLOCK_SIZE];
+	bool use_ni;
+
 	uint8_t nonce[AES_CCM_128_NONCE_SIZE];
 
 	size_t a_remain;
@@ -0,0 +1,196 @@
+/*
+   AES-CCM-128 tests
+
+   Copyright (C) The Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "replace.h"
+#include "../lib/util/samba_util.h"
+#include "../lib/crypto/crypto.h"
+
+struct torture_context;
+bool torture_local_crypto_aes_ccm_128(struct torture_context *torture);
+
+#define AES_CCM_128_TEST_MAX 261
+
+struct aes_ccm_128_testvector {
+	size_t a_len;
+	size_t m_len;
+	DATA_BLOB C;
+	DATA_BLOB T;
+};
+
+static bool aes_ccm_128_check(uint32_t i,
+			      const uint8_t K[AES_BLOCK_SIZE],
+			      const uint8_t N[AES_CCM_128_NONCE_SIZE],
+			      const uint8_t *A,
+			      const uint8_t *P,
+			      const struct aes_ccm_128_testvector *v)
+{
+	struct aes_ccm_128_context ctx;
+	uint8_t T[AES_BLOCK_SIZE];
+	uint8_t C[AES_CCM_128_TEST_MAX];
+	size_t split;
+
+	/*
+	 * Encrypt and decrypt with the data split at
+	 * every possible offset, in order to verify
+	 * the handling of partial blocks.
+	 */
+	for (split = 0; split <= v->m_len; split++) {
+		size_t rest = v->m_len - split;
+		int e1, e2, e3;
+
+		memcpy(C, P, v->m_len);
+
+		aes_ccm_128_init(&ctx, K, N, v->a_len, v->m_len);
+		aes_ccm_128_update(&ctx, A, v->a_len);
+		aes_ccm_128_update(&ctx, C, split);
+		aes_ccm_128_update(&ctx, C + split, rest);
+		aes_ccm_128_crypt(&ctx, C, split);
+		aes_ccm_128_crypt(&ctx, C + split, rest);
+		aes_ccm_128_digest(&ctx, T);
+
+		e1 = 0;
+		if (v->m_len > 0) {
+			e1 = memcmp(v->C.data, C, v->m_len);
+		}
+		e2 = memcmp(v->T.data, T, sizeof(T));
+
+		aes_ccm_128_init(&ctx, K, N, v->a_len, v->m_len);
+		aes_ccm_128_crypt(&ctx, C, split);
+		aes_ccm_128_crypt(&ctx, C + split, rest);
+		aes_ccm_128_update(&ctx, A, v->a_len);
+		aes_ccm_128_update(&ctx, C, split);
+		aes_ccm_128_update(&ctx, C + split, rest);
+		aes_ccm_128_digest(&ctx, T);
+
+		e3 = memcmp(v->T.data, T, sizeof(T));
+		e3 |= memcmp(P, C, v->m_len);
+
+		if (e1 != 0 || e2 != 0 || e3 != 0) {
+			printf("aes_ccm_128 test[%u] split[%u]: failed\n",
+			       i, (unsigned)split);
+			dump_data(0, P, v->m_len);
+			dump_data(0, v->C.data, v->C.length);
+			dump_data(0, v->T.data, v->T.length);
+			dump_data(0, T, sizeof(T));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ The expected values were computed with an independent
+ implementation, using the parameters of SMB2 encryption:
+ a 16 byte tag and an 11 byte nonce.
+*/
+bool torture_local_crypto_aes_ccm_128(struct torture_context *torture)
+{
+	bool ret = true;
+	uint32_t i;
+	DATA_BLOB K;
+	DATA_BLOB N;
+	uint8_t A[32];
+	uint8_t P[AES_CCM_128_TEST_MAX];
+	struct aes_ccm_128_testvector v[6];
+
+	TALLOC_CTX *tctx = talloc_new(torture);
+	if (!tctx) { return false; };
+
+	K = strhex_to_data_blob(tctx, "40474e555c636a71787f868d949ba2a9");
+	N = strhex_to_data_blob(tctx, "a0a3a6a9acafb2b5b8bbbe");
+
+	for (i = 0; i < sizeof(A); i++) {
+		A[i] = 0x10 + i;
+	}
+	for (i = 0; i < sizeof(P); i++) {
+		P[i] = (i * 37 + 11) & 0xFF;
+	}
+
+	ZERO_STRUCT(v);
+
+	v[0].a_len = 0;
+	v[0].m_len = 0;
+	v[0].T = strhex_to_data_blob(tctx,
+				"0a5d1a491a75f8110e5905b562581276");
+
+	v[1].a_len = 32;
+	v[1].m_len = 1;
+	v[1].C = strhex_to_data_blob(tctx,
+				"37");
+	v[1].T = strhex_to_data_blob(tctx,
+				"c3933df519e9911b3bb188d1d5ec7281");
+
+	v[2].a_len = 32;
+	v[2].m_len = 16;
+	v[2].C = strhex_to_data_blob(tctx,
+				"3719cf6e6c62ccb49c4332ee92e55d5b");
+	v[2].T = strhex_to_data_blob(tctx,
+				"5d5422a92f0b83def3c4952163822d62");
+
+	v[3].a_len = 20;
+	v[3].m_len = 33;
+	v[3].C = strhex_to_data_blob(tctx,
+				"3719cf6e6c62ccb49c4332ee92e55d5b"
+				"158ceae580f49cc49b24c216157f3eb4"
+				"b4");
+	v[3].T = strhex_to_data_blob(tctx,
+				"e9d4bff82bf5feb735a2d40c4f5336ef");
+
+	v[4].a_len = 32;
+	v[4].m_len = 64;
+	v[4].C = strhex_to_data_blob(tctx,
+				"3719cf6e6c62ccb49c4332ee92e55d5b"
+				"158ceae580f49cc49b24c216157f3eb4"
+				"b493aad3068b6c9a35ceb3d03b7064f5"
+				"c8cd93962f20b659d8029c1ea608d042");
+	v[4].T = strhex_to_data_blob(tctx,
+				"ccb38f579ce6f4e83608bda428f9a2a6");
+
+	v[5].a_len = 32;
+	v[5].m_len = 261;
+	v[5].C = strhex_to_data_blob(tctx,
+				"3719cf6e6c62ccb49c4332ee92e55d5b"
+				"158ceae580f49cc49b24c216157f3eb4"
+				"b493aad3068b6c9a35ceb3d03b7064f5"
+				"c8cd93962f20b659d8029c1ea608d042"
+				"ab40976bdf3c67fb0ea65ef47e5ce358"
+				"f25e418881453d81b535fd2355dd053d"
+				"85797e407f2c2d92a6a4e8e0178b04b5"
+				"a1730e8ef802459962e97a829aa04d21"
+				"04a32f7fbe39e7f87c51462ebc2b7bfa"
+				"27d3bdc336a8ecf683a8ddf4acf9f82c"
+				"b38b403a08f5d281f8cdca3d38cc2838"
+				"71926f88d333308724a410239b959864"
+				"06fe2a097f1c7aaf6f28db2c519f2555"
+				"15344db375acbdda781513e40a0c55c9"
+				"2b4cfa4c34afedaa816016a1f22e02e6"
+				"28b6effd20d993bd417c21be013d9f08"
+				"6c6a8311ec");
+	v[5].T = strhex_to_data_blob(tctx,
+				"2ddc69a7036d0fa35c63a03c0f0aad72");
+
+	for (i = 0; i < ARRAY_SIZE(v); i++) {
+		if (!aes_ccm_128_check(i, K.data, N.data, A, P, &v[i])) {
+			ret = false;
+		}
+	}
+
+	talloc_free(tctx);
+	return ret;
+}
@@ -59,42 +59,75 @@ static inline void aes_cmac_128_xor(const uint8_t in1[AES_BLOCK_SIZE],
 	}
 }
 
-void aes_cmac_128_init(struct aes_cmac_128_context *ctx,
-		       const uint8_t K[AES_BLOCK_SIZE])
+static inline void aes_cmac_128_encrypt(const struct aes_cmac_128_key *key,
+					const uint8_t in[AES_BLOCK_SIZE],
+					uint8_t out[AES_BLOCK_SIZE])
+{
+	if (key->use_ni) {
+		samba_aesni_128_encrypt(key->ni_rk, in, out);
+		return;
+	}
+	AES_encrypt(in, out, &key->aes_key);
+}
+
+void aes_cmac_128_key_setup(struct aes_cmac_128_key *key,
+			    const uint8_t K[AES_BLOCK_SIZE])
 {
 	uint8_t L[AES_BLOCK_SIZE];
 
-	ZERO_STRUCTP(ctx);
+	ZERO_STRUCTP(key);
 
-	AES_set_encrypt_key(K, 128, &ctx->aes_key);
+	if (samba_crypto_have_aesni()) {
+		samba_aesni_128_set_encrypt_key(K, key->ni_rk);
+		key->use_ni = true;
+	} else {
+		AES_set_encrypt_key(K, 128, &key->aes_key);
+	}
 
 	/* step 1 - generate subkeys k1 and k2 */
 
-	AES_encrypt(const_Zero, L, &ctx->aes_key);
+	aes_cmac_128_encrypt(key, const_Zero, L);
 
 	if (_MSB(L) == 0) {
-		aes_cmac_128_left_shift_1(L, ctx->K1);
+		aes_cmac_128_left_shift_1(L, key->K1);
 	} else {
 		uint8_t tmp_block[AES_BLOCK_SIZE];
 
 		aes_cmac_128_left_shift_1(L, tmp_block);
-		aes_cmac_128_xor(tmp_block, const_Rb, ctx->K1);
+		aes_cmac_128_xor(tmp_block, const_Rb, key->K1);
 		ZERO_STRUCT(tmp_block);
 	}
 
-	if (_MSB(ctx->K1) == 0) {
-		aes_cmac_128_left_shift_1(ctx->K1, ctx->K2);
+	if (_MSB(key->K1) == 0) {
+		aes_cmac_128_left_shift_1(key->K1, key->K2);
 	} else {
 		uint8_t tmp_block[AES_BLOCK_SIZE];
 
-		aes_cmac_128_left_shift_1(ctx->K1, tmp_block);
-		aes_cmac_128_xor(tmp_block, const_Rb, ctx->K2);
+		aes_cmac_128_left_shift_1(key->K1, tmp_block);
+		aes_cmac_128_xor(tmp_block, const_Rb, key->K2);
 		ZERO_STRUCT(tmp_block);
 	}
 
 	ZERO_STRUCT(L);
 }
 
+void aes_cmac_128_init_key(struct aes_cmac_128_context *ctx,
+			   const struct aes_cmac_128_key *key)
+{
+	ZERO_STRUCTP(ctx);
+
+	ctx->key = key;
+}
+
+void aes_cmac_128_init(struct aes_cmac_128_context *ctx,
+		       const uint8_t K[AES_BLOCK_SIZE])
+{
+	ZERO_STRUCTP(ctx);
+
+	aes_cmac_128_key_setup(&ctx->key_buf, K);
+	ctx->key = &ctx->key_buf;
+}
+
 void aes_cmac_128_update(struct aes_cmac_128_context *ctx,
 			 const uint8_t *_msg, size_t _msg_len)
 {
@@ -140,7 +173,16 @@ void aes_cmac_128_update(struct aes_cmac_128_context *ctx,
 	 * now checksum everything but the last block
 	 */
 	aes_cmac_128_xor(ctx->X, tmp_block, Y);
-	AES_encrypt(Y, ctx->X, &ctx->aes_key);
+	aes_cmac_128_encrypt(ctx->key, Y, ctx->X);
+
+	if (ctx->key->use_ni && msg_len > AES_BLOCK_SIZE) {
+		size_t num_blocks = (msg_len - 1) / AES_BLOCK_SIZE;
+
+		samba_aesni_128_cbc_mac(ctx->key->ni_rk, ctx->X,
+					msg, num_blocks);
+		msg += num_blocks * AES_BLOCK_SIZE;
+		msg_len -= num_blocks * AES_BLOCK_SIZE;
+	}
 
 	while (msg_len > AES_BLOCK_SIZE) {
 		memcpy(tmp_block, msg, AES_BLOCK_SIZE);
@@ -148,7 +190,7 @@ void aes_cmac_128_update(struct aes_cmac_128_context *ctx,
 		msg_len -= AES_BLOCK_SIZE;
 
 		aes_cmac_128_xor(ctx->X, tmp_block, Y);
-		AES_encrypt(Y, ctx->X, &ctx->aes_key);
+		aes_cmac_128_encrypt(ctx->key, Y, ctx->X);
 	}
 
 	/*
@@ -170,13 +212,13 @@ void aes_cmac_128_final(struct aes_cmac_128_context *ctx,
 
 	if (ctx->last_len < AES_BLOCK_SIZE) {
 		ctx->last[ctx->last_len] = 0x80;
-		aes_cmac_128_xor(ctx->last, ctx->K2, tmp_block);
+		aes_cmac_128_xor(ctx->last, ctx->key->K2, tmp_block);
 	} else {
-		aes_cmac_128_xor(ctx->last, ctx->K1, tmp_block);
+		aes_cmac_128_xor(ctx->last, ctx->key->K1, tmp_block);
 	}
 
 	aes_cmac_128_xor(tmp_block, ctx->X, Y);
-	AES_encrypt(Y, T, &ctx->aes_key);
+	aes_cmac_128_encrypt(ctx->key, Y, T);
 
 	ZERO_STRUCT(tmp_block);
 	ZERO_STRUCT(Y);
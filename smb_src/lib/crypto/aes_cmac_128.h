@@ -19,11 +19,28 @@
 #ifndef LIB_CRYPTO_AES_CMAC_128_H
 #define LIB_CRYPTO_AES_CMAC_128_H
 
-struct aes_cmac_128_context {
+/*
+ * The expanded key and the subkeys, which only
+ * depend on K and can be reused for many messages.
+ */
+struct aes_cmac_128_key {
 	AES_KEY aes_key;
 
+	/*
+	 * round keys for the AES-NI implementation,
+	 * only valid if use_ni is true.
+	 */
+	uint8_t ni_rk[AESNI_128_ROUND_KEYS][AES_BLOCK_SIZE];
+	bool use_ni;
+
 	uint8_t K1[AES_BLOCK_SIZE];
 	uint8_t K2[AES_BLOCK_SIZE];
+};
+
+struct aes_cmac_128_context {
+	/* only used by aes_cmac_128_init() */
+	struct aes_cmac_128_key key_buf;
+	const struct aes_cmac_128_key *key;
 
 	uint8_t X[AES_BLOCK_SIZE];
 
@@ -31,6 +48,13 @@ struct aes_cmac_128_context {
 	size_t last_len;
 };
 
+void aes_cmac_128_key_setup(struct aes_cmac_128_key *key,
+			    const uint8_t K[AES_BLOCK_SIZE]);
+/*
+ * key needs to stay valid until aes_cmac_128_final()
+ */
+void aes_cmac_128_init_key(struct aes_cmac_128_context *ctx,
+			   const struct aes_cmac_128_key *key);
 void aes_cmac_128_init(struct aes_cmac_128_context *ctx,
 		       const uint8_t K[AES_BLOCK_SIZE]);
 void aes_cmac_128_update(struct aes_cmac_128_context *ctx,
@@ -30,6 +30,7 @@ bool torture_local_crypto_aes_cmac_128(struct torture_context *torture)
 	bool ret = true;
 	uint32_t i;
 	DATA_BLOB key;
+	struct aes_cmac_128_key cmac_key;
 	struct {
 		DATA_BLOB data;
 		DATA_BLOB cmac;
@@ -66,9 +67,12 @@ bool torture_local_crypto_aes_cmac_128(struct torture_context *torture)
 
 	ZERO_STRUCT(testarray[4]);
 
+	aes_cmac_128_key_setup(&cmac_key, key.data);
+
 	for (i=0; testarray[i].cmac.length != 0; i++) {
 		struct aes_cmac_128_context ctx;
 		uint8_t cmac[AES_BLOCK_SIZE];
+		uint8_t cmac_key_T[AES_BLOCK_SIZE];
 		int e;
 
 		aes_cmac_128_init(&ctx, key.data);
@@ -77,13 +81,26 @@ bool torture_local_crypto_aes_cmac_128(struct torture_context *torture)
 				    testarray[i].data.length);
 		aes_cmac_128_final(&ctx, cmac);
 
+		/*
+		 * the precomputed key schedule is
+		 * reused for all messages.
+		 */
+		aes_cmac_128_init_key(&ctx, &cmac_key);
+		aes_cmac_128_update(&ctx,
+				    testarray[i].data.data,
+				    testarray[i].data.length);
+		aes_cmac_128_final(&ctx, cmac_key_T);
+
 		e = memcmp(testarray[i].cmac.data, cmac, sizeof(cmac));
+		e |= memcmp(testarray[i].cmac.data, cmac_key_T,
+			    sizeof(cmac_key_T));
 		if (e != 0) {
 			printf("aes_cmac_128 test[%u]: failed\n", i);
 			dump_data(0, key.data, key.length);
 			dump_data(0, testarray[i].data.data, testarray[i].data.length);
 			dump_data(0, testarray[i].cmac.data, testarray[i].cmac.length);
 			dump_data(0, cmac, sizeof(cmac));
+			dump_data(0, cmac_key_T, sizeof(cmac_key_T));
 			ret = false;
 		}
 	}
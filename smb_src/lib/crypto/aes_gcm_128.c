@@ -0,0 +1,586 @@
+/*
+   AES-GCM-128 (NIST SP 800-38D)
+
+   Copyright (C) The Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "replace.h"
+#include "../lib/crypto/crypto.h"
+#include "lib/util/byteorder.h"
+
+#ifdef HAVE_AESNI_INTRINSICS
+#include <wmmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+static inline uint64_t aes_gcm_128_get_be64(const uint8_t *p)
+{
+	return ((uint64_t)RIVAL(p, 0) << 32) | (uint64_t)RIVAL(p, 4);
+}
+
+static inline void aes_gcm_128_put_be64(uint8_t *p, uint64_t v)
+{
+	RSIVAL(p, 0, v >> 32);
+	RSIVAL(p, 4, v & 0xFFFFFFFF);
+}
+
+static inline void aes_gcm_128_inc32(uint8_t inout[AES_BLOCK_SIZE])
+{
+	uint32_t v;
+
+	v = RIVAL(inout, AES_BLOCK_SIZE - 4);
+	v += 1;
+	RSIVAL(inout, AES_BLOCK_SIZE - 4, v);
+}
+
+static inline void aes_gcm_128_xor(const uint8_t in1[AES_BLOCK_SIZE],
+				   const uint8_t in2[AES_BLOCK_SIZE],
+				   uint8_t out[AES_BLOCK_SIZE])
+{
+	uint8_t i;
+
+	for (i = 0; i < AES_BLOCK_SIZE; i++) {
+		out[i] = in1[i] ^ in2[i];
+	}
+}
+
+/*
+ * Portable implementation.
+ *
+ * GHASH uses Shoup's 4-bit tables, which are
+ * precomputed from H in aes_gcm_128_init().
+ */
+
+static void aes_gcm_128_generic_table(struct aes_gcm_128_context *ctx)
+{
+	uint64_t vh, vl;
+	int i, j;
+
+	vh = aes_gcm_128_get_be64(ctx->H);
+	vl = aes_gcm_128_get_be64(ctx->H + 8);
+
+	ctx->HL[8] = vl;
+	ctx->HH[8] = vh;
+	ctx->HL[0] = 0;
+	ctx->HH[0] = 0;
+
+	for (i = 4; i > 0; i >>= 1) {
+		uint64_t T = (vl & 1) * 0xe100000000000000ULL;
+
+		vl = (vh << 63) | (vl >> 1);
+		vh = (vh >> 1) ^ T;
+
+		ctx->HL[i] = vl;
+		ctx->HH[i] = vh;
+	}
+
+	for (i = 2; i <= 8; i *= 2) {
+		vh = ctx->HH[i];
+		vl = ctx->HL[i];
+		for (j = 1; j < i; j++) {
+			ctx->HH[i + j] = vh ^ ctx->HH[j];
+			ctx->HL[i + j] = vl ^ ctx->HL[j];
+		}
+	}
+}
+
+static const uint64_t aes_gcm_128_last4[16] = {
+	0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+	0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+/*
+ * Y = (Y ^ X_i) * H for all blocks in v
+ */
+static void aes_gcm_128_generic_ghash(struct aes_gcm_128_context *ctx,
+				      const uint8_t *v, size_t num_blocks)
+{
+	while (num_blocks > 0) {
+		uint8_t x[AES_BLOCK_SIZE];
+		uint64_t zh, zl;
+		uint8_t lo, hi, rem;
+		int i;
+
+		aes_gcm_128_xor(ctx->Y, v, x);
+
+		lo = x[15] & 0xf;
+		zh = ctx->HH[lo];
+		zl = ctx->HL[lo];
+
+		for (i = 15; i >= 0; i--) {
+			lo = x[i] & 0xf;
+			hi = (x[i] >> 4) & 0xf;
+
+			if (i != 15) {
+				rem = zl & 0xf;
+				zl = (zh << 60) | (zl >> 4);
+				zh = (zh >> 4);
+				zh ^= aes_gcm_128_last4[rem] << 48;
+				zh ^= ctx->HH[lo];
+				zl ^= ctx->HL[lo];
+			}
+
+			rem = zl & 0xf;
+			zl = (zh << 60) | (zl >> 4);
+			zh = (zh >> 4);
+			zh ^= aes_gcm_128_last4[rem] << 48;
+			zh ^= ctx->HH[hi];
+			zl ^= ctx->HL[hi];
+		}
+
+		aes_gcm_128_put_be64(ctx->Y, zh);
+		aes_gcm_128_put_be64(ctx->Y + 8, zl);
+
+		v += AES_BLOCK_SIZE;
+		num_blocks -= 1;
+	}
+}
+
+/*
+ * m ^= E(CB++) for all blocks in m
+ */
+static void aes_gcm_128_generic_ctr(struct aes_gcm_128_context *ctx,
+				    uint8_t *m, size_t num_blocks)
+{
+	while (num_blocks > 0) {
+		uint8_t S[AES_BLOCK_SIZE];
+
+		AES_encrypt(ctx->CB, S, &ctx->aes_key);
+		aes_gcm_128_inc32(ctx->CB);
+		aes_gcm_128_xor(m, S, m);
+
+		m += AES_BLOCK_SIZE;
+		num_blocks -= 1;
+	}
+}
+
+#ifdef HAVE_AESNI_INTRINSICS
+
+/*
+ * AES-NI/PCLMULQDQ implementation, see Intel's
+ * "Carry-Less Multiplication Instruction and its Usage
+ * for Computing the GCM Mode" white paper.
+ *
+ * The functions are compiled for the required
+ * instruction set extensions only, the caller
+ * checks the cpu via aes_gcm_128_have_ni(),
+ * the key schedule comes from crypto_accel.c.
+ */
+
+#define AES_GCM_128_NI __attribute__((target("aes,pclmul,ssse3")))
+
+AES_GCM_128_NI
+static inline __m128i aes_gcm_128_ni_bswap(__m128i v)
+{
+	const __m128i mask = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+					  8, 9, 10, 11, 12, 13, 14, 15);
+
+	return _mm_shuffle_epi8(v, mask);
+}
+
+AES_GCM_128_NI
+static inline __m128i aes_gcm_128_ni_encrypt(const __m128i rk[11], __m128i v)
+{
+	int i;
+
+	v = _mm_xor_si128(v, rk[0]);
+	for (i = 1; i < 10; i++) {
+		v = _mm_aesenc_si128(v, rk[i]);
+	}
+	return _mm_aesenclast_si128(v, rk[10]);
+}
+
+/*
+ * Carry-less multiplication of a and b (both in
+ * reflected byte order) followed by the reduction
+ * modulo x^128 + x^7 + x^2 + x + 1.
+ */
+AES_GCM_128_NI
+static inline __m128i aes_gcm_128_ni_gfmul(__m128i a, __m128i b)
+{
+	__m128i t2, t3, t4, t5, t6, t7, t8, t9;
+
+	t3 = _mm_clmulepi64_si128(a, b, 0x00);
+	t4 = _mm_clmulepi64_si128(a, b, 0x10);
+	t5 = _mm_clmulepi64_si128(a, b, 0x01);
+	t6 = _mm_clmulepi64_si128(a, b, 0x11);
+
+	t4 = _mm_xor_si128(t4, t5);
+	t5 = _mm_slli_si128(t4, 8);
+	t4 = _mm_srli_si128(t4, 8);
+	t3 = _mm_xor_si128(t3, t5);
+	t6 = _mm_xor_si128(t6, t4);
+
+	/* shift the 256-bit product left by one bit */
+	t7 = _mm_srli_epi32(t3, 31);
+	t8 = _mm_srli_epi32(t6, 31);
+	t3 = _mm_slli_epi32(t3, 1);
+	t6 = _mm_slli_epi32(t6, 1);
+	t9 = _mm_srli_si128(t7, 12);
+	t8 = _mm_slli_si128(t8, 4);
+	t7 = _mm_slli_si128(t7, 4);
+	t3 = _mm_or_si128(t3, t7);
+	t6 = _mm_or_si128(t6, t8);
+	t6 = _mm_or_si128(t6, t9);
+
+	/* reduce */
+	t7 = _mm_slli_epi32(t3, 31);
+	t8 = _mm_slli_epi32(t3, 30);
+	t9 = _mm_slli_epi32(t3, 25);
+	t7 = _mm_xor_si128(t7, t8);
+	t7 = _mm_xor_si128(t7, t9);
+	t8 = _mm_srli_si128(t7, 4);
+	t7 = _mm_slli_si128(t7, 12);
+	t3 = _mm_xor_si128(t3, t7);
+
+	t2 = _mm_srli_epi32(t3, 1);
+	t4 = _mm_srli_epi32(t3, 2);
+	t5 = _mm_srli_epi32(t3, 7);
+	t2 = _mm_xor_si128(t2, t4);
+	t2 = _mm_xor_si128(t2, t5);
+	t2 = _mm_xor_si128(t2, t8);
+	t3 = _mm_xor_si128(t3, t2);
+	t6 = _mm_xor_si128(t6, t3);
+
+	return t6;
+}
+
+AES_GCM_128_NI
+static void aes_gcm_128_ni_ghash(struct aes_gcm_128_context *ctx,
+				 const uint8_t *v, size_t num_blocks)
+{
+	__m128i h, y;
+
+	h = aes_gcm_128_ni_bswap(_mm_loadu_si128((const __m128i *)ctx->H));
+	y = aes_gcm_128_ni_bswap(_mm_loadu_si128((const __m128i *)ctx->Y));
+
+	while (num_blocks > 0) {
+		__m128i x;
+
+		x = aes_gcm_128_ni_bswap(_mm_loadu_si128((const __m128i *)v));
+		y = aes_gcm_128_ni_gfmul(_mm_xor_si128(y, x), h);
+
+		v += AES_BLOCK_SIZE;
+		num_blocks -= 1;
+	}
+
+	_mm_storeu_si128((__m128i *)ctx->Y, aes_gcm_128_ni_bswap(y));
+}
+
+AES_GCM_128_NI
+static void aes_gcm_128_ni_ctr(struct aes_gcm_128_context *ctx,
+			       uint8_t *m, size_t num_blocks)
+{
+	const __m128i one = _mm_set_epi32(0, 0, 0, 1);
+	__m128i rk[11];
+	__m128i cb;
+	int i;
+
+	for (i = 0; i < 11; i++) {
+		rk[i] = _mm_loadu_si128((const __m128i *)ctx->ni_rk[i]);
+	}
+
+	/*
+	 * Keep the counter block in reflected byte order,
+	 * so that inc32 is a simple 32-bit addition
+	 * to the lowest dword.
+	 */
+	cb = aes_gcm_128_ni_bswap(_mm_loadu_si128((const __m128i *)ctx->CB));
+
+	/*
+	 * Process 4 blocks in parallel in order to hide
+	 * the latency of the aesenc instructions.
+	 */
+	while (num_blocks >= 4) {
+		__m128i s0, s1, s2, s3;
+		__m128i m0, m1, m2, m3;
+
+#define AES_GCM_128_NI_CB(s) do { \
+	s = aes_gcm_128_ni_bswap(cb); \
+	cb = _mm_add_epi32(cb, one); \
+} while (0)
+
+		AES_GCM_128_NI_CB(s0);
+		AES_GCM_128_NI_CB(s1);
+		AES_GCM_128_NI_CB(s2);
+		AES_GCM_128_NI_CB(s3);
+
+		s0 = _mm_xor_si128(s0, rk[0]);
+		s1 = _mm_xor_si128(s1, rk[0]);
+		s2 = _mm_xor_si128(s2, rk[0]);
+		s3 = _mm_xor_si128(s3, rk[0]);
+		for (i = 1; i < 10; i++) {
+			s0 = _mm_aesenc_si128(s0, rk[i]);
+			s1 = _mm_aesenc_si128(s1, rk[i]);
+			s2 = _mm_aesenc_si128(s2, rk[i]);
+			s3 = _mm_aesenc_si128(s3, rk[i]);
+		}
+		s0 = _mm_aesenclast_si128(s0, rk[10]);
+		s1 = _mm_aesenclast_si128(s1, rk[10]);
+		s2 = _mm_aesenclast_si128(s2, rk[10]);
+		s3 = _mm_aesenclast_si128(s3, rk[10]);
+
+		m0 = _mm_loadu_si128((const __m128i *)(m + 0 * AES_BLOCK_SIZE));
+		m1 = _mm_loadu_si128((const __m128i *)(m + 1 * AES_BLOCK_SIZE));
+		m2 = _mm_loadu_si128((const __m128i *)(m + 2 * AES_BLOCK_SIZE));
+		m3 = _mm_loadu_si128((const __m128i *)(m + 3 * AES_BLOCK_SIZE));
+
+		_mm_storeu_si128((__m128i *)(m + 0 * AES_BLOCK_SIZE),
+				 _mm_xor_si128(m0, s0));
+		_mm_storeu_si128((__m128i *)(m + 1 * AES_BLOCK_SIZE),
+				 _mm_xor_si128(m1, s1));
+		_mm_storeu_si128((__m128i *)(m + 2 * AES_BLOCK_SIZE),
+				 _mm_xor_si128(m2, s2));
+		_mm_storeu_si128((__m128i *)(m + 3 * AES_BLOCK_SIZE),
+				 _mm_xor_si128(m3, s3));
+
+		m += 4 * AES_BLOCK_SIZE;
+		num_blocks -= 4;
+	}
+
+	while (num_blocks > 0) {
+		__m128i s0, m0;
+
+		AES_GCM_128_NI_CB(s0);
+		s0 = aes_gcm_128_ni_encrypt(rk, s0);
+
+		m0 = _mm_loadu_si128((const __m128i *)m);
+		_mm_storeu_si128((__m128i *)m, _mm_xor_si128(m0, s0));
+
+		m += AES_BLOCK_SIZE;
+		num_blocks -= 1;
+	}
+
+#undef AES_GCM_128_NI_CB
+
+	_mm_storeu_si128((__m128i *)ctx->CB, aes_gcm_128_ni_bswap(cb));
+}
+
+#endif /* HAVE_AESNI_INTRINSICS */
+
+bool aes_gcm_128_have_ni(void)
+{
+	return samba_crypto_have_aesni() && samba_crypto_have_pclmul();
+}
+
+static void aes_gcm_128_encrypt_block(struct aes_gcm_128_context *ctx,
+				      const uint8_t in[AES_BLOCK_SIZE],
+				      uint8_t out[AES_BLOCK_SIZE])
+{
+	if (ctx->use_ni) {
+		samba_aesni_128_encrypt(ctx->ni_rk, in, out);
+		return;
+	}
+	AES_encrypt(in, out, &ctx->aes_key);
+}
+
+static void aes_gcm_128_ghash(struct aes_gcm_128_context *ctx,
+			      const uint8_t *v, size_t num_blocks)
+{
+#ifdef HAVE_AESNI_INTRINSICS
+	if (ctx->use_ni) {
+		aes_gcm_128_ni_ghash(ctx, v, num_blocks);
+		return;
+	}
+#endif
+	aes_gcm_128_generic_ghash(ctx, v, num_blocks);
+}
+
+static void aes_gcm_128_ctr(struct aes_gcm_128_context *ctx,
+			    uint8_t *m, size_t num_blocks)
+{
+#ifdef HAVE_AESNI_INTRINSICS
+	if (ctx->use_ni) {
+		aes_gcm_128_ni_ctr(ctx, m, num_blocks);
+		return;
+	}
+#endif
+	aes_gcm_128_generic_ctr(ctx, m, num_blocks);
+}
+
+static void aes_gcm_128_init_common(struct aes_gcm_128_context *ctx,
+				    const uint8_t K[AES_BLOCK_SIZE],
+				    const uint8_t IV[AES_GCM_128_IV_SIZE],
+				    bool use_ni)
+{
+	ZERO_STRUCTP(ctx);
+
+	if (use_ni) {
+		samba_aesni_128_set_encrypt_key(K, ctx->ni_rk);
+		ctx->use_ni = true;
+	}
+	if (!ctx->use_ni) {
+		AES_set_encrypt_key(K, 128, &ctx->aes_key);
+	}
+
+	/*
+	 * Step 1: generate H (ctx->Y is the zero block here)
+	 */
+	aes_gcm_128_encrypt_block(ctx, ctx->Y, ctx->H);
+
+	if (!ctx->use_ni) {
+		aes_gcm_128_generic_table(ctx);
+	}
+
+	/*
+	 * Step 2: generate J0
+	 */
+	memcpy(ctx->J0, IV, AES_GCM_128_IV_SIZE);
+	aes_gcm_128_inc32(ctx->J0);
+
+	/*
+	 * The first counter block used for
+	 * the payload is inc32(J0).
+	 */
+	memcpy(ctx->CB, ctx->J0, AES_BLOCK_SIZE);
+	aes_gcm_128_inc32(ctx->CB);
+	ctx->c_ofs = AES_BLOCK_SIZE;
+}
+
+void aes_gcm_128_init(struct aes_gcm_128_context *ctx,
+		      const uint8_t K[AES_BLOCK_SIZE],
+		      const uint8_t IV[AES_GCM_128_IV_SIZE])
+{
+	aes_gcm_128_init_common(ctx, K, IV, aes_gcm_128_have_ni());
+}
+
+void aes_gcm_128_init_generic(struct aes_gcm_128_context *ctx,
+			      const uint8_t K[AES_BLOCK_SIZE],
+			      const uint8_t IV[AES_GCM_128_IV_SIZE])
+{
+	aes_gcm_128_init_common(ctx, K, IV, false);
+}
+
+static void aes_gcm_128_ghash_update(struct aes_gcm_128_context *ctx,
+				     struct aes_gcm_128_tmp *tmp,
+				     const uint8_t *v, size_t v_len)
+{
+	tmp->total += v_len;
+
+	if (tmp->ofs > 0) {
+		size_t n = MIN(AES_BLOCK_SIZE - tmp->ofs, v_len);
+
+		memcpy(tmp->block + tmp->ofs, v, n);
+		tmp->ofs += n;
+		v += n;
+		v_len -= n;
+
+		if (tmp->ofs < AES_BLOCK_SIZE) {
+			return;
+		}
+
+		aes_gcm_128_ghash(ctx, tmp->block, 1);
+		tmp->ofs = 0;
+	}
+
+	if (v_len >= AES_BLOCK_SIZE) {
+		size_t num_blocks = v_len / AES_BLOCK_SIZE;
+
+		aes_gcm_128_ghash(ctx, v, num_blocks);
+		v += num_blocks * AES_BLOCK_SIZE;
+		v_len -= num_blocks * AES_BLOCK_SIZE;
+	}
+
+	if (v_len > 0) {
+		memcpy(tmp->block, v, v_len);
+		tmp->ofs = v_len;
+	}
+}
+
+static void aes_gcm_128_ghash_flush(struct aes_gcm_128_context *ctx,
+				    struct aes_gcm_128_tmp *tmp)
+{
+	if (tmp->ofs == 0) {
+		return;
+	}
+
+	memset(tmp->block + tmp->ofs, 0, AES_BLOCK_SIZE - tmp->ofs);
+	aes_gcm_128_ghash(ctx, tmp->block, 1);
+	tmp->ofs = 0;
+}
+
+void aes_gcm_128_updateA(struct aes_gcm_128_context *ctx,
+			 const uint8_t *a, size_t a_len)
+{
+	aes_gcm_128_ghash_update(ctx, &ctx->A, a, a_len);
+}
+
+void aes_gcm_128_updateC(struct aes_gcm_128_context *ctx,
+			 const uint8_t *c, size_t c_len)
+{
+	/*
+	 * The additional data is complete
+	 * once the first ciphertext arrives.
+	 */
+	aes_gcm_128_ghash_flush(ctx, &ctx->A);
+	aes_gcm_128_ghash_update(ctx, &ctx->C, c, c_len);
+}
+
+void aes_gcm_128_crypt(struct aes_gcm_128_context *ctx,
+		       uint8_t *m, size_t m_len)
+{
+	/*
+	 * First use up the key stream left over
+	 * from a previous partial block.
+	 */
+	while (m_len > 0 && ctx->c_ofs < AES_BLOCK_SIZE) {
+		m[0] ^= ctx->c[ctx->c_ofs];
+		m += 1;
+		m_len -= 1;
+		ctx->c_ofs += 1;
+	}
+
+	if (m_len >= AES_BLOCK_SIZE) {
+		size_t num_blocks = m_len / AES_BLOCK_SIZE;
+
+		aes_gcm_128_ctr(ctx, m, num_blocks);
+		m += num_blocks * AES_BLOCK_SIZE;
+		m_len -= num_blocks * AES_BLOCK_SIZE;
+	}
+
+	if (m_len > 0) {
+		aes_gcm_128_encrypt_block(ctx, ctx->CB, ctx->c);
+		aes_gcm_128_inc32(ctx->CB);
+		ctx->c_ofs = 0;
+	}
+
+	while (m_len > 0) {
+		m[0] ^= ctx->c[ctx->c_ofs];
+		m += 1;
+		m_len -= 1;
+		ctx->c_ofs += 1;
+	}
+}
+
+void aes_gcm_128_digest(struct aes_gcm_128_context *ctx,
+			uint8_t T[AES_BLOCK_SIZE])
+{
+	uint8_t L[AES_BLOCK_SIZE];
+	uint8_t S[AES_BLOCK_SIZE];
+
+	aes_gcm_128_ghash_flush(ctx, &ctx->A);
+	aes_gcm_128_ghash_flush(ctx, &ctx->C);
+
+	aes_gcm_128_put_be64(L, (uint64_t)ctx->A.total * 8);
+	aes_gcm_128_put_be64(L + 8, (uint64_t)ctx->C.total * 8);
+	aes_gcm_128_ghash(ctx, L, 1);
+
+	aes_gcm_128_encrypt_block(ctx, ctx->J0, S);
+	aes_gcm_128_xor(S, ctx->Y, T);
+
+	ZERO_STRUCT(S);
+	ZERO_STRUCTP(ctx);
+}
@@ -0,0 +1,311 @@
+/*
+   AES-GCM-128 tests
+
+   Copyright (C) The Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "replace.h"
+#include "../lib/util/samba_util.h"
+#include "../lib/crypto/crypto.h"
+
+struct torture_context;
+bool torture_local_crypto_aes_gcm_128(struct torture_context *torture);
+bool torture_local_crypto_aes_128_bench(struct torture_context *torture);
+
+struct aes_gcm_128_testvector {
+	DATA_BLOB K;
+	DATA_BLOB IV;
+	DATA_BLOB A;
+	DATA_BLOB P;
+	DATA_BLOB C;
+	DATA_BLOB T;
+};
+
+static bool aes_gcm_128_check(const char *name, uint32_t i, bool generic,
+			      const struct aes_gcm_128_testvector *v)
+{
+	struct aes_gcm_128_context ctx;
+	uint8_t T[AES_BLOCK_SIZE];
+	uint8_t *C = NULL;
+	size_t split;
+	bool ret = true;
+
+	C = talloc_zero_array(NULL, uint8_t, v->P.length + 1);
+	if (C == NULL) {
+		return false;
+	}
+
+	/*
+	 * Encrypt and decrypt with the data split at
+	 * every possible offset, in order to verify
+	 * the handling of partial blocks.
+	 */
+	for (split = 0; split <= v->P.length; split++) {
+		size_t rest = v->P.length - split;
+		int e1, e2, e3;
+
+		if (v->P.length > 0) {
+			memcpy(C, v->P.data, v->P.length);
+		}
+
+		if (generic) {
+			aes_gcm_128_init_generic(&ctx, v->K.data, v->IV.data);
+		} else {
+			aes_gcm_128_init(&ctx, v->K.data, v->IV.data);
+		}
+		aes_gcm_128_updateA(&ctx, v->A.data, v->A.length);
+		aes_gcm_128_crypt(&ctx, C, split);
+		aes_gcm_128_updateC(&ctx, C, split);
+		aes_gcm_128_crypt(&ctx, C + split, rest);
+		aes_gcm_128_updateC(&ctx, C + split, rest);
+		aes_gcm_128_digest(&ctx, T);
+
+		e1 = 0;
+		if (v->C.length > 0) {
+			e1 = memcmp(v->C.data, C, v->C.length);
+		}
+		e2 = memcmp(v->T.data, T, sizeof(T));
+
+		if (generic) {
+			aes_gcm_128_init_generic(&ctx, v->K.data, v->IV.data);
+		} else {
+			aes_gcm_128_init(&ctx, v->K.data, v->IV.data);
+		}
+		aes_gcm_128_updateA(&ctx, v->A.data, v->A.length);
+		aes_gcm_128_updateC(&ctx, C, split);
+		aes_gcm_128_crypt(&ctx, C, split);
+		aes_gcm_128_updateC(&ctx, C + split, rest);
+		aes_gcm_128_crypt(&ctx, C + split, rest);
+		aes_gcm_128_digest(&ctx, T);
+
+		e3 = memcmp(v->T.data, T, sizeof(T));
+		if (v->P.length > 0) {
+			e3 |= memcmp(v->P.data, C, v->P.length);
+		}
+
+		if (e1 != 0 || e2 != 0 || e3 != 0) {
+			printf("%s test[%u] split[%u]: failed\n",
+			       name, i, (unsigned)split);
+			dump_data(0, v->P.data, v->P.length);
+			dump_data(0, v->C.data, v->C.length);
+			dump_data(0, v->T.data, v->T.length);
+			dump_data(0, T, sizeof(T));
+			ret = false;
+			break;
+		}
+	}
+
+	TALLOC_FREE(C);
+	return ret;
+}
+
+/*
+ This uses the test values from the GCM specification
+ (McGrew/Viega), test cases 1-4
+*/
+bool torture_local_crypto_aes_gcm_128(struct torture_context *torture)
+{
+	bool ret = true;
+	uint32_t i;
+	struct aes_gcm_128_testvector testarray[5];
+
+	TALLOC_CTX *tctx = talloc_new(torture);
+	if (!tctx) { return false; };
+
+	testarray[0].K = strhex_to_data_blob(tctx,
+				"00000000000000000000000000000000");
+	testarray[0].IV = strhex_to_data_blob(tctx,
+				"000000000000000000000000");
+	testarray[0].A = data_blob_null;
+	testarray[0].P = data_blob_null;
+	testarray[0].C = data_blob_null;
+	testarray[0].T = strhex_to_data_blob(tctx,
+				"58e2fccefa7e3061367f1d57a4e7455a");
+
+	testarray[1].K = strhex_to_data_blob(tctx,
+				"00000000000000000000000000000000");
+	testarray[1].IV = strhex_to_data_blob(tctx,
+				"000000000000000000000000");
+	testarray[1].A = data_blob_null;
+	testarray[1].P = strhex_to_data_blob(tctx,
+				"00000000000000000000000000000000");
+	testarray[1].C = strhex_to_data_blob(tctx,
+				"0388dace60b6a392f328c2b971b2fe78");
+	testarray[1].T = strhex_to_data_blob(tctx,
+				"ab6e47d42cec13bdf53a67b21257bddf");
+
+	testarray[2].K = strhex_to_data_blob(tctx,
+				"feffe9928665731c6d6a8f9467308308");
+	testarray[2].IV = strhex_to_data_blob(tctx,
+				"cafebabefacedbaddecaf888");
+	testarray[2].A = data_blob_null;
+	testarray[2].P = strhex_to_data_blob(tctx,
+				"d9313225f88406e5a55909c5aff5269a"
+				"86a7a9531534f7da2e4c303d8a318a72"
+				"1c3c0c95956809532fcf0e2449a6b525"
+				"b16aedf5aa0de657ba637b391aafd255");
+	testarray[2].C = strhex_to_data_blob(tctx,
+				"42831ec2217774244b7221b784d0d49c"
+				"e3aa212f2c02a4e035c17e2329aca12e"
+				"21d514b25466931c7d8f6a5aac84aa05"
+				"1ba30b396a0aac973d58e091473f5985");
+	testarray[2].T = strhex_to_data_blob(tctx,
+				"4d5c2af327cd64a62cf35abd2ba6fab4");
+
+	testarray[3].K = strhex_to_data_blob(tctx,
+				"feffe9928665731c6d6a8f9467308308");
+	testarray[3].IV = strhex_to_data_blob(tctx,
+				"cafebabefacedbaddecaf888");
+	testarray[3].A = strhex_to_data_blob(tctx,
+				"feedfacedeadbeeffeedfacedeadbeef"
+				"abaddad2");
+	testarray[3].P = strhex_to_data_blob(tctx,
+				"d9313225f88406e5a55909c5aff5269a"
+				"86a7a9531534f7da2e4c303d8a318a72"
+				"1c3c0c95956809532fcf0e2449a6b525"
+				"b16aedf5aa0de657ba637b39");
+	testarray[3].C = strhex_to_data_blob(tctx,
+				"42831ec2217774244b7221b784d0d49c"
+				"e3aa212f2c02a4e035c17e2329aca12e"
+				"21d514b25466931c7d8f6a5aac84aa05"
+				"1ba30b396a0aac973d58e091");
+	testarray[3].T = strhex_to_data_blob(tctx,
+				"5bc94fbc3221a5db94fae95ae7121a47");
+
+	ZERO_STRUCT(testarray[4]);
+
+	for (i=0; testarray[i].T.length != 0; i++) {
+		if (!aes_gcm_128_check("aes_gcm_128", i, false,
+				       &testarray[i])) {
+			ret = false;
+		}
+		if (!aes_gcm_128_check("aes_gcm_128_generic", i, true,
+				       &testarray[i])) {
+			ret = false;
+		}
+	}
+
+	talloc_free(tctx);
+	return ret;
+}
+
+#define AES_128_BENCH_BUFSIZE (64 * 1024)
+#define AES_128_BENCH_LOOPS 256
+
+static double aes_128_bench_mbs(const struct timeval *start)
+{
+	double secs = timeval_elapsed(start);
+
+	if (secs <= 0) {
+		return 0;
+	}
+
+	return ((double)AES_128_BENCH_BUFSIZE * AES_128_BENCH_LOOPS) /
+		(secs * 1024 * 1024);
+}
+
+/*
+ Compare the throughput of AES-CCM-128 and AES-GCM-128
+ with the buffer layout used for SMB2 encryption:
+ a 32 byte transform header as additional data
+ and a 64k payload.
+*/
+bool torture_local_crypto_aes_128_bench(struct torture_context *torture)
+{
+	uint8_t key[AES_BLOCK_SIZE];
+	uint8_t nonce[16];
+	uint8_t aad[32];
+	uint8_t sig[AES_BLOCK_SIZE];
+	uint8_t sig_generic[AES_BLOCK_SIZE];
+	uint8_t *buf = NULL;
+	struct timeval start;
+	uint32_t i;
+	bool ret = true;
+
+	buf = talloc_zero_array(NULL, uint8_t, AES_128_BENCH_BUFSIZE);
+	if (buf == NULL) {
+		return false;
+	}
+
+	generate_random_buffer(key, sizeof(key));
+	generate_random_buffer(nonce, sizeof(nonce));
+	generate_random_buffer(aad, sizeof(aad));
+	generate_random_buffer(buf, AES_128_BENCH_BUFSIZE);
+
+	start = timeval_current();
+	for (i = 0; i < AES_128_BENCH_LOOPS; i++) {
+		struct aes_ccm_128_context ctx;
+
+		aes_ccm_128_init(&ctx, key, nonce,
+				 sizeof(aad), AES_128_BENCH_BUFSIZE);
+		aes_ccm_128_update(&ctx, aad, sizeof(aad));
+		aes_ccm_128_update(&ctx, buf, AES_128_BENCH_BUFSIZE);
+		aes_ccm_128_crypt(&ctx, buf, AES_128_BENCH_BUFSIZE);
+		aes_ccm_128_digest(&ctx, sig);
+	}
+	printf("aes_ccm_128:         %8.1f MB/s\n",
+	       aes_128_bench_mbs(&start));
+
+	start = timeval_current();
+	for (i = 0; i < AES_128_BENCH_LOOPS; i++) {
+		struct aes_gcm_128_context ctx;
+
+		aes_gcm_128_init_generic(&ctx, key, nonce);
+		aes_gcm_128_updateA(&ctx, aad, sizeof(aad));
+		aes_gcm_128_crypt(&ctx, buf, AES_128_BENCH_BUFSIZE);
+		aes_gcm_128_updateC(&ctx, buf, AES_128_BENCH_BUFSIZE);
+		aes_gcm_128_digest(&ctx, sig_generic);
+	}
+	printf("aes_gcm_128_generic: %8.1f MB/s\n",
+	       aes_128_bench_mbs(&start));
+
+	if (!aes_gcm_128_have_ni()) {
+		printf("aes_gcm_128 (AES-NI/PCLMULQDQ) not available\n");
+		goto done;
+	}
+
+	/*
+	 * Decrypt the data again, using the same keystream,
+	 * the result must match the generic implementation.
+	 */
+	start = timeval_current();
+	for (i = 0; i < AES_128_BENCH_LOOPS; i++) {
+		struct aes_gcm_128_context ctx;
+
+		aes_gcm_128_init(&ctx, key, nonce);
+		aes_gcm_128_updateA(&ctx, aad, sizeof(aad));
+		aes_gcm_128_updateC(&ctx, buf, AES_128_BENCH_BUFSIZE);
+		aes_gcm_128_crypt(&ctx, buf, AES_128_BENCH_BUFSIZE);
+		aes_gcm_128_digest(&ctx, sig);
+
+		if (memcmp(sig, sig_generic, sizeof(sig)) != 0) {
+			printf("aes_gcm_128 loop[%u]: digest mismatch\n", i);
+			ret = false;
+			goto done;
+		}
+
+		aes_gcm_128_init(&ctx, key, nonce);
+		aes_gcm_128_updateA(&ctx, aad, sizeof(aad));
+		aes_gcm_128_crypt(&ctx, buf, AES_128_BENCH_BUFSIZE);
+		aes_gcm_128_updateC(&ctx, buf, AES_128_BENCH_BUFSIZE);
+		aes_gcm_128_digest(&ctx, sig_generic);
+	}
+	printf("aes_gcm_128 (NI):    %8.1f MB/s\n",
+	       aes_128_bench_mbs(&start) * 2);
+
+done:
+	TALLOC_FREE(buf);
+	return ret;
+}
@@ -0,0 +1,402 @@
+/*
+   Instruction set extensions for the crypto primitives
+
+   Copyright (C) The Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "replace.h"
+#include "../lib/crypto/crypto.h"
+
+#if defined(HAVE_AESNI_INTRINSICS) || defined(HAVE_SHANI_INTRINSICS)
+#include <cpuid.h>
+#endif
+#ifdef HAVE_AESNI_INTRINSICS
+#include <wmmintrin.h>
+#endif
+#ifdef HAVE_SHANI_INTRINSICS
+#include <immintrin.h>
+#endif
+
+#define CRYPTO_ACCEL_AESNI	0x01
+#define CRYPTO_ACCEL_PCLMUL	0x02
+#define CRYPTO_ACCEL_SHANI	0x04
+
+/*
+ * The cpu features are only queried once,
+ * the result is cached for the lifetime of the process.
+ */
+static unsigned crypto_accel_features(void)
+{
+	static int features = -1;
+#if defined(HAVE_AESNI_INTRINSICS) || defined(HAVE_SHANI_INTRINSICS)
+	unsigned int eax, ebx, ecx, edx;
+	unsigned int max_leaf;
+#endif
+
+	if (features != -1) {
+		return features;
+	}
+
+	features = 0;
+
+#if defined(HAVE_AESNI_INTRINSICS) || defined(HAVE_SHANI_INTRINSICS)
+	max_leaf = __get_cpuid_max(0, NULL);
+	if (max_leaf < 1) {
+		return features;
+	}
+
+	__cpuid(1, eax, ebx, ecx, edx);
+
+#ifdef HAVE_AESNI_INTRINSICS
+	if (ecx & bit_AES) {
+		features |= CRYPTO_ACCEL_AESNI;
+	}
+	if ((ecx & bit_PCLMUL) && (ecx & bit_SSSE3)) {
+		features |= CRYPTO_ACCEL_PCLMUL;
+	}
+#endif
+
+#ifdef HAVE_SHANI_INTRINSICS
+	if ((ecx & bit_SSE4_1) && max_leaf >= 7) {
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		/* bit 29 of ebx: SHA extensions */
+		if (ebx & (1U << 29)) {
+			features |= CRYPTO_ACCEL_SHANI;
+		}
+	}
+#endif
+#endif
+
+	return features;
+}
+
+bool samba_crypto_have_aesni(void)
+{
+	return (crypto_accel_features() & CRYPTO_ACCEL_AESNI) != 0;
+}
+
+bool samba_crypto_have_pclmul(void)
+{
+	return (crypto_accel_features() & CRYPTO_ACCEL_PCLMUL) != 0;
+}
+
+bool samba_crypto_have_shani(void)
+{
+	return (crypto_accel_features() & CRYPTO_ACCEL_SHANI) != 0;
+}
+
+#ifdef HAVE_AESNI_INTRINSICS
+
+#define CRYPTO_ACCEL_AESNI_TARGET __attribute__((target("aes")))
+
+CRYPTO_ACCEL_AESNI_TARGET
+static inline __m128i aesni_128_key_assist(__m128i t1, __m128i t2)
+{
+	__m128i t3;
+
+	t2 = _mm_shuffle_epi32(t2, 0xff);
+	t3 = _mm_slli_si128(t1, 0x4);
+	t1 = _mm_xor_si128(t1, t3);
+	t3 = _mm_slli_si128(t3, 0x4);
+	t1 = _mm_xor_si128(t1, t3);
+	t3 = _mm_slli_si128(t3, 0x4);
+	t1 = _mm_xor_si128(t1, t3);
+	t1 = _mm_xor_si128(t1, t2);
+
+	return t1;
+}
+
+CRYPTO_ACCEL_AESNI_TARGET
+void samba_aesni_128_set_encrypt_key(const uint8_t K[AES_BLOCK_SIZE],
+			uint8_t rk[AESNI_128_ROUND_KEYS][AES_BLOCK_SIZE])
+{
+	__m128i k;
+
+	k = _mm_loadu_si128((const __m128i *)K);
+	_mm_storeu_si128((__m128i *)rk[0], k);
+
+#define AESNI_128_EXPAND(i, rcon) do { \
+	k = aesni_128_key_assist(k, _mm_aeskeygenassist_si128(k, rcon)); \
+	_mm_storeu_si128((__m128i *)rk[i], k); \
+} while (0)
+
+	AESNI_128_EXPAND(1, 0x01);
+	AESNI_128_EXPAND(2, 0x02);
+	AESNI_128_EXPAND(3, 0x04);
+	AESNI_128_EXPAND(4, 0x08);
+	AESNI_128_EXPAND(5, 0x10);
+	AESNI_128_EXPAND(6, 0x20);
+	AESNI_128_EXPAND(7, 0x40);
+	AESNI_128_EXPAND(8, 0x80);
+	AESNI_128_EXPAND(9, 0x1b);
+	AESNI_128_EXPAND(10, 0x36);
+
+#undef AESNI_128_EXPAND
+}
+
+CRYPTO_ACCEL_AESNI_TARGET
+static inline void aesni_128_load_key(
+			const uint8_t rk[AESNI_128_ROUND_KEYS][AES_BLOCK_SIZE],
+			__m128i k[AESNI_128_ROUND_KEYS])
+{
+	int i;
+
+	for (i = 0; i < AESNI_128_ROUND_KEYS; i++) {
+		k[i] = _mm_loadu_si128((const __m128i *)rk[i]);
+	}
+}
+
+CRYPTO_ACCEL_AESNI_TARGET
+static inline __m128i aesni_128_encrypt(const __m128i k[AESNI_128_ROUND_KEYS],
+					__m128i v)
+{
+	int i;
+
+	v = _mm_xor_si128(v, k[0]);
+	for (i = 1; i < AESNI_128_ROUND_KEYS - 1; i++) {
+		v = _mm_aesenc_si128(v, k[i]);
+	}
+	return _mm_aesenclast_si128(v, k[AESNI_128_ROUND_KEYS - 1]);
+}
+
+CRYPTO_ACCEL_AESNI_TARGET
+void samba_aesni_128_encrypt(
+			const uint8_t rk[AESNI_128_ROUND_KEYS][AES_BLOCK_SIZE],
+			const uint8_t in[AES_BLOCK_SIZE],
+			uint8_t out[AES_BLOCK_SIZE])
+{
+	__m128i k[AESNI_128_ROUND_KEYS];
+	__m128i v;
+
+	aesni_128_load_key(rk, k);
+
+	v = _mm_loadu_si128((const __m128i *)in);
+	v = aesni_128_encrypt(k, v);
+	_mm_storeu_si128((__m128i *)out, v);
+}
+
+CRYPTO_ACCEL_AESNI_TARGET
+void samba_aesni_128_cbc_mac(
+			const uint8_t rk[AESNI_128_ROUND_KEYS][AES_BLOCK_SIZE],
+			uint8_t X[AES_BLOCK_SIZE],
+			const uint8_t *m, size_t num_blocks)
+{
+	__m128i k[AESNI_128_ROUND_KEYS];
+	__m128i x;
+
+	aesni_128_load_key(rk, k);
+
+	/*
+	 * The round keys and the chaining value stay
+	 * in registers for the whole message.
+	 */
+	x = _mm_loadu_si128((const __m128i *)X);
+	while (num_blocks > 0) {
+		__m128i v = _mm_loadu_si128((const __m128i *)m);
+
+		x = aesni_128_encrypt(k, _mm_xor_si128(x, v));
+
+		m += AES_BLOCK_SIZE;
+		num_blocks -= 1;
+	}
+	_mm_storeu_si128((__m128i *)X, x);
+}
+
+CRYPTO_ACCEL_AESNI_TARGET
+void samba_aesni_128_ctr32(
+			const uint8_t rk[AESNI_128_ROUND_KEYS][AES_BLOCK_SIZE],
+			uint8_t A[AES_BLOCK_SIZE],
+			uint8_t *m, size_t num_blocks)
+{
+	__m128i k[AESNI_128_ROUND_KEYS];
+	uint32_t ctr;
+
+	aesni_128_load_key(rk, k);
+
+	ctr  = (uint32_t)A[12] << 24;
+	ctr |= (uint32_t)A[13] << 16;
+	ctr |= (uint32_t)A[14] << 8;
+	ctr |= (uint32_t)A[15];
+
+	while (num_blocks > 0) {
+		__m128i s, v;
+
+		A[12] = (ctr >> 24) & 0xFF;
+		A[13] = (ctr >> 16) & 0xFF;
+		A[14] = (ctr >> 8) & 0xFF;
+		A[15] = ctr & 0xFF;
+
+		s = aesni_128_encrypt(k, _mm_loadu_si128((const __m128i *)A));
+		v = _mm_loadu_si128((const __m128i *)m);
+		_mm_storeu_si128((__m128i *)m, _mm_xor_si128(v, s));
+
+		ctr += 1;
+		m += AES_BLOCK_SIZE;
+		num_blocks -= 1;
+	}
+
+	A[12] = (ctr >> 24) & 0xFF;
+	A[13] = (ctr >> 16) & 0xFF;
+	A[14] = (ctr >> 8) & 0xFF;
+	A[15] = ctr & 0xFF;
+}
+
+#else /* HAVE_AESNI_INTRINSICS */
+
+void samba_aesni_128_set_encrypt_key(const uint8_t K[AES_BLOCK_SIZE],
+			uint8_t rk[AESNI_128_ROUND_KEYS][AES_BLOCK_SIZE])
+{
+	abort();
+}
+
+void samba_aesni_128_encrypt(
+			const uint8_t rk[AESNI_128_ROUND_KEYS][AES_BLOCK_SIZE],
+			const uint8_t in[AES_BLOCK_SIZE],
+			uint8_t out[AES_BLOCK_SIZE])
+{
+	abort();
+}
+
+void samba_aesni_128_cbc_mac(
+			const uint8_t rk[AESNI_128_ROUND_KEYS][AES_BLOCK_SIZE],
+			uint8_t X[AES_BLOCK_SIZE],
+			const uint8_t *m, size_t num_blocks)
+{
+	abort();
+}
+
+void samba_aesni_128_ctr32(
+			const uint8_t rk[AESNI_128_ROUND_KEYS][AES_BLOCK_SIZE],
+			uint8_t A[AES_BLOCK_SIZE],
+			uint8_t *m, size_t num_blocks)
+{
+	abort();
+}
+
+#endif /* HAVE_AESNI_INTRINSICS */
+
+#ifdef HAVE_SHANI_INTRINSICS
+
+/*
+ * SHA-256 using the SHA extensions, the message schedule
+ * is computed 4 rounds ahead with sha256msg1/sha256msg2,
+ * see Intel's "New Instructions Supporting the Secure Hash
+ * Algorithm on Intel Architecture Processors" white paper.
+ */
+
+#define CRYPTO_ACCEL_SHANI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+
+static const uint32_t shani_sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+CRYPTO_ACCEL_SHANI_TARGET
+void samba_shani_sha256_blocks(uint32_t state[8],
+			       const uint8_t *data, size_t num_blocks)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					     0x0405060700010203ULL);
+	__m128i state0, state1;
+	__m128i tmp;
+
+	/*
+	 * sha256rnds2 wants the state as ABEF and CDGH
+	 */
+	tmp = _mm_loadu_si128((const __m128i *)&state[0]);
+	state1 = _mm_loadu_si128((const __m128i *)&state[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xB1);			/* CDAB */
+	state1 = _mm_shuffle_epi32(state1, 0x1B);		/* EFGH */
+	state0 = _mm_alignr_epi8(tmp, state1, 8);		/* ABEF */
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);		/* CDGH */
+
+	while (num_blocks > 0) {
+		__m128i abef = state0;
+		__m128i cdgh = state1;
+		__m128i w[4];
+		int g;
+
+		for (g = 0; g < 16; g++) {
+			__m128i *cur = &w[g % 4];
+			__m128i msg;
+
+			if (g < 4) {
+				*cur = _mm_loadu_si128(
+					(const __m128i *)(data + 16 * g));
+				*cur = _mm_shuffle_epi8(*cur, bswap);
+			}
+
+			msg = _mm_add_epi32(*cur, _mm_loadu_si128(
+				(const __m128i *)&shani_sha256_k[4 * g]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+
+			if (g >= 3 && g <= 14) {
+				__m128i *next = &w[(g + 1) % 4];
+
+				tmp = _mm_alignr_epi8(*cur, w[(g + 3) % 4], 4);
+				*next = _mm_add_epi32(*next, tmp);
+				*next = _mm_sha256msg2_epu32(*next, *cur);
+			}
+
+			msg = _mm_shuffle_epi32(msg, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+			if (g >= 1 && g <= 12) {
+				__m128i *prev = &w[(g + 3) % 4];
+
+				*prev = _mm_sha256msg1_epu32(*prev, *cur);
+			}
+		}
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+
+		data += 64;
+		num_blocks -= 1;
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);			/* FEBA */
+	state1 = _mm_shuffle_epi32(state1, 0xB1);		/* DCHG */
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);		/* DCBA */
+	state1 = _mm_alignr_epi8(state1, tmp, 8);		/* ABEF */
+
+	_mm_storeu_si128((__m128i *)&state[0], state0);
+	_mm_storeu_si128((__m128i *)&state[4], state1);
+}
+
+#else /* HAVE_SHANI_INTRINSICS */
+
+void samba_shani_sha256_blocks(uint32_t state[8],
+			       const uint8_t *data, size_t num_blocks)
+{
+	abort();
+}
+
+#endif /* HAVE_SHANI_INTRINSICS */
@@ -0,0 +1,70 @@
+/*
+   Instruction set extensions for the crypto primitives
+
+   Copyright (C) The Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIB_CRYPTO_CRYPTO_ACCEL_H
+#define LIB_CRYPTO_CRYPTO_ACCEL_H
+
+/*
+ * The samba_crypto_have_*() functions check at runtime
+ * whether the cpu supports the instructions and whether
+ * the code was compiled with them.
+ *
+ * The other functions may only be called if the
+ * matching samba_crypto_have_*() returned true.
+ */
+
+#define AESNI_128_ROUND_KEYS 11
+
+/* AES-NI */
+bool samba_crypto_have_aesni(void);
+/* PCLMULQDQ and SSSE3 */
+bool samba_crypto_have_pclmul(void);
+/* SHA extensions and SSE4.1 */
+bool samba_crypto_have_shani(void);
+
+void samba_aesni_128_set_encrypt_key(const uint8_t K[AES_BLOCK_SIZE],
+			uint8_t rk[AESNI_128_ROUND_KEYS][AES_BLOCK_SIZE]);
+void samba_aesni_128_encrypt(
+			const uint8_t rk[AESNI_128_ROUND_KEYS][AES_BLOCK_SIZE],
+			const uint8_t in[AES_BLOCK_SIZE],
+			uint8_t out[AES_BLOCK_SIZE]);
+/*
+ * X = E(X ^ m_i) for all blocks in m
+ */
+void samba_aesni_128_cbc_mac(
+			const uint8_t rk[AESNI_128_ROUND_KEYS][AES_BLOCK_SIZE],
+			uint8_t X[AES_BLOCK_SIZE],
+			const uint8_t *m, size_t num_blocks);
+/*
+ * m_i ^= E(A_i) for all blocks in m, the last 4 bytes of A
+ * are a big endian counter. A is returned with the counter
+ * for the block after m.
+ */
+void samba_aesni_128_ctr32(
+			const uint8_t rk[AESNI_128_ROUND_KEYS][AES_BLOCK_SIZE],
+			uint8_t A[AES_BLOCK_SIZE],
+			uint8_t *m, size_t num_blocks);
+
+/*
+ * The SHA-256 compression function for num_blocks 64 byte blocks.
+ */
+void samba_shani_sha256_blocks(uint32_t state[8],
+			       const uint8_t *data, size_t num_blocks);
+
+#endif /* LIB_CRYPTO_CRYPTO_ACCEL_H */
@@ -65,6 +65,32 @@ _PUBLIC_ void hmac_sha256_init(const uint8_t *key, size_t key_len, struct HMACSH
 
         samba_SHA256_Init(&ctx->ctx);
         samba_SHA256_Update(&ctx->ctx, ctx->k_ipad, 64);
+        ctx->key = NULL;
+}
+
+/***********************************************************************
+ precompute the hash states of the inner and outer pads for a key.
+***********************************************************************/
+_PUBLIC_ void hmac_sha256_key_setup(const uint8_t *key, size_t key_len, struct hmac_sha256_key *hkey)
+{
+        struct HMACSHA256Context ctx;
+
+        hmac_sha256_init(key, key_len, &ctx);
+
+        hkey->ictx = ctx.ctx;
+        samba_SHA256_Init(&hkey->octx);
+        samba_SHA256_Update(&hkey->octx, ctx.k_opad, 64);
+
+        ZERO_STRUCT(ctx);
+}
+
+/***********************************************************************
+ hmac_sha256 initialisation from a precomputed key.
+***********************************************************************/
+_PUBLIC_ void hmac_sha256_init_key(const struct hmac_sha256_key *hkey, struct HMACSHA256Context *ctx)
+{
+        ctx->ctx = hkey->ictx;
+        ctx->key = hkey;
 }
 
 /***********************************************************************
@@ -84,8 +110,12 @@ _PUBLIC_ void hmac_sha256_final(uint8_t digest[SHA256_DIGEST_LENGTH], struct HMA
 
         samba_SHA256_Final(digest, &ctx->ctx);
 
-        samba_SHA256_Init(&ctx_o);
-        samba_SHA256_Update(&ctx_o, ctx->k_opad, 64);
+        if (ctx->key != NULL) {
+                ctx_o = ctx->key->octx;
+        } else {
+                samba_SHA256_Init(&ctx_o);
+                samba_SHA256_Update(&ctx_o, ctx->k_opad, 64);
+        }
         samba_SHA256_Update(&ctx_o, digest, SHA256_DIGEST_LENGTH);
         samba_SHA256_Final(digest, &ctx_o);
 }
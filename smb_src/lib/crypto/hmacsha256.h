@@ -25,13 +25,26 @@
 
 #ifndef _HMAC_SHA256_H
 
+/*
+ * The hash states after the inner and outer pad,
+ * they only depend on the key and can be reused for many messages.
+ */
+struct hmac_sha256_key {
+        SHA256_CTX ictx;
+        SHA256_CTX octx;
+};
+
 struct HMACSHA256Context {
         SHA256_CTX ctx;
         uint8_t k_ipad[65];    
         uint8_t k_opad[65];
+        const struct hmac_sha256_key *key;
 };
 
 void hmac_sha256_init(const uint8_t *key, size_t key_len, struct HMACSHA256Context *ctx);
+void hmac_sha256_key_setup(const uint8_t *key, size_t key_len, struct hmac_sha256_key *hkey);
+/* hkey needs to stay valid until hmac_sha256_final() */
+void hmac_sha256_init_key(const struct hmac_sha256_key *hkey, struct HMACSHA256Context *ctx);
 void hmac_sha256_update(const uint8_t *data, size_t data_len, struct HMACSHA256Context *ctx);
 void hmac_sha256_final(uint8_t digest[SHA256_DIGEST_LENGTH], struct HMACSHA256Context *ctx);
 
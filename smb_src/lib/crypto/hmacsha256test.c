@@ -0,0 +1,144 @@
+/*
+   Unix SMB/CIFS implementation.
+   HMAC SHA256 tests
+
+   Copyright (C) The Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "replace.h"
+#include "../lib/util/samba_util.h"
+#include "../lib/crypto/crypto.h"
+
+struct torture_context;
+bool torture_local_crypto_hmacsha256(struct torture_context *torture);
+
+static DATA_BLOB data_blob_repeat_byte(TALLOC_CTX *mem_ctx,
+				       uint8_t byte, size_t length)
+{
+	DATA_BLOB b = data_blob_talloc(mem_ctx, NULL, length);
+	memset(b.data, byte, length);
+	return b;
+}
+
+/*
+ This uses the test values from rfc 4231 (without the
+ truncated test case 5) and a multi block message.
+
+ Every test is run with hmac_sha256_init() and with a
+ precomputed key from hmac_sha256_key_setup(), the latter
+ feeds the data in small pieces.
+*/
+bool torture_local_crypto_hmacsha256(struct torture_context *torture)
+{
+	bool ret = true;
+	uint32_t i;
+	struct {
+		DATA_BLOB key;
+		DATA_BLOB data;
+		DATA_BLOB sha256;
+	} testarray[8];
+
+	TALLOC_CTX *tctx = talloc_new(torture);
+	if (!tctx) { return false; };
+
+	testarray[0].key	= data_blob_repeat_byte(tctx, 0x0b, 20);
+	testarray[0].data	= data_blob_string_const("Hi There");
+	testarray[0].sha256	= strhex_to_data_blob(tctx,
+				"b0344c61d8db38535ca8afceaf0bf12b"
+				"881dc200c9833da726e9376c2e32cff7");
+
+	testarray[1].key	= data_blob_string_const("Jefe");
+	testarray[1].data	= data_blob_string_const("what do ya want for nothing?");
+	testarray[1].sha256	= strhex_to_data_blob(tctx,
+				"5bdcc146bf60754e6a042426089575c7"
+				"5a003f089d2739839dec58b964ec3843");
+
+	testarray[2].key	= data_blob_repeat_byte(tctx, 0xaa, 20);
+	testarray[2].data	= data_blob_repeat_byte(tctx, 0xdd, 50);
+	testarray[2].sha256	= strhex_to_data_blob(tctx,
+				"773ea91e36800e46854db8ebd09181a7"
+				"2959098b3ef8c122d9635514ced565fe");
+
+	testarray[3].key	= strhex_to_data_blob(tctx,
+				"0102030405060708090a0b0c0d0e0f10"
+				"111213141516171819");
+	testarray[3].data	= data_blob_repeat_byte(tctx, 0xcd, 50);
+	testarray[3].sha256	= strhex_to_data_blob(tctx,
+				"82558a389a443c0ea4cc819899f2083a"
+				"85f0faa3e578f8077a2e3ff46729665b");
+
+	testarray[4].key	= data_blob_repeat_byte(tctx, 0xaa, 131);
+	testarray[4].data	= data_blob_string_const("Test Using Larger Than Block-Size Key - Hash Key First");
+	testarray[4].sha256	= strhex_to_data_blob(tctx,
+				"60e431591ee0b67f0d8a26aacbf5b77f"
+				"8e0bc6213728c5140546040f0ee37f54");
+
+	testarray[5].key	= data_blob_repeat_byte(tctx, 0xaa, 131);
+	testarray[5].data	= data_blob_string_const("This is a test using a larger than block-size key "
+							 "and a larger than block-size data. The key needs to "
+							 "be hashed before being used by the HMAC algorithm.");
+	testarray[5].sha256	= strhex_to_data_blob(tctx,
+				"9b09ffa71b942fcb27635fbcd5b0e944"
+				"bfdc63644f0713938a7f51535c3a35e2");
+
+	testarray[6].key	= data_blob_repeat_byte(tctx, 0x0c, 16);
+	testarray[6].data	= data_blob_repeat_byte(tctx, 0x5a, 1000);
+	testarray[6].sha256	= strhex_to_data_blob(tctx,
+				"5b57f3ce959a5b50a80261eb332f02de"
+				"a7a07b534493f925765bb1b1777e7350");
+
+	ZERO_STRUCT(testarray[7]);
+
+	for (i=0; testarray[i].sha256.length != 0; i++) {
+		struct HMACSHA256Context ctx;
+		struct hmac_sha256_key hkey;
+		uint8_t sha256[SHA256_DIGEST_LENGTH];
+		uint8_t sha256_key[SHA256_DIGEST_LENGTH];
+		size_t ofs;
+		int e;
+
+		hmac_sha256_init(testarray[i].key.data,
+				 testarray[i].key.length, &ctx);
+		hmac_sha256_update(testarray[i].data.data,
+				   testarray[i].data.length, &ctx);
+		hmac_sha256_final(sha256, &ctx);
+
+		hmac_sha256_key_setup(testarray[i].key.data,
+				      testarray[i].key.length, &hkey);
+		hmac_sha256_init_key(&hkey, &ctx);
+		for (ofs = 0; ofs < testarray[i].data.length; ofs += 7) {
+			size_t len = MIN(7, testarray[i].data.length - ofs);
+
+			hmac_sha256_update(testarray[i].data.data + ofs,
+					   len, &ctx);
+		}
+		hmac_sha256_final(sha256_key, &ctx);
+
+		e = memcmp(testarray[i].sha256.data, sha256, sizeof(sha256));
+		e |= memcmp(testarray[i].sha256.data, sha256_key,
+			    sizeof(sha256_key));
+		if (e != 0) {
+			printf("hmacsha256 test[%u]: failed\n", i);
+			dump_data(0, testarray[i].key.data, testarray[i].key.length);
+			dump_data(0, testarray[i].data.data, testarray[i].data.length);
+			dump_data(0, testarray[i].sha256.data, testarray[i].sha256.length);
+			dump_data(0, sha256, sizeof(sha256));
+			dump_data(0, sha256_key, sizeof(sha256_key));
+			ret = false;
+		}
+	}
+	talloc_free(tctx);
+	return ret;
+}
@@ -39,7 +39,7 @@
  */
 
 #include "replace.h"
-#include "sha256.h"
+#include "../lib/crypto/crypto.h"
 
 #define Ch(x,y,z) (((x) & (y)) ^ ((~(x)) & (z)))
 #define Maj(x,y,z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
@@ -198,12 +198,30 @@ samba_SHA256_Update (SHA256_CTX *m, const void *v, size_t len)
 	++m->sz[1];
     offset = (old_sz / 8) % 64;
     while(len > 0){
-	size_t l = MIN(len, 64 - offset);
+	size_t l;
+
+	/*
+	 * With the SHA extensions complete blocks are
+	 * hashed directly from the caller's buffer.
+	 */
+	if (offset == 0 && len >= 64 && samba_crypto_have_shani()) {
+	    size_t num_blocks = len / 64;
+
+	    samba_shani_sha256_blocks(m->counter, p, num_blocks);
+	    p += num_blocks * 64;
+	    len -= num_blocks * 64;
+	    continue;
+	}
+
+	l = MIN(len, 64 - offset);
 	memcpy(m->save + offset, p, l);
 	offset += l;
 	p += l;
 	len -= l;
-	if(offset == 64){
+	if(offset == 64 && samba_crypto_have_shani()){
+	    samba_shani_sha256_blocks(m->counter, m->save, 1);
+	    offset = 0;
+	} else if(offset == 64){
 #if !defined(WORDS_BIGENDIAN) || defined(_CRAY)
 	    int i;
 	    uint32_t current[16];
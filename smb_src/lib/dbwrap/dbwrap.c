@@ -387,6 +387,134 @@ NTSTATUS dbwrap_parse_record(struct db_context *db, TDB_DATA key,
 	return db->parse_record(db, key, parser, private_data);
 }
 
+struct dbwrap_parse_records_fallback_state {
+	size_t idx;
+	void (*parser)(size_t idx, TDB_DATA key, TDB_DATA data,
+		       void *private_data);
+	void *private_data;
+};
+
+static void dbwrap_parse_records_fallback_parser(TDB_DATA key, TDB_DATA data,
+						 void *private_data)
+{
+	struct dbwrap_parse_records_fallback_state *state = private_data;
+	state->parser(state->idx, key, data, state->private_data);
+}
+
+/*
+ * Fallback parse_records implementation: One parse_record per key
+ */
+static NTSTATUS dbwrap_fallback_parse_records(
+	struct db_context *db, const TDB_DATA *keys, size_t num_keys,
+	void (*parser)(size_t idx, TDB_DATA key, TDB_DATA data,
+		       void *private_data),
+	void *private_data)
+{
+	struct dbwrap_parse_records_fallback_state state = {
+		.parser = parser, .private_data = private_data
+	};
+	size_t i;
+
+	for (i=0; i<num_keys; i++) {
+		NTSTATUS status;
+
+		state.idx = i;
+		status = db->parse_record(
+			db, keys[i], dbwrap_parse_records_fallback_parser,
+			&state);
+		if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+			continue;
+		}
+		if (!NT_STATUS_IS_OK(status)) {
+			return status;
+		}
+	}
+	return NT_STATUS_OK;
+}
+
+static void dbwrap_null_records_parser(size_t idx, TDB_DATA key,
+				       TDB_DATA data, void *private_data)
+{
+	return;
+}
+
+NTSTATUS dbwrap_parse_records(struct db_context *db,
+			      const TDB_DATA *keys, size_t num_keys,
+			      void (*parser)(size_t idx, TDB_DATA key,
+					     TDB_DATA data,
+					     void *private_data),
+			      void *private_data)
+{
+	if (num_keys == 0) {
+		return NT_STATUS_OK;
+	}
+	if (parser == NULL) {
+		parser = dbwrap_null_records_parser;
+	}
+	if (db->parse_records == NULL) {
+		return dbwrap_fallback_parse_records(db, keys, num_keys,
+						     parser, private_data);
+	}
+	return db->parse_records(db, keys, num_keys, parser, private_data);
+}
+
+NTSTATUS dbwrap_prefetch_locked(struct db_context **dbs,
+				const TDB_DATA *keys, size_t num_keys)
+{
+	struct db_context **backing;
+	size_t i, j;
+	NTSTATUS status = NT_STATUS_OK;
+
+	if (num_keys == 0) {
+		return NT_STATUS_OK;
+	}
+
+	/*
+	 * Look through wrappers such as sharded databases to the
+	 * database that actually holds each record.
+	 */
+	backing = talloc_array(talloc_tos(), struct db_context *, num_keys);
+	if (backing == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+	for (i=0; i<num_keys; i++) {
+		struct db_context *db = dbs[i];
+
+		while ((db != NULL) && (db->backing_db != NULL)) {
+			db = db->backing_db(db, keys[i]);
+		}
+		backing[i] = db;
+	}
+
+	/*
+	 * Every backend that knows how to prefetch gets the whole list
+	 * once and picks out the records that belong to it.
+	 */
+	for (i=0; i<num_keys; i++) {
+		if ((backing[i] == NULL) ||
+		    (backing[i]->prefetch_locked == NULL)) {
+			continue;
+		}
+		for (j=0; j<i; j++) {
+			if ((backing[j] != NULL) &&
+			    (backing[j]->prefetch_locked ==
+			     backing[i]->prefetch_locked)) {
+				break;
+			}
+		}
+		if (j < i) {
+			continue;
+		}
+		status = backing[i]->prefetch_locked(backing, keys, num_keys);
+		if (!NT_STATUS_IS_OK(status)) {
+			break;
+		}
+	}
+
+	TALLOC_FREE(backing);
+	return status;
+}
+
 int dbwrap_wipe(struct db_context *db)
 {
 	if (db->wipe == NULL) {
@@ -408,6 +536,24 @@ int dbwrap_check(struct db_context *db)
 	return db->check(db);
 }
 
+int dbwrap_repack_chains(struct db_context *db, uint32_t start,
+			 uint32_t num_chains,
+			 struct tdb_repack_stats *stats)
+{
+	if (db->repack_chains == NULL) {
+		return 0;
+	}
+	return db->repack_chains(db, start, num_chains, stats);
+}
+
+NTSTATUS dbwrap_flush(struct db_context *db)
+{
+	if (db->flush == NULL) {
+		return NT_STATUS_OK;
+	}
+	return db->flush(db);
+}
+
 int dbwrap_get_seqnum(struct db_context *db)
 {
 	return db->get_seqnum(db);
@@ -76,8 +76,43 @@ NTSTATUS dbwrap_parse_record(struct db_context *db, TDB_DATA key,
 			     void (*parser)(TDB_DATA key, TDB_DATA data,
 					    void *private_data),
 			     void *private_data);
+/*
+ * Look up several keys in one go. "parser" is called with the index
+ * into "keys" for every key that exists, keys that don't exist are
+ * skipped. Backends that can do so fetch all records with one lock per
+ * hash chain or one round trip, the order of the parser calls is
+ * undefined.
+ */
+NTSTATUS dbwrap_parse_records(struct db_context *db,
+			      const TDB_DATA *keys, size_t num_keys,
+			      void (*parser)(size_t idx, TDB_DATA key,
+					     TDB_DATA data,
+					     void *private_data),
+			      void *private_data);
+/*
+ * Hint that the caller is about to fetch_locked the records keys[i] in
+ * dbs[i]. Clustered backends move all of them to this node in one round
+ * trip instead of one per fetch_locked. The records are not locked, the
+ * caller still has to use dbwrap_fetch_locked.
+ */
+NTSTATUS dbwrap_prefetch_locked(struct db_context **dbs,
+				const TDB_DATA *keys, size_t num_keys);
 int dbwrap_wipe(struct db_context *db);
 int dbwrap_check(struct db_context *db);
+/*
+ * Incrementally repack num_chains hash chains from start on, see
+ * tdb_repack_chains(). Returns the chain to continue with, 0 when
+ * the pass is complete (always for databases that can't be
+ * repacked) or -1 on error.
+ */
+int dbwrap_repack_chains(struct db_context *db, uint32_t start,
+			 uint32_t num_chains,
+			 struct tdb_repack_stats *stats);
+/*
+ * Durability barrier: Write out changes a layer like
+ * db_open_writebehind() has buffered. A no-op for other databases.
+ */
+NTSTATUS dbwrap_flush(struct db_context *db);
 int dbwrap_get_seqnum(struct db_context *db);
 /* Returns 0 if unknown. */
 int dbwrap_hash_size(struct db_context *db);
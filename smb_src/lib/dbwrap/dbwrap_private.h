@@ -55,9 +55,23 @@ struct db_context {
 				 void (*parser)(TDB_DATA key, TDB_DATA data,
 						void *private_data),
 				 void *private_data);
+	NTSTATUS (*parse_records)(struct db_context *db,
+				  const TDB_DATA *keys, size_t num_keys,
+				  void (*parser)(size_t idx, TDB_DATA key,
+						 TDB_DATA data,
+						 void *private_data),
+				  void *private_data);
+	NTSTATUS (*prefetch_locked)(struct db_context **dbs,
+				    const TDB_DATA *keys, size_t num_keys);
+	struct db_context *(*backing_db)(struct db_context *db,
+					 TDB_DATA key);
 	int (*exists)(struct db_context *db,TDB_DATA key);
 	int (*wipe)(struct db_context *db);
 	int (*check)(struct db_context *db);
+	int (*repack_chains)(struct db_context *db, uint32_t start,
+			     uint32_t num_chains,
+			     struct tdb_repack_stats *stats);
+	NTSTATUS (*flush)(struct db_context *db);
 	void (*id)(struct db_context *db, const uint8_t **id, size_t *idlen);
 	const char *name;
 	int hash_size;
@@ -0,0 +1,452 @@
+/*
+   Unix SMB/CIFS implementation.
+   Spread a database across several backing databases
+   Copyright (C) The Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Every key lives in exactly one of the shards, so the freelist,
+ * the hash chain locks and the file growth of each shard only see a
+ * fraction of the traffic. Records handed out carry the sharded
+ * db_context, so stored callbacks (dbwrap_watch_db) see the sharded
+ * database as a whole. Lock order is checked by the shards.
+ */
+
+#include "includes.h"
+#include "lib/dbwrap/dbwrap.h"
+#include "lib/dbwrap/dbwrap_private.h"
+#include "lib/dbwrap/dbwrap_sharded.h"
+
+struct db_sharded_ctx {
+	struct db_context **shards;
+	unsigned num_shards;
+};
+
+static unsigned db_sharded_shard_idx(struct db_sharded_ctx *ctx,
+				     TDB_DATA key)
+{
+	uint64_t hash = tdb_jenkins_hash(&key);
+
+	/*
+	 * Pick the shard by the upper bits of the hash, the tdb hash
+	 * chain within the shard is picked by the lower ones.
+	 */
+	return (hash * ctx->num_shards) >> 32;
+}
+
+static struct db_context *db_sharded_shard(struct db_sharded_ctx *ctx,
+					   TDB_DATA key)
+{
+	return ctx->shards[db_sharded_shard_idx(ctx, key)];
+}
+
+static NTSTATUS db_sharded_store(struct db_record *rec, TDB_DATA data,
+				 int flag)
+{
+	struct db_record *subrec = talloc_get_type_abort(
+		rec->private_data, struct db_record);
+	return dbwrap_record_store(subrec, data, flag);
+}
+
+static NTSTATUS db_sharded_delete(struct db_record *rec)
+{
+	struct db_record *subrec = talloc_get_type_abort(
+		rec->private_data, struct db_record);
+	return dbwrap_record_delete(subrec);
+}
+
+static struct db_record *db_sharded_fetch_locked_internal(
+	struct db_context *db, TALLOC_CTX *mem_ctx, TDB_DATA key,
+	struct db_record *(*fetch_fn)(struct db_context *db,
+				      TALLOC_CTX *mem_ctx,
+				      TDB_DATA key))
+{
+	struct db_sharded_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_sharded_ctx);
+	struct db_record *rec, *subrec;
+
+	rec = talloc_zero(mem_ctx, struct db_record);
+	if (rec == NULL) {
+		return NULL;
+	}
+	subrec = fetch_fn(db_sharded_shard(ctx, key), rec, key);
+	if (subrec == NULL) {
+		TALLOC_FREE(rec);
+		return NULL;
+	}
+
+	rec->key = dbwrap_record_get_key(subrec);
+	rec->value = dbwrap_record_get_value(subrec);
+	rec->store = db_sharded_store;
+	rec->delete_rec = db_sharded_delete;
+	rec->private_data = subrec;
+
+	return rec;
+}
+
+static struct db_record *db_sharded_fetch_locked(
+	struct db_context *db, TALLOC_CTX *mem_ctx, TDB_DATA key)
+{
+	return db_sharded_fetch_locked_internal(db, mem_ctx, key,
+						dbwrap_fetch_locked);
+}
+
+static struct db_record *db_sharded_try_fetch_locked(
+	struct db_context *db, TALLOC_CTX *mem_ctx, TDB_DATA key)
+{
+	return db_sharded_fetch_locked_internal(db, mem_ctx, key,
+						dbwrap_try_fetch_locked);
+}
+
+struct db_sharded_traverse_state {
+	struct db_context *db;
+	int (*f)(struct db_record *rec, void *private_data);
+	void *private_data;
+	bool stopped;
+};
+
+static int db_sharded_traverse_fn(struct db_record *subrec,
+				  void *private_data)
+{
+	struct db_sharded_traverse_state *state = private_data;
+	struct db_record rec = {
+		.db = state->db,
+		.key = dbwrap_record_get_key(subrec),
+		.value = dbwrap_record_get_value(subrec),
+		.store = db_sharded_store,
+		.delete_rec = db_sharded_delete,
+		.private_data = subrec,
+	};
+	int ret;
+
+	ret = state->f(&rec, state->private_data);
+	if (ret != 0) {
+		state->stopped = true;
+	}
+	return ret;
+}
+
+static int db_sharded_traverse_internal(
+	struct db_context *db,
+	int (*f)(struct db_record *rec, void *private_data),
+	void *private_data,
+	NTSTATUS (*traverse_fn)(struct db_context *db,
+				int (*f)(struct db_record*, void*),
+				void *private_data,
+				int *count))
+{
+	struct db_sharded_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_sharded_ctx);
+	struct db_sharded_traverse_state state = {
+		.db = db, .f = f, .private_data = private_data
+	};
+	unsigned i;
+	int count = 0;
+
+	for (i=0; i<ctx->num_shards; i++) {
+		NTSTATUS status;
+		int shard_count = 0;
+
+		status = traverse_fn(ctx->shards[i], db_sharded_traverse_fn,
+				     &state, &shard_count);
+		if (!NT_STATUS_IS_OK(status)) {
+			return -1;
+		}
+		count += shard_count;
+		if (state.stopped) {
+			break;
+		}
+	}
+	return count;
+}
+
+static int db_sharded_traverse(struct db_context *db,
+			       int (*f)(struct db_record *rec,
+					void *private_data),
+			       void *private_data)
+{
+	return db_sharded_traverse_internal(db, f, private_data,
+					    dbwrap_traverse);
+}
+
+static int db_sharded_traverse_read(struct db_context *db,
+				    int (*f)(struct db_record *rec,
+					     void *private_data),
+				    void *private_data)
+{
+	return db_sharded_traverse_internal(db, f, private_data,
+					    dbwrap_traverse_read);
+}
+
+static int db_sharded_get_seqnum(struct db_context *db)
+{
+	struct db_sharded_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_sharded_ctx);
+	unsigned i;
+	unsigned seqnum = 0;
+
+	/*
+	 * Any change in any shard changes the sum
+	 */
+	for (i=0; i<ctx->num_shards; i++) {
+		seqnum += dbwrap_get_seqnum(ctx->shards[i]);
+	}
+	return seqnum;
+}
+
+static int db_sharded_transaction_fail(struct db_context *db)
+{
+	DEBUG(1, ("No transactions on sharded database %s\n", db->name));
+	return -1;
+}
+
+static NTSTATUS db_sharded_parse_record(
+	struct db_context *db, TDB_DATA key,
+	void (*parser)(TDB_DATA key, TDB_DATA data, void *private_data),
+	void *private_data)
+{
+	struct db_sharded_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_sharded_ctx);
+	return dbwrap_parse_record(db_sharded_shard(ctx, key), key,
+				   parser, private_data);
+}
+
+struct db_sharded_parse_records_state {
+	const size_t *idxs;
+	void (*parser)(size_t idx, TDB_DATA key, TDB_DATA data,
+		       void *private_data);
+	void *private_data;
+};
+
+static void db_sharded_parse_records_parser(size_t idx, TDB_DATA key,
+					    TDB_DATA data, void *private_data)
+{
+	struct db_sharded_parse_records_state *state = private_data;
+	state->parser(state->idxs[idx], key, data, state->private_data);
+}
+
+/*
+ * Hand each shard the subset of keys it owns in one batch
+ */
+static NTSTATUS db_sharded_parse_records(
+	struct db_context *db, const TDB_DATA *keys, size_t num_keys,
+	void (*parser)(size_t idx, TDB_DATA key, TDB_DATA data,
+		       void *private_data),
+	void *private_data)
+{
+	struct db_sharded_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_sharded_ctx);
+	struct db_sharded_parse_records_state state = {
+		.parser = parser, .private_data = private_data
+	};
+	unsigned *shard_idxs;
+	TDB_DATA *shard_keys;
+	size_t *idxs;
+	unsigned i;
+	size_t j;
+	NTSTATUS status = NT_STATUS_OK;
+
+	shard_idxs = talloc_array(talloc_tos(), unsigned, num_keys);
+	shard_keys = talloc_array(shard_idxs, TDB_DATA, num_keys);
+	idxs = talloc_array(shard_idxs, size_t, num_keys);
+	if ((shard_idxs == NULL) || (shard_keys == NULL) || (idxs == NULL)) {
+		TALLOC_FREE(shard_idxs);
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	for (j=0; j<num_keys; j++) {
+		shard_idxs[j] = db_sharded_shard_idx(ctx, keys[j]);
+	}
+	state.idxs = idxs;
+
+	for (i=0; i<ctx->num_shards; i++) {
+		size_t num_shard_keys = 0;
+
+		for (j=0; j<num_keys; j++) {
+			if (shard_idxs[j] != i) {
+				continue;
+			}
+			shard_keys[num_shard_keys] = keys[j];
+			idxs[num_shard_keys] = j;
+			num_shard_keys += 1;
+		}
+		if (num_shard_keys == 0) {
+			continue;
+		}
+		status = dbwrap_parse_records(
+			ctx->shards[i], shard_keys, num_shard_keys,
+			db_sharded_parse_records_parser, &state);
+		if (!NT_STATUS_IS_OK(status)) {
+			break;
+		}
+	}
+
+	TALLOC_FREE(shard_idxs);
+	return status;
+}
+
+static struct db_context *db_sharded_backing_db(struct db_context *db,
+						 TDB_DATA key)
+{
+	struct db_sharded_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_sharded_ctx);
+	return db_sharded_shard(ctx, key);
+}
+
+static int db_sharded_exists(struct db_context *db, TDB_DATA key)
+{
+	struct db_sharded_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_sharded_ctx);
+	return dbwrap_exists(db_sharded_shard(ctx, key), key);
+}
+
+static int db_sharded_wipe(struct db_context *db)
+{
+	struct db_sharded_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_sharded_ctx);
+	unsigned i;
+
+	for (i=0; i<ctx->num_shards; i++) {
+		int ret = dbwrap_wipe(ctx->shards[i]);
+		if (ret != 0) {
+			return ret;
+		}
+	}
+	return 0;
+}
+
+static int db_sharded_check(struct db_context *db)
+{
+	struct db_sharded_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_sharded_ctx);
+	unsigned i;
+
+	for (i=0; i<ctx->num_shards; i++) {
+		int ret = dbwrap_check(ctx->shards[i]);
+		if (ret != 0) {
+			return ret;
+		}
+	}
+	return 0;
+}
+
+/*
+ * The chains of all shards are numbered one after the other, a call
+ * only ever walks chains of a single shard.
+ */
+static int db_sharded_repack_chains(struct db_context *db, uint32_t start,
+				    uint32_t num_chains,
+				    struct tdb_repack_stats *stats)
+{
+	struct db_sharded_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_sharded_ctx);
+	uint32_t first = 0;
+	unsigned i;
+
+	for (i=0; i<ctx->num_shards; i++) {
+		uint32_t hash_size = dbwrap_hash_size(ctx->shards[i]);
+		int ret;
+
+		if (start >= first + hash_size) {
+			first += hash_size;
+			continue;
+		}
+
+		ret = dbwrap_repack_chains(ctx->shards[i], start - first,
+					   num_chains, stats);
+		if (ret == -1) {
+			return -1;
+		}
+		if (ret != 0) {
+			return first + ret;
+		}
+		if (i == ctx->num_shards - 1) {
+			return 0;
+		}
+		return first + hash_size;
+	}
+	return 0;
+}
+
+static void db_sharded_id(struct db_context *db, const uint8_t **id,
+			  size_t *idlen)
+{
+	struct db_sharded_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_sharded_ctx);
+
+	/*
+	 * The first shard identifies the whole set
+	 */
+	dbwrap_db_id(ctx->shards[0], id, idlen);
+}
+
+struct db_context *db_open_sharded(TALLOC_CTX *mem_ctx,
+				   const char *name,
+				   struct db_context ***shards,
+				   unsigned num_shards)
+{
+	struct db_context *db;
+	struct db_sharded_ctx *ctx;
+	unsigned i;
+	int hash_size = 0;
+
+	if (num_shards == 0) {
+		return NULL;
+	}
+
+	db = talloc_zero(mem_ctx, struct db_context);
+	if (db == NULL) {
+		return NULL;
+	}
+	ctx = talloc_zero(db, struct db_sharded_ctx);
+	if (ctx == NULL) {
+		TALLOC_FREE(db);
+		return NULL;
+	}
+	ctx->shards = talloc_move(ctx, shards);
+	ctx->num_shards = num_shards;
+
+	for (i=0; i<num_shards; i++) {
+		hash_size += dbwrap_hash_size(ctx->shards[i]);
+	}
+
+	db->name = talloc_strdup(db, name);
+	if (db->name == NULL) {
+		TALLOC_FREE(db);
+		return NULL;
+	}
+
+	db->private_data = ctx;
+	db->fetch_locked = db_sharded_fetch_locked;
+	db->try_fetch_locked = db_sharded_try_fetch_locked;
+	db->traverse = db_sharded_traverse;
+	db->traverse_read = db_sharded_traverse_read;
+	db->get_seqnum = db_sharded_get_seqnum;
+	db->transaction_start = db_sharded_transaction_fail;
+	db->transaction_commit = db_sharded_transaction_fail;
+	db->transaction_cancel = db_sharded_transaction_fail;
+	db->parse_record = db_sharded_parse_record;
+	db->parse_records = db_sharded_parse_records;
+	db->backing_db = db_sharded_backing_db;
+	db->exists = db_sharded_exists;
+	db->wipe = db_sharded_wipe;
+	db->check = db_sharded_check;
+	db->repack_chains = db_sharded_repack_chains;
+	db->id = db_sharded_id;
+	db->hash_size = hash_size;
+	db->persistent = dbwrap_is_persistent(ctx->shards[0]);
+	return db;
+}
@@ -196,6 +196,20 @@ static int db_tdb_check(struct db_context *db)
 	return tdb_check(ctx->wtdb->tdb, NULL, NULL);
 }
 
+static int db_tdb_repack_chains(struct db_context *db, uint32_t start,
+				uint32_t num_chains,
+				struct tdb_repack_stats *stats)
+{
+	struct db_tdb_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_tdb_ctx);
+	struct tdb_context *tdb = ctx->wtdb->tdb;
+
+	if (start >= tdb_hash_size(tdb)) {
+		return 0;
+	}
+	return tdb_repack_chains(tdb, start, num_chains, stats);
+}
+
 struct db_tdb_parse_state {
 	void (*parser)(TDB_DATA key, TDB_DATA data,
 		       void *private_data);
@@ -237,6 +251,45 @@ static NTSTATUS db_tdb_parse(struct db_context *db, TDB_DATA key,
 	return NT_STATUS_OK;
 }
 
+struct db_tdb_parse_records_state {
+	void (*parser)(size_t idx, TDB_DATA key, TDB_DATA data,
+		       void *private_data);
+	void *private_data;
+};
+
+static int db_tdb_records_parser(size_t idx, TDB_DATA key, TDB_DATA data,
+				 void *private_data)
+{
+	struct db_tdb_parse_records_state *state =
+		(struct db_tdb_parse_records_state *)private_data;
+	state->parser(idx, key, data, state->private_data);
+	return 0;
+}
+
+static NTSTATUS db_tdb_parse_records(struct db_context *db,
+				     const TDB_DATA *keys, size_t num_keys,
+				     void (*parser)(size_t idx, TDB_DATA key,
+						    TDB_DATA data,
+						    void *private_data),
+				     void *private_data)
+{
+	struct db_tdb_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_tdb_ctx);
+	struct db_tdb_parse_records_state state;
+	int ret;
+
+	state.parser = parser;
+	state.private_data = private_data;
+
+	ret = tdb_parse_records(ctx->wtdb->tdb, keys, num_keys,
+				db_tdb_records_parser, &state);
+
+	if (ret != 0) {
+		return map_nt_error_from_tdb(tdb_error(ctx->wtdb->tdb));
+	}
+	return NT_STATUS_OK;
+}
+
 static NTSTATUS db_tdb_store(struct db_record *rec, TDB_DATA data, int flag)
 {
 	struct db_tdb_ctx *ctx = talloc_get_type_abort(rec->private_data,
@@ -454,6 +507,7 @@ struct db_context *db_open_tdb(TALLOC_CTX *mem_ctx,
 	result->traverse = db_tdb_traverse;
 	result->traverse_read = db_tdb_traverse_read;
 	result->parse_record = db_tdb_parse;
+	result->parse_records = db_tdb_parse_records;
 	result->get_seqnum = db_tdb_get_seqnum;
 	result->persistent = ((tdb_flags & TDB_CLEAR_IF_FIRST) == 0);
 	result->transaction_start = db_tdb_transaction_start;
@@ -464,6 +518,7 @@ struct db_context *db_open_tdb(TALLOC_CTX *mem_ctx,
 	result->wipe = db_tdb_wipe;
 	result->id = db_tdb_id;
 	result->check = db_tdb_check;
+	result->repack_chains = db_tdb_repack_chains;
 	result->name = tdb_name(db_tdb->wtdb->tdb);
 	result->hash_size = hash_size;
 	return result;
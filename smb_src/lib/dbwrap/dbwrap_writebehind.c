@@ -0,0 +1,768 @@
+/*
+   Unix SMB/CIFS implementation.
+   Buffer dbwrap stores and commit them in groups
+   Copyright (C) The Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Changes are kept in an rbt keyed like the backing database. The
+ * first byte of each buffered value says whether the key was stored
+ * or deleted. Explicit transactions collect their changes in a second
+ * rbt that is merged into the pending one on commit. Readers look at
+ * the transaction buffer, the pending buffer and the backing
+ * database, in that order.
+ */
+
+#include "includes.h"
+#include <tevent.h>
+#include "lib/dbwrap/dbwrap.h"
+#include "lib/dbwrap/dbwrap_private.h"
+#include "lib/dbwrap/dbwrap_rbt.h"
+#include "lib/dbwrap/dbwrap_writebehind.h"
+#include "lib/util/util_tdb.h"
+
+#define DB_WB_STORED ((uint8_t)'S')
+#define DB_WB_DELETED ((uint8_t)'D')
+
+struct db_writebehind_ctx {
+	struct tevent_context *ev;
+	struct db_context *backing;
+
+	struct db_context *pending;
+	unsigned num_pending;
+	/* ops a non-buffering backend would have committed one by one */
+	unsigned pending_ops;
+
+	struct db_context *txn;
+	unsigned txn_nesting;
+	bool txn_cancelled;
+
+	struct tevent_timer *te;
+	unsigned interval_msec;
+	unsigned max_pending;
+
+	struct dbwrap_writebehind_stats stats;
+};
+
+struct db_writebehind_lookup_state {
+	uint8_t op;
+	TDB_DATA data;
+};
+
+static void db_writebehind_lookup_parser(TDB_DATA key, TDB_DATA data,
+					 void *private_data)
+{
+	struct db_writebehind_lookup_state *state = private_data;
+
+	if (data.dsize == 0) {
+		return;
+	}
+	state->op = data.dptr[0];
+	state->data = make_tdb_data(data.dptr + 1, data.dsize - 1);
+}
+
+/*
+ * Look for buffered changes to "key". Returns false if the backing db
+ * has to be asked. The data returned points into the rbt, it is only
+ * valid until the next buffered change.
+ */
+static bool db_writebehind_lookup(struct db_writebehind_ctx *ctx,
+				  TDB_DATA key, uint8_t *op, TDB_DATA *data)
+{
+	struct db_writebehind_lookup_state state = { .op = 0 };
+
+	if (ctx->txn != NULL) {
+		dbwrap_parse_record(ctx->txn, key,
+				    db_writebehind_lookup_parser, &state);
+	}
+	if (state.op == 0) {
+		dbwrap_parse_record(ctx->pending, key,
+				    db_writebehind_lookup_parser, &state);
+	}
+	if (state.op == 0) {
+		return false;
+	}
+	*op = state.op;
+	*data = state.data;
+	return true;
+}
+
+static bool db_writebehind_exists_internal(struct db_writebehind_ctx *ctx,
+					   TDB_DATA key)
+{
+	uint8_t op;
+	TDB_DATA data;
+
+	if (db_writebehind_lookup(ctx, key, &op, &data)) {
+		return (op == DB_WB_STORED);
+	}
+	return dbwrap_exists(ctx->backing, key);
+}
+
+static NTSTATUS db_writebehind_put(struct db_context *buf, TDB_DATA key,
+				   uint8_t op, TDB_DATA data, bool *replaced)
+{
+	TDB_DATA value;
+	NTSTATUS status;
+
+	*replaced = dbwrap_exists(buf, key);
+
+	value.dsize = 1 + data.dsize;
+	value.dptr = talloc_array(talloc_tos(), uint8_t, value.dsize);
+	if (value.dptr == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+	value.dptr[0] = op;
+	if (data.dsize != 0) {
+		memcpy(value.dptr + 1, data.dptr, data.dsize);
+	}
+
+	status = dbwrap_store(buf, key, value, 0);
+	TALLOC_FREE(value.dptr);
+	return status;
+}
+
+static NTSTATUS db_writebehind_commit(struct db_writebehind_ctx *ctx);
+static void db_writebehind_timer(struct tevent_context *ev,
+				 struct tevent_timer *te,
+				 struct timeval current_time,
+				 void *private_data);
+
+static NTSTATUS db_writebehind_queue_pending(struct db_writebehind_ctx *ctx,
+					     TDB_DATA key, uint8_t op,
+					     TDB_DATA data)
+{
+	NTSTATUS status;
+	bool replaced;
+
+	status = db_writebehind_put(ctx->pending, key, op, data, &replaced);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+	if (replaced) {
+		ctx->stats.coalesced += 1;
+	} else {
+		ctx->num_pending += 1;
+	}
+	return NT_STATUS_OK;
+}
+
+/*
+ * A change has been added to the pending buffer: Commit now if it's
+ * full, otherwise make sure the timer is running.
+ */
+static NTSTATUS db_writebehind_schedule(struct db_writebehind_ctx *ctx)
+{
+	if (ctx->num_pending >= ctx->max_pending) {
+		return db_writebehind_commit(ctx);
+	}
+	if (ctx->te != NULL) {
+		return NT_STATUS_OK;
+	}
+	ctx->te = tevent_add_timer(
+		ctx->ev, ctx, timeval_current_ofs_msec(ctx->interval_msec),
+		db_writebehind_timer, ctx);
+	if (ctx->te == NULL) {
+		/*
+		 * Without the timer nothing would write the buffer
+		 */
+		return db_writebehind_commit(ctx);
+	}
+	return NT_STATUS_OK;
+}
+
+static NTSTATUS db_writebehind_queue(struct db_writebehind_ctx *ctx,
+				     TDB_DATA key, uint8_t op, TDB_DATA data)
+{
+	NTSTATUS status;
+
+	ctx->stats.queued += 1;
+
+	if (ctx->txn != NULL) {
+		bool replaced;
+
+		status = db_writebehind_put(ctx->txn, key, op, data,
+					    &replaced);
+		if (replaced) {
+			ctx->stats.coalesced += 1;
+		}
+		return status;
+	}
+
+	status = db_writebehind_queue_pending(ctx, key, op, data);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+	ctx->pending_ops += 1;
+
+	return db_writebehind_schedule(ctx);
+}
+
+struct db_writebehind_apply_state {
+	struct db_context *backing;
+	NTSTATUS status;
+	unsigned num_records;
+};
+
+static int db_writebehind_apply_fn(struct db_record *rec, void *private_data)
+{
+	struct db_writebehind_apply_state *state = private_data;
+	TDB_DATA key = dbwrap_record_get_key(rec);
+	TDB_DATA value = dbwrap_record_get_value(rec);
+	NTSTATUS status;
+
+	if (value.dsize == 0) {
+		state->status = NT_STATUS_INTERNAL_DB_CORRUPTION;
+		return -1;
+	}
+
+	if (value.dptr[0] == DB_WB_STORED) {
+		status = dbwrap_store(
+			state->backing, key,
+			make_tdb_data(value.dptr + 1, value.dsize - 1),
+			TDB_REPLACE);
+	} else {
+		status = dbwrap_delete(state->backing, key);
+		if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+			status = NT_STATUS_OK;
+		}
+	}
+	if (!NT_STATUS_IS_OK(status)) {
+		state->status = status;
+		return -1;
+	}
+
+	state->num_records += 1;
+	return 0;
+}
+
+/*
+ * Write the pending buffer to the backing db. Persistent databases
+ * get one transaction for the whole buffer. If that fails, the buffer
+ * is kept for the next try.
+ */
+static NTSTATUS db_writebehind_commit(struct db_writebehind_ctx *ctx)
+{
+	struct db_writebehind_apply_state state = {
+		.backing = ctx->backing, .status = NT_STATUS_OK
+	};
+	struct db_context *empty;
+	bool persistent = dbwrap_is_persistent(ctx->backing);
+	NTSTATUS status;
+	int ret;
+
+	TALLOC_FREE(ctx->te);
+
+	if (ctx->num_pending == 0) {
+		return NT_STATUS_OK;
+	}
+
+	empty = db_open_rbt(ctx);
+	if (empty == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	if (persistent) {
+		ret = dbwrap_transaction_start(ctx->backing);
+		if (ret != 0) {
+			DEBUG(1, ("%s: transaction_start failed\n",
+				  dbwrap_name(ctx->backing)));
+			status = NT_STATUS_INTERNAL_DB_ERROR;
+			goto fail;
+		}
+	}
+
+	status = dbwrap_traverse_read(ctx->pending, db_writebehind_apply_fn,
+				      &state, NULL);
+	if (NT_STATUS_IS_OK(status)) {
+		status = state.status;
+	}
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(1, ("%s: applying buffered changes failed: %s\n",
+			  dbwrap_name(ctx->backing), nt_errstr(status)));
+		if (persistent) {
+			dbwrap_transaction_cancel(ctx->backing);
+		}
+		goto fail;
+	}
+
+	if (persistent) {
+		ret = dbwrap_transaction_commit(ctx->backing);
+		if (ret != 0) {
+			DEBUG(1, ("%s: transaction_commit failed\n",
+				  dbwrap_name(ctx->backing)));
+			status = NT_STATUS_INTERNAL_DB_ERROR;
+			goto fail;
+		}
+		ctx->stats.fsyncs_saved += ctx->pending_ops - 1;
+	}
+
+	DEBUG(10, ("%s: committed %u records from %u changes\n",
+		   dbwrap_name(ctx->backing), state.num_records,
+		   ctx->pending_ops));
+
+	ctx->stats.commits += 1;
+	ctx->stats.records += state.num_records;
+
+	TALLOC_FREE(ctx->pending);
+	ctx->pending = empty;
+	ctx->num_pending = 0;
+	ctx->pending_ops = 0;
+
+	return NT_STATUS_OK;
+
+fail:
+	ctx->stats.failed += 1;
+	TALLOC_FREE(empty);
+	return status;
+}
+
+static void db_writebehind_timer(struct tevent_context *ev,
+				 struct tevent_timer *te,
+				 struct timeval current_time,
+				 void *private_data)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		private_data, struct db_writebehind_ctx);
+	NTSTATUS status;
+
+	ctx->te = NULL;
+
+	status = db_writebehind_commit(ctx);
+	if (NT_STATUS_IS_OK(status)) {
+		return;
+	}
+
+	/*
+	 * Keep the changes and try again later
+	 */
+	ctx->te = tevent_add_timer(
+		ctx->ev, ctx, timeval_current_ofs_msec(ctx->interval_msec),
+		db_writebehind_timer, ctx);
+	if (ctx->te == NULL) {
+		DEBUG(0, ("%s: could not reschedule commit of %u records\n",
+			  dbwrap_name(ctx->backing), ctx->num_pending));
+	}
+}
+
+static int db_writebehind_ctx_destructor(struct db_writebehind_ctx *ctx)
+{
+	NTSTATUS status;
+
+	status = db_writebehind_commit(ctx);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(0, ("%s: lost %u buffered records: %s\n",
+			  dbwrap_name(ctx->backing), ctx->num_pending,
+			  nt_errstr(status)));
+	}
+	return 0;
+}
+
+static NTSTATUS db_writebehind_store(struct db_record *rec, TDB_DATA data,
+				     int flag)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		rec->private_data, struct db_writebehind_ctx);
+
+	if ((flag == TDB_INSERT) &&
+	    db_writebehind_exists_internal(ctx, rec->key)) {
+		return NT_STATUS_OBJECT_NAME_COLLISION;
+	}
+	if ((flag == TDB_MODIFY) &&
+	    !db_writebehind_exists_internal(ctx, rec->key)) {
+		return NT_STATUS_NOT_FOUND;
+	}
+
+	return db_writebehind_queue(ctx, rec->key, DB_WB_STORED, data);
+}
+
+static NTSTATUS db_writebehind_delete(struct db_record *rec)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		rec->private_data, struct db_writebehind_ctx);
+
+	if (!db_writebehind_exists_internal(ctx, rec->key)) {
+		return NT_STATUS_NOT_FOUND;
+	}
+
+	return db_writebehind_queue(ctx, rec->key, DB_WB_DELETED,
+				    tdb_null);
+}
+
+static struct db_record *db_writebehind_fetch_locked(
+	struct db_context *db, TALLOC_CTX *mem_ctx, TDB_DATA key)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_writebehind_ctx);
+	struct db_record *rec;
+	uint8_t op;
+	TDB_DATA data;
+	NTSTATUS status;
+
+	rec = talloc_zero(mem_ctx, struct db_record);
+	if (rec == NULL) {
+		return NULL;
+	}
+	rec->key.dptr = (uint8_t *)talloc_memdup(rec, key.dptr, key.dsize);
+	if ((rec->key.dptr == NULL) && (key.dsize != 0)) {
+		TALLOC_FREE(rec);
+		return NULL;
+	}
+	rec->key.dsize = key.dsize;
+
+	if (db_writebehind_lookup(ctx, key, &op, &data)) {
+		if ((op == DB_WB_STORED) && (data.dsize != 0)) {
+			rec->value.dptr = (uint8_t *)talloc_memdup(
+				rec, data.dptr, data.dsize);
+			if (rec->value.dptr == NULL) {
+				TALLOC_FREE(rec);
+				return NULL;
+			}
+			rec->value.dsize = data.dsize;
+		}
+	} else {
+		status = dbwrap_fetch(ctx->backing, rec, key, &rec->value);
+		if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+			rec->value = tdb_null;
+		} else if (!NT_STATUS_IS_OK(status)) {
+			TALLOC_FREE(rec);
+			return NULL;
+		}
+	}
+
+	rec->db = db;
+	rec->store = db_writebehind_store;
+	rec->delete_rec = db_writebehind_delete;
+	rec->private_data = ctx;
+	return rec;
+}
+
+static NTSTATUS db_writebehind_parse_record(
+	struct db_context *db, TDB_DATA key,
+	void (*parser)(TDB_DATA key, TDB_DATA data, void *private_data),
+	void *private_data)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_writebehind_ctx);
+	uint8_t op;
+	TDB_DATA data;
+
+	if (db_writebehind_lookup(ctx, key, &op, &data)) {
+		if (op != DB_WB_STORED) {
+			return NT_STATUS_NOT_FOUND;
+		}
+		parser(key, data, private_data);
+		return NT_STATUS_OK;
+	}
+	return dbwrap_parse_record(ctx->backing, key, parser, private_data);
+}
+
+static int db_writebehind_exists(struct db_context *db, TDB_DATA key)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_writebehind_ctx);
+	return db_writebehind_exists_internal(ctx, key) ? 1 : 0;
+}
+
+/*
+ * Traversals see what has been committed, so write the buffer first.
+ * Changes made inside a running transaction are not visible.
+ */
+static int db_writebehind_traverse(struct db_context *db,
+				   int (*f)(struct db_record *rec,
+					    void *private_data),
+				   void *private_data)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_writebehind_ctx);
+	NTSTATUS status;
+	int count;
+
+	status = db_writebehind_commit(ctx);
+	if (!NT_STATUS_IS_OK(status)) {
+		return -1;
+	}
+	status = dbwrap_traverse(ctx->backing, f, private_data, &count);
+	if (!NT_STATUS_IS_OK(status)) {
+		return -1;
+	}
+	return count;
+}
+
+static int db_writebehind_traverse_read(struct db_context *db,
+					int (*f)(struct db_record *rec,
+						 void *private_data),
+					void *private_data)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_writebehind_ctx);
+	NTSTATUS status;
+	int count;
+
+	status = db_writebehind_commit(ctx);
+	if (!NT_STATUS_IS_OK(status)) {
+		return -1;
+	}
+	status = dbwrap_traverse_read(ctx->backing, f, private_data, &count);
+	if (!NT_STATUS_IS_OK(status)) {
+		return -1;
+	}
+	return count;
+}
+
+static int db_writebehind_get_seqnum(struct db_context *db)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_writebehind_ctx);
+	return dbwrap_get_seqnum(ctx->backing);
+}
+
+static int db_writebehind_transaction_start(struct db_context *db)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_writebehind_ctx);
+
+	if (ctx->txn_nesting == 0) {
+		ctx->txn = db_open_rbt(ctx);
+		if (ctx->txn == NULL) {
+			return -1;
+		}
+		ctx->txn_cancelled = false;
+	}
+	ctx->txn_nesting += 1;
+	return 0;
+}
+
+static NTSTATUS db_writebehind_transaction_start_nonblock(
+	struct db_context *db)
+{
+	int ret;
+
+	ret = db_writebehind_transaction_start(db);
+	if (ret != 0) {
+		return NT_STATUS_NO_MEMORY;
+	}
+	return NT_STATUS_OK;
+}
+
+struct db_writebehind_merge_state {
+	struct db_writebehind_ctx *ctx;
+	NTSTATUS status;
+};
+
+static int db_writebehind_merge_fn(struct db_record *rec, void *private_data)
+{
+	struct db_writebehind_merge_state *state = private_data;
+	TDB_DATA key = dbwrap_record_get_key(rec);
+	TDB_DATA value = dbwrap_record_get_value(rec);
+
+	if (value.dsize == 0) {
+		state->status = NT_STATUS_INTERNAL_DB_CORRUPTION;
+		return -1;
+	}
+
+	state->status = db_writebehind_queue_pending(
+		state->ctx, key, value.dptr[0],
+		make_tdb_data(value.dptr + 1, value.dsize - 1));
+	if (!NT_STATUS_IS_OK(state->status)) {
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Committing the outermost transaction moves its changes into the
+ * pending buffer, they become durable with the next group commit.
+ */
+static int db_writebehind_transaction_commit(struct db_context *db)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_writebehind_ctx);
+	struct db_writebehind_merge_state state = {
+		.ctx = ctx, .status = NT_STATUS_OK
+	};
+	struct db_context *txn;
+	NTSTATUS status;
+
+	if (ctx->txn_nesting == 0) {
+		DEBUG(0, ("%s: no transaction running\n", db->name));
+		return -1;
+	}
+
+	ctx->txn_nesting -= 1;
+	if (ctx->txn_nesting > 0) {
+		return 0;
+	}
+
+	txn = ctx->txn;
+	ctx->txn = NULL;
+
+	if (ctx->txn_cancelled) {
+		TALLOC_FREE(txn);
+		return -1;
+	}
+
+	status = dbwrap_traverse_read(txn, db_writebehind_merge_fn, &state,
+				      NULL);
+	TALLOC_FREE(txn);
+	if (NT_STATUS_IS_OK(status)) {
+		status = state.status;
+	}
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(1, ("%s: merging transaction failed: %s\n",
+			  db->name, nt_errstr(status)));
+		return -1;
+	}
+
+	ctx->stats.transactions += 1;
+	ctx->pending_ops += 1;
+
+	status = db_writebehind_schedule(ctx);
+	if (!NT_STATUS_IS_OK(status)) {
+		return -1;
+	}
+	return 0;
+}
+
+static int db_writebehind_transaction_cancel(struct db_context *db)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_writebehind_ctx);
+
+	if (ctx->txn_nesting == 0) {
+		DEBUG(0, ("%s: no transaction running\n", db->name));
+		return -1;
+	}
+
+	ctx->txn_cancelled = true;
+	ctx->txn_nesting -= 1;
+	if (ctx->txn_nesting == 0) {
+		TALLOC_FREE(ctx->txn);
+	}
+	return 0;
+}
+
+static int db_writebehind_wipe(struct db_context *db)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_writebehind_ctx);
+	struct db_context *empty;
+
+	empty = db_open_rbt(ctx);
+	if (empty == NULL) {
+		return -1;
+	}
+	TALLOC_FREE(ctx->te);
+	TALLOC_FREE(ctx->pending);
+	ctx->pending = empty;
+	ctx->num_pending = 0;
+	ctx->pending_ops = 0;
+
+	return dbwrap_wipe(ctx->backing);
+}
+
+static int db_writebehind_check(struct db_context *db)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_writebehind_ctx);
+	NTSTATUS status;
+
+	status = db_writebehind_commit(ctx);
+	if (!NT_STATUS_IS_OK(status)) {
+		return -1;
+	}
+	return dbwrap_check(ctx->backing);
+}
+
+static NTSTATUS db_writebehind_flush(struct db_context *db)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_writebehind_ctx);
+	return db_writebehind_commit(ctx);
+}
+
+static void db_writebehind_id(struct db_context *db, const uint8_t **id,
+			      size_t *idlen)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_writebehind_ctx);
+	dbwrap_db_id(ctx->backing, id, idlen);
+}
+
+struct db_context *db_open_writebehind(TALLOC_CTX *mem_ctx,
+				       struct tevent_context *ev,
+				       struct db_context **backing,
+				       unsigned interval_msec,
+				       unsigned max_pending)
+{
+	struct db_context *db;
+	struct db_writebehind_ctx *ctx;
+
+	db = talloc_zero(mem_ctx, struct db_context);
+	if (db == NULL) {
+		return NULL;
+	}
+	ctx = talloc_zero(db, struct db_writebehind_ctx);
+	if (ctx == NULL) {
+		TALLOC_FREE(db);
+		return NULL;
+	}
+	ctx->pending = db_open_rbt(ctx);
+	if (ctx->pending == NULL) {
+		TALLOC_FREE(db);
+		return NULL;
+	}
+
+	ctx->ev = ev;
+	ctx->interval_msec = interval_msec;
+	ctx->max_pending = MAX(max_pending, 1);
+	ctx->backing = talloc_move(ctx, backing);
+	talloc_set_destructor(ctx, db_writebehind_ctx_destructor);
+
+	db->private_data = ctx;
+	db->fetch_locked = db_writebehind_fetch_locked;
+	db->traverse = db_writebehind_traverse;
+	db->traverse_read = db_writebehind_traverse_read;
+	db->get_seqnum = db_writebehind_get_seqnum;
+	db->transaction_start = db_writebehind_transaction_start;
+	db->transaction_start_nonblock =
+		db_writebehind_transaction_start_nonblock;
+	db->transaction_commit = db_writebehind_transaction_commit;
+	db->transaction_cancel = db_writebehind_transaction_cancel;
+	db->parse_record = db_writebehind_parse_record;
+	db->exists = db_writebehind_exists;
+	db->wipe = db_writebehind_wipe;
+	db->check = db_writebehind_check;
+	db->flush = db_writebehind_flush;
+	db->id = db_writebehind_id;
+	db->name = dbwrap_name(ctx->backing);
+	db->hash_size = dbwrap_hash_size(ctx->backing);
+	db->persistent = dbwrap_is_persistent(ctx->backing);
+	return db;
+}
+
+NTSTATUS dbwrap_writebehind_stats(struct db_context *db,
+				  struct dbwrap_writebehind_stats *stats)
+{
+	struct db_writebehind_ctx *ctx = talloc_get_type(
+		db->private_data, struct db_writebehind_ctx);
+
+	if (ctx == NULL) {
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+	*stats = ctx->stats;
+	return NT_STATUS_OK;
+}
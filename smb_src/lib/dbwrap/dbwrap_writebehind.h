@@ -0,0 +1,60 @@
+/*
+   Unix SMB/CIFS implementation.
+   Buffer dbwrap stores and commit them in groups
+   Copyright (C) The Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __DBWRAP_WRITEBEHIND_H__
+#define __DBWRAP_WRITEBEHIND_H__
+
+#include <talloc.h>
+#include <tevent.h>
+
+struct db_context;
+
+struct dbwrap_writebehind_stats {
+	uint64_t queued;	/* stores and deletes buffered */
+	uint64_t coalesced;	/* buffered ops that replaced a pending one */
+	uint64_t transactions;	/* explicit transactions merged */
+	uint64_t commits;	/* group commits to the backing db */
+	uint64_t records;	/* records written by group commits */
+	uint64_t fsyncs_saved;	/* backing transaction commits avoided */
+	uint64_t failed;	/* group commits that failed */
+};
+
+/**
+ * Create a db_context that buffers stores and deletes to "backing" in
+ * memory. The buffer is written to "backing" in one transaction
+ * (persistent databases) "interval_msec" after the first buffered
+ * change, when "max_pending" records are buffered, or when
+ * dbwrap_flush() is called. Transactions on the returned db_context
+ * only end up in the buffer, so many small transactions share one
+ * fsync.
+ *
+ * Buffered changes are invisible to other processes until they are
+ * committed, so this is only suitable for databases with a single
+ * writer. "backing" is talloc_move'd into the new context.
+ */
+struct db_context *db_open_writebehind(TALLOC_CTX *mem_ctx,
+				       struct tevent_context *ev,
+				       struct db_context **backing,
+				       unsigned interval_msec,
+				       unsigned max_pending);
+
+NTSTATUS dbwrap_writebehind_stats(struct db_context *db,
+				  struct dbwrap_writebehind_stats *stats);
+
+#endif /* __DBWRAP_WRITEBEHIND_H__ */
@@ -55,6 +55,10 @@ static bool tdb_check_header(struct tdb_context *tdb, tdb_off_t *recovery)
 	if (hdr.hash_size != tdb->hash_size)
 		goto corrupt;
 
+	if ((tdb->feature_flags & TDB_FEATURE_FLAG_FREELISTS) &&
+	    hdr.num_freelists != tdb->num_freelists)
+		goto corrupt;
+
 	if (hdr.recovery_start != 0 &&
 	    hdr.recovery_start < TDB_DATA_START(tdb->hash_size))
 		goto corrupt;
@@ -301,6 +305,14 @@ static bool tdb_check_free_record(struct tdb_context *tdb,
 	if (!tdb_check_record(tdb, off, rec))
 		return false;
 
+	if (tdb->num_freelists > 1 && rec->full_hash >= tdb->num_freelists) {
+		tdb->ecode = TDB_ERR_CORRUPT;
+		TDB_LOG((tdb, TDB_DEBUG_ERROR,
+			 "Free record offset %u on invalid freelist %u\n",
+			 off, rec->full_hash));
+		return false;
+	}
+
 	/* Mark this offset as a known value for the free list. */
 	record_offset(hashes[0], off);
 	/* And similarly if the next pointer is valid. */
@@ -383,6 +395,14 @@ _PUBLIC_ int tdb_check(struct tdb_context *tdb,
 			record_offset(hashes[h], off);
 	}
 
+	/* The other freelists all count as freelist 0. */
+	for (h = 1; h < tdb->num_freelists; h++) {
+		if (tdb_ofs_read(tdb, TDB_FREELIST_TOP(h), &off) == -1)
+			goto free;
+		if (off)
+			record_offset(hashes[0], off);
+	}
+
 	/* For each record, read it in and check it's ok. */
 	for (off = TDB_DATA_START(tdb->hash_size);
 	     off < tdb->map_size;
@@ -90,47 +90,67 @@ _PUBLIC_ void tdb_dump_all(struct tdb_context *tdb)
 	tdb_dump_chain(tdb, -1);
 }
 
-_PUBLIC_ int tdb_printfreelist(struct tdb_context *tdb)
+static int tdb_printfreelist_list(struct tdb_context *tdb, uint32_t list,
+				  long *total_free)
 {
 	int ret;
-	long total_free = 0;
+	int lock = TDB_FREELIST_LOCK(list);
 	tdb_off_t offset, rec_ptr;
 	struct tdb_record rec;
 
-	if ((ret = tdb_lock(tdb, -1, F_WRLCK)) != 0)
+	if ((ret = tdb_lock(tdb, lock, F_WRLCK)) != 0)
 		return ret;
 
-	offset = FREELIST_TOP;
+	offset = TDB_FREELIST_TOP(list);
 
 	/* read in the freelist top */
 	if (tdb_ofs_read(tdb, offset, &rec_ptr) == -1) {
-		tdb_unlock(tdb, -1, F_WRLCK);
+		tdb_unlock(tdb, lock, F_WRLCK);
 		return 0;
 	}
 
+	if (tdb->num_freelists > 1) {
+		printf("freelist %u ", list);
+	}
 	printf("freelist top=[0x%08x]\n", rec_ptr );
 	while (rec_ptr) {
 		if (tdb->methods->tdb_read(tdb, rec_ptr, (char *)&rec,
 					   sizeof(rec), DOCONV()) == -1) {
-			tdb_unlock(tdb, -1, F_WRLCK);
+			tdb_unlock(tdb, lock, F_WRLCK);
 			return -1;
 		}
 
 		if (rec.magic != TDB_FREE_MAGIC) {
 			printf("bad magic 0x%08x in free list\n", rec.magic);
-			tdb_unlock(tdb, -1, F_WRLCK);
+			tdb_unlock(tdb, lock, F_WRLCK);
 			return -1;
 		}
 
 		printf("entry offset=[0x%08x], rec.rec_len = [0x%08x (%u)] (end = 0x%08x)\n",
 		       rec_ptr, rec.rec_len, rec.rec_len, rec_ptr + rec.rec_len);
-		total_free += rec.rec_len;
+		*total_free += rec.rec_len;
 
 		/* move to the next record */
 		rec_ptr = rec.next;
 	}
+
+	return tdb_unlock(tdb, lock, F_WRLCK);
+}
+
+_PUBLIC_ int tdb_printfreelist(struct tdb_context *tdb)
+{
+	int ret;
+	long total_free = 0;
+	uint32_t list;
+
+	for (list=0; list<tdb->num_freelists; list++) {
+		ret = tdb_printfreelist_list(tdb, list, &total_free);
+		if (ret != 0) {
+			return ret;
+		}
+	}
 	printf("total rec_len = [0x%08lx (%lu)]\n", total_free, total_free);
 
-	return tdb_unlock(tdb, -1, F_WRLCK);
+	return 0;
 }
 
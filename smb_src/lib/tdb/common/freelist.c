@@ -33,6 +33,16 @@
 */
 #define USE_RIGHT_MERGES 0
 
+/* the freelist a free record is on, see TDB_FEATURE_FLAG_FREELISTS */
+static uint32_t tdb_free_rec_list(struct tdb_context *tdb,
+				  const struct tdb_record *rec)
+{
+	if (tdb->num_freelists == 1) {
+		return 0;
+	}
+	return rec->full_hash;
+}
+
 /* read a freelist record and check for simple errors */
 int tdb_rec_free_read(struct tdb_context *tdb, tdb_off_t off, struct tdb_record *rec)
 {
@@ -190,6 +200,43 @@ static int merge_with_left_record(struct tdb_context *tdb,
 	return 0;
 }
 
+/**
+ * The free record on the left is on another freelist than ours. It
+ * may only be modified under that list's lock, which we only try to
+ * get nonblocking to avoid deadlocks with the holder. Re-read the
+ * record under the lock, it might have changed in the meantime.
+ *
+ * Return code:
+ *   0 if the records can't be merged now
+ *   1 with the other list locked if the records can be merged.
+ */
+static int lock_left_freelist(struct tdb_context *tdb, uint32_t left_list,
+			      tdb_off_t rec_ptr, tdb_off_t *left_p,
+			      struct tdb_record *left_r)
+{
+	int ret;
+
+	if (left_list >= tdb->num_freelists) {
+		return 0;
+	}
+
+	ret = tdb_lock_nonblock(tdb, TDB_FREELIST_LOCK(left_list), F_WRLCK);
+	if (ret != 0) {
+		return 0;
+	}
+
+	ret = read_record_on_left(tdb, rec_ptr, left_p, left_r);
+	if ((ret == 0) &&
+	    (left_r->magic == TDB_FREE_MAGIC) &&
+	    (tdb_free_rec_list(tdb, left_r) == left_list) &&
+	    (*left_p + sizeof(*left_r) + left_r->rec_len == rec_ptr)) {
+		return 1;
+	}
+
+	tdb_unlock(tdb, TDB_FREELIST_LOCK(left_list), F_WRLCK);
+	return 0;
+}
+
 /**
  * Check whether the record left of a given freelist record is
  * also a freelist record, and if so, merge the two records.
@@ -199,12 +246,14 @@ static int merge_with_left_record(struct tdb_context *tdb,
  *   0 if left was not a free record
  *   1 if left was free and successfully merged.
  *
- * The currend record is handed in with pointer and fully read record.
+ * The currend record is handed in with pointer and fully read record,
+ * "list" is the freelist we hold the lock for.
  *
  * The left record pointer and struct can be retrieved as result
  * in lp and lr;
  */
 static int check_merge_with_left_record(struct tdb_context *tdb,
+					uint32_t list,
 					tdb_off_t rec_ptr,
 					struct tdb_record *rec,
 					tdb_off_t *lp,
@@ -212,6 +261,7 @@ static int check_merge_with_left_record(struct tdb_context *tdb,
 {
 	tdb_off_t left_ptr;
 	struct tdb_record left_rec;
+	uint32_t left_list;
 	int ret;
 
 	ret = read_record_on_left(tdb, rec_ptr, &left_ptr, &left_rec);
@@ -223,8 +273,20 @@ static int check_merge_with_left_record(struct tdb_context *tdb,
 		return 0;
 	}
 
+	left_list = tdb_free_rec_list(tdb, &left_rec);
+	if (left_list != list) {
+		ret = lock_left_freelist(tdb, left_list, rec_ptr,
+					 &left_ptr, &left_rec);
+		if (ret != 1) {
+			return ret;
+		}
+	}
+
 	/* It's free - expand to include it. */
 	ret = merge_with_left_record(tdb, left_ptr, &left_rec, rec);
+	if (left_list != list) {
+		tdb_unlock(tdb, TDB_FREELIST_LOCK(left_list), F_WRLCK);
+	}
 	if (ret != 0) {
 		return -1;
 	}
@@ -257,11 +319,13 @@ static int check_merge_with_left_record(struct tdb_context *tdb,
  * the caller can update the last pointer.
  */
 static int check_merge_ptr_with_left_record(struct tdb_context *tdb,
+					    uint32_t list,
 					    tdb_off_t rec_ptr,
 					    tdb_off_t *next_ptr)
 {
 	tdb_off_t left_ptr;
 	struct tdb_record rec, left_rec;
+	uint32_t left_list;
 	int ret;
 
 	ret = read_record_on_left(tdb, rec_ptr, &left_ptr, &left_rec);
@@ -273,15 +337,25 @@ static int check_merge_ptr_with_left_record(struct tdb_context *tdb,
 		return 0;
 	}
 
+	left_list = tdb_free_rec_list(tdb, &left_rec);
+	if (left_list != list) {
+		ret = lock_left_freelist(tdb, left_list, rec_ptr,
+					 &left_ptr, &left_rec);
+		if (ret != 1) {
+			return ret;
+		}
+	}
+
 	/* It's free - expand to include it. */
 
 	ret = tdb->methods->tdb_read(tdb, rec_ptr, &rec,
 				     sizeof(rec), DOCONV());
-	if (ret != 0) {
-		return -1;
+	if (ret == 0) {
+		ret = merge_with_left_record(tdb, left_ptr, &left_rec, &rec);
+	}
+	if (left_list != list) {
+		tdb_unlock(tdb, TDB_FREELIST_LOCK(left_list), F_WRLCK);
 	}
-
-	ret = merge_with_left_record(tdb, left_ptr, &left_rec, &rec);
 	if (ret != 0) {
 		return -1;
 	}
@@ -294,7 +368,7 @@ static int check_merge_ptr_with_left_record(struct tdb_context *tdb,
 }
 
 /**
- * Add an element into the freelist.
+ * Add an element into the freelist "list".
  *
  * We merge the new record into the left record if it is also a
  * free record, but not with the right one. This makes the
@@ -304,12 +378,13 @@ static int check_merge_ptr_with_left_record(struct tdb_context *tdb,
  *
  * This prevents db traverses from being O(n^2) after a lot of deletes.
  */
-int tdb_free(struct tdb_context *tdb, tdb_off_t offset, struct tdb_record *rec)
+int tdb_free_list(struct tdb_context *tdb, uint32_t list, tdb_off_t offset,
+		  struct tdb_record *rec)
 {
 	int ret;
 
 	/* Allocation and tailer lock */
-	if (tdb_lock(tdb, -1, F_WRLCK) != 0)
+	if (tdb_lock(tdb, TDB_FREELIST_LOCK(list), F_WRLCK) != 0)
 		return -1;
 
 	/* set an initial tailer, so if we fail we don't leave a bogus record */
@@ -345,7 +420,7 @@ int tdb_free(struct tdb_context *tdb, tdb_off_t offset, struct tdb_record *rec)
 left:
 #endif
 
-	ret = check_merge_with_left_record(tdb, offset, rec, NULL, NULL);
+	ret = check_merge_with_left_record(tdb, list, offset, rec, NULL, NULL);
 	if (ret == -1) {
 		goto fail;
 	}
@@ -357,24 +432,36 @@ left:
 	/* Nothing to merge, prepend to free list */
 
 	rec->magic = TDB_FREE_MAGIC;
+	if (tdb->num_freelists > 1) {
+		rec->full_hash = list;
+	}
 
-	if (tdb_ofs_read(tdb, FREELIST_TOP, &rec->next) == -1 ||
+	if (tdb_ofs_read(tdb, TDB_FREELIST_TOP(list), &rec->next) == -1 ||
 	    tdb_rec_write(tdb, offset, rec) == -1 ||
-	    tdb_ofs_write(tdb, FREELIST_TOP, &offset) == -1) {
+	    tdb_ofs_write(tdb, TDB_FREELIST_TOP(list), &offset) == -1) {
 		TDB_LOG((tdb, TDB_DEBUG_FATAL, "tdb_free record write failed at offset=%u\n", offset));
 		goto fail;
 	}
 
 done:
 	/* And we're done. */
-	tdb_unlock(tdb, -1, F_WRLCK);
+	tdb_unlock(tdb, TDB_FREELIST_LOCK(list), F_WRLCK);
 	return 0;
 
  fail:
-	tdb_unlock(tdb, -1, F_WRLCK);
+	tdb_unlock(tdb, TDB_FREELIST_LOCK(list), F_WRLCK);
 	return -1;
 }
 
+/*
+ * Free a record into the freelist of the hash chain it belonged to.
+ */
+int tdb_free(struct tdb_context *tdb, tdb_off_t offset, struct tdb_record *rec)
+{
+	return tdb_free_list(tdb, TDB_FREELIST_OF(tdb, rec->full_hash),
+			     offset, rec);
+}
+
 
 
 /*
@@ -434,37 +521,34 @@ static tdb_off_t tdb_allocate_ofs(struct tdb_context *tdb,
 	return rec_ptr;
 }
 
-/* allocate some space from the free list. The offset returned points
-   to a unconnected tdb_record within the database with room for at
-   least length bytes of total data
+/* allocate some space from the locked free list "list". On success
+   *pofs points to a unconnected tdb_record within the database with
+   room for at least length bytes of total data, it is 0 if there is
+   no record large enough in the list. If limit is not 0, only free
+   records below limit are used.
 
-   0 is returned if the space could not be allocated
+   -1 is returned on error
  */
-static tdb_off_t tdb_allocate_from_freelist(
-	struct tdb_context *tdb, tdb_len_t length, struct tdb_record *rec)
+static int tdb_allocate_from_list(
+	struct tdb_context *tdb, uint32_t list, tdb_len_t length,
+	tdb_off_t limit, struct tdb_record *rec, tdb_off_t *pofs)
 {
 	tdb_off_t rec_ptr, last_ptr, newrec_ptr;
 	struct {
 		tdb_off_t rec_ptr, last_ptr;
 		tdb_len_t rec_len;
 	} bestfit;
-	float multiplier = 1.0;
+	float multiplier;
 	bool merge_created_candidate;
 
-	/* over-allocate to reduce fragmentation */
-	length *= 1.25;
-
-	/* Extra bytes required for tailer */
-	length += sizeof(tdb_off_t);
-	length = TDB_ALIGN(length, TDB_ALIGNMENT);
-
  again:
 	merge_created_candidate = false;
-	last_ptr = FREELIST_TOP;
+	multiplier = 1.0;
+	last_ptr = TDB_FREELIST_TOP(list);
 
 	/* read in the freelist top */
-	if (tdb_ofs_read(tdb, FREELIST_TOP, &rec_ptr) == -1)
-		return 0;
+	if (tdb_ofs_read(tdb, last_ptr, &rec_ptr) == -1)
+		return -1;
 
 	bestfit.rec_ptr = 0;
 	bestfit.last_ptr = 0;
@@ -481,20 +565,20 @@ static tdb_off_t tdb_allocate_from_freelist(
 		struct tdb_record left_rec;
 
 		if (tdb_rec_free_read(tdb, rec_ptr, rec) == -1) {
-			return 0;
+			return -1;
 		}
 
-		ret = check_merge_with_left_record(tdb, rec_ptr, rec,
+		ret = check_merge_with_left_record(tdb, list, rec_ptr, rec,
 						   &left_ptr, &left_rec);
 		if (ret == -1) {
-			return 0;
+			return -1;
 		}
 		if (ret == 1) {
 			/* merged */
 			rec_ptr = rec->next;
 			ret = tdb_ofs_write(tdb, last_ptr, &rec->next);
 			if (ret == -1) {
-				return 0;
+				return -1;
 			}
 
 			/*
@@ -529,7 +613,8 @@ static tdb_off_t tdb_allocate_from_freelist(
 			continue;
 		}
 
-		if (rec->rec_len >= length) {
+		if (rec->rec_len >= length &&
+		    (limit == 0 || rec_ptr < limit)) {
 			if (bestfit.rec_ptr == 0 ||
 			    rec->rec_len < bestfit.rec_len) {
 				bestfit.rec_len = rec->rec_len;
@@ -560,21 +645,83 @@ static tdb_off_t tdb_allocate_from_freelist(
 
 	if (bestfit.rec_ptr != 0) {
 		if (tdb_rec_free_read(tdb, bestfit.rec_ptr, rec) == -1) {
-			return 0;
+			return -1;
 		}
 
 		newrec_ptr = tdb_allocate_ofs(tdb, length, bestfit.rec_ptr,
 					      rec, bestfit.last_ptr);
-		return newrec_ptr;
+		if (newrec_ptr == 0) {
+			return -1;
+		}
+		*pofs = newrec_ptr;
+		return 0;
 	}
 
 	if (merge_created_candidate) {
 		goto again;
 	}
 
+	*pofs = 0;
+	return 0;
+}
+
+/* allocate some space from the free list "list", which must be locked.
+   The offset returned points to a unconnected tdb_record within the
+   database with room for at least length bytes of total data
+
+   0 is returned if the space could not be allocated
+ */
+static tdb_off_t tdb_allocate_from_freelist(
+	struct tdb_context *tdb, uint32_t list, tdb_len_t length,
+	struct tdb_record *rec)
+{
+	tdb_off_t ofs;
+	uint32_t i;
+	int ret;
+
+	/* over-allocate to reduce fragmentation */
+	length *= 1.25;
+
+	/* Extra bytes required for tailer */
+	length += sizeof(tdb_off_t);
+	length = TDB_ALIGN(length, TDB_ALIGNMENT);
+
+ again:
+	ret = tdb_allocate_from_list(tdb, list, length, 0, rec, &ofs);
+	if (ret == -1) {
+		return 0;
+	}
+	if (ofs != 0) {
+		return ofs;
+	}
+
+	/*
+	 * Before growing the file, use the space on other freelists
+	 * that nobody is using right now. Records are freed into the
+	 * list of their hash chain, so without this free space would
+	 * not move between the lists.
+	 */
+	for (i=1; i<tdb->num_freelists; i++) {
+		uint32_t other = (list + i) % tdb->num_freelists;
+
+		ret = tdb_lock_nonblock(tdb, TDB_FREELIST_LOCK(other),
+					F_WRLCK);
+		if (ret != 0) {
+			continue;
+		}
+		ret = tdb_allocate_from_list(tdb, other, length, 0, rec, &ofs);
+		tdb_unlock(tdb, TDB_FREELIST_LOCK(other), F_WRLCK);
+		if (ret == -1) {
+			return 0;
+		}
+		if (ofs != 0) {
+			return ofs;
+		}
+	}
+
 	/* we didn't find enough space. See if we can expand the
 	   database and if we can then try again */
-	if (tdb_expand(tdb, length + sizeof(*rec)) == 0)
+	if (tdb_expand(tdb, list, length + sizeof(*rec)) == 0)
 		goto again;
 
 	return 0;
@@ -604,6 +751,8 @@ static bool tdb_alloc_dead(
 tdb_off_t tdb_allocate(struct tdb_context *tdb, int hash, tdb_len_t length,
 		       struct tdb_record *rec)
 {
+	uint32_t freelist = TDB_FREELIST_OF(tdb, hash);
+	int freelist_lock = TDB_FREELIST_LOCK(freelist);
 	tdb_off_t ret;
 	int i;
 
@@ -643,52 +792,133 @@ tdb_off_t tdb_allocate(struct tdb_context *tdb, int hash, tdb_len_t length,
 			}
 		}
 
-		if (tdb_lock_nonblock(tdb, -1, F_WRLCK) == 0) {
+		if (tdb_lock_nonblock(tdb, freelist_lock, F_WRLCK) == 0) {
 			/*
 			 * Under the freelist lock take the chance to give
 			 * back our dead records.
 			 */
 			tdb_purge_dead(tdb, hash);
 
-			ret = tdb_allocate_from_freelist(tdb, length, rec);
-			tdb_unlock(tdb, -1, F_WRLCK);
+			ret = tdb_allocate_from_freelist(tdb, freelist, length,
+							 rec);
+			tdb_unlock(tdb, freelist_lock, F_WRLCK);
 			return ret;
 		}
 	}
 
 blocking_freelist_allocate:
 
-	if (tdb_lock(tdb, -1, F_WRLCK) == -1) {
+	if (tdb_lock(tdb, freelist_lock, F_WRLCK) == -1) {
 		return 0;
 	}
-	ret = tdb_allocate_from_freelist(tdb, length, rec);
-	tdb_unlock(tdb, -1, F_WRLCK);
+	ret = tdb_allocate_from_freelist(tdb, freelist, length, rec);
+	tdb_unlock(tdb, freelist_lock, F_WRLCK);
 	return ret;
 }
 
+/*
+ * Allocate space for a record that tdb_repack_chains() moves down
+ * from "limit": only free space below "limit" is used, without
+ * over-allocation, and the file is never expanded. Chain "hash" is
+ * assumed to be locked.
+ *
+ * 0 is returned if there is no space below limit or on error.
+ */
+tdb_off_t tdb_allocate_below(struct tdb_context *tdb, int hash,
+			     tdb_len_t length, tdb_off_t limit,
+			     struct tdb_record *rec)
+{
+	uint32_t freelist = TDB_FREELIST_OF(tdb, hash);
+	tdb_off_t ofs = 0;
+	uint32_t i;
+	int ret;
+
+	/* Extra bytes required for tailer */
+	length += sizeof(tdb_off_t);
+	length = TDB_ALIGN(length, TDB_ALIGNMENT);
+
+	for (i=0; i<tdb->num_freelists; i++) {
+		uint32_t list = (freelist + i) % tdb->num_freelists;
+
+		if (i == 0) {
+			ret = tdb_lock(tdb, TDB_FREELIST_LOCK(list), F_WRLCK);
+		} else {
+			ret = tdb_lock_nonblock(tdb, TDB_FREELIST_LOCK(list),
+						F_WRLCK);
+		}
+		if (ret != 0) {
+			continue;
+		}
+		ret = tdb_allocate_from_list(tdb, list, length, limit,
+					     rec, &ofs);
+		tdb_unlock(tdb, TDB_FREELIST_LOCK(list), F_WRLCK);
+		if (ret == -1) {
+			return 0;
+		}
+		if (ofs != 0) {
+			return ofs;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Check whether the record at rec_ptr borders on free space. Without
+ * the freelist lock this is just a hint.
+ */
+bool tdb_next_to_free_space(struct tdb_context *tdb, tdb_off_t rec_ptr,
+			    const struct tdb_record *rec)
+{
+	tdb_off_t left_ptr, right_ptr;
+	struct tdb_record left_rec;
+	uint32_t magic;
+	int ret;
+
+	ret = read_record_on_left(tdb, rec_ptr, &left_ptr, &left_rec);
+	if ((ret == 0) && (left_rec.magic == TDB_FREE_MAGIC)) {
+		return true;
+	}
+
+	right_ptr = rec_ptr + sizeof(*rec) + rec->rec_len;
+	if ((right_ptr < rec_ptr) ||
+	    (right_ptr + sizeof(*rec) > tdb->map_size)) {
+		return false;
+	}
+	ret = tdb_ofs_read(tdb, right_ptr + offsetof(struct tdb_record, magic),
+			   &magic);
+	if (ret == -1) {
+		return false;
+	}
+	return (magic == TDB_FREE_MAGIC);
+}
+
 /**
- * Merge adjacent records in the freelist.
+ * Merge adjacent records in the freelist "list".
  */
-static int tdb_freelist_merge_adjacent(struct tdb_context *tdb,
-				       int *count_records, int *count_merged)
+static int tdb_freelist_merge_adjacent_list(struct tdb_context *tdb,
+					    uint32_t list,
+					    int *count_records,
+					    int *count_merged)
 {
 	tdb_off_t cur, next;
 	int count = 0;
 	int merged = 0;
 	int ret;
 
-	ret = tdb_lock(tdb, -1, F_RDLCK);
+	ret = tdb_lock(tdb, TDB_FREELIST_LOCK(list), F_RDLCK);
 	if (ret == -1) {
 		return -1;
 	}
 
-	cur = FREELIST_TOP;
+	cur = TDB_FREELIST_TOP(list);
 	while (tdb_ofs_read(tdb, cur, &next) == 0 && next != 0) {
 		tdb_off_t next2;
 
 		count++;
 
-		ret = check_merge_ptr_with_left_record(tdb, next, &next2);
+		ret = check_merge_ptr_with_left_record(tdb, list, next,
+						       &next2);
 		if (ret == -1) {
 			goto done;
 		}
@@ -703,8 +933,13 @@ static int tdb_freelist_merge_adjacent(struct tdb_context *tdb,
 				goto done;
 			}
 
-			next = next2;
+			/*
+			 * Stay at cur, next2 may need merging as well.
+			 * Moving on to next2 would also read the
+			 * header at offset 0 if next2 ended the list.
+			 */
 			merged++;
+			continue;
 		}
 
 		cur = next;
@@ -721,28 +956,66 @@ static int tdb_freelist_merge_adjacent(struct tdb_context *tdb,
 	ret = 0;
 
 done:
-	tdb_unlock(tdb, -1, F_RDLCK);
+	tdb_unlock(tdb, TDB_FREELIST_LOCK(list), F_RDLCK);
 	return ret;
 }
 
+/**
+ * Merge adjacent records in all freelists, one list at a time.
+ */
+static int tdb_freelist_merge_adjacent(struct tdb_context *tdb,
+				       int *count_records, int *count_merged)
+{
+	uint32_t list;
+	int count = 0;
+	int merged = 0;
+
+	for (list=0; list<tdb->num_freelists; list++) {
+		int c = 0;
+		int m = 0;
+		int ret;
+
+		ret = tdb_freelist_merge_adjacent_list(tdb, list, &c, &m);
+		if (ret == -1) {
+			return -1;
+		}
+		count += c;
+		merged += m;
+	}
+
+	if (count_records != NULL) {
+		*count_records = count;
+	}
+
+	if (count_merged != NULL) {
+		*count_merged = merged;
+	}
+
+	return 0;
+}
+
 /**
  * return the size of the freelist - no merging done
  */
 static int tdb_freelist_size_no_merge(struct tdb_context *tdb)
 {
 	tdb_off_t ptr;
+	uint32_t list;
 	int count=0;
 
-	if (tdb_lock(tdb, -1, F_RDLCK) == -1) {
-		return -1;
-	}
+	for (list=0; list<tdb->num_freelists; list++) {
+		if (tdb_lock(tdb, TDB_FREELIST_LOCK(list), F_RDLCK) == -1) {
+			return -1;
+		}
 
-	ptr = FREELIST_TOP;
-	while (tdb_ofs_read(tdb, ptr, &ptr) == 0 && ptr != 0) {
-		count++;
+		ptr = TDB_FREELIST_TOP(list);
+		while (tdb_ofs_read(tdb, ptr, &ptr) == 0 && ptr != 0) {
+			count++;
+		}
+
+		tdb_unlock(tdb, TDB_FREELIST_LOCK(list), F_RDLCK);
 	}
 
-	tdb_unlock(tdb, -1, F_RDLCK);
 	return count;
 }
 
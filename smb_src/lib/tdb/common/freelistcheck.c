@@ -42,27 +42,19 @@ static int seen_insert(struct tdb_context *mem_tdb, tdb_off_t rec_ptr)
 	return tdb_store(mem_tdb, key, tdb_null, TDB_INSERT);
 }
 
-_PUBLIC_ int tdb_validate_freelist(struct tdb_context *tdb, int *pnum_entries)
+static int tdb_validate_freelist_list(struct tdb_context *tdb,
+				      struct tdb_context *mem_tdb,
+				      uint32_t list, int *pnum_entries)
 {
-	struct tdb_context *mem_tdb = NULL;
 	struct tdb_record rec;
 	tdb_off_t rec_ptr, last_ptr;
 	int ret = -1;
 
-	*pnum_entries = 0;
-
-	mem_tdb = tdb_open("flval", tdb->hash_size,
-				TDB_INTERNAL, O_RDWR, 0600);
-	if (!mem_tdb) {
-		return -1;
-	}
-
-	if (tdb_lock(tdb, -1, F_WRLCK) == -1) {
-		tdb_close(mem_tdb);
+	if (tdb_lock(tdb, TDB_FREELIST_LOCK(list), F_WRLCK) == -1) {
 		return 0;
 	}
 
-	last_ptr = FREELIST_TOP;
+	last_ptr = TDB_FREELIST_TOP(list);
 
 	/* Store the FREELIST_TOP record. */
 	if (seen_insert(mem_tdb, last_ptr) == -1) {
@@ -72,7 +64,7 @@ _PUBLIC_ int tdb_validate_freelist(struct tdb_context *tdb, int *pnum_entries)
 	}
 
 	/* read in the freelist top */
-	if (tdb_ofs_read(tdb, FREELIST_TOP, &rec_ptr) == -1) {
+	if (tdb_ofs_read(tdb, last_ptr, &rec_ptr) == -1) {
 		goto fail;
 	}
 
@@ -102,7 +94,36 @@ _PUBLIC_ int tdb_validate_freelist(struct tdb_context *tdb, int *pnum_entries)
 
   fail:
 
+	tdb_unlock(tdb, TDB_FREELIST_LOCK(list), F_WRLCK);
+	return ret;
+}
+
+_PUBLIC_ int tdb_validate_freelist(struct tdb_context *tdb, int *pnum_entries)
+{
+	struct tdb_context *mem_tdb = NULL;
+	uint32_t list;
+	int ret = 0;
+
+	*pnum_entries = 0;
+
+	mem_tdb = tdb_open("flval", tdb->hash_size,
+				TDB_INTERNAL, O_RDWR, 0600);
+	if (!mem_tdb) {
+		return -1;
+	}
+
+	/*
+	 * A record on more than one list is caught as a loop
+	 * as well, the lists share the "seen" records.
+	 */
+	for (list=0; list<tdb->num_freelists; list++) {
+		ret = tdb_validate_freelist_list(tdb, mem_tdb, list,
+						 pnum_entries);
+		if (ret != 0) {
+			break;
+		}
+	}
+
 	tdb_close(mem_tdb);
-	tdb_unlock(tdb, -1, F_WRLCK);
 	return ret;
 }
@@ -492,17 +492,23 @@ overflow:
 }
 
 /* expand the database at least size bytes by expanding the underlying
-   file and doing the mmap again if necessary */
-int tdb_expand(struct tdb_context *tdb, tdb_off_t size)
+   file and doing the mmap again if necessary. The new space is put
+   on the freelist "list". */
+int tdb_expand(struct tdb_context *tdb, uint32_t list, tdb_off_t size)
 {
 	struct tdb_record rec;
 	tdb_off_t offset;
 	tdb_off_t new_size;
 
-	if (tdb_lock(tdb, -1, F_WRLCK) == -1) {
+	if (tdb_lock(tdb, TDB_FREELIST_LOCK(list), F_WRLCK) == -1) {
 		TDB_LOG((tdb, TDB_DEBUG_ERROR, "lock failed in tdb_expand\n"));
 		return -1;
 	}
+	if (tdb_lock(tdb, TDB_EXPAND_LOCK(tdb), F_WRLCK) == -1) {
+		TDB_LOG((tdb, TDB_DEBUG_ERROR, "lock failed in tdb_expand\n"));
+		tdb_unlock(tdb, TDB_FREELIST_LOCK(list), F_WRLCK);
+		return -1;
+	}
 
 	/* must know about any previous expansions by another process */
 	tdb->methods->tdb_oob(tdb, tdb->map_size, 1, 1);
@@ -561,13 +567,15 @@ int tdb_expand(struct tdb_context *tdb, tdb_off_t size)
 	}
 
 	/* link it into the free list */
-	if (tdb_free(tdb, offset, &rec) == -1)
+	if (tdb_free_list(tdb, list, offset, &rec) == -1)
 		goto fail;
 
-	tdb_unlock(tdb, -1, F_WRLCK);
+	tdb_unlock(tdb, TDB_EXPAND_LOCK(tdb), F_WRLCK);
+	tdb_unlock(tdb, TDB_FREELIST_LOCK(list), F_WRLCK);
 	return 0;
  fail:
-	tdb_unlock(tdb, -1, F_WRLCK);
+	tdb_unlock(tdb, TDB_EXPAND_LOCK(tdb), F_WRLCK);
+	tdb_unlock(tdb, TDB_FREELIST_LOCK(list), F_WRLCK);
 	return -1;
 }
 
@@ -384,7 +384,8 @@ static bool have_data_locks(const struct tdb_context *tdb)
 	unsigned int i;
 
 	for (i = 0; i < tdb->num_lockrecs; i++) {
-		if (tdb->lockrecs[i].off >= lock_offset(-1))
+		if (tdb->lockrecs[i].off >=
+		    lock_offset(-(int)TDB_NUM_FREELIST_LOCKS(tdb)))
 			return true;
 	}
 	return false;
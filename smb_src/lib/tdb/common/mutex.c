@@ -70,7 +70,9 @@ struct tdb_mutexes {
 
 	/*
 	 * Index 0 is the freelist mutex, followed by
-	 * one mutex per hashchain.
+	 * one mutex per hashchain, followed by the mutexes
+	 * for freelists 1 and up and the expand lock
+	 * (TDB_FEATURE_FLAG_FREELISTS).
 	 */
 	pthread_mutex_t hashchains[1];
 };
@@ -90,6 +92,8 @@ size_t tdb_mutex_size(struct tdb_context *tdb)
 
 	mutex_size = sizeof(struct tdb_mutexes);
 	mutex_size += tdb->hash_size * sizeof(pthread_mutex_t);
+	mutex_size += (TDB_NUM_FREELIST_LOCKS(tdb) - 1) *
+		sizeof(pthread_mutex_t);
 
 	return TDB_ALIGN(mutex_size, tdb->page_size);
 }
@@ -108,6 +112,7 @@ static bool tdb_mutex_index(struct tdb_context *tdb, off_t off, off_t len,
 	 * the tdb file itself as data, we need to adjust the offset here.
 	 */
 	const off_t freelist_lock_ofs = FREELIST_TOP - sizeof(tdb_off_t);
+	off_t first_freelist_ofs;
 
 	if (!tdb_have_mutexes(tdb)) {
 		return false;
@@ -116,14 +121,31 @@ static bool tdb_mutex_index(struct tdb_context *tdb, off_t off, off_t len,
 		/* Possibly the allrecord lock */
 		return false;
 	}
-	if (off < freelist_lock_ofs) {
-		/* One of the special locks */
-		return false;
-	}
 	if (tdb->hash_size == 0) {
 		/* tdb not initialized yet, called from tdb_open_ex() */
 		return false;
 	}
+
+	/*
+	 * The locks of the additional freelists are placed in
+	 * front of the lock for freelist 0, their mutexes are
+	 * behind the hash chain mutexes.
+	 */
+	first_freelist_ofs = freelist_lock_ofs -
+		(TDB_NUM_FREELIST_LOCKS(tdb) - 1) * sizeof(tdb_off_t);
+
+	if (off < first_freelist_ofs) {
+		/* One of the special locks */
+		return false;
+	}
+	if (off < freelist_lock_ofs) {
+		if ((off % sizeof(tdb_off_t)) != 0) {
+			abort();
+		}
+		*idx = tdb->hash_size +
+			(freelist_lock_ofs - off) / sizeof(tdb_off_t);
+		return true;
+	}
 	if (off >= TDB_DATA_START(tdb->hash_size)) {
 		/* Single record lock from traverses */
 		return false;
@@ -147,6 +169,11 @@ static bool tdb_mutex_index(struct tdb_context *tdb, off_t off, off_t len,
 	return true;
 }
 
+static bool tdb_mutex_is_freelist(struct tdb_context *tdb, unsigned idx)
+{
+	return ((idx == 0) || (idx > tdb->hash_size));
+}
+
 static bool tdb_have_mutex_chainlocks(struct tdb_context *tdb)
 {
 	size_t i;
@@ -163,8 +190,8 @@ static bool tdb_have_mutex_chainlocks(struct tdb_context *tdb)
 			continue;
 		}
 
-		if (idx == 0) {
-			/* this is the freelist mutex */
+		if (tdb_mutex_is_freelist(tdb, idx)) {
+			/* this is a freelist mutex */
 			continue;
 		}
 
@@ -240,7 +267,7 @@ again:
 		goto fail;
 	}
 
-	if (idx == 0) {
+	if (tdb_mutex_is_freelist(tdb, idx)) {
 		/*
 		 * This is a freelist lock, which is independent to
 		 * the allrecord lock. So we're done once we got the
@@ -584,7 +611,7 @@ int tdb_mutex_init(struct tdb_context *tdb)
 		goto fail;
 	}
 
-	for (i=0; i<tdb->hash_size+1; i++) {
+	for (i=0; i<tdb->hash_size+TDB_NUM_FREELIST_LOCKS(tdb); i++) {
 		pthread_mutex_t *chain = &m->hashchains[i];
 
 		ret = pthread_mutex_init(chain, &ma);
@@ -73,7 +73,7 @@ static int tdb_new_database(struct tdb_context *tdb, struct tdb_header *header,
 
 	/* Make sure older tdbs (which don't check the magic hash fields)
 	 * will refuse to open this TDB. */
-	if (tdb->flags & TDB_INCOMPATIBLE_HASH)
+	if (tdb->flags & (TDB_INCOMPATIBLE_HASH|TDB_FAST_HASH))
 		newdb->rwlocks = TDB_HASH_RWLOCK_MAGIC;
 
 	/*
@@ -85,6 +85,15 @@ static int tdb_new_database(struct tdb_context *tdb, struct tdb_header *header,
 		newdb->feature_flags |= TDB_FEATURE_FLAG_MUTEX;
 	}
 
+	/*
+	 * Several freelists only make sense if there are enough
+	 * hash chains to spread over them.
+	 */
+	if ((tdb->flags & TDB_MULTI_FREELIST) && hash_size > 1) {
+		newdb->feature_flags |= TDB_FEATURE_FLAG_FREELISTS;
+		newdb->num_freelists = MIN(hash_size, TDB_MAX_FREELISTS);
+	}
+
 	/*
 	 * If we have any features we add the FEATURE_FLAG_MAGIC, overwriting the
 	 * TDB_HASH_RWLOCK_MAGIC above.
@@ -101,6 +110,7 @@ static int tdb_new_database(struct tdb_context *tdb, struct tdb_header *header,
 	 */
 	tdb->feature_flags = newdb->feature_flags;
 	tdb->hash_size = newdb->hash_size;
+	tdb->num_freelists = MAX(newdb->num_freelists, 1);
 
 	if (tdb->flags & TDB_INTERNAL) {
 		tdb->map_size = size;
@@ -209,6 +219,12 @@ static bool check_header_hash(struct tdb_context *tdb,
 			      struct tdb_header *header,
 			      bool default_hash, uint32_t *m1, uint32_t *m2)
 {
+	tdb_hash_func builtin[] = {
+		tdb_old_hash, tdb_jenkins_hash, tdb_crc32c_hash
+	};
+	tdb_hash_func hash_fn = tdb->hash_fn;
+	size_t i;
+
 	tdb_header_hash(tdb, m1, m2);
 	if (header->magic1_hash == *m1 &&
 	    header->magic2_hash == *m2) {
@@ -219,12 +235,26 @@ static bool check_header_hash(struct tdb_context *tdb,
 	if (!default_hash)
 		return false;
 
-	/* Otherwise, try the other inbuilt hash. */
-	if (tdb->hash_fn == tdb_old_hash)
-		tdb->hash_fn = tdb_jenkins_hash;
-	else
-		tdb->hash_fn = tdb_old_hash;
-	return check_header_hash(tdb, header, false, m1, m2);
+	/* Otherwise, try the other inbuilt hashes. */
+	for (i=0; i<ARRAY_SIZE(builtin); i++) {
+		uint32_t b1, b2;
+
+		if (builtin[i] == hash_fn) {
+			continue;
+		}
+		tdb->hash_fn = builtin[i];
+		tdb_header_hash(tdb, &b1, &b2);
+		if (header->magic1_hash == b1 &&
+		    header->magic2_hash == b2) {
+			*m1 = b1;
+			*m2 = b2;
+			return true;
+		}
+	}
+
+	/* Report the mismatch against the hash they asked for */
+	tdb->hash_fn = hash_fn;
+	return false;
 }
 
 static bool tdb_mutex_open_ok(struct tdb_context *tdb,
@@ -316,6 +346,7 @@ _PUBLIC_ struct tdb_context *tdb_open_ex(const char *name, int hash_size, int td
 		goto fail;
 	}
 	tdb_io_init(tdb);
+	tdb->num_freelists = 1;
 
 	if (tdb_flags & TDB_INTERNAL) {
 		tdb_flags |= TDB_INCOMPATIBLE_HASH;
@@ -370,7 +401,9 @@ _PUBLIC_ struct tdb_context *tdb_open_ex(const char *name, int hash_size, int td
 		hash_alg = "the user defined";
 	} else {
 		/* This controls what we use when creating a tdb. */
-		if (tdb->flags & TDB_INCOMPATIBLE_HASH) {
+		if (tdb->flags & TDB_FAST_HASH) {
+			tdb->hash_fn = tdb_crc32c_hash;
+		} else if (tdb->flags & TDB_INCOMPATIBLE_HASH) {
 			tdb->hash_fn = tdb_jenkins_hash;
 		} else {
 			tdb->hash_fn = tdb_old_hash;
@@ -608,6 +641,20 @@ _PUBLIC_ struct tdb_context *tdb_open_ex(const char *name, int hash_size, int td
 		goto fail;
 	}
 
+	tdb->num_freelists = 1;
+	if (tdb->feature_flags & TDB_FEATURE_FLAG_FREELISTS) {
+		if ((header.num_freelists < 2) ||
+		    (header.num_freelists > TDB_MAX_FREELISTS) ||
+		    (header.num_freelists > header.hash_size)) {
+			TDB_LOG((tdb, TDB_DEBUG_ERROR, "tdb_open_ex: "
+				 "invalid number of freelists in %s: %u\n",
+				 name, (unsigned)header.num_freelists));
+			errno = EINVAL;
+			goto fail;
+		}
+		tdb->num_freelists = header.num_freelists;
+	}
+
 	if (tdb->feature_flags & TDB_FEATURE_FLAG_MUTEX) {
 		if (!tdb_mutex_open_ok(tdb, &header)) {
 			errno = EINVAL;
@@ -286,6 +286,33 @@ _PUBLIC_ int tdb_rescue(struct tdb_context *tdb,
 		}
 	}
 
+	/* The other freelists, if any. */
+	for (h = 1; h < tdb->num_freelists; h++) {
+		bool slow_chase = false;
+		tdb_off_t slow_off = TDB_FREELIST_TOP(h);
+
+		if (tdb_ofs_read(tdb, TDB_FREELIST_TOP(h), &off) == -1)
+			continue;
+
+		while (off && off != slow_off) {
+			if (tdb->methods->tdb_read(tdb, off, &rec, sizeof(rec),
+						   DOCONV()) != 0) {
+				break;
+			}
+			if (rec.magic != TDB_FREE_MAGIC) {
+				break;
+			}
+			mark_free_area(&found, off, sizeof(rec) + rec.rec_len);
+
+			off = rec.next;
+
+			if (slow_chase) {
+				tdb_ofs_read(tdb, slow_off, &slow_off);
+			}
+			slow_chase = !slow_chase;
+		}
+	}
+
 	/* Recovery area: must be marked as free, since it often has old
 	 * records in there! */
 	if (tdb_ofs_read(tdb, TDB_RECOVERY_HEAD, &off) == 0 && off != 0) {
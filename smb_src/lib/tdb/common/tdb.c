@@ -258,6 +258,142 @@ _PUBLIC_ int tdb_parse_record(struct tdb_context *tdb, TDB_DATA key,
 	return ret;
 }
 
+struct tdb_parse_records_key {
+	uint32_t bucket;
+	uint32_t hash;
+	size_t idx;
+};
+
+static int tdb_parse_records_key_cmp(const void *p1, const void *p2)
+{
+	const struct tdb_parse_records_key *k1 =
+		(const struct tdb_parse_records_key *)p1;
+	const struct tdb_parse_records_key *k2 =
+		(const struct tdb_parse_records_key *)p2;
+	if (k1->bucket != k2->bucket) {
+		return (k1->bucket < k2->bucket) ? -1 : 1;
+	}
+	if (k1->idx != k2->idx) {
+		return (k1->idx < k2->idx) ? -1 : 1;
+	}
+	return 0;
+}
+
+struct tdb_parse_records_state {
+	size_t idx;
+	int (*parser)(size_t idx, TDB_DATA key, TDB_DATA data,
+		      void *private_data);
+	void *private_data;
+};
+
+static int tdb_parse_records_parser(TDB_DATA key, TDB_DATA data,
+				    void *private_data)
+{
+	struct tdb_parse_records_state *state =
+		(struct tdb_parse_records_state *)private_data;
+
+	return state->parser(state->idx, key, data, state->private_data);
+}
+
+/*
+ * Like tdb_parse_record, but for a whole set of keys. The keys are sorted
+ * by hash chain, and each chain involved is read locked only once while all
+ * of its keys are looked up. Within a chain, keys are handed to the parser
+ * in the order they were passed in, the parser's "idx" argument is the
+ * position of the key in the "keys" array.
+ *
+ * Keys that do not exist are silently skipped. If the parser returns
+ * non-zero, the walk is stopped and that value is returned.
+ *
+ * Returns 0 if all keys were processed, -1 on error.
+ */
+_PUBLIC_ int tdb_parse_records(struct tdb_context *tdb,
+			       const TDB_DATA *keys, size_t num_keys,
+			       int (*parser)(size_t idx, TDB_DATA key,
+					     TDB_DATA data,
+					     void *private_data),
+			       void *private_data)
+{
+	struct tdb_parse_records_state state = {
+		.parser = parser, .private_data = private_data
+	};
+	struct tdb_parse_records_key *sorted;
+	uint32_t locked = 0;
+	bool have_lock = false;
+	size_t i;
+	int ret = 0;
+
+	if (num_keys == 0) {
+		return 0;
+	}
+	if (num_keys > SIZE_MAX / sizeof(*sorted)) {
+		tdb->ecode = TDB_ERR_OOM;
+		return -1;
+	}
+
+	sorted = (struct tdb_parse_records_key *)malloc(
+		num_keys * sizeof(*sorted));
+	if (sorted == NULL) {
+		tdb->ecode = TDB_ERR_OOM;
+		return -1;
+	}
+
+	for (i=0; i<num_keys; i++) {
+		TDB_DATA key = keys[i];
+
+		sorted[i].hash = tdb->hash_fn(&key);
+		sorted[i].bucket = BUCKET(sorted[i].hash);
+		sorted[i].idx = i;
+	}
+	qsort(sorted, num_keys, sizeof(*sorted), tdb_parse_records_key_cmp);
+
+	for (i=0; i<num_keys; i++) {
+		uint32_t bucket = sorted[i].bucket;
+		TDB_DATA key = keys[sorted[i].idx];
+		struct tdb_record rec;
+		tdb_off_t rec_ptr;
+
+		if (!have_lock || (bucket != locked)) {
+			if (have_lock) {
+				tdb_unlock(tdb, locked, F_RDLCK);
+				have_lock = false;
+			}
+			if (tdb_lock(tdb, bucket, F_RDLCK) == -1) {
+				ret = -1;
+				break;
+			}
+			locked = bucket;
+			have_lock = true;
+		}
+
+		rec_ptr = tdb_find(tdb, key, sorted[i].hash, &rec);
+		if (rec_ptr == 0) {
+			if (tdb->ecode == TDB_ERR_NOEXIST) {
+				continue;
+			}
+			ret = -1;
+			break;
+		}
+
+		state.idx = sorted[i].idx;
+		ret = tdb_parse_data(tdb, key,
+				     rec_ptr + sizeof(rec) + rec.key_len,
+				     rec.data_len, tdb_parse_records_parser,
+				     &state);
+		if (ret != 0) {
+			break;
+		}
+	}
+
+	if (have_lock) {
+		tdb_unlock(tdb, locked, F_RDLCK);
+	}
+	free(sorted);
+
+	tdb_trace_ret(tdb, "tdb_parse_records", ret);
+	return ret;
+}
+
 /* check if an entry in the database exists
 
    note that 1 is returned if the key is found and 0 is returned if not found
@@ -347,11 +483,12 @@ static int tdb_count_dead(struct tdb_context *tdb, uint32_t hash)
  */
 int tdb_purge_dead(struct tdb_context *tdb, uint32_t hash)
 {
+	int freelist_lock = TDB_FREELIST_LOCK(TDB_FREELIST_OF(tdb, hash));
 	int res = -1;
 	struct tdb_record rec;
 	tdb_off_t rec_ptr;
 
-	if (tdb_lock_nonblock(tdb, -1, F_WRLCK) == -1) {
+	if (tdb_lock_nonblock(tdb, freelist_lock, F_WRLCK) == -1) {
 		/*
 		 * Don't block the freelist if not strictly necessary
 		 */
@@ -379,7 +516,7 @@ int tdb_purge_dead(struct tdb_context *tdb, uint32_t hash)
 	}
 	res = 0;
  fail:
-	tdb_unlock(tdb, -1, F_WRLCK);
+	tdb_unlock(tdb, freelist_lock, F_WRLCK);
 	return res;
 }
 
@@ -785,6 +922,7 @@ static int tdb_free_region(struct tdb_context *tdb, tdb_off_t offset, ssize_t le
  */
 _PUBLIC_ int tdb_wipe_all(struct tdb_context *tdb)
 {
+	uint32_t list;
 	int i;
 	tdb_off_t offset = 0;
 	ssize_t data_len;
@@ -823,10 +961,12 @@ _PUBLIC_ int tdb_wipe_all(struct tdb_context *tdb)
 		}
 	}
 
-	/* wipe the freelist */
-	if (tdb_ofs_write(tdb, FREELIST_TOP, &offset) == -1) {
-		TDB_LOG((tdb, TDB_DEBUG_FATAL,"tdb_wipe_all: failed to write freelist\n"));
-		goto failed;
+	/* wipe the freelists */
+	for (list=0; list<tdb->num_freelists; list++) {
+		if (tdb_ofs_write(tdb, TDB_FREELIST_TOP(list), &offset) == -1) {
+			TDB_LOG((tdb, TDB_DEBUG_FATAL,"tdb_wipe_all: failed to write freelist %u\n", list));
+			goto failed;
+		}
 	}
 
 	/* add all the rest of the file to the freelist, possibly leaving a gap
@@ -962,6 +1102,223 @@ _PUBLIC_ int tdb_repack(struct tdb_context *tdb)
 	return 0;
 }
 
+/*
+ * Move the record at rec_ptr into free space further down the file.
+ * Returns the new offset, rec_ptr if there is no such space, or 0 on
+ * error. The chain is locked and *last_ptr points at rec_ptr.
+ */
+static tdb_off_t tdb_repack_move(struct tdb_context *tdb, uint32_t chain,
+				 tdb_off_t last_ptr, tdb_off_t rec_ptr,
+				 struct tdb_record *rec)
+{
+	struct tdb_record newrec;
+	tdb_off_t new_ptr;
+	tdb_len_t len = rec->key_len + rec->data_len;
+	unsigned char *buf;
+	int ret;
+
+	new_ptr = tdb_allocate_below(tdb, chain, len, rec_ptr, &newrec);
+	if (new_ptr == 0) {
+		return rec_ptr;
+	}
+
+	buf = tdb_alloc_read(tdb, rec_ptr + sizeof(*rec), len);
+	if (buf == NULL) {
+		goto fail;
+	}
+
+	newrec.next = rec->next;
+	newrec.key_len = rec->key_len;
+	newrec.data_len = rec->data_len;
+	newrec.full_hash = rec->full_hash;
+	newrec.magic = TDB_MAGIC;
+
+	ret = tdb_rec_write(tdb, new_ptr, &newrec);
+	if (ret == 0) {
+		ret = tdb->methods->tdb_write(tdb, new_ptr + sizeof(newrec),
+					      buf, len);
+	}
+	SAFE_FREE(buf);
+	if (ret == -1) {
+		goto fail;
+	}
+
+	/* switch the chain over to the copy, then free the original */
+	if (tdb_ofs_write(tdb, last_ptr, &new_ptr) == -1) {
+		goto fail;
+	}
+	if (tdb_free(tdb, rec_ptr, rec) == -1) {
+		return 0;
+	}
+	*rec = newrec;
+	return new_ptr;
+
+fail:
+	tdb_free(tdb, new_ptr, &newrec);
+	return 0;
+}
+
+/*
+ * Cut the unused end of the record at rec_ptr off into a free record.
+ * Returns the number of bytes trimmed, 0 if not worth it or -1 on error.
+ */
+static int tdb_repack_trim(struct tdb_context *tdb, tdb_off_t rec_ptr,
+			   struct tdb_record *rec)
+{
+	struct tdb_record tail;
+	tdb_len_t needed;
+	tdb_off_t tailer;
+
+	needed = rec->key_len + rec->data_len + sizeof(tdb_off_t);
+	needed = TDB_ALIGN(needed, TDB_ALIGNMENT);
+
+	if ((rec->rec_len < needed) ||
+	    (rec->rec_len - needed < 2 * sizeof(struct tdb_record))) {
+		return 0;
+	}
+
+	memset(&tail, 0, sizeof(tail));
+	tail.rec_len = rec->rec_len - needed - sizeof(tail);
+	tail.full_hash = rec->full_hash;
+
+	rec->rec_len = needed;
+	tailer = sizeof(*rec) + rec->rec_len;
+	if ((tdb_rec_write(tdb, rec_ptr, rec) == -1) ||
+	    (tdb_ofs_write(tdb, rec_ptr + tailer - sizeof(tdb_off_t),
+			   &tailer) == -1)) {
+		return -1;
+	}
+	if (tdb_free(tdb, rec_ptr + tailer, &tail) == -1) {
+		return -1;
+	}
+	return sizeof(tail) + tail.rec_len;
+}
+
+static int tdb_repack_chain(struct tdb_context *tdb, uint32_t chain,
+			    struct tdb_repack_stats *stats)
+{
+	tdb_off_t last_ptr, rec_ptr;
+	struct tdb_record rec;
+
+	last_ptr = TDB_HASH_TOP(chain);
+	if (tdb_ofs_read(tdb, last_ptr, &rec_ptr) == -1) {
+		return -1;
+	}
+
+	while (rec_ptr != 0) {
+		tdb_off_t new_ptr;
+		tdb_len_t old_len;
+		int trimmed;
+
+		if (tdb_rec_read(tdb, rec_ptr, &rec) == -1) {
+			return -1;
+		}
+
+		/* Someone traversing here: leave the record alone */
+		if (tdb_write_lock_record(tdb, rec_ptr) == -1) {
+			last_ptr = rec_ptr;
+			rec_ptr = rec.next;
+			continue;
+		}
+		if (tdb_write_unlock_record(tdb, rec_ptr) != 0) {
+			return -1;
+		}
+
+		if (rec.magic == TDB_DEAD_MAGIC) {
+			tdb_off_t next = rec.next;
+
+			if ((tdb_ofs_write(tdb, last_ptr, &next) == -1) ||
+			    (tdb_free(tdb, rec_ptr, &rec) == -1)) {
+				return -1;
+			}
+			stats->purged += 1;
+			stats->bytes_reclaimed += sizeof(rec) + rec.rec_len;
+			rec_ptr = next;
+			continue;
+		}
+
+		old_len = rec.rec_len;
+
+		if (tdb_next_to_free_space(tdb, rec_ptr, &rec)) {
+			new_ptr = tdb_repack_move(tdb, chain, last_ptr,
+						  rec_ptr, &rec);
+			if (new_ptr == 0) {
+				return -1;
+			}
+			if (new_ptr != rec_ptr) {
+				stats->moved += 1;
+				stats->bytes_moved += sizeof(rec) + old_len;
+				if (old_len > rec.rec_len) {
+					stats->bytes_reclaimed +=
+						old_len - rec.rec_len;
+				}
+				rec_ptr = new_ptr;
+			}
+		}
+
+		trimmed = tdb_repack_trim(tdb, rec_ptr, &rec);
+		if (trimmed == -1) {
+			return -1;
+		}
+		if (trimmed > 0) {
+			stats->trimmed += 1;
+			stats->bytes_reclaimed += trimmed;
+		}
+
+		last_ptr = rec_ptr;
+		rec_ptr = rec.next;
+	}
+
+	return 0;
+}
+
+_PUBLIC_ int tdb_repack_chains(struct tdb_context *tdb, uint32_t start,
+			       uint32_t num_chains,
+			       struct tdb_repack_stats *stats)
+{
+	struct tdb_repack_stats dummy;
+	uint32_t chain;
+
+	tdb_trace(tdb, "tdb_repack_chains");
+
+	if (tdb->read_only || tdb->traverse_read) {
+		tdb->ecode = TDB_ERR_RDONLY;
+		return -1;
+	}
+	if ((tdb->traverse_write != 0) || (tdb->transaction != NULL) ||
+	    (start >= tdb->hash_size)) {
+		tdb->ecode = TDB_ERR_EINVAL;
+		return -1;
+	}
+
+	if (stats == NULL) {
+		memset(&dummy, 0, sizeof(dummy));
+		stats = &dummy;
+	}
+
+	for (chain = start;
+	     (chain < tdb->hash_size) && (chain - start < num_chains);
+	     chain++) {
+		int ret;
+
+		if (tdb_lock_nonblock(tdb, chain, F_WRLCK) != 0) {
+			stats->chains_busy += 1;
+			continue;
+		}
+		ret = tdb_repack_chain(tdb, chain, stats);
+		tdb_unlock(tdb, chain, F_WRLCK);
+		if (ret == -1) {
+			return -1;
+		}
+		stats->chains += 1;
+	}
+
+	if (chain == tdb->hash_size) {
+		return 0;
+	}
+	return chain;
+}
+
 /* Even on files, we can get partial writes due to signals. */
 bool tdb_write_all(int fd, const void *buf, size_t count)
 {
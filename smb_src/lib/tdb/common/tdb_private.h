@@ -70,11 +70,33 @@ typedef uint32_t tdb_off_t;
 #define TDB_PAD_U32  0x42424242
 
 #define TDB_FEATURE_FLAG_MUTEX 0x00000001
+#define TDB_FEATURE_FLAG_FREELISTS 0x00000002
 
 #define TDB_SUPPORTED_FEATURE_FLAGS ( \
 	TDB_FEATURE_FLAG_MUTEX | \
+	TDB_FEATURE_FLAG_FREELISTS | \
 	0)
 
+/*
+ * With TDB_FEATURE_FLAG_FREELISTS, free space is spread over
+ * header.num_freelists lists. List 0 is at FREELIST_TOP, the others
+ * have their heads in the header. Hash chain "h" allocates from and
+ * frees into list BUCKET(h) % num_freelists. Each list has its own
+ * lock, placed in front of the lock for list 0 (see lock_offset()),
+ * followed by a lock serializing tdb_expand(). With a single freelist
+ * list 0's lock also serializes tdb_expand().
+ */
+#define TDB_MAX_FREELISTS 16
+#define TDB_FREELIST_TOP(list) ((list) == 0 ? FREELIST_TOP : \
+	offsetof(struct tdb_header, freelist_tops) + \
+	((list)-1) * sizeof(tdb_off_t))
+#define TDB_FREELIST_LOCK(list) (-1 - (int)(list))
+#define TDB_FREELIST_OF(tdb, hash) (BUCKET(hash) % (tdb)->num_freelists)
+#define TDB_EXPAND_LOCK(tdb) TDB_FREELIST_LOCK( \
+	(tdb)->num_freelists == 1 ? 0 : (tdb)->num_freelists)
+#define TDB_NUM_FREELIST_LOCKS(tdb) \
+	((tdb)->num_freelists == 1 ? 1 : (tdb)->num_freelists + 1)
+
 /* NB assumes there is a local variable called "tdb" that is the
  * current context, also takes doubly-parenthesized print-style
  * argument. */
@@ -134,7 +156,8 @@ struct tdb_record {
 	tdb_len_t rec_len; /* total byte length of record */
 	tdb_len_t key_len; /* byte length of key */
 	tdb_len_t data_len; /* byte length of data */
-	uint32_t full_hash; /* the full 32 bit hash of the key */
+	uint32_t full_hash; /* the full 32 bit hash of the key, for
+			     * free records the freelist they are on */
 	uint32_t magic;   /* try to catch errors */
 	/* the following union is implied:
 		union {
@@ -161,7 +184,9 @@ struct tdb_header {
 	uint32_t magic2_hash; /* hash of TDB_MAGIC. */
 	uint32_t feature_flags;
 	tdb_len_t mutex_size; /* set if TDB_FEATURE_FLAG_MUTEX is set */
-	tdb_off_t reserved[25];
+	uint32_t num_freelists; /* set if TDB_FEATURE_FLAG_FREELISTS is set */
+	tdb_off_t freelist_tops[TDB_MAX_FREELISTS-1]; /* lists 1 and up */
+	tdb_off_t reserved[25-TDB_MAX_FREELISTS];
 };
 
 struct tdb_lock_type {
@@ -216,6 +241,7 @@ struct tdb_context {
 	enum TDB_ERROR ecode; /* error code for last tdb error */
 	uint32_t hash_size;
 	uint32_t feature_flags;
+	uint32_t num_freelists; /* 1 without TDB_FEATURE_FLAG_FREELISTS */
 	uint32_t flags; /* the flags passed to tdb_open */
 	struct tdb_traverse_lock travlocks; /* current traversal locks */
 	struct tdb_context *next; /* all tdbs to avoid multiple opens */
@@ -271,8 +297,15 @@ int tdb_ofs_read(struct tdb_context *tdb, tdb_off_t offset, tdb_off_t *d);
 int tdb_ofs_write(struct tdb_context *tdb, tdb_off_t offset, tdb_off_t *d);
 void *tdb_convert(void *buf, uint32_t size);
 int tdb_free(struct tdb_context *tdb, tdb_off_t offset, struct tdb_record *rec);
+int tdb_free_list(struct tdb_context *tdb, uint32_t list, tdb_off_t offset,
+		  struct tdb_record *rec);
 tdb_off_t tdb_allocate(struct tdb_context *tdb, int hash, tdb_len_t length,
 		       struct tdb_record *rec);
+tdb_off_t tdb_allocate_below(struct tdb_context *tdb, int hash,
+			     tdb_len_t length, tdb_off_t limit,
+			     struct tdb_record *rec);
+bool tdb_next_to_free_space(struct tdb_context *tdb, tdb_off_t rec_ptr,
+			    const struct tdb_record *rec);
 int tdb_ofs_read(struct tdb_context *tdb, tdb_off_t offset, tdb_off_t *d);
 int tdb_ofs_write(struct tdb_context *tdb, tdb_off_t offset, tdb_off_t *d);
 int tdb_lock_record(struct tdb_context *tdb, tdb_off_t off);
@@ -294,7 +327,7 @@ tdb_off_t tdb_find_dead(struct tdb_context *tdb, uint32_t hash,
 			tdb_off_t *p_last_ptr);
 int tdb_purge_dead(struct tdb_context *tdb, uint32_t hash);
 void tdb_io_init(struct tdb_context *tdb);
-int tdb_expand(struct tdb_context *tdb, tdb_off_t size);
+int tdb_expand(struct tdb_context *tdb, uint32_t list, tdb_off_t size);
 tdb_off_t tdb_expand_adjust(tdb_off_t map_size, tdb_off_t size, int page_size);
 int tdb_rec_free_read(struct tdb_context *tdb, tdb_off_t off,
 		      struct tdb_record *rec);
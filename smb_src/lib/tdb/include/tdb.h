@@ -84,6 +84,10 @@ extern "C" {
 #define TDB_MUTEX_LOCKING 4096 /** optimized locking using robust mutexes if supported,
                                    only with tdb >= 1.3.0 and TDB_CLEAR_IF_FIRST
                                    after checking tdb_runtime_check_for_robust_mutexes() */
+#define TDB_MULTI_FREELIST 8192 /** Spread free space over several freelists with
+                                    their own locks, only used when the db is
+                                    created, can't be opened by tdb < 1.3.5 */
+#define TDB_FAST_HASH 16384 /** Faster hashing (CRC32C): can't be opened by tdb < 1.3.5 */
 
 /** The tdb error codes */
 enum TDB_ERROR {TDB_SUCCESS=0, TDB_ERR_CORRUPT, TDB_ERR_IO, TDB_ERR_LOCK, 
@@ -152,6 +156,10 @@ struct tdb_logging_context {
  *                                             can't be opened by tdb < 1.3.0.
  *                                             Only valid in combination with TDB_CLEAR_IF_FIRST
  *                                             after checking tdb_runtime_check_for_robust_mutexes()\n
+ *                         TDB_MULTI_FREELIST - Use several freelists with separate locks,
+ *                                              can't be opened by tdb < 1.3.5.
+ *                                              Only used when the db is created.\n
+ *                         TDB_FAST_HASH - Faster hashing (CRC32C): can't be opened by tdb < 1.3.5.\n
  *
  * @param[in]  open_flags Flags for the open(2) function.
  *
@@ -193,6 +201,10 @@ struct tdb_context *tdb_open(const char *name, int hash_size, int tdb_flags,
  *                                             can't be opened by tdb < 1.3.0.
  *                                             Only valid in combination with TDB_CLEAR_IF_FIRST
  *                                             after checking tdb_runtime_check_for_robust_mutexes()\n
+ *                         TDB_MULTI_FREELIST - Use several freelists with separate locks,
+ *                                              can't be opened by tdb < 1.3.5.
+ *                                              Only used when the db is created.\n
+ *                         TDB_FAST_HASH - Faster hashing (CRC32C): can't be opened by tdb < 1.3.5.\n
  *
  * @param[in]  open_flags Flags for the open(2) function.
  *
@@ -324,6 +336,41 @@ int tdb_parse_record(struct tdb_context *tdb, TDB_DATA key,
 					    void *private_data),
 			      void *private_data);
 
+/**
+ * @brief Hand a set of records to a parser function in one pass.
+ *
+ * This is the batch version of tdb_parse_record(). The keys are sorted by
+ * hash chain internally, so every chain involved is read locked only once,
+ * no matter how many of the keys live in it.
+ *
+ * @warning The same restrictions as for tdb_parse_record() apply to the
+ * parser: it is called with a chain lock held.
+ *
+ * @param[in]  tdb      The tdb to parse the records.
+ *
+ * @param[in]  keys     The keys to parse.
+ *
+ * @param[in]  num_keys The number of keys.
+ *
+ * @param[in]  parser   The parser to use to parse the data. "idx" is the
+ *                      position of the key in the "keys" array. Keys that do
+ *                      not exist are skipped. If the parser returns non-zero,
+ *                      no further records are parsed.
+ *
+ * @param[in]  private_data A private data pointer which is passed to the parser
+ *                          function.
+ *
+ * @return              0 if all keys were processed, -1 on error, or the
+ *                      non-zero return value of "parser".
+ *
+ * @see tdb_parse_record()
+ */
+int tdb_parse_records(struct tdb_context *tdb,
+		      const TDB_DATA *keys, size_t num_keys,
+		      int (*parser)(size_t idx, TDB_DATA key, TDB_DATA data,
+				    void *private_data),
+		      void *private_data);
+
 /**
  * @brief Delete an entry in the database given a key.
  *
@@ -809,6 +856,18 @@ void tdb_increment_seqnum_nonblock(struct tdb_context *tdb);
  */
 unsigned int tdb_jenkins_hash(TDB_DATA *key);
 
+/**
+ * @brief Create a hash of the key, as used by TDB_FAST_HASH.
+ *
+ * This is a CRC32C, using the SSE4.2 crc32 instruction if the cpu has
+ * it. The result is the same on all platforms.
+ *
+ * @param[in]  key      The key to hash
+ *
+ * @return              The hash.
+ */
+unsigned int tdb_crc32c_hash(TDB_DATA *key);
+
 /**
  * @brief Check the consistency of the database.
  *
@@ -894,6 +953,28 @@ void tdb_setalarm_sigptr(struct tdb_context *tdb, volatile sig_atomic_t *sigptr)
 int tdb_wipe_all(struct tdb_context *tdb);
 int tdb_repack(struct tdb_context *tdb);
 
+/*
+ * Incremental repack: tdb_repack_chains() walks num_chains hash chains
+ * from "start" on, taking only the chain lock (and skipping busy
+ * chains). It purges dead records, moves records that border on free
+ * space down into a free hole and trims unused slack off the end of
+ * records. The counters in stats are added to, stats may be NULL.
+ *
+ * Returns the chain to continue with, 0 once all chains have been
+ * walked, or -1 on error.
+ */
+struct tdb_repack_stats {
+	uint32_t chains;
+	uint32_t chains_busy;
+	uint32_t moved;
+	uint32_t trimmed;
+	uint32_t purged;
+	uint64_t bytes_moved;
+	uint64_t bytes_reclaimed;
+};
+int tdb_repack_chains(struct tdb_context *tdb, uint32_t start,
+		      uint32_t num_chains, struct tdb_repack_stats *stats);
+
 /* Debug functions. Not used in production. */
 void tdb_dump_all(struct tdb_context *tdb);
 int tdb_printfreelist(struct tdb_context *tdb);
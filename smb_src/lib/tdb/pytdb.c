@@ -695,6 +695,7 @@ void inittdb(void)
 	PyModule_AddObject(m, "ALLOW_NESTING", PyInt_FromLong(TDB_ALLOW_NESTING));
 	PyModule_AddObject(m, "DISALLOW_NESTING", PyInt_FromLong(TDB_DISALLOW_NESTING));
 	PyModule_AddObject(m, "INCOMPATIBLE_HASH", PyInt_FromLong(TDB_INCOMPATIBLE_HASH));
+	PyModule_AddObject(m, "FAST_HASH", PyInt_FromLong(TDB_FAST_HASH));
 
 	PyModule_AddObject(m, "__docformat__", PyString_FromString("restructuredText"));
 
@@ -85,7 +85,7 @@ int main(int argc, char *argv[])
 	orig_data.dptr = discard_const_p(uint8_t, "world");
 
 	/* Enlarge the file (internally multiplies by 2). */
-	ret = tdb_expand(tdb, 1500000000);
+	ret = tdb_expand(tdb, 0, 1500000000);
 #ifdef HAVE_INCOHERENT_MMAP
 	/* This can fail due to mmap failure on 32 bit systems. */
 	if (ret == -1) {
@@ -0,0 +1,152 @@
+#include "../common/tdb_private.h"
+#include "../common/io.c"
+#include "../common/tdb.c"
+#include "../common/lock.c"
+#include "../common/freelist.c"
+#include "../common/traverse.c"
+#include "../common/transaction.c"
+#include "../common/error.c"
+#include "../common/open.c"
+#include "../common/check.c"
+#include "../common/hash.c"
+#include "../common/mutex.c"
+#include "tap-interface.h"
+#include <stdlib.h>
+#include "logging.h"
+
+#define NUM_RECORDS 20000
+#define FETCH_LOOPS 10
+
+static double timeval_elapsed(const struct timeval *tv)
+{
+	struct timeval tv2;
+	gettimeofday(&tv2, NULL);
+	return (tv2.tv_sec - tv->tv_sec) +
+	       (tv2.tv_usec - tv->tv_usec)*1.0e-6;
+}
+
+/* Keys like the ones in gencache and winbindd_cache */
+static TDB_DATA make_key(int i, char *buf, size_t bufsize)
+{
+	TDB_DATA key;
+
+	snprintf(buf, bufsize, "IDMAP/SID2XID/S-1-5-21-1004336348-"
+		 "1177238915-682003330-%d", i);
+	key.dptr = (uint8_t *)buf;
+	key.dsize = strlen(buf);
+	return key;
+}
+
+static bool fill(struct tdb_context *tdb)
+{
+	char keybuf[80];
+	TDB_DATA key;
+	int i;
+
+	for (i = 0; i < NUM_RECORDS; i++) {
+		key = make_key(i, keybuf, sizeof(keybuf));
+		if (tdb_store(tdb, key, key, TDB_INSERT) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static int parse_fn(TDB_DATA key, TDB_DATA data, void *private_data)
+{
+	return data.dsize;
+}
+
+/* Returns the number of fetches per second, 0 on error */
+static double bench_fetch(struct tdb_context *tdb)
+{
+	char keybuf[80];
+	struct timeval start;
+	TDB_DATA key;
+	int i, j;
+
+	gettimeofday(&start, NULL);
+	for (j = 0; j < FETCH_LOOPS; j++) {
+		for (i = 0; i < NUM_RECORDS; i++) {
+			key = make_key(i, keybuf, sizeof(keybuf));
+			if (tdb_parse_record(tdb, key, parse_fn, NULL) !=
+			    key.dsize) {
+				return 0;
+			}
+		}
+	}
+	return NUM_RECORDS * FETCH_LOOPS / timeval_elapsed(&start);
+}
+
+int main(int argc, char *argv[])
+{
+	struct {
+		const char *name;
+		int tdb_flags;
+		tdb_hash_func fn;
+	} hashes[] = {
+		{ "old", 0, tdb_old_hash },
+		{ "jenkins", TDB_INCOMPATIBLE_HASH, tdb_jenkins_hash },
+		{ "crc32c", TDB_FAST_HASH, tdb_crc32c_hash },
+	};
+	struct tdb_context *tdb;
+	struct tdb_header hdr;
+	uint8_t buf[256];
+	bool same;
+	int fd;
+	size_t i;
+
+	plan_tests(7 + 4 * ARRAY_SIZE(hashes));
+
+	/* The standard check value of CRC32C */
+	ok1(~crc32c_sw(~0U, (const uint8_t *)"123456789", 9) == 0xe3069283);
+
+	/* The cpu and the table give the same result at all lengths */
+	for (i = 0; i < sizeof(buf); i++) {
+		buf[i] = i * 7;
+	}
+	same = true;
+	for (i = 0; i <= sizeof(buf); i++) {
+		if (crc32c_impl()(~0U, buf, i) != crc32c_sw(~0U, buf, i)) {
+			same = false;
+		}
+	}
+	ok1(same);
+
+	/* Old versions refuse a tdb created with TDB_FAST_HASH */
+	tdb = tdb_open_ex("run-fast-hash.tdb", 0, TDB_FAST_HASH,
+			  O_CREAT|O_TRUNC|O_RDWR, 0600, &taplogctx, NULL);
+	ok1(tdb && tdb->hash_fn == tdb_crc32c_hash);
+	tdb_close(tdb);
+	fd = open("run-fast-hash.tdb", O_RDONLY);
+	ok1(fd != -1 && read(fd, &hdr, sizeof(hdr)) == sizeof(hdr));
+	close(fd);
+	ok1(hdr.rwlocks == TDB_HASH_RWLOCK_MAGIC);
+
+	/* The hash is found without the flag, but not with another one */
+	tdb = tdb_open_ex("run-fast-hash.tdb", 0, 0, O_RDWR, 0600,
+			  &taplogctx, NULL);
+	ok1(tdb && tdb->hash_fn == tdb_crc32c_hash);
+	tdb_close(tdb);
+	tdb = tdb_open_ex("run-fast-hash.tdb", 0, 0, O_RDWR, 0600,
+			  &taplogctx, tdb_jenkins_hash);
+	ok1(tdb == NULL);
+
+	for (i = 0; i < ARRAY_SIZE(hashes); i++) {
+		double rate;
+
+		tdb = tdb_open_ex("run-fast-hash.tdb", 10007,
+				  TDB_CLEAR_IF_FIRST|hashes[i].tdb_flags,
+				  O_CREAT|O_TRUNC|O_RDWR, 0600, &taplogctx,
+				  NULL);
+		ok1(tdb && tdb->hash_fn == hashes[i].fn);
+		ok1(fill(tdb));
+		rate = bench_fetch(tdb);
+		ok1(rate > 0);
+		ok1(tdb_check(tdb, NULL, NULL) == 0);
+		diag("%s hash: %.0f fetches/sec", hashes[i].name, rate);
+		tdb_close(tdb);
+	}
+
+	return exit_status();
+}
@@ -0,0 +1,107 @@
+#include "../common/tdb_private.h"
+#include "../common/io.c"
+#include "../common/tdb.c"
+#include "../common/lock.c"
+#include "../common/freelist.c"
+#include "../common/freelistcheck.c"
+#include "../common/traverse.c"
+#include "../common/transaction.c"
+#include "../common/error.c"
+#include "../common/open.c"
+#include "../common/check.c"
+#include "../common/hash.c"
+#include "../common/mutex.c"
+#include "tap-interface.h"
+#include <stdlib.h>
+#include "logging.h"
+
+#define NUM_RECORDS 1000
+
+static bool store_records(struct tdb_context *tdb, int start, int step)
+{
+	char keybuf[16];
+	char databuf[1024];
+	TDB_DATA key, data;
+	int i;
+
+	memset(databuf, 'x', sizeof(databuf));
+
+	for (i = start; i < NUM_RECORDS; i += step) {
+		snprintf(keybuf, sizeof(keybuf), "key%d", i);
+		key.dptr = (uint8_t *)keybuf;
+		key.dsize = strlen(keybuf);
+		data.dptr = (uint8_t *)databuf;
+		data.dsize = 1 + (i * 37) % sizeof(databuf);
+		if (tdb_store(tdb, key, data, TDB_REPLACE) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool delete_records(struct tdb_context *tdb, int start, int step)
+{
+	char keybuf[16];
+	TDB_DATA key;
+	int i;
+
+	for (i = start; i < NUM_RECORDS; i += step) {
+		snprintf(keybuf, sizeof(keybuf), "key%d", i);
+		key.dptr = (uint8_t *)keybuf;
+		key.dsize = strlen(keybuf);
+		if (tdb_delete(tdb, key) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	struct tdb_context *tdb;
+	int num_entries;
+
+	plan_tests(21);
+
+	/* Without the flag we get the old format. */
+	tdb = tdb_open_ex("run-multi-freelist.tdb", 128,
+			  TDB_CLEAR_IF_FIRST,
+			  O_CREAT|O_TRUNC|O_RDWR, 0600, &taplogctx, NULL);
+	ok1(tdb);
+	ok1(tdb->num_freelists == 1);
+	ok1(!(tdb->feature_flags & TDB_FEATURE_FLAG_FREELISTS));
+	tdb_close(tdb);
+
+	tdb = tdb_open_ex("run-multi-freelist.tdb", 128,
+			  TDB_CLEAR_IF_FIRST|TDB_MULTI_FREELIST,
+			  O_CREAT|O_TRUNC|O_RDWR, 0600, &taplogctx, NULL);
+	ok1(tdb);
+	ok1(tdb->num_freelists == TDB_MAX_FREELISTS);
+	ok1(tdb->feature_flags & TDB_FEATURE_FLAG_FREELISTS);
+
+	/* Fill, punch holes, refill: free space is on many lists. */
+	ok1(store_records(tdb, 0, 1));
+	ok1(delete_records(tdb, 0, 2));
+	ok1(tdb_check(tdb, NULL, NULL) == 0);
+	ok1(tdb_validate_freelist(tdb, &num_entries) == 0);
+	ok1(tdb_freelist_size(tdb) >= 0);
+	ok1(store_records(tdb, 0, 3));
+	ok1(tdb_check(tdb, NULL, NULL) == 0);
+
+	ok1(tdb_wipe_all(tdb) == 0);
+	ok1(tdb_check(tdb, NULL, NULL) == 0);
+	ok1(store_records(tdb, 0, 1));
+	tdb_close(tdb);
+
+	/* The format sticks, the flag is not needed to reopen. */
+	tdb = tdb_open_ex("run-multi-freelist.tdb", 0, 0, O_RDWR, 0,
+			  &taplogctx, NULL);
+	ok1(tdb);
+	ok1(tdb->num_freelists == TDB_MAX_FREELISTS);
+	ok1(tdb_check(tdb, NULL, NULL) == 0);
+	ok1(delete_records(tdb, 1, 2));
+	ok1(tdb_check(tdb, NULL, NULL) == 0);
+	tdb_close(tdb);
+
+	return exit_status();
+}
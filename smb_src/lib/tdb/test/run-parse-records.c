@@ -0,0 +1,141 @@
+#include "../common/tdb_private.h"
+#include "../common/io.c"
+#include "../common/tdb.c"
+#include "../common/lock.c"
+#include "../common/freelist.c"
+#include "../common/traverse.c"
+#include "../common/transaction.c"
+#include "../common/error.c"
+#include "../common/open.c"
+#include "../common/check.c"
+#include "../common/hash.c"
+#include "../common/mutex.c"
+#include "tap-interface.h"
+#include <stdlib.h>
+#include "logging.h"
+
+#define NUM_KEYS 100
+
+struct parse_state {
+	const TDB_DATA *keys;
+	unsigned seen[NUM_KEYS + 1];
+	unsigned num_parsed;
+	unsigned stop_after;
+	bool mismatch;
+};
+
+static int parse_fn(size_t idx, TDB_DATA key, TDB_DATA data,
+		    void *private_data)
+{
+	struct parse_state *state = (struct parse_state *)private_data;
+	char expect[16];
+
+	if ((key.dsize != state->keys[idx].dsize) ||
+	    (memcmp(key.dptr, state->keys[idx].dptr, key.dsize) != 0)) {
+		state->mismatch = true;
+	}
+	snprintf(expect, sizeof(expect), "data%.*s",
+		 (int)key.dsize - 3, (const char *)key.dptr + 3);
+	if ((data.dsize != strlen(expect)) ||
+	    (memcmp(data.dptr, expect, data.dsize) != 0)) {
+		state->mismatch = true;
+	}
+
+	state->seen[idx] += 1;
+	state->num_parsed += 1;
+
+	if (state->num_parsed == state->stop_after) {
+		return 42;
+	}
+	return 0;
+}
+
+static bool check_seen(const struct parse_state *state, size_t num_keys)
+{
+	size_t i;
+
+	for (i = 0; i < num_keys; i++) {
+		unsigned expect = ((i % NUM_KEYS) % 2 == 0) ? 1 : 0;
+
+		if (state->seen[i] != expect) {
+			diag("key %zu seen %u times", i, state->seen[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	struct tdb_context *tdb;
+	struct parse_state state;
+	TDB_DATA keys[NUM_KEYS + 1];
+	char keybufs[NUM_KEYS][16];
+	char databuf[16];
+	unsigned num_lockrecs;
+	int i, ret;
+
+	plan_tests(16);
+
+	/* A tiny hash size to get several keys per chain */
+	tdb = tdb_open_ex("run-parse-records.tdb", 7, TDB_CLEAR_IF_FIRST,
+			  O_CREAT|O_TRUNC|O_RDWR, 0600, &taplogctx, NULL);
+	ok1(tdb);
+
+	for (i = 0; i < NUM_KEYS; i++) {
+		snprintf(keybufs[i], sizeof(keybufs[i]), "key%d", i);
+		keys[i].dptr = (uint8_t *)keybufs[i];
+		keys[i].dsize = strlen(keybufs[i]);
+		if (i % 2 == 0) {
+			TDB_DATA data;
+
+			snprintf(databuf, sizeof(databuf), "data%d", i);
+			data.dptr = (uint8_t *)databuf;
+			data.dsize = strlen(databuf);
+			tdb_store(tdb, keys[i], data, TDB_INSERT);
+		}
+	}
+	/* A duplicate key is looked up twice */
+	keys[NUM_KEYS] = keys[0];
+
+	/* TDB_CLEAR_IF_FIRST keeps the open lock */
+	num_lockrecs = tdb->num_lockrecs;
+
+	memset(&state, 0, sizeof(state));
+	state.keys = keys;
+	ok1(tdb_parse_records(tdb, keys, 0, parse_fn, &state) == 0);
+	ok1(state.num_parsed == 0);
+
+	ret = tdb_parse_records(tdb, keys, NUM_KEYS, parse_fn, &state);
+	ok1(ret == 0);
+	ok1(!state.mismatch);
+	ok1(state.num_parsed == NUM_KEYS / 2);
+	ok1(check_seen(&state, NUM_KEYS));
+	ok1(tdb->num_lockrecs == num_lockrecs);
+
+	memset(&state, 0, sizeof(state));
+	state.keys = keys;
+	ret = tdb_parse_records(tdb, keys, NUM_KEYS + 1, parse_fn, &state);
+	ok1(ret == 0);
+	ok1(state.seen[0] == 1 && state.seen[NUM_KEYS] == 1);
+
+	/* A non-zero parser return stops the walk */
+	memset(&state, 0, sizeof(state));
+	state.keys = keys;
+	state.stop_after = 3;
+	ret = tdb_parse_records(tdb, keys, NUM_KEYS, parse_fn, &state);
+	ok1(ret == 42);
+	ok1(state.num_parsed == 3);
+	ok1(tdb->num_lockrecs == num_lockrecs);
+
+	/* Inside a transaction the records come from the transaction */
+	ok1(tdb_transaction_start(tdb) == 0);
+	memset(&state, 0, sizeof(state));
+	state.keys = keys;
+	ret = tdb_parse_records(tdb, keys, NUM_KEYS, parse_fn, &state);
+	ok1(ret == 0 && !state.mismatch && check_seen(&state, NUM_KEYS));
+	ok1(tdb_transaction_cancel(tdb) == 0);
+
+	tdb_close(tdb);
+	return exit_status();
+}
@@ -0,0 +1,151 @@
+#include "../common/tdb_private.h"
+#include "../common/io.c"
+#include "../common/tdb.c"
+#include "../common/lock.c"
+#include "../common/freelist.c"
+#include "../common/traverse.c"
+#include "../common/transaction.c"
+#include "../common/error.c"
+#include "../common/open.c"
+#include "../common/check.c"
+#include "../common/hash.c"
+#include "../common/mutex.c"
+#include "tap-interface.h"
+#include <stdlib.h>
+#include "logging.h"
+
+#define NUM_RECORDS 1000
+
+static TDB_DATA make_data(int i, char *databuf, size_t bufsize)
+{
+	TDB_DATA data;
+
+	memset(databuf, 'a' + (i % 26), bufsize);
+	data.dptr = (uint8_t *)databuf;
+	data.dsize = 1 + (i * 37) % bufsize;
+	return data;
+}
+
+static bool store_records(struct tdb_context *tdb, int start, int step,
+			  int shrink)
+{
+	char keybuf[16];
+	char databuf[1024];
+	TDB_DATA key, data;
+	int i;
+
+	for (i = start; i < NUM_RECORDS; i += step) {
+		snprintf(keybuf, sizeof(keybuf), "key%d", i);
+		key.dptr = (uint8_t *)keybuf;
+		key.dsize = strlen(keybuf);
+		data = make_data(i, databuf, sizeof(databuf));
+		data.dsize /= shrink;
+		if (tdb_store(tdb, key, data, TDB_REPLACE) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool delete_records(struct tdb_context *tdb, int start, int step)
+{
+	char keybuf[16];
+	TDB_DATA key;
+	int i;
+
+	for (i = start; i < NUM_RECORDS; i += step) {
+		snprintf(keybuf, sizeof(keybuf), "key%d", i);
+		key.dptr = (uint8_t *)keybuf;
+		key.dsize = strlen(keybuf);
+		if (tdb_delete(tdb, key) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool check_records(struct tdb_context *tdb, int start, int step,
+			  int shrink)
+{
+	char keybuf[16];
+	char databuf[1024];
+	TDB_DATA key, data, expect;
+	int i;
+
+	for (i = start; i < NUM_RECORDS; i += step) {
+		bool match;
+
+		snprintf(keybuf, sizeof(keybuf), "key%d", i);
+		key.dptr = (uint8_t *)keybuf;
+		key.dsize = strlen(keybuf);
+		expect = make_data(i, databuf, sizeof(databuf));
+		expect.dsize /= shrink;
+		data = tdb_fetch(tdb, key);
+		match = ((data.dsize == expect.dsize) &&
+			 (memcmp(data.dptr, expect.dptr, data.dsize) == 0));
+		free(data.dptr);
+		if (!match) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static int repack_all(struct tdb_context *tdb, uint32_t step,
+		      struct tdb_repack_stats *stats)
+{
+	int next = 0;
+
+	do {
+		next = tdb_repack_chains(tdb, next, step, stats);
+	} while (next > 0);
+
+	return next;
+}
+
+int main(int argc, char *argv[])
+{
+	struct tdb_context *tdb;
+	struct tdb_repack_stats stats;
+	int flags[] = { TDB_DEFAULT, TDB_MULTI_FREELIST };
+	int i;
+
+	plan_tests(2 * 14 + 2);
+
+	for (i = 0; i < 2; i++) {
+		tdb = tdb_open_ex("run-repack-chains.tdb", 128,
+				  TDB_CLEAR_IF_FIRST|flags[i],
+				  O_CREAT|O_TRUNC|O_RDWR, 0600, &taplogctx,
+				  NULL);
+		ok1(tdb);
+
+		/* Punch holes and leave slack behind in the records */
+		ok1(store_records(tdb, 0, 1, 1));
+		ok1(delete_records(tdb, 0, 3));
+		ok1(store_records(tdb, 1, 3, 4));
+		ok1(tdb_check(tdb, NULL, NULL) == 0);
+
+		memset(&stats, 0, sizeof(stats));
+		ok1(tdb_repack_chains(tdb, 0, 10, &stats) == 10);
+		ok1(stats.chains == 10);
+		ok1(repack_all(tdb, 10, &stats) == 0);
+		ok1(stats.chains == 10 + 128);
+		ok1(stats.moved > 0);
+		ok1(stats.trimmed > 0);
+		ok1(stats.bytes_reclaimed > 0);
+		ok1(tdb_check(tdb, NULL, NULL) == 0);
+		ok1(check_records(tdb, 1, 3, 4) &&
+		    check_records(tdb, 2, 3, 1));
+		tdb_close(tdb);
+	}
+
+	/* Out of range start chain */
+	tdb = tdb_open_ex("run-repack-chains.tdb", 128, TDB_CLEAR_IF_FIRST,
+			  O_CREAT|O_TRUNC|O_RDWR, 0600, &taplogctx, NULL);
+	ok1(tdb_repack_chains(tdb, 128, 1, NULL) == -1 &&
+	    tdb_error(tdb) == TDB_ERR_EINVAL);
+	ok1(tdb_repack_chains(tdb, 0, 128, NULL) == 0);
+	tdb_close(tdb);
+
+	return exit_status();
+}
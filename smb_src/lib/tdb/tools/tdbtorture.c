@@ -23,8 +23,10 @@
 #define TRAVERSE_PROB 20
 #define TRAVERSE_READ_PROB 20
 #define CULL_PROB 100
+#define REPACK_PROB 50
 #define KEYLEN 3
 #define DATALEN 100
+#define ALLOC_DATALEN 1000
 
 static struct tdb_context *db;
 static int in_transaction;
@@ -34,6 +36,8 @@ static int hash_size = 2;
 static int loopnum;
 static int count_pipe;
 static bool mutex = false;
+static bool multi_freelist = false;
+static bool alloc_only = false;
 static struct tdb_logging_context log_ctx;
 
 #ifdef PRINTF_ATTRIBUTE
@@ -186,6 +190,13 @@ static void addrec_db(void)
 	} 
 #endif
 
+#if REPACK_PROB
+	if (in_transaction == 0 && random() % REPACK_PROB == 0) {
+		tdb_repack_chains(db, random() % hash_size, 4, NULL);
+		goto next;
+	}
+#endif
+
 #if TRAVERSE_PROB
 	if (random() % TRAVERSE_PROB == 0) {
 		tdb_traverse(db, cull_traverse, NULL);
@@ -208,6 +219,38 @@ next:
 	free(d);
 }
 
+/*
+ * Only stores and deletes of varying size: this measures how well
+ * concurrent allocations scale.
+ */
+static void allocrec_db(void)
+{
+	int klen, dlen;
+	char *k, *d;
+	TDB_DATA key, data;
+
+	klen = 1 + (rand() % KEYLEN);
+	dlen = 1 + (rand() % ALLOC_DATALEN);
+
+	k = randbuf(klen);
+	d = randbuf(dlen);
+
+	key.dptr = (unsigned char *)k;
+	key.dsize = klen+1;
+
+	data.dptr = (unsigned char *)d;
+	data.dsize = dlen+1;
+
+	if (random() % 2 == 0) {
+		tdb_delete(db, key);
+	} else if (tdb_store(db, key, data, TDB_REPLACE) != 0) {
+		fatal("tdb_store failed");
+	}
+
+	free(k);
+	free(d);
+}
+
 static int traverse_fn(struct tdb_context *tdb, TDB_DATA key, TDB_DATA dbuf,
                        void *state)
 {
@@ -217,7 +260,9 @@ static int traverse_fn(struct tdb_context *tdb, TDB_DATA key, TDB_DATA dbuf,
 
 static void usage(void)
 {
-	printf("Usage: tdbtorture [-t] [-k] [-m] [-n NUM_PROCS] [-l NUM_LOOPS] [-s SEED] [-H HASH_SIZE]\n");
+	printf("Usage: tdbtorture [-t] [-k] [-m] [-f] [-a] [-n NUM_PROCS] [-l NUM_LOOPS] [-s SEED] [-H HASH_SIZE]\n");
+	printf("  -f  use TDB_MULTI_FREELIST\n");
+	printf("  -a  only store and delete records, report the ops/sec\n");
 	exit(0);
 }
 
@@ -236,6 +281,9 @@ static int run_child(const char *filename, int i, int seed, unsigned num_loops,
 	if (mutex) {
 		tdb_flags |= TDB_MUTEX_LOCKING;
 	}
+	if (multi_freelist) {
+		tdb_flags |= TDB_MULTI_FREELIST;
+	}
 
 	db = tdb_open_ex(filename, hash_size, tdb_flags,
 			 O_RDWR | O_CREAT, 0600, &log_ctx, NULL);
@@ -251,7 +299,11 @@ static int run_child(const char *filename, int i, int seed, unsigned num_loops,
 	signal(SIGUSR1, send_count_and_suicide);
 
 	for (;loopnum<num_loops && error_count == 0;loopnum++) {
-		addrec_db();
+		if (alloc_only) {
+			allocrec_db();
+		} else {
+			addrec_db();
+		}
 	}
 
 	if (error_count == 0) {
@@ -306,10 +358,13 @@ int main(int argc, char * const *argv)
 	int kill_random = 0;
 	int *done;
 	char *test_tdb;
+	struct timeval start, end;
+	double secs;
+	int total_ops;
 
 	log_ctx.log_fn = tdb_log;
 
-	while ((c = getopt(argc, argv, "n:l:s:H:thkm")) != -1) {
+	while ((c = getopt(argc, argv, "n:l:s:H:thkmfa")) != -1) {
 		switch (c) {
 		case 'n':
 			num_procs = strtol(optarg, NULL, 0);
@@ -336,6 +391,12 @@ int main(int argc, char * const *argv)
 				exit(1);
 			}
 			break;
+		case 'f':
+			multi_freelist = true;
+			break;
+		case 'a':
+			alloc_only = true;
+			break;
 		default:
 			usage();
 		}
@@ -349,9 +410,13 @@ int main(int argc, char * const *argv)
 		seed = (getpid() + time(NULL)) & 0x7FFFFFFF;
 	}
 
-	printf("Testing with %d processes, %d loops, %d hash_size, seed=%d%s\n",
+	printf("Testing with %d processes, %d loops, %d hash_size, seed=%d%s%s\n",
 	       num_procs, num_loops, hash_size, seed,
-	       (always_transaction ? " (all within transactions)" : ""));
+	       (always_transaction ? " (all within transactions)" : ""),
+	       (multi_freelist ? " (multiple freelists)" : ""));
+
+	total_ops = num_procs * num_loops;
+	gettimeofday(&start, NULL);
 
 	if (num_procs == 1 && !kill_random) {
 		/* Don't fork for this case, makes debugging easier. */
@@ -456,6 +521,15 @@ int main(int argc, char * const *argv)
 	free(pids);
 
 done:
+	gettimeofday(&end, NULL);
+	secs = (end.tv_sec - start.tv_sec) +
+		(end.tv_usec - start.tv_usec) / 1000000.0;
+
+	if (alloc_only && error_count == 0 && secs > 0) {
+		printf("%d ops in %.3f seconds: %.0f ops/sec\n",
+		       total_ops, secs, total_ops / secs);
+	}
+
 	if (error_count == 0) {
 		int tdb_flags = TDB_DEFAULT;
 
@@ -53,6 +53,7 @@ static bool memcache_is_talloc(enum memcache_number n)
 	case GETPWNAM_CACHE:
 	case PDB_GETPWSID_CACHE:
 	case SINGLETON_CACHE_TALLOC:
+	case SHARE_MODE_LOCK_CACHE:
 		result = true;
 		break;
 	default:
@@ -29,13 +29,21 @@
 #define SMB2_TF_MSG_SIZE	0x24 /*  4 bytes */
 #define SMB2_TF_RESERVED	0x28 /*  2 bytes */
 #define SMB2_TF_ALGORITHM	0x2A /*  2 bytes */
+#define SMB2_TF_FLAGS		0x2A /*  2 bytes, SMB >= 3.1.1 */
 #define SMB2_TF_SESSION_ID	0x2C /*  8 bytes */
 
 #define SMB2_TF_HDR_SIZE	0x34 /* 52 bytes */
 
 #define SMB2_TF_MAGIC 0x424D53FD /* 0xFD 'S' 'M' 'B' */
 
+#define SMB2_TF_FLAGS_ENCRYPTED	0x0001
+
+/*
+ * The cipher ids used for the SMB2 transform header,
+ * SMB 3.0 and 3.02 always use AES128_CCM.
+ */
 #define SMB2_ENCRYPTION_AES128_CCM	0x0001
+#define SMB2_ENCRYPTION_AES128_GCM	0x0002
 
 /* offsets into header elements for a sync SMB2 request */
 #define SMB2_HDR_PROTOCOL_ID    0x00
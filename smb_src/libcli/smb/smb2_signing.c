@@ -23,15 +23,129 @@
 #include "../libcli/smb/smb_common.h"
 #include "../lib/crypto/crypto.h"
 
+/*
+ * The expanded key schedule of a signing key,
+ * so that it's not recomputed for every pdu.
+ */
+struct smb2_signing_state {
+	bool valid;
+	bool aes_cmac;
+	uint8_t key[16];
+	struct aes_cmac_128_key cmac;
+	struct hmac_sha256_key hmac;
+};
+
+static int smb2_signing_state_destructor(struct smb2_signing_state *state)
+{
+	ZERO_STRUCTP(state);
+	return 0;
+}
+
+struct smb2_signing_state *smb2_signing_state_create(TALLOC_CTX *mem_ctx)
+{
+	struct smb2_signing_state *state;
+
+	state = talloc_zero(mem_ctx, struct smb2_signing_state);
+	if (state == NULL) {
+		return NULL;
+	}
+	talloc_set_destructor(state, smb2_signing_state_destructor);
+
+	return state;
+}
+
+static void smb2_signing_state_prepare(struct smb2_signing_state *state,
+				       DATA_BLOB signing_key,
+				       enum protocol_types protocol)
+{
+	uint8_t key[16];
+	bool aes_cmac = (protocol >= PROTOCOL_SMB2_24);
+
+	/*
+	 * Only the first 16 bytes of the key are used,
+	 * shorter keys are padded with zeros, which
+	 * gives the same result for HMAC-SHA256.
+	 */
+	ZERO_STRUCT(key);
+	memcpy(key, signing_key.data, MIN(signing_key.length, 16));
+
+	if (state->valid &&
+	    state->aes_cmac == aes_cmac &&
+	    memcmp(state->key, key, sizeof(key)) == 0)
+	{
+		ZERO_STRUCT(key);
+		return;
+	}
+
+	ZERO_STRUCTP(state);
+
+	if (aes_cmac) {
+		aes_cmac_128_key_setup(&state->cmac, key);
+	} else {
+		hmac_sha256_key_setup(key, sizeof(key), &state->hmac);
+	}
+
+	memcpy(state->key, key, sizeof(key));
+	state->aes_cmac = aes_cmac;
+	state->valid = true;
+
+	ZERO_STRUCT(key);
+}
+
+/*
+ * The signature field of the header is always
+ * taken as zero.
+ */
+static void smb2_signing_calc(const struct smb2_signing_state *state,
+			      const struct iovec *vector,
+			      int count,
+			      uint8_t res[16])
+{
+	const uint8_t *hdr = (const uint8_t *)vector[0].iov_base;
+	static const uint8_t zero_sig[16] = { 0, };
+	int i;
+
+	if (state->aes_cmac) {
+		struct aes_cmac_128_context ctx;
+
+		aes_cmac_128_init_key(&ctx, &state->cmac);
+		aes_cmac_128_update(&ctx, hdr, SMB2_HDR_SIGNATURE);
+		aes_cmac_128_update(&ctx, zero_sig, 16);
+		for (i=1; i < count; i++) {
+			aes_cmac_128_update(&ctx,
+					(const uint8_t *)vector[i].iov_base,
+					vector[i].iov_len);
+		}
+		aes_cmac_128_final(&ctx, res);
+	} else {
+		struct HMACSHA256Context m;
+		uint8_t digest[SHA256_DIGEST_LENGTH];
+
+		ZERO_STRUCT(m);
+		hmac_sha256_init_key(&state->hmac, &m);
+		hmac_sha256_update(hdr, SMB2_HDR_SIGNATURE, &m);
+		hmac_sha256_update(zero_sig, 16, &m);
+		for (i=1; i < count; i++) {
+			hmac_sha256_update((const uint8_t *)vector[i].iov_base,
+					   vector[i].iov_len, &m);
+		}
+		hmac_sha256_final(digest, &m);
+		memcpy(res, digest, 16);
+		ZERO_STRUCT(m);
+		ZERO_STRUCT(digest);
+	}
+}
+
 NTSTATUS smb2_signing_sign_pdu(DATA_BLOB signing_key,
+			       struct smb2_signing_state *state,
 			       enum protocol_types protocol,
 			       struct iovec *vector,
 			       int count)
 {
+	struct smb2_signing_state tmp_state;
 	uint8_t *hdr;
 	uint64_t session_id;
 	uint8_t res[16];
-	int i;
 
 	if (count < 2) {
 		return NT_STATUS_INVALID_PARAMETER;
@@ -62,33 +176,18 @@ NTSTATUS smb2_signing_sign_pdu(DATA_BLOB signing_key,
 
 	SIVAL(hdr, SMB2_HDR_FLAGS, IVAL(hdr, SMB2_HDR_FLAGS) | SMB2_HDR_FLAG_SIGNED);
 
-	if (protocol >= PROTOCOL_SMB2_24) {
-		struct aes_cmac_128_context ctx;
-		uint8_t key[AES_BLOCK_SIZE];
-
-		ZERO_STRUCT(key);
-		memcpy(key, signing_key.data, MIN(signing_key.length, 16));
+	if (state == NULL) {
+		ZERO_STRUCT(tmp_state);
+		state = &tmp_state;
+	}
 
-		aes_cmac_128_init(&ctx, key);
-		for (i=0; i < count; i++) {
-			aes_cmac_128_update(&ctx,
-					(const uint8_t *)vector[i].iov_base,
-					vector[i].iov_len);
-		}
-		aes_cmac_128_final(&ctx, res);
-	} else {
-		struct HMACSHA256Context m;
-		uint8_t digest[SHA256_DIGEST_LENGTH];
+	smb2_signing_state_prepare(state, signing_key, protocol);
+	smb2_signing_calc(state, vector, count, res);
 
-		ZERO_STRUCT(m);
-		hmac_sha256_init(signing_key.data, MIN(signing_key.length, 16), &m);
-		for (i=0; i < count; i++) {
-			hmac_sha256_update((const uint8_t *)vector[i].iov_base,
-					   vector[i].iov_len, &m);
-		}
-		hmac_sha256_final(digest, &m);
-		memcpy(res, digest, 16);
+	if (state == &tmp_state) {
+		ZERO_STRUCT(tmp_state);
 	}
+
 	DEBUG(5,("signed SMB2 message\n"));
 
 	memcpy(hdr + SMB2_HDR_SIGNATURE, res, 16);
@@ -97,16 +196,16 @@ NTSTATUS smb2_signing_sign_pdu(DATA_BLOB signing_key,
 }
 
 NTSTATUS smb2_signing_check_pdu(DATA_BLOB signing_key,
+				struct smb2_signing_state *state,
 				enum protocol_types protocol,
 				const struct iovec *vector,
 				int count)
 {
+	struct smb2_signing_state tmp_state;
 	const uint8_t *hdr;
 	const uint8_t *sig;
 	uint64_t session_id;
 	uint8_t res[16];
-	static const uint8_t zero_sig[16] = { 0, };
-	int i;
 
 	if (count < 2) {
 		return NT_STATUS_INVALID_PARAMETER;
@@ -134,36 +233,16 @@ NTSTATUS smb2_signing_check_pdu(DATA_BLOB signing_key,
 
 	sig = hdr+SMB2_HDR_SIGNATURE;
 
-	if (protocol >= PROTOCOL_SMB2_24) {
-		struct aes_cmac_128_context ctx;
-		uint8_t key[AES_BLOCK_SIZE];
+	if (state == NULL) {
+		ZERO_STRUCT(tmp_state);
+		state = &tmp_state;
+	}
 
-		ZERO_STRUCT(key);
-		memcpy(key, signing_key.data, MIN(signing_key.length, 16));
+	smb2_signing_state_prepare(state, signing_key, protocol);
+	smb2_signing_calc(state, vector, count, res);
 
-		aes_cmac_128_init(&ctx, key);
-		aes_cmac_128_update(&ctx, hdr, SMB2_HDR_SIGNATURE);
-		aes_cmac_128_update(&ctx, zero_sig, 16);
-		for (i=1; i < count; i++) {
-			aes_cmac_128_update(&ctx,
-					(const uint8_t *)vector[i].iov_base,
-					vector[i].iov_len);
-		}
-		aes_cmac_128_final(&ctx, res);
-	} else {
-		struct HMACSHA256Context m;
-		uint8_t digest[SHA256_DIGEST_LENGTH];
-
-		ZERO_STRUCT(m);
-		hmac_sha256_init(signing_key.data, MIN(signing_key.length, 16), &m);
-		hmac_sha256_update(hdr, SMB2_HDR_SIGNATURE, &m);
-		hmac_sha256_update(zero_sig, 16, &m);
-		for (i=1; i < count; i++) {
-			hmac_sha256_update((const uint8_t *)vector[i].iov_base,
-					   vector[i].iov_len, &m);
-		}
-		hmac_sha256_final(digest, &m);
-		memcpy(res, digest, 16);
+	if (state == &tmp_state) {
+		ZERO_STRUCT(tmp_state);
 	}
 
 	if (memcmp(res, sig, 16) != 0) {
@@ -209,17 +288,15 @@ void smb2_key_derivation(const uint8_t *KI, size_t KI_len,
 }
 
 NTSTATUS smb2_signing_encrypt_pdu(DATA_BLOB encryption_key,
-				  enum protocol_types protocol,
+				  uint16_t cipher_id,
 				  struct iovec *vector,
 				  int count)
 {
 	uint8_t *tf;
-	uint16_t alg;
 	uint8_t sig[16];
 	int i;
 	size_t a_total;
 	size_t m_total = 0;
-	struct aes_ccm_128_context ctx;
 	uint8_t key[AES_BLOCK_SIZE];
 
 	if (count < 1) {
@@ -243,28 +320,57 @@ NTSTATUS smb2_signing_encrypt_pdu(DATA_BLOB encryption_key,
 		m_total += vector[i].iov_len;
 	}
 
-	alg = SMB2_ENCRYPTION_AES128_CCM;
-	SSVAL(tf, SMB2_TF_ALGORITHM, alg);
+	SSVAL(tf, SMB2_TF_FLAGS, SMB2_TF_FLAGS_ENCRYPTED);
 	SIVAL(tf, SMB2_TF_MSG_SIZE, m_total);
 
 	ZERO_STRUCT(key);
 	memcpy(key, encryption_key.data,
 	       MIN(encryption_key.length, AES_BLOCK_SIZE));
-	aes_ccm_128_init(&ctx, key,
-			 tf + SMB2_TF_NONCE,
-			 a_total, m_total);
-	aes_ccm_128_update(&ctx, tf + SMB2_TF_NONCE, a_total);
-	for (i=1; i < count; i++) {
-		aes_ccm_128_update(&ctx,
-				(const uint8_t *)vector[i].iov_base,
-				vector[i].iov_len);
+
+	switch (cipher_id) {
+	case SMB2_ENCRYPTION_AES128_CCM: {
+		struct aes_ccm_128_context ctx;
+
+		aes_ccm_128_init(&ctx, key,
+				 tf + SMB2_TF_NONCE,
+				 a_total, m_total);
+		aes_ccm_128_update(&ctx, tf + SMB2_TF_NONCE, a_total);
+		for (i=1; i < count; i++) {
+			aes_ccm_128_update(&ctx,
+					(const uint8_t *)vector[i].iov_base,
+					vector[i].iov_len);
+		}
+		for (i=1; i < count; i++) {
+			aes_ccm_128_crypt(&ctx,
+					(uint8_t *)vector[i].iov_base,
+					vector[i].iov_len);
+		}
+		aes_ccm_128_digest(&ctx, sig);
+		break;
 	}
-	for (i=1; i < count; i++) {
-		aes_ccm_128_crypt(&ctx,
-				(uint8_t *)vector[i].iov_base,
-				vector[i].iov_len);
+	case SMB2_ENCRYPTION_AES128_GCM: {
+		struct aes_gcm_128_context ctx;
+
+		aes_gcm_128_init(&ctx, key, tf + SMB2_TF_NONCE);
+		aes_gcm_128_updateA(&ctx, tf + SMB2_TF_NONCE, a_total);
+		for (i=1; i < count; i++) {
+			aes_gcm_128_crypt(&ctx,
+					(uint8_t *)vector[i].iov_base,
+					vector[i].iov_len);
+			aes_gcm_128_updateC(&ctx,
+					(const uint8_t *)vector[i].iov_base,
+					vector[i].iov_len);
+		}
+		aes_gcm_128_digest(&ctx, sig);
+		break;
 	}
-	aes_ccm_128_digest(&ctx, sig);
+	default:
+		ZERO_STRUCT(key);
+		DEBUG(2,("Unknown SMB2 cipher id 0x%04x\n",
+			 (unsigned)cipher_id));
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+	ZERO_STRUCT(key);
 
 	memcpy(tf + SMB2_TF_SIGNATURE, sig, 16);
 
@@ -274,19 +380,18 @@ NTSTATUS smb2_signing_encrypt_pdu(DATA_BLOB encryption_key,
 }
 
 NTSTATUS smb2_signing_decrypt_pdu(DATA_BLOB decryption_key,
-				  enum protocol_types protocol,
+				  uint16_t cipher_id,
 				  struct iovec *vector,
 				  int count)
 {
 	uint8_t *tf;
-	uint16_t alg;
+	uint16_t flags;
 	uint8_t *sig_ptr = NULL;
 	uint8_t sig[16];
 	int i;
 	size_t a_total;
 	size_t m_total = 0;
 	uint32_t msg_size = 0;
-	struct aes_ccm_128_context ctx;
 	uint8_t key[AES_BLOCK_SIZE];
 
 	if (count < 1) {
@@ -310,10 +415,10 @@ NTSTATUS smb2_signing_decrypt_pdu(DATA_BLOB decryption_key,
 		m_total += vector[i].iov_len;
 	}
 
-	alg = SVAL(tf, SMB2_TF_ALGORITHM);
+	flags = SVAL(tf, SMB2_TF_FLAGS);
 	msg_size = IVAL(tf, SMB2_TF_MSG_SIZE);
 
-	if (alg != SMB2_ENCRYPTION_AES128_CCM) {
+	if (flags != SMB2_TF_FLAGS_ENCRYPTED) {
 		return NT_STATUS_ACCESS_DENIED;
 	}
 
@@ -324,21 +429,51 @@ NTSTATUS smb2_signing_decrypt_pdu(DATA_BLOB decryption_key,
 	ZERO_STRUCT(key);
 	memcpy(key, decryption_key.data,
 	       MIN(decryption_key.length, AES_BLOCK_SIZE));
-	aes_ccm_128_init(&ctx, key,
-			 tf + SMB2_TF_NONCE,
-			 a_total, m_total);
-	for (i=1; i < count; i++) {
-		aes_ccm_128_crypt(&ctx,
-				(uint8_t *)vector[i].iov_base,
-				vector[i].iov_len);
+
+	switch (cipher_id) {
+	case SMB2_ENCRYPTION_AES128_CCM: {
+		struct aes_ccm_128_context ctx;
+
+		aes_ccm_128_init(&ctx, key,
+				 tf + SMB2_TF_NONCE,
+				 a_total, m_total);
+		for (i=1; i < count; i++) {
+			aes_ccm_128_crypt(&ctx,
+					(uint8_t *)vector[i].iov_base,
+					vector[i].iov_len);
+		}
+		aes_ccm_128_update(&ctx, tf + SMB2_TF_NONCE, a_total);
+		for (i=1; i < count; i++) {
+			aes_ccm_128_update(&ctx,
+					( uint8_t *)vector[i].iov_base,
+					vector[i].iov_len);
+		}
+		aes_ccm_128_digest(&ctx, sig);
+		break;
 	}
-	aes_ccm_128_update(&ctx, tf + SMB2_TF_NONCE, a_total);
-	for (i=1; i < count; i++) {
-		aes_ccm_128_update(&ctx,
-				( uint8_t *)vector[i].iov_base,
-				vector[i].iov_len);
+	case SMB2_ENCRYPTION_AES128_GCM: {
+		struct aes_gcm_128_context ctx;
+
+		aes_gcm_128_init(&ctx, key, tf + SMB2_TF_NONCE);
+		aes_gcm_128_updateA(&ctx, tf + SMB2_TF_NONCE, a_total);
+		for (i=1; i < count; i++) {
+			aes_gcm_128_updateC(&ctx,
+					(const uint8_t *)vector[i].iov_base,
+					vector[i].iov_len);
+			aes_gcm_128_crypt(&ctx,
+					(uint8_t *)vector[i].iov_base,
+					vector[i].iov_len);
+		}
+		aes_gcm_128_digest(&ctx, sig);
+		break;
 	}
-	aes_ccm_128_digest(&ctx, sig);
+	default:
+		ZERO_STRUCT(key);
+		DEBUG(2,("Unknown SMB2 cipher id 0x%04x\n",
+			 (unsigned)cipher_id));
+		return NT_STATUS_ACCESS_DENIED;
+	}
+	ZERO_STRUCT(key);
 
 	sig_ptr = tf + SMB2_TF_SIGNATURE;
 	if (memcmp(sig_ptr, sig, 16) != 0) {
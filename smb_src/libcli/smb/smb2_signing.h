@@ -23,12 +23,24 @@
 
 struct iovec;
 
+/*
+ * Caches the expanded key schedule for a signing key,
+ * it's rebuilt if the key or the protocol changes.
+ * All signing functions accept NULL, in that case
+ * the key schedule is computed for each pdu.
+ */
+struct smb2_signing_state;
+
+struct smb2_signing_state *smb2_signing_state_create(TALLOC_CTX *mem_ctx);
+
 NTSTATUS smb2_signing_sign_pdu(DATA_BLOB signing_key,
+			       struct smb2_signing_state *state,
 			       enum protocol_types protocol,
 			       struct iovec *vector,
 			       int count);
 
 NTSTATUS smb2_signing_check_pdu(DATA_BLOB signing_key,
+				struct smb2_signing_state *state,
 				enum protocol_types protocol,
 				const struct iovec *vector,
 				int count);
@@ -39,11 +51,11 @@ void smb2_key_derivation(const uint8_t *KI, size_t KI_len,
 			 uint8_t KO[16]);
 
 NTSTATUS smb2_signing_encrypt_pdu(DATA_BLOB encryption_key,
-				  enum protocol_types protocol,
+				  uint16_t cipher_id,
 				  struct iovec *vector,
 				  int count);
 NTSTATUS smb2_signing_decrypt_pdu(DATA_BLOB decryption_key,
-				  enum protocol_types protocol,
+				  uint16_t cipher_id,
 				  struct iovec *vector,
 				  int count);
 
@@ -121,6 +121,7 @@ struct smbXcli_conn {
 			NTTIME system_time;
 			NTTIME start_time;
 			DATA_BLOB gss_blob;
+			uint16_t cipher;
 		} server;
 
 		uint64_t mid;
@@ -3006,6 +3007,7 @@ skip_credits:
 			NTSTATUS status;
 
 			status = smb2_signing_sign_pdu(*signing_key,
+						       NULL,
 						       state->session->conn->protocol,
 						       &iov[hdr_iov], num_iov - hdr_iov);
 			if (!NT_STATUS_IS_OK(status)) {
@@ -3055,7 +3057,7 @@ skip_credits:
 		}
 
 		status = smb2_signing_encrypt_pdu(*encryption_key,
-					state->conn->protocol,
+					state->conn->smb2.server.cipher,
 					&iov[tf_iov], num_iov - tf_iov);
 		if (!NT_STATUS_IS_OK(status)) {
 			return status;
@@ -3230,7 +3232,7 @@ static NTSTATUS smb2cli_inbuf_parse_compound(struct smbXcli_conn *conn,
 			tf_iov[1].iov_len = enc_len;
 
 			status = smb2_signing_decrypt_pdu(s->smb2->decryption_key,
-							  conn->protocol,
+							  conn->smb2.server.cipher,
 							  tf_iov, 2);
 			if (!NT_STATUS_IS_OK(status)) {
 				TALLOC_FREE(iov);
@@ -3580,6 +3582,7 @@ static NTSTATUS smb2cli_conn_dispatch_incoming(struct smbXcli_conn *conn,
 
 		if (signing_key) {
 			status = smb2_signing_check_pdu(*signing_key,
+							NULL,
 							state->conn->protocol,
 							&cur[1], 3);
 			if (!NT_STATUS_IS_OK(status)) {
@@ -4482,6 +4485,14 @@ static void smbXcli_negprot_smb2_done(struct tevent_req *subreq)
 	conn->smb2.server.system_time	= BVAL(body, 40);
 	conn->smb2.server.start_time	= BVAL(body, 48);
 
+	/*
+	 * SMB 3.0 and 3.02 only support AES-CCM-128,
+	 * other ciphers require an SMB 3.1.1 negotiate context.
+	 */
+	if (conn->smb2.server.capabilities & SMB2_CAP_ENCRYPTION) {
+		conn->smb2.server.cipher = SMB2_ENCRYPTION_AES128_CCM;
+	}
+
 	security_offset = SVAL(body, 56);
 	security_length = SVAL(body, 58);
 
@@ -5205,6 +5216,7 @@ NTSTATUS smb2cli_session_set_session_key(struct smbXcli_session *session,
 
 	if (check_signature) {
 		status = smb2_signing_check_pdu(session->smb2_channel.signing_key,
+						NULL,
 						session->conn->protocol,
 						recv_iov, 3);
 		if (!NT_STATUS_IS_OK(status)) {
@@ -5315,6 +5327,7 @@ NTSTATUS smb2cli_session_set_channel_key(struct smbXcli_session *session,
 	ZERO_STRUCT(channel_key);
 
 	status = smb2_signing_check_pdu(session->smb2_channel.signing_key,
+					NULL,
 					session->conn->protocol,
 					recv_iov, 3);
 	if (!NT_STATUS_IS_OK(status)) {
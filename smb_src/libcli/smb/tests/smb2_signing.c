@@ -0,0 +1,173 @@
+/*
+   Unix SMB/CIFS implementation.
+
+   SMB2 transform header encryption testing
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "includes.h"
+#include "torture/torture.h"
+#include "torture/local/proto.h"
+#include "system/filesys.h"
+#include "../libcli/smb/smb_common.h"
+
+#define SMB2_SIGNING_TEST_PAYLOAD 300
+
+/*
+ * Build a transform header and a payload split over three
+ * iovecs of uneven size, so the ciphers have to carry
+ * partial blocks from one vector to the next.
+ */
+static void smb2_signing_test_pdu(uint8_t tf[SMB2_TF_HDR_SIZE],
+				  uint8_t *payload,
+				  struct iovec vector[4])
+{
+	size_t i;
+
+	memset(tf, 0, SMB2_TF_HDR_SIZE);
+	SIVAL(tf, SMB2_TF_PROTOCOL_ID, SMB2_TF_MAGIC);
+	for (i = 0; i < 16; i++) {
+		tf[SMB2_TF_NONCE + i] = 0xA0 + i;
+	}
+	SBVAL(tf, SMB2_TF_SESSION_ID, 0x0000400000000005ULL);
+
+	for (i = 0; i < SMB2_SIGNING_TEST_PAYLOAD; i++) {
+		payload[i] = (i * 37 + 11) & 0xFF;
+	}
+
+	vector[0].iov_base = tf;
+	vector[0].iov_len = SMB2_TF_HDR_SIZE;
+	vector[1].iov_base = payload;
+	vector[1].iov_len = 7;
+	vector[2].iov_base = payload + 7;
+	vector[2].iov_len = 64;
+	vector[3].iov_base = payload + 71;
+	vector[3].iov_len = SMB2_SIGNING_TEST_PAYLOAD - 71;
+}
+
+static bool smb2_signing_test_roundtrip(struct torture_context *tctx,
+					uint16_t cipher_id,
+					uint16_t other_cipher_id)
+{
+	static const uint8_t key_buf[16] = {
+		0x40, 0x47, 0x4e, 0x55, 0x5c, 0x63, 0x6a, 0x71,
+		0x78, 0x7f, 0x86, 0x8d, 0x94, 0x9b, 0xa2, 0xa9
+	};
+	DATA_BLOB key = data_blob_const(key_buf, sizeof(key_buf));
+	uint8_t tf[SMB2_TF_HDR_SIZE];
+	uint8_t payload[SMB2_SIGNING_TEST_PAYLOAD];
+	uint8_t plain[SMB2_SIGNING_TEST_PAYLOAD];
+	uint8_t sealed_tf[SMB2_TF_HDR_SIZE];
+	uint8_t sealed[SMB2_SIGNING_TEST_PAYLOAD];
+	struct iovec vector[4];
+	NTSTATUS status;
+
+	smb2_signing_test_pdu(tf, payload, vector);
+	memcpy(plain, payload, sizeof(plain));
+
+	status = smb2_signing_encrypt_pdu(key, cipher_id, vector, 4);
+	torture_assert_ntstatus_ok(tctx, status, "encrypt");
+	torture_assert_int_equal(tctx, IVAL(tf, SMB2_TF_MSG_SIZE),
+				 SMB2_SIGNING_TEST_PAYLOAD, "msg size");
+	torture_assert(tctx, memcmp(payload, plain, sizeof(plain)) != 0,
+		       "payload not encrypted");
+
+	memcpy(sealed_tf, tf, sizeof(tf));
+	memcpy(sealed, payload, sizeof(payload));
+
+	status = smb2_signing_decrypt_pdu(key, cipher_id, vector, 4);
+	torture_assert_ntstatus_ok(tctx, status, "decrypt");
+	torture_assert_mem_equal(tctx, payload, plain, sizeof(plain),
+				 "payload after round trip");
+
+	/* a flipped bit in the encrypted payload */
+	memcpy(tf, sealed_tf, sizeof(tf));
+	memcpy(payload, sealed, sizeof(payload));
+	payload[100] ^= 0x01;
+	status = smb2_signing_decrypt_pdu(key, cipher_id, vector, 4);
+	torture_assert_ntstatus_equal(tctx, status, NT_STATUS_ACCESS_DENIED,
+				      "tampered payload");
+
+	/* a flipped bit in the authenticated session id */
+	memcpy(tf, sealed_tf, sizeof(tf));
+	memcpy(payload, sealed, sizeof(payload));
+	tf[SMB2_TF_SESSION_ID] ^= 0x01;
+	status = smb2_signing_decrypt_pdu(key, cipher_id, vector, 4);
+	torture_assert_ntstatus_equal(tctx, status, NT_STATUS_ACCESS_DENIED,
+				      "tampered header");
+
+	/* the other cipher must not accept the pdu */
+	memcpy(tf, sealed_tf, sizeof(tf));
+	memcpy(payload, sealed, sizeof(payload));
+	status = smb2_signing_decrypt_pdu(key, other_cipher_id, vector, 4);
+	torture_assert_ntstatus_equal(tctx, status, NT_STATUS_ACCESS_DENIED,
+				      "wrong cipher");
+
+	return true;
+}
+
+static bool test_smb2_signing_aes128_ccm(struct torture_context *tctx)
+{
+	return smb2_signing_test_roundtrip(tctx,
+					   SMB2_ENCRYPTION_AES128_CCM,
+					   SMB2_ENCRYPTION_AES128_GCM);
+}
+
+static bool test_smb2_signing_aes128_gcm(struct torture_context *tctx)
+{
+	return smb2_signing_test_roundtrip(tctx,
+					   SMB2_ENCRYPTION_AES128_GCM,
+					   SMB2_ENCRYPTION_AES128_CCM);
+}
+
+static bool test_smb2_signing_unknown_cipher(struct torture_context *tctx)
+{
+	static const uint8_t key_buf[16] = { 0x01, };
+	DATA_BLOB key = data_blob_const(key_buf, sizeof(key_buf));
+	uint8_t tf[SMB2_TF_HDR_SIZE];
+	uint8_t payload[SMB2_SIGNING_TEST_PAYLOAD];
+	struct iovec vector[4];
+	NTSTATUS status;
+
+	smb2_signing_test_pdu(tf, payload, vector);
+
+	status = smb2_signing_encrypt_pdu(key, 0x0003, vector, 4);
+	torture_assert_ntstatus_equal(tctx, status,
+				      NT_STATUS_INVALID_PARAMETER,
+				      "encrypt with unknown cipher");
+
+	SSVAL(tf, SMB2_TF_FLAGS, SMB2_TF_FLAGS_ENCRYPTED);
+	SIVAL(tf, SMB2_TF_MSG_SIZE, SMB2_SIGNING_TEST_PAYLOAD);
+	status = smb2_signing_decrypt_pdu(key, 0x0003, vector, 4);
+	torture_assert_ntstatus_equal(tctx, status, NT_STATUS_ACCESS_DENIED,
+				      "decrypt with unknown cipher");
+
+	return true;
+}
+
+struct torture_suite *torture_local_smb2_signing(TALLOC_CTX *mem_ctx)
+{
+	struct torture_suite *suite = torture_suite_create(mem_ctx,
+							   "smb2_signing");
+
+	torture_suite_add_simple_test(suite, "aes128_ccm",
+				      test_smb2_signing_aes128_ccm);
+	torture_suite_add_simple_test(suite, "aes128_gcm",
+				      test_smb2_signing_aes128_gcm);
+	torture_suite_add_simple_test(suite, "unknown_cipher",
+				      test_smb2_signing_unknown_cipher);
+
+	return suite;
+}
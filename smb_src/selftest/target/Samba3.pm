@@ -454,6 +454,21 @@ sub setup_simpleserver($$)
         vfs objects = aio_fork
         read only = no
         vfs_aio_fork:erratic_testing_mode=yes
+
+[vfs_io_uring]
+	path = $prefix_abs/share
+        vfs objects = io_uring
+        read only = no
+        aio read size = 1
+        aio write size = 1
+
+[vfs_io_uring_erratic]
+	copy = vfs_io_uring
+        io_uring:testing mode = erratic
+
+[vfs_io_uring_unsupported]
+	copy = vfs_io_uring
+        io_uring:testing mode = unsupported
 ";
 
 	my $vars = $self->provision($path,
@@ -63,12 +63,22 @@ NTSTATUS ctdbd_db_attach(struct ctdbd_connection *conn, const char *name,
 
 NTSTATUS ctdbd_migrate(struct ctdbd_connection *conn, uint32_t db_id,
 		       TDB_DATA key);
+NTSTATUS ctdbd_migrate_records(struct ctdbd_connection *conn,
+			       const uint32_t *db_ids, const TDB_DATA *keys,
+			       size_t num_keys);
 
 NTSTATUS ctdbd_parse(struct ctdbd_connection *conn, uint32_t db_id,
 		     TDB_DATA key, bool local_copy,
 		     void (*parser)(TDB_DATA key, TDB_DATA data,
 				    void *private_data),
 		     void *private_data);
+NTSTATUS ctdbd_parse_records(struct ctdbd_connection *conn, uint32_t db_id,
+			     const TDB_DATA *keys, size_t num_keys,
+			     const bool *local_copy,
+			     void (*parser)(size_t idx, TDB_DATA key,
+					    TDB_DATA data,
+					    void *private_data),
+			     void *private_data);
 
 NTSTATUS ctdbd_traverse(uint32_t db_id,
 			void (*fn)(TDB_DATA key, TDB_DATA data,
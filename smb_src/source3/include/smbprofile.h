@@ -856,6 +856,22 @@ struct profile_stats {
 	unsigned syscall_sendfile_bytes;
 	unsigned syscall_recvfile_bytes;
 
+/* SMB2 read buffer counters */
+	unsigned smb2_read_buffer_hits;
+	unsigned smb2_read_buffer_misses;
+	/* bytes copied to pad responses in compound chains */
+	unsigned smb2_read_copied_bytes;
+	unsigned smb2_dyn_copied_bytes;
+
+/* SMB2 send queue counters, responses per writev() */
+	unsigned smb2_send_writev_calls;
+	unsigned smb2_send_responses;
+
+/* directory cache counters */
+	unsigned dircache_hits;
+	unsigned dircache_misses;
+	unsigned dircache_invalidations;
+
 /* stat cache counters */
 	unsigned statcache_lookups;
 	unsigned statcache_misses;
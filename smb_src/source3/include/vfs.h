@@ -161,6 +161,7 @@
 /* Version 32 - Add "lease" to struct files_struct */
 /* Version 32 - Add SMB_VFS_READDIR_ATTR() */
 /* Version 32 - Add in and our create context blobs to create_file */
+/* Version 32 - Add SMB_VFS_[STAT|LSTAT|FSTAT|GETXATTR]_SEND/RECV */
 
 #define SMB_VFS_INTERFACE_VERSION 32
 
@@ -591,6 +592,27 @@ struct vfs_fn_pointers {
 	int (*stat_fn)(struct vfs_handle_struct *handle, struct smb_filename *smb_fname);
 	int (*fstat_fn)(struct vfs_handle_struct *handle, struct files_struct *fsp, SMB_STRUCT_STAT *sbuf);
 	int (*lstat_fn)(struct vfs_handle_struct *handle, struct smb_filename *smb_filename);
+	/*
+	 * The async stat calls fill in smb_fname->st or sbuf when
+	 * they complete. Freeing the request before that stops them
+	 * from touching the result.
+	 */
+	struct tevent_req *(*stat_send_fn)(struct vfs_handle_struct *handle,
+					   TALLOC_CTX *mem_ctx,
+					   struct tevent_context *ev,
+					   struct smb_filename *smb_fname);
+	int (*stat_recv_fn)(struct tevent_req *req, int *err);
+	struct tevent_req *(*fstat_send_fn)(struct vfs_handle_struct *handle,
+					    TALLOC_CTX *mem_ctx,
+					    struct tevent_context *ev,
+					    struct files_struct *fsp,
+					    SMB_STRUCT_STAT *sbuf);
+	int (*fstat_recv_fn)(struct tevent_req *req, int *err);
+	struct tevent_req *(*lstat_send_fn)(struct vfs_handle_struct *handle,
+					    TALLOC_CTX *mem_ctx,
+					    struct tevent_context *ev,
+					    struct smb_filename *smb_fname);
+	int (*lstat_recv_fn)(struct tevent_req *req, int *err);
 	uint64_t (*get_alloc_size_fn)(struct vfs_handle_struct *handle, struct files_struct *fsp, const SMB_STRUCT_STAT *sbuf);
 	int (*unlink_fn)(struct vfs_handle_struct *handle,
 			 const struct smb_filename *smb_fname);
@@ -758,6 +780,13 @@ struct vfs_fn_pointers {
 
 	/* EA operations. */
 	ssize_t (*getxattr_fn)(struct vfs_handle_struct *handle,const char *path, const char *name, void *value, size_t size);
+	struct tevent_req *(*getxattr_send_fn)(struct vfs_handle_struct *handle,
+					       TALLOC_CTX *mem_ctx,
+					       struct tevent_context *ev,
+					       const char *path,
+					       const char *name,
+					       void *value, size_t size);
+	ssize_t (*getxattr_recv_fn)(struct tevent_req *req, int *err);
 	ssize_t (*fgetxattr_fn)(struct vfs_handle_struct *handle, struct files_struct *fsp, const char *name, void *value, size_t size);
 	ssize_t (*listxattr_fn)(struct vfs_handle_struct *handle, const char *path, char *list, size_t size);
 	ssize_t (*flistxattr_fn)(struct vfs_handle_struct *handle, struct files_struct *fsp, char *list, size_t size);
@@ -1026,6 +1055,22 @@ int smb_vfs_call_fstat(struct vfs_handle_struct *handle,
 		       struct files_struct *fsp, SMB_STRUCT_STAT *sbuf);
 int smb_vfs_call_lstat(struct vfs_handle_struct *handle,
 		       struct smb_filename *smb_filename);
+struct tevent_req *smb_vfs_call_stat_send(struct vfs_handle_struct *handle,
+					  TALLOC_CTX *mem_ctx,
+					  struct tevent_context *ev,
+					  struct smb_filename *smb_fname);
+int SMB_VFS_STAT_RECV(struct tevent_req *req, int *perrno);
+struct tevent_req *smb_vfs_call_fstat_send(struct vfs_handle_struct *handle,
+					   TALLOC_CTX *mem_ctx,
+					   struct tevent_context *ev,
+					   struct files_struct *fsp,
+					   SMB_STRUCT_STAT *sbuf);
+int SMB_VFS_FSTAT_RECV(struct tevent_req *req, int *perrno);
+struct tevent_req *smb_vfs_call_lstat_send(struct vfs_handle_struct *handle,
+					   TALLOC_CTX *mem_ctx,
+					   struct tevent_context *ev,
+					   struct smb_filename *smb_fname);
+int SMB_VFS_LSTAT_RECV(struct tevent_req *req, int *perrno);
 uint64_t smb_vfs_call_get_alloc_size(struct vfs_handle_struct *handle,
 				     struct files_struct *fsp,
 				     const SMB_STRUCT_STAT *sbuf);
@@ -1199,6 +1244,13 @@ int smb_vfs_call_sys_acl_delete_def_file(struct vfs_handle_struct *handle,
 ssize_t smb_vfs_call_getxattr(struct vfs_handle_struct *handle,
 			      const char *path, const char *name, void *value,
 			      size_t size);
+struct tevent_req *smb_vfs_call_getxattr_send(struct vfs_handle_struct *handle,
+					      TALLOC_CTX *mem_ctx,
+					      struct tevent_context *ev,
+					      const char *path,
+					      const char *name,
+					      void *value, size_t size);
+ssize_t SMB_VFS_GETXATTR_RECV(struct tevent_req *req, int *perrno);
 ssize_t smb_vfs_call_fgetxattr(struct vfs_handle_struct *handle,
 			       struct files_struct *fsp, const char *name,
 			       void *value, size_t size);
@@ -231,6 +231,25 @@
 #define SMB_VFS_NEXT_LSTAT(handle, smb_fname) \
 	smb_vfs_call_lstat((handle)->next, (smb_fname))
 
+#define SMB_VFS_STAT_SEND(mem_ctx, ev, conn, smb_fname) \
+	smb_vfs_call_stat_send((conn)->vfs_handles, (mem_ctx), (ev), \
+			       (smb_fname))
+#define SMB_VFS_NEXT_STAT_SEND(mem_ctx, ev, handle, smb_fname) \
+	smb_vfs_call_stat_send((handle)->next, (mem_ctx), (ev), (smb_fname))
+
+#define SMB_VFS_FSTAT_SEND(mem_ctx, ev, fsp, sbuf) \
+	smb_vfs_call_fstat_send((fsp)->conn->vfs_handles, (mem_ctx), (ev), \
+				(fsp), (sbuf))
+#define SMB_VFS_NEXT_FSTAT_SEND(mem_ctx, ev, handle, fsp, sbuf) \
+	smb_vfs_call_fstat_send((handle)->next, (mem_ctx), (ev), (fsp), \
+				(sbuf))
+
+#define SMB_VFS_LSTAT_SEND(mem_ctx, ev, conn, smb_fname) \
+	smb_vfs_call_lstat_send((conn)->vfs_handles, (mem_ctx), (ev), \
+				(smb_fname))
+#define SMB_VFS_NEXT_LSTAT_SEND(mem_ctx, ev, handle, smb_fname) \
+	smb_vfs_call_lstat_send((handle)->next, (mem_ctx), (ev), (smb_fname))
+
 #define SMB_VFS_GET_ALLOC_SIZE(conn, fsp, sbuf) \
 	smb_vfs_call_get_alloc_size((conn)->vfs_handles, (fsp), (sbuf))
 #define SMB_VFS_NEXT_GET_ALLOC_SIZE(conn, fsp, sbuf) \
@@ -491,6 +510,12 @@
 	smb_vfs_call_getxattr((conn)->vfs_handles,(path),(name),(value),(size))
 #define SMB_VFS_NEXT_GETXATTR(handle,path,name,value,size) \
 	smb_vfs_call_getxattr((handle)->next,(path),(name),(value),(size))
+#define SMB_VFS_GETXATTR_SEND(mem_ctx,ev,conn,path,name,value,size) \
+	smb_vfs_call_getxattr_send((conn)->vfs_handles,(mem_ctx),(ev), \
+				   (path),(name),(value),(size))
+#define SMB_VFS_NEXT_GETXATTR_SEND(mem_ctx,ev,handle,path,name,value,size) \
+	smb_vfs_call_getxattr_send((handle)->next,(mem_ctx),(ev), \
+				   (path),(name),(value),(size))
 
 #define SMB_VFS_FGETXATTR(fsp,name,value,size) \
 	smb_vfs_call_fgetxattr((fsp)->conn->vfs_handles, (fsp), (name),(value),(size))
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include "../pthreadpool/pthreadpool.h"
+#include "../../../lib/util/setid.h"
 
 struct asys_pwrite_args {
 	int fildes;
@@ -39,15 +40,41 @@ struct asys_fsync_args {
 	int fildes;
 };
 
+/*
+ * The results of stat and getxattr are collected in the job and
+ * copied to the caller's buffers in asys_results(), so a canceled
+ * job never writes into memory the caller has already freed.
+ */
+
+struct asys_stat_args {
+	char *pathname;
+	int fildes;
+	int follow;
+	struct stat st;
+	struct stat *result;
+};
+
+struct asys_getxattr_args {
+	char *pathname;
+	char *name;
+	void *buf;
+	size_t size;
+	void *result;
+};
+
 union asys_job_args {
 	struct asys_pwrite_args pwrite_args;
 	struct asys_pread_args pread_args;
 	struct asys_fsync_args fsync_args;
+	struct asys_stat_args stat_args;
+	struct asys_getxattr_args getxattr_args;
 };
 
 struct asys_job {
 	void *private_data;
 	union asys_job_args args;
+	void (*finish)(struct asys_job *job);
+	struct asys_creds_context *cctx;
 	ssize_t ret;
 	int err;
 	char busy;
@@ -63,7 +90,14 @@ struct asys_context {
 };
 
 struct asys_creds_context {
-	int dummy;
+	uid_t uid;
+	gid_t gid;
+	unsigned num_gids;
+	gid_t *gids;
+	/*
+	 * One reference from the creator and one per job using it
+	 */
+	unsigned refcount;
 };
 
 int asys_context_init(struct asys_context **pctx, unsigned max_parallel)
@@ -125,6 +159,9 @@ static int asys_new_job(struct asys_context *ctx, int *jobid,
 		job = ctx->jobs[i];
 		if (!job->busy) {
 			job->err = 0;
+			job->canceled = 0;
+			job->finish = NULL;
+			job->cctx = NULL;
 			*pjob = job;
 			*jobid = i;
 			return 0;
@@ -275,6 +312,281 @@ static void asys_fsync_do(void *private_data)
 	}
 }
 
+struct asys_creds_context *asys_creds_context_create(
+	struct asys_context *ctx,
+	uid_t uid, gid_t gid, unsigned num_gids, gid_t *gids)
+{
+#ifdef USE_LINUX_THREAD_CREDENTIALS
+	struct asys_creds_context *cctx;
+
+	cctx = calloc(1, sizeof(struct asys_creds_context));
+	if (cctx == NULL) {
+		return NULL;
+	}
+	cctx->uid = uid;
+	cctx->gid = gid;
+	cctx->num_gids = num_gids;
+	if (num_gids != 0) {
+		cctx->gids = calloc(num_gids, sizeof(gid_t));
+		if (cctx->gids == NULL) {
+			free(cctx);
+			return NULL;
+		}
+		memcpy(cctx->gids, gids, num_gids * sizeof(gid_t));
+	}
+	cctx->refcount = 1;
+	return cctx;
+#else
+	/*
+	 * Without per-thread credentials a job would run with the
+	 * credentials of whatever the main thread is doing.
+	 */
+	errno = ENOSYS;
+	return NULL;
+#endif
+}
+
+static void asys_creds_context_unref(struct asys_creds_context *cctx)
+{
+	if (cctx == NULL) {
+		return;
+	}
+	cctx->refcount -= 1;
+	if (cctx->refcount != 0) {
+		return;
+	}
+	free(cctx->gids);
+	free(cctx);
+}
+
+int asys_creds_context_delete(struct asys_creds_context *cctx)
+{
+	asys_creds_context_unref(cctx);
+	return 0;
+}
+
+static int asys_job_set_creds(struct asys_job *job)
+{
+	struct asys_creds_context *cctx = job->cctx;
+
+	if (cctx == NULL) {
+		return 0;
+	}
+
+#ifdef USE_LINUX_THREAD_CREDENTIALS
+	/*
+	 * The samba_set* wrappers use the raw system calls, which on
+	 * Linux only change the credentials of the calling thread.
+	 */
+	if (samba_setresuid(0, 0, -1) != 0) {
+		return errno;
+	}
+	if (samba_setresgid(cctx->gid, cctx->gid, -1) != 0) {
+		return errno;
+	}
+	if (samba_setgroups(cctx->num_gids, cctx->gids) != 0) {
+		return errno;
+	}
+	if (samba_setresuid(cctx->uid, cctx->uid, -1) != 0) {
+		return errno;
+	}
+	return 0;
+#else
+	return ENOSYS;
+#endif
+}
+
+static void asys_stat_do(void *private_data);
+static void asys_stat_finish(struct asys_job *job);
+
+static int asys_stat_job(struct asys_context *ctx,
+			 struct asys_creds_context *cctx,
+			 const char *pathname, int fildes, int follow,
+			 struct stat *st, void *private_data)
+{
+	struct asys_job *job;
+	struct asys_stat_args *args;
+	int jobid;
+	int ret;
+
+	ret = asys_new_job(ctx, &jobid, &job);
+	if (ret != 0) {
+		return ret;
+	}
+	job->private_data = private_data;
+
+	args = &job->args.stat_args;
+	args->pathname = NULL;
+	args->fildes = fildes;
+	args->follow = follow;
+	args->result = st;
+
+	if (pathname != NULL) {
+		args->pathname = strdup(pathname);
+		if (args->pathname == NULL) {
+			return ENOMEM;
+		}
+	}
+
+	job->finish = asys_stat_finish;
+	job->cctx = cctx;
+
+	ret = pthreadpool_add_job(ctx->pool, jobid, asys_stat_do, job);
+	if (ret != 0) {
+		free(args->pathname);
+		args->pathname = NULL;
+		job->cctx = NULL;
+		return ret;
+	}
+	job->busy = 1;
+	if (cctx != NULL) {
+		cctx->refcount += 1;
+	}
+
+	return 0;
+}
+
+int asys_stat(struct asys_context *ctx, struct asys_creds_context *cctx,
+	      const char *pathname, struct stat *st, void *private_data)
+{
+	return asys_stat_job(ctx, cctx, pathname, -1, 1, st, private_data);
+}
+
+int asys_lstat(struct asys_context *ctx, struct asys_creds_context *cctx,
+	       const char *pathname, struct stat *st, void *private_data)
+{
+	return asys_stat_job(ctx, cctx, pathname, -1, 0, st, private_data);
+}
+
+int asys_fstat(struct asys_context *ctx, int fildes, struct stat *st,
+	       void *private_data)
+{
+	return asys_stat_job(ctx, NULL, NULL, fildes, 1, st, private_data);
+}
+
+static void asys_stat_do(void *private_data)
+{
+	struct asys_job *job = (struct asys_job *)private_data;
+	struct asys_stat_args *args = &job->args.stat_args;
+
+	job->err = asys_job_set_creds(job);
+	if (job->err != 0) {
+		job->ret = -1;
+		return;
+	}
+
+	if (args->pathname == NULL) {
+		job->ret = fstat(args->fildes, &args->st);
+	} else if (args->follow) {
+		job->ret = stat(args->pathname, &args->st);
+	} else {
+		job->ret = lstat(args->pathname, &args->st);
+	}
+	if (job->ret == -1) {
+		job->err = errno;
+	}
+}
+
+static void asys_stat_finish(struct asys_job *job)
+{
+	struct asys_stat_args *args = &job->args.stat_args;
+
+	if (!job->canceled && job->ret == 0) {
+		*args->result = args->st;
+	}
+	free(args->pathname);
+	args->pathname = NULL;
+}
+
+static void asys_getxattr_do(void *private_data);
+static void asys_getxattr_finish(struct asys_job *job);
+
+static void asys_getxattr_free(struct asys_getxattr_args *args)
+{
+	free(args->pathname);
+	args->pathname = NULL;
+	free(args->name);
+	args->name = NULL;
+	free(args->buf);
+	args->buf = NULL;
+}
+
+int asys_getxattr(struct asys_context *ctx, struct asys_creds_context *cctx,
+		  const char *pathname, const char *name,
+		  void *value, size_t size, void *private_data)
+{
+	struct asys_job *job;
+	struct asys_getxattr_args *args;
+	int jobid;
+	int ret;
+
+	ret = asys_new_job(ctx, &jobid, &job);
+	if (ret != 0) {
+		return ret;
+	}
+	job->private_data = private_data;
+
+	args = &job->args.getxattr_args;
+	args->pathname = strdup(pathname);
+	args->name = strdup(name);
+	args->buf = NULL;
+	args->size = size;
+	args->result = value;
+
+	if (size != 0) {
+		args->buf = malloc(size);
+	}
+	if ((args->pathname == NULL) || (args->name == NULL) ||
+	    ((size != 0) && (args->buf == NULL))) {
+		asys_getxattr_free(args);
+		return ENOMEM;
+	}
+
+	job->finish = asys_getxattr_finish;
+	job->cctx = cctx;
+
+	ret = pthreadpool_add_job(ctx->pool, jobid, asys_getxattr_do, job);
+	if (ret != 0) {
+		asys_getxattr_free(args);
+		job->cctx = NULL;
+		return ret;
+	}
+	job->busy = 1;
+	if (cctx != NULL) {
+		cctx->refcount += 1;
+	}
+
+	return 0;
+}
+
+static void asys_getxattr_do(void *private_data)
+{
+	struct asys_job *job = (struct asys_job *)private_data;
+	struct asys_getxattr_args *args = &job->args.getxattr_args;
+
+	job->err = asys_job_set_creds(job);
+	if (job->err != 0) {
+		job->ret = -1;
+		return;
+	}
+
+	job->ret = getxattr(args->pathname, args->name, args->buf,
+			    args->size);
+	if (job->ret == -1) {
+		job->err = errno;
+	}
+}
+
+static void asys_getxattr_finish(struct asys_job *job)
+{
+	struct asys_getxattr_args *args = &job->args.getxattr_args;
+
+	if (!job->canceled && (job->ret > 0) && (args->size != 0)) {
+		memcpy(args->result, args->buf, job->ret);
+	}
+	asys_getxattr_free(args);
+}
+
 void asys_cancel(struct asys_context *ctx, void *private_data)
 {
 	unsigned i;
@@ -321,6 +633,12 @@ int asys_results(struct asys_context *ctx, struct asys_result *results,
 		}
 		result->private_data = job->private_data;
 
+		if (job->finish != NULL) {
+			job->finish(job);
+		}
+		asys_creds_context_unref(job->cctx);
+		job->cctx = NULL;
+
 		job->busy = 0;
 	}
 
@@ -137,6 +137,10 @@ int asys_ftruncate(struct asys_context *ctx, int filedes, off_t length,
 int asys_fsync(struct asys_context *ctx, int fd, void *private_data);
 int asys_close(struct asys_context *ctx, int fd, void *private_data);
 
+/*
+ * Returns NULL with errno ENOSYS if the platform can't run a job
+ * with other credentials than the main thread.
+ */
 struct asys_creds_context *asys_creds_context_create(
 	struct asys_context *ctx,
 	uid_t uid, gid_t gid, unsigned num_gids, gid_t *gids);
@@ -149,6 +153,20 @@ int asys_open(struct asys_context *ctx, struct asys_creds_context *cctx,
 int asys_unlink(struct asys_context *ctx, struct asys_creds_context *cctx,
 		const char *pathname, void *private_data);
 
+/*
+ * The stat and getxattr results are copied to st and value by
+ * asys_results(). A canceled job doesn't touch them anymore.
+ */
+int asys_stat(struct asys_context *ctx, struct asys_creds_context *cctx,
+	      const char *pathname, struct stat *st, void *private_data);
+int asys_lstat(struct asys_context *ctx, struct asys_creds_context *cctx,
+	       const char *pathname, struct stat *st, void *private_data);
+int asys_fstat(struct asys_context *ctx, int fildes, struct stat *st,
+	       void *private_data);
+int asys_getxattr(struct asys_context *ctx, struct asys_creds_context *cctx,
+		  const char *pathname, const char *name,
+		  void *value, size_t size, void *private_data);
+
 /* @} */
 
 #endif /* __ASYS_H__ */
@@ -1469,6 +1469,237 @@ NTSTATUS ctdbd_parse(struct ctdbd_connection *conn, uint32_t db_id,
 	return status;
 }
 
+/*
+ * Number of CTDB_REQ_CALLs put into one writev by ctdbd_req_calls, two
+ * iovecs each.
+ */
+#define CTDBD_REQ_CALLS_BATCH 64
+
+/*
+ * Send a set of CTDB_REQ_CALLs and collect the replies: All requests are
+ * written before the first reply is read, so ctdbd processes them in
+ * parallel. The caller fills in flags, callid and db_id of "reqs", the
+ * header and the key are filled in here. "fn" is called for every reply
+ * with the index of the request.
+ */
+static NTSTATUS ctdbd_req_calls(struct ctdbd_connection *conn,
+				struct ctdb_req_call *reqs,
+				const TDB_DATA *keys, size_t num_keys,
+				void (*fn)(size_t idx,
+					   struct ctdb_reply_call *reply,
+					   void *private_data),
+				void *private_data)
+{
+	TALLOC_CTX *frame = talloc_stackframe();
+	uint32_t *reqids;
+	size_t i, num_received;
+	NTSTATUS status;
+
+	reqids = talloc_array(frame, uint32_t, num_keys);
+	if (reqids == NULL) {
+		TALLOC_FREE(frame);
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	i = 0;
+
+	while (i < num_keys) {
+		struct iovec iov[CTDBD_REQ_CALLS_BATCH * 2];
+		int num_iov = 0;
+		ssize_t nwritten;
+
+		while ((i < num_keys) &&
+		       (num_iov < CTDBD_REQ_CALLS_BATCH * 2)) {
+			struct ctdb_req_call *req = &reqs[i];
+
+			reqids[i] = ctdbd_next_reqid(conn);
+
+			req->hdr.length = offsetof(struct ctdb_req_call, data)
+				+ keys[i].dsize;
+			req->hdr.ctdb_magic   = CTDB_MAGIC;
+			req->hdr.ctdb_version = CTDB_PROTOCOL;
+			req->hdr.operation    = CTDB_REQ_CALL;
+			req->hdr.reqid        = reqids[i];
+			req->keylen           = keys[i].dsize;
+
+			iov[num_iov].iov_base = req;
+			iov[num_iov].iov_len =
+				offsetof(struct ctdb_req_call, data);
+			iov[num_iov+1].iov_base = keys[i].dptr;
+			iov[num_iov+1].iov_len = keys[i].dsize;
+
+			num_iov += 2;
+			i += 1;
+		}
+
+		nwritten = write_data_iov(conn->fd, iov, num_iov);
+		if (nwritten == -1) {
+			DEBUG(3, ("write_data_iov failed: %s\n",
+				  strerror(errno)));
+			cluster_fatal("cluster dispatch daemon msg write "
+				      "error\n");
+		}
+	}
+
+	num_received = 0;
+
+	while (num_received < num_keys) {
+		struct ctdb_req_header *hdr;
+		uint32_t reqid;
+
+		status = ctdb_read_req(conn, 0, frame, &hdr);
+		if (!NT_STATUS_IS_OK(status)) {
+			DEBUG(0, ("ctdb_read_req failed: %s\n",
+				  nt_errstr(status)));
+			goto fail;
+		}
+
+		if (hdr->operation != CTDB_REPLY_CALL) {
+			DEBUG(0, ("received invalid reply\n"));
+			status = NT_STATUS_INTERNAL_ERROR;
+			goto fail;
+		}
+
+		/*
+		 * reqids are handed out sequentially, so the offset
+		 * from the first one is the index unless the counter
+		 * wrapped.
+		 */
+		reqid = hdr->reqid;
+		i = reqid - reqids[0];
+
+		if ((i >= num_keys) || (reqids[i] != reqid)) {
+			for (i=0; i<num_keys; i++) {
+				if (reqids[i] == reqid) {
+					break;
+				}
+			}
+		}
+		if (i == num_keys) {
+			DEBUG(0, ("Discarding unknown ctdb reqid %u\n",
+				  (unsigned)reqid));
+			TALLOC_FREE(hdr);
+			continue;
+		}
+
+		fn(i, (struct ctdb_reply_call *)hdr, private_data);
+
+		TALLOC_FREE(hdr);
+		num_received += 1;
+	}
+
+	status = NT_STATUS_OK;
+ fail:
+	TALLOC_FREE(frame);
+	return status;
+}
+
+struct ctdbd_parse_records_state {
+	const TDB_DATA *keys;
+	void (*parser)(size_t idx, TDB_DATA key, TDB_DATA data,
+		       void *private_data);
+	void *private_data;
+};
+
+static void ctdbd_parse_records_reply(size_t idx,
+				      struct ctdb_reply_call *reply,
+				      void *private_data)
+{
+	struct ctdbd_parse_records_state *state = private_data;
+
+	/*
+	 * Treat an empty record as non-existing
+	 */
+	if (reply->datalen != 0) {
+		state->parser(idx, state->keys[idx],
+			      make_tdb_data(&reply->data[0], reply->datalen),
+			      state->private_data);
+	}
+}
+
+/*
+ * Fetch a set of records in one round trip. Records that don't exist are
+ * not passed to the parser. local_copy may be NULL.
+ */
+
+NTSTATUS ctdbd_parse_records(struct ctdbd_connection *conn, uint32_t db_id,
+			     const TDB_DATA *keys, size_t num_keys,
+			     const bool *local_copy,
+			     void (*parser)(size_t idx, TDB_DATA key,
+					    TDB_DATA data,
+					    void *private_data),
+			     void *private_data)
+{
+	struct ctdbd_parse_records_state state = {
+		.keys = keys, .parser = parser, .private_data = private_data
+	};
+	struct ctdb_req_call *reqs;
+	size_t i;
+	NTSTATUS status;
+
+	reqs = talloc_zero_array(talloc_tos(), struct ctdb_req_call,
+				 num_keys);
+	if (reqs == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	for (i=0; i<num_keys; i++) {
+		bool readonly = (local_copy != NULL) && local_copy[i];
+
+		reqs[i].flags  = readonly ? CTDB_WANT_READONLY : 0;
+		reqs[i].callid = CTDB_FETCH_FUNC;
+		reqs[i].db_id  = db_id;
+	}
+
+	status = ctdbd_req_calls(conn, reqs, keys, num_keys,
+				 ctdbd_parse_records_reply, &state);
+	TALLOC_FREE(reqs);
+	return status;
+}
+
+static void ctdbd_migrate_records_reply(size_t idx,
+					struct ctdb_reply_call *reply,
+					void *private_data)
+{
+	return;
+}
+
+/*
+ * Migrate a set of records, possibly from different databases, to this
+ * node in one round trip. Like ctdbd_migrate, this does not guarantee
+ * that the records are still here when the caller locks them.
+ */
+
+NTSTATUS ctdbd_migrate_records(struct ctdbd_connection *conn,
+			       const uint32_t *db_ids, const TDB_DATA *keys,
+			       size_t num_keys)
+{
+	struct ctdb_req_call *reqs;
+	size_t i;
+	NTSTATUS status;
+
+	if (num_keys == 1) {
+		return ctdbd_migrate(conn, db_ids[0], keys[0]);
+	}
+
+	reqs = talloc_zero_array(talloc_tos(), struct ctdb_req_call,
+				 num_keys);
+	if (reqs == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	for (i=0; i<num_keys; i++) {
+		reqs[i].flags  = CTDB_IMMEDIATE_MIGRATION;
+		reqs[i].callid = CTDB_NULL_FUNC;
+		reqs[i].db_id  = db_ids[i];
+	}
+
+	status = ctdbd_req_calls(conn, reqs, keys, num_keys,
+				 ctdbd_migrate_records_reply, NULL);
+	TALLOC_FREE(reqs);
+	return status;
+}
+
 /*
   Traverse a ctdb database. This uses a kind-of hackish way to open a second
   connection to ctdbd to avoid the hairy recursive and async problems with
@@ -1313,6 +1313,243 @@ static NTSTATUS db_ctdb_parse_record(struct db_context *db, TDB_DATA key,
 			   state.ask_for_readonly_copy, parser, private_data);
 }
 
+struct db_ctdb_parse_records_state {
+	struct db_context *db;
+	void (*parser)(size_t idx, TDB_DATA key, TDB_DATA data,
+		       void *private_data);
+	void *private_data;
+	bool *done;
+	bool *ask_for_readonly_copy;
+	const size_t *idxs;
+	size_t idx;
+};
+
+static int db_ctdb_parse_records_ltdb_parser(size_t idx, TDB_DATA key,
+					     TDB_DATA data,
+					     void *private_data)
+{
+	struct db_ctdb_parse_records_state *state =
+		(struct db_ctdb_parse_records_state *)private_data;
+	struct ctdb_ltdb_header *header;
+
+	if (data.dsize < sizeof(struct ctdb_ltdb_header)) {
+		return 0;
+	}
+	header = (struct ctdb_ltdb_header *)data.dptr;
+	data = make_tdb_data(data.dptr + sizeof(struct ctdb_ltdb_header),
+			     data.dsize - sizeof(struct ctdb_ltdb_header));
+
+	if (state->db->persistent) {
+		state->parser(idx, key, data, state->private_data);
+		return 0;
+	}
+
+	if (db_ctdb_can_use_local_hdr(header, true)) {
+		state->parser(idx, key, data, state->private_data);
+		state->done[idx] = true;
+	} else {
+		/*
+		 * See db_ctdb_parse_record_parser_nonpersistent
+		 */
+		state->ask_for_readonly_copy[idx] = true;
+	}
+	return 0;
+}
+
+static void db_ctdb_parse_records_remote_parser(size_t idx, TDB_DATA key,
+						TDB_DATA data,
+						void *private_data)
+{
+	struct db_ctdb_parse_records_state *state =
+		(struct db_ctdb_parse_records_state *)private_data;
+	state->parser(state->idxs[idx], key, data, state->private_data);
+}
+
+static void db_ctdb_parse_records_single_parser(TDB_DATA key, TDB_DATA data,
+						void *private_data)
+{
+	struct db_ctdb_parse_records_state *state =
+		(struct db_ctdb_parse_records_state *)private_data;
+	state->parser(state->idx, key, data, state->private_data);
+}
+
+/*
+ * Batch version of db_ctdb_parse_record: All keys are first looked up in
+ * the local tdb with one lock per hash chain. Whatever can't be served
+ * locally is fetched from ctdbd in one pipelined round trip.
+ */
+static NTSTATUS db_ctdb_parse_records(struct db_context *db,
+				      const TDB_DATA *keys, size_t num_keys,
+				      void (*parser)(size_t idx, TDB_DATA key,
+						     TDB_DATA data,
+						     void *private_data),
+				      void *private_data)
+{
+	struct db_ctdb_ctx *ctx = talloc_get_type_abort(
+		db->private_data, struct db_ctdb_ctx);
+	struct db_ctdb_parse_records_state state = {
+		.db = db, .parser = parser, .private_data = private_data
+	};
+	TALLOC_CTX *frame;
+	TDB_DATA *remote_keys;
+	bool *remote_readonly;
+	size_t *idxs;
+	size_t i, num_remote;
+	NTSTATUS status;
+	int ret;
+
+	if (ctx->transaction != NULL) {
+		/*
+		 * The transaction's marshall buffer has to be consulted
+		 * for every key, don't bother batching.
+		 */
+		for (i=0; i<num_keys; i++) {
+			state.idx = i;
+			status = db_ctdb_parse_record(
+				db, keys[i],
+				db_ctdb_parse_records_single_parser, &state);
+			if (NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+				continue;
+			}
+			if (!NT_STATUS_IS_OK(status)) {
+				return status;
+			}
+		}
+		return NT_STATUS_OK;
+	}
+
+	frame = talloc_stackframe();
+
+	if (!db->persistent) {
+		state.done = talloc_zero_array(frame, bool, num_keys);
+		state.ask_for_readonly_copy = talloc_zero_array(
+			frame, bool, num_keys);
+		if ((state.done == NULL) ||
+		    (state.ask_for_readonly_copy == NULL)) {
+			TALLOC_FREE(frame);
+			return NT_STATUS_NO_MEMORY;
+		}
+	}
+
+	ret = tdb_parse_records(ctx->wtdb->tdb, keys, num_keys,
+				db_ctdb_parse_records_ltdb_parser, &state);
+	if (ret != 0) {
+		status = map_nt_error_from_tdb(tdb_error(ctx->wtdb->tdb));
+		TALLOC_FREE(frame);
+		return status;
+	}
+
+	if (db->persistent) {
+		TALLOC_FREE(frame);
+		return NT_STATUS_OK;
+	}
+
+	remote_keys = talloc_array(frame, TDB_DATA, num_keys);
+	remote_readonly = talloc_array(frame, bool, num_keys);
+	idxs = talloc_array(frame, size_t, num_keys);
+	if ((remote_keys == NULL) || (remote_readonly == NULL) ||
+	    (idxs == NULL)) {
+		TALLOC_FREE(frame);
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	num_remote = 0;
+
+	for (i=0; i<num_keys; i++) {
+		if (state.done[i]) {
+			continue;
+		}
+		remote_keys[num_remote] = keys[i];
+		remote_readonly[num_remote] = state.ask_for_readonly_copy[i];
+		idxs[num_remote] = i;
+		num_remote += 1;
+	}
+
+	if (num_remote == 0) {
+		TALLOC_FREE(frame);
+		return NT_STATUS_OK;
+	}
+
+	state.idxs = idxs;
+
+	status = ctdbd_parse_records(
+		messaging_ctdbd_connection(), ctx->db_id,
+		remote_keys, num_remote, remote_readonly,
+		db_ctdb_parse_records_remote_parser, &state);
+	TALLOC_FREE(frame);
+	return status;
+}
+
+static void db_ctdb_prefetch_locked_parser(TDB_DATA key,
+					   struct ctdb_ltdb_header *header,
+					   TDB_DATA data, void *private_data)
+{
+	bool *local = (bool *)private_data;
+	*local = db_ctdb_can_use_local_hdr(header, false);
+}
+
+/*
+ * Migrate all records from non-persistent ctdb databases in "dbs" that
+ * fetch_locked would have to migrate one by one. All migrate requests go
+ * out together, so their round trips through the cluster overlap.
+ */
+static NTSTATUS db_ctdb_prefetch_locked(struct db_context **dbs,
+					const TDB_DATA *keys, size_t num_keys)
+{
+	TALLOC_CTX *frame = talloc_stackframe();
+	uint32_t *db_ids;
+	TDB_DATA *remote_keys;
+	size_t i, num_remote;
+	NTSTATUS status;
+
+	db_ids = talloc_array(frame, uint32_t, num_keys);
+	remote_keys = talloc_array(frame, TDB_DATA, num_keys);
+	if ((db_ids == NULL) || (remote_keys == NULL)) {
+		TALLOC_FREE(frame);
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	num_remote = 0;
+
+	for (i=0; i<num_keys; i++) {
+		struct db_ctdb_ctx *ctx;
+		bool local = false;
+
+		if ((dbs[i] == NULL) ||
+		    (dbs[i]->prefetch_locked != db_ctdb_prefetch_locked) ||
+		    dbs[i]->persistent) {
+			continue;
+		}
+		ctx = talloc_get_type_abort(dbs[i]->private_data,
+					    struct db_ctdb_ctx);
+		if (ctx->transaction != NULL) {
+			continue;
+		}
+
+		db_ctdb_ltdb_parse(ctx, keys[i],
+				   db_ctdb_prefetch_locked_parser, &local);
+		if (local) {
+			continue;
+		}
+
+		db_ids[num_remote] = ctx->db_id;
+		remote_keys[num_remote] = keys[i];
+		num_remote += 1;
+	}
+
+	if (num_remote == 0) {
+		TALLOC_FREE(frame);
+		return NT_STATUS_OK;
+	}
+
+	DEBUG(10, ("Prefetching %u records\n", (unsigned)num_remote));
+
+	status = ctdbd_migrate_records(messaging_ctdbd_connection(),
+				       db_ids, remote_keys, num_remote);
+	TALLOC_FREE(frame);
+	return status;
+}
+
 struct traverse_state {
 	struct db_context *db;
 	int (*fn)(struct db_record *rec, void *private_data);
@@ -1688,6 +1925,8 @@ struct db_context *db_open_ctdb(TALLOC_CTX *mem_ctx,
 	result->fetch_locked = db_ctdb_fetch_locked;
 	result->try_fetch_locked = db_ctdb_try_fetch_locked;
 	result->parse_record = db_ctdb_parse_record;
+	result->parse_records = db_ctdb_parse_records;
+	result->prefetch_locked = db_ctdb_prefetch_locked;
 	result->traverse = db_ctdb_traverse;
 	result->traverse_read = db_ctdb_traverse_read;
 	result->get_seqnum = db_ctdb_get_seqnum;
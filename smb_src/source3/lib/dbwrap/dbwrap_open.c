@@ -24,6 +24,7 @@
 #include "dbwrap/dbwrap_open.h"
 #include "dbwrap/dbwrap_tdb.h"
 #include "dbwrap/dbwrap_ctdb.h"
+#include "dbwrap/dbwrap_sharded.h"
 #include "lib/param/param.h"
 #include "util_tdb.h"
 #include "ctdbd_conn.h"
@@ -112,6 +113,39 @@ struct db_context *db_open(TALLOC_CTX *mem_ctx,
 		}
 	}
 
+	if (!lp_clustering()) {
+		const char *base;
+		bool fast_hash = false;
+		bool multi_freelist = ((tdb_flags & TDB_MULTI_FREELIST) != 0);
+
+		base = strrchr_m(name, '/');
+		if (base != NULL) {
+			base += 1;
+		} else {
+			base = name;
+		}
+
+		/*
+		 * Only used when the tdb is created, existing tdbs
+		 * keep their hash function and their freelist.
+		 */
+		fast_hash = lp_parm_bool(-1, "dbwrap_tdb_fast_hash", "*", fast_hash);
+		fast_hash = lp_parm_bool(-1, "dbwrap_tdb_fast_hash", base, fast_hash);
+
+		if (fast_hash) {
+			tdb_flags |= TDB_FAST_HASH;
+		}
+
+		multi_freelist = lp_parm_bool(-1, "dbwrap_tdb_multi_freelist", "*", multi_freelist);
+		multi_freelist = lp_parm_bool(-1, "dbwrap_tdb_multi_freelist", base, multi_freelist);
+
+		if (multi_freelist) {
+			tdb_flags |= TDB_MULTI_FREELIST;
+		} else {
+			tdb_flags &= ~TDB_MULTI_FREELIST;
+		}
+	}
+
 	sockname = lp_ctdbd_socket();
 
 	if (lp_clustering()) {
@@ -155,3 +189,72 @@ struct db_context *db_open(TALLOC_CTX *mem_ctx,
 	}
 	return result;
 }
+
+/**
+ * Open "name" spread across num_shards databases. The first shard
+ * keeps "name", the others are called like "locking.1.tdb".
+ */
+struct db_context *db_open_shards(TALLOC_CTX *mem_ctx,
+				  const char *name,
+				  unsigned num_shards,
+				  int hash_size, int tdb_flags,
+				  int open_flags, mode_t mode,
+				  enum dbwrap_lock_order lock_order,
+				  uint64_t dbwrap_flags)
+{
+	TALLOC_CTX *frame;
+	struct db_context **shards;
+	struct db_context *result;
+	size_t namelen;
+	unsigned i;
+
+	if (num_shards <= 1) {
+		return db_open(mem_ctx, name, hash_size, tdb_flags,
+			       open_flags, mode, lock_order, dbwrap_flags);
+	}
+
+	frame = talloc_stackframe();
+
+	shards = talloc_zero_array(frame, struct db_context *, num_shards);
+	if (shards == NULL) {
+		TALLOC_FREE(frame);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	namelen = strlen(name);
+	if ((namelen > 4) && (strcmp(name + namelen - 4, ".tdb") == 0)) {
+		namelen -= 4;
+	}
+
+	for (i=0; i<num_shards; i++) {
+		const char *shard_name = name;
+
+		if (i > 0) {
+			shard_name = talloc_asprintf(
+				frame, "%.*s.%u.tdb", (int)namelen, name, i);
+			if (shard_name == NULL) {
+				TALLOC_FREE(frame);
+				errno = ENOMEM;
+				return NULL;
+			}
+		}
+
+		shards[i] = db_open(shards, shard_name, hash_size, tdb_flags,
+				    open_flags, mode, lock_order,
+				    dbwrap_flags);
+		if (shards[i] == NULL) {
+			DEBUG(1, ("Could not open %s: %s\n", shard_name,
+				  strerror(errno)));
+			TALLOC_FREE(frame);
+			return NULL;
+		}
+	}
+
+	result = db_open_sharded(mem_ctx, name, &shards, num_shards);
+	TALLOC_FREE(frame);
+	if (result == NULL) {
+		errno = ENOMEM;
+	}
+	return result;
+}
@@ -42,4 +42,16 @@ struct db_context *db_open(TALLOC_CTX *mem_ctx,
 			   enum dbwrap_lock_order lock_order,
 			   uint64_t dbwrap_flags);
 
+/**
+ * Like db_open(), but hash the keys across "num_shards" databases.
+ * All users of the database must use the same num_shards.
+ */
+struct db_context *db_open_shards(TALLOC_CTX *mem_ctx,
+				  const char *name,
+				  unsigned num_shards,
+				  int hash_size, int tdb_flags,
+				  int open_flags, mode_t mode,
+				  enum dbwrap_lock_order lock_order,
+				  uint64_t dbwrap_flags);
+
 #endif /* __DBWRAP_OPEN_H__ */
@@ -334,6 +334,16 @@ static void add_interface(const struct iface_struct *ifs)
 	iface->netmask = ifs->netmask;
 	iface->bcast = ifs->bcast;
 
+	/*
+	 * We don't have a portable way to find the
+	 * real link speed, so we just assume 1 Gbit.
+	 */
+#ifdef HAVE_IF_NAMETOINDEX
+	iface->if_index = if_nametoindex(ifs->name);
+#endif
+	iface->linkspeed = 1000 * 1000 * 1000;
+	iface->capability = 0;
+
 	DLIST_ADD(local_interfaces, iface);
 
 	DEBUG(2,("added interface %s ip=%s ",
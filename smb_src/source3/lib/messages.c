@@ -265,6 +265,19 @@ static void messaging_recv_cb(const uint8_t *msg, size_t msg_len,
 	messaging_dispatch_rec(msg_ctx, &rec);
 }
 
+/*
+ * Local messages can optionally go through shared memory rings instead of
+ * datagram sockets, see lib/unix_msg/shm_msg.h. The rings live in the
+ * cache directory, which should be on a tmpfs for this to pay off.
+ */
+static size_t messaging_shm_ring_size(void)
+{
+	if (!lp_parm_bool(-1, "messaging", "shm transport", false)) {
+		return 0;
+	}
+	return lp_parm_ulong(-1, "messaging", "shm ring size", 256*1024);
+}
+
 static int messaging_context_destructor(struct messaging_context *ctx)
 {
 	messaging_dgm_destroy();
@@ -289,6 +302,7 @@ struct messaging_context *messaging_init(TALLOC_CTX *mem_ctx,
 
 	ret = messaging_dgm_init(ctx->event_ctx, ctx->id,
 				 lp_cache_directory(), sec_initial_uid(),
+				 messaging_shm_ring_size(),
 				 messaging_recv_cb, ctx);
 
 	if (ret != 0) {
@@ -341,6 +355,7 @@ NTSTATUS messaging_reinit(struct messaging_context *msg_ctx)
 
 	ret = messaging_dgm_init(msg_ctx->event_ctx, msg_ctx->id,
 				 lp_cache_directory(), sec_initial_uid(),
+				 messaging_shm_ring_size(),
 				 messaging_recv_cb, msg_ctx);
 	if (ret != 0) {
 		DEBUG(0, ("messaging_dgm_init failed: %s\n", strerror(errno)));
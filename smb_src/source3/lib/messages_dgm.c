@@ -26,6 +26,7 @@
 #include "lib/param/param.h"
 #include "poll_funcs/poll_funcs_tevent.h"
 #include "unix_msg/unix_msg.h"
+#include "unix_msg/shm_msg.h"
 
 struct sun_path_buf {
 	/*
@@ -39,6 +40,7 @@ struct messaging_dgm_context {
 	struct poll_funcs *msg_callbacks;
 	void *tevent_handle;
 	struct unix_msg_ctx *dgm_ctx;
+	struct shm_msg_ctx *shm_ctx;
 	struct sun_path_buf cache_dir;
 	int lockfile_fd;
 
@@ -58,6 +60,9 @@ static void messaging_dgm_recv(struct unix_msg_ctx *ctx,
 			       uint8_t *msg, size_t msg_len,
 			       int *fds, size_t num_fds,
 			       void *private_data);
+static void messaging_dgm_shm_recv(struct shm_msg_ctx *ctx,
+				   uint8_t *msg, size_t msg_len,
+				   void *private_data);
 
 static int messaging_dgm_lockfile_name(struct sun_path_buf *buf,
 				       const char *cache_dir,
@@ -73,7 +78,23 @@ static int messaging_dgm_lockfile_name(struct sun_path_buf *buf,
 	return 0;
 }
 
+static int messaging_dgm_shm_name(struct sun_path_buf *buf,
+				  const char *cache_dir,
+				  pid_t pid)
+{
+	int ret;
+
+	ret = snprintf(buf->buf, sizeof(buf->buf), "%s/shm/%u", cache_dir,
+		       (unsigned)pid);
+	if (ret >= sizeof(buf->buf)) {
+		return ENAMETOOLONG;
+	}
+	return 0;
+}
+
 static int messaging_dgm_context_destructor(struct messaging_dgm_context *c);
+static void messaging_dgm_shm_init(struct messaging_dgm_context *ctx,
+				   uid_t dir_owner, size_t ring_size);
 
 static int messaging_dgm_lockfile_create(const char *cache_dir,
 					 uid_t dir_owner, pid_t pid,
@@ -179,6 +200,7 @@ int messaging_dgm_init(struct tevent_context *ev,
 		       struct server_id pid,
 		       const char *cache_dir,
 		       uid_t dir_owner,
+		       size_t shm_ring_size,
 		       void (*recv_cb)(const uint8_t *msg,
 				       size_t msg_len,
 				       int *fds,
@@ -266,6 +288,10 @@ int messaging_dgm_init(struct tevent_context *ev,
 	}
 	talloc_set_destructor(ctx, messaging_dgm_context_destructor);
 
+	if (shm_ring_size != 0) {
+		messaging_dgm_shm_init(ctx, dir_owner, shm_ring_size);
+	}
+
 	ctx->have_dgm_context = &have_dgm_context;
 
 	global_dgm_context = ctx;
@@ -276,12 +302,55 @@ fail_nomem:
 	return ENOMEM;
 }
 
+/*
+ * The shm ring is optional: Without it, or if it can't be set up, all
+ * messages go through the datagram socket. Senders can't tell in advance
+ * whether the destination has a ring, they just try it first.
+ */
+static void messaging_dgm_shm_init(struct messaging_dgm_context *ctx,
+				   uid_t dir_owner, size_t ring_size)
+{
+	struct sun_path_buf shm_dir, shm_name;
+	int ret;
+	bool ok;
+
+	ret = snprintf(shm_dir.buf, sizeof(shm_dir.buf), "%s/shm",
+		       ctx->cache_dir.buf);
+	if (ret >= sizeof(shm_dir.buf)) {
+		return;
+	}
+	ret = messaging_dgm_shm_name(&shm_name, ctx->cache_dir.buf,
+				     ctx->pid);
+	if (ret != 0) {
+		return;
+	}
+
+	ok = directory_create_or_exist_strict(shm_dir.buf, dir_owner, 0700);
+	if (!ok) {
+		DEBUG(1, ("%s: Could not create shm directory\n", __func__));
+		return;
+	}
+
+	unlink(shm_name.buf);
+
+	ret = shm_msg_init(shm_name.buf, ctx->msg_callbacks, ring_size,
+			   messaging_dgm_shm_recv, ctx, &ctx->shm_ctx);
+	if (ret != 0) {
+		DEBUG(1, ("%s: shm_msg_init failed: %s\n", __func__,
+			  strerror(ret)));
+		ctx->shm_ctx = NULL;
+	}
+}
+
 static int messaging_dgm_context_destructor(struct messaging_dgm_context *c)
 {
 	/*
 	 * First delete the socket to avoid races. The lockfile is the
 	 * indicator that we're still around.
 	 */
+	if (c->shm_ctx != NULL) {
+		shm_msg_free(c->shm_ctx);
+	}
 	unix_msg_free(c->dgm_ctx);
 
 	if (getpid() == c->pid) {
@@ -324,6 +393,24 @@ int messaging_dgm_send(pid_t pid,
 
 	DEBUG(10, ("%s: Sending message to %u\n", __func__, (unsigned)pid));
 
+	if ((ctx->shm_ctx != NULL) && (num_fds == 0)) {
+		struct sun_path_buf shm_name;
+
+		ret = messaging_dgm_shm_name(&shm_name, ctx->cache_dir.buf,
+					     pid);
+		if (ret == 0) {
+			ret = shm_msg_send(ctx->shm_ctx, shm_name.buf,
+					   iov, iovlen);
+		}
+		if (ret == 0) {
+			return 0;
+		}
+		if (ret != ENOENT) {
+			DEBUG(10, ("%s: shm_msg_send failed: %s, using "
+				   "the socket\n", __func__, strerror(ret)));
+		}
+	}
+
 	ret = unix_msg_send(ctx->dgm_ctx, &dst, iov, iovlen, fds, num_fds);
 
 	return ret;
@@ -337,14 +424,34 @@ static void messaging_dgm_recv(struct unix_msg_ctx *ctx,
 	struct messaging_dgm_context *dgm_ctx = talloc_get_type_abort(
 		private_data, struct messaging_dgm_context);
 
+	if (dgm_ctx->shm_ctx != NULL) {
+		/*
+		 * A sender falls back to the socket for messages with
+		 * fds or when our ring is full. Deliver what it put into
+		 * the ring before.
+		 */
+		shm_msg_drain(dgm_ctx->shm_ctx);
+	}
+
 	dgm_ctx->recv_cb(msg, msg_len, fds, num_fds,
 			 dgm_ctx->recv_cb_private_data);
 }
 
+static void messaging_dgm_shm_recv(struct shm_msg_ctx *ctx,
+				   uint8_t *msg, size_t msg_len,
+				   void *private_data)
+{
+	struct messaging_dgm_context *dgm_ctx = talloc_get_type_abort(
+		private_data, struct messaging_dgm_context);
+
+	dgm_ctx->recv_cb(msg, msg_len, NULL, 0,
+			 dgm_ctx->recv_cb_private_data);
+}
+
 int messaging_dgm_cleanup(pid_t pid)
 {
 	struct messaging_dgm_context *ctx = global_dgm_context;
-	struct sun_path_buf lockfile_name, socket_name;
+	struct sun_path_buf lockfile_name, socket_name, shm_name;
 	int fd, ret;
 	struct flock lck = {};
 
@@ -387,6 +494,18 @@ int messaging_dgm_cleanup(pid_t pid)
 	}
 
 	(void)unlink(socket_name.buf);
+
+	/* same length as lockfile_name, can't overflow */
+	snprintf(shm_name.buf, sizeof(shm_name.buf), "%s/shm/%u",
+		 ctx->cache_dir.buf, (unsigned)pid);
+	(void)unlink(shm_name.buf);
+
+	ret = snprintf(shm_name.buf, sizeof(shm_name.buf), "%s/shm/%u.bell",
+		       ctx->cache_dir.buf, (unsigned)pid);
+	if (ret < sizeof(shm_name.buf)) {
+		(void)unlink(shm_name.buf);
+	}
+
 	(void)unlink(lockfile_name.buf);
 	(void)close(fd);
 	return 0;
@@ -24,6 +24,7 @@ int messaging_dgm_init(struct tevent_context *ev,
 		       struct server_id pid,
 		       const char *cache_dir,
 		       uid_t dir_owner,
+		       size_t shm_ring_size,
 		       void (*recv_cb)(const uint8_t *msg,
 				       size_t msg_len,
 				       int *fds,
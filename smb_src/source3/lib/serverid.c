@@ -182,6 +182,26 @@ static void server_exists_parse(TDB_DATA key, TDB_DATA data, void *priv)
 				sizeof(state->id->unique_id)) == 0);
 }
 
+struct serverids_exist_state {
+	const struct server_id *ids;
+	const int *verify_idx;
+	bool *results;
+};
+
+static void serverids_exist_parse(size_t i, TDB_DATA key, TDB_DATA data,
+				  void *priv)
+{
+	struct serverids_exist_state *state =
+		(struct serverids_exist_state *)priv;
+	struct serverid_exists_state exists_state;
+	int idx = state->verify_idx[i];
+
+	exists_state.id = &state->ids[idx];
+	exists_state.exists = false;
+	server_exists_parse(key, data, &exists_state);
+	state->results[idx] = exists_state.exists;
+}
+
 bool serverid_exists(const struct server_id *id)
 {
 	bool result = false;
@@ -205,6 +225,8 @@ bool serverids_exist(const struct server_id *ids, int num_ids, bool *results)
 	int remote_num = 0;
 	int *verify_idx = NULL;
 	int verify_num = 0;
+	struct serverid_key *verify_keys = NULL;
+	TDB_DATA *verify_tdbkeys = NULL;
 	int t, idx;
 	bool result = false;
 	struct db_context *db;
@@ -352,29 +374,46 @@ bool serverids_exist(const struct server_id *ids, int num_ids, bool *results)
 		}
 	}
 
-	for (t=0; t<verify_num; t++) {
-		struct serverid_exists_state state;
-		struct serverid_key key;
-		TDB_DATA tdbkey;
-		NTSTATUS status;
+	if (verify_num > 0) {
+		struct serverids_exist_state state;
 
-		idx = verify_idx[t];
+		verify_keys = talloc_array(talloc_tos(), struct serverid_key,
+					   verify_num);
+		if (verify_keys == NULL) {
+			goto fail;
+		}
+		verify_tdbkeys = talloc_array(talloc_tos(), TDB_DATA,
+					      verify_num);
+		if (verify_tdbkeys == NULL) {
+			goto fail;
+		}
 
-		serverid_fill_key(&ids[idx], &key);
-		tdbkey = make_tdb_data((uint8_t *)&key, sizeof(key));
+		for (t=0; t<verify_num; t++) {
+			idx = verify_idx[t];
 
-		state.id = &ids[idx];
-		state.exists = false;
-		status = dbwrap_parse_record(db, tdbkey, server_exists_parse, &state);
-		if (!NT_STATUS_IS_OK(status)) {
+			serverid_fill_key(&ids[idx], &verify_keys[t]);
+			verify_tdbkeys[t] = make_tdb_data(
+				(uint8_t *)&verify_keys[t],
+				sizeof(verify_keys[t]));
 			results[idx] = false;
-			continue;
 		}
-		results[idx] = state.exists;
+
+		state.ids = ids;
+		state.verify_idx = verify_idx;
+		state.results = results;
+
+		/*
+		 * Records that can't be found or read leave results[]
+		 * at false.
+		 */
+		dbwrap_parse_records(db, verify_tdbkeys, verify_num,
+				     serverids_exist_parse, &state);
 	}
 
 	result = true;
 fail:
+	TALLOC_FREE(verify_tdbkeys);
+	TALLOC_FREE(verify_keys);
 	TALLOC_FREE(verify_idx);
 	TALLOC_FREE(remote_idx);
 	TALLOC_FREE(todo_results);
@@ -0,0 +1,749 @@
+/*
+ * Unix SMB/CIFS implementation.
+ * Copyright (C) The Samba Team 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "replace.h"
+#include "shm_msg.h"
+#include "system/select.h"
+#include "system/filesys.h"
+#include "system/threads.h"
+#include "dlinklist.h"
+#include <sys/mman.h>
+
+/*
+ * The ring is a multi-producer, single-consumer queue of variable sized
+ * records. "head" and "tail" are byte positions that only ever grow, the
+ * offset into data[] is the position modulo the ring size.
+ *
+ * A producer reserves [tail, tail+extent) under "tail_lock", a robust
+ * process-shared mutex. With the lock held it writes the record header,
+ * including its pid as "sender", and only then moves tail. After
+ * dropping the lock it copies the data and finally sets "state" to
+ * SHM_MSG_REC_DATA. A record never wraps around the end of the ring. If
+ * the space up to the end of the ring is too small, the same reservation
+ * also covers a SHM_MSG_REC_PAD record filling it up.
+ *
+ * The lock is only held for a few stores, the copy runs in parallel.
+ * If a producer dies while holding it, the next one gets EOWNERDEAD.
+ * As tail was not moved yet, nothing the dead producer wrote is visible
+ * to the consumer, so there is nothing to repair.
+ *
+ * The consumer looks at the record at head. If it is committed, the
+ * consumer copies the data out, zeroes the whole record and advances
+ * head. A record with state==SHM_MSG_REC_EMPTY is one that is still
+ * being written. Every record below tail has a valid header, so if the
+ * sender died before committing, the consumer can skip the record.
+ *
+ * Wakeup: Before the consumer goes back to its event loop it sets
+ * "idle" and checks the ring once more. A producer that has committed a
+ * record clears "idle", and if it was set, writes a byte into the
+ * doorbell fifo. This is the same handshake that a futex based
+ * lock/unlock does, only that the consumer sleeps in poll(2) on the fifo
+ * instead of in futex(2), so the ring integrates with any event loop.
+ * An eventfd would do as well as the fifo, but eventfds can't be
+ * opened by other processes without passing them.
+ */
+
+#define SHM_MSG_MAGIC 0x53484d31 /* "SHM1" */
+#define SHM_MSG_ALIGN 16
+#define SHM_MSG_ALIGN_UP(x) (((x) + SHM_MSG_ALIGN - 1) & ~(SHM_MSG_ALIGN - 1))
+
+#define SHM_MSG_MIN_RING 4096
+#define SHM_MSG_MAX_RING (1U<<30)
+
+/*
+ * Number of peer rings we keep mapped
+ */
+#define SHM_MSG_MAX_PEERS 64
+
+/*
+ * Don't starve other event sources while a storm of messages comes in
+ */
+#define SHM_MSG_MAX_BATCH 256
+
+enum shm_msg_rec_state {
+	SHM_MSG_REC_EMPTY = 0,
+	SHM_MSG_REC_DATA = 1,
+	SHM_MSG_REC_PAD = 2
+};
+
+struct shm_msg_rec {
+	uint32_t state;
+	uint32_t extent;	/* header + data, aligned */
+	uint32_t sender;	/* pid */
+	uint32_t msglen;
+};
+
+struct shm_msg_ring {
+	uint32_t magic;
+	uint32_t alive;
+	uint64_t size;
+	uint32_t owner;
+	uint32_t idle;
+	uint8_t pad1[40];
+
+	/* protects reserving space, see above */
+	union {
+		pthread_mutex_t mutex;
+		uint8_t pad[64];
+	} tail_lock;
+
+	/* written by the consumer */
+	uint64_t head;
+	uint8_t pad2[56];
+
+	/* written by the producers */
+	uint64_t tail;
+	uint8_t pad3[56];
+
+	uint8_t data[];
+};
+
+struct shm_msg_peer {
+	struct shm_msg_peer *prev, *next;
+	struct shm_msg_ring *ring;
+	uint64_t size;
+	size_t maplen;
+	dev_t dev;
+	ino_t ino;
+	int bell_fd;
+	char path[];
+};
+
+struct shm_msg_ctx {
+	struct shm_msg_ring *ring;
+	uint64_t size;
+	size_t maplen;
+	pid_t created_pid;
+
+	int bell_fd;
+	const struct poll_funcs *ev_funcs;
+	struct poll_watch *bell_watch;
+
+	void (*recv_callback)(struct shm_msg_ctx *ctx,
+			      uint8_t *msg, size_t msg_len,
+			      void *private_data);
+	void *private_data;
+
+	struct shm_msg_peer *peers;
+	unsigned num_peers;
+
+	char *bell_path;
+	char path[];
+};
+
+static void shm_msg_bell_handler(struct poll_watch *w, int fd, short events,
+				 void *private_data);
+static void shm_msg_peer_free(struct shm_msg_ctx *ctx,
+			      struct shm_msg_peer *peer);
+
+static int shm_msg_bell_name(char *buf, size_t buflen, const char *path)
+{
+	int ret;
+
+	ret = snprintf(buf, buflen, "%s.bell", path);
+	if ((ret < 0) || ((size_t)ret >= buflen)) {
+		return ENAMETOOLONG;
+	}
+	return 0;
+}
+
+static int shm_msg_tail_lock_init(struct shm_msg_ring *ring)
+{
+#ifdef HAVE_ROBUST_MUTEXES
+	pthread_mutexattr_t ma;
+	int ret;
+
+	ret = pthread_mutexattr_init(&ma);
+	if (ret != 0) {
+		return ret;
+	}
+	ret = pthread_mutexattr_setpshared(&ma, PTHREAD_PROCESS_SHARED);
+	if (ret != 0) {
+		goto fail;
+	}
+	ret = pthread_mutexattr_setrobust(&ma, PTHREAD_MUTEX_ROBUST);
+	if (ret != 0) {
+		goto fail;
+	}
+	ret = pthread_mutex_init(&ring->tail_lock.mutex, &ma);
+fail:
+	pthread_mutexattr_destroy(&ma);
+	return ret;
+#else
+	return ENOSYS;
+#endif
+}
+
+static int shm_msg_tail_lock(struct shm_msg_ring *ring)
+{
+	int ret;
+
+	ret = pthread_mutex_lock(&ring->tail_lock.mutex);
+#ifdef HAVE_ROBUST_MUTEXES
+	if (ret == EOWNERDEAD) {
+		/*
+		 * The holder died before moving tail, nothing to clean up
+		 */
+		ret = pthread_mutex_consistent(&ring->tail_lock.mutex);
+	}
+#endif
+	return ret;
+}
+
+int shm_msg_init(const char *path,
+		 const struct poll_funcs *ev_funcs,
+		 size_t ring_size,
+		 void (*recv_callback)(struct shm_msg_ctx *ctx,
+				       uint8_t *msg, size_t msg_len,
+				       void *private_data),
+		 void *private_data,
+		 struct shm_msg_ctx **result)
+{
+	struct shm_msg_ctx *ctx;
+	struct shm_msg_ring *ring;
+	size_t pathlen, bell_len, maplen;
+	uint64_t size;
+	int fd, ret;
+
+	size = SHM_MSG_MIN_RING;
+	while (size < ring_size) {
+		if (size >= SHM_MSG_MAX_RING) {
+			return EINVAL;
+		}
+		size *= 2;
+	}
+	maplen = sizeof(struct shm_msg_ring) + size;
+
+	pathlen = strlen(path) + 1;
+	bell_len = pathlen + strlen(".bell");
+
+	ctx = malloc(offsetof(struct shm_msg_ctx, path) + pathlen + bell_len);
+	if (ctx == NULL) {
+		return ENOMEM;
+	}
+	*ctx = (struct shm_msg_ctx) {
+		.size = size,
+		.maplen = maplen,
+		.created_pid = (pid_t)-1,
+		.bell_fd = -1,
+		.ev_funcs = ev_funcs,
+		.recv_callback = recv_callback,
+		.private_data = private_data
+	};
+	memcpy(ctx->path, path, pathlen);
+	ctx->bell_path = ctx->path + pathlen;
+	shm_msg_bell_name(ctx->bell_path, bell_len, path);
+
+	/*
+	 * O_EXCL gives us the same semantics as bind(2) for unix_msg: The
+	 * caller has to remove stale rings.
+	 */
+	fd = open(ctx->path, O_RDWR|O_CREAT|O_EXCL|O_CLOEXEC, 0600);
+	if (fd == -1) {
+		ret = errno;
+		free(ctx);
+		return ret;
+	}
+	ctx->created_pid = getpid();
+
+	ret = ftruncate(fd, maplen);
+	if (ret == -1) {
+		ret = errno;
+		close(fd);
+		goto fail_unlink;
+	}
+
+	ring = mmap(NULL, maplen, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	ret = errno;
+	close(fd);
+	if (ring == MAP_FAILED) {
+		goto fail_unlink;
+	}
+	ctx->ring = ring;
+
+	ring->magic = SHM_MSG_MAGIC;
+	ring->size = size;
+	ring->owner = ctx->created_pid;
+	ring->idle = 1;		/* we're not looking yet */
+
+	ret = shm_msg_tail_lock_init(ring);
+	if (ret != 0) {
+		goto fail_unmap;
+	}
+
+	/*
+	 * We own the ring name, so a leftover doorbell is stale
+	 */
+	unlink(ctx->bell_path);
+
+	ret = mkfifo(ctx->bell_path, 0600);
+	if (ret == -1) {
+		ret = errno;
+		goto fail_unmap;
+	}
+
+	/*
+	 * O_RDWR: We are a writer ourselves, so we never see EOF and
+	 * senders can open with O_NONBLOCK.
+	 */
+	ctx->bell_fd = open(ctx->bell_path, O_RDWR|O_NONBLOCK|O_CLOEXEC);
+	if (ctx->bell_fd == -1) {
+		ret = errno;
+		goto fail_unlink_bell;
+	}
+
+	ctx->bell_watch = ev_funcs->watch_new(ev_funcs, ctx->bell_fd, POLLIN,
+					      shm_msg_bell_handler, ctx);
+	if (ctx->bell_watch == NULL) {
+		ret = ENOMEM;
+		goto fail_close_bell;
+	}
+
+	__atomic_store_n(&ring->alive, 1, __ATOMIC_RELEASE);
+
+	*result = ctx;
+	return 0;
+
+fail_close_bell:
+	close(ctx->bell_fd);
+fail_unlink_bell:
+	unlink(ctx->bell_path);
+fail_unmap:
+	munmap(ctx->ring, maplen);
+fail_unlink:
+	unlink(ctx->path);
+	free(ctx);
+	return ret;
+}
+
+static bool shm_msg_pid_dead(uint32_t pid)
+{
+	int ret;
+
+	ret = kill(pid, 0);
+	return ((ret == -1) && (errno == ESRCH));
+}
+
+static int shm_msg_peer_open(struct shm_msg_ctx *ctx, const char *path,
+			     struct shm_msg_peer **result)
+{
+	struct shm_msg_peer *peer;
+	struct shm_msg_ring *ring;
+	char bell_path[PATH_MAX];
+	size_t pathlen = strlen(path) + 1;
+	struct stat st;
+	uint64_t size;
+	int fd, ret;
+
+	ret = shm_msg_bell_name(bell_path, sizeof(bell_path), path);
+	if (ret != 0) {
+		return ret;
+	}
+
+	fd = open(path, O_RDWR|O_CLOEXEC);
+	if (fd == -1) {
+		return errno;
+	}
+
+	ret = fstat(fd, &st);
+	if (ret == -1) {
+		ret = errno;
+		close(fd);
+		return ret;
+	}
+	if ((uint64_t)st.st_size <
+	    sizeof(struct shm_msg_ring) + SHM_MSG_MIN_RING) {
+		/* Not yet initialized or not a ring at all */
+		close(fd);
+		return ENOENT;
+	}
+
+	ring = mmap(NULL, st.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	ret = errno;
+	close(fd);
+	if (ring == MAP_FAILED) {
+		return ret;
+	}
+
+	size = ring->size;
+
+	if ((__atomic_load_n(&ring->alive, __ATOMIC_ACQUIRE) == 0) ||
+	    (ring->magic != SHM_MSG_MAGIC) ||
+	    ((size & (size - 1)) != 0) ||
+	    (sizeof(struct shm_msg_ring) + size != (uint64_t)st.st_size) ||
+	    shm_msg_pid_dead(ring->owner)) {
+		munmap(ring, st.st_size);
+		return ENOENT;
+	}
+
+	peer = malloc(offsetof(struct shm_msg_peer, path) + pathlen);
+	if (peer == NULL) {
+		munmap(ring, st.st_size);
+		return ENOMEM;
+	}
+	*peer = (struct shm_msg_peer) {
+		.ring = ring,
+		.size = size,
+		.maplen = st.st_size,
+		.dev = st.st_dev,
+		.ino = st.st_ino
+	};
+	memcpy(peer->path, path, pathlen);
+
+	peer->bell_fd = open(bell_path, O_WRONLY|O_NONBLOCK|O_CLOEXEC);
+	if (peer->bell_fd == -1) {
+		ret = errno;
+		munmap(ring, peer->maplen);
+		free(peer);
+		return (ret == ENXIO) ? EPIPE : ret;
+	}
+
+	if (ctx->num_peers >= SHM_MSG_MAX_PEERS) {
+		shm_msg_peer_free(ctx, DLIST_TAIL(ctx->peers));
+	}
+	DLIST_ADD(ctx->peers, peer);
+	ctx->num_peers += 1;
+
+	*result = peer;
+	return 0;
+}
+
+static void shm_msg_peer_free(struct shm_msg_ctx *ctx,
+			      struct shm_msg_peer *peer)
+{
+	DLIST_REMOVE(ctx->peers, peer);
+	ctx->num_peers -= 1;
+	close(peer->bell_fd);
+	munmap(peer->ring, peer->maplen);
+	free(peer);
+}
+
+static int shm_msg_peer_get(struct shm_msg_ctx *ctx, const char *path,
+			    struct shm_msg_peer **result)
+{
+	struct shm_msg_peer *peer;
+
+	for (peer = ctx->peers; peer != NULL; peer = peer->next) {
+		if (strcmp(peer->path, path) == 0) {
+			break;
+		}
+	}
+
+	if (peer != NULL) {
+		struct stat st;
+		int ret;
+
+		/*
+		 * A crashed owner does not clear "alive". The ring is
+		 * unlinked by messaging_dgm_cleanup, and its pid might
+		 * have been reused by a process with a new ring. Make
+		 * sure the mapping still is the ring at "path" and that
+		 * its owner is around.
+		 */
+		ret = stat(path, &st);
+		if ((ret == 0) &&
+		    (st.st_dev == peer->dev) && (st.st_ino == peer->ino) &&
+		    (__atomic_load_n(&peer->ring->alive,
+				     __ATOMIC_ACQUIRE) != 0) &&
+		    !shm_msg_pid_dead(peer->ring->owner)) {
+			DLIST_PROMOTE(ctx->peers, peer);
+			*result = peer;
+			return 0;
+		}
+		shm_msg_peer_free(ctx, peer);
+	}
+
+	return shm_msg_peer_open(ctx, path, result);
+}
+
+static int shm_msg_post(struct shm_msg_peer *peer,
+			const struct iovec *iov, int iovlen, size_t msglen)
+{
+	struct shm_msg_ring *ring = peer->ring;
+	uint64_t mask = peer->size - 1;
+	uint32_t extent;
+	uint64_t head, tail, new_tail, pos;
+	size_t pad;
+	struct shm_msg_rec *rec;
+	uint8_t *p;
+	uint32_t me = getpid();
+	size_t to_end;
+	int i, ret;
+
+	extent = SHM_MSG_ALIGN_UP(sizeof(struct shm_msg_rec) + msglen);
+
+	ret = shm_msg_tail_lock(ring);
+	if (ret != 0) {
+		return ret;
+	}
+
+	tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+	to_end = peer->size - (tail & mask);
+
+	pad = (to_end < extent) ? to_end : 0;
+	new_tail = tail + pad + extent;
+
+	head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	if (new_tail - head > peer->size) {
+		pthread_mutex_unlock(&ring->tail_lock.mutex);
+		return ENOSPC;
+	}
+
+	pos = tail;
+
+	if (pad != 0) {
+		rec = (struct shm_msg_rec *)(ring->data + (pos & mask));
+		rec->extent = pad;
+		rec->msglen = 0;
+		rec->sender = me;
+		rec->state = SHM_MSG_REC_PAD;
+		pos += pad;
+	}
+
+	rec = (struct shm_msg_rec *)(ring->data + (pos & mask));
+	rec->extent = extent;
+	rec->msglen = msglen;
+	rec->sender = me;
+	rec->state = SHM_MSG_REC_EMPTY;
+
+	/*
+	 * Publish the headers. From here on the consumer can skip our
+	 * record should we die before committing it.
+	 */
+	__atomic_store_n(&ring->tail, new_tail, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&ring->tail_lock.mutex);
+
+	p = (uint8_t *)(rec + 1);
+	for (i=0; i<iovlen; i++) {
+		memcpy(p, iov[i].iov_base, iov[i].iov_len);
+		p += iov[i].iov_len;
+	}
+
+	/*
+	 * seq_cst pairs with the consumer's store to "idle" followed by
+	 * its load of "state"
+	 */
+	__atomic_store_n(&rec->state, SHM_MSG_REC_DATA, __ATOMIC_SEQ_CST);
+
+	if (__atomic_exchange_n(&ring->idle, 0, __ATOMIC_SEQ_CST) != 0) {
+		uint8_t c = 0;
+		ssize_t written;
+
+		written = write(peer->bell_fd, &c, sizeof(c));
+		if ((written == -1) && (errno == EPIPE)) {
+			return EPIPE;
+		}
+		/*
+		 * EAGAIN means the fifo is full of wakeups already
+		 */
+	}
+
+	return 0;
+}
+
+int shm_msg_send(struct shm_msg_ctx *ctx, const char *dst_path,
+		 const struct iovec *iov, int iovlen)
+{
+	struct shm_msg_peer *peer;
+	size_t msglen = 0;
+	int i, ret;
+
+	for (i=0; i<iovlen; i++) {
+		msglen += iov[i].iov_len;
+		if (msglen < iov[i].iov_len) {
+			return EMSGSIZE;
+		}
+	}
+
+	ret = shm_msg_peer_get(ctx, dst_path, &peer);
+	if (ret != 0) {
+		return ret;
+	}
+
+	if (msglen > peer->size / 4) {
+		return EMSGSIZE;
+	}
+
+	ret = shm_msg_post(peer, iov, iovlen, msglen);
+	if (ret == EPIPE) {
+		shm_msg_peer_free(ctx, peer);
+	}
+	return ret;
+}
+
+/*
+ * Deliver the record at head. Returns false if there is nothing to
+ * deliver (yet).
+ */
+static bool shm_msg_recv_one(struct shm_msg_ctx *ctx)
+{
+	struct shm_msg_ring *ring = ctx->ring;
+	uint64_t mask = ctx->size - 1;
+	uint64_t head, tail;
+	struct shm_msg_rec *rec;
+	uint32_t state, extent, msglen;
+	uint64_t stackbuf[128];
+	uint8_t *buf = NULL;
+
+	head = ring->head;
+	tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	if (head == tail) {
+		return false;
+	}
+
+	rec = (struct shm_msg_rec *)(ring->data + (head & mask));
+
+	state = __atomic_load_n(&rec->state, __ATOMIC_SEQ_CST);
+	if (state == SHM_MSG_REC_EMPTY) {
+		if (!shm_msg_pid_dead(rec->sender)) {
+			/* still being written */
+			return false;
+		}
+		/*
+		 * The sender died between reserving and committing,
+		 * skip the record.
+		 */
+	}
+
+	extent = rec->extent;
+	msglen = rec->msglen;
+
+	if ((extent < sizeof(struct shm_msg_rec)) ||
+	    (extent % SHM_MSG_ALIGN != 0) ||
+	    (extent > ctx->size - (head & mask)) ||
+	    (msglen > extent - sizeof(struct shm_msg_rec))) {
+		/*
+		 * Corrupt ring. Tell senders to go elsewhere.
+		 */
+		__atomic_store_n(&ring->alive, 0, __ATOMIC_RELEASE);
+		return false;
+	}
+
+	if (state == SHM_MSG_REC_DATA) {
+		buf = (uint8_t *)stackbuf;
+		if (msglen > sizeof(stackbuf)) {
+			buf = malloc(msglen);
+		}
+		if (buf != NULL) {
+			memcpy(buf, rec + 1, msglen);
+		}
+	}
+
+	/*
+	 * Copy out before we free the space: The callback might run a
+	 * nested event loop that comes back here.
+	 */
+	memset(rec, 0, extent);
+	__atomic_store_n(&ring->head, head + extent, __ATOMIC_RELEASE);
+
+	if (buf != NULL) {
+		ctx->recv_callback(ctx, buf, msglen, ctx->private_data);
+		if (buf != (uint8_t *)stackbuf) {
+			free(buf);
+		}
+	}
+
+	return true;
+}
+
+static bool shm_msg_pending(struct shm_msg_ctx *ctx)
+{
+	struct shm_msg_ring *ring = ctx->ring;
+	uint64_t mask = ctx->size - 1;
+	uint64_t head = ring->head;
+	struct shm_msg_rec *rec;
+
+	if (head == __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST)) {
+		return false;
+	}
+	rec = (struct shm_msg_rec *)(ring->data + (head & mask));
+	return (__atomic_load_n(&rec->state, __ATOMIC_SEQ_CST) !=
+		SHM_MSG_REC_EMPTY);
+}
+
+static void shm_msg_consume(struct shm_msg_ctx *ctx, unsigned max_batch)
+{
+	struct shm_msg_ring *ring = ctx->ring;
+	unsigned received = 0;
+
+	while (true) {
+		while (shm_msg_recv_one(ctx)) {
+			received += 1;
+			if (received >= max_batch) {
+				uint8_t c = 0;
+				/*
+				 * Come back via the event loop. Stay
+				 * non-idle, senders don't need to ring.
+				 */
+				(void)write(ctx->bell_fd, &c, sizeof(c));
+				return;
+			}
+		}
+
+		__atomic_store_n(&ring->idle, 1, __ATOMIC_SEQ_CST);
+
+		if (!shm_msg_pending(ctx)) {
+			break;
+		}
+		__atomic_store_n(&ring->idle, 0, __ATOMIC_SEQ_CST);
+	}
+}
+
+static void shm_msg_bell_handler(struct poll_watch *w, int fd, short events,
+				 void *private_data)
+{
+	struct shm_msg_ctx *ctx = (struct shm_msg_ctx *)private_data;
+	uint8_t buf[64];
+	ssize_t nread;
+
+	do {
+		nread = read(fd, buf, sizeof(buf));
+	} while (nread == sizeof(buf));
+
+	shm_msg_consume(ctx, SHM_MSG_MAX_BATCH);
+}
+
+void shm_msg_drain(struct shm_msg_ctx *ctx)
+{
+	shm_msg_consume(ctx, UINT_MAX);
+}
+
+int shm_msg_free(struct shm_msg_ctx *ctx)
+{
+	while (ctx->peers != NULL) {
+		shm_msg_peer_free(ctx, ctx->peers);
+	}
+
+	ctx->ev_funcs->watch_free(ctx->bell_watch);
+
+	if (getpid() == ctx->created_pid) {
+		/*
+		 * If we created it, tell cached senders and unlink.
+		 * Otherwise we're a forked child, the parent still uses
+		 * it.
+		 */
+		__atomic_store_n(&ctx->ring->alive, 0, __ATOMIC_RELEASE);
+		unlink(ctx->bell_path);
+		unlink(ctx->path);
+	}
+
+	close(ctx->bell_fd);
+	munmap(ctx->ring, ctx->maplen);
+	free(ctx);
+	return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Unix SMB/CIFS implementation.
+ * Copyright (C) The Samba Team 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SHM_MSG_H__
+#define __SHM_MSG_H__
+
+#include "replace.h"
+#include "poll_funcs/poll_funcs.h"
+#include "system/network.h"
+
+/**
+ * @file shm_msg.h
+ *
+ * @brief Send small messages through per-process shared memory rings
+ *
+ * A shm_msg_ctx owns a ring buffer in a file mapped with MAP_SHARED and a
+ * fifo used as a doorbell. Any process that can open the files can post
+ * messages into the ring, the owner is the only consumer.
+ *
+ * Sending a message into a ring that the sender has seen before does not
+ * wake up the receiver: Space is reserved under a robust process-shared
+ * mutex, the data is copied and the record is marked committed. Only if
+ * the consumer announced that it is about to sleep, the sender writes a
+ * byte into the doorbell fifo. A burst of messages thus costs the
+ * receiver one read(2) instead of one per message. The sender checks
+ * with stat(2) and kill(2) that the ring it has mapped still belongs to
+ * the living receiver, so a crashed receiver or a reused pid is noticed.
+ *
+ * Without robust mutexes shm_msg_init fails with ENOSYS.
+ *
+ * Unlike unix_msg this does not do fragmentation and fd-passing. If a
+ * message does not fit, shm_msg_send returns an error and the caller is
+ * expected to fall back to unix_msg:
+ *
+ * - ENOENT: The destination does not have a ring
+ * - EMSGSIZE: The message is larger than a quarter of the ring
+ * - ENOSPC: The ring is full, the receiver is not keeping up
+ * - EPIPE: The receiver is gone
+ *
+ * Messages from one sender to one receiver are delivered in order. There
+ * is no ordering across senders.
+ */
+
+/**
+ * @brief Abstract structure representing a shm ring
+ */
+struct shm_msg_ctx;
+
+/**
+ * @brief Initialize a struct shm_msg_ctx
+ *
+ * @param[in] path The ring file, the doorbell is "path.bell"
+ * @param[in] ev_funcs The event callback functions to use
+ * @param[in] ring_size Size of the ring, rounded up to a power of two
+ * @param[in] recv_callback Function called when a message is received
+ * @param[in] private_data Private pointer for recv_callback
+ * @param[out] result The new struct shm_msg_ctx
+ * @return 0 on success, errno on failure
+ */
+int shm_msg_init(const char *path,
+		 const struct poll_funcs *ev_funcs,
+		 size_t ring_size,
+		 void (*recv_callback)(struct shm_msg_ctx *ctx,
+				       uint8_t *msg, size_t msg_len,
+				       void *private_data),
+		 void *private_data,
+		 struct shm_msg_ctx **result);
+
+/**
+ * @brief Send a message
+ *
+ * @param[in] ctx The context to send from
+ * @param[in] dst_path The destination ring path
+ * @param[in] iov The message
+ * @param[in] iovlen The number of iov structs
+ * @return 0 on success, errno on failure
+ */
+int shm_msg_send(struct shm_msg_ctx *ctx, const char *dst_path,
+		 const struct iovec *iov, int iovlen);
+
+/**
+ * @brief Deliver all messages currently in our ring
+ *
+ * This is used to keep ordering with messages arriving through a
+ * different transport: A sender that falls back to unix_msg has posted
+ * its earlier messages into the ring before, so draining the ring before
+ * dispatching the unix_msg message preserves the sender's order.
+ *
+ * @param[in] ctx The context to drain
+ */
+void shm_msg_drain(struct shm_msg_ctx *ctx);
+
+/**
+ * @brief Free a shm_msg_ctx
+ *
+ * The ring and doorbell files are removed if called by the process that
+ * created them.
+ *
+ * @param[in] ctx The message context to free
+ * @return 0 on success, errno on failure
+ */
+int shm_msg_free(struct shm_msg_ctx *ctx);
+
+#endif
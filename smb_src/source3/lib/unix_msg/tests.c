@@ -1,5 +1,8 @@
 #include "replace.h"
+#include "system/time.h"
+#include "system/wait.h"
 #include "unix_msg.h"
+#include "shm_msg.h"
 #include "poll_funcs/poll_funcs_tevent.h"
 #include "tevent.h"
 
@@ -13,6 +16,11 @@ static void recv_cb(struct unix_msg_ctx *ctx,
 		    uint8_t *msg, size_t msg_len,
 		    int *fds, size_t num_fds,
 		    void *private_data);
+static void shm_recv_cb(struct shm_msg_ctx *ctx,
+			uint8_t *msg, size_t msg_len,
+			void *private_data);
+static int test_shm(struct tevent_context *ev, struct poll_funcs *funcs);
+static int bench_transports(void);
 
 static void expect_messages(struct tevent_context *ev, struct cb_state *state,
 			    unsigned num_msgs)
@@ -217,11 +225,17 @@ int main(void)
 
 	unix_msg_free(ctx1);
 	unix_msg_free(ctx2);
+
+	ret = test_shm(ev, funcs);
+	if (ret != 0) {
+		return ret;
+	}
+
 	talloc_free(tevent_handle);
 	talloc_free(funcs);
 	talloc_free(ev);
 
-	return 0;
+	return bench_transports();
 }
 
 static void recv_cb(struct unix_msg_ctx *ctx,
@@ -242,3 +256,589 @@ static void recv_cb(struct unix_msg_ctx *ctx,
 	}
 	state->num_received += 1;
 }
+
+static void shm_recv_cb(struct shm_msg_ctx *ctx,
+			uint8_t *msg, size_t msg_len,
+			void *private_data)
+{
+	recv_cb(NULL, msg, msg_len, NULL, 0, private_data);
+}
+
+/*
+ * A child creates "shm1" and exits without cleaning up, the way a
+ * crashed smbd does. Once the ring is replaced by a new process with
+ * the same name, messages must not go into the stale mapping.
+ */
+static int test_shm_crashed_peer(struct tevent_context *ev,
+				 struct poll_funcs *funcs,
+				 struct shm_msg_ctx *ctx,
+				 struct cb_state *state)
+{
+	struct shm_msg_ctx *new_ctx;
+	int ready[2], done[2];
+	pid_t child;
+	char c = 0;
+	int ret, status;
+
+	if ((pipe(ready) == -1) || (pipe(done) == -1)) {
+		perror("pipe failed");
+		return 1;
+	}
+
+	child = fork();
+	if (child == -1) {
+		perror("fork failed");
+		return 1;
+	}
+	if (child == 0) {
+		struct shm_msg_ctx *child_ctx;
+
+		close(ready[0]);
+		close(done[1]);
+
+		ret = shm_msg_init("shm1", funcs, 8192, shm_recv_cb, state,
+				   &child_ctx);
+		if (ret != 0) {
+			_exit(1);
+		}
+		(void)write(ready[1], &c, 1);
+		(void)read(done[0], &c, 1);
+		_exit(0);
+	}
+	close(ready[1]);
+	close(done[0]);
+
+	if (read(ready[0], &c, 1) != 1) {
+		fprintf(stderr, "child failed to create its ring\n");
+		return 1;
+	}
+	close(ready[0]);
+
+	ret = shm_msg_send(ctx, "shm1", NULL, 0);
+	if (ret != 0) {
+		fprintf(stderr, "shm_msg_send failed: %s\n", strerror(ret));
+		return 1;
+	}
+
+	close(done[1]);
+	if ((waitpid(child, &status, 0) != child) ||
+	    !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+		fprintf(stderr, "child failed\n");
+		return 1;
+	}
+
+	ret = shm_msg_send(ctx, "shm1", NULL, 0);
+	if (ret != ENOENT) {
+		fprintf(stderr, "shm_msg_send returned %s, expected "
+			"ENOENT\n", strerror(ret));
+		return 1;
+	}
+
+	unlink("shm1");
+	ret = shm_msg_init("shm1", funcs, 8192, shm_recv_cb, state,
+			   &new_ctx);
+	if (ret != 0) {
+		fprintf(stderr, "shm_msg_init failed: %s\n", strerror(ret));
+		return 1;
+	}
+
+	state->buf = NULL;
+	state->buflen = 0;
+
+	ret = shm_msg_send(ctx, "shm1", NULL, 0);
+	if (ret != 0) {
+		fprintf(stderr, "shm_msg_send failed: %s\n", strerror(ret));
+		return 1;
+	}
+	expect_messages(ev, state, 1);
+
+	shm_msg_free(new_ctx);
+	return 0;
+}
+
+static int test_shm(struct tevent_context *ev, struct poll_funcs *funcs)
+{
+	struct shm_msg_ctx *ctx1, *ctx2;
+	struct cb_state state;
+	struct iovec iov;
+	static uint8_t buf[1755];
+	int i, ret;
+
+	unlink("shm1");
+	unlink("shm2");
+
+	ret = shm_msg_init("shm1", funcs, 8192, shm_recv_cb, &state, &ctx1);
+	if (ret != 0) {
+		fprintf(stderr, "shm_msg_init failed: %s\n", strerror(ret));
+		return 1;
+	}
+
+	ret = shm_msg_init("shm1", funcs, 8192, shm_recv_cb, &state, &ctx1);
+	if (ret != EEXIST) {
+		fprintf(stderr, "shm_msg_init returned %s, expected "
+			"EEXIST\n", strerror(ret));
+		return 1;
+	}
+
+	ret = shm_msg_init("shm2", funcs, 8192, shm_recv_cb, &state, &ctx2);
+	if (ret != 0) {
+		fprintf(stderr, "shm_msg_init failed: %s\n", strerror(ret));
+		return 1;
+	}
+
+	printf("shm: sending to a nonexisting ring\n");
+
+	ret = shm_msg_send(ctx1, "shm3", NULL, 0);
+	if (ret != ENOENT) {
+		fprintf(stderr, "shm_msg_send returned %s, expected "
+			"ENOENT\n", strerror(ret));
+		return 1;
+	}
+
+	printf("shm: sending a 0-length message\n");
+
+	state.buf = NULL;
+	state.buflen = 0;
+
+	ret = shm_msg_send(ctx1, "shm2", NULL, 0);
+	if (ret != 0) {
+		fprintf(stderr, "shm_msg_send failed: %s\n", strerror(ret));
+		return 1;
+	}
+	expect_messages(ev, &state, 1);
+
+	printf("shm: sending a message too large for the ring\n");
+
+	for (i=0; i<sizeof(buf); i++) {
+		buf[i] = random();
+	}
+	iov = (struct iovec) { .iov_base = buf, .iov_len = sizeof(buf) };
+
+	ret = shm_msg_send(ctx1, "shm2", &iov, 1);
+	if (ret != 0) {
+		fprintf(stderr, "shm_msg_send failed: %s\n", strerror(ret));
+		return 1;
+	}
+	state.buf = buf;
+	state.buflen = sizeof(buf);
+	expect_messages(ev, &state, 1);
+
+	iov.iov_len = 8192/4 + 1;
+	ret = shm_msg_send(ctx1, "shm2", &iov, 1);
+	if (ret != EMSGSIZE) {
+		fprintf(stderr, "shm_msg_send returned %s, expected "
+			"EMSGSIZE\n", strerror(ret));
+		return 1;
+	}
+
+	printf("shm: filling the ring, wrapping around\n");
+
+	iov.iov_len = sizeof(buf);
+	for (i=0; i<4; i++) {
+		ret = shm_msg_send(ctx2, "shm1", &iov, 1);
+		if (ret != 0) {
+			fprintf(stderr, "shm_msg_send failed: %s\n",
+				strerror(ret));
+			return 1;
+		}
+	}
+	ret = shm_msg_send(ctx2, "shm1", &iov, 1);
+	if (ret != ENOSPC) {
+		fprintf(stderr, "shm_msg_send returned %s, expected "
+			"ENOSPC\n", strerror(ret));
+		return 1;
+	}
+	expect_messages(ev, &state, 4);
+
+	for (i=0; i<20; i++) {
+		ret = shm_msg_send(ctx2, "shm1", &iov, 1);
+		if (ret != 0) {
+			fprintf(stderr, "shm_msg_send failed: %s\n",
+				strerror(ret));
+			return 1;
+		}
+		expect_messages(ev, &state, 1);
+	}
+
+	printf("shm: draining without the event loop\n");
+
+	ret = shm_msg_send(ctx2, "shm1", &iov, 1);
+	if (ret != 0) {
+		fprintf(stderr, "shm_msg_send failed: %s\n", strerror(ret));
+		return 1;
+	}
+	state.num_received = 0;
+	shm_msg_drain(ctx1);
+	if (state.num_received != 1) {
+		fprintf(stderr, "shm_msg_drain delivered %u messages\n",
+			state.num_received);
+		return 1;
+	}
+
+	printf("shm: sending to a freed ring\n");
+
+	shm_msg_free(ctx1);
+
+	ret = shm_msg_send(ctx2, "shm1", &iov, 1);
+	if (ret != ENOENT) {
+		fprintf(stderr, "shm_msg_send returned %s, expected "
+			"ENOENT\n", strerror(ret));
+		return 1;
+	}
+
+	printf("shm: sending to the ring of a crashed process\n");
+
+	ret = test_shm_crashed_peer(ev, funcs, ctx2, &state);
+	if (ret != 0) {
+		return ret;
+	}
+
+	shm_msg_free(ctx2);
+
+	return 0;
+}
+
+/*
+ * Compare unix_msg and shm_msg: A child process echoes every message
+ * back, the parent measures round trip latency (one message in flight)
+ * and throughput (a window of messages in flight).
+ */
+
+#define BENCH_MSGS 20000
+#define BENCH_WINDOW 64
+#define BENCH_MSGLEN 64
+
+struct bench_ctx {
+	const struct bench_transport *t;
+	void *ctx;
+	const char *peer;
+	bool echo;
+	unsigned num_received;
+	bool done;
+};
+
+struct bench_transport {
+	const char *name;
+	const char *paths[2];
+	int (*init)(struct bench_ctx *b, const char *path,
+		    const struct poll_funcs *funcs);
+	int (*send)(struct bench_ctx *b, const struct iovec *iov, int iovlen);
+	void (*free)(struct bench_ctx *b);
+};
+
+static void bench_recv(struct bench_ctx *b, uint8_t *msg, size_t msg_len)
+{
+	b->num_received += 1;
+
+	if (msg_len == 0) {
+		b->done = true;
+		return;
+	}
+	if (b->echo) {
+		struct iovec iov = { .iov_base = msg, .iov_len = msg_len };
+		int ret;
+
+		ret = b->t->send(b, &iov, 1);
+		if (ret != 0) {
+			fprintf(stderr, "%s: echo failed: %s\n", b->t->name,
+				strerror(ret));
+			exit(1);
+		}
+	}
+}
+
+static void bench_unix_msg_recv(struct unix_msg_ctx *ctx,
+				uint8_t *msg, size_t msg_len,
+				int *fds, size_t num_fds,
+				void *private_data)
+{
+	bench_recv((struct bench_ctx *)private_data, msg, msg_len);
+}
+
+static int bench_unix_msg_init(struct bench_ctx *b, const char *path,
+			       const struct poll_funcs *funcs)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct unix_msg_ctx *ctx;
+	int ret;
+
+	strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+	unlink(addr.sun_path);
+
+	ret = unix_msg_init(&addr, funcs, 1024, 1, bench_unix_msg_recv, b,
+			    &ctx);
+	b->ctx = ctx;
+	return ret;
+}
+
+static int bench_unix_msg_send(struct bench_ctx *b,
+			       const struct iovec *iov, int iovlen)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+	strlcpy(addr.sun_path, b->peer, sizeof(addr.sun_path));
+	return unix_msg_send(b->ctx, &addr, iov, iovlen, NULL, 0);
+}
+
+static void bench_unix_msg_free(struct bench_ctx *b)
+{
+	unix_msg_free(b->ctx);
+}
+
+static void bench_shm_msg_recv(struct shm_msg_ctx *ctx,
+			       uint8_t *msg, size_t msg_len,
+			       void *private_data)
+{
+	bench_recv((struct bench_ctx *)private_data, msg, msg_len);
+}
+
+static int bench_shm_msg_init(struct bench_ctx *b, const char *path,
+			      const struct poll_funcs *funcs)
+{
+	struct shm_msg_ctx *ctx;
+	int ret;
+
+	unlink(path);
+
+	ret = shm_msg_init(path, funcs, 256*1024, bench_shm_msg_recv, b,
+			   &ctx);
+	b->ctx = ctx;
+	return ret;
+}
+
+static int bench_shm_msg_send(struct bench_ctx *b,
+			      const struct iovec *iov, int iovlen)
+{
+	return shm_msg_send(b->ctx, b->peer, iov, iovlen);
+}
+
+static void bench_shm_msg_free(struct bench_ctx *b)
+{
+	shm_msg_free(b->ctx);
+}
+
+static const struct bench_transport bench_transports_list[] = {
+	{
+		.name = "unix_msg",
+		.paths = { "bench_sock1", "bench_sock2" },
+		.init = bench_unix_msg_init,
+		.send = bench_unix_msg_send,
+		.free = bench_unix_msg_free,
+	},
+	{
+		.name = "shm_msg",
+		.paths = { "bench_shm1", "bench_shm2" },
+		.init = bench_shm_msg_init,
+		.send = bench_shm_msg_send,
+		.free = bench_shm_msg_free,
+	},
+};
+
+struct bench_env {
+	struct tevent_context *ev;
+	struct poll_funcs *funcs;
+	void *tevent_handle;
+};
+
+static int bench_env_init(struct bench_env *env)
+{
+	env->ev = tevent_context_init(NULL);
+	if (env->ev == NULL) {
+		return ENOMEM;
+	}
+	env->funcs = poll_funcs_init_tevent(env->ev);
+	if (env->funcs == NULL) {
+		return ENOMEM;
+	}
+	env->tevent_handle = poll_funcs_tevent_register(env->ev, env->funcs,
+							env->ev);
+	if (env->tevent_handle == NULL) {
+		return ENOMEM;
+	}
+	return 0;
+}
+
+static void bench_env_free(struct bench_env *env)
+{
+	talloc_free(env->tevent_handle);
+	talloc_free(env->funcs);
+	talloc_free(env->ev);
+}
+
+static void bench_loop_once(struct bench_env *env)
+{
+	int ret;
+
+	ret = tevent_loop_once(env->ev);
+	if (ret == -1) {
+		fprintf(stderr, "tevent_loop_once failed: %s\n",
+			strerror(errno));
+		exit(1);
+	}
+}
+
+static void bench_send(struct bench_env *env, struct bench_ctx *b,
+		       const struct iovec *iov, int iovlen)
+{
+	int ret;
+
+	while (true) {
+		ret = b->t->send(b, iov, iovlen);
+		if (ret != ENOSPC) {
+			break;
+		}
+		bench_loop_once(env);
+	}
+	if (ret != 0) {
+		fprintf(stderr, "%s: send failed: %s\n", b->t->name,
+			strerror(ret));
+		exit(1);
+	}
+}
+
+static double bench_usec(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000.0 +
+		(now.tv_nsec - start->tv_nsec) / 1000.0;
+}
+
+static void bench_echo_child(const struct bench_transport *t, int sync_fd)
+{
+	struct bench_env env;
+	struct bench_ctx b = { .t = t, .peer = t->paths[0], .echo = true };
+	int ret;
+
+	ret = bench_env_init(&env);
+	if (ret != 0) {
+		exit(1);
+	}
+	ret = t->init(&b, t->paths[1], env.funcs);
+	if (ret != 0) {
+		fprintf(stderr, "%s: init failed: %s\n", t->name,
+			strerror(ret));
+		exit(1);
+	}
+
+	(void)write(sync_fd, &ret, 1);
+	close(sync_fd);
+
+	while (!b.done) {
+		bench_loop_once(&env);
+	}
+
+	t->free(&b);
+	bench_env_free(&env);
+	exit(0);
+}
+
+static int bench_transport(const struct bench_transport *t)
+{
+	struct bench_env env;
+	struct bench_ctx b = { .t = t, .peer = t->paths[1] };
+	uint8_t msg[BENCH_MSGLEN] = { 0, };
+	struct iovec iov = { .iov_base = msg, .iov_len = sizeof(msg) };
+	struct timespec start;
+	double latency, elapsed;
+	unsigned i, sent;
+	int sync_fds[2];
+	char c;
+	pid_t child;
+	int ret, status;
+
+	ret = pipe(sync_fds);
+	if (ret == -1) {
+		perror("pipe failed");
+		return 1;
+	}
+
+	fflush(stdout);
+
+	child = fork();
+	if (child == -1) {
+		perror("fork failed");
+		return 1;
+	}
+	if (child == 0) {
+		close(sync_fds[0]);
+		bench_echo_child(t, sync_fds[1]);
+	}
+	close(sync_fds[1]);
+
+	ret = bench_env_init(&env);
+	if (ret != 0) {
+		fprintf(stderr, "bench_env_init failed\n");
+		return 1;
+	}
+	ret = t->init(&b, t->paths[0], env.funcs);
+	if (ret != 0) {
+		fprintf(stderr, "%s: init failed: %s\n", t->name,
+			strerror(ret));
+		return 1;
+	}
+
+	if (read(sync_fds[0], &c, 1) != 1) {
+		fprintf(stderr, "%s: child did not start\n", t->name);
+		return 1;
+	}
+	close(sync_fds[0]);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i=0; i<BENCH_MSGS; i++) {
+		bench_send(&env, &b, &iov, 1);
+		while (b.num_received <= i) {
+			bench_loop_once(&env);
+		}
+	}
+	latency = bench_usec(&start) / BENCH_MSGS;
+
+	b.num_received = 0;
+	sent = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (b.num_received < BENCH_MSGS) {
+		while ((sent < BENCH_MSGS) &&
+		       (sent - b.num_received < BENCH_WINDOW)) {
+			bench_send(&env, &b, &iov, 1);
+			sent += 1;
+		}
+		bench_loop_once(&env);
+	}
+	elapsed = bench_usec(&start);
+
+	printf("%-8s: round trip %6.2f usec, %9.0f msgs/sec "
+	       "(window %u, %u bytes)\n", t->name, latency,
+	       BENCH_MSGS / (elapsed / 1000000.0), BENCH_WINDOW,
+	       BENCH_MSGLEN);
+
+	bench_send(&env, &b, NULL, 0);
+
+	ret = waitpid(child, &status, 0);
+	if ((ret != child) || !WIFEXITED(status) ||
+	    (WEXITSTATUS(status) != 0)) {
+		fprintf(stderr, "%s: child failed\n", t->name);
+		return 1;
+	}
+
+	t->free(&b);
+	bench_env_free(&env);
+	return 0;
+}
+
+static int bench_transports(void)
+{
+	size_t i;
+	int ret;
+
+	printf("Benchmarking %u echoed messages\n", BENCH_MSGS);
+
+	for (i=0; i<ARRAY_SIZE(bench_transports_list); i++) {
+		ret = bench_transport(&bench_transports_list[i]);
+		if (ret != 0) {
+			return ret;
+		}
+	}
+	return 0;
+}
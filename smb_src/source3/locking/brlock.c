@@ -49,9 +49,16 @@ struct byte_range_lock {
 	bool modified;
 	uint32_t num_read_oplocks;
 	struct lock_struct *lock_data;
+	uint64_t *max_end;
 	struct db_record *record;
 };
 
+/*
+ * With more than BRL_INDEX_MIN_LOCKS locks on a file, conflicts are
+ * looked up in an interval tree instead of scanning all locks.
+ */
+#define BRL_INDEX_MIN_LOCKS 16
+
 /****************************************************************************
  Debug info at level 10 for lock struct.
 ****************************************************************************/
@@ -301,6 +308,242 @@ static bool brl_pending_overlap(const struct lock_struct *lock, const struct loc
 	return False;
 }
 
+/****************************************************************************
+ The lock array is stored sorted by start offset. Return the position a
+ lock starting at "start" goes to, behind all locks with the same start.
+****************************************************************************/
+
+static unsigned brl_insert_pos(const struct lock_struct *locks,
+			       unsigned num_locks,
+			       br_off start)
+{
+	unsigned lo = 0;
+	unsigned hi = num_locks;
+
+	while (lo < hi) {
+		unsigned mid = lo + (hi - lo) / 2;
+
+		if (locks[mid].start <= start) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/****************************************************************************
+ Stable insertion sort. Locks are appended in order, so usually there
+ is nothing to move.
+****************************************************************************/
+
+static void brl_sort_locks(struct lock_struct *locks, unsigned num_locks)
+{
+	unsigned i;
+
+	for (i=1; i < num_locks; i++) {
+		struct lock_struct tmp;
+		unsigned pos;
+
+		if (locks[i-1].start <= locks[i].start) {
+			continue;
+		}
+
+		tmp = locks[i];
+		pos = brl_insert_pos(locks, i, tmp.start);
+		memmove(&locks[pos+1], &locks[pos],
+			(i - pos) * sizeof(struct lock_struct));
+		locks[pos] = tmp;
+	}
+}
+
+/****************************************************************************
+ The interval tree is implicit in the sorted lock array: the root of
+ the range [lo,hi) is the middle element, its children are the roots
+ of the two halves. max_end[mid] is the largest start+size in the
+ subtree below mid.
+****************************************************************************/
+
+static uint64_t brl_index_build(const struct lock_struct *locks,
+				uint64_t *max_end,
+				unsigned lo,
+				unsigned hi)
+{
+	unsigned mid;
+	uint64_t end;
+
+	if (lo >= hi) {
+		return 0;
+	}
+
+	mid = lo + (hi - lo) / 2;
+	end = locks[mid].start + locks[mid].size;
+	end = MAX(end, brl_index_build(locks, max_end, lo, mid));
+	end = MAX(end, brl_index_build(locks, max_end, mid + 1, hi));
+	max_end[mid] = end;
+
+	return end;
+}
+
+static bool brl_index_usable(struct byte_range_lock *br_lck)
+{
+	const struct lock_struct *locks = br_lck->lock_data;
+	unsigned i;
+
+	if (br_lck->modified) {
+		/*
+		 * The index describes the lock array as read from
+		 * the database.
+		 */
+		return false;
+	}
+	if (br_lck->num_locks < BRL_INDEX_MIN_LOCKS) {
+		return false;
+	}
+	if (br_lck->max_end != NULL) {
+		return true;
+	}
+
+	for (i=1; i < br_lck->num_locks; i++) {
+		if (locks[i-1].start > locks[i].start) {
+			DEBUG(10, ("lock array not sorted\n"));
+			return false;
+		}
+	}
+
+	br_lck->max_end = talloc_array(br_lck, uint64_t, br_lck->num_locks);
+	if (br_lck->max_end == NULL) {
+		return false;
+	}
+	brl_index_build(locks, br_lck->max_end, 0, br_lck->num_locks);
+	return true;
+}
+
+/*
+ * Return true to stop the walk.
+ */
+typedef bool (*brl_overlap_fn_t)(struct byte_range_lock *br_lck,
+				 struct lock_struct *lock,
+				 void *private_data);
+
+static bool brl_index_walk(struct byte_range_lock *br_lck,
+			   unsigned lo,
+			   unsigned hi,
+			   br_off start,
+			   br_off last,
+			   brl_overlap_fn_t fn,
+			   void *private_data)
+{
+	struct lock_struct *locks = br_lck->lock_data;
+
+	while (lo < hi) {
+		unsigned mid = lo + (hi - lo) / 2;
+		struct lock_struct *lock = &locks[mid];
+
+		if (br_lck->max_end[mid] <= start) {
+			/* Everything below mid ends before start */
+			return false;
+		}
+		if (brl_index_walk(br_lck, lo, mid, start, last,
+				   fn, private_data)) {
+			return true;
+		}
+		if (lock->start > last) {
+			/* mid and everything right of it starts too late */
+			return false;
+		}
+		if ((lock->start + lock->size > start) &&
+		    fn(br_lck, lock, private_data)) {
+			return true;
+		}
+		lo = mid + 1;
+	}
+	return false;
+}
+
+/****************************************************************************
+ Call fn for all locks that might overlap plock in the sense of
+ brl_overlap(), fn has to do the exact check. Returns true if fn
+ stopped the walk.
+****************************************************************************/
+
+static bool brl_forall_overlapping(struct byte_range_lock *br_lck,
+				   const struct lock_struct *plock,
+				   brl_overlap_fn_t fn,
+				   void *private_data)
+{
+	br_off end = plock->start + plock->size;
+	unsigned i;
+
+	if (((plock->size == 0) || (end > plock->start)) &&
+	    brl_index_usable(br_lck)) {
+		br_off last = (plock->size == 0) ? plock->start : end - 1;
+
+		return brl_index_walk(br_lck, 0, br_lck->num_locks,
+				      plock->start, last, fn, private_data);
+	}
+
+	for (i=0; i < br_lck->num_locks; i++) {
+		if (fn(br_lck, &br_lck->lock_data[i], private_data)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+struct brl_find_conflict_state {
+	const struct lock_struct *plock;
+	bool (*conflict)(const struct lock_struct *lock,
+			 const struct lock_struct *plock);
+	struct lock_struct *found;
+};
+
+static bool brl_find_conflict_fn(struct byte_range_lock *br_lck,
+				 struct lock_struct *lock,
+				 void *private_data)
+{
+	struct brl_find_conflict_state *state = private_data;
+
+	if (!state->conflict(lock, state->plock)) {
+		return false;
+	}
+
+	if ((br_lck->record != NULL) &&
+	    !serverid_exists(&lock->context.pid)) {
+		/*
+		 * Autocleanup in byte_range_lock_flush(), the
+		 * start and size that the index is built from
+		 * stay the same.
+		 */
+		lock->context.pid.pid = 0;
+		br_lck->modified = true;
+		return false;
+	}
+
+	state->found = lock;
+	return true;
+}
+
+/****************************************************************************
+ Find a lock conflicting with plock, marking locks of dead processes
+ for cleanup on the way.
+****************************************************************************/
+
+static struct lock_struct *brl_find_conflict(
+	struct byte_range_lock *br_lck,
+	const struct lock_struct *plock,
+	bool (*conflict)(const struct lock_struct *lock,
+			 const struct lock_struct *plock))
+{
+	struct brl_find_conflict_state state = {
+		.plock = plock, .conflict = conflict
+	};
+
+	brl_forall_overlapping(br_lck, plock, brl_find_conflict_fn, &state);
+
+	return state.found;
+}
+
 /****************************************************************************
  Amazingly enough, w2k3 "remembers" whether the last lock failure on a fnum
  is the same as this one and changes its error code. I wonder if any
@@ -358,7 +601,8 @@ void brl_init(bool read_only)
 		tdb_flags |= TDB_SEQNUM;
 	}
 
-	brlock_db = db_open(NULL, lock_path("brlock.tdb"),
+	brlock_db = db_open_shards(NULL, lock_path("brlock.tdb"),
+			    locking_db_shards(),
 			    SMB_OPEN_DATABASE_TDB_HASH_SIZE, tdb_flags,
 			    read_only?O_RDONLY:(O_RDWR|O_CREAT), 0644,
 			    DBWRAP_LOCK_ORDER_2, DBWRAP_FLAG_NONE);
@@ -406,6 +650,7 @@ NTSTATUS brl_lock_windows_default(struct byte_range_lock *br_lck,
 	unsigned int i;
 	files_struct *fsp = br_lck->fsp;
 	struct lock_struct *locks = br_lck->lock_data;
+	struct lock_struct *conflict;
 	NTSTATUS status;
 
 	SMB_ASSERT(plock->lock_type != UNLOCK_LOCK);
@@ -415,24 +660,12 @@ NTSTATUS brl_lock_windows_default(struct byte_range_lock *br_lck,
 		return NT_STATUS_INVALID_LOCK_RANGE;
 	}
 
-	for (i=0; i < br_lck->num_locks; i++) {
-		/* Do any Windows or POSIX locks conflict ? */
-		if (brl_conflict(&locks[i], plock)) {
-			if (!serverid_exists(&locks[i].context.pid)) {
-				locks[i].context.pid.pid = 0;
-				br_lck->modified = true;
-				continue;
-			}
-			/* Remember who blocked us. */
-			plock->context.smblctx = locks[i].context.smblctx;
-			return brl_lock_failed(fsp,plock,blocking_lock);
-		}
-#if ZERO_ZERO
-		if (plock->start == 0 && plock->size == 0 &&
-				locks[i].size == 0) {
-			break;
-		}
-#endif
+	/* Do any Windows or POSIX locks conflict ? */
+	conflict = brl_find_conflict(br_lck, plock, brl_conflict);
+	if (conflict != NULL) {
+		/* Remember who blocked us. */
+		plock->context.smblctx = conflict->context.smblctx;
+		return brl_lock_failed(fsp,plock,blocking_lock);
 	}
 
 	if (!IS_PENDING_LOCK(plock->lock_type)) {
@@ -467,7 +700,7 @@ NTSTATUS brl_lock_windows_default(struct byte_range_lock *br_lck,
 		}
 	}
 
-	/* no conflicts - add it to the list of locks */
+	/* no conflicts - add it to the list of locks, sorted by start */
 	locks = talloc_realloc(br_lck, locks, struct lock_struct,
 			       (br_lck->num_locks + 1));
 	if (!locks) {
@@ -475,7 +708,10 @@ NTSTATUS brl_lock_windows_default(struct byte_range_lock *br_lck,
 		goto fail;
 	}
 
-	memcpy(&locks[br_lck->num_locks], plock, sizeof(struct lock_struct));
+	i = brl_insert_pos(locks, br_lck->num_locks, plock->start);
+	memmove(&locks[i+1], &locks[i],
+		(br_lck->num_locks - i) * sizeof(struct lock_struct));
+	memcpy(&locks[i], plock, sizeof(struct lock_struct));
 	br_lck->num_locks += 1;
 	br_lck->lock_data = locks;
 	br_lck->modified = True;
@@ -882,13 +1118,7 @@ static NTSTATUS brl_lock_posix(struct messaging_context *msg_ctx,
 	}
 
 	/* Try and add the lock in order, sorted by lock start. */
-	for (i=0; i < count; i++) {
-		struct lock_struct *curr_lock = &tp[i];
-
-		if (curr_lock->start <= plock->start) {
-			continue;
-		}
-	}
+	i = brl_insert_pos(tp, count, plock->start);
 
 	if (i < count) {
 		memmove(&tp[i+1], &tp[i],
@@ -1364,29 +1594,14 @@ bool brl_locktest(struct byte_range_lock *br_lck,
 		  const struct lock_struct *rw_probe)
 {
 	bool ret = True;
-	unsigned int i;
-	struct lock_struct *locks = br_lck->lock_data;
 	files_struct *fsp = br_lck->fsp;
 
-	/* Make sure existing locks don't conflict */
-	for (i=0; i < br_lck->num_locks; i++) {
-		/*
-		 * Our own locks don't conflict.
-		 */
-		if (brl_conflict_other(&locks[i], rw_probe)) {
-			if (br_lck->record == NULL) {
-				/* readonly */
-				return false;
-			}
-
-			if (!serverid_exists(&locks[i].context.pid)) {
-				locks[i].context.pid.pid = 0;
-				br_lck->modified = true;
-				continue;
-			}
-
-			return False;
-		}
+	/*
+	 * Make sure existing locks don't conflict. Our own locks
+	 * don't conflict.
+	 */
+	if (brl_find_conflict(br_lck, rw_probe, brl_conflict_other) != NULL) {
+		return False;
 	}
 
 	/*
@@ -1841,7 +2056,7 @@ int brl_forall(void (*fn)(struct file_id id, struct server_id pid,
 
 static void byte_range_lock_flush(struct byte_range_lock *br_lck)
 {
-	unsigned i;
+	unsigned i, j;
 	struct lock_struct *locks = br_lck->lock_data;
 
 	if (!br_lck->modified) {
@@ -1849,20 +2064,30 @@ static void byte_range_lock_flush(struct byte_range_lock *br_lck)
 		goto done;
 	}
 
+	TALLOC_FREE(br_lck->max_end);
+
 	i = 0;
 
-	while (i < br_lck->num_locks) {
-		if (locks[i].context.pid.pid == 0) {
+	for (j=0; j < br_lck->num_locks; j++) {
+		if (locks[j].context.pid.pid == 0) {
 			/*
 			 * Autocleanup, the process conflicted and does not
 			 * exist anymore.
 			 */
-			locks[i] = locks[br_lck->num_locks-1];
-			br_lck->num_locks -= 1;
-		} else {
-			i += 1;
+			continue;
+		}
+		if (i != j) {
+			locks[i] = locks[j];
 		}
+		i += 1;
 	}
+	br_lck->num_locks = i;
+
+	/*
+	 * Splitting POSIX locks can leave the array unsorted,
+	 * readers rely on the order for their conflict index.
+	 */
+	brl_sort_locks(locks, br_lck->num_locks);
 
 	if ((br_lck->num_locks == 0) && (br_lck->num_read_oplocks == 0)) {
 		/* No locks - delete this entry. */
@@ -1935,6 +2160,23 @@ static bool brl_parse_data(struct byte_range_lock *br_lck, TDB_DATA data)
 	return true;
 }
 
+/*******************************************************************
+ Database and key brl_get_locks will lock for fsp, for
+ dbwrap_prefetch_locked. The key points into fsp.
+********************************************************************/
+
+bool brl_prefetch_key(files_struct *fsp, struct db_context **db,
+		      TDB_DATA *key)
+{
+	if (brlock_db == NULL) {
+		return false;
+	}
+	*db = brlock_db;
+	*key = make_tdb_data((uint8_t *)&fsp->file_id,
+			     sizeof(struct file_id));
+	return true;
+}
+
 /*******************************************************************
  Fetch a set of byte range lock data from the database.
  Leave the record locked.
@@ -2056,6 +2298,7 @@ struct byte_range_lock *brl_get_locks_readonly(files_struct *fsp)
 		br_lock->num_read_oplocks = 0;
 		br_lock->num_locks = 0;
 		br_lock->lock_data = NULL;
+		br_lock->max_end = NULL;
 
 	} else if (!NT_STATUS_IS_OK(status)) {
 		DEBUG(3, ("Could not parse byte range lock record: "
@@ -88,6 +88,10 @@ int brl_forall(void (*fn)(struct file_id id, struct server_id pid,
 struct byte_range_lock *brl_get_locks(TALLOC_CTX *mem_ctx,
 					files_struct *fsp);
 struct byte_range_lock *brl_get_locks_readonly(files_struct *fsp);
+struct db_context;
+struct TDB_DATA;
+bool brl_prefetch_key(files_struct *fsp, struct db_context **db,
+		      struct TDB_DATA *key);
 void brl_revalidate(struct messaging_context *msg_ctx,
 		    void *private_data,
 		    uint32_t msg_type,
@@ -139,9 +143,13 @@ NTSTATUS do_lock_cancel(files_struct *fsp,
 void locking_close_file(struct messaging_context *msg_ctx,
 			files_struct *fsp,
 			enum file_close_type close_type);
+unsigned locking_db_shards(void);
 bool locking_init(void);
 bool locking_init_readonly(void);
 bool locking_end(void);
+struct tdb_repack_stats;
+int locking_db_repack_chains(uint32_t start, uint32_t num_chains,
+			     struct tdb_repack_stats *stats);
 char *share_mode_str(TALLOC_CTX *ctx, int num, const struct share_mode_entry *e);
 struct share_mode_lock *get_existing_share_mode_lock(TALLOC_CTX *mem_ctx,
 						     struct file_id id);
@@ -153,6 +161,10 @@ struct share_mode_lock *get_share_mode_lock(
 	const struct timespec *old_write_time);
 struct share_mode_lock *fetch_share_mode_unlocked(TALLOC_CTX *mem_ctx,
 						  struct file_id id);
+bool share_mode_lock_prefetch_key(const struct file_id *id,
+				  struct db_context **db,
+				  struct TDB_DATA *key);
+bool share_mode_lock_load_entries(struct share_mode_lock *lck);
 bool rename_share_filename(struct messaging_context *msg_ctx,
 			struct share_mode_lock *lck,
 			struct file_id id,
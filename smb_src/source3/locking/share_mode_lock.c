@@ -37,6 +37,7 @@
 
 #include "includes.h"
 #include "system/filesys.h"
+#include "system/shmem.h"
 #include "locking/proto.h"
 #include "smbd/globals.h"
 #include "dbwrap/dbwrap.h"
@@ -48,6 +49,7 @@
 #include "../librpc/gen_ndr/ndr_open_files.h"
 #include "source3/lib/dbwrap/dbwrap_watch.h"
 #include "locking/leases_db.h"
+#include "../lib/util/memcache.h"
 
 #undef DBGC_CLASS
 #define DBGC_CLASS DBGC_LOCKING
@@ -57,6 +59,130 @@
 /* the locking database handle */
 static struct db_context *lock_db;
 
+/*
+ * Change counters for the records in locking.tdb, shared by all
+ * processes through a mmap'ed file. A writer bumps the counter of the
+ * record's slot while holding the record lock, before it stores the
+ * record. fetch_share_mode_unlocked() keeps the records it parsed
+ * together with the counter seen before reading them. As long as the
+ * counter did not move, it returns them without touching locking.tdb.
+ * Records sharing a slot just cause extra misses.
+ */
+#define SHARE_MODE_SEQNUM_SLOTS 65536
+static uint32_t *share_mode_seqnums;
+
+static bool share_mode_seqnums_init(bool read_only)
+{
+	size_t size = SHARE_MODE_SEQNUM_SLOTS * sizeof(uint32_t);
+	char *fname;
+	struct stat st;
+	void *p;
+	int fd;
+
+#ifndef HAVE___SYNC_FETCH_AND_ADD
+	/* Can't bump the counters atomically, no unlocked reads */
+	return true;
+#endif
+
+	if (lp_clustering()) {
+		/* Other nodes don't bump our counters */
+		return true;
+	}
+	if (share_mode_seqnums != NULL) {
+		return true;
+	}
+
+	fname = lock_path("locking_seqnum.dat");
+	if (fname == NULL) {
+		return false;
+	}
+	fd = open(fname, read_only ? O_RDONLY : O_RDWR|O_CREAT, 0644);
+	if (fd == -1) {
+		DEBUG(read_only ? 5 : 0, ("Could not open %s: %s\n",
+					  fname, strerror(errno)));
+		TALLOC_FREE(fname);
+		/* Without the counters readers can't use the cache */
+		return read_only;
+	}
+	TALLOC_FREE(fname);
+
+	if (fstat(fd, &st) == -1) {
+		goto fail;
+	}
+	if (st.st_size < size) {
+		if (read_only) {
+			goto fail;
+		}
+		if (ftruncate(fd, size) == -1) {
+			goto fail;
+		}
+	}
+
+	p = mmap(NULL, size, read_only ? PROT_READ : PROT_READ|PROT_WRITE,
+		 MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) {
+		goto fail;
+	}
+	close(fd);
+	share_mode_seqnums = (uint32_t *)p;
+	return true;
+
+fail:
+	DEBUG(read_only ? 5 : 0, ("Could not map locking_seqnum.dat: %s\n",
+				  strerror(errno)));
+	close(fd);
+	return read_only;
+}
+
+static void share_mode_seqnums_end(void)
+{
+	if (share_mode_seqnums == NULL) {
+		return;
+	}
+	munmap(share_mode_seqnums, SHARE_MODE_SEQNUM_SLOTS * sizeof(uint32_t));
+	share_mode_seqnums = NULL;
+	memcache_flush(NULL, SHARE_MODE_LOCK_CACHE);
+}
+
+static uint32_t *share_mode_seqnum_slot(TDB_DATA key)
+{
+	uint32_t hash = tdb_jenkins_hash(&key);
+	return &share_mode_seqnums[hash % SHARE_MODE_SEQNUM_SLOTS];
+}
+
+static uint32_t share_mode_seqnum_get(TDB_DATA key)
+{
+	volatile uint32_t *slot = share_mode_seqnum_slot(key);
+	uint32_t seqnum = *slot;
+
+#ifdef HAVE___SYNC_FETCH_AND_ADD
+	/* Nothing we read afterwards may be older than the counter */
+	__sync_synchronize();
+#endif
+	return seqnum;
+}
+
+static void share_mode_seqnum_bump(TDB_DATA key)
+{
+#ifdef HAVE___SYNC_FETCH_AND_ADD
+	if (share_mode_seqnums == NULL) {
+		return;
+	}
+	__sync_fetch_and_add(share_mode_seqnum_slot(key), 1);
+#endif
+}
+
+/*
+ * locking.tdb and brlock.tdb can be spread across several files, see
+ * db_open_shards(). All processes must see the same value.
+ */
+unsigned locking_db_shards(void)
+{
+	int shards = lp_parm_int(-1, "locking", "database shards", 1);
+
+	return MIN(MAX(shards, 1), 256);
+}
+
 static bool locking_init_internal(bool read_only)
 {
 	brl_init(read_only);
@@ -64,9 +190,11 @@ static bool locking_init_internal(bool read_only)
 	if (lock_db)
 		return True;
 
-	lock_db = db_open(NULL, lock_path("locking.tdb"),
+	lock_db = db_open_shards(NULL, lock_path("locking.tdb"),
+			  locking_db_shards(),
 			  SMB_OPEN_DATABASE_TDB_HASH_SIZE,
-			  TDB_DEFAULT|TDB_VOLATILE|TDB_CLEAR_IF_FIRST|TDB_INCOMPATIBLE_HASH,
+			  TDB_DEFAULT|TDB_VOLATILE|TDB_CLEAR_IF_FIRST|
+			  TDB_INCOMPATIBLE_HASH|TDB_MULTI_FREELIST,
 			  read_only?O_RDONLY:O_RDWR|O_CREAT, 0644,
 			  DBWRAP_LOCK_ORDER_1, DBWRAP_FLAG_NONE);
 
@@ -78,6 +206,13 @@ static bool locking_init_internal(bool read_only)
 	if (!posix_locking_init(read_only))
 		return False;
 
+	if (!share_mode_seqnums_init(read_only)) {
+		DEBUG(0,("ERROR: Failed to initialise locking sequence "
+			 "numbers\n"));
+		TALLOC_FREE(lock_db);
+		return False;
+	}
+
 	dbwrap_watch_db(lock_db, server_messaging_context());
 
 	return True;
@@ -100,10 +235,23 @@ bool locking_init_readonly(void)
 bool locking_end(void)
 {
 	brl_shutdown();
+	share_mode_seqnums_end();
 	TALLOC_FREE(lock_db);
 	return true;
 }
 
+/*
+ * Incrementally repack locking.tdb, see dbwrap_repack_chains()
+ */
+int locking_db_repack_chains(uint32_t start, uint32_t num_chains,
+			     struct tdb_repack_stats *stats)
+{
+	if (lock_db == NULL) {
+		return 0;
+	}
+	return dbwrap_repack_chains(lock_db, start, num_chains, stats);
+}
+
 /*******************************************************************
  Form a static locking key for a dev/inode pair.
 ******************************************************************/
@@ -113,19 +261,160 @@ static TDB_DATA locking_key(const struct file_id *id)
 	return make_tdb_data((const uint8_t *)id, sizeof(*id));
 }
 
+/*
+ * Database and key of the locking.tdb record for "id", for
+ * dbwrap_prefetch_locked. The key points into "id".
+ */
+bool share_mode_lock_prefetch_key(const struct file_id *id,
+				  struct db_context **db, TDB_DATA *key)
+{
+	if (lock_db == NULL) {
+		return false;
+	}
+	*db = lock_db;
+	*key = locking_key(id);
+	return true;
+}
+
+/*
+ * A locking.tdb record is a header followed by share_mode_data with
+ * no share mode entries in NDR, followed by the entries, each in its
+ * own fixed size NDR encoding. The entries are only decoded when
+ * needed, and storing a record only encodes the entries that changed
+ * since it was read. Records of the older layout, share_mode_data in
+ * NDR with the entries inside, are read as well.
+ *
+ * Header: magic, length of share_mode_data, number of entries and
+ * size of one entry, each uint32.
+ */
+#define SHARE_MODE_RECORD_MAGIC 0x32524d53 /* "SMR2" */
+#define SHARE_MODE_RECORD_HDR_SIZE 16
+
+static size_t share_mode_entry_size(void)
+{
+	static size_t size;
+
+	if (size == 0) {
+		struct share_mode_entry e;
+		enum ndr_err_code ndr_err;
+		DATA_BLOB blob;
+
+		ZERO_STRUCT(e);
+
+		ndr_err = ndr_push_struct_blob(
+			&blob, talloc_tos(), &e,
+			(ndr_push_flags_fn_t)ndr_push_share_mode_entry);
+		if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+			smb_panic("ndr_push_share_mode_entry failed");
+		}
+		size = blob.length;
+		data_blob_free(&blob);
+	}
+	return size;
+}
+
+/*
+ * Initialize the values that are [skip] in the idl. The NDR code does
+ * not initialize them.
+ */
+static void share_mode_entries_setup(struct share_mode_data *d)
+{
+	uint32_t i;
+
+	for (i=0; i<d->num_share_modes; i++) {
+		struct share_mode_entry *e = &d->share_modes[i];
+
+		e->stale = false;
+		e->lease = NULL;
+		if (e->op_type != LEASE_OPLOCK) {
+			continue;
+		}
+		if (e->lease_idx >= d->num_leases) {
+			continue;
+		}
+		e->lease = &d->leases[e->lease_idx];
+	}
+}
+
+/*
+ * Decode the share mode entries of a record read with
+ * load_entries == false.
+ */
+static bool share_mode_entries_load(struct share_mode_data *d)
+{
+	struct share_mode_entry *entries;
+	uint32_t i;
+
+	if (!d->entries_pending) {
+		return true;
+	}
+
+	entries = talloc_array(d, struct share_mode_entry,
+			       d->num_stored_entries);
+	if (entries == NULL) {
+		DEBUG(0, ("talloc failed\n"));
+		return false;
+	}
+
+	for (i=0; i<d->num_stored_entries; i++) {
+		DATA_BLOB blob;
+		enum ndr_err_code ndr_err;
+
+		blob = data_blob_const(
+			d->stored_entries + i * d->stored_entry_size,
+			d->stored_entry_size);
+
+		ndr_err = ndr_pull_struct_blob_all(
+			&blob, entries, &entries[i],
+			(ndr_pull_flags_fn_t)ndr_pull_share_mode_entry);
+		if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+			DEBUG(1, ("ndr_pull_share_mode_entry failed: %s\n",
+				  ndr_errstr(ndr_err)));
+			TALLOC_FREE(entries);
+			return false;
+		}
+	}
+
+	d->share_modes = entries;
+	d->num_share_modes = d->num_stored_entries;
+	d->entries_pending = false;
+	share_mode_entries_setup(d);
+
+	/*
+	 * Remember the entries as decoded, an entry still equal to
+	 * its copy is stored again as it was read.
+	 */
+	d->stored_copy = (struct share_mode_entry *)talloc_memdup(
+		d, d->share_modes,
+		sizeof(struct share_mode_entry) * d->num_share_modes);
+	if (d->stored_copy == NULL) {
+		d->num_stored_entries = 0;
+	}
+	return true;
+}
+
+/*******************************************************************
+ Make the share mode entries of an unlocked share mode available.
+********************************************************************/
+
+bool share_mode_lock_load_entries(struct share_mode_lock *lck)
+{
+	return share_mode_entries_load(lck->data);
+}
+
 /*******************************************************************
  Get all share mode entries for a dev/inode pair.
 ********************************************************************/
 
 static struct share_mode_data *parse_share_modes(TALLOC_CTX *mem_ctx,
-						 const TDB_DATA dbuf)
+						 const TDB_DATA dbuf,
+						 bool load_entries)
 {
 	struct share_mode_data *d;
 	enum ndr_err_code ndr_err;
-	uint32_t i;
 	DATA_BLOB blob;
 
-	d = talloc(mem_ctx, struct share_mode_data);
+	d = talloc_zero(mem_ctx, struct share_mode_data);
 	if (d == NULL) {
 		DEBUG(0, ("talloc failed\n"));
 		goto fail;
@@ -134,6 +423,35 @@ static struct share_mode_data *parse_share_modes(TALLOC_CTX *mem_ctx,
 	blob.data = dbuf.dptr;
 	blob.length = dbuf.dsize;
 
+	if ((dbuf.dsize >= SHARE_MODE_RECORD_HDR_SIZE) &&
+	    (IVAL(dbuf.dptr, 0) == SHARE_MODE_RECORD_MAGIC)) {
+		uint32_t header_len = IVAL(dbuf.dptr, 4);
+		uint32_t num_entries = IVAL(dbuf.dptr, 8);
+		uint32_t entry_size = IVAL(dbuf.dptr, 12);
+		size_t entries_len = dbuf.dsize - SHARE_MODE_RECORD_HDR_SIZE;
+
+		if ((header_len > entries_len) ||
+		    (entry_size == 0) ||
+		    (num_entries != (entries_len - header_len) / entry_size) ||
+		    ((entries_len - header_len) % entry_size != 0)) {
+			DEBUG(1, ("parse_share_modes: invalid record\n"));
+			goto fail;
+		}
+		entries_len -= header_len;
+
+		blob.data = dbuf.dptr + SHARE_MODE_RECORD_HDR_SIZE;
+		blob.length = header_len;
+
+		d->stored_entries = (uint8_t *)talloc_memdup(
+			d, blob.data + header_len, entries_len);
+		if ((entries_len != 0) && (d->stored_entries == NULL)) {
+			DEBUG(0, ("talloc failed\n"));
+			goto fail;
+		}
+		d->num_stored_entries = num_entries;
+		d->stored_entry_size = entry_size;
+	}
+
 	ndr_err = ndr_pull_struct_blob_all(
 		&blob, d, d, (ndr_pull_flags_fn_t)ndr_pull_share_mode_data);
 	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
@@ -142,27 +460,22 @@ static struct share_mode_data *parse_share_modes(TALLOC_CTX *mem_ctx,
 		goto fail;
 	}
 
-	/*
-	 * Initialize the values that are [skip] in the idl. The NDR code does
-	 * not initialize them.
-	 */
-
-	for (i=0; i<d->num_share_modes; i++) {
-		struct share_mode_entry *e = &d->share_modes[i];
-
-		e->stale = false;
-		e->lease = NULL;
-		if (e->op_type != LEASE_OPLOCK) {
-			continue;
-		}
-		if (e->lease_idx >= d->num_leases) {
-			continue;
+	if (d->stored_entries != NULL) {
+		if (d->num_share_modes != 0) {
+			DEBUG(1, ("parse_share_modes: entries in header\n"));
+			goto fail;
 		}
-		e->lease = &d->leases[e->lease_idx];
+		d->entries_pending = true;
 	}
+
+	share_mode_entries_setup(d);
 	d->modified = false;
 	d->fresh = false;
 
+	if (load_entries && !share_mode_entries_load(d)) {
+		goto fail;
+	}
+
 	if (DEBUGLEVEL >= 10) {
 		DEBUG(10, ("parse_share_modes:\n"));
 		NDR_PRINT_DEBUG(share_mode_data, d);
@@ -174,6 +487,44 @@ fail:
 	return NULL;
 }
 
+/*
+ * Encode the entries behind the rest of the record, reusing the stored
+ * encoding of every entry that did not change.
+ */
+static void unparse_share_mode_entries(struct share_mode_data *d,
+				       uint8_t *buf, size_t entry_size)
+{
+	uint32_t i;
+
+	for (i=0; i<d->num_share_modes; i++) {
+		struct share_mode_entry *e = &d->share_modes[i];
+		uint8_t *p = buf + i * entry_size;
+		enum ndr_err_code ndr_err;
+		DATA_BLOB blob;
+
+		if ((i < d->num_stored_entries) &&
+		    (d->stored_entry_size == entry_size) &&
+		    (d->stored_copy != NULL) &&
+		    (memcmp(e, &d->stored_copy[i], sizeof(*e)) == 0)) {
+			memcpy(p, d->stored_entries + i * entry_size,
+			       entry_size);
+			continue;
+		}
+
+		ndr_err = ndr_push_struct_blob(
+			&blob, talloc_tos(), e,
+			(ndr_push_flags_fn_t)ndr_push_share_mode_entry);
+		if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+			smb_panic("ndr_push_share_mode_entry failed");
+		}
+		if (blob.length != entry_size) {
+			smb_panic("share mode entry size changed");
+		}
+		memcpy(p, blob.data, entry_size);
+		data_blob_free(&blob);
+	}
+}
+
 /*******************************************************************
  Create a storable data blob from a modified share_mode_data struct.
 ********************************************************************/
@@ -182,6 +533,15 @@ static TDB_DATA unparse_share_modes(struct share_mode_data *d)
 {
 	DATA_BLOB blob;
 	enum ndr_err_code ndr_err;
+	struct share_mode_entry *share_modes;
+	uint32_t num_share_modes;
+	size_t entry_size;
+	uint8_t *buf;
+	size_t len;
+
+	if (!share_mode_entries_load(d)) {
+		smb_panic("share_mode_entries_load failed");
+	}
 
 	if (DEBUGLEVEL >= 10) {
 		DEBUG(10, ("unparse_share_modes:\n"));
@@ -195,13 +555,53 @@ static TDB_DATA unparse_share_modes(struct share_mode_data *d)
 		return make_tdb_data(NULL, 0);
 	}
 
+	if (lp_parm_bool(-1, "locking", "legacy share mode records", false)) {
+		/* For smbds not knowing the new layout */
+		ndr_err = ndr_push_struct_blob(
+			&blob, d, d,
+			(ndr_push_flags_fn_t)ndr_push_share_mode_data);
+		if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+			smb_panic("ndr_push_share_mode_lock failed");
+		}
+		return make_tdb_data(blob.data, blob.length);
+	}
+
+	share_modes = d->share_modes;
+	num_share_modes = d->num_share_modes;
+	d->share_modes = NULL;
+	d->num_share_modes = 0;
+
 	ndr_err = ndr_push_struct_blob(
 		&blob, d, d, (ndr_push_flags_fn_t)ndr_push_share_mode_data);
+
+	d->share_modes = share_modes;
+	d->num_share_modes = num_share_modes;
+
 	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
 		smb_panic("ndr_push_share_mode_lock failed");
 	}
 
-	return make_tdb_data(blob.data, blob.length);
+	entry_size = share_mode_entry_size();
+	len = SHARE_MODE_RECORD_HDR_SIZE + blob.length +
+		num_share_modes * entry_size;
+
+	buf = talloc_array(d, uint8_t, len);
+	if (buf == NULL) {
+		smb_panic("talloc failed");
+	}
+
+	SIVAL(buf, 0, SHARE_MODE_RECORD_MAGIC);
+	SIVAL(buf, 4, blob.length);
+	SIVAL(buf, 8, num_share_modes);
+	SIVAL(buf, 12, entry_size);
+	memcpy(buf + SHARE_MODE_RECORD_HDR_SIZE, blob.data, blob.length);
+
+	unparse_share_mode_entries(
+		d, buf + SHARE_MODE_RECORD_HDR_SIZE + blob.length, entry_size);
+
+	data_blob_free(&blob);
+
+	return make_tdb_data(buf, len);
 }
 
 /*******************************************************************
@@ -217,6 +617,9 @@ static int share_mode_data_destructor(struct share_mode_data *d)
 		return 0;
 	}
 
+	/* Invalidate what unlocked readers have cached */
+	share_mode_seqnum_bump(dbwrap_record_get_key(d->record));
+
 	data = unparse_share_modes(d);
 
 	if (data.dptr == NULL) {
@@ -333,7 +736,7 @@ static struct share_mode_lock *get_share_mode_lock_internal(
 		d = fresh_share_mode_lock(mem_ctx, servicepath, smb_fname,
 					  old_write_time);
 	} else {
-		d = parse_share_modes(mem_ctx, value);
+		d = parse_share_modes(mem_ctx, value, true);
 	}
 
 	if (d == NULL) {
@@ -421,12 +824,92 @@ static void fetch_share_mode_unlocked_parser(
 	struct share_mode_lock *lck = talloc_get_type_abort(
 		private_data, struct share_mode_lock);
 
-	lck->data = parse_share_modes(lck, data);
+	lck->data = parse_share_modes(lck, data, false);
+}
+
+static int share_mode_data_nofree_destructor(struct share_mode_data *d)
+{
+	return -1;
+}
+
+/*
+ * Look for a cached copy of the record that is still current. True
+ * if one was found, *pd is NULL if the record does not exist.
+ */
+static bool share_mode_cache_fetch(TALLOC_CTX *mem_ctx, struct file_id id,
+				   uint32_t seqnum,
+				   struct share_mode_data **pd)
+{
+	DATA_BLOB key = data_blob_const(&id, sizeof(id));
+	struct share_mode_data *d;
+
+	d = (struct share_mode_data *)memcache_lookup_talloc(
+		NULL, SHARE_MODE_LOCK_CACHE, key);
+	if (d == NULL) {
+		return false;
+	}
+	if (d->seqnum != seqnum) {
+		memcache_delete(NULL, SHARE_MODE_LOCK_CACHE, key);
+		return false;
+	}
+	if (d->fresh) {
+		/* Known not to exist */
+		*pd = NULL;
+		return true;
+	}
+
+	/*
+	 * Take it out of the cache, it comes back when the caller is
+	 * done with it.
+	 */
+	d = talloc_move(mem_ctx, &d);
+	talloc_set_destructor(d, share_mode_data_nofree_destructor);
+	memcache_delete(NULL, SHARE_MODE_LOCK_CACHE, key);
+	talloc_set_destructor(d, NULL);
+
+	*pd = d;
+	return true;
+}
+
+static void share_mode_cache_store(struct share_mode_data **pd)
+{
+	struct share_mode_data *d = *pd;
+	DATA_BLOB key = data_blob_const(&d->id, sizeof(d->id));
+
+	/* Without a global memcache d stays where it is */
+	memcache_add_talloc(NULL, SHARE_MODE_LOCK_CACHE, key, pd);
+}
+
+static void share_mode_cache_store_missing(struct file_id id,
+					   uint32_t seqnum)
+{
+	struct share_mode_data *d;
+
+	d = talloc_zero(talloc_tos(), struct share_mode_data);
+	if (d == NULL) {
+		return;
+	}
+	d->fresh = true;
+	d->id = id;
+	d->seqnum = seqnum;
+
+	share_mode_cache_store(&d);
+	TALLOC_FREE(d);
+}
+
+static int share_mode_unlocked_destructor(struct share_mode_lock *lck)
+{
+	/* Nobody changes unlocked data, keep it for the next reader */
+	share_mode_cache_store(&lck->data);
+	return 0;
 }
 
 /*******************************************************************
  Get a share_mode_lock without locking the database or reference
- counting. Used by smbstatus to display existing share modes.
+ counting. The result must not be modified. Used by smbstatus to
+ display existing share modes and for read-only checks in smbd.
+ The share mode entries are only there after
+ share_mode_lock_load_entries().
 ********************************************************************/
 
 struct share_mode_lock *fetch_share_mode_unlocked(TALLOC_CTX *mem_ctx,
@@ -434,6 +917,7 @@ struct share_mode_lock *fetch_share_mode_unlocked(TALLOC_CTX *mem_ctx,
 {
 	struct share_mode_lock *lck;
 	TDB_DATA key = locking_key(&id);
+	uint32_t seqnum = 0;
 	NTSTATUS status;
 
 	lck = talloc(mem_ctx, struct share_mode_lock);
@@ -441,13 +925,45 @@ struct share_mode_lock *fetch_share_mode_unlocked(TALLOC_CTX *mem_ctx,
 		DEBUG(0, ("talloc failed\n"));
 		return NULL;
 	}
+	lck->data = NULL;
+
+	if (share_mode_seqnums != NULL) {
+		/*
+		 * Read the counter before the record. A change to the
+		 * record that we don't see bumps it afterwards.
+		 */
+		seqnum = share_mode_seqnum_get(key);
+
+		if (share_mode_cache_fetch(lck, id, seqnum, &lck->data)) {
+			if (lck->data == NULL) {
+				TALLOC_FREE(lck);
+				return NULL;
+			}
+			talloc_set_destructor(
+				lck, share_mode_unlocked_destructor);
+			return lck;
+		}
+	}
+
 	status = dbwrap_parse_record(
 		lock_db, key, fetch_share_mode_unlocked_parser, lck);
+
+	if ((share_mode_seqnums != NULL) &&
+	    NT_STATUS_EQUAL(status, NT_STATUS_NOT_FOUND)) {
+		share_mode_cache_store_missing(id, seqnum);
+	}
+
 	if (!NT_STATUS_IS_OK(status) ||
 	    (lck->data == NULL)) {
 		TALLOC_FREE(lck);
 		return NULL;
 	}
+
+	if (share_mode_seqnums != NULL) {
+		lck->data->id = id;
+		lck->data->seqnum = seqnum;
+		talloc_set_destructor(lck, share_mode_unlocked_destructor);
+	}
 	return lck;
 }
 
@@ -461,11 +977,8 @@ static int share_mode_traverse_fn(struct db_record *rec, void *_state)
 {
 	struct share_mode_forall_state *state =
 		(struct share_mode_forall_state *)_state;
-	uint32_t i;
 	TDB_DATA key;
 	TDB_DATA value;
-	DATA_BLOB blob;
-	enum ndr_err_code ndr_err;
 	struct share_mode_data *d;
 	struct file_id fid;
 	int ret;
@@ -479,28 +992,11 @@ static int share_mode_traverse_fn(struct db_record *rec, void *_state)
 	}
 	memcpy(&fid, key.dptr, sizeof(fid));
 
-	d = talloc(talloc_tos(), struct share_mode_data);
+	d = parse_share_modes(talloc_tos(), value, true);
 	if (d == NULL) {
 		return 0;
 	}
 
-	blob.data = value.dptr;
-	blob.length = value.dsize;
-
-	ndr_err = ndr_pull_struct_blob_all(
-		&blob, d, d, (ndr_pull_flags_fn_t)ndr_pull_share_mode_data);
-	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
-		DEBUG(1, ("ndr_pull_share_mode_lock failed\n"));
-		return 0;
-	}
-	if (DEBUGLEVEL > 10) {
-		DEBUG(11, ("parse_share_modes:\n"));
-		NDR_PRINT_DEBUG(share_mode_data, d);
-	}
-	for (i=0; i<d->num_share_modes; i++) {
-		d->share_modes[i].stale = false; /* [skip] in idl */
-	}
-
 	ret = state->fn(fid, d, state->private_data);
 
 	TALLOC_FREE(d);
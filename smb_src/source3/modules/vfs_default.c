@@ -661,50 +661,106 @@ static void vfswrap_asys_finished(struct tevent_context *ev,
 				  struct tevent_fd *fde,
 				  uint16_t flags, void *p);
 
-static bool vfswrap_init_asys_ctx(struct smbd_server_connection *conn)
+static bool vfswrap_init_asys_pool(struct smbd_server_connection *conn,
+				   struct asys_context **pctx,
+				   struct tevent_fd **pfde,
+				   unsigned max_parallel)
 {
 	int ret;
 	int fd;
 
-	if (conn->asys_ctx != NULL) {
+	if (*pctx != NULL) {
 		return true;
 	}
-	ret = asys_context_init(&conn->asys_ctx, aio_pending_size);
+	ret = asys_context_init(pctx, max_parallel);
 	if (ret != 0) {
 		DEBUG(1, ("asys_context_init failed: %s\n", strerror(ret)));
 		return false;
 	}
 
-	fd = asys_signalfd(conn->asys_ctx);
+	fd = asys_signalfd(*pctx);
 
 	set_blocking(fd, false);
 
-	conn->asys_fde = tevent_add_fd(conn->ev_ctx, conn, fd,
-				       TEVENT_FD_READ,
-				       vfswrap_asys_finished,
-				       conn->asys_ctx);
-	if (conn->asys_fde == NULL) {
+	*pfde = tevent_add_fd(conn->ev_ctx, conn, fd,
+			      TEVENT_FD_READ,
+			      vfswrap_asys_finished,
+			      *pctx);
+	if (*pfde == NULL) {
 		DEBUG(1, ("tevent_add_fd failed\n"));
-		asys_context_destroy(conn->asys_ctx);
-		conn->asys_ctx = NULL;
+		asys_context_destroy(*pctx);
+		*pctx = NULL;
 		return false;
 	}
 	return true;
 }
 
+static bool vfswrap_init_asys_ctx(struct smbd_server_connection *conn)
+{
+	return vfswrap_init_asys_pool(conn, &conn->asys_ctx, &conn->asys_fde,
+				      aio_pending_size);
+}
+
+/*
+ * The pool for the stat and getxattr calls. With "smb2 worker
+ * threads" they get their own threads, so that they don't queue up
+ * behind reads and writes, with only "aio metadata" they share the
+ * pool of the reads and writes. NULL means the call has to be done
+ * synchronously.
+ */
+static struct asys_context *vfswrap_asys_meta_ctx(
+	struct vfs_handle_struct *handle)
+{
+	struct smbd_server_connection *sconn = handle->conn->sconn;
+	int threads = lp_smb2_worker_threads();
+
+	if (!smbd_smb2_worker_enabled(handle->conn)) {
+		return NULL;
+	}
+	if (threads <= 0) {
+		if (!vfswrap_init_asys_ctx(sconn)) {
+			return NULL;
+		}
+		return sconn->asys_ctx;
+	}
+	if (!vfswrap_init_asys_pool(sconn, &sconn->asys_meta_ctx,
+				    &sconn->asys_meta_fde, threads)) {
+		return NULL;
+	}
+	return sconn->asys_meta_ctx;
+}
+
 struct vfswrap_asys_state {
 	struct asys_context *asys_ctx;
 	struct tevent_req *req;
 	ssize_t ret;
 	int err;
+	/* For the stat calls */
+	struct stat st;
+	SMB_STRUCT_STAT *sbuf;
+	bool fake_dir_create_times;
 };
 
+/*
+ * Jobs in the asys pool. The stat and getxattr calls are not counted
+ * in outstanding_aio_calls, vfswrap_asys_finished() must still
+ * collect their results when no read or write is pending.
+ */
+static unsigned vfswrap_asys_pending;
+
 static int vfswrap_asys_state_destructor(struct vfswrap_asys_state *s)
 {
 	asys_cancel(s->asys_ctx, s->req);
+	vfswrap_asys_pending -= 1;
 	return 0;
 }
 
+static void vfswrap_asys_submitted(struct vfswrap_asys_state *s)
+{
+	vfswrap_asys_pending += 1;
+	talloc_set_destructor(s, vfswrap_asys_state_destructor);
+}
+
 static struct tevent_req *vfswrap_pread_send(struct vfs_handle_struct *handle,
 					     TALLOC_CTX *mem_ctx,
 					     struct tevent_context *ev,
@@ -732,7 +788,7 @@ static struct tevent_req *vfswrap_pread_send(struct vfs_handle_struct *handle,
 		tevent_req_error(req, ret);
 		return tevent_req_post(req, ev);
 	}
-	talloc_set_destructor(state, vfswrap_asys_state_destructor);
+	vfswrap_asys_submitted(state);
 
 	return req;
 }
@@ -764,7 +820,7 @@ static struct tevent_req *vfswrap_pwrite_send(struct vfs_handle_struct *handle,
 		tevent_req_error(req, ret);
 		return tevent_req_post(req, ev);
 	}
-	talloc_set_destructor(state, vfswrap_asys_state_destructor);
+	vfswrap_asys_submitted(state);
 
 	return req;
 }
@@ -794,7 +850,7 @@ static struct tevent_req *vfswrap_fsync_send(struct vfs_handle_struct *handle,
 		tevent_req_error(req, ret);
 		return tevent_req_post(req, ev);
 	}
-	talloc_set_destructor(state, vfswrap_asys_state_destructor);
+	vfswrap_asys_submitted(state);
 
 	return req;
 }
@@ -804,14 +860,15 @@ static void vfswrap_asys_finished(struct tevent_context *ev,
 					uint16_t flags, void *p)
 {
 	struct asys_context *asys_ctx = (struct asys_context *)p;
-	struct asys_result results[outstanding_aio_calls];
+	unsigned num_results = MAX(vfswrap_asys_pending, 1);
+	struct asys_result results[num_results];
 	int i, ret;
 
 	if ((flags & TEVENT_FD_READ) == 0) {
 		return;
 	}
 
-	ret = asys_results(asys_ctx, results, outstanding_aio_calls);
+	ret = asys_results(asys_ctx, results, num_results);
 	if (ret < 0) {
 		DEBUG(1, ("asys_results returned %s\n", strerror(-ret)));
 		return;
@@ -831,9 +888,14 @@ static void vfswrap_asys_finished(struct tevent_context *ev,
 		state = tevent_req_data(req, struct vfswrap_asys_state);
 
 		talloc_set_destructor(state, NULL);
+		vfswrap_asys_pending -= 1;
 
 		state->ret = result->ret;
 		state->err = result->err;
+		if ((state->sbuf != NULL) && (state->ret == 0)) {
+			init_stat_ex_from_stat(state->sbuf, &state->st,
+					       state->fake_dir_create_times);
+		}
 		tevent_req_defer_callback(req, ev);
 		tevent_req_done(req);
 	}
@@ -997,6 +1059,171 @@ static int vfswrap_lstat(vfs_handle_struct *handle,
 	return result;
 }
 
+/*
+ * The path based calls run with the credentials of the current
+ * user. NULL means the call has to be done synchronously.
+ */
+static struct asys_creds_context *vfswrap_asys_creds(
+	struct vfs_handle_struct *handle,
+	struct asys_context *asys_ctx)
+{
+	const struct security_unix_token *utok;
+
+	if (asys_ctx == NULL) {
+		return NULL;
+	}
+	utok = get_current_utok(handle->conn);
+	if (utok == NULL) {
+		return NULL;
+	}
+	return asys_creds_context_create(asys_ctx,
+					 utok->uid, utok->gid,
+					 utok->ngroups, utok->groups);
+}
+
+/*
+ * The helper thread can't rely on the current directory.
+ */
+static char *vfswrap_asys_path(TALLOC_CTX *mem_ctx,
+			       struct vfs_handle_struct *handle,
+			       const char *path)
+{
+	const char *cwd = handle->conn->cwd;
+
+	if (path[0] == '/') {
+		return talloc_strdup(mem_ctx, path);
+	}
+	if (cwd == NULL) {
+		cwd = handle->conn->connectpath;
+	}
+	return talloc_asprintf(mem_ctx, "%s/%s", cwd, path);
+}
+
+static struct tevent_req *vfswrap_stat_common_send(
+	struct vfs_handle_struct *handle, TALLOC_CTX *mem_ctx,
+	struct tevent_context *ev, struct smb_filename *smb_fname,
+	bool follow)
+{
+	struct tevent_req *req;
+	struct vfswrap_asys_state *state;
+	struct asys_context *asys_ctx;
+	struct asys_creds_context *cctx;
+	char *path;
+	int ret;
+
+	req = tevent_req_create(mem_ctx, &state, struct vfswrap_asys_state);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	if (smb_fname->stream_name != NULL) {
+		tevent_req_error(req, ENOENT);
+		return tevent_req_post(req, ev);
+	}
+
+	asys_ctx = vfswrap_asys_meta_ctx(handle);
+	cctx = vfswrap_asys_creds(handle, asys_ctx);
+	if (cctx == NULL) {
+		if (follow) {
+			state->ret = vfswrap_stat(handle, smb_fname);
+		} else {
+			state->ret = vfswrap_lstat(handle, smb_fname);
+		}
+		state->err = (state->ret == -1) ? errno : 0;
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
+	}
+
+	path = vfswrap_asys_path(talloc_tos(), handle, smb_fname->base_name);
+	if (path == NULL) {
+		asys_creds_context_delete(cctx);
+		tevent_req_oom(req);
+		return tevent_req_post(req, ev);
+	}
+
+	state->asys_ctx = asys_ctx;
+	state->req = req;
+	state->sbuf = &smb_fname->st;
+	state->fake_dir_create_times =
+		lp_fake_directory_create_times(SNUM(handle->conn));
+
+	if (follow) {
+		ret = asys_stat(state->asys_ctx, cctx, path, &state->st, req);
+	} else {
+		ret = asys_lstat(state->asys_ctx, cctx, path, &state->st, req);
+	}
+	asys_creds_context_delete(cctx);
+	TALLOC_FREE(path);
+	if (ret != 0) {
+		tevent_req_error(req, ret);
+		return tevent_req_post(req, ev);
+	}
+	vfswrap_asys_submitted(state);
+
+	return req;
+}
+
+static struct tevent_req *vfswrap_stat_send(struct vfs_handle_struct *handle,
+					    TALLOC_CTX *mem_ctx,
+					    struct tevent_context *ev,
+					    struct smb_filename *smb_fname)
+{
+	return vfswrap_stat_common_send(handle, mem_ctx, ev, smb_fname, true);
+}
+
+static struct tevent_req *vfswrap_lstat_send(struct vfs_handle_struct *handle,
+					     TALLOC_CTX *mem_ctx,
+					     struct tevent_context *ev,
+					     struct smb_filename *smb_fname)
+{
+	return vfswrap_stat_common_send(handle, mem_ctx, ev, smb_fname,
+					false);
+}
+
+static struct tevent_req *vfswrap_fstat_send(struct vfs_handle_struct *handle,
+					     TALLOC_CTX *mem_ctx,
+					     struct tevent_context *ev,
+					     struct files_struct *fsp,
+					     SMB_STRUCT_STAT *sbuf)
+{
+	struct tevent_req *req;
+	struct vfswrap_asys_state *state;
+	struct asys_context *asys_ctx;
+	int ret;
+
+	req = tevent_req_create(mem_ctx, &state, struct vfswrap_asys_state);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	/*
+	 * No credentials needed for the fd, but only go async
+	 * where the path based calls do.
+	 */
+	asys_ctx = vfswrap_asys_meta_ctx(handle);
+	if (asys_ctx == NULL) {
+		state->ret = vfswrap_fstat(handle, fsp, sbuf);
+		state->err = (state->ret == -1) ? errno : 0;
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
+	}
+
+	state->asys_ctx = asys_ctx;
+	state->req = req;
+	state->sbuf = sbuf;
+	state->fake_dir_create_times =
+		lp_fake_directory_create_times(SNUM(handle->conn));
+
+	ret = asys_fstat(state->asys_ctx, fsp->fh->fd, &state->st, req);
+	if (ret != 0) {
+		tevent_req_error(req, ret);
+		return tevent_req_post(req, ev);
+	}
+	vfswrap_asys_submitted(state);
+
+	return req;
+}
+
 static NTSTATUS vfswrap_translate_name(struct vfs_handle_struct *handle,
 				       const char *name,
 				       enum vfs_translate_direction direction,
@@ -2397,6 +2624,55 @@ static ssize_t vfswrap_getxattr(struct vfs_handle_struct *handle,const char *pat
 	return getxattr(path, name, value, size);
 }
 
+static struct tevent_req *vfswrap_getxattr_send(
+	struct vfs_handle_struct *handle, TALLOC_CTX *mem_ctx,
+	struct tevent_context *ev, const char *path, const char *name,
+	void *value, size_t size)
+{
+	struct tevent_req *req;
+	struct vfswrap_asys_state *state;
+	struct asys_context *asys_ctx;
+	struct asys_creds_context *cctx;
+	char *abspath;
+	int ret;
+
+	req = tevent_req_create(mem_ctx, &state, struct vfswrap_asys_state);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	asys_ctx = vfswrap_asys_meta_ctx(handle);
+	cctx = vfswrap_asys_creds(handle, asys_ctx);
+	if (cctx == NULL) {
+		state->ret = getxattr(path, name, value, size);
+		state->err = (state->ret == -1) ? errno : 0;
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
+	}
+
+	abspath = vfswrap_asys_path(talloc_tos(), handle, path);
+	if (abspath == NULL) {
+		asys_creds_context_delete(cctx);
+		tevent_req_oom(req);
+		return tevent_req_post(req, ev);
+	}
+
+	state->asys_ctx = asys_ctx;
+	state->req = req;
+
+	ret = asys_getxattr(state->asys_ctx, cctx, abspath, name,
+			    value, size, req);
+	asys_creds_context_delete(cctx);
+	TALLOC_FREE(abspath);
+	if (ret != 0) {
+		tevent_req_error(req, ret);
+		return tevent_req_post(req, ev);
+	}
+	vfswrap_asys_submitted(state);
+
+	return req;
+}
+
 static ssize_t vfswrap_fgetxattr(struct vfs_handle_struct *handle, struct files_struct *fsp, const char *name, void *value, size_t size)
 {
 	return fgetxattr(fsp->fh->fd, name, value, size);
@@ -2560,6 +2836,12 @@ static struct vfs_fn_pointers vfs_default_fns = {
 	.stat_fn = vfswrap_stat,
 	.fstat_fn = vfswrap_fstat,
 	.lstat_fn = vfswrap_lstat,
+	.stat_send_fn = vfswrap_stat_send,
+	.stat_recv_fn = vfswrap_asys_int_recv,
+	.fstat_send_fn = vfswrap_fstat_send,
+	.fstat_recv_fn = vfswrap_asys_int_recv,
+	.lstat_send_fn = vfswrap_lstat_send,
+	.lstat_recv_fn = vfswrap_asys_int_recv,
 	.get_alloc_size_fn = vfswrap_get_alloc_size,
 	.unlink_fn = vfswrap_unlink,
 	.chmod_fn = vfswrap_chmod,
@@ -2621,6 +2903,8 @@ static struct vfs_fn_pointers vfs_default_fns = {
 
 	/* EA operations. */
 	.getxattr_fn = vfswrap_getxattr,
+	.getxattr_send_fn = vfswrap_getxattr_send,
+	.getxattr_recv_fn = vfswrap_asys_ssize_t_recv,
 	.fgetxattr_fn = vfswrap_fgetxattr,
 	.listxattr_fn = vfswrap_listxattr,
 	.flistxattr_fn = vfswrap_flistxattr,
@@ -0,0 +1,1090 @@
+/*
+ * Async pread/pwrite/fsync using the Linux io_uring interface.
+ *
+ * Copyright (C) The Samba Team 2015
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Every smbd process has a single ring. Requests are put into the
+ * submission queue directly, the io_uring_enter() call for all of
+ * them is done from a tevent immediate. So all reads and writes
+ * started while processing a batch of SMB2 requests go to the
+ * kernel with a single system call.
+ *
+ * Completions are signalled via an eventfd registered with the
+ * ring, that is watched by the main event loop.
+ *
+ * The number of requests in flight is limited to the size of the
+ * submission queue, so that neither the submission queue nor the
+ * completion queue can overflow. Requests exceeding that limit
+ * wait in a list until a completion makes room.
+ *
+ * Open files are registered with the ring (IOSQE_FIXED_FILE), which
+ * saves the kernel the file table lookup and reference counting for
+ * each request.
+ *
+ * The ring is set up when a share is connected. Kernels before 5.6
+ * have io_uring, but not IORING_OP_READ/WRITE. This is found out with
+ * IORING_REGISTER_PROBE, in that case all requests are passed down to
+ * the next module.
+ *
+ * For selftest, "io_uring:testing mode" makes the fallbacks happen
+ * on any kernel. "unsupported" acts as if there was no io_uring at
+ * all. "erratic" splits every read and write into a short first part,
+ * lets every third io_uring_enter() fail with EAGAIN and every fifth
+ * one with EINVAL.
+ */
+
+#include "includes.h"
+#include "system/filesys.h"
+#include "smbd/smbd.h"
+#include "smbd/globals.h"
+#include "lib/util/tevent_unix.h"
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+struct vfs_io_uring_request;
+
+struct vfs_io_uring_ring {
+	pid_t pid;
+	int fd;
+	int event_fd;
+	struct tevent_context *ev;
+	struct tevent_fd *fde;
+	struct tevent_immediate *im;
+	struct tevent_timer *retry_te;
+	bool submit_scheduled;
+
+	/* See "io_uring:testing mode" */
+	bool erratic_testing_mode;
+	unsigned num_enter;
+
+	void *sq_ptr;
+	size_t sq_size;
+	void *cq_ptr;
+	size_t cq_size;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned sq_entries;
+
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	/* Put into the submission queue, not yet given to the kernel */
+	unsigned num_unsubmitted;
+	/* In the submission queue or in the kernel */
+	unsigned num_inflight;
+	/* Waiting for room in the submission queue */
+	struct vfs_io_uring_request *waiting;
+
+	/* Registered file table, -1 for a free slot */
+	int *files;
+	unsigned num_files;
+};
+
+/*
+ * Allocated on the ring and not on the tevent_req, a request in
+ * flight can't be taken back from the kernel. If the tevent_req
+ * is freed before the completion arrives, req is set to NULL and
+ * the completion just frees the request.
+ */
+struct vfs_io_uring_request {
+	struct vfs_io_uring_request *prev, *next;
+	struct vfs_io_uring_ring *ring;
+	struct tevent_req *req;
+	struct io_uring_sqe sqe;
+	bool queued;
+	/* Bytes done by earlier parts of a short read or write */
+	size_t nread;
+	int res;
+};
+
+struct vfs_io_uring_fsp {
+	struct vfs_io_uring_ring *ring;
+	unsigned slot;
+};
+
+struct vfs_io_uring_state {
+	struct vfs_io_uring_request *ur;
+	ssize_t ret;
+	int err;
+};
+
+enum vfs_io_uring_testing_mode {
+	VFS_IO_URING_TESTING_NONE,
+	VFS_IO_URING_TESTING_UNSUPPORTED,
+	VFS_IO_URING_TESTING_ERRATIC
+};
+
+static const struct enum_list vfs_io_uring_testing_modes[] = {
+	{ VFS_IO_URING_TESTING_NONE, "none" },
+	{ VFS_IO_URING_TESTING_UNSUPPORTED, "unsupported" },
+	{ VFS_IO_URING_TESTING_ERRATIC, "erratic" },
+	{ -1, NULL }
+};
+
+static struct vfs_io_uring_ring *vfs_io_uring_ring;
+
+/* Setting up the ring failed in this process, don't try again */
+static bool vfs_io_uring_unavailable;
+
+static int vfs_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int vfs_io_uring_enter(int fd, unsigned to_submit,
+			      unsigned min_complete, unsigned flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+static int vfs_io_uring_register(int fd, unsigned opcode,
+				 void *arg, unsigned nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void vfs_io_uring_complete(struct tevent_context *ev,
+				  struct tevent_fd *fde,
+				  uint16_t flags, void *private_data);
+static void vfs_io_uring_submit(struct tevent_context *ev,
+				struct tevent_immediate *im,
+				void *private_data);
+
+static int vfs_io_uring_ring_destructor(struct vfs_io_uring_ring *ring)
+{
+	TALLOC_FREE(ring->fde);
+	if (ring->sqes != NULL) {
+		munmap(ring->sqes, ring->sqes_size);
+	}
+	if (ring->cq_ptr != NULL && ring->cq_ptr != ring->sq_ptr) {
+		munmap(ring->cq_ptr, ring->cq_size);
+	}
+	if (ring->sq_ptr != NULL) {
+		munmap(ring->sq_ptr, ring->sq_size);
+	}
+	if (ring->fd != -1) {
+		close(ring->fd);
+	}
+	if (ring->event_fd != -1) {
+		close(ring->event_fd);
+	}
+	if (vfs_io_uring_ring == ring) {
+		vfs_io_uring_ring = NULL;
+	}
+	return 0;
+}
+
+/*
+ * Make sure the kernel knows all opcodes we use
+ */
+static bool vfs_io_uring_probe(struct vfs_io_uring_ring *ring)
+{
+	static const uint8_t needed[] = {
+		IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC
+	};
+	struct io_uring_probe *probe;
+	size_t i;
+	int ret;
+
+	probe = talloc_zero_size(
+		ring, sizeof(struct io_uring_probe) +
+		IORING_OP_LAST * sizeof(struct io_uring_probe_op));
+	if (probe == NULL) {
+		return false;
+	}
+
+	ret = vfs_io_uring_register(ring->fd, IORING_REGISTER_PROBE,
+				    probe, IORING_OP_LAST);
+	if (ret == -1) {
+		DEBUG(1, ("IORING_REGISTER_PROBE failed: %s, kernel too "
+			  "old\n", strerror(errno)));
+		TALLOC_FREE(probe);
+		return false;
+	}
+
+	for (i=0; i<ARRAY_SIZE(needed); i++) {
+		uint8_t op = needed[i];
+
+		if ((op > probe->last_op) || (op >= probe->ops_len) ||
+		    !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+			DEBUG(1, ("io_uring opcode %u not supported\n",
+				  (unsigned)op));
+			TALLOC_FREE(probe);
+			return false;
+		}
+	}
+
+	TALLOC_FREE(probe);
+	return true;
+}
+
+static struct vfs_io_uring_ring *vfs_io_uring_ring_init(
+	struct tevent_context *ev, int snum)
+{
+	struct vfs_io_uring_ring *ring;
+	struct io_uring_params p;
+	int testing_mode;
+	int entries;
+	int num_files;
+	int i;
+	int ret;
+
+	ring = vfs_io_uring_ring;
+	if (ring != NULL) {
+		if (ring->pid == getpid()) {
+			return ring;
+		}
+		/*
+		 * We're a forked child, the ring belongs to the
+		 * parent. Stop watching it, but keep the memory, there
+		 * might still be requests pointing to it.
+		 */
+		TALLOC_FREE(ring->fde);
+		close(ring->fd);
+		close(ring->event_fd);
+		TALLOC_FREE(ring->retry_te);
+		talloc_set_destructor(ring, NULL);
+		vfs_io_uring_ring = NULL;
+		vfs_io_uring_unavailable = false;
+	}
+
+	if (vfs_io_uring_unavailable) {
+		return NULL;
+	}
+
+	entries = lp_parm_int(-1, "io_uring", "num entries", 128);
+	num_files = lp_parm_int(-1, "io_uring", "registered files", 64);
+	testing_mode = lp_parm_enum(snum, "io_uring", "testing mode",
+				    vfs_io_uring_testing_modes,
+				    VFS_IO_URING_TESTING_NONE);
+
+	ring = talloc_zero(NULL, struct vfs_io_uring_ring);
+	if (ring == NULL) {
+		return NULL;
+	}
+	ring->pid = getpid();
+	ring->fd = -1;
+	ring->event_fd = -1;
+	ring->ev = ev;
+	ring->erratic_testing_mode =
+		(testing_mode == VFS_IO_URING_TESTING_ERRATIC);
+	talloc_set_destructor(ring, vfs_io_uring_ring_destructor);
+
+	ZERO_STRUCT(p);
+	if (testing_mode == VFS_IO_URING_TESTING_UNSUPPORTED) {
+		errno = ENOSYS;
+	} else {
+		ring->fd = vfs_io_uring_setup(entries, &p);
+	}
+	if (ring->fd == -1) {
+		DEBUG(1, ("io_uring_setup(%d) failed: %s\n", entries,
+			  strerror(errno)));
+		goto fail;
+	}
+
+	if (!vfs_io_uring_probe(ring)) {
+		goto fail;
+	}
+
+	ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cq_size = p.cq_off.cqes +
+		p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->sq_size = MAX(ring->sq_size, ring->cq_size);
+		ring->cq_size = ring->sq_size;
+	}
+
+	ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ|PROT_WRITE,
+			    MAP_SHARED|MAP_POPULATE, ring->fd,
+			    IORING_OFF_SQ_RING);
+	if (ring->sq_ptr == MAP_FAILED) {
+		ring->sq_ptr = NULL;
+		goto fail_mmap;
+	}
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ptr = ring->sq_ptr;
+	} else {
+		ring->cq_ptr = mmap(NULL, ring->cq_size,
+				    PROT_READ|PROT_WRITE,
+				    MAP_SHARED|MAP_POPULATE, ring->fd,
+				    IORING_OFF_CQ_RING);
+		if (ring->cq_ptr == MAP_FAILED) {
+			ring->cq_ptr = NULL;
+			goto fail_mmap;
+		}
+	}
+
+	ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ|PROT_WRITE,
+			  MAP_SHARED|MAP_POPULATE, ring->fd,
+			  IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		ring->sqes = NULL;
+		goto fail_mmap;
+	}
+
+	ring->sq_head = (unsigned *)((char *)ring->sq_ptr + p.sq_off.head);
+	ring->sq_tail = (unsigned *)((char *)ring->sq_ptr + p.sq_off.tail);
+	ring->sq_mask = (unsigned *)((char *)ring->sq_ptr +
+				     p.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)((char *)ring->sq_ptr +
+				      p.sq_off.array);
+	ring->sq_entries = p.sq_entries;
+
+	ring->cq_head = (unsigned *)((char *)ring->cq_ptr + p.cq_off.head);
+	ring->cq_tail = (unsigned *)((char *)ring->cq_ptr + p.cq_off.tail);
+	ring->cq_mask = (unsigned *)((char *)ring->cq_ptr +
+				     p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ptr +
+					     p.cq_off.cqes);
+
+	ring->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (ring->event_fd == -1) {
+		DEBUG(1, ("eventfd failed: %s\n", strerror(errno)));
+		goto fail;
+	}
+	ret = vfs_io_uring_register(ring->fd, IORING_REGISTER_EVENTFD,
+				    &ring->event_fd, 1);
+	if (ret == -1) {
+		DEBUG(1, ("IORING_REGISTER_EVENTFD failed: %s\n",
+			  strerror(errno)));
+		goto fail;
+	}
+
+	ring->fde = tevent_add_fd(ev, ring, ring->event_fd, TEVENT_FD_READ,
+				  vfs_io_uring_complete, ring);
+	if (ring->fde == NULL) {
+		goto fail;
+	}
+	ring->im = tevent_create_immediate(ring);
+	if (ring->im == NULL) {
+		goto fail;
+	}
+
+	if (num_files > 0) {
+		ring->files = talloc_array(ring, int, num_files);
+		if (ring->files == NULL) {
+			goto fail;
+		}
+		for (i=0; i<num_files; i++) {
+			ring->files[i] = -1;
+		}
+		ret = vfs_io_uring_register(ring->fd,
+					    IORING_REGISTER_FILES,
+					    ring->files, num_files);
+		if (ret == 0) {
+			ring->num_files = num_files;
+		} else {
+			DEBUG(3, ("IORING_REGISTER_FILES failed: %s, "
+				  "not using registered files\n",
+				  strerror(errno)));
+			TALLOC_FREE(ring->files);
+		}
+	}
+
+	DEBUG(10, ("io_uring initialized with %u entries, "
+		   "%u registered files\n", ring->sq_entries,
+		   ring->num_files));
+
+	vfs_io_uring_ring = ring;
+	return ring;
+
+fail_mmap:
+	DEBUG(1, ("mmap of the io_uring failed: %s\n", strerror(errno)));
+fail:
+	TALLOC_FREE(ring);
+	DEBUG(1, ("Not using io_uring, passing requests to the next "
+		  "module\n"));
+	vfs_io_uring_unavailable = true;
+	return NULL;
+}
+
+/*
+ * Copy the prepared sqe into the submission queue. The caller
+ * has made sure there's room.
+ */
+static void vfs_io_uring_queue(struct vfs_io_uring_ring *ring,
+			       struct vfs_io_uring_request *ur)
+{
+	unsigned tail, idx;
+
+	tail = *ring->sq_tail;
+	idx = tail & *ring->sq_mask;
+
+	ring->sqes[idx] = ur->sqe;
+	ring->sqes[idx].user_data = (uint64_t)(uintptr_t)ur;
+	ring->sq_array[idx] = idx;
+
+	if (ring->erratic_testing_mode &&
+	    (ur->sqe.opcode == IORING_OP_READ ||
+	     ur->sqe.opcode == IORING_OP_WRITE) &&
+	    (ur->nread == 0) && (ur->sqe.len > 1)) {
+		/*
+		 * Only the queued copy is shortened, the request
+		 * sees a short read or write and resubmits the rest.
+		 */
+		ring->sqes[idx].len = ur->sqe.len / 2;
+	}
+
+	/* The kernel must see the sqe before the new tail */
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	ur->queued = true;
+	ring->num_unsubmitted += 1;
+	ring->num_inflight += 1;
+
+	if (!ring->submit_scheduled) {
+		tevent_schedule_immediate(ring->im, ring->ev,
+					  vfs_io_uring_submit, ring);
+		ring->submit_scheduled = true;
+	}
+}
+
+static void vfs_io_uring_finish(struct vfs_io_uring_ring *ring,
+				struct vfs_io_uring_request *ur);
+
+/*
+ * The kernel refused the sqes we put into the submission queue. We're
+ * the only producer and the kernel only looks at the queue within
+ * io_uring_enter(), so take them back and do them synchronously.
+ */
+static void vfs_io_uring_submit_sync(struct vfs_io_uring_ring *ring)
+{
+	struct vfs_io_uring_request *done = NULL;
+	struct vfs_io_uring_request *ur;
+	unsigned head, tail;
+
+	head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	tail = *ring->sq_tail;
+
+	for (; head != tail; head++) {
+		struct io_uring_sqe *sqe;
+		ssize_t ret = -1;
+		int fd;
+
+		sqe = &ring->sqes[ring->sq_array[head & *ring->sq_mask]];
+		ur = (struct vfs_io_uring_request *)(uintptr_t)sqe->user_data;
+
+		fd = sqe->fd;
+		if (sqe->flags & IOSQE_FIXED_FILE) {
+			fd = ring->files[fd];
+		}
+
+		switch (sqe->opcode) {
+		case IORING_OP_READ:
+			ret = sys_pread(fd, (void *)(uintptr_t)sqe->addr,
+					sqe->len, sqe->off);
+			break;
+		case IORING_OP_WRITE:
+			ret = sys_pwrite(fd,
+					 (const void *)(uintptr_t)sqe->addr,
+					 sqe->len, sqe->off);
+			break;
+		case IORING_OP_FSYNC:
+			ret = fsync(fd);
+			break;
+		default:
+			errno = EINVAL;
+			break;
+		}
+		ur->res = (ret == -1) ? -errno : ret;
+
+		DLIST_ADD_END(done, ur, struct vfs_io_uring_request *);
+	}
+
+	__atomic_store_n(ring->sq_tail, *ring->sq_head, __ATOMIC_RELEASE);
+	ring->num_unsubmitted = 0;
+
+	while ((ur = done) != NULL) {
+		DLIST_REMOVE(done, ur);
+		vfs_io_uring_finish(ring, ur);
+
+		if (vfs_io_uring_ring != ring) {
+			return;
+		}
+	}
+}
+
+static int vfs_io_uring_ring_enter(struct vfs_io_uring_ring *ring)
+{
+	if (ring->erratic_testing_mode) {
+		ring->num_enter += 1;
+		if ((ring->num_enter % 5) == 0) {
+			errno = EINVAL;
+			return -1;
+		}
+		if ((ring->num_enter % 3) == 0) {
+			errno = EAGAIN;
+			return -1;
+		}
+	}
+	return vfs_io_uring_enter(ring->fd, ring->num_unsubmitted, 0, 0);
+}
+
+static void vfs_io_uring_retry(struct tevent_context *ev,
+			       struct tevent_timer *te,
+			       struct timeval current_time,
+			       void *private_data)
+{
+	struct vfs_io_uring_ring *ring = talloc_get_type_abort(
+		private_data, struct vfs_io_uring_ring);
+
+	ring->retry_te = NULL;
+	vfs_io_uring_submit(ev, ring->im, ring);
+}
+
+static void vfs_io_uring_submit(struct tevent_context *ev,
+				struct tevent_immediate *im,
+				void *private_data)
+{
+	struct vfs_io_uring_ring *ring = talloc_get_type_abort(
+		private_data, struct vfs_io_uring_ring);
+	int ret;
+
+	ring->submit_scheduled = false;
+
+	while (ring->num_unsubmitted > 0) {
+		ret = vfs_io_uring_ring_enter(ring);
+		if (ret == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EBUSY) {
+				/*
+				 * The kernel is short of resources, try
+				 * again with the next completion. If
+				 * there is none to wait for, try again a
+				 * bit later.
+				 */
+				DEBUG(5, ("io_uring_enter: %s\n",
+					  strerror(errno)));
+				if ((ring->num_inflight >
+				     ring->num_unsubmitted) ||
+				    (ring->retry_te != NULL)) {
+					return;
+				}
+				ring->retry_te = tevent_add_timer(
+					ring->ev, ring,
+					timeval_current_ofs_msec(10),
+					vfs_io_uring_retry, ring);
+				if (ring->retry_te != NULL) {
+					return;
+				}
+			}
+			DEBUG(1, ("io_uring_enter failed: %s, doing %u "
+				  "requests synchronously\n",
+				  strerror(errno), ring->num_unsubmitted));
+			vfs_io_uring_submit_sync(ring);
+			return;
+		}
+		ring->num_unsubmitted -= ret;
+	}
+}
+
+static void vfs_io_uring_start(struct vfs_io_uring_ring *ring,
+			       struct vfs_io_uring_request *ur)
+{
+	if (ring->num_inflight >= ring->sq_entries) {
+		DLIST_ADD_END(ring->waiting, ur, struct vfs_io_uring_request *);
+		return;
+	}
+	vfs_io_uring_queue(ring, ur);
+}
+
+static void vfs_io_uring_complete(struct tevent_context *ev,
+				  struct tevent_fd *fde,
+				  uint16_t flags, void *private_data)
+{
+	struct vfs_io_uring_ring *ring = talloc_get_type_abort(
+		private_data, struct vfs_io_uring_ring);
+	uint64_t num_events;
+	unsigned head, tail;
+
+	/*
+	 * Just reset the eventfd, the completion queue
+	 * tells us what's done.
+	 */
+	(void)sys_read(ring->event_fd, &num_events, sizeof(num_events));
+
+	head = *ring->cq_head;
+	tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+	while (head != tail) {
+		struct io_uring_cqe *cqe;
+		struct vfs_io_uring_request *ur;
+		int res;
+
+		cqe = &ring->cqes[head & *ring->cq_mask];
+		ur = (struct vfs_io_uring_request *)(uintptr_t)cqe->user_data;
+		res = cqe->res;
+
+		head += 1;
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+		ur->res = res;
+		vfs_io_uring_finish(ring, ur);
+
+		/*
+		 * The callback might have put new requests into the
+		 * ring, or freed it.
+		 */
+		if (vfs_io_uring_ring != ring) {
+			return;
+		}
+		tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+	}
+
+	if (ring->num_unsubmitted > 0 && !ring->submit_scheduled) {
+		/* A previous io_uring_enter ran out of resources */
+		vfs_io_uring_submit(ev, ring->im, ring);
+	}
+}
+
+/*
+ * A request left the kernel or was done synchronously, ur->res is
+ * its result. Short reads and writes are resubmitted for the rest.
+ */
+static void vfs_io_uring_finish(struct vfs_io_uring_ring *ring,
+				struct vfs_io_uring_request *ur)
+{
+	struct vfs_io_uring_state *state;
+	struct tevent_req *req = ur->req;
+	int res = ur->res;
+
+	ring->num_inflight -= 1;
+
+	if (ring->waiting != NULL) {
+		struct vfs_io_uring_request *w = ring->waiting;
+		DLIST_REMOVE(ring->waiting, w);
+		vfs_io_uring_queue(ring, w);
+	}
+
+	if (req == NULL) {
+		/* The caller went away */
+		TALLOC_FREE(ur);
+		return;
+	}
+
+	if ((ur->sqe.opcode == IORING_OP_READ ||
+	     ur->sqe.opcode == IORING_OP_WRITE) &&
+	    (res > 0) && ((uint32_t)res < ur->sqe.len)) {
+		/*
+		 * A read returns 0 at the end of file, so a short read
+		 * does not tell us we're there yet.
+		 */
+		ur->nread += res;
+		ur->sqe.addr += res;
+		ur->sqe.len -= res;
+		ur->sqe.off += res;
+		ur->queued = false;
+		vfs_io_uring_start(ring, ur);
+		return;
+	}
+
+	if (ur->nread > 0) {
+		/* Report what the earlier parts did */
+		res = (res < 0) ? ur->nread : ur->nread + res;
+	}
+
+	TALLOC_FREE(ur);
+
+	state = tevent_req_data(req, struct vfs_io_uring_state);
+	state->ur = NULL;
+	if (res < 0) {
+		state->ret = -1;
+		state->err = -res;
+	} else {
+		state->ret = res;
+		state->err = 0;
+	}
+	tevent_req_done(req);
+}
+
+static int vfs_io_uring_state_destructor(struct vfs_io_uring_state *state)
+{
+	struct vfs_io_uring_request *ur = state->ur;
+
+	if (ur == NULL) {
+		return 0;
+	}
+	state->ur = NULL;
+	ur->req = NULL;
+
+	if (ur->queued) {
+		/* Wait for the kernel to give up the buffer */
+		return 0;
+	}
+	DLIST_REMOVE(ur->ring->waiting, ur);
+	TALLOC_FREE(ur);
+	return 0;
+}
+
+static void vfs_io_uring_fsp_destroy(void *p_data)
+{
+	struct vfs_io_uring_fsp *ext = (struct vfs_io_uring_fsp *)p_data;
+	struct vfs_io_uring_ring *ring = ext->ring;
+	int fd = -1;
+	int ret;
+
+	if (ring != vfs_io_uring_ring || ring->files == NULL) {
+		return;
+	}
+
+	/*
+	 * The registered file holds a reference on the open file,
+	 * release it before the real close.
+	 */
+	ret = vfs_io_uring_register(ring->fd, IORING_REGISTER_FILES_UPDATE,
+				    &(struct io_uring_files_update) {
+					    .offset = ext->slot,
+					    .fds = (uint64_t)(uintptr_t)&fd,
+				    }, 1);
+	if (ret == -1) {
+		DEBUG(1, ("unregistering file slot %u failed: %s\n",
+			  ext->slot, strerror(errno)));
+		return;
+	}
+	ring->files[ext->slot] = -1;
+}
+
+/*
+ * Fill in the file of the sqe, use a registered file if possible.
+ */
+static void vfs_io_uring_prep_file(struct vfs_handle_struct *handle,
+				   struct vfs_io_uring_ring *ring,
+				   struct files_struct *fsp,
+				   struct io_uring_sqe *sqe)
+{
+	struct vfs_io_uring_fsp *ext;
+	unsigned slot;
+	int fd = fsp->fh->fd;
+	int ret;
+
+	ext = (struct vfs_io_uring_fsp *)VFS_FETCH_FSP_EXTENSION(handle, fsp);
+	if (ext != NULL && ext->ring == ring) {
+		sqe->fd = ext->slot;
+		sqe->flags |= IOSQE_FIXED_FILE;
+		return;
+	}
+
+	sqe->fd = fd;
+
+	if (ext != NULL || ring->files == NULL) {
+		return;
+	}
+
+	for (slot=0; slot<ring->num_files; slot++) {
+		if (ring->files[slot] == -1) {
+			break;
+		}
+	}
+	if (slot == ring->num_files) {
+		/* Table is full, use the plain fd */
+		return;
+	}
+
+	ret = vfs_io_uring_register(ring->fd, IORING_REGISTER_FILES_UPDATE,
+				    &(struct io_uring_files_update) {
+					    .offset = slot,
+					    .fds = (uint64_t)(uintptr_t)&fd,
+				    }, 1);
+	if (ret != 1) {
+		DEBUG(5, ("registering %s in slot %u failed: %s\n",
+			  fsp_str_dbg(fsp), slot, strerror(errno)));
+		return;
+	}
+
+	ext = (struct vfs_io_uring_fsp *)VFS_ADD_FSP_EXTENSION(
+		handle, fsp, struct vfs_io_uring_fsp,
+		vfs_io_uring_fsp_destroy);
+	if (ext == NULL) {
+		fd = -1;
+		vfs_io_uring_register(ring->fd, IORING_REGISTER_FILES_UPDATE,
+				      &(struct io_uring_files_update) {
+					      .offset = slot,
+					      .fds = (uint64_t)(uintptr_t)&fd,
+				      }, 1);
+		return;
+	}
+	ext->ring = ring;
+	ext->slot = slot;
+	ring->files[slot] = fsp->fh->fd;
+
+	sqe->fd = slot;
+	sqe->flags |= IOSQE_FIXED_FILE;
+}
+
+/*
+ * Returns the request and the prepared io_uring request. If the
+ * ring is not available, *pur is NULL and the caller has to pass
+ * the operation down the VFS stack.
+ */
+static struct tevent_req *vfs_io_uring_create(
+	struct vfs_handle_struct *handle, TALLOC_CTX *mem_ctx,
+	struct tevent_context *ev, struct files_struct *fsp,
+	struct vfs_io_uring_request **pur)
+{
+	struct tevent_req *req;
+	struct vfs_io_uring_state *state;
+	struct vfs_io_uring_ring *ring;
+	struct vfs_io_uring_request *ur;
+
+	*pur = NULL;
+
+	req = tevent_req_create(mem_ctx, &state, struct vfs_io_uring_state);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	ring = vfs_io_uring_ring_init(handle->conn->sconn->ev_ctx,
+				      SNUM(handle->conn));
+	if (ring == NULL) {
+		return req;
+	}
+
+	ur = talloc_zero(ring, struct vfs_io_uring_request);
+	if (ur == NULL) {
+		TALLOC_FREE(req);
+		return NULL;
+	}
+	ur->ring = ring;
+	ur->req = req;
+	state->ur = ur;
+	talloc_set_destructor(state, vfs_io_uring_state_destructor);
+
+	vfs_io_uring_prep_file(handle, ring, fsp, &ur->sqe);
+
+	*pur = ur;
+	return req;
+}
+
+static void vfs_io_uring_pread_done(struct tevent_req *subreq);
+
+static struct tevent_req *vfs_io_uring_pread_send(
+	struct vfs_handle_struct *handle, TALLOC_CTX *mem_ctx,
+	struct tevent_context *ev, struct files_struct *fsp,
+	void *data, size_t n, off_t offset)
+{
+	struct tevent_req *req, *subreq;
+	struct vfs_io_uring_state *state;
+	struct vfs_io_uring_request *ur;
+
+	req = vfs_io_uring_create(handle, mem_ctx, ev, fsp, &ur);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	if (ur == NULL) {
+		state = tevent_req_data(req, struct vfs_io_uring_state);
+		subreq = SMB_VFS_NEXT_PREAD_SEND(state, ev, handle, fsp,
+						 data, n, offset);
+		if (tevent_req_nomem(subreq, req)) {
+			return tevent_req_post(req, ev);
+		}
+		tevent_req_set_callback(subreq, vfs_io_uring_pread_done, req);
+		return req;
+	}
+
+	ur->sqe.opcode = IORING_OP_READ;
+	ur->sqe.addr = (uint64_t)(uintptr_t)data;
+	ur->sqe.len = n;
+	ur->sqe.off = offset;
+
+	vfs_io_uring_start(ur->ring, ur);
+	return req;
+}
+
+static void vfs_io_uring_pread_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct vfs_io_uring_state *state = tevent_req_data(
+		req, struct vfs_io_uring_state);
+
+	state->ret = SMB_VFS_PREAD_RECV(subreq, &state->err);
+	TALLOC_FREE(subreq);
+	tevent_req_done(req);
+}
+
+static void vfs_io_uring_pwrite_done(struct tevent_req *subreq);
+
+static struct tevent_req *vfs_io_uring_pwrite_send(
+	struct vfs_handle_struct *handle, TALLOC_CTX *mem_ctx,
+	struct tevent_context *ev, struct files_struct *fsp,
+	const void *data, size_t n, off_t offset)
+{
+	struct tevent_req *req, *subreq;
+	struct vfs_io_uring_state *state;
+	struct vfs_io_uring_request *ur;
+
+	req = vfs_io_uring_create(handle, mem_ctx, ev, fsp, &ur);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	if (ur == NULL) {
+		state = tevent_req_data(req, struct vfs_io_uring_state);
+		subreq = SMB_VFS_NEXT_PWRITE_SEND(state, ev, handle, fsp,
+						  data, n, offset);
+		if (tevent_req_nomem(subreq, req)) {
+			return tevent_req_post(req, ev);
+		}
+		tevent_req_set_callback(subreq, vfs_io_uring_pwrite_done, req);
+		return req;
+	}
+
+	ur->sqe.opcode = IORING_OP_WRITE;
+	ur->sqe.addr = (uint64_t)(uintptr_t)data;
+	ur->sqe.len = n;
+	ur->sqe.off = offset;
+
+	vfs_io_uring_start(ur->ring, ur);
+	return req;
+}
+
+static void vfs_io_uring_pwrite_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct vfs_io_uring_state *state = tevent_req_data(
+		req, struct vfs_io_uring_state);
+
+	state->ret = SMB_VFS_PWRITE_RECV(subreq, &state->err);
+	TALLOC_FREE(subreq);
+	tevent_req_done(req);
+}
+
+static void vfs_io_uring_fsync_done(struct tevent_req *subreq);
+
+static struct tevent_req *vfs_io_uring_fsync_send(
+	struct vfs_handle_struct *handle, TALLOC_CTX *mem_ctx,
+	struct tevent_context *ev, struct files_struct *fsp)
+{
+	struct tevent_req *req, *subreq;
+	struct vfs_io_uring_state *state;
+	struct vfs_io_uring_request *ur;
+
+	req = vfs_io_uring_create(handle, mem_ctx, ev, fsp, &ur);
+	if (req == NULL) {
+		return NULL;
+	}
+
+	if (ur == NULL) {
+		state = tevent_req_data(req, struct vfs_io_uring_state);
+		subreq = SMB_VFS_NEXT_FSYNC_SEND(state, ev, handle, fsp);
+		if (tevent_req_nomem(subreq, req)) {
+			return tevent_req_post(req, ev);
+		}
+		tevent_req_set_callback(subreq, vfs_io_uring_fsync_done, req);
+		return req;
+	}
+
+	ur->sqe.opcode = IORING_OP_FSYNC;
+
+	vfs_io_uring_start(ur->ring, ur);
+	return req;
+}
+
+static void vfs_io_uring_fsync_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct vfs_io_uring_state *state = tevent_req_data(
+		req, struct vfs_io_uring_state);
+
+	state->ret = SMB_VFS_FSYNC_RECV(subreq, &state->err);
+	TALLOC_FREE(subreq);
+	tevent_req_done(req);
+}
+
+static ssize_t vfs_io_uring_recv(struct tevent_req *req, int *err)
+{
+	struct vfs_io_uring_state *state = tevent_req_data(
+		req, struct vfs_io_uring_state);
+
+	if (tevent_req_is_unix_error(req, err)) {
+		return -1;
+	}
+	if (state->ret == -1) {
+		*err = state->err;
+	}
+	return state->ret;
+}
+
+static int vfs_io_uring_int_recv(struct tevent_req *req, int *err)
+{
+	/*
+	 * Use implicit conversion ssize_t->int
+	 */
+	return vfs_io_uring_recv(req, err);
+}
+
+static int vfs_io_uring_connect(vfs_handle_struct *handle,
+				const char *service, const char *user)
+{
+	int ret;
+
+	ret = SMB_VFS_NEXT_CONNECT(handle, service, user);
+	if (ret < 0) {
+		return ret;
+	}
+
+	/*
+	 * Find out now whether the kernel can do what we need, not
+	 * with the first read. Without a ring, requests go to the next
+	 * module.
+	 */
+	(void)vfs_io_uring_ring_init(handle->conn->sconn->ev_ctx,
+				     SNUM(handle->conn));
+
+	return 0;
+}
+
+static int vfs_io_uring_close(vfs_handle_struct *handle, files_struct *fsp)
+{
+	VFS_REMOVE_FSP_EXTENSION(handle, fsp);
+	return SMB_VFS_NEXT_CLOSE(handle, fsp);
+}
+
+static struct vfs_fn_pointers vfs_io_uring_fns = {
+	.connect_fn = vfs_io_uring_connect,
+	.close_fn = vfs_io_uring_close,
+	.pread_send_fn = vfs_io_uring_pread_send,
+	.pread_recv_fn = vfs_io_uring_recv,
+	.pwrite_send_fn = vfs_io_uring_pwrite_send,
+	.pwrite_recv_fn = vfs_io_uring_recv,
+	.fsync_send_fn = vfs_io_uring_fsync_send,
+	.fsync_recv_fn = vfs_io_uring_int_recv,
+};
+
+NTSTATUS vfs_io_uring_init(void)
+{
+	return smb_register_vfs(SMB_VFS_INTERFACE_VERSION,
+				"io_uring", &vfs_io_uring_fns);
+}
@@ -155,6 +155,7 @@ static struct loadparm_service sDefault =
 	.vfs_objects = NULL,
 	.msdfs_proxy = NULL,
 	.aio_write_behind = NULL,
+	.aio_metadata = false,
 	.dfree_command = NULL,
 	.min_print_space = 0,
 	.iMaxPrintJobs = 1000,
@@ -690,6 +691,7 @@ static void init_globals(struct loadparm_context *lp_ctx, bool reinit_globals)
 	Globals.nt_status_support = true; /* Use NT status by default. */
 	Globals.stat_cache = true;	/* use stat cache by default */
 	Globals.max_stat_cache_size = 256; /* 256k by default */
+	Globals.directory_cache_size = 0;
 	Globals.restrict_anonymous = 0;
 	Globals.client_lanman_auth = false;	/* Do NOT use the LanMan hash if it is available */
 	Globals.client_plaintext_auth = false;	/* Do NOT use a plaintext password even if is requested by the server */
@@ -855,6 +857,8 @@ static void init_globals(struct loadparm_context *lp_ctx, bool reinit_globals)
 	Globals.smb2_max_trans = DEFAULT_SMB2_MAX_TRANSACT;
 	Globals.ismb2_max_credits = DEFAULT_SMB2_MAX_CREDITS;
 	Globals.smb2_leases = false;
+	Globals.smb2_worker_threads = 0;
+	Globals.server_multi_channel_support = false;
 
 	string_set(Globals.ctx, &Globals.ncalrpc_dir, get_dyn_NCALRPCDIR());
 
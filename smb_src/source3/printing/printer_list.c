@@ -21,6 +21,7 @@
 #include "system/filesys.h"
 #include "dbwrap/dbwrap.h"
 #include "dbwrap/dbwrap_open.h"
+#include "dbwrap/dbwrap_writebehind.h"
 #include "util_tdb.h"
 #include "printer_list.h"
 
@@ -42,6 +43,27 @@ static struct db_context *get_printer_list_db(void)
 		     TDB_DEFAULT|TDB_CLEAR_IF_FIRST|TDB_INCOMPATIBLE_HASH,
 		     O_RDWR|O_CREAT, 0644, DBWRAP_LOCK_ORDER_1,
 		     DBWRAP_FLAG_NONE);
+	if (db == NULL) {
+		return NULL;
+	}
+
+	/*
+	 * A printcap reload stores every printer one by one. Only the
+	 * process doing the reload writes, and printer_list_clean_old()
+	 * traverses the db, which writes the buffer out.
+	 */
+	if (lp_parm_bool(-1, "dbwrap_writebehind", "printer_list", false)) {
+		struct db_context *wb;
+
+		wb = db_open_writebehind(NULL, server_event_context(), &db,
+					 1000, 1000);
+		if (wb == NULL) {
+			DEBUG(1, ("db_open_writebehind failed, using "
+				  "printer_list.tdb directly\n"));
+			return db;
+		}
+		db = wb;
+	}
 	return db;
 }
 
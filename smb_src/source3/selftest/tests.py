@@ -78,6 +78,24 @@ tests = ["RW1", "RW2", "RW3"]
 for t in tests:
     plantestsuite("samba3.smbtorture_s3.vfs_aio_fork(simpleserver).%s" % t, "simpleserver", [os.path.join(samba3srcdir, "script/tests/test_smbtorture_s3.sh"), t, '//$SERVER_IP/vfs_aio_fork', '$USERNAME', '$PASSWORD', smbtorture3, "", "-l $LOCAL_PATH"])
 
+# vfs_io_uring is only built on Linux with io_uring support
+try:
+    config_h = os.environ["CONFIG_H"]
+except KeyError:
+    config_h = os.path.join(samba4bindir, "default/include/config.h")
+f = open(config_h, 'r')
+try:
+    have_io_uring = ("HAVE_LINUX_IO_URING 1" in f.read())
+finally:
+    f.close()
+
+if have_io_uring:
+    # the erratic and unsupported shares go through the fallback paths
+    for share in ["vfs_io_uring", "vfs_io_uring_erratic", "vfs_io_uring_unsupported"]:
+        for t in tests:
+            plantestsuite("samba3.smbtorture_s3.%s(simpleserver).%s" % (share, t), "simpleserver", [os.path.join(samba3srcdir, "script/tests/test_smbtorture_s3.sh"), t, '//$SERVER_IP/%s' % share, '$USERNAME', '$PASSWORD', smbtorture3, "", "-l $LOCAL_PATH"])
+        plansmbtorture4testsuite("smb2.read", "simpleserver", '//$SERVER_IP/%s -U$USERNAME%%$PASSWORD' % share, share)
+
 posix_tests = ["POSIX", "POSIX-APPEND"]
 
 for t in posix_tests:
@@ -106,6 +124,8 @@ local_tests = [
     "LOCAL-CONVERT-STRING",
     "LOCAL-CONV-AUTH-INFO",
     "LOCAL-IDMAP-TDB-COMMON",
+    "LOCAL-DBWRAP-SHARDED",
+    "LOCAL-DBWRAP-WRITEBEHIND",
     "LOCAL-MESSAGING-READ1",
     "LOCAL-MESSAGING-READ2",
     "LOCAL-MESSAGING-READ3",
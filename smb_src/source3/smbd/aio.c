@@ -676,7 +676,6 @@ static void aio_pread_smb2_done(struct tevent_req *req);
 NTSTATUS schedule_smb2_aio_read(connection_struct *conn,
 				struct smb_request *smbreq,
 				files_struct *fsp,
-				TALLOC_CTX *ctx,
 				DATA_BLOB *preadbuf,
 				off_t startpos,
 				size_t smb_maxcnt)
@@ -718,10 +717,9 @@ NTSTATUS schedule_smb2_aio_read(connection_struct *conn,
 		return NT_STATUS_RETRY;
 	}
 
-	/* Create the out buffer. */
-	*preadbuf = data_blob_talloc(ctx, NULL, smb_maxcnt);
-	if (preadbuf->data == NULL) {
-		return NT_STATUS_NO_MEMORY;
+	/* The out buffer is provided by the caller. */
+	if (preadbuf->length < smb_maxcnt) {
+		return NT_STATUS_INTERNAL_ERROR;
 	}
 
 	if (!(aio_ex = create_aio_extra(smbreq->smb2req, fsp, 0))) {
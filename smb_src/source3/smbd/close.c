@@ -29,6 +29,7 @@
 #include "transfer_file.h"
 #include "auth.h"
 #include "messages.h"
+#include "lib/dbwrap/dbwrap.h"
 #include "../librpc/gen_ndr/open_files.h"
 
 /****************************************************************************
@@ -593,6 +594,57 @@ static NTSTATUS ntstatus_keeperror(NTSTATUS s1, NTSTATUS s2)
 	return s2;
 }
 
+/****************************************************************************
+ In a cluster, closing a file locks its locking.tdb, brlock.tdb and
+ smbXsrv_open_global.tdb records one after the other, each of which might
+ have to be migrated from another node first. Migrate them together.
+****************************************************************************/
+
+static void close_prefetch_records(files_struct *fsp)
+{
+	TALLOC_CTX *frame;
+	struct db_context *dbs[3];
+	TDB_DATA keys[3];
+	size_t num_keys = 0;
+	NTSTATUS status;
+
+	if (!lp_clustering()) {
+		return;
+	}
+
+	frame = talloc_stackframe();
+
+	if ((fsp->fh->ref_count == 1) &&
+	    share_mode_lock_prefetch_key(&fsp->file_id, &dbs[num_keys],
+					 &keys[num_keys])) {
+		num_keys += 1;
+	}
+
+	if (lp_locking(fsp->conn->params) &&
+	    (fsp->current_lock_count != 0) &&
+	    brl_prefetch_key(fsp, &dbs[num_keys], &keys[num_keys])) {
+		num_keys += 1;
+	}
+
+	if ((fsp->op != NULL) &&
+	    smbXsrv_open_close_prefetch_key(frame, fsp->op, &dbs[num_keys],
+					    &keys[num_keys])) {
+		num_keys += 1;
+	}
+
+	if (num_keys < 2) {
+		TALLOC_FREE(frame);
+		return;
+	}
+
+	status = dbwrap_prefetch_locked(dbs, keys, num_keys);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(5, ("dbwrap_prefetch_locked failed for %s: %s\n",
+			  fsp_str_dbg(fsp), nt_errstr(status)));
+	}
+	TALLOC_FREE(frame);
+}
+
 /****************************************************************************
  Close a file.
 
@@ -733,6 +785,8 @@ static NTSTATUS close_normal_file(struct smb_request *req, files_struct *fsp,
 		return NT_STATUS_OK;
 	}
 
+	close_prefetch_records(fsp);
+
 	/* Remove the oplock before potentially deleting the file. */
 	if(fsp->oplock_type) {
 		remove_oplock(fsp);
@@ -26,6 +26,7 @@
 #include "lib/util/bitmap.h"
 #include "../lib/util/memcache.h"
 #include "../librpc/gen_ndr/open_files.h"
+#include "../lib/util/tevent_ntstatus.h"
 
 /*
    This module implements directory related functions for Samba.
@@ -59,6 +60,14 @@ struct smb_Dir {
 	unsigned int file_number;
 	files_struct *fsp; /* Back pointer to containing fsp, only
 			      set from OpenDir_fsp(). */
+	/*
+	 * Cached listing, either served from (cache_serve) or
+	 * being built while reading. cache_idx is the position
+	 * of the next entry. When serving, offsets are positions.
+	 */
+	struct dircache_dir *cache;
+	bool cache_serve;
+	size_t cache_idx;
 };
 
 struct dptr_struct {
@@ -76,6 +85,27 @@ struct dptr_struct {
 	bool priv;     /* Directory handle opened with privilege. */
 	uint32_t counter;
 	struct memcache *dptr_cache;
+	struct dptr_prefetch *prefetch;
+};
+
+/*
+ * Results of dptr_prefetch_send() for the next entries of a dptr.
+ */
+struct dptr_prefetch_entry {
+	char *name;
+	struct smb_filename *smb_fname;
+	int stat_ret;
+	bool have_dosattrib;
+	ssize_t dosattrib_len;
+	char dosattrib[sizeof(fstring)];
+	struct tevent_req *req;
+};
+
+struct dptr_prefetch {
+	struct dptr_prefetch_entry *entries;
+	size_t num_entries;
+	size_t next;
+	struct dptr_prefetch_entry *current;
 };
 
 static struct smb_Dir *OpenDir_fsp(TALLOC_CTX *mem_ctx, connection_struct *conn,
@@ -859,6 +889,282 @@ void dptr_init_search_op(struct dptr_struct *dptr)
 	SMB_VFS_INIT_SEARCH_OP(dptr->conn, dptr->dir_hnd->dir);
 }
 
+/****************************************************************************
+ Read the next names of a wildcard search and stat them and fetch their
+ DOS attribute EA in parallel, the VFS decides whether that happens in
+ helper threads. The directory position is left unchanged,
+ smbd_dirptr_get_entry() picks up the results once dptr_prefetch_recv()
+ attached them to the dptr.
+****************************************************************************/
+
+struct dptr_prefetch_state {
+	struct dptr_prefetch *pf;
+	size_t num_pending;
+};
+
+static void dptr_prefetch_stat_done(struct tevent_req *subreq);
+static void dptr_prefetch_getxattr_done(struct tevent_req *subreq);
+
+struct tevent_req *dptr_prefetch_send(TALLOC_CTX *mem_ctx,
+				      struct tevent_context *ev,
+				      struct dptr_struct *dptr,
+				      size_t max_entries)
+{
+	struct tevent_req *req, *subreq;
+	struct dptr_prefetch_state *state;
+	struct smb_Dir *dirp = dptr->dir_hnd;
+	connection_struct *conn = dptr->conn;
+	bool get_dosattrib = lp_store_dos_attributes(SNUM(conn));
+	long saved_offset;
+	unsigned int saved_file_number;
+	long offset;
+	size_t i;
+
+	req = tevent_req_create(mem_ctx, &state, struct dptr_prefetch_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	state->pf = talloc_zero(state, struct dptr_prefetch);
+	if (tevent_req_nomem(state->pf, req)) {
+		return tevent_req_post(req, ev);
+	}
+
+	if (!dptr->has_wild || (dirp->offset == END_OF_DIRECTORY_OFFSET) ||
+	    (max_entries == 0)) {
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
+	}
+
+	state->pf->entries = talloc_zero_array(
+		state->pf, struct dptr_prefetch_entry, max_entries);
+	if (tevent_req_nomem(state->pf->entries, req)) {
+		return tevent_req_post(req, ev);
+	}
+
+	/*
+	 * The . and .. entries are tracked by file_number, not by
+	 * the offset, so remember both.
+	 */
+	saved_offset = dirp->offset;
+	saved_file_number = dirp->file_number;
+	offset = saved_offset;
+
+	for (i = 0; i < max_entries; i++) {
+		struct dptr_prefetch_entry *e = &state->pf->entries[i];
+		SMB_STRUCT_STAT st;
+		char *path;
+
+		e->name = dptr_ReadDirName(state->pf->entries, dptr,
+					   &offset, &st);
+		if (e->name == NULL) {
+			break;
+		}
+		state->pf->num_entries += 1;
+		e->req = req;
+		e->stat_ret = -1;
+
+		if (!mask_match_search(e->name, dptr->wcard,
+				       conn->case_sensitive)) {
+			/* Probably not asked for, don't waste a stat */
+			continue;
+		}
+
+		path = talloc_asprintf(talloc_tos(), "%s/%s",
+				       dptr->path, e->name);
+		if (path == NULL) {
+			break;
+		}
+		e->smb_fname = synthetic_smb_fname(state->pf->entries, path,
+						   NULL, &st);
+		TALLOC_FREE(path);
+		if (e->smb_fname == NULL) {
+			break;
+		}
+
+		if (VALID_STAT(st)) {
+			/* The readdir call already did the stat */
+			e->stat_ret = 0;
+		} else {
+			subreq = SMB_VFS_STAT_SEND(state->pf->entries, ev,
+						   conn, e->smb_fname);
+			if (subreq == NULL) {
+				break;
+			}
+			tevent_req_set_callback(
+				subreq, dptr_prefetch_stat_done, e);
+			state->num_pending += 1;
+		}
+
+		if (get_dosattrib) {
+			subreq = SMB_VFS_GETXATTR_SEND(
+				state->pf->entries, ev, conn, e->smb_fname->base_name,
+				SAMBA_XATTR_DOS_ATTRIB, e->dosattrib,
+				sizeof(e->dosattrib));
+			if (subreq == NULL) {
+				break;
+			}
+			tevent_req_set_callback(
+				subreq, dptr_prefetch_getxattr_done, e);
+			state->num_pending += 1;
+		}
+	}
+
+	SeekDir(dirp, saved_offset);
+	dirp->file_number = saved_file_number;
+
+	DEBUG(10, ("dptr_prefetch_send: %s: %u entries, %u requests\n",
+		   dptr->path, (unsigned)state->pf->num_entries,
+		   (unsigned)state->num_pending));
+
+	if (state->num_pending == 0) {
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
+	}
+	return req;
+}
+
+static void dptr_prefetch_stat_done(struct tevent_req *subreq)
+{
+	struct dptr_prefetch_entry *e = tevent_req_callback_data(
+		subreq, struct dptr_prefetch_entry);
+	struct tevent_req *req = e->req;
+	struct dptr_prefetch_state *state = tevent_req_data(
+		req, struct dptr_prefetch_state);
+	int err;
+
+	e->stat_ret = SMB_VFS_STAT_RECV(subreq, &err);
+	TALLOC_FREE(subreq);
+
+	state->num_pending -= 1;
+	if (state->num_pending == 0) {
+		tevent_req_done(req);
+	}
+}
+
+static void dptr_prefetch_getxattr_done(struct tevent_req *subreq)
+{
+	struct dptr_prefetch_entry *e = tevent_req_callback_data(
+		subreq, struct dptr_prefetch_entry);
+	struct tevent_req *req = e->req;
+	struct dptr_prefetch_state *state = tevent_req_data(
+		req, struct dptr_prefetch_state);
+	int err;
+
+	e->dosattrib_len = SMB_VFS_GETXATTR_RECV(subreq, &err);
+	TALLOC_FREE(subreq);
+
+	/*
+	 * Only a missing EA is a result worth keeping, leave
+	 * everything else to the synchronous path in dos_mode().
+	 */
+	if ((e->dosattrib_len != -1) || (err == ENOATTR)) {
+		e->have_dosattrib = true;
+	}
+
+	state->num_pending -= 1;
+	if (state->num_pending == 0) {
+		tevent_req_done(req);
+	}
+}
+
+NTSTATUS dptr_prefetch_recv(struct tevent_req *req, struct dptr_struct *dptr)
+{
+	struct dptr_prefetch_state *state = tevent_req_data(
+		req, struct dptr_prefetch_state);
+	NTSTATUS status;
+
+	if (tevent_req_is_nterror(req, &status)) {
+		tevent_req_received(req);
+		return status;
+	}
+	if (dptr != NULL) {
+		TALLOC_FREE(dptr->prefetch);
+		dptr->prefetch = talloc_move(dptr, &state->pf);
+	}
+	tevent_req_received(req);
+	return NT_STATUS_OK;
+}
+
+void dptr_prefetch_clear(struct dptr_struct *dptr)
+{
+	TALLOC_FREE(dptr->prefetch);
+}
+
+/*
+ * Find the prefetched entry for a name just read from the directory,
+ * usually the next one in the list.
+ */
+static void dptr_prefetch_lookup(struct dptr_struct *dptr, const char *name,
+				 SMB_STRUCT_STAT *pst)
+{
+	struct dptr_prefetch *pf = dptr->prefetch;
+	struct dptr_prefetch_entry *e = NULL;
+	size_t i;
+
+	pf->current = NULL;
+
+	for (i = 0; i < pf->num_entries; i++) {
+		size_t idx = (pf->next + i) % pf->num_entries;
+
+		if (strcmp(pf->entries[idx].name, name) == 0) {
+			e = &pf->entries[idx];
+			pf->next = idx + 1;
+			break;
+		}
+	}
+	if ((e == NULL) || (e->smb_fname == NULL)) {
+		return;
+	}
+
+	pf->current = e;
+
+	if (!VALID_STAT(*pst) && (e->stat_ret == 0)) {
+		*pst = e->smb_fname->st;
+	}
+}
+
+/****************************************************************************
+ Return the prefetched DOS attribute EA of the entry last returned by
+ smbd_dirptr_get_entry(). False if there is none, blob->data is NULL
+ if the file has no such EA.
+****************************************************************************/
+
+bool dptr_prefetched_dosattrib(struct dptr_struct *dptr, DATA_BLOB *blob)
+{
+	struct dptr_prefetch_entry *e;
+
+	if ((dptr->prefetch == NULL) || (dptr->prefetch->current == NULL)) {
+		return false;
+	}
+	e = dptr->prefetch->current;
+	if (!e->have_dosattrib) {
+		return false;
+	}
+	if (e->dosattrib_len == -1) {
+		*blob = data_blob_null;
+	} else {
+		*blob = data_blob_const(e->dosattrib, e->dosattrib_len);
+	}
+	return true;
+}
+
+/****************************************************************************
+ Remember the stat of the entry last read from the directory in its
+ cached listing.
+****************************************************************************/
+
+void dptr_set_entry_stat(struct dptr_struct *dptr, const char *name,
+			 const SMB_STRUCT_STAT *st)
+{
+	struct smb_Dir *dirp = dptr->dir_hnd;
+
+	if ((dirp == NULL) || (dirp->cache == NULL) ||
+	    (dirp->cache_idx == 0)) {
+		return;
+	}
+	dircache_set_stat(dirp->cache, dirp->cache_idx - 1, name, st);
+}
+
 /****************************************************************************
  Map a native directory offset to a 32-bit cookie.
 ****************************************************************************/
@@ -1101,6 +1407,10 @@ bool smbd_dirptr_get_entry(TALLOC_CTX *ctx,
 			return false;
 		}
 
+		if (dirptr->prefetch != NULL) {
+			dptr_prefetch_lookup(dirptr, dname, &sbuf);
+		}
+
 		isdots = (ISDOT(dname) || ISDOTDOT(dname));
 		if (dont_descend && !isdots) {
 			TALLOC_FREE(dname);
@@ -1498,6 +1808,8 @@ bool is_visible_file(connection_struct *conn, const char *dir_path,
 
 static int smb_Dir_destructor(struct smb_Dir *dirp)
 {
+	dircache_release(&dirp->cache);
+
 	if (dirp->dir != NULL) {
 		SMB_VFS_CLOSEDIR(dirp->conn,dirp->dir);
 		if (dirp->fsp != NULL) {
@@ -1620,6 +1932,13 @@ static struct smb_Dir *OpenDir_fsp(TALLOC_CTX *mem_ctx, connection_struct *conn,
 		goto fail;
 	}
 
+	dirp->cache = dircache_lookup(fsp);
+	if (dirp->cache != NULL) {
+		dirp->cache_serve = true;
+	} else {
+		dirp->cache = dircache_start(fsp);
+	}
+
 	return dirp;
 
   fail:
@@ -1663,6 +1982,25 @@ const char *ReadDirName(struct smb_Dir *dirp, long *poffset,
 		SeekDir(dirp, *poffset);
 	}
 
+	if (dirp->cache_serve) {
+		const struct dircache_entry *e;
+
+		e = dircache_entry(dirp->cache, dirp->cache_idx);
+		if (e == NULL) {
+			*poffset = dirp->offset = END_OF_DIRECTORY_OFFSET;
+			*ptalloced = NULL;
+			return NULL;
+		}
+		if (sbuf != NULL) {
+			*sbuf = e->st;
+		}
+		dirp->cache_idx += 1;
+		*poffset = dirp->offset = dirp->cache_idx;
+		*ptalloced = NULL;
+		dirp->file_number++;
+		return e->name;
+	}
+
 	while ((n = vfs_readdirname(conn, dirp->dir, sbuf, &talloced))) {
 		/* Ignore . and .. - we've already returned them. */
 		if (*n == '.') {
@@ -1672,10 +2010,18 @@ const char *ReadDirName(struct smb_Dir *dirp, long *poffset,
 			}
 		}
 		*poffset = dirp->offset = SMB_VFS_TELLDIR(conn, dirp->dir);
+		if (dirp->cache != NULL) {
+			dircache_add(dirp->cache, dirp->cache_idx, n, sbuf,
+				     dirp->offset);
+			dirp->cache_idx += 1;
+		}
 		*ptalloced = talloced;
 		dirp->file_number++;
 		return n;
 	}
+	if (dirp->cache != NULL) {
+		dircache_finish(dirp->cache);
+	}
 	*poffset = dirp->offset = END_OF_DIRECTORY_OFFSET;
 	*ptalloced = NULL;
 	return NULL;
@@ -1687,7 +2033,15 @@ const char *ReadDirName(struct smb_Dir *dirp, long *poffset,
 
 void RewindDir(struct smb_Dir *dirp, long *poffset)
 {
-	SMB_VFS_REWINDDIR(dirp->conn, dirp->dir);
+	if (dirp->cache_serve) {
+		dirp->cache_idx = 0;
+	} else {
+		SMB_VFS_REWINDDIR(dirp->conn, dirp->dir);
+		if (dirp->cache != NULL &&
+		    !dircache_seek(dirp->cache, 0, &dirp->cache_idx)) {
+			dircache_release(&dirp->cache);
+		}
+	}
 	dirp->file_number = 0;
 	dirp->offset = START_OF_DIRECTORY_OFFSET;
 	*poffset = START_OF_DIRECTORY_OFFSET;
@@ -1719,8 +2073,16 @@ void SeekDir(struct smb_Dir *dirp, long offset)
 			dirp->file_number = 2;
 		} else if (offset == END_OF_DIRECTORY_OFFSET) {
 			; /* Don't seek in this case. */
+		} else if (dirp->cache_serve) {
+			dirp->cache_idx = MIN((size_t)offset,
+					      dircache_num_entries(dirp->cache));
 		} else {
 			SMB_VFS_SEEKDIR(dirp->conn, dirp->dir, offset);
+			if (dirp->cache != NULL &&
+			    !dircache_seek(dirp->cache, offset,
+					   &dirp->cache_idx)) {
+				dircache_release(&dirp->cache);
+			}
 		}
 		dirp->offset = offset;
 	}
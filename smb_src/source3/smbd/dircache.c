@@ -0,0 +1,464 @@
+/*
+   Unix SMB/CIFS implementation.
+   Directory contents cache
+   Copyright (C) The Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Every smbd keeps the names and stat results of the directories it
+ * listed completely. The next listing of the same directory in the
+ * same share by the same user is served from memory instead of
+ * readdir() and a stat call per entry.
+ *
+ * A directory is only cached while an inotify watch on it is active,
+ * any event for it drops the listing. Before a listing is used the
+ * pending inotify events are dispatched, so changes done by this
+ * process itself are never missed. The mtime and ctime of the
+ * directory are compared as well.
+ */
+
+#include "includes.h"
+#include "smbd/smbd.h"
+#include "smbd/globals.h"
+#include "../librpc/gen_ndr/notify.h"
+#include "smbprofile.h"
+
+struct dircache_dir {
+	struct dircache_dir *prev, *next;
+	struct smbd_dircache *cache;
+	struct file_id id;
+	int snum;
+	uid_t uid;
+	struct timespec mtime;
+	struct timespec ctime;
+	struct dircache_entry *entries;
+	size_t num_entries;
+	/* Telldir offsets after each entry, for the builder */
+	long *offsets;
+	void *watch;
+	unsigned refcount;
+	bool complete;
+	bool in_list;
+	bool invalid;
+};
+
+struct smbd_dircache {
+	struct dircache_dir *dirs;
+	size_t num_entries;
+	size_t max_entries;
+};
+
+#ifdef HAVE_INOTIFY
+
+static struct smbd_dircache *dircache_get(connection_struct *conn)
+{
+	struct smbd_server_connection *sconn = conn->sconn;
+	int max_entries = lp_directory_cache_size();
+
+	if (max_entries <= 0) {
+		return NULL;
+	}
+	if (lp_clustering()) {
+		/* inotify does not see changes made on other nodes */
+		return NULL;
+	}
+	if (!lp_kernel_change_notify(conn->params)) {
+		return NULL;
+	}
+	if (sconn->sys_notify_ctx == NULL) {
+		return NULL;
+	}
+
+	if (sconn->dircache == NULL) {
+		/*
+		 * Allocated after sys_notify_ctx, so it's freed
+		 * before it together with our inotify watches.
+		 */
+		sconn->dircache = talloc_zero(sconn, struct smbd_dircache);
+		if (sconn->dircache == NULL) {
+			return NULL;
+		}
+	}
+	sconn->dircache->max_entries = max_entries;
+	return sconn->dircache;
+}
+
+static bool dircache_stat_dir(files_struct *fsp, SMB_STRUCT_STAT *st)
+{
+	int ret;
+
+	if (fsp->fh->fd != -1) {
+		ret = SMB_VFS_FSTAT(fsp, st);
+	} else {
+		struct smb_filename smb_fname = {
+			.base_name = fsp->fsp_name->base_name,
+		};
+		ret = SMB_VFS_STAT(fsp->conn, &smb_fname);
+		*st = smb_fname.st;
+	}
+	return (ret == 0);
+}
+
+static void dircache_unlink(struct dircache_dir *d)
+{
+	struct smbd_dircache *cache = d->cache;
+
+	if (!d->in_list) {
+		return;
+	}
+	DLIST_REMOVE(cache->dirs, d);
+	cache->num_entries -= d->num_entries;
+	d->in_list = false;
+
+	if (d->refcount == 0) {
+		TALLOC_FREE(d);
+	}
+}
+
+static void dircache_watch_fn(struct sys_notify_context *ctx,
+			      void *private_data,
+			      struct notify_event *ev)
+{
+	struct dircache_dir *d = talloc_get_type_abort(
+		private_data, struct dircache_dir);
+
+	if (d->invalid) {
+		return;
+	}
+
+	DEBUG(10, ("dircache_watch_fn: %s changed in %s\n", ev->path,
+		   file_id_string_tos(&d->id)));
+
+	DO_PROFILE_INC(dircache_invalidations);
+	d->invalid = true;
+	dircache_unlink(d);
+}
+
+/****************************************************************************
+ Find a valid cached listing of the directory fsp for the share of fsp.
+ The result stays valid until dircache_release() is called on it.
+****************************************************************************/
+
+struct dircache_dir *dircache_lookup(files_struct *fsp)
+{
+	struct smbd_dircache *cache = dircache_get(fsp->conn);
+	struct dircache_dir *d;
+	SMB_STRUCT_STAT st;
+
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	/*
+	 * Make sure we don't miss changes just done, by us or
+	 * by others.
+	 */
+	inotify_poll(fsp->conn->sconn->sys_notify_ctx);
+
+	for (d = cache->dirs; d != NULL; d = d->next) {
+		if (file_id_equal(&d->id, &fsp->file_id) &&
+		    (d->snum == SNUM(fsp->conn)) &&
+		    (d->uid == get_current_uid(fsp->conn))) {
+			break;
+		}
+	}
+	if (d == NULL) {
+		DO_PROFILE_INC(dircache_misses);
+		return NULL;
+	}
+
+	if (!dircache_stat_dir(fsp, &st) ||
+	    (timespec_compare(&d->mtime, &st.st_ex_mtime) != 0) ||
+	    (timespec_compare(&d->ctime, &st.st_ex_ctime) != 0)) {
+		DO_PROFILE_INC(dircache_invalidations);
+		DO_PROFILE_INC(dircache_misses);
+		d->invalid = true;
+		dircache_unlink(d);
+		return NULL;
+	}
+
+	DO_PROFILE_INC(dircache_hits);
+
+	DLIST_PROMOTE(cache->dirs, d);
+	d->refcount += 1;
+	return d;
+}
+
+/****************************************************************************
+ Start collecting a new listing of the directory fsp. The watch is set
+ up now, so changes while the directory is being read are caught.
+****************************************************************************/
+
+struct dircache_dir *dircache_start(files_struct *fsp)
+{
+	struct smbd_dircache *cache = dircache_get(fsp->conn);
+	struct dircache_dir *d;
+	uint32_t filter, subdir_filter;
+	SMB_STRUCT_STAT st;
+	NTSTATUS status;
+
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	d = talloc_zero(cache, struct dircache_dir);
+	if (d == NULL) {
+		return NULL;
+	}
+	d->cache = cache;
+	d->id = fsp->file_id;
+	d->snum = SNUM(fsp->conn);
+	d->uid = get_current_uid(fsp->conn);
+	d->refcount = 1;
+
+	if (!dircache_stat_dir(fsp, &st)) {
+		TALLOC_FREE(d);
+		return NULL;
+	}
+	d->mtime = st.st_ex_mtime;
+	d->ctime = st.st_ex_ctime;
+
+	filter = FILE_NOTIFY_CHANGE_FILE_NAME|FILE_NOTIFY_CHANGE_DIR_NAME|
+		FILE_NOTIFY_CHANGE_ATTRIBUTES|FILE_NOTIFY_CHANGE_LAST_WRITE|
+		FILE_NOTIFY_CHANGE_EA|FILE_NOTIFY_CHANGE_SECURITY;
+	subdir_filter = 0;
+
+	status = inotify_watch(fsp->conn->sconn->sys_notify_ctx,
+			       fsp->fsp_name->base_name,
+			       &filter, &subdir_filter,
+			       dircache_watch_fn, d, &d->watch);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(5, ("dircache_start: inotify_watch on %s failed: %s\n",
+			  fsp_str_dbg(fsp), nt_errstr(status)));
+		TALLOC_FREE(d);
+		return NULL;
+	}
+	talloc_steal(d, d->watch);
+
+	return d;
+}
+
+/****************************************************************************
+ Add the entry at position idx read from the directory. offset is where
+ the directory is after reading it.
+****************************************************************************/
+
+void dircache_add(struct dircache_dir *d, size_t idx, const char *name,
+		  const SMB_STRUCT_STAT *st, long offset)
+{
+	struct dircache_entry *e;
+	size_t n = d->num_entries;
+
+	if (d->invalid || d->complete) {
+		return;
+	}
+	if (idx != n) {
+		/* We lost track of where we are */
+		d->invalid = true;
+		return;
+	}
+	if (n >= d->cache->max_entries) {
+		/* Too large to be cached */
+		d->invalid = true;
+		return;
+	}
+
+	if (n == talloc_array_length(d->entries)) {
+		size_t new_size = MAX(n * 2, 64);
+		struct dircache_entry *entries;
+		long *offsets;
+
+		entries = talloc_realloc(d, d->entries,
+					 struct dircache_entry, new_size);
+		if (entries == NULL) {
+			d->invalid = true;
+			return;
+		}
+		d->entries = entries;
+
+		offsets = talloc_realloc(d, d->offsets, long, new_size);
+		if (offsets == NULL) {
+			d->invalid = true;
+			return;
+		}
+		d->offsets = offsets;
+	}
+
+	e = &d->entries[n];
+	e->name = talloc_strdup(d->entries, name);
+	if (e->name == NULL) {
+		d->invalid = true;
+		return;
+	}
+	if (st != NULL) {
+		e->st = *st;
+	} else {
+		SET_STAT_INVALID(e->st);
+	}
+	d->offsets[n] = offset;
+	d->num_entries = n + 1;
+}
+
+/****************************************************************************
+ The directory was seeked to offset, or rewound for offset == 0. Return
+ the position of the entry read next, a listing still being built
+ forgets what comes after it.
+****************************************************************************/
+
+bool dircache_seek(struct dircache_dir *d, long offset, size_t *pidx)
+{
+	size_t i = 0;
+
+	if (d->invalid) {
+		return false;
+	}
+	if (offset != 0) {
+		for (i = d->num_entries; i > 0; i--) {
+			if (d->offsets[i-1] == offset) {
+				break;
+			}
+		}
+		if (i == 0) {
+			d->invalid = true;
+			return false;
+		}
+	}
+
+	if (!d->complete) {
+		while (d->num_entries > i) {
+			d->num_entries -= 1;
+			TALLOC_FREE(d->entries[d->num_entries].name);
+		}
+	}
+
+	*pidx = i;
+	return true;
+}
+
+/****************************************************************************
+ The whole directory was read, make the listing available. The caller
+ keeps its reference.
+****************************************************************************/
+
+void dircache_finish(struct dircache_dir *d)
+{
+	struct smbd_dircache *cache = d->cache;
+
+	if (d->invalid || d->complete) {
+		return;
+	}
+	d->complete = true;
+
+	DEBUG(10, ("dircache_finish: %s: %u entries\n",
+		   file_id_string_tos(&d->id), (unsigned)d->num_entries));
+
+	DLIST_ADD(cache->dirs, d);
+	d->in_list = true;
+	cache->num_entries += d->num_entries;
+
+	while (cache->num_entries > cache->max_entries) {
+		struct dircache_dir *last = DLIST_TAIL(cache->dirs);
+		dircache_unlink(last);
+	}
+}
+
+void dircache_release(struct dircache_dir **pd)
+{
+	struct dircache_dir *d = *pd;
+
+	*pd = NULL;
+
+	if (d == NULL) {
+		return;
+	}
+	SMB_ASSERT(d->refcount > 0);
+	d->refcount -= 1;
+
+	if ((d->refcount == 0) && !d->in_list) {
+		TALLOC_FREE(d);
+	}
+}
+
+/****************************************************************************
+ Remember a stat result for an entry, it's used for the next listings.
+****************************************************************************/
+
+void dircache_set_stat(struct dircache_dir *d, size_t idx, const char *name,
+		       const SMB_STRUCT_STAT *st)
+{
+	if (d->invalid || (idx >= d->num_entries)) {
+		return;
+	}
+	if (strcmp(d->entries[idx].name, name) != 0) {
+		return;
+	}
+	d->entries[idx].st = *st;
+}
+
+#else
+
+struct dircache_dir *dircache_lookup(files_struct *fsp)
+{
+	return NULL;
+}
+
+struct dircache_dir *dircache_start(files_struct *fsp)
+{
+	return NULL;
+}
+
+void dircache_add(struct dircache_dir *d, size_t idx, const char *name,
+		  const SMB_STRUCT_STAT *st, long offset)
+{
+	return;
+}
+
+bool dircache_seek(struct dircache_dir *d, long offset, size_t *pidx)
+{
+	return false;
+}
+
+void dircache_finish(struct dircache_dir *d)
+{
+	return;
+}
+
+void dircache_release(struct dircache_dir **pd)
+{
+	TALLOC_FREE(*pd);
+}
+
+void dircache_set_stat(struct dircache_dir *d, size_t idx, const char *name,
+		       const SMB_STRUCT_STAT *st)
+{
+	return;
+}
+
+#endif
+
+size_t dircache_num_entries(const struct dircache_dir *d)
+{
+	return d->num_entries;
+}
+
+const struct dircache_entry *dircache_entry(const struct dircache_dir *d,
+					    size_t idx)
+{
+	if (idx >= d->num_entries) {
+		return NULL;
+	}
+	return &d->entries[idx];
+}
@@ -258,6 +258,7 @@ static uint32 dos_mode_from_sbuf(connection_struct *conn,
 
 static bool get_ea_dos_attribute(connection_struct *conn,
 				 struct smb_filename *smb_fname,
+				 const DATA_BLOB *prefetched,
 				 uint32 *pattr)
 {
 	struct xattr_DOSATTRIB dosattrib;
@@ -274,9 +275,17 @@ static bool get_ea_dos_attribute(connection_struct *conn,
 	/* Don't reset pattr to zero as we may already have filename-based attributes we
 	   need to preserve. */
 
-	sizeret = SMB_VFS_GETXATTR(conn, smb_fname->base_name,
-				   SAMBA_XATTR_DOS_ATTRIB, attrstr,
-				   sizeof(attrstr));
+	if (prefetched != NULL) {
+		if (prefetched->data == NULL) {
+			return false;
+		}
+		sizeret = MIN(prefetched->length, sizeof(attrstr));
+		memcpy(attrstr, prefetched->data, sizeret);
+	} else {
+		sizeret = SMB_VFS_GETXATTR(conn, smb_fname->base_name,
+					   SAMBA_XATTR_DOS_ATTRIB, attrstr,
+					   sizeof(attrstr));
+	}
 	if (sizeret == -1) {
 		if (errno == ENOSYS
 #if defined(ENOTSUP)
@@ -593,6 +602,19 @@ err_out:
 ****************************************************************************/
 
 uint32 dos_mode(connection_struct *conn, struct smb_filename *smb_fname)
+{
+	return dos_mode_prefetched(conn, smb_fname, NULL);
+}
+
+/****************************************************************************
+ dos_mode() with the value of the DOS attribute EA already read by the
+ caller, see dptr_prefetch_send(). dosattrib->data == NULL means the
+ file has no such EA.
+****************************************************************************/
+
+uint32 dos_mode_prefetched(connection_struct *conn,
+			   struct smb_filename *smb_fname,
+			   const DATA_BLOB *dosattrib)
 {
 	uint32 result = 0;
 	bool offline;
@@ -621,7 +643,7 @@ uint32 dos_mode(connection_struct *conn, struct smb_filename *smb_fname)
 	}
 
 	/* Get the DOS attributes from an EA by preference. */
-	if (!get_ea_dos_attribute(conn, smb_fname, &result)) {
+	if (!get_ea_dos_attribute(conn, smb_fname, dosattrib, &result)) {
 		result |= dos_mode_from_sbuf(conn, smb_fname);
 	}
 
@@ -283,6 +283,16 @@ NTSTATUS smbd_smb2_request_process_create(struct smbd_smb2_request *req);
 NTSTATUS smbd_smb2_request_process_close(struct smbd_smb2_request *req);
 NTSTATUS smbd_smb2_request_process_flush(struct smbd_smb2_request *req);
 NTSTATUS smbd_smb2_request_process_read(struct smbd_smb2_request *req);
+struct smbd_smb2_read_buffer {
+	struct smbd_smb2_read_buffer *prev, *next;
+	struct smbd_smb2_read_buffer_pool *pool;
+	uint8_t *data;
+	size_t size;
+};
+struct smbd_smb2_read_buffer *smbd_smb2_read_buffer_get(
+	TALLOC_CTX *mem_ctx,
+	struct smbXsrv_connection *xconn,
+	size_t length);
 NTSTATUS smb2_read_complete(struct tevent_req *req, ssize_t nread, int err);
 NTSTATUS smbd_smb2_request_process_write(struct smbd_smb2_request *req);
 NTSTATUS smb2_write_complete(struct tevent_req *req, ssize_t nwritten, int err);
@@ -301,6 +311,14 @@ void smbd_smb2_request_dispatch_immediate(struct tevent_context *ctx,
 				struct tevent_immediate *im,
 				void *private_data);
 
+/* From smbd/smb2_worker.c */
+bool smbd_smb2_worker_enabled(connection_struct *conn);
+NTSTATUS smbd_smb2_worker_become_user(struct smbd_smb2_request *smb2req);
+struct tevent_req *smbd_smb2_worker_wait_send(TALLOC_CTX *mem_ctx,
+					      struct tevent_context *ev,
+					      files_struct *fsp);
+NTSTATUS smbd_smb2_worker_wait_recv(struct tevent_req *req);
+
 struct deferred_open_record;
 
 /* SMB1 -> SMB2 glue. */
@@ -449,6 +467,11 @@ struct smbXsrv_connection {
 		} request_read_state;
 		struct smbd_smb2_send_queue *send_queue;
 		size_t send_queue_len;
+		/* responses are only queued, see smbd_smb2_send_queue_add() */
+		bool send_corked;
+
+		/* cached page aligned buffers for SMB2 READ responses */
+		struct smbd_smb2_read_buffer_pool *read_buffers;
 
 		struct {
 			/*
@@ -503,6 +526,7 @@ struct smbXsrv_connection {
 			uint16_t security_mode;
 			uint16_t num_dialects;
 			uint16_t *dialects;
+			bool guid_verified;
 		} client;
 		struct {
 			uint32_t capabilities;
@@ -512,6 +536,7 @@ struct smbXsrv_connection {
 			uint32_t max_trans;
 			uint32_t max_read;
 			uint32_t max_write;
+			uint16_t cipher;
 		} server;
 
 		struct smbd_smb2_request *requests;
@@ -526,6 +551,22 @@ uint32_t smbXsrv_version_global_current(void);
 NTSTATUS smbXsrv_connection_init_tables(struct smbXsrv_connection *conn,
 					enum protocol_types protocol);
 
+NTSTATUS smbXsrv_client_global_init(void);
+NTSTATUS smbXsrv_client_create(TALLOC_CTX *mem_ctx,
+			       struct tevent_context *ev_ctx,
+			       struct messaging_context *msg_ctx,
+			       NTTIME now,
+			       struct smbXsrv_client **_client);
+NTSTATUS smbXsrv_client_update(struct smbXsrv_client *client);
+NTSTATUS smbXsrv_client_remove(struct smbXsrv_client *client);
+struct smbXsrv_client_global0;
+NTSTATUS smb2srv_client_lookup_global(struct smbXsrv_client *client,
+				      struct GUID client_guid,
+				      TALLOC_CTX *mem_ctx,
+				      struct smbXsrv_client_global0 **_global);
+NTSTATUS smb2srv_client_connection_pass(struct smbd_smb2_request *smb2req,
+					struct smbXsrv_client_global0 *global);
+
 NTSTATUS smbXsrv_session_global_init(void);
 NTSTATUS smbXsrv_session_create(struct smbXsrv_connection *conn,
 				NTTIME now,
@@ -536,6 +577,23 @@ NTSTATUS smbXsrv_session_find_channel(const struct smbXsrv_session *session,
 				      const struct smbXsrv_connection *conn,
 				      struct smbXsrv_channel_global0 **_c);
 NTSTATUS smbXsrv_session_logoff(struct smbXsrv_session *session);
+NTSTATUS smbXsrv_session_add_channel(struct smbXsrv_session *session,
+				     struct smbXsrv_connection *conn,
+				     struct smbXsrv_channel_global0 **_c);
+NTSTATUS smbXsrv_session_remove_channel(struct smbXsrv_session *session,
+					struct smbXsrv_connection *xconn);
+NTSTATUS smbXsrv_session_disconnect_xconn(struct smbXsrv_connection *xconn);
+struct smbXsrv_session_auth0;
+NTSTATUS smbXsrv_session_find_auth(const struct smbXsrv_session *session,
+				   const struct smbXsrv_connection *conn,
+				   NTTIME now,
+				   struct smbXsrv_session_auth0 **_a);
+NTSTATUS smbXsrv_session_create_auth(struct smbXsrv_session *session,
+				     struct smbXsrv_connection *conn,
+				     NTTIME now,
+				     uint8_t in_flags,
+				     uint8_t in_security_mode,
+				     struct smbXsrv_session_auth0 **_a);
 NTSTATUS smbXsrv_session_logoff_all(struct smbXsrv_connection *conn);
 NTSTATUS smb1srv_session_table_init(struct smbXsrv_connection *conn);
 NTSTATUS smb1srv_session_lookup(struct smbXsrv_connection *conn,
@@ -588,6 +646,16 @@ NTSTATUS smbXsrv_open_create(struct smbXsrv_connection *conn,
 			     struct smbXsrv_open **_open);
 uint32_t smbXsrv_open_hash(struct smbXsrv_open *_open);
 NTSTATUS smbXsrv_open_update(struct smbXsrv_open *_open);
+struct db_context;
+struct TDB_DATA;
+bool smbXsrv_open_create_prefetch_key(TALLOC_CTX *mem_ctx,
+				      struct smbXsrv_connection *conn,
+				      struct db_context **db,
+				      struct TDB_DATA *key);
+bool smbXsrv_open_close_prefetch_key(TALLOC_CTX *mem_ctx,
+				     struct smbXsrv_open *op,
+				     struct db_context **db,
+				     struct TDB_DATA *key);
 NTSTATUS smbXsrv_open_close(struct smbXsrv_open *op, NTTIME now);
 NTSTATUS smb1srv_open_table_init(struct smbXsrv_connection *conn);
 NTSTATUS smb1srv_open_lookup(struct smbXsrv_connection *conn,
@@ -783,6 +851,12 @@ struct user_struct {
 	struct smbXsrv_session *session;
 };
 
+/* One entry of a cached directory listing, see smbd/dircache.c */
+struct dircache_entry {
+	char *name;
+	SMB_STRUCT_STAT st;
+};
+
 struct smbd_server_connection {
 	const struct tsocket_address *local_address;
 	const struct tsocket_address *remote_address;
@@ -790,6 +864,7 @@ struct smbd_server_connection {
 	struct tevent_context *ev_ctx;
 	struct messaging_context *msg_ctx;
 	struct sys_notify_context *sys_notify_ctx;
+	struct smbd_dircache *dircache;
 	struct notify_context *notify_ctx;
 	bool using_smb2;
 	int trans_num;
@@ -855,6 +930,14 @@ struct smbd_server_connection {
 	struct asys_context *asys_ctx;
 	struct tevent_fd *asys_fde;
 
+	/*
+	 * Helper threads for the metadata calls of SMB2
+	 * requests, see smbd/smb2_worker.c
+	 */
+	struct asys_context *asys_meta_ctx;
+	struct tevent_fd *asys_meta_fde;
+	struct smbd_smb2_worker_queue *worker_queues;
+
 	struct smbXsrv_client *client;
 };
 
@@ -40,6 +40,7 @@
 struct inotify_private {
 	struct sys_notify_context *ctx;
 	int fd;
+	struct tevent_fd *fde;
 	struct inotify_watch_context *watches;
 };
 
@@ -208,7 +209,7 @@ static void inotify_handler(struct tevent_context *ev, struct tevent_fd *fde,
 	if (ioctl(in->fd, FIONREAD, &bufsize) != 0 || 
 	    bufsize == 0) {
 		DEBUG(0,("No data on inotify fd?!\n"));
-		TALLOC_FREE(fde);
+		TALLOC_FREE(in->fde);
 		return;
 	}
 
@@ -223,7 +224,7 @@ static void inotify_handler(struct tevent_context *ev, struct tevent_fd *fde,
 		talloc_free(e0);
 		/* the inotify fd will now be out of sync,
 		 * can't keep reading data off it */
-		TALLOC_FREE(fde);
+		TALLOC_FREE(in->fde);
 		return;
 	}
 
@@ -263,13 +264,15 @@ static NTSTATUS inotify_setup(struct sys_notify_context *ctx)
 		return map_nt_error_from_unix(errno);
 	}
 	in->ctx = ctx;
+	in->fde = NULL;
 	in->watches = NULL;
 
 	ctx->private_data = in;
 	talloc_set_destructor(in, inotify_destructor);
 
 	/* add a event waiting for the inotify fd to be readable */
-	tevent_add_fd(ctx->ev, in, in->fd, TEVENT_FD_READ, inotify_handler, in);
+	in->fde = tevent_add_fd(ctx->ev, in, in->fd, TEVENT_FD_READ,
+				inotify_handler, in);
 
 	return NT_STATUS_OK;
 }
@@ -330,6 +333,29 @@ static int watch_destructor(struct inotify_watch_context *w)
 }
 
 
+/*
+  dispatch the events the kernel has queued for us right now, without
+  waiting for the main loop to get to the inotify fd. Callers that
+  cache file system state use this to see their own changes.
+*/
+void inotify_poll(struct sys_notify_context *ctx)
+{
+	struct inotify_private *in;
+	int bufsize = 0;
+
+	if (ctx->private_data == NULL) {
+		return;
+	}
+	in = talloc_get_type(ctx->private_data, struct inotify_private);
+	if ((in == NULL) || (in->fde == NULL)) {
+		return;
+	}
+	if (ioctl(in->fd, FIONREAD, &bufsize) != 0 || bufsize == 0) {
+		return;
+	}
+	inotify_handler(ctx->ev, in->fde, TEVENT_FD_READ, in);
+}
+
 /*
   add a watch. The watch is removed when the caller calls
   talloc_free() on *handle
@@ -476,11 +476,11 @@ struct notify_trigger_index_state {
 	TALLOC_CTX *mem_ctx;
 	uint32_t *vnns;
 	uint32_t my_vnn;
-	bool found_my_vnn;
+	bool *found_my_vnn;
 };
 
-static void notify_trigger_index_parser(TDB_DATA key, TDB_DATA data,
-					void *private_data)
+static void notify_trigger_index_parser(size_t idx, TDB_DATA key,
+					TDB_DATA data, void *private_data)
 {
 	struct notify_trigger_index_state *state =
 		(struct notify_trigger_index_state *)private_data;
@@ -498,7 +498,7 @@ static void notify_trigger_index_parser(TDB_DATA key, TDB_DATA data,
 
 	for (i=0; i<num_new_vnns; i++) {
 		if (new_vnns[i] == state->my_vnn) {
-			state->found_my_vnn = true;
+			state->found_my_vnn[idx] = true;
 			num_remote_vnns -= 1;
 		}
 	}
@@ -605,8 +605,9 @@ void notify_trigger(struct notify_context *notify,
 {
 	struct ctdbd_connection *ctdbd_conn;
 	struct notify_trigger_index_state idx_state;
-	const char *p, *next_p;
-	size_t i, num_vnns;
+	const char *p;
+	TDB_DATA *prefixes = NULL;
+	size_t i, num_prefixes, num_vnns;
 	uint32_t last_vnn;
 	uint8_t *remote_blob = NULL;
 	size_t remote_blob_len = 0;
@@ -628,25 +629,44 @@ void notify_trigger(struct notify_context *notify,
 
 	idx_state.mem_ctx = talloc_tos();
 	idx_state.vnns = NULL;
-	idx_state.found_my_vnn = false;
+	idx_state.found_my_vnn = NULL;
 	idx_state.my_vnn = get_my_vnn();
 
-	for (p = strchr(path+1, '/'); p != NULL; p = next_p) {
-		ptrdiff_t path_len = p - path;
-		bool recursive;
+	/*
+	 * Look up all parent directories in the index with one
+	 * dbwrap_parse_records call
+	 */
+	num_prefixes = 0;
+	for (p = strchr(path+1, '/'); p != NULL; p = strchr(p+1, '/')) {
+		num_prefixes += 1;
+	}
+	if (num_prefixes == 0) {
+		return;
+	}
 
-		next_p = strchr(p+1, '/');
-		recursive = (next_p != NULL);
+	prefixes = talloc_array(talloc_tos(), TDB_DATA, num_prefixes);
+	idx_state.found_my_vnn = talloc_zero_array(talloc_tos(), bool,
+						   num_prefixes);
+	if ((prefixes == NULL) || (idx_state.found_my_vnn == NULL)) {
+		DEBUG(1, ("talloc failed\n"));
+		goto done;
+	}
+
+	i = 0;
+	for (p = strchr(path+1, '/'); p != NULL; p = strchr(p+1, '/')) {
+		prefixes[i++] = make_tdb_data(discard_const_p(uint8_t, path),
+					      p - path);
+	}
+
+	dbwrap_parse_records(notify->db_index, prefixes, num_prefixes,
+			     notify_trigger_index_parser, &idx_state);
 
-		dbwrap_parse_record(
-			notify->db_index,
-			make_tdb_data(discard_const_p(uint8_t, path), path_len),
-			notify_trigger_index_parser, &idx_state);
+	for (i=0; i<num_prefixes; i++) {
+		bool recursive = (i+1 < num_prefixes);
 
-		if (idx_state.found_my_vnn) {
-			notify_trigger_local(notify, action, filter,
-					     path, path_len, recursive);
-			idx_state.found_my_vnn = false;
+		if (idx_state.found_my_vnn[i]) {
+			notify_trigger_local(notify, action, filter, path,
+					     prefixes[i].dsize, recursive);
 		}
 	}
 
@@ -693,6 +713,8 @@ void notify_trigger(struct notify_context *notify,
 done:
 	TALLOC_FREE(remote_blob);
 	TALLOC_FREE(idx_state.vnns);
+	TALLOC_FREE(idx_state.found_my_vnn);
+	TALLOC_FREE(prefixes);
 }
 
 static void notify_trigger_local(struct notify_context *notify,
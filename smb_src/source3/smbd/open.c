@@ -35,6 +35,7 @@
 #include "serverid.h"
 #include "messages.h"
 #include "source3/lib/dbwrap/dbwrap_watch.h"
+#include "lib/dbwrap/dbwrap.h"
 #include "locking/leases_db.h"
 #include "librpc/gen_ndr/ndr_leases_db.h"
 
@@ -4376,6 +4377,57 @@ static NTSTATUS lease_match(connection_struct *conn,
 	return NT_STATUS_OPLOCK_NOT_GRANTED;
 }
 
+/*
+ * In a cluster, opening an existing file locks its locking.tdb record
+ * and a new smbXsrv_open_global.tdb record one after the other, each of
+ * which might have to be migrated from another node first. Migrate them
+ * together.
+ */
+
+static void open_prefetch_records(connection_struct *conn,
+				  struct smb_request *req,
+				  const struct smb_filename *smb_fname)
+{
+	TALLOC_CTX *frame;
+	struct db_context *dbs[2];
+	TDB_DATA keys[2];
+	struct file_id id;
+	size_t num_keys = 0;
+	NTSTATUS status;
+
+	if (!lp_clustering() || (req == NULL) ||
+	    !VALID_STAT(smb_fname->st)) {
+		return;
+	}
+
+	frame = talloc_stackframe();
+
+	id = vfs_file_id_from_sbuf(conn, &smb_fname->st);
+
+	if (share_mode_lock_prefetch_key(&id, &dbs[num_keys],
+					 &keys[num_keys])) {
+		num_keys += 1;
+	}
+
+	if (smbXsrv_open_create_prefetch_key(frame, req->xconn,
+					     &dbs[num_keys],
+					     &keys[num_keys])) {
+		num_keys += 1;
+	}
+
+	if (num_keys < 2) {
+		TALLOC_FREE(frame);
+		return;
+	}
+
+	status = dbwrap_prefetch_locked(dbs, keys, num_keys);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(5, ("dbwrap_prefetch_locked failed for %s: %s\n",
+			  smb_fname_str_dbg(smb_fname), nt_errstr(status)));
+	}
+	TALLOC_FREE(frame);
+}
+
 /*
  * Wrapper around open_file_ntcreate and open_directory
  */
@@ -4584,6 +4636,8 @@ static NTSTATUS create_file_unixpath(connection_struct *conn,
 		 * Ordinary file case.
 		 */
 
+		open_prefetch_records(conn, req, smb_fname);
+
 		status = file_new(req, conn, &fsp);
 		if(!NT_STATUS_IS_OK(status)) {
 			goto fail;
@@ -3468,6 +3468,14 @@ NTSTATUS smbXsrv_connection_init_tables(struct smbXsrv_connection *conn,
 	set_Protocol(protocol);
 	conn->protocol = protocol;
 
+	if (conn->client->session_table != NULL) {
+		/*
+		 * This is an additional channel of an existing
+		 * client, the tables are shared by all connections.
+		 */
+		return NT_STATUS_OK;
+	}
+
 	if (protocol >= PROTOCOL_SMB2_02) {
 		status = smb2srv_session_table_init(conn);
 		if (!NT_STATUS_IS_OK(status)) {
@@ -3699,7 +3707,7 @@ NTSTATUS smbd_add_connection(struct smbXsrv_client *client, int sock_fd,
 		 * so that the caller can return an error message
 		 * to the client
 		 */
-		client->connections = xconn;
+		DLIST_ADD_END(client->connections, xconn, NULL);
 		xconn->client = client;
 		talloc_steal(client, xconn);
 
@@ -3748,7 +3756,7 @@ NTSTATUS smbd_add_connection(struct smbXsrv_client *client, int sock_fd,
 		return NT_STATUS_NO_MEMORY;
 	}
 
-	/* for now we only have one connection */
+	/* with multi-channel support we may get more than one connection */
 	DLIST_ADD_END(client->connections, xconn, NULL);
 	xconn->client = client;
 	talloc_steal(client, xconn);
@@ -3777,10 +3785,12 @@ void smbd_process(struct tevent_context *ev_ctx,
 	const char *remaddr = NULL;
 	int ret;
 	NTSTATUS status;
+	struct timeval tv = timeval_current();
+	NTTIME now = timeval_to_nttime(&tv);
 
-	client = talloc_zero(ev_ctx, struct smbXsrv_client);
-	if (client == NULL) {
-		DEBUG(0,("talloc_zero(struct smbXsrv_client)\n"));
+	status = smbXsrv_client_create(ev_ctx, ev_ctx, msg_ctx, now, &client);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(0,("smbXsrv_client_create(): %s\n", nt_errstr(status)));
 		exit_server_cleanly("talloc_zero(struct smbXsrv_client).\n");
 	}
 
@@ -3789,9 +3799,6 @@ void smbd_process(struct tevent_context *ev_ctx,
 	 */
 	global_smbXsrv_client = client;
 
-	client->ev_ctx = ev_ctx;
-	client->msg_ctx = msg_ctx;
-
 	sconn = talloc_zero(client, struct smbd_server_connection);
 	if (sconn == NULL) {
 		exit_server("failed to create smbd_server_connection");
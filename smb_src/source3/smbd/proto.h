@@ -80,7 +80,6 @@ NTSTATUS schedule_aio_write_and_X(connection_struct *conn,
 NTSTATUS schedule_smb2_aio_read(connection_struct *conn,
 				struct smb_request *smbreq,
 				files_struct *fsp,
-				TALLOC_CTX *ctx,
 				DATA_BLOB *preadbuf,
 				off_t startpos,
 				size_t smb_maxcnt);
@@ -178,6 +177,21 @@ uint64_t get_dfree_info(connection_struct *conn,
 			uint64_t *dfree,
 			uint64_t *dsize);
 
+/* The following definitions come from smbd/dircache.c  */
+
+struct dircache_dir *dircache_lookup(files_struct *fsp);
+struct dircache_dir *dircache_start(files_struct *fsp);
+void dircache_add(struct dircache_dir *d, size_t idx, const char *name,
+		  const SMB_STRUCT_STAT *st, long offset);
+bool dircache_seek(struct dircache_dir *d, long offset, size_t *pidx);
+void dircache_finish(struct dircache_dir *d);
+void dircache_release(struct dircache_dir **pd);
+void dircache_set_stat(struct dircache_dir *d, size_t idx, const char *name,
+		       const SMB_STRUCT_STAT *st);
+size_t dircache_num_entries(const struct dircache_dir *d);
+const struct dircache_entry *dircache_entry(const struct dircache_dir *d,
+					    size_t idx);
+
 /* The following definitions come from smbd/dir.c  */
 
 bool init_dptrs(struct smbd_server_connection *sconn);
@@ -203,6 +217,15 @@ bool dptr_get_priv(struct dptr_struct *dptr);
 void dptr_set_priv(struct dptr_struct *dptr);
 bool dptr_SearchDir(struct dptr_struct *dptr, const char *name, long *poffset, SMB_STRUCT_STAT *pst);
 void dptr_init_search_op(struct dptr_struct *dptr);
+struct tevent_req *dptr_prefetch_send(TALLOC_CTX *mem_ctx,
+				      struct tevent_context *ev,
+				      struct dptr_struct *dptr,
+				      size_t max_entries);
+NTSTATUS dptr_prefetch_recv(struct tevent_req *req, struct dptr_struct *dptr);
+void dptr_prefetch_clear(struct dptr_struct *dptr);
+bool dptr_prefetched_dosattrib(struct dptr_struct *dptr, DATA_BLOB *blob);
+void dptr_set_entry_stat(struct dptr_struct *dptr, const char *name,
+			 const SMB_STRUCT_STAT *st);
 bool dptr_fill(struct smbd_server_connection *sconn,
 	       char *buf1,unsigned int key);
 struct dptr_struct *dptr_fetch(struct smbd_server_connection *sconn,
@@ -254,6 +277,9 @@ uint32 dos_mode_msdfs(connection_struct *conn,
 		      const struct smb_filename *smb_fname);
 int dos_attributes_to_stat_dos_flags(uint32_t dosmode);
 uint32 dos_mode(connection_struct *conn, struct smb_filename *smb_fname);
+uint32 dos_mode_prefetched(connection_struct *conn,
+			   struct smb_filename *smb_fname,
+			   const DATA_BLOB *dosattrib);
 int file_set_dosmode(connection_struct *conn, struct smb_filename *smb_fname,
 		     uint32 dosmode, const char *parent_dir, bool newfile);
 NTSTATUS file_set_sparse(connection_struct *conn,
@@ -531,6 +557,7 @@ struct sys_notify_context *sys_notify_context_create(TALLOC_CTX *mem_ctx,
 
 /* The following definitions come from smbd/notify_inotify.c  */
 
+void inotify_poll(struct sys_notify_context *ctx);
 NTSTATUS inotify_watch(struct sys_notify_context *ctx,
 		       const char *path,
 		       uint32_t *filter,
@@ -36,6 +36,9 @@ struct smbd_scavenger_state {
 	struct server_id parent_id;
 	struct server_id *scavenger_id;
 	bool am_scavenger;
+	struct tevent_timer *repack_start_te;
+	uint32_t repack_chain;
+	struct tdb_repack_stats repack_stats;
 };
 
 static struct smbd_scavenger_state *smbd_scavenger_state = NULL;
@@ -46,12 +49,114 @@ struct scavenger_message {
 	NTTIME until;
 };
 
+static void scavenger_repack_add_timer(struct smbd_scavenger_state *state);
+
+/*
+ * Every "smbd:repack interval" seconds repack "smbd:repack chains"
+ * hash chains of locking.tdb. Only the chain locks are taken, so this
+ * does not get in the way of the smbds for long.
+ */
+static void scavenger_repack_timer(struct tevent_context *ev,
+				   struct tevent_timer *te,
+				   struct timeval t, void *data)
+{
+	struct smbd_scavenger_state *state = talloc_get_type_abort(
+		data, struct smbd_scavenger_state);
+	int num_chains = lp_parm_int(-1, "smbd", "repack chains", 64);
+	int ret;
+
+	ret = locking_db_repack_chains(state->repack_chain,
+				       MAX(num_chains, 1),
+				       &state->repack_stats);
+	if (ret == -1) {
+		DEBUG(2, ("scavenger: repacking locking.tdb failed\n"));
+		ret = 0;
+	}
+	state->repack_chain = ret;
+
+	if (state->repack_chain == 0) {
+		struct tdb_repack_stats *stats = &state->repack_stats;
+
+		DEBUG(3, ("scavenger: repacked locking.tdb: %u chains "
+			  "(%u busy), %u records moved, %u trimmed, "
+			  "%u purged, %llu bytes reclaimed\n",
+			  (unsigned)stats->chains,
+			  (unsigned)stats->chains_busy,
+			  (unsigned)stats->moved,
+			  (unsigned)stats->trimmed,
+			  (unsigned)stats->purged,
+			  (unsigned long long)stats->bytes_reclaimed));
+		ZERO_STRUCTP(stats);
+	}
+
+	scavenger_repack_add_timer(state);
+}
+
+static void scavenger_repack_add_timer(struct smbd_scavenger_state *state)
+{
+	int interval = lp_parm_int(-1, "smbd", "repack interval", 0);
+	struct tevent_timer *te;
+
+	if (interval <= 0) {
+		return;
+	}
+
+	te = tevent_add_timer(state->ev, state,
+			      timeval_current_ofs(interval, 0),
+			      scavenger_repack_timer, state);
+	if (te == NULL) {
+		DEBUG(2, ("Failed to add scavenger_repack_timer event\n"));
+	}
+}
+
+static bool smbd_scavenger_start(struct smbd_scavenger_state *state);
+
+/*
+ * The scavenger is otherwise only forked for disconnected durable
+ * handles. With a repack interval the parent makes sure it runs, and
+ * restarts it should it die.
+ */
+static void scavenger_repack_start_timer(struct tevent_context *ev,
+					 struct tevent_timer *te,
+					 struct timeval t, void *data)
+{
+	struct smbd_scavenger_state *state = talloc_get_type_abort(
+		data, struct smbd_scavenger_state);
+	struct server_id self = messaging_server_id(state->msg);
+	int interval = lp_parm_int(-1, "smbd", "repack interval", 0);
+
+	state->repack_start_te = NULL;
+
+	if (!server_id_equal(&state->parent_id, &self)) {
+		/* inherited by a forked child smbd */
+		return;
+	}
+
+	if (interval <= 0) {
+		return;
+	}
+
+	if (!smbd_scavenger_start(state)) {
+		DEBUG(2, ("Failed to start scavenger for repacking\n"));
+	}
+
+	state->repack_start_te = tevent_add_timer(
+		state->ev, state, timeval_current_ofs(interval, 0),
+		scavenger_repack_start_timer, state);
+	if (state->repack_start_te == NULL) {
+		DEBUG(2, ("Failed to add scavenger_repack_start_timer "
+			  "event\n"));
+	}
+}
+
 static int smbd_scavenger_main(struct smbd_scavenger_state *state)
 {
 	DEBUG(10, ("scavenger: %s started, parent: %s\n",
 		   server_id_str(talloc_tos(), state->scavenger_id),
 		   server_id_str(talloc_tos(), &state->parent_id)));
 
+	scavenger_repack_add_timer(state);
+
 	while (true) {
 		TALLOC_CTX *frame = talloc_stackframe();
 		int ret;
@@ -258,6 +363,7 @@ static bool smbd_scavenger_start(struct smbd_scavenger_state *state)
 		prctl_set_comment("smbd-scavenger");
 
 		state->am_scavenger = true;
+		TALLOC_FREE(state->repack_start_te);
 		*state->scavenger_id = messaging_server_id(state->msg);
 
 		scavenger_setup_sig_term_handler(state->ev);
@@ -402,6 +508,17 @@ bool smbd_scavenger_init(TALLOC_CTX *mem_ctx,
 		goto fail;
 	}
 
+	if (lp_parm_int(-1, "smbd", "repack interval", 0) > 0) {
+		state->repack_start_te = tevent_add_timer(
+			ev, state, timeval_zero(),
+			scavenger_repack_start_timer, state);
+		if (state->repack_start_te == NULL) {
+			DEBUG(2, ("Failed to add scavenger_repack_start_timer "
+				  "event\n"));
+			goto fail;
+		}
+	}
+
 	smbd_scavenger_state = state;
 	return true;
 fail:
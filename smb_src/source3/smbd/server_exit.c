@@ -93,7 +93,9 @@ static void exit_server_common(enum server_exit_reason how,
 	if (client != NULL) {
 		sconn = client->sconn;
 		/*
-		 * Here we typically have just one connection
+		 * With multi-channel we may have more than one
+		 * connection, the first one is used for the
+		 * cleanup of the client wide tables.
 		 */
 		xconn = client->connections;
 	}
@@ -104,23 +106,38 @@ static void exit_server_common(enum server_exit_reason how,
 
 	change_to_root_user();
 
-	if (xconn != NULL) {
+	if (client != NULL) {
+		struct smbXsrv_connection *c = NULL;
+
 		/*
-		 * This is typically the disconnect for the only
-		 * (or with multi-channel last) connection of the client
+		 * This is the disconnect for the only
+		 * (or with multi-channel all) connections of the client
 		 */
-		if (NT_STATUS_IS_OK(xconn->transport.status)) {
-			switch (how) {
-			case SERVER_EXIT_ABNORMAL:
-				xconn->transport.status = NT_STATUS_INTERNAL_ERROR;
-				break;
-			case SERVER_EXIT_NORMAL:
-				xconn->transport.status = NT_STATUS_LOCAL_DISCONNECT;
-				break;
+		for (c = client->connections; c != NULL; c = c->next) {
+			if (NT_STATUS_IS_OK(c->transport.status)) {
+				switch (how) {
+				case SERVER_EXIT_ABNORMAL:
+					c->transport.status = NT_STATUS_INTERNAL_ERROR;
+					break;
+				case SERVER_EXIT_NORMAL:
+					c->transport.status = NT_STATUS_LOCAL_DISCONNECT;
+					break;
+				}
 			}
+
+			TALLOC_FREE(c->smb1.negprot.auth_context);
 		}
 
-		TALLOC_FREE(xconn->smb1.negprot.auth_context);
+		if (client->global != NULL) {
+			NTSTATUS status;
+
+			status = smbXsrv_client_remove(client);
+			if (!NT_STATUS_IS_OK(status)) {
+				DEBUG(0, ("exit_server_common: "
+					  "smbXsrv_client_remove() failed (%s)\n",
+					  nt_errstr(status)));
+			}
+		}
 	}
 
 	change_to_root_user();
@@ -218,7 +235,10 @@ static void exit_server_common(enum server_exit_reason how,
 	 * because smbd_msg_ctx is not a talloc child of smbd_server_conn.
 	 */
 	if (client != NULL) {
-		for (; xconn != NULL; xconn = xconn->next) {
+		struct smbXsrv_connection *next;
+
+		for (; xconn != NULL; xconn = next) {
+			next = xconn->next;
 			DLIST_REMOVE(client->connections, xconn);
 			talloc_free(xconn);
 		}
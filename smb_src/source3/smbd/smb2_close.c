@@ -300,6 +300,7 @@ struct smbd_smb2_close_state {
 	uint32_t out_file_attributes;
 };
 
+static void smbd_smb2_close_flushed(struct tevent_req *subreq);
 static void smbd_smb2_close_do(struct tevent_req *subreq);
 
 static struct tevent_req *smbd_smb2_close_send(TALLOC_CTX *mem_ctx,
@@ -309,6 +310,7 @@ static struct tevent_req *smbd_smb2_close_send(TALLOC_CTX *mem_ctx,
 					       uint16_t in_flags)
 {
 	struct tevent_req *req;
+	struct tevent_req *subreq;
 	struct smbd_smb2_close_state *state;
 	NTSTATUS status;
 
@@ -321,6 +323,24 @@ static struct tevent_req *smbd_smb2_close_send(TALLOC_CTX *mem_ctx,
 	state->in_fsp = in_fsp;
 	state->in_flags = in_flags;
 
+	if (smbd_smb2_worker_enabled(in_fsp->conn) && in_fsp->modified &&
+	    !in_fsp->is_directory && (in_fsp->fh->fd != -1)) {
+		/*
+		 * A network file system writes back the dirty data
+		 * in close(). Do that in a helper thread first, the
+		 * close below waits for it.
+		 */
+		subreq = SMB_VFS_FSYNC_SEND(state, ev, in_fsp);
+		if (tevent_req_nomem(subreq, req)) {
+			return tevent_req_post(req, ev);
+		}
+		if (!aio_add_req_to_fsp(in_fsp, subreq)) {
+			tevent_req_oom(req);
+			return tevent_req_post(req, ev);
+		}
+		tevent_req_set_callback(subreq, smbd_smb2_close_flushed, req);
+	}
+
 	if (in_fsp->num_aio_requests != 0) {
 
 		in_fsp->deferred_close = tevent_wait_send(in_fsp, ev);
@@ -351,6 +371,25 @@ static struct tevent_req *smbd_smb2_close_send(TALLOC_CTX *mem_ctx,
 	return tevent_req_post(req, ev);
 }
 
+static void smbd_smb2_close_flushed(struct tevent_req *subreq)
+{
+	int ret, err;
+
+	ret = SMB_VFS_FSYNC_RECV(subreq, &err);
+	if (ret == -1) {
+		/*
+		 * close() will report it again
+		 */
+		DEBUG(5, ("smbd_smb2_close_flushed: fsync failed: %s\n",
+			  strerror(err)));
+	}
+
+	/*
+	 * This lets smbd_smb2_close_do() run via fsp->deferred_close
+	 */
+	TALLOC_FREE(subreq);
+}
+
 static void smbd_smb2_close_do(struct tevent_req *subreq)
 {
 	struct tevent_req *req = tevent_req_callback_data(
@@ -26,6 +26,7 @@
 #include "../libcli/smb/smb_common.h"
 #include "../librpc/gen_ndr/ndr_security.h"
 #include "../librpc/gen_ndr/ndr_smb2_lease_struct.h"
+#include "librpc/gen_ndr/xattr.h"
 #include "../lib/util/tevent_ntstatus.h"
 #include "messages.h"
 
@@ -434,6 +435,8 @@ struct smbd_smb2_create_state {
 	struct timeval request_time;
 	struct file_id id;
 	struct deferred_open_record *open_rec;
+	struct tevent_req *prime_req;
+	bool primed;
 	uint8_t out_oplock_level;
 	uint32_t out_create_action;
 	struct timespec out_creation_ts;
@@ -448,6 +451,15 @@ struct smbd_smb2_create_state {
 	struct smb2_create_blobs *out_context_blobs;
 };
 
+/*
+ * Enough for a typical NT ACL, see get_acl_blob() in vfs_acl_xattr.c
+ */
+#define SMBD_SMB2_CREATE_PRIME_SIZE 1024
+
+static bool smbd_smb2_create_prime(struct tevent_req *req,
+				   struct tevent_context *ev,
+				   const struct smb_filename *smb_fname);
+
 static struct tevent_req *smbd_smb2_create_send(TALLOC_CTX *mem_ctx,
 			struct tevent_context *ev,
 			struct smbd_smb2_request *smb2req,
@@ -1055,6 +1067,12 @@ static struct tevent_req *smbd_smb2_create_send(TALLOC_CTX *mem_ctx,
 				return tevent_req_post(req, ev);
 			}
 
+			if (smbd_smb2_create_prime(req, ev, smb_fname)) {
+				/* We're re-dispatched once it's done */
+				TALLOC_FREE(smb_fname);
+				return req;
+			}
+
 			status = SMB_VFS_CREATE_FILE(smb1req->conn,
 						     smb1req,
 						     0, /* root_dir_fid */
@@ -1539,6 +1557,126 @@ bool schedule_deferred_open_message_smb2(
 	return true;
 }
 
+static void smbd_smb2_create_prime_done(struct tevent_req *subreq);
+static bool smbd_smb2_create_prime_cancel(struct tevent_req *req);
+
+/*
+ * With "aio metadata" or "smb2 worker threads" on a share with
+ * acl_xattr, read the NT ACL the access check of the open is going to
+ * need in a helper thread. On a slow file system this pulls it into
+ * the kernel's cache while the main process serves other requests.
+ * The result itself is not used, the create is re-dispatched once the
+ * read is done. This works on the name filename_convert() has already
+ * checked, for a new file it reads the ACL of the parent directory.
+ */
+static bool smbd_smb2_create_prime(struct tevent_req *req,
+				   struct tevent_context *ev,
+				   const struct smb_filename *smb_fname)
+{
+	struct smbd_smb2_create_state *state = tevent_req_data(
+		req, struct smbd_smb2_create_state);
+	connection_struct *conn = state->smb1req->conn;
+	const char *path = smb_fname->base_name;
+	char *parent = NULL;
+	uint8_t *buf;
+
+	if (state->primed) {
+		return false;
+	}
+	state->primed = true;
+
+	if (!smbd_smb2_worker_enabled(conn) || IS_IPC(conn) || IS_PRINT(conn)) {
+		return false;
+	}
+	if (!str_list_check(lp_vfs_objects(SNUM(conn)), "acl_xattr")) {
+		return false;
+	}
+
+	buf = talloc_size(state, SMBD_SMB2_CREATE_PRIME_SIZE);
+	if (buf == NULL) {
+		return false;
+	}
+
+	if (!VALID_STAT(smb_fname->st)) {
+		if (!parent_dirname(buf, path, &parent, NULL)) {
+			TALLOC_FREE(buf);
+			return false;
+		}
+		path = parent;
+	}
+
+	state->prime_req = SMB_VFS_GETXATTR_SEND(buf, ev, conn, path,
+						 XATTR_NTACL_NAME, buf,
+						 SMBD_SMB2_CREATE_PRIME_SIZE);
+	if (state->prime_req == NULL) {
+		TALLOC_FREE(buf);
+		return false;
+	}
+	if (!tevent_req_is_in_progress(state->prime_req)) {
+		/* Done synchronously, nothing to wait for */
+		TALLOC_FREE(buf);
+		state->prime_req = NULL;
+		return false;
+	}
+	tevent_req_set_callback(state->prime_req,
+				smbd_smb2_create_prime_done, req);
+	tevent_req_set_cancel_fn(req, smbd_smb2_create_prime_cancel);
+	return true;
+}
+
+static void smbd_smb2_create_prime_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct smbd_smb2_create_state *state = tevent_req_data(
+		req, struct smbd_smb2_create_state);
+	struct smbd_smb2_request *smb2req = state->smb2req;
+	uint8_t *buf = talloc_parent(subreq);
+	ssize_t ret;
+	int err;
+
+	ret = SMB_VFS_GETXATTR_RECV(subreq, &err);
+	state->prime_req = NULL;
+	TALLOC_FREE(buf);
+
+	DEBUG(10, ("smbd_smb2_create_prime_done: getxattr returned %d (%s), "
+		   "re-dispatching mid %llu\n", (int)ret,
+		   (ret == -1) ? strerror(err) : "ok",
+		   (unsigned long long)get_mid_from_smb2req(smb2req)));
+
+	tevent_req_set_cancel_fn(req, NULL);
+
+	/* See schedule_deferred_open_message_smb2() */
+	tevent_req_set_callback(req, NULL, NULL);
+
+	TALLOC_FREE(state->im);
+	state->im = tevent_create_immediate(smb2req);
+	if (state->im == NULL) {
+		smbd_server_connection_terminate(smb2req->xconn,
+			nt_errstr(NT_STATUS_NO_MEMORY));
+		return;
+	}
+	tevent_schedule_immediate(state->im,
+			smb2req->sconn->ev_ctx,
+			smbd_smb2_create_request_dispatch_immediate,
+			smb2req);
+}
+
+static bool smbd_smb2_create_prime_cancel(struct tevent_req *req)
+{
+	struct smbd_smb2_create_state *state = tevent_req_data(
+		req, struct smbd_smb2_create_state);
+
+	if (state->prime_req == NULL) {
+		return false;
+	}
+	TALLOC_FREE(state->prime_req);
+
+	tevent_req_defer_callback(req, state->smb2req->sconn->ev_ctx);
+	tevent_req_nterror(req, NT_STATUS_CANCELLED);
+	return true;
+}
+
 static bool smbd_smb2_create_cancel(struct tevent_req *req)
 {
 	struct smbd_smb2_request *smb2req = NULL;
@@ -194,9 +194,26 @@ static void smbd_smb2_request_find_done(struct tevent_req *subreq)
 
 struct smbd_smb2_find_state {
 	struct smbd_smb2_request *smb2req;
+	struct smb_request *smbreq;
+	struct files_struct *fsp;
+	const char *in_file_name;
+	uint8_t in_flags;
+	uint32_t in_output_buffer_length;
+	uint32_t info_level;
+	uint32_t max_count;
+	uint32_t dirtype;
+	bool dont_descend;
+	bool ask_sharemode;
+	NTSTATUS empty_status;
 	DATA_BLOB out_output_buffer;
 };
 
+static void smbd_smb2_find_turn(struct tevent_req *subreq);
+static void smbd_smb2_find_start(struct tevent_req *req,
+				 struct tevent_context *ev);
+static void smbd_smb2_find_prefetch_done(struct tevent_req *subreq);
+static void smbd_smb2_find_entries(struct tevent_req *req);
+
 static struct tevent_req *smbd_smb2_find_send(TALLOC_CTX *mem_ctx,
 					      struct tevent_context *ev,
 					      struct smbd_smb2_request *smb2req,
@@ -209,23 +226,12 @@ static struct tevent_req *smbd_smb2_find_send(TALLOC_CTX *mem_ctx,
 {
 	struct smbXsrv_connection *xconn = smb2req->xconn;
 	struct tevent_req *req;
+	struct tevent_req *subreq;
 	struct smbd_smb2_find_state *state;
 	struct smb_request *smbreq;
 	connection_struct *conn = smb2req->tcon->compat;
 	NTSTATUS status;
-	NTSTATUS empty_status;
 	uint32_t info_level;
-	uint32_t max_count;
-	char *pdata;
-	char *base_data;
-	char *end_data;
-	int last_entry_off = 0;
-	int off = 0;
-	uint32_t num = 0;
-	uint32_t dirtype = FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_DIRECTORY;
-	bool dont_descend = false;
-	bool ask_sharemode = true;
-	bool wcard_has_wild;
 	struct tm tm;
 	char *p;
 
@@ -321,6 +327,84 @@ static struct tevent_req *smbd_smb2_find_send(TALLOC_CTX *mem_ctx,
 		return tevent_req_post(req, ev);
 	}
 
+	state->smbreq = smbreq;
+	state->fsp = fsp;
+	state->in_flags = in_flags;
+	state->in_file_name = in_file_name;
+	state->in_output_buffer_length = in_output_buffer_length;
+	state->info_level = info_level;
+
+	if (!smbd_smb2_worker_enabled(conn)) {
+		smbd_smb2_find_start(req, ev);
+		if (!tevent_req_is_in_progress(req)) {
+			return tevent_req_post(req, ev);
+		}
+		return req;
+	}
+
+	/*
+	 * The requests before us on this handle may still wait
+	 * for helper threads, they have to finish with the
+	 * directory first.
+	 */
+	subreq = smbd_smb2_worker_wait_send(state, ev, fsp);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, smbd_smb2_find_turn, req);
+	return req;
+}
+
+static void smbd_smb2_find_turn(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct smbd_smb2_find_state *state = tevent_req_data(
+		req, struct smbd_smb2_find_state);
+	NTSTATUS status;
+
+	/*
+	 * Don't free subreq, it holds our turn on the
+	 * handle until the response is done.
+	 */
+	status = smbd_smb2_worker_wait_recv(subreq);
+	if (tevent_req_nterror(req, status)) {
+		return;
+	}
+
+	status = smbd_smb2_worker_become_user(state->smb2req);
+	if (tevent_req_nterror(req, status)) {
+		return;
+	}
+
+	smbd_smb2_find_start(req, state->smb2req->sconn->ev_ctx);
+}
+
+/*
+ * Position the directory and fill the response, via a batch of
+ * prefetched entries if possible
+ */
+static void smbd_smb2_find_start(struct tevent_req *req,
+				 struct tevent_context *ev)
+{
+	struct smbd_smb2_find_state *state = tevent_req_data(
+		req, struct smbd_smb2_find_state);
+	struct tevent_req *subreq;
+	struct files_struct *fsp = state->fsp;
+	connection_struct *conn = fsp->conn;
+	uint8_t in_flags = state->in_flags;
+	const char *in_file_name = state->in_file_name;
+	uint32_t in_output_buffer_length = state->in_output_buffer_length;
+	uint32_t info_level = state->info_level;
+	NTSTATUS status;
+	NTSTATUS empty_status;
+	uint32_t max_count;
+	uint32_t dirtype = FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_DIRECTORY;
+	bool dont_descend = false;
+	bool ask_sharemode = true;
+	bool wcard_has_wild;
+	int prefetch;
+
 	if (in_flags & SMB2_CONTINUE_FLAG_REOPEN) {
 		dptr_CloseDir(fsp);
 	}
@@ -345,7 +429,7 @@ static struct tevent_req *smbd_smb2_find_send(TALLOC_CTX *mem_ctx,
 				tmpbuf, sizeof(tmpbuf), &tmp, &to_free);
 			if (len == -1) {
 				tevent_req_oom(req);
-				return tevent_req_post(req, ev);
+				return;
 			}
 			fullpath = tmp;
 		}
@@ -360,10 +444,11 @@ static struct tevent_req *smbd_smb2_find_send(TALLOC_CTX *mem_ctx,
 		TALLOC_FREE(to_free);
 
 		if (tevent_req_nterror(req, status)) {
-			return tevent_req_post(req, ev);
+			return;
 		}
 
 		in_file_name = smb_fname->original_lcomp;
+		state->in_file_name = in_file_name;
 	}
 
 	if (fsp->dptr == NULL) {
@@ -380,7 +465,7 @@ static struct tevent_req *smbd_smb2_find_send(TALLOC_CTX *mem_ctx,
 				     &fsp->dptr);
 		if (!NT_STATUS_IS_OK(status)) {
 			tevent_req_nterror(req, status);
-			return tevent_req_post(req, ev);
+			return;
 		}
 
 		empty_status = NT_STATUS_NO_SUCH_FILE;
@@ -403,20 +488,10 @@ static struct tevent_req *smbd_smb2_find_send(TALLOC_CTX *mem_ctx,
 	state->out_output_buffer = data_blob_talloc(state, NULL,
 			in_output_buffer_length + DIR_ENTRY_SAFETY_MARGIN);
 	if (tevent_req_nomem(state->out_output_buffer.data, req)) {
-		return tevent_req_post(req, ev);
+		return;
 	}
 
 	state->out_output_buffer.length = 0;
-	pdata = (char *)state->out_output_buffer.data;
-	base_data = pdata;
-	/*
-	 * end_data must include the safety margin as it's what is
-	 * used to determine if pushed strings have been truncated.
-	 */
-	end_data = pdata + in_output_buffer_length + DIR_ENTRY_SAFETY_MARGIN - 1;
-	last_entry_off = 0;
-	off = 0;
-	num = 0;
 
 	DEBUG(8,("smbd_smb2_find_send: dirpath=<%s> dontdescend=<%s>, "
 		"in_output_buffer_length = %u\n",
@@ -431,6 +506,100 @@ static struct tevent_req *smbd_smb2_find_send(TALLOC_CTX *mem_ctx,
 				     "smbd", "search ask sharemode",
 				     true);
 
+	state->max_count = max_count;
+	state->dirtype = dirtype;
+	state->dont_descend = dont_descend;
+	state->ask_sharemode = ask_sharemode;
+	state->empty_status = empty_status;
+
+	/*
+	 * An entry takes about 100 bytes or more in the response,
+	 * don't stat more names than can fit.
+	 */
+#define DIR_ENTRY_PREFETCH_MIN_SIZE 96
+
+	prefetch = lp_parm_int(SNUM(conn), "smbd", "find prefetch", 1024);
+	prefetch = MIN(prefetch,
+		       in_output_buffer_length / DIR_ENTRY_PREFETCH_MIN_SIZE);
+	prefetch = MIN(prefetch, max_count);
+
+	if (!smbd_smb2_worker_enabled(conn) || dont_descend ||
+	    (info_level == SMB_FIND_FILE_NAMES_INFO) || (prefetch <= 1)) {
+		smbd_smb2_find_entries(req);
+		return;
+	}
+
+	/*
+	 * Let the VFS stat the next batch of names in parallel
+	 * instead of one by one in smbd_dirptr_get_entry().
+	 */
+	subreq = dptr_prefetch_send(state, ev, fsp->dptr, prefetch);
+	if (tevent_req_nomem(subreq, req)) {
+		return;
+	}
+	if (!aio_add_req_to_fsp(fsp, subreq)) {
+		tevent_req_oom(req);
+		return;
+	}
+	tevent_req_set_callback(subreq, smbd_smb2_find_prefetch_done, req);
+}
+
+static void smbd_smb2_find_prefetch_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct smbd_smb2_find_state *state = tevent_req_data(
+		req, struct smbd_smb2_find_state);
+	struct files_struct *fsp = state->fsp;
+	NTSTATUS status;
+
+	status = dptr_prefetch_recv(subreq, fsp->dptr);
+	TALLOC_FREE(subreq);
+	if (tevent_req_nterror(req, status)) {
+		return;
+	}
+	if (fsp->dptr == NULL) {
+		/* Closed by a REOPEN in the meantime */
+		tevent_req_nterror(req, NT_STATUS_INVALID_HANDLE);
+		return;
+	}
+
+	status = smbd_smb2_worker_become_user(state->smb2req);
+	if (tevent_req_nterror(req, status)) {
+		return;
+	}
+
+	smbd_smb2_find_entries(req);
+
+	dptr_prefetch_clear(fsp->dptr);
+}
+
+/*
+ * Fill the output buffer from fsp->dptr, this finishes req
+ */
+static void smbd_smb2_find_entries(struct tevent_req *req)
+{
+	struct smbd_smb2_find_state *state = tevent_req_data(
+		req, struct smbd_smb2_find_state);
+	struct files_struct *fsp = state->fsp;
+	connection_struct *conn = fsp->conn;
+	uint32_t in_output_buffer_length = state->in_output_buffer_length;
+	NTSTATUS status;
+	char *pdata;
+	char *base_data;
+	char *end_data;
+	int last_entry_off = 0;
+	int off = 0;
+	uint32_t num = 0;
+
+	pdata = (char *)state->out_output_buffer.data;
+	base_data = pdata;
+	/*
+	 * end_data must include the safety margin as it's what is
+	 * used to determine if pushed strings have been truncated.
+	 */
+	end_data = pdata + in_output_buffer_length + DIR_ENTRY_SAFETY_MARGIN - 1;
+
 	while (true) {
 		bool got_exact_match = false;
 		int space_remaining = in_output_buffer_length - off;
@@ -440,13 +609,13 @@ static struct tevent_req *smbd_smb2_find_send(TALLOC_CTX *mem_ctx,
 		status = smbd_dirptr_lanman2_entry(state,
 					       conn,
 					       fsp->dptr,
-					       smbreq->flags2,
-					       in_file_name,
-					       dirtype,
-					       info_level,
+					       state->smbreq->flags2,
+					       state->in_file_name,
+					       state->dirtype,
+					       state->info_level,
 					       false, /* requires_resume_key */
-					       dont_descend,
-					       ask_sharemode,
+					       state->dont_descend,
+					       state->ask_sharemode,
 					       8, /* align to 8 bytes */
 					       false, /* no padding */
 					       &pdata,
@@ -469,30 +638,29 @@ static struct tevent_req *smbd_smb2_find_send(TALLOC_CTX *mem_ctx,
 			} else if (num > 0) {
 				SIVAL(state->out_output_buffer.data, last_entry_off, 0);
 				tevent_req_done(req);
-				return tevent_req_post(req, ev);
+				return;
 			} else if (NT_STATUS_EQUAL(status, STATUS_MORE_ENTRIES)) {
 				tevent_req_nterror(req, NT_STATUS_INFO_LENGTH_MISMATCH);
-				return tevent_req_post(req, ev);
+				return;
 			} else {
-				tevent_req_nterror(req, empty_status);
-				return tevent_req_post(req, ev);
+				tevent_req_nterror(req, state->empty_status);
+				return;
 			}
 		}
 
 		num++;
 		state->out_output_buffer.length = off;
 
-		if (num < max_count) {
+		if (num < state->max_count) {
 			continue;
 		}
 
 		SIVAL(state->out_output_buffer.data, last_entry_off, 0);
 		tevent_req_done(req);
-		return tevent_req_post(req, ev);
+		return;
 	}
 
 	tevent_req_nterror(req, NT_STATUS_INTERNAL_ERROR);
-	return tevent_req_post(req, ev);
 }
 
 static NTSTATUS smbd_smb2_find_recv(struct tevent_req *req,
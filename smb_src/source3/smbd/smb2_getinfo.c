@@ -208,10 +208,17 @@ static void smbd_smb2_request_getinfo_done(struct tevent_req *subreq)
 
 struct smbd_smb2_getinfo_state {
 	struct smbd_smb2_request *smb2req;
+	struct files_struct *fsp;
+	uint16_t file_info_level;
+	uint32_t in_output_buffer_length;
 	NTSTATUS status;
 	DATA_BLOB out_output_buffer;
 };
 
+static void smbd_smb2_getinfo_file(struct tevent_req *req);
+static void smbd_smb2_getinfo_turn(struct tevent_req *subreq);
+static void smbd_smb2_getinfo_stat_done(struct tevent_req *subreq);
+
 static void smb2_ipc_getinfo(struct tevent_req *req,
 				struct smbd_smb2_getinfo_state *state,
 				struct tevent_context *ev,
@@ -285,33 +292,24 @@ static struct tevent_req *smbd_smb2_getinfo_send(TALLOC_CTX *mem_ctx,
 	switch (in_info_type) {
 	case SMB2_GETINFO_FILE:
 	{
-		uint16_t file_info_level;
-		char *data = NULL;
-		unsigned int data_size = 0;
-		bool delete_pending = false;
-		struct timespec write_time_ts;
-		struct file_id fileid;
-		struct ea_list *ea_list = NULL;
-		int lock_data_count = 0;
-		char *lock_data = NULL;
-		size_t fixed_portion;
-
-		ZERO_STRUCT(write_time_ts);
+		struct tevent_req *subreq;
 
 		switch (in_file_info_class) {
 		case 0x0F:/* RAW_FILEINFO_SMB2_ALL_EAS */
-			file_info_level = 0xFF00 | in_file_info_class;
+			state->file_info_level = 0xFF00 | in_file_info_class;
 			break;
 
 		case 0x12:/* RAW_FILEINFO_SMB2_ALL_INFORMATION */
-			file_info_level = 0xFF00 | in_file_info_class;
+			state->file_info_level = 0xFF00 | in_file_info_class;
 			break;
 
 		default:
 			/* the levels directly map to the passthru levels */
-			file_info_level = in_file_info_class + 1000;
+			state->file_info_level = in_file_info_class + 1000;
 			break;
 		}
+		state->fsp = fsp;
+		state->in_output_buffer_length = in_output_buffer_length;
 
 		if (fsp->fake_file_handle) {
 			/*
@@ -320,14 +318,36 @@ static struct tevent_req *smbd_smb2_getinfo_send(TALLOC_CTX *mem_ctx,
 
 			/* We know this name is ok, it's already passed the checks. */
 
-		} else if (fsp->fh->fd == -1) {
+			smbd_smb2_getinfo_file(req);
+			return tevent_req_post(req, ev);
+		}
+
+		if (!smbd_smb2_worker_enabled(conn) ||
+		    fsp->fsp_name->stream_name != NULL) {
+			goto sync_stat;
+		}
+
+		/*
+		 * Don't block the client connection on a slow file
+		 * system, the VFS can do the stat in a helper thread.
+		 * The requests before us on this handle go first.
+		 */
+		subreq = smbd_smb2_worker_wait_send(state, ev, fsp);
+		if (tevent_req_nomem(subreq, req)) {
+			return tevent_req_post(req, ev);
+		}
+		tevent_req_set_callback(subreq, smbd_smb2_getinfo_turn, req);
+		return req;
+
+sync_stat:
+		if (fsp->fh->fd == -1) {
 			/*
 			 * This is actually a QFILEINFO on a directory
 			 * handle (returned from an NT SMB). NT5.0 seems
 			 * to do this call. JRA.
 			 */
 
-			if (INFO_LEVEL_IS_UNIX(file_info_level)) {
+			if (INFO_LEVEL_IS_UNIX(state->file_info_level)) {
 				/* Always do lstat for UNIX calls. */
 				if (SMB_VFS_LSTAT(conn, fsp->fsp_name)) {
 					DEBUG(3,("smbd_smb2_getinfo_send: "
@@ -347,11 +367,6 @@ static struct tevent_req *smbd_smb2_getinfo_send(TALLOC_CTX *mem_ctx,
 				tevent_req_nterror(req, status);
 				return tevent_req_post(req, ev);
 			}
-
-			fileid = vfs_file_id_from_sbuf(conn,
-						       &fsp->fsp_name->st);
-			get_file_infos(fileid, fsp->name_hash,
-				&delete_pending, &write_time_ts);
 		} else {
 			/*
 			 * Original code - this is an open file.
@@ -365,56 +380,10 @@ static struct tevent_req *smbd_smb2_getinfo_send(TALLOC_CTX *mem_ctx,
 				tevent_req_nterror(req, status);
 				return tevent_req_post(req, ev);
 			}
-			fileid = vfs_file_id_from_sbuf(conn,
-						       &fsp->fsp_name->st);
-			get_file_infos(fileid, fsp->name_hash,
-				&delete_pending, &write_time_ts);
 		}
 
-		status = smbd_do_qfilepathinfo(conn, state,
-					       file_info_level,
-					       fsp,
-					       fsp->fsp_name,
-					       delete_pending,
-					       write_time_ts,
-					       ea_list,
-					       lock_data_count,
-					       lock_data,
-					       STR_UNICODE,
-					       in_output_buffer_length,
-					       &fixed_portion,
-					       &data,
-					       &data_size);
-		if (!NT_STATUS_IS_OK(status)) {
-			SAFE_FREE(data);
-			if (NT_STATUS_EQUAL(status, NT_STATUS_INVALID_LEVEL)) {
-				status = NT_STATUS_INVALID_INFO_CLASS;
-			}
-			tevent_req_nterror(req, status);
-			return tevent_req_post(req, ev);
-		}
-		if (in_output_buffer_length < fixed_portion) {
-			SAFE_FREE(data);
-			tevent_req_nterror(
-				req, NT_STATUS_INFO_LENGTH_MISMATCH);
-			return tevent_req_post(req, ev);
-		}
-		if (data_size > 0) {
-			state->out_output_buffer = data_blob_talloc(state,
-								    data,
-								    data_size);
-			SAFE_FREE(data);
-			if (tevent_req_nomem(state->out_output_buffer.data, req)) {
-				return tevent_req_post(req, ev);
-			}
-			if (data_size > in_output_buffer_length) {
-				state->out_output_buffer.length =
-					in_output_buffer_length;
-				status = STATUS_BUFFER_OVERFLOW;
-			}
-		}
-		SAFE_FREE(data);
-		break;
+		smbd_smb2_getinfo_file(req);
+		return tevent_req_post(req, ev);
 	}
 
 	case SMB2_GETINFO_FS:
@@ -537,6 +506,162 @@ static struct tevent_req *smbd_smb2_getinfo_send(TALLOC_CTX *mem_ctx,
 	return tevent_req_post(req, ev);
 }
 
+static void smbd_smb2_getinfo_turn(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct smbd_smb2_getinfo_state *state = tevent_req_data(
+		req, struct smbd_smb2_getinfo_state);
+	struct tevent_context *ev = state->smb2req->sconn->ev_ctx;
+	struct files_struct *fsp = state->fsp;
+	connection_struct *conn = fsp->conn;
+	NTSTATUS status;
+
+	/*
+	 * Don't free subreq, it holds our turn on fsp
+	 * until the response is done.
+	 */
+	status = smbd_smb2_worker_wait_recv(subreq);
+	if (tevent_req_nterror(req, status)) {
+		return;
+	}
+
+	status = smbd_smb2_worker_become_user(state->smb2req);
+	if (tevent_req_nterror(req, status)) {
+		return;
+	}
+
+	if (fsp->fh->fd != -1) {
+		subreq = SMB_VFS_FSTAT_SEND(state, ev, fsp,
+					    &fsp->fsp_name->st);
+	} else if (INFO_LEVEL_IS_UNIX(state->file_info_level)) {
+		/* Always do lstat for UNIX calls. */
+		subreq = SMB_VFS_LSTAT_SEND(state, ev, conn,
+					    fsp->fsp_name);
+	} else {
+		subreq = SMB_VFS_STAT_SEND(state, ev, conn,
+					   fsp->fsp_name);
+	}
+	if (tevent_req_nomem(subreq, req)) {
+		return;
+	}
+	if (!aio_add_req_to_fsp(fsp, subreq)) {
+		tevent_req_oom(req);
+		return;
+	}
+	tevent_req_set_callback(subreq, smbd_smb2_getinfo_stat_done, req);
+}
+
+static void smbd_smb2_getinfo_stat_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct smbd_smb2_getinfo_state *state = tevent_req_data(
+		req, struct smbd_smb2_getinfo_state);
+	struct files_struct *fsp = state->fsp;
+	NTSTATUS status;
+	int ret, err;
+
+	if (fsp->fh->fd != -1) {
+		ret = SMB_VFS_FSTAT_RECV(subreq, &err);
+	} else if (INFO_LEVEL_IS_UNIX(state->file_info_level)) {
+		ret = SMB_VFS_LSTAT_RECV(subreq, &err);
+	} else {
+		ret = SMB_VFS_STAT_RECV(subreq, &err);
+	}
+	TALLOC_FREE(subreq);
+	if (ret == -1) {
+		DEBUG(3, ("smbd_smb2_getinfo_stat_done: "
+			  "stat of %s failed (%s)\n",
+			  fsp_str_dbg(fsp), strerror(err)));
+		tevent_req_nterror(req, map_nt_error_from_unix(err));
+		return;
+	}
+
+	status = smbd_smb2_worker_become_user(state->smb2req);
+	if (tevent_req_nterror(req, status)) {
+		return;
+	}
+
+	smbd_smb2_getinfo_file(req);
+}
+
+/*
+ * SMB2_GETINFO_FILE, fsp->fsp_name->st is up to date
+ */
+static void smbd_smb2_getinfo_file(struct tevent_req *req)
+{
+	struct smbd_smb2_getinfo_state *state = tevent_req_data(
+		req, struct smbd_smb2_getinfo_state);
+	struct files_struct *fsp = state->fsp;
+	connection_struct *conn = fsp->conn;
+	uint32_t in_output_buffer_length = state->in_output_buffer_length;
+	char *data = NULL;
+	unsigned int data_size = 0;
+	bool delete_pending = false;
+	struct timespec write_time_ts;
+	struct file_id fileid;
+	struct ea_list *ea_list = NULL;
+	int lock_data_count = 0;
+	char *lock_data = NULL;
+	size_t fixed_portion;
+	NTSTATUS status;
+
+	ZERO_STRUCT(write_time_ts);
+
+	if (!fsp->fake_file_handle) {
+		fileid = vfs_file_id_from_sbuf(conn, &fsp->fsp_name->st);
+		get_file_infos(fileid, fsp->name_hash,
+			       &delete_pending, &write_time_ts);
+	}
+
+	status = smbd_do_qfilepathinfo(conn, state,
+				       state->file_info_level,
+				       fsp,
+				       fsp->fsp_name,
+				       delete_pending,
+				       write_time_ts,
+				       ea_list,
+				       lock_data_count,
+				       lock_data,
+				       STR_UNICODE,
+				       in_output_buffer_length,
+				       &fixed_portion,
+				       &data,
+				       &data_size);
+	if (!NT_STATUS_IS_OK(status)) {
+		SAFE_FREE(data);
+		if (NT_STATUS_EQUAL(status, NT_STATUS_INVALID_LEVEL)) {
+			status = NT_STATUS_INVALID_INFO_CLASS;
+		}
+		tevent_req_nterror(req, status);
+		return;
+	}
+	if (in_output_buffer_length < fixed_portion) {
+		SAFE_FREE(data);
+		tevent_req_nterror(req, NT_STATUS_INFO_LENGTH_MISMATCH);
+		return;
+	}
+	if (data_size > 0) {
+		state->out_output_buffer = data_blob_talloc(state,
+							    data,
+							    data_size);
+		SAFE_FREE(data);
+		if (tevent_req_nomem(state->out_output_buffer.data, req)) {
+			return;
+		}
+		if (data_size > in_output_buffer_length) {
+			state->out_output_buffer.length =
+				in_output_buffer_length;
+			status = STATUS_BUFFER_OVERFLOW;
+		}
+	}
+	SAFE_FREE(data);
+
+	state->status = status;
+	tevent_req_done(req);
+}
+
 static NTSTATUS smbd_smb2_getinfo_recv(struct tevent_req *req,
 				       TALLOC_CTX *mem_ctx,
 				       DATA_BLOB *out_output_buffer,
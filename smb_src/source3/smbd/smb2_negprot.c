@@ -141,6 +141,7 @@ NTSTATUS smbd_smb2_request_process_negprot(struct smbd_smb2_request *req)
 	struct GUID in_guid;
 	uint16_t dialect = 0;
 	uint32_t capabilities;
+	uint16_t cipher = 0;
 	DATA_BLOB out_guid_blob;
 	struct GUID out_guid;
 	enum protocol_types protocol = PROTOCOL_NONE;
@@ -149,6 +150,9 @@ NTSTATUS smbd_smb2_request_process_negprot(struct smbd_smb2_request *req)
 	uint32_t max_read = lp_smb2_max_read();
 	uint32_t max_write = lp_smb2_max_write();
 	NTTIME now = timeval_to_nttime(&req->request_time);
+	const uint8_t *inhdr = SMBD_SMB2_IN_HDR_PTR(req);
+	uint64_t in_mid = BVAL(inhdr, SMB2_HDR_MESSAGE_ID);
+	struct smbXsrv_client_global0 *global0 = NULL;
 
 	status = smbd_smb2_request_verify_sizes(req, 0x24);
 	if (!NT_STATUS_IS_OK(status)) {
@@ -242,6 +246,25 @@ NTSTATUS smbd_smb2_request_process_negprot(struct smbd_smb2_request *req)
 	    (lp_smb_encrypt(-1) != SMB_SIGNING_OFF) &&
 	    (in_capabilities & SMB2_CAP_ENCRYPTION)) {
 		capabilities |= SMB2_CAP_ENCRYPTION;
+		/*
+		 * SMB 3.0 and 3.02 only know about AES-CCM-128,
+		 * AES-GCM-128 can only be selected via an
+		 * SMB 3.1.1 encryption negotiate context.
+		 */
+		cipher = SMB2_ENCRYPTION_AES128_CCM;
+	}
+
+	/*
+	 * Multi-channel is only possible if the connection
+	 * can be passed to the process owning the client guid,
+	 * which requires the SMB2 negprot to be the first
+	 * request on the connection (mid == 0).
+	 */
+	if ((protocol >= PROTOCOL_SMB2_22) &&
+	    xconn->client->server_multi_channel_enabled &&
+	    (in_mid == 0) &&
+	    (in_capabilities & SMB2_CAP_MULTI_CHANNEL)) {
+		capabilities |= SMB2_CAP_MULTI_CHANNEL;
 	}
 
 	/*
@@ -253,8 +276,8 @@ NTSTATUS smbd_smb2_request_process_negprot(struct smbd_smb2_request *req)
 	if (protocol >= PROTOCOL_SMB2_10) {
 		int p = 0;
 
-		if (tsocket_address_is_inet(req->sconn->local_address, "ip")) {
-			p = tsocket_address_inet_port(req->sconn->local_address);
+		if (tsocket_address_is_inet(xconn->local_address, "ip")) {
+			p = tsocket_address_inet_port(xconn->local_address);
 		}
 
 		/* largeMTU is not supported over NBT (tcp port 139) */
@@ -357,7 +380,63 @@ NTSTATUS smbd_smb2_request_process_negprot(struct smbd_smb2_request *req)
 		xconn->smb2.server.max_trans = max_trans;
 		xconn->smb2.server.max_read  = max_read;
 		xconn->smb2.server.max_write = max_write;
+		xconn->smb2.server.cipher = cipher;
+	}
+
+	if (!(capabilities & SMB2_CAP_MULTI_CHANNEL)) {
+		/*
+		 * We only deal with the client guid database
+		 * if multi-channel was negotiated.
+		 */
+		return smbd_smb2_request_done(req, outbody, &outdyn);
+	}
+
+	if (xconn->smb2.client.guid_verified) {
+		/*
+		 * This connection was passed from another
+		 * smbd process, or it's an additional connection
+		 * within the process owning the client guid.
+		 */
+		return smbd_smb2_request_done(req, outbody, &outdyn);
+	}
+
+	status = smb2srv_client_lookup_global(xconn->client,
+					      xconn->smb2.client.guid,
+					      req, &global0);
+	if (NT_STATUS_EQUAL(status, NT_STATUS_OBJECTID_NOT_FOUND)) {
+		xconn->client->global->client_guid = xconn->smb2.client.guid;
+		status = smbXsrv_client_update(xconn->client);
+		if (!NT_STATUS_IS_OK(status)) {
+			return smbd_smb2_request_error(req, status);
+		}
+
+		xconn->smb2.client.guid_verified = true;
+		return smbd_smb2_request_done(req, outbody, &outdyn);
+	}
+	if (!NT_STATUS_IS_OK(status)) {
+		return smbd_smb2_request_error(req, status);
+	}
+
+	if (server_id_equal(&global0->server_id,
+			    &xconn->client->global->server_id)) {
+		/*
+		 * We already own the client guid.
+		 */
+		xconn->smb2.client.guid_verified = true;
+		return smbd_smb2_request_done(req, outbody, &outdyn);
+	}
+
+	/*
+	 * Another smbd process owns the client guid,
+	 * pass the connection with the negprot request
+	 * to it and forget about the connection.
+	 */
+	status = smb2srv_client_connection_pass(req, global0);
+	if (!NT_STATUS_IS_OK(status)) {
+		return smbd_smb2_request_error(req, status);
 	}
 
-	return smbd_smb2_request_done(req, outbody, &outdyn);
+	smbd_server_connection_terminate(xconn,
+					 "passed connection");
+	return NT_STATUS_OBJECTID_EXISTS;
 }
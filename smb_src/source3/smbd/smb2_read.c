@@ -26,6 +26,7 @@
 #include "libcli/security/security.h"
 #include "../lib/util/tevent_ntstatus.h"
 #include "rpc_server/srv_pipe_hnd.h"
+#include "smbprofile.h"
 
 static struct tevent_req *smbd_smb2_read_send(TALLOC_CTX *mem_ctx,
 					      struct tevent_context *ev,
@@ -38,8 +39,160 @@ static struct tevent_req *smbd_smb2_read_send(TALLOC_CTX *mem_ctx,
 static NTSTATUS smbd_smb2_read_recv(struct tevent_req *req,
 				    TALLOC_CTX *mem_ctx,
 				    DATA_BLOB *out_data,
+				    size_t *out_tailroom,
 				    uint32_t *out_remaining);
 
+/*
+ * We keep a few page aligned read buffers per connection.
+ * Large buffers from malloc() are typically mmap'ed, the kernel
+ * would have to map and zero the pages again for every read.
+ *
+ * The buffer size is rounded up to SMBD_SMB2_READ_BUFFER_ALIGN,
+ * clients typically use a fixed read size, so we only reuse
+ * buffers with the exact size.
+ */
+#define SMBD_SMB2_READ_BUFFER_ALIGN (64*1024)
+#define SMBD_SMB2_READ_BUFFER_SLOTS 16
+#define SMBD_SMB2_READ_BUFFER_MAX_CACHED (16*1024*1024)
+
+struct smbd_smb2_read_buffer_pool {
+	struct {
+		uint8_t *data;
+		size_t size;
+	} cached[SMBD_SMB2_READ_BUFFER_SLOTS];
+	size_t cached_bytes;
+	struct smbd_smb2_read_buffer *used;
+};
+
+static int smbd_smb2_read_buffer_pool_destructor(
+	struct smbd_smb2_read_buffer_pool *pool)
+{
+	struct smbd_smb2_read_buffer *buf;
+	unsigned i;
+
+	for (i=0; i<SMBD_SMB2_READ_BUFFER_SLOTS; i++) {
+		SAFE_FREE(pool->cached[i].data);
+	}
+	pool->cached_bytes = 0;
+
+	for (buf = pool->used; buf != NULL; buf = buf->next) {
+		buf->pool = NULL;
+	}
+	pool->used = NULL;
+
+	return 0;
+}
+
+static int smbd_smb2_read_buffer_destructor(struct smbd_smb2_read_buffer *buf)
+{
+	struct smbd_smb2_read_buffer_pool *pool = buf->pool;
+	unsigned i;
+
+	if (pool == NULL) {
+		SAFE_FREE(buf->data);
+		return 0;
+	}
+
+	DLIST_REMOVE(pool->used, buf);
+	buf->pool = NULL;
+
+	if (pool->cached_bytes + buf->size > SMBD_SMB2_READ_BUFFER_MAX_CACHED) {
+		SAFE_FREE(buf->data);
+		return 0;
+	}
+
+	for (i=0; i<SMBD_SMB2_READ_BUFFER_SLOTS; i++) {
+		if (pool->cached[i].data == NULL) {
+			break;
+		}
+	}
+	if (i == SMBD_SMB2_READ_BUFFER_SLOTS) {
+		SAFE_FREE(buf->data);
+		return 0;
+	}
+
+	pool->cached[i].data = buf->data;
+	pool->cached[i].size = buf->size;
+	pool->cached_bytes += buf->size;
+	buf->data = NULL;
+
+	return 0;
+}
+
+/*
+ * Get a buffer for at least length bytes. There's always room
+ * for 8 more bytes, the padding of a compound response can be
+ * added without copying the data.
+ */
+struct smbd_smb2_read_buffer *smbd_smb2_read_buffer_get(
+	TALLOC_CTX *mem_ctx,
+	struct smbXsrv_connection *xconn,
+	size_t length)
+{
+	struct smbd_smb2_read_buffer_pool *pool = xconn->smb2.read_buffers;
+	struct smbd_smb2_read_buffer *buf;
+	size_t size;
+	unsigned i;
+
+	size = length + 8;
+	if (size < length) {
+		return NULL;
+	}
+	size = (size + SMBD_SMB2_READ_BUFFER_ALIGN - 1) &
+		~(size_t)(SMBD_SMB2_READ_BUFFER_ALIGN - 1);
+	if (size <= length || size > UINT_MAX) {
+		return NULL;
+	}
+
+	if (pool == NULL) {
+		pool = talloc_zero(xconn, struct smbd_smb2_read_buffer_pool);
+		if (pool == NULL) {
+			return NULL;
+		}
+		talloc_set_destructor(pool,
+				      smbd_smb2_read_buffer_pool_destructor);
+		xconn->smb2.read_buffers = pool;
+	}
+
+	buf = talloc_zero(mem_ctx, struct smbd_smb2_read_buffer);
+	if (buf == NULL) {
+		return NULL;
+	}
+	buf->size = size;
+
+	for (i=0; i<SMBD_SMB2_READ_BUFFER_SLOTS; i++) {
+		if (pool->cached[i].size != size) {
+			continue;
+		}
+		if (pool->cached[i].data == NULL) {
+			continue;
+		}
+		buf->data = pool->cached[i].data;
+		pool->cached[i].data = NULL;
+		pool->cached[i].size = 0;
+		pool->cached_bytes -= size;
+		DO_PROFILE_INC(smb2_read_buffer_hits);
+		break;
+	}
+
+	if (buf->data == NULL) {
+		buf->data = (uint8_t *)memalign_array(sizeof(uint8_t),
+						      getpagesize(),
+						      size);
+		if (buf->data == NULL) {
+			TALLOC_FREE(buf);
+			return NULL;
+		}
+		DO_PROFILE_INC(smb2_read_buffer_misses);
+	}
+
+	buf->pool = pool;
+	DLIST_ADD(pool->used, buf);
+	talloc_set_destructor(buf, smbd_smb2_read_buffer_destructor);
+
+	return buf;
+}
+
 static void smbd_smb2_request_read_done(struct tevent_req *subreq);
 NTSTATUS smbd_smb2_request_process_read(struct smbd_smb2_request *req)
 {
@@ -108,13 +261,17 @@ static void smbd_smb2_request_read_done(struct tevent_req *subreq)
 	DATA_BLOB outdyn;
 	uint8_t out_data_offset;
 	DATA_BLOB out_data_buffer = data_blob_null;
+	size_t out_data_tailroom = 0;
 	uint32_t out_data_remaining = 0;
+	uint32_t next_command_ofs;
+	size_t pad_size;
 	NTSTATUS status;
 	NTSTATUS error; /* transport error */
 
 	status = smbd_smb2_read_recv(subreq,
 				     req,
 				     &out_data_buffer,
+				     &out_data_tailroom,
 				     &out_data_remaining);
 	TALLOC_FREE(subreq);
 	if (!NT_STATUS_IS_OK(status)) {
@@ -152,6 +309,21 @@ static void smbd_smb2_request_read_done(struct tevent_req *subreq)
 
 	outdyn = out_data_buffer;
 
+	/*
+	 * If there's a next response in the compound chain,
+	 * add the padding in our buffer, otherwise
+	 * smbd_smb2_request_done() would copy the data.
+	 * The header and body are 8 byte aligned.
+	 */
+	next_command_ofs = IVAL(SMBD_SMB2_OUT_HDR_PTR(req),
+				SMB2_HDR_NEXT_COMMAND);
+	pad_size = (8 - (outdyn.length % 8)) % 8;
+	if (next_command_ofs != 0 && pad_size != 0 &&
+	    pad_size <= out_data_tailroom) {
+		memset(outdyn.data + outdyn.length, 0, pad_size);
+		outdyn.length += pad_size;
+	}
+
 	error = smbd_smb2_request_done(req, outbody, &outdyn);
 	if (!NT_STATUS_IS_OK(error)) {
 		smbd_server_connection_terminate(req->xconn,
@@ -169,6 +341,7 @@ struct smbd_smb2_read_state {
 	uint32_t in_minimum;
 	DATA_BLOB out_headers;
 	uint8_t _out_hdr_buf[NBT_HDR_SIZE + SMB2_HDR_BODY + 0x10];
+	struct smbd_smb2_read_buffer *out_buf;
 	DATA_BLOB out_data;
 	uint32_t out_remaining;
 };
@@ -494,10 +667,17 @@ static struct tevent_req *smbd_smb2_read_send(TALLOC_CTX *mem_ctx,
 		return tevent_req_post(req, ev);
 	}
 
+	/* Allocate the out buffer, the data is read directly into it. */
+	state->out_buf = smbd_smb2_read_buffer_get(state, smb2req->xconn,
+						   in_length);
+	if (tevent_req_nomem(state->out_buf, req)) {
+		return tevent_req_post(req, ev);
+	}
+	state->out_data = data_blob_const(state->out_buf->data, in_length);
+
 	status = schedule_smb2_aio_read(fsp->conn,
 				smbreq,
 				fsp,
-				state,
 				&state->out_data,
 				(off_t)in_offset,
 				(size_t)in_length);
@@ -534,6 +714,8 @@ static struct tevent_req *smbd_smb2_read_send(TALLOC_CTX *mem_ctx,
 	/* Try sendfile in preference. */
 	status = schedule_smb2_sendfile_read(smb2req, state);
 	if (NT_STATUS_IS_OK(status)) {
+		TALLOC_FREE(state->out_buf);
+		state->out_data.data = NULL;
 		tevent_req_done(req);
 		return tevent_req_post(req, ev);
 	} else {
@@ -544,13 +726,7 @@ static struct tevent_req *smbd_smb2_read_send(TALLOC_CTX *mem_ctx,
 		}
 	}
 
-	/* Ok, read into memory. Allocate the out buffer. */
-	state->out_data = data_blob_talloc(state, NULL, in_length);
-	if (in_length > 0 && tevent_req_nomem(state->out_data.data, req)) {
-		SMB_VFS_STRICT_UNLOCK(conn, fsp, &lock);
-		return tevent_req_post(req, ev);
-	}
-
+	/* Ok, read into memory. */
 	nread = read_file(fsp,
 			  (char *)state->out_data.data,
 			  in_offset,
@@ -616,6 +792,7 @@ static void smbd_smb2_read_pipe_done(struct tevent_req *subreq)
 static NTSTATUS smbd_smb2_read_recv(struct tevent_req *req,
 				    TALLOC_CTX *mem_ctx,
 				    DATA_BLOB *out_data,
+				    size_t *out_tailroom,
 				    uint32_t *out_remaining)
 {
 	NTSTATUS status;
@@ -628,7 +805,13 @@ static NTSTATUS smbd_smb2_read_recv(struct tevent_req *req,
 	}
 
 	*out_data = state->out_data;
-	talloc_steal(mem_ctx, out_data->data);
+	*out_tailroom = 0;
+	if (state->out_buf != NULL) {
+		talloc_steal(mem_ctx, state->out_buf);
+		*out_tailroom = state->out_buf->size - out_data->length;
+	} else {
+		talloc_steal(mem_ctx, out_data->data);
+	}
 	*out_remaining = state->out_remaining;
 
 	if (state->out_headers.length > 0) {
@@ -35,6 +35,8 @@ static void smbd_smb2_connection_handler(struct tevent_context *ev,
 					 uint16_t flags,
 					 void *private_data);
 static NTSTATUS smbd_smb2_flush_send_queue(struct smbXsrv_connection *xconn);
+static NTSTATUS smbd_smb2_send_queue_add(struct smbXsrv_connection *xconn,
+					 struct smbd_smb2_send_queue *e);
 
 static const struct smbd_smb2_dispatch_table {
 	uint16_t opcode;
@@ -400,7 +402,7 @@ static NTSTATUS smbd_smb2_inbuf_parse_compound(struct smbXsrv_connection *xconn,
 			tf_iov[1].iov_len = enc_len;
 
 			status = smb2_signing_decrypt_pdu(s->global->decryption_key,
-							  xconn->protocol,
+							  xconn->smb2.server.cipher,
 							  tf_iov, 2);
 			if (!NT_STATUS_IS_OK(status)) {
 				TALLOC_FREE(iov_alloc);
@@ -1041,13 +1043,79 @@ static NTSTATUS smbd_smb2_request_setup_out(struct smbd_smb2_request *req)
 	return NT_STATUS_OK;
 }
 
+static void smbd_server_connection_free_handler(struct tevent_context *ctx,
+					       struct tevent_immediate *im,
+					       void *private_data)
+{
+	struct smbXsrv_connection *xconn =
+		talloc_get_type_abort(private_data,
+		struct smbXsrv_connection);
+
+	TALLOC_FREE(im);
+	TALLOC_FREE(xconn);
+}
+
 void smbd_server_connection_terminate_ex(struct smbXsrv_connection *xconn,
 					 const char *reason,
 					 const char *location)
 {
+	struct smbXsrv_client *client = xconn->client;
+	struct tevent_immediate *im = NULL;
+	NTSTATUS status;
+
 	DEBUG(10,("smbd_server_connection_terminate_ex: reason[%s] at %s\n",
 		  reason, location));
-	exit_server_cleanly(reason);
+
+	if (xconn->transport.sock == -1) {
+		/*
+		 * The connection was already dropped
+		 */
+		return;
+	}
+
+	if (client->connections->next == NULL) {
+		exit_server_cleanly(reason);
+		return;
+	}
+
+	/*
+	 * There are other channels of the client left,
+	 * so we only drop this connection.
+	 */
+	DEBUG(1,("smbd_server_connection_terminate_ex: "
+		 "dropping connection %s: reason[%s] at %s\n",
+		 smbXsrv_connection_dbg(xconn), reason, location));
+
+	if (NT_STATUS_IS_OK(xconn->transport.status)) {
+		xconn->transport.status = NT_STATUS_CONNECTION_DISCONNECTED;
+	}
+	TALLOC_FREE(xconn->transport.fde);
+	if (xconn->transport.sock != -1) {
+		close(xconn->transport.sock);
+		xconn->transport.sock = -1;
+	}
+
+	DLIST_REMOVE(client->connections, xconn);
+
+	status = smbXsrv_session_disconnect_xconn(xconn);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(0,("smbd_server_connection_terminate_ex: "
+			 "smbXsrv_session_disconnect_xconn() failed: %s\n",
+			 nt_errstr(status)));
+	}
+
+	/*
+	 * We may be called from within a request of
+	 * the connection, so we free it later.
+	 */
+	im = tevent_create_immediate(client);
+	if (im == NULL) {
+		exit_server_cleanly("tevent_create_immediate() failed");
+		return;
+	}
+	tevent_schedule_immediate(im, client->ev_ctx,
+				  smbd_server_connection_free_handler,
+				  xconn);
 }
 
 static bool dup_smb2_vec4(TALLOC_CTX *ctx,
@@ -1249,7 +1317,7 @@ static NTSTATUS smb2_send_async_interim_response(const struct smbd_smb2_request
 	 */
 	if (firsttf->iov_len == SMB2_TF_HDR_SIZE) {
 		status = smb2_signing_encrypt_pdu(req->first_key,
-					xconn->protocol,
+					xconn->smb2.server.cipher,
 					firsttf,
 					nreq->out.vector_count - first_idx);
 		if (!NT_STATUS_IS_OK(status)) {
@@ -1257,6 +1325,7 @@ static NTSTATUS smb2_send_async_interim_response(const struct smbd_smb2_request
 		}
 	} else if (req->last_key.length > 0) {
 		status = smb2_signing_sign_pdu(req->last_key,
+					       NULL,
 					       xconn->protocol,
 					       outhdr_v,
 					       SMBD_SMB2_NUM_IOV_PER_REQ - 1);
@@ -1268,10 +1337,7 @@ static NTSTATUS smb2_send_async_interim_response(const struct smbd_smb2_request
 	nreq->queue_entry.mem_ctx = nreq;
 	nreq->queue_entry.vector = nreq->out.vector;
 	nreq->queue_entry.count = nreq->out.vector_count;
-	DLIST_ADD_END(xconn->smb2.send_queue, &nreq->queue_entry, NULL);
-	xconn->smb2.send_queue_len++;
-
-	status = smbd_smb2_flush_send_queue(xconn);
+	status = smbd_smb2_send_queue_add(xconn, &nreq->queue_entry);
 	if (!NT_STATUS_IS_OK(status)) {
 		return status;
 	}
@@ -1419,16 +1485,30 @@ NTSTATUS smbd_smb2_request_pending_queue(struct smbd_smb2_request *req,
 	return NT_STATUS_OK;
 }
 
+/*
+ * Returns the signing key for the channel and the cache
+ * for its key schedule, *state is NULL if there's no channel
+ * or no memory for the cache.
+ */
 static DATA_BLOB smbd_smb2_signing_key(struct smbXsrv_session *session,
-				       struct smbXsrv_connection *xconn)
+				       struct smbXsrv_connection *xconn,
+				       struct smb2_signing_state **state)
 {
 	struct smbXsrv_channel_global0 *c = NULL;
 	NTSTATUS status;
 	DATA_BLOB key = data_blob_null;
 
+	*state = NULL;
+
 	status = smbXsrv_session_find_channel(session, xconn, &c);
 	if (NT_STATUS_IS_OK(status)) {
 		key = c->signing_key;
+
+		if (c->signing_state == NULL) {
+			c->signing_state = smb2_signing_state_create(
+							session->global);
+		}
+		*state = c->signing_state;
 	}
 
 	if (key.length == 0) {
@@ -1590,7 +1670,7 @@ static void smbd_smb2_request_pending_timer(struct tevent_context *ev,
 		DATA_BLOB encryption_key = x->global->encryption_key;
 
 		status = smb2_signing_encrypt_pdu(encryption_key,
-					xconn->protocol,
+					xconn->smb2.server.cipher,
 					&state->vector[1+SMBD_SMB2_TF_IOV_OFS],
 					SMBD_SMB2_NUM_IOV_PER_REQ);
 		if (!NT_STATUS_IS_OK(status)) {
@@ -1600,9 +1680,12 @@ static void smbd_smb2_request_pending_timer(struct tevent_context *ev,
 		}
 	} else if (req->do_signing) {
 		struct smbXsrv_session *x = req->session;
-		DATA_BLOB signing_key = smbd_smb2_signing_key(x, xconn);
+		struct smb2_signing_state *signing_state = NULL;
+		DATA_BLOB signing_key = smbd_smb2_signing_key(x, xconn,
+							      &signing_state);
 
 		status = smb2_signing_sign_pdu(signing_key,
+					signing_state,
 					xconn->protocol,
 					&state->vector[1+SMBD_SMB2_HDR_IOV_OFS],
 					SMBD_SMB2_NUM_IOV_PER_REQ - 1);
@@ -1616,10 +1699,7 @@ static void smbd_smb2_request_pending_timer(struct tevent_context *ev,
 	state->queue_entry.mem_ctx = state;
 	state->queue_entry.vector = state->vector;
 	state->queue_entry.count = ARRAY_SIZE(state->vector);
-	DLIST_ADD_END(xconn->smb2.send_queue, &state->queue_entry, NULL);
-	xconn->smb2.send_queue_len++;
-
-	status = smbd_smb2_flush_send_queue(xconn);
+	status = smbd_smb2_send_queue_add(xconn, &state->queue_entry);
 	if (!NT_STATUS_IS_OK(status)) {
 		smbd_server_connection_terminate(xconn,
 						 nt_errstr(status));
@@ -1810,6 +1890,20 @@ static NTSTATUS smbd_smb2_request_check_session(struct smbd_smb2_request *req)
 		return status;
 	}
 
+	if (in_opcode != SMB2_OP_SESSSETUP) {
+		struct smbXsrv_channel_global0 *c = NULL;
+
+		/*
+		 * With multi-channel the session needs
+		 * to be bound to this connection.
+		 */
+		status = smbXsrv_session_find_channel(session,
+						      req->xconn, &c);
+		if (!NT_STATUS_IS_OK(status)) {
+			return status;
+		}
+	}
+
 	session_info = session->global->auth_session_info;
 	if (session_info == NULL) {
 		return NT_STATUS_INVALID_HANDLE;
@@ -2050,6 +2144,7 @@ NTSTATUS smbd_smb2_request_dispatch(struct smbd_smb2_request *req)
 		signing_required = false;
 	} else if (signing_required || (flags & SMB2_HDR_FLAG_SIGNED)) {
 		DATA_BLOB signing_key = data_blob_null;
+		struct smb2_signing_state *signing_state = NULL;
 
 		if (x == NULL) {
 			/*
@@ -2071,7 +2166,7 @@ NTSTATUS smbd_smb2_request_dispatch(struct smbd_smb2_request *req)
 			return smbd_smb2_request_error(req, status);
 		}
 
-		signing_key = smbd_smb2_signing_key(x, xconn);
+		signing_key = smbd_smb2_signing_key(x, xconn, &signing_state);
 
 		/*
 		 * If we have a signing key, we should
@@ -2082,6 +2177,7 @@ NTSTATUS smbd_smb2_request_dispatch(struct smbd_smb2_request *req)
 		}
 
 		status = smb2_signing_check_pdu(signing_key,
+						signing_state,
 						xconn->protocol,
 						SMBD_SMB2_IN_HDR_IOV(req),
 						SMBD_SMB2_NUM_IOV_PER_REQ - 1);
@@ -2423,6 +2519,7 @@ static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
 		 * with the last signing key we remembered.
 		 */
 		status = smb2_signing_sign_pdu(req->last_key,
+					       NULL,
 					       xconn->protocol,
 					       lasthdr,
 					       SMBD_SMB2_NUM_IOV_PER_REQ - 1);
@@ -2452,7 +2549,9 @@ static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
 
 		if (req->do_signing && firsttf->iov_len == 0) {
 			struct smbXsrv_session *x = req->session;
-			DATA_BLOB signing_key = smbd_smb2_signing_key(x, xconn);
+			struct smb2_signing_state *signing_state = NULL;
+			DATA_BLOB signing_key = smbd_smb2_signing_key(x, xconn,
+								&signing_state);
 
 			/*
 			 * we need to remember the signing key
@@ -2488,7 +2587,7 @@ static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
 	 */
 	if (firsttf->iov_len == SMB2_TF_HDR_SIZE) {
 		status = smb2_signing_encrypt_pdu(req->first_key,
-					xconn->protocol,
+					xconn->smb2.server.cipher,
 					firsttf,
 					req->out.vector_count - first_idx);
 		if (!NT_STATUS_IS_OK(status)) {
@@ -2496,9 +2595,12 @@ static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
 		}
 	} else if (req->do_signing) {
 		struct smbXsrv_session *x = req->session;
-		DATA_BLOB signing_key = smbd_smb2_signing_key(x, xconn);
+		struct smb2_signing_state *signing_state = NULL;
+		DATA_BLOB signing_key = smbd_smb2_signing_key(x, xconn,
+							      &signing_state);
 
 		status = smb2_signing_sign_pdu(signing_key,
+					       signing_state,
 					       xconn->protocol,
 					       outhdr,
 					       SMBD_SMB2_NUM_IOV_PER_REQ - 1);
@@ -2527,10 +2629,7 @@ static NTSTATUS smbd_smb2_request_reply(struct smbd_smb2_request *req)
 	req->queue_entry.mem_ctx = req;
 	req->queue_entry.vector = req->out.vector;
 	req->queue_entry.count = req->out.vector_count;
-	DLIST_ADD_END(xconn->smb2.send_queue, &req->queue_entry, NULL);
-	xconn->smb2.send_queue_len++;
-
-	status = smbd_smb2_flush_send_queue(xconn);
+	status = smbd_smb2_send_queue_add(xconn, &req->queue_entry);
 	if (!NT_STATUS_IS_OK(status)) {
 		return status;
 	}
@@ -2662,6 +2761,12 @@ NTSTATUS smbd_smb2_request_done_ex(struct smbd_smb2_request *req,
 			memcpy(new_dyn, old_dyn, old_size);
 			memset(new_dyn + old_size, 0, pad_size);
 
+			DO_PROFILE_ADD(smb2_dyn_copied_bytes, old_size);
+			if (SVAL(outhdr, SMB2_HDR_OPCODE) == SMB2_OP_READ) {
+				DO_PROFILE_ADD(smb2_read_copied_bytes,
+					       old_size);
+			}
+
 			outdyn_v->iov_base = (void *)new_dyn;
 			outdyn_v->iov_len = new_size;
 		}
@@ -2847,7 +2952,7 @@ static NTSTATUS smbd_smb2_send_break(struct smbXsrv_connection *xconn,
 		DATA_BLOB encryption_key = session->global->encryption_key;
 
 		status = smb2_signing_encrypt_pdu(encryption_key,
-					xconn->protocol,
+					xconn->smb2.server.cipher,
 					&state->vector[1+SMBD_SMB2_TF_IOV_OFS],
 					SMBD_SMB2_NUM_IOV_PER_REQ);
 		if (!NT_STATUS_IS_OK(status)) {
@@ -2858,10 +2963,7 @@ static NTSTATUS smbd_smb2_send_break(struct smbXsrv_connection *xconn,
 	state->queue_entry.mem_ctx = state;
 	state->queue_entry.vector = state->vector;
 	state->queue_entry.count = ARRAY_SIZE(state->vector);
-	DLIST_ADD_END(xconn->smb2.send_queue, &state->queue_entry, NULL);
-	xconn->smb2.send_queue_len++;
-
-	status = smbd_smb2_flush_send_queue(xconn);
+	status = smbd_smb2_send_queue_add(xconn, &state->queue_entry);
 	if (!NT_STATUS_IS_OK(status)) {
 		return status;
 	}
@@ -3140,12 +3242,39 @@ static int socket_error_from_errno(int ret,
 	return sys_errno;
 }
 
+/*
+ * The maximum number of iovecs we pass to a single writev()
+ */
+#define SMBD_SMB2_SEND_MAX_IOV 128
+
+/*
+ * The incoming requests we process in one call of
+ * smbd_smb2_connection_handler(). We only continue with the next
+ * request if it's already waiting in the socket buffer, so a single
+ * request is never delayed. Queued responses are not held back longer
+ * than SMBD_SMB2_BATCH_MAX_USECS, the send queue is flushed
+ * as soon as the requests dispatched so far used up that time.
+ */
+#define SMBD_SMB2_BATCH_MAX_REQUESTS 16
+#define SMBD_SMB2_BATCH_MAX_USECS 500
+
 static NTSTATUS smbd_smb2_flush_send_queue(struct smbXsrv_connection *xconn)
 {
+	struct iovec iov[SMBD_SMB2_SEND_MAX_IOV];
+	struct iovec *vector;
+	int count;
+	unsigned num_responses;
 	int ret;
 	int err;
 	bool retry;
 
+	if (!NT_STATUS_IS_OK(xconn->transport.status)) {
+		/*
+		 * we're not supposed to do any io
+		 */
+		return NT_STATUS_OK;
+	}
+
 	if (xconn->smb2.send_queue == NULL) {
 		TEVENT_FD_NOT_WRITEABLE(xconn->transport.fde);
 		return NT_STATUS_OK;
@@ -3193,6 +3322,7 @@ static NTSTATUS smbd_smb2_flush_send_queue(struct smbXsrv_connection *xconn)
 			 * the destructor.
 			 */
 			talloc_free(e->mem_ctx);
+			DO_PROFILE_INC(smb2_send_responses);
 
 			if (!NT_STATUS_IS_OK(status)) {
 				return status;
@@ -3200,7 +3330,35 @@ static NTSTATUS smbd_smb2_flush_send_queue(struct smbXsrv_connection *xconn)
 			continue;
 		}
 
-		ret = writev(xconn->transport.sock, e->vector, e->count);
+		/*
+		 * Send all responses up to the next sendfile
+		 * response with a single writev().
+		 */
+		vector = e->vector;
+		count = e->count;
+		num_responses = 1;
+		if (e->count <= ARRAY_SIZE(iov)) {
+			struct smbd_smb2_send_queue *n;
+
+			vector = iov;
+			count = 0;
+			num_responses = 0;
+
+			for (n = e; n != NULL; n = n->next) {
+				if (n->sendfile_header != NULL) {
+					break;
+				}
+				if (count + n->count > ARRAY_SIZE(iov)) {
+					break;
+				}
+				memcpy(&iov[count], n->vector,
+				       n->count * sizeof(struct iovec));
+				count += n->count;
+				num_responses += 1;
+			}
+		}
+
+		ret = writev(xconn->transport.sock, vector, count);
 		if (ret == 0) {
 			/* propagate end of file */
 			return NT_STATUS_INTERNAL_ERROR;
@@ -3214,47 +3372,82 @@ static NTSTATUS smbd_smb2_flush_send_queue(struct smbXsrv_connection *xconn)
 		if (err != 0) {
 			return map_nt_error_from_unix_common(err);
 		}
-		while (ret > 0) {
-			if (ret < e->vector[0].iov_len) {
-				uint8_t *base;
-				base = (uint8_t *)e->vector[0].iov_base;
-				base += ret;
-				e->vector[0].iov_base = (void *)base;
-				e->vector[0].iov_len -= ret;
-				break;
+		DO_PROFILE_INC(smb2_send_writev_calls);
+
+		while (num_responses > 0) {
+			e = xconn->smb2.send_queue;
+
+			while (ret > 0) {
+				if (ret < e->vector[0].iov_len) {
+					uint8_t *base;
+					base = (uint8_t *)e->vector[0].iov_base;
+					base += ret;
+					e->vector[0].iov_base = (void *)base;
+					e->vector[0].iov_len -= ret;
+					ret = 0;
+					break;
+				}
+				ret -= e->vector[0].iov_len;
+				e->vector += 1;
+				e->count -= 1;
+				if (e->count == 0) {
+					break;
+				}
 			}
-			ret -= e->vector[0].iov_len;
-			e->vector += 1;
-			e->count -= 1;
-		}
 
-		/*
-		 * there're maybe some empty vectors at the end
-		 * which we need to skip, otherwise we would get
-		 * ret == 0 from the readv() call and return EPIPE
-		 */
-		while (e->count > 0) {
-			if (e->vector[0].iov_len > 0) {
-				break;
+			/*
+			 * there're maybe some empty vectors at the end
+			 * which we need to skip, otherwise we would get
+			 * ret == 0 from the readv() call and return EPIPE
+			 */
+			while (e->count > 0) {
+				if (e->vector[0].iov_len > 0) {
+					break;
+				}
+				e->vector += 1;
+				e->count -= 1;
 			}
-			e->vector += 1;
-			e->count -= 1;
-		}
 
-		if (e->count > 0) {
-			/* we have more to write */
-			TEVENT_FD_WRITEABLE(xconn->transport.fde);
-			return NT_STATUS_OK;
-		}
+			if (e->count > 0) {
+				/* we have more to write */
+				TEVENT_FD_WRITEABLE(xconn->transport.fde);
+				return NT_STATUS_OK;
+			}
 
-		xconn->smb2.send_queue_len--;
-		DLIST_REMOVE(xconn->smb2.send_queue, e);
-		talloc_free(e->mem_ctx);
+			xconn->smb2.send_queue_len--;
+			DLIST_REMOVE(xconn->smb2.send_queue, e);
+			talloc_free(e->mem_ctx);
+			num_responses -= 1;
+			DO_PROFILE_INC(smb2_send_responses);
+		}
 	}
 
 	return NT_STATUS_OK;
 }
 
+/*
+ * Queue a response. While smbd_smb2_connection_handler()
+ * processes a batch of incoming requests, the send queue
+ * is corked. It's flushed at the end of the batch, or when
+ * the batch used up SMBD_SMB2_BATCH_MAX_USECS.
+ */
+static NTSTATUS smbd_smb2_send_queue_add(struct smbXsrv_connection *xconn,
+					 struct smbd_smb2_send_queue *e)
+{
+	DLIST_ADD_END(xconn->smb2.send_queue, e, NULL);
+	xconn->smb2.send_queue_len++;
+
+	/*
+	 * A sendfile response needs to go out now, before
+	 * the next request of the batch can close the file.
+	 */
+	if (xconn->smb2.send_corked && e->sendfile_header == NULL) {
+		return NT_STATUS_OK;
+	}
+
+	return smbd_smb2_flush_send_queue(xconn);
+}
+
 static NTSTATUS smbd_smb2_io_handler(struct smbXsrv_connection *xconn,
 				     uint16_t fde_flags)
 {
@@ -3262,6 +3455,8 @@ static NTSTATUS smbd_smb2_io_handler(struct smbXsrv_connection *xconn,
 	struct smbd_smb2_request_read_state *state = &xconn->smb2.request_read_state;
 	struct smbd_smb2_request *req = NULL;
 	size_t min_recvfile_size = UINT32_MAX;
+	struct timeval batch_start = timeval_current();
+	unsigned num_batched = 0;
 	int ret;
 	int err;
 	bool retry;
@@ -3460,6 +3655,21 @@ got_full:
 	if (!NT_STATUS_IS_OK(status)) {
 		return status;
 	}
+	num_batched += 1;
+
+	if (xconn->smb2.send_corked &&
+	    timeval_elapsed(&batch_start) * 1000000 >= SMBD_SMB2_BATCH_MAX_USECS)
+	{
+		/*
+		 * Don't let the responses queued so far wait
+		 * for the next request we read.
+		 */
+		status = smbd_smb2_flush_send_queue(xconn);
+		if (!NT_STATUS_IS_OK(status)) {
+			return status;
+		}
+		batch_start = timeval_current();
+	}
 
 	sconn->num_requests++;
 
@@ -3481,6 +3691,22 @@ got_full:
 		return status;
 	}
 
+	/*
+	 * If the client has already sent more requests,
+	 * process them before we flush the send queue.
+	 */
+	if (xconn->smb2.send_corked &&
+	    state->req != NULL &&
+	    num_batched < SMBD_SMB2_BATCH_MAX_REQUESTS)
+	{
+		int pending = 0;
+
+		ret = ioctl(xconn->transport.sock, FIONREAD, &pending);
+		if (ret == 0 && pending >= NBT_HDR_SIZE) {
+			goto again;
+		}
+	}
+
 	return NT_STATUS_OK;
 }
 
@@ -3494,7 +3720,16 @@ static void smbd_smb2_connection_handler(struct tevent_context *ev,
 		struct smbXsrv_connection);
 	NTSTATUS status;
 
+	/*
+	 * Responses to the requests we process now are sent
+	 * together, at the end of the handler.
+	 */
+	xconn->smb2.send_corked = true;
 	status = smbd_smb2_io_handler(xconn, flags);
+	xconn->smb2.send_corked = false;
+	if (NT_STATUS_IS_OK(status) && (flags & TEVENT_FD_READ)) {
+		status = smbd_smb2_flush_send_queue(xconn);
+	}
 	if (!NT_STATUS_IS_OK(status)) {
 		smbd_server_connection_terminate(xconn, nt_errstr(status));
 		return;
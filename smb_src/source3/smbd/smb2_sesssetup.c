@@ -184,6 +184,12 @@ static NTSTATUS smbd_smb2_auth_generic_return(struct smbXsrv_session *session,
 	uint8_t session_key[16];
 	struct smbXsrv_session *x = session;
 	struct smbXsrv_connection *xconn = smb2req->xconn;
+	struct smbXsrv_channel_global0 *c = NULL;
+
+	status = smbXsrv_session_find_channel(session, xconn, &c);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
 
 	if ((in_security_mode & SMB2_NEGOTIATE_SIGNING_REQUIRED) ||
 	    lp_server_signing() == SMB_SIGNING_REQUIRED) {
@@ -300,9 +306,9 @@ static NTSTATUS smbd_smb2_auth_generic_return(struct smbXsrv_session *session,
 	}
 	ZERO_STRUCT(session_key);
 
-	x->global->channels[0].signing_key = data_blob_dup_talloc(x->global->channels,
-						x->global->signing_key);
-	if (x->global->channels[0].signing_key.data == NULL) {
+	c->signing_key = data_blob_dup_talloc(x->global,
+					      x->global->signing_key);
+	if (c->signing_key.data == NULL) {
 		return NT_STATUS_NO_MEMORY;
 	}
 
@@ -339,8 +345,7 @@ static NTSTATUS smbd_smb2_auth_generic_return(struct smbXsrv_session *session,
 	session->status = NT_STATUS_OK;
 	session->global->auth_session_info = session_info;
 	session->global->auth_session_info_seqnum += 1;
-	session->global->channels[0].auth_session_info_seqnum =
-		session->global->auth_session_info_seqnum;
+	c->auth_session_info_seqnum = session->global->auth_session_info_seqnum;
 	session->global->auth_time = timeval_to_nttime(&smb2req->request_time);
 	session->global->expiration_time = gensec_expire_time(session->gensec);
 
@@ -383,6 +388,13 @@ static NTSTATUS smbd_smb2_reauth_generic_return(struct smbXsrv_session *session,
 {
 	NTSTATUS status;
 	struct smbXsrv_session *x = session;
+	struct smbXsrv_connection *xconn = smb2req->xconn;
+	struct smbXsrv_channel_global0 *c = NULL;
+
+	status = smbXsrv_session_find_channel(session, xconn, &c);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
 
 	data_blob_clear_free(&session_info->session_key);
 	session_info->session_key = data_blob_dup_talloc(session_info,
@@ -407,8 +419,7 @@ static NTSTATUS smbd_smb2_reauth_generic_return(struct smbXsrv_session *session,
 	TALLOC_FREE(session->global->auth_session_info);
 	session->global->auth_session_info = session_info;
 	session->global->auth_session_info_seqnum += 1;
-	session->global->channels[0].auth_session_info_seqnum =
-		session->global->auth_session_info_seqnum;
+	c->auth_session_info_seqnum = session->global->auth_session_info_seqnum;
 	session->global->auth_time = timeval_to_nttime(&smb2req->request_time);
 	session->global->expiration_time = gensec_expire_time(session->gensec);
 
@@ -431,6 +442,91 @@ static NTSTATUS smbd_smb2_reauth_generic_return(struct smbXsrv_session *session,
 	return NT_STATUS_OK;
 }
 
+static NTSTATUS smbd_smb2_bind_auth_return(struct smbXsrv_session_auth0 *auth,
+					   struct smbd_smb2_request *smb2req,
+					   struct auth_session_info *session_info,
+					   uint16_t *out_session_flags,
+					   uint64_t *out_session_id)
+{
+	struct smbXsrv_session *session = auth->session;
+	struct smbXsrv_connection *xconn = smb2req->xconn;
+	struct smbXsrv_channel_global0 *c = NULL;
+	struct security_token *cur_token = NULL;
+	struct security_token *new_token = NULL;
+	uint8_t session_key[16];
+	NTSTATUS status;
+	bool equal;
+
+	cur_token = session->global->auth_session_info->security_token;
+	new_token = session_info->security_token;
+
+	if (cur_token->num_sids <= PRIMARY_USER_SID_INDEX ||
+	    new_token->num_sids <= PRIMARY_USER_SID_INDEX) {
+		return NT_STATUS_ACCESS_DENIED;
+	}
+
+	/*
+	 * MS-SMB2: 3.3.5.5.2: the user that authenticated
+	 * the new channel has to be the owner of the session.
+	 */
+	equal = dom_sid_equal(&cur_token->sids[PRIMARY_USER_SID_INDEX],
+			      &new_token->sids[PRIMARY_USER_SID_INDEX]);
+	if (!equal) {
+		DEBUG(1, ("smb2: rejecting session bind for vuid=%llu "
+			  "by a different user\n",
+			  (unsigned long long)session->global->session_wire_id));
+		return NT_STATUS_ACCESS_DENIED;
+	}
+
+	status = smbXsrv_session_add_channel(session, xconn, &c);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+
+	ZERO_STRUCT(session_key);
+	memcpy(session_key, session_info->session_key.data,
+	       MIN(session_info->session_key.length, sizeof(session_key)));
+
+	c->signing_key = data_blob_talloc(session->global,
+					  session_key,
+					  sizeof(session_key));
+	if (c->signing_key.data == NULL) {
+		ZERO_STRUCT(session_key);
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	if (xconn->protocol >= PROTOCOL_SMB2_24) {
+		const DATA_BLOB label = data_blob_string_const_null("SMB2AESCMAC");
+		const DATA_BLOB context = data_blob_string_const_null("SmbSign");
+
+		smb2_key_derivation(session_key, sizeof(session_key),
+				    label.data, label.length,
+				    context.data, context.length,
+				    c->signing_key.data);
+	}
+	ZERO_STRUCT(session_key);
+
+	c->auth_session_info_seqnum = session->global->auth_session_info_seqnum;
+
+	status = smbXsrv_session_update(session);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(0, ("smb2: Failed to update session for vuid=%llu - %s\n",
+			  (unsigned long long)session->global->session_wire_id,
+			  nt_errstr(status)));
+		return NT_STATUS_LOGON_FAILURE;
+	}
+
+	/*
+	 * The response is signed with the
+	 * signing key of the new channel.
+	 */
+	smb2req->do_signing = true;
+
+	*out_session_id = session->global->session_wire_id;
+
+	return NT_STATUS_OK;
+}
+
 struct smbd_smb2_session_setup_state {
 	struct tevent_context *ev;
 	struct smbd_smb2_request *smb2req;
@@ -440,12 +536,15 @@ struct smbd_smb2_session_setup_state {
 	uint64_t in_previous_session_id;
 	DATA_BLOB in_security_buffer;
 	struct smbXsrv_session *session;
+	struct smbXsrv_session_auth0 *auth;
 	struct auth_session_info *session_info;
 	uint16_t out_session_flags;
 	DATA_BLOB out_security_buffer;
 	uint64_t out_session_id;
 	/* The following pointer is owned by state->session. */
 	struct smbd_smb2_session_setup_state **pp_self_ref;
+	/* The following pointer is owned by state->auth. */
+	struct smbd_smb2_session_setup_state **pp_auth_ref;
 };
 
 static int pp_self_ref_destructor(struct smbd_smb2_session_setup_state **pp_state)
@@ -513,6 +612,7 @@ static int smbd_smb2_session_setup_state_destructor(struct smbd_smb2_session_set
 static void smbd_smb2_session_setup_gensec_done(struct tevent_req *subreq);
 static void smbd_smb2_session_setup_previous_done(struct tevent_req *subreq);
 static void smbd_smb2_session_setup_auth_return(struct tevent_req *req);
+static void smbd_smb2_session_setup_bind_gensec_done(struct tevent_req *subreq);
 
 /************************************************************************
  We have to tag the state->session pointer with memory talloc'ed
@@ -532,6 +632,169 @@ static NTSTATUS tag_state_session_ptr(struct smbd_smb2_session_setup_state *stat
 	return NT_STATUS_OK;
 }
 
+static int pp_auth_ref_destructor(struct smbd_smb2_session_setup_state **pp_state)
+{
+	(*pp_state)->auth = NULL;
+	(*pp_state)->pp_auth_ref = NULL;
+	return 0;
+}
+
+/************************************************************************
+ The same for the state->auth pointer of a session bind, the pending
+ authentication is owned by the session it wants to bind to.
+************************************************************************/
+
+static NTSTATUS tag_state_auth_ptr(struct smbd_smb2_session_setup_state *state)
+{
+	state->pp_auth_ref = talloc_zero(state->auth,
+			struct smbd_smb2_session_setup_state *);
+	if (state->pp_auth_ref == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+	*state->pp_auth_ref = state;
+	talloc_set_destructor(state->pp_auth_ref, pp_auth_ref_destructor);
+	return NT_STATUS_OK;
+}
+
+static int smbd_smb2_session_setup_bind_state_destructor(
+	struct smbd_smb2_session_setup_state *state)
+{
+	/*
+	 * If the request goes away in the middle of
+	 * the authentication, we also drop the pending
+	 * authentication.
+	 */
+	TALLOC_FREE(state->auth);
+	return 0;
+}
+
+static NTSTATUS smbd_smb2_session_setup_bind(struct tevent_req *req)
+{
+	struct smbd_smb2_session_setup_state *state =
+		tevent_req_data(req,
+		struct smbd_smb2_session_setup_state);
+	struct smbd_smb2_request *smb2req = state->smb2req;
+	struct smbXsrv_connection *xconn = smb2req->xconn;
+	struct smbXsrv_session *session = smb2req->session;
+	struct smbXsrv_channel_global0 *c = NULL;
+	struct smbXsrv_connection *c0_conn = NULL;
+	struct auth_session_info *session_info = NULL;
+	NTTIME now = timeval_to_nttime(&smb2req->request_time);
+	struct tevent_req *subreq;
+	NTSTATUS status;
+
+	if (xconn->protocol < PROTOCOL_SMB2_22) {
+		return NT_STATUS_REQUEST_NOT_ACCEPTED;
+	}
+
+	if (!(xconn->smb2.server.capabilities & SMB2_CAP_MULTI_CHANNEL)) {
+		return NT_STATUS_REQUEST_NOT_ACCEPTED;
+	}
+
+	if (session == NULL) {
+		return NT_STATUS_USER_SESSION_DELETED;
+	}
+
+	/*
+	 * MS-SMB2: 3.3.5.5.2: the bind request needs
+	 * to be signed with the key of the session.
+	 */
+	if (!smb2req->do_signing) {
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	status = session->status;
+	if (NT_STATUS_EQUAL(status, NT_STATUS_MORE_PROCESSING_REQUIRED)) {
+		return NT_STATUS_REQUEST_NOT_ACCEPTED;
+	}
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+
+	if (session->global->connection_dialect != xconn->smb2.server.dialect) {
+		return NT_STATUS_INVALID_PARAMETER;
+	}
+
+	if (session->global->num_channels == 0) {
+		return NT_STATUS_USER_SESSION_DELETED;
+	}
+
+	c0_conn = session->global->channels[0].connection;
+	if (!GUID_equal(&c0_conn->smb2.client.guid,
+			&xconn->smb2.client.guid)) {
+		return NT_STATUS_USER_SESSION_DELETED;
+	}
+
+	session_info = session->global->auth_session_info;
+	if (session_info == NULL) {
+		return NT_STATUS_USER_SESSION_DELETED;
+	}
+	if (security_session_user_level(session_info, NULL) < SECURITY_USER) {
+		/* guest and anonymous sessions can't be bound */
+		return NT_STATUS_NOT_SUPPORTED;
+	}
+
+	status = smbXsrv_session_find_channel(session, xconn, &c);
+	if (NT_STATUS_IS_OK(status)) {
+		/* the session is already bound to this connection */
+		return NT_STATUS_REQUEST_NOT_ACCEPTED;
+	}
+
+	status = smbXsrv_session_find_auth(session, xconn, now, &state->auth);
+	if (!NT_STATUS_IS_OK(status)) {
+		status = smbXsrv_session_create_auth(session, xconn, now,
+						     state->in_flags,
+						     state->in_security_mode,
+						     &state->auth);
+		if (!NT_STATUS_IS_OK(status)) {
+			return status;
+		}
+	}
+
+	status = tag_state_auth_ptr(state);
+	if (!NT_STATUS_IS_OK(status)) {
+		TALLOC_FREE(state->auth);
+		return status;
+	}
+	talloc_set_destructor(state,
+			      smbd_smb2_session_setup_bind_state_destructor);
+
+	if (state->auth->gensec == NULL) {
+		status = auth_generic_prepare(state->auth,
+					      xconn->remote_address,
+					      &state->auth->gensec);
+		if (!NT_STATUS_IS_OK(status)) {
+			TALLOC_FREE(state->auth);
+			return status;
+		}
+
+		gensec_want_feature(state->auth->gensec, GENSEC_FEATURE_SESSION_KEY);
+		gensec_want_feature(state->auth->gensec, GENSEC_FEATURE_UNIX_TOKEN);
+
+		status = gensec_start_mech_by_oid(state->auth->gensec,
+						  GENSEC_OID_SPNEGO);
+		if (!NT_STATUS_IS_OK(status)) {
+			TALLOC_FREE(state->auth);
+			return status;
+		}
+	}
+
+	become_root();
+	subreq = gensec_update_send(state, state->ev,
+				    state->auth->gensec,
+				    state->in_security_buffer);
+	unbecome_root();
+	if (subreq == NULL) {
+		TALLOC_FREE(state->auth);
+		return NT_STATUS_NO_MEMORY;
+	}
+	tevent_req_set_callback(subreq,
+				smbd_smb2_session_setup_bind_gensec_done,
+				req);
+
+	return NT_STATUS_OK;
+}
+
 static struct tevent_req *smbd_smb2_session_setup_send(TALLOC_CTX *mem_ctx,
 					struct tevent_context *ev,
 					struct smbd_smb2_request *smb2req,
@@ -561,16 +824,15 @@ static struct tevent_req *smbd_smb2_session_setup_send(TALLOC_CTX *mem_ctx,
 	state->in_security_buffer = in_security_buffer;
 
 	if (in_flags & SMB2_SESSION_FLAG_BINDING) {
-		if (smb2req->xconn->protocol < PROTOCOL_SMB2_22) {
-			tevent_req_nterror(req, NT_STATUS_REQUEST_NOT_ACCEPTED);
-			return tevent_req_post(req, ev);
-		}
-
 		/*
-		 * We do not support multi channel.
+		 * Bind the existing session as an additional
+		 * channel to this connection (multi-channel).
 		 */
-		tevent_req_nterror(req, NT_STATUS_NOT_SUPPORTED);
-		return tevent_req_post(req, ev);
+		status = smbd_smb2_session_setup_bind(req);
+		if (tevent_req_nterror(req, status)) {
+			return tevent_req_post(req, ev);
+		}
+		return req;
 	}
 
 	talloc_set_destructor(state, smbd_smb2_session_setup_state_destructor);
@@ -583,11 +845,24 @@ static struct tevent_req *smbd_smb2_session_setup_send(TALLOC_CTX *mem_ctx,
 			return tevent_req_post(req, ev);
 		}
 	} else {
+		struct smbXsrv_channel_global0 *c = NULL;
+
 		if (smb2req->session == NULL) {
 			tevent_req_nterror(req, NT_STATUS_USER_SESSION_DELETED);
 			return tevent_req_post(req, ev);
 		}
 
+		status = smbXsrv_session_find_channel(smb2req->session,
+						      smb2req->xconn, &c);
+		if (!NT_STATUS_IS_OK(status)) {
+			/*
+			 * The session is not bound to this
+			 * connection.
+			 */
+			tevent_req_nterror(req, status);
+			return tevent_req_post(req, ev);
+		}
+
 		state->session = smb2req->session;
 		status = state->session->status;
 		if (NT_STATUS_EQUAL(status, NT_STATUS_NETWORK_SESSION_EXPIRED)) {
@@ -754,6 +1029,67 @@ static void smbd_smb2_session_setup_auth_return(struct tevent_req *req)
 	return;
 }
 
+static void smbd_smb2_session_setup_bind_gensec_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req =
+		tevent_req_callback_data(subreq,
+		struct tevent_req);
+	struct smbd_smb2_session_setup_state *state =
+		tevent_req_data(req,
+		struct smbd_smb2_session_setup_state);
+	NTSTATUS status;
+
+	become_root();
+	status = gensec_update_recv(subreq, state,
+				    &state->out_security_buffer);
+	unbecome_root();
+	TALLOC_FREE(subreq);
+	if (state->auth == NULL) {
+		/* the session went away in the meantime */
+		tevent_req_nterror(req, NT_STATUS_USER_SESSION_DELETED);
+		return;
+	}
+	if (!NT_STATUS_EQUAL(status, NT_STATUS_MORE_PROCESSING_REQUIRED) &&
+	    !NT_STATUS_IS_OK(status)) {
+		TALLOC_FREE(state->auth);
+		tevent_req_nterror(req, status);
+		return;
+	}
+
+	if (NT_STATUS_EQUAL(status, NT_STATUS_MORE_PROCESSING_REQUIRED)) {
+		state->out_session_id =
+			state->auth->session->global->session_wire_id;
+		/* we want to keep the pending authentication */
+		TALLOC_FREE(state->pp_auth_ref);
+		state->auth = NULL;
+		tevent_req_nterror(req, status);
+		return;
+	}
+
+	status = gensec_session_info(state->auth->gensec,
+				     state,
+				     &state->session_info);
+	if (!NT_STATUS_IS_OK(status)) {
+		TALLOC_FREE(state->auth);
+		tevent_req_nterror(req, status);
+		return;
+	}
+
+	status = smbd_smb2_bind_auth_return(state->auth,
+					    state->smb2req,
+					    state->session_info,
+					    &state->out_session_flags,
+					    &state->out_session_id);
+	/* the authentication is finished either way */
+	TALLOC_FREE(state->auth);
+	TALLOC_FREE(state->session_info);
+	if (tevent_req_nterror(req, status)) {
+		return;
+	}
+
+	tevent_req_done(req);
+}
+
 static NTSTATUS smbd_smb2_session_setup_recv(struct tevent_req *req,
 					uint16_t *out_session_flags,
 					TALLOC_CTX *mem_ctx,
@@ -0,0 +1,200 @@
+/*
+   Unix SMB/CIFS implementation.
+   Ordering of SMB2 requests with metadata calls in helper threads
+
+   Copyright (C) The Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * With "aio metadata" or "smb2 worker threads" the SMB2 CREATE,
+ * CLOSE, GETINFO and QUERY_DIRECTORY requests hand their blocking
+ * system calls to helper threads via the async VFS calls, see
+ * SMB_VFS_STAT_SEND() and friends. The request processing itself
+ * stays in the main thread, it is not thread safe (talloc, the VFS
+ * modules, the tdb databases).
+ *
+ * Requests on the same files_struct still have to be processed in
+ * the order they arrived: two QUERY_DIRECTORY requests must not read
+ * the same directory at the same time, and a GETINFO must not see
+ * the results of a later request. smbd_smb2_worker_wait_send() gives
+ * a request its turn on a files_struct.
+ */
+
+#include "includes.h"
+#include "smbd/smbd.h"
+#include "smbd/globals.h"
+#include "../lib/util/tevent_ntstatus.h"
+
+struct smbd_smb2_worker_queue {
+	struct smbd_smb2_worker_queue *prev, *next;
+	struct smbd_server_connection *sconn;
+	struct files_struct *fsp;
+	struct tevent_queue *queue;
+};
+
+struct smbd_smb2_worker_wait_state {
+	struct smbd_smb2_worker_queue *wq;
+	struct tevent_queue_entry *qe;
+};
+
+bool smbd_smb2_worker_enabled(connection_struct *conn)
+{
+	if (lp_smb2_worker_threads() > 0) {
+		return true;
+	}
+	return lp_aio_metadata(SNUM(conn));
+}
+
+/*
+ * A request continues from the event loop once its helper thread
+ * is done, make sure it runs as its user again.
+ */
+NTSTATUS smbd_smb2_worker_become_user(struct smbd_smb2_request *smb2req)
+{
+	bool ok;
+
+	ok = change_to_user(smb2req->tcon->compat,
+			    smb2req->session->compat->vuid);
+	if (!ok) {
+		return NT_STATUS_ACCESS_DENIED;
+	}
+
+	ok = set_current_service(smb2req->tcon->compat, 0, true);
+	if (!ok) {
+		return NT_STATUS_ACCESS_DENIED;
+	}
+
+	return NT_STATUS_OK;
+}
+
+static struct smbd_smb2_worker_queue *smbd_smb2_worker_queue_get(
+	struct smbd_server_connection *sconn,
+	struct files_struct *fsp)
+{
+	struct smbd_smb2_worker_queue *wq;
+
+	for (wq = sconn->worker_queues; wq != NULL; wq = wq->next) {
+		if (wq->fsp == fsp) {
+			return wq;
+		}
+	}
+
+	wq = talloc_zero(sconn, struct smbd_smb2_worker_queue);
+	if (wq == NULL) {
+		return NULL;
+	}
+	wq->sconn = sconn;
+	wq->fsp = fsp;
+	wq->queue = tevent_queue_create(wq, "smbd_smb2_worker_queue");
+	if (wq->queue == NULL) {
+		TALLOC_FREE(wq);
+		return NULL;
+	}
+	DLIST_ADD(sconn->worker_queues, wq);
+
+	return wq;
+}
+
+static void smbd_smb2_worker_wait_trigger(struct tevent_req *req,
+					  void *private_data);
+static void smbd_smb2_worker_wait_cleanup(struct tevent_req *req,
+					  enum tevent_req_state req_state);
+
+/*
+ * Wait until the requests before us on fsp are done. The request
+ * keeps its turn until it is freed, the caller must keep it around
+ * until it is done with fsp. Until then a close of fsp waits for it
+ * via aio_add_req_to_fsp().
+ */
+struct tevent_req *smbd_smb2_worker_wait_send(TALLOC_CTX *mem_ctx,
+					      struct tevent_context *ev,
+					      files_struct *fsp)
+{
+	struct tevent_req *req;
+	struct smbd_smb2_worker_wait_state *state;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct smbd_smb2_worker_wait_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	tevent_req_set_cleanup_fn(req, smbd_smb2_worker_wait_cleanup);
+
+	if (!aio_add_req_to_fsp(fsp, req)) {
+		tevent_req_oom(req);
+		return tevent_req_post(req, ev);
+	}
+
+	state->wq = smbd_smb2_worker_queue_get(fsp->conn->sconn, fsp);
+	if (tevent_req_nomem(state->wq, req)) {
+		return tevent_req_post(req, ev);
+	}
+
+	state->qe = tevent_queue_add_entry(state->wq->queue, ev, req,
+					   smbd_smb2_worker_wait_trigger,
+					   NULL);
+	if (tevent_req_nomem(state->qe, req)) {
+		return tevent_req_post(req, ev);
+	}
+
+	return req;
+}
+
+static void smbd_smb2_worker_wait_trigger(struct tevent_req *req,
+					  void *private_data)
+{
+	tevent_req_done(req);
+}
+
+static void smbd_smb2_worker_wait_cleanup(struct tevent_req *req,
+					  enum tevent_req_state req_state)
+{
+	struct smbd_smb2_worker_wait_state *state = tevent_req_data(
+		req, struct smbd_smb2_worker_wait_state);
+	struct smbd_smb2_worker_queue *wq = state->wq;
+
+	if (req_state != TEVENT_REQ_RECEIVED) {
+		/*
+		 * Keep our turn until we're freed
+		 */
+		return;
+	}
+
+	/*
+	 * Let the next request for this fsp start
+	 */
+	TALLOC_FREE(state->qe);
+	state->wq = NULL;
+
+	if (wq == NULL) {
+		return;
+	}
+	if (tevent_queue_length(wq->queue) != 0) {
+		return;
+	}
+	DLIST_REMOVE(wq->sconn->worker_queues, wq);
+	TALLOC_FREE(wq);
+}
+
+NTSTATUS smbd_smb2_worker_wait_recv(struct tevent_req *req)
+{
+	NTSTATUS status;
+
+	if (tevent_req_is_nterror(req, &status)) {
+		return status;
+	}
+	return NT_STATUS_OK;
+}
@@ -0,0 +1,716 @@
+/*
+   Unix SMB/CIFS implementation.
+
+   Copyright (C) Stefan Metzmacher 2014
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "includes.h"
+#include "system/filesys.h"
+#include <tevent.h>
+#include "smbd/smbd.h"
+#include "smbd/globals.h"
+#include "dbwrap/dbwrap.h"
+#include "dbwrap/dbwrap_rbt.h"
+#include "dbwrap/dbwrap_open.h"
+#include "dbwrap/dbwrap_watch.h"
+#include "session.h"
+#include "auth.h"
+#include "auth/gensec/gensec.h"
+#include "../lib/tsocket/tsocket.h"
+#include "../libcli/security/security.h"
+#include "messages.h"
+#include "lib/util/util_tdb.h"
+#include "librpc/gen_ndr/ndr_smbXsrv.h"
+#include "serverid.h"
+
+static struct db_context *smbXsrv_client_global_db_ctx = NULL;
+
+NTSTATUS smbXsrv_client_global_init(void)
+{
+	const char *global_path = NULL;
+	struct db_context *db_ctx = NULL;
+
+	if (smbXsrv_client_global_db_ctx != NULL) {
+		return NT_STATUS_OK;
+	}
+
+	/*
+	 * This contains secret information like client keys!
+	 */
+	global_path = lock_path("smbXsrv_client_global.tdb");
+
+	db_ctx = db_open(NULL, global_path,
+			 0, /* hash_size */
+			 TDB_DEFAULT |
+			 TDB_CLEAR_IF_FIRST |
+			 TDB_INCOMPATIBLE_HASH,
+			 O_RDWR | O_CREAT, 0600,
+			 DBWRAP_LOCK_ORDER_1,
+			 DBWRAP_FLAG_NONE);
+	if (db_ctx == NULL) {
+		NTSTATUS status;
+
+		status = map_nt_error_from_unix_common(errno);
+
+		return status;
+	}
+
+	smbXsrv_client_global_db_ctx = db_ctx;
+
+	return NT_STATUS_OK;
+}
+
+/*
+ * The records are indexed by the ndr encoded client guid.
+ */
+
+#define SMBXSRV_CLIENT_GLOBAL_TDB_KEY_SIZE 16
+
+static TDB_DATA smbXsrv_client_global_id_to_key(const struct GUID *client_guid,
+						uint8_t *key_buf)
+{
+	TDB_DATA key = { .dsize = 0, };
+	NTSTATUS status;
+	DATA_BLOB b;
+
+	status = GUID_to_ndr_blob(client_guid, talloc_tos(), &b);
+	if (!NT_STATUS_IS_OK(status)) {
+		return key;
+	}
+	if (b.length != SMBXSRV_CLIENT_GLOBAL_TDB_KEY_SIZE) {
+		data_blob_free(&b);
+		return key;
+	}
+
+	memcpy(key_buf, b.data, SMBXSRV_CLIENT_GLOBAL_TDB_KEY_SIZE);
+	data_blob_free(&b);
+
+	key = make_tdb_data(key_buf, SMBXSRV_CLIENT_GLOBAL_TDB_KEY_SIZE);
+
+	return key;
+}
+
+static struct db_record *smbXsrv_client_global_fetch_locked(
+			struct db_context *db,
+			const struct GUID *client_guid,
+			TALLOC_CTX *mem_ctx)
+{
+	TDB_DATA key;
+	uint8_t key_buf[SMBXSRV_CLIENT_GLOBAL_TDB_KEY_SIZE];
+	struct db_record *rec = NULL;
+
+	key = smbXsrv_client_global_id_to_key(client_guid, key_buf);
+	if (key.dsize == 0) {
+		return NULL;
+	}
+
+	rec = dbwrap_fetch_locked(db, mem_ctx, key);
+
+	if (rec == NULL) {
+		DEBUG(0, ("fetch_locked(%s) failed\n",
+			  GUID_string(talloc_tos(), client_guid)));
+	}
+
+	return rec;
+}
+
+static bool smbXsrv_client_connection_pass_filter(struct messaging_rec *rec,
+						  void *private_data)
+{
+	if (rec->msg_type != MSG_SMBXSRV_CONNECTION_PASS) {
+		return false;
+	}
+
+	if (rec->num_fds != 1) {
+		return false;
+	}
+
+	return true;
+}
+
+static void smbXsrv_client_connection_pass_loop(struct tevent_req *subreq);
+
+NTSTATUS smbXsrv_client_create(TALLOC_CTX *mem_ctx,
+			       struct tevent_context *ev_ctx,
+			       struct messaging_context *msg_ctx,
+			       NTTIME now,
+			       struct smbXsrv_client **_client)
+{
+	struct smbXsrv_client *client;
+	struct smbXsrv_client_global0 *global = NULL;
+
+	client = talloc_zero(mem_ctx, struct smbXsrv_client);
+	if (client == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	client->ev_ctx = ev_ctx;
+	client->msg_ctx = msg_ctx;
+
+	client->server_multi_channel_enabled = lp_server_multi_channel_support();
+	if (client->server_multi_channel_enabled && lp_clustering()) {
+		/*
+		 * The connection passing relies on a node local
+		 * database and the passing of file descriptors,
+		 * so we can't use it in a cluster yet.
+		 */
+		DEBUG(3, ("smbXsrv_client_create: disabling "
+			  "multi-channel support in clustered mode\n"));
+		client->server_multi_channel_enabled = false;
+	}
+
+	global = talloc_zero(client, struct smbXsrv_client_global0);
+	if (global == NULL) {
+		TALLOC_FREE(client);
+		return NT_STATUS_NO_MEMORY;
+	}
+	client->global = global;
+
+	global->initial_connect_time = now;
+
+	global->server_id = messaging_server_id(client->msg_ctx);
+
+	if (DEBUGLVL(10)) {
+		struct smbXsrv_clientB client_blob;
+
+		ZERO_STRUCT(client_blob);
+		client_blob.version = SMBXSRV_VERSION_0;
+		client_blob.info.info0 = client;
+
+		DEBUG(10,("smbXsrv_client_create: client_guid[%s] created\n",
+			  GUID_string(talloc_tos(), &global->client_guid)));
+		NDR_PRINT_DEBUG(smbXsrv_clientB, &client_blob);
+	}
+
+	*_client = client;
+	return NT_STATUS_OK;
+}
+
+static NTSTATUS smbXsrv_client_global_verify_record(struct db_record *db_rec,
+					bool *is_free,
+					TALLOC_CTX *mem_ctx,
+					struct smbXsrv_client_global0 **_g)
+{
+	TDB_DATA key;
+	TDB_DATA val;
+	DATA_BLOB blob;
+	struct smbXsrv_client_globalB global_blob;
+	enum ndr_err_code ndr_err;
+	struct smbXsrv_client_global0 *global = NULL;
+	bool exists;
+	TALLOC_CTX *frame = talloc_stackframe();
+
+	*is_free = false;
+
+	if (_g) {
+		*_g = NULL;
+	}
+
+	key = dbwrap_record_get_key(db_rec);
+
+	val = dbwrap_record_get_value(db_rec);
+	if (val.dsize == 0) {
+		TALLOC_FREE(frame);
+		*is_free = true;
+		return NT_STATUS_OK;
+	}
+
+	blob = data_blob_const(val.dptr, val.dsize);
+
+	ndr_err = ndr_pull_struct_blob(&blob, frame, &global_blob,
+			(ndr_pull_flags_fn_t)ndr_pull_smbXsrv_client_globalB);
+	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+		NTSTATUS status = ndr_map_error2ntstatus(ndr_err);
+		DEBUG(1,("smbXsrv_client_global_verify_record: "
+			 "key '%s' ndr_pull_struct_blob - %s\n",
+			 hex_encode_talloc(frame, key.dptr, key.dsize),
+			 nt_errstr(status)));
+		TALLOC_FREE(frame);
+		return status;
+	}
+
+	DEBUG(10,("smbXsrv_client_global_verify_record\n"));
+	if (DEBUGLVL(10)) {
+		NDR_PRINT_DEBUG(smbXsrv_client_globalB, &global_blob);
+	}
+
+	if (global_blob.version != SMBXSRV_VERSION_0) {
+		DEBUG(0,("smbXsrv_client_global_verify_record: "
+			 "key '%s' use unsupported version %u\n",
+			 hex_encode_talloc(frame, key.dptr, key.dsize),
+			 global_blob.version));
+		NDR_PRINT_DEBUG(smbXsrv_client_globalB, &global_blob);
+		TALLOC_FREE(frame);
+		return NT_STATUS_INTERNAL_DB_CORRUPTION;
+	}
+
+	global = global_blob.info.info0;
+
+	exists = serverid_exists(&global->server_id);
+	if (!exists) {
+		DEBUG(2,("smbXsrv_client_global_verify_record: "
+			 "key '%s' server_id %s does not exist.\n",
+			 hex_encode_talloc(frame, key.dptr, key.dsize),
+			 server_id_str(frame, &global->server_id)));
+		if (DEBUGLVL(2)) {
+			NDR_PRINT_DEBUG(smbXsrv_client_globalB, &global_blob);
+		}
+		TALLOC_FREE(frame);
+		dbwrap_record_delete(db_rec);
+		*is_free = true;
+		return NT_STATUS_OK;
+	}
+
+	if (_g) {
+		*_g = talloc_move(mem_ctx, &global);
+	}
+	TALLOC_FREE(frame);
+	return NT_STATUS_OK;
+}
+
+NTSTATUS smb2srv_client_lookup_global(struct smbXsrv_client *client,
+				      struct GUID client_guid,
+				      TALLOC_CTX *mem_ctx,
+				      struct smbXsrv_client_global0 **_global)
+{
+	struct db_record *db_rec = NULL;
+	struct smbXsrv_client_global0 *global = NULL;
+	bool is_free = false;
+	NTSTATUS status;
+
+	*_global = NULL;
+
+	status = smbXsrv_client_global_init();
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+
+	db_rec = smbXsrv_client_global_fetch_locked(
+			smbXsrv_client_global_db_ctx,
+			&client_guid,
+			talloc_tos());
+	if (db_rec == NULL) {
+		return NT_STATUS_INTERNAL_DB_ERROR;
+	}
+
+	status = smbXsrv_client_global_verify_record(db_rec,
+						     &is_free,
+						     mem_ctx,
+						     &global);
+	TALLOC_FREE(db_rec);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+
+	if (is_free) {
+		return NT_STATUS_OBJECTID_NOT_FOUND;
+	}
+
+	*_global = global;
+	return NT_STATUS_OK;
+}
+
+NTSTATUS smb2srv_client_connection_pass(struct smbd_smb2_request *smb2req,
+					struct smbXsrv_client_global0 *global)
+{
+	struct smbXsrv_connection *xconn = smb2req->xconn;
+	DATA_BLOB blob;
+	enum ndr_err_code ndr_err;
+	NTSTATUS status;
+	struct smbXsrv_connection_pass0 pass_info0;
+	struct smbXsrv_connection_passB pass_blob;
+	ssize_t reqlen;
+	struct iovec iov;
+
+	pass_info0.initial_connect_time = global->initial_connect_time;
+	pass_info0.client_guid = global->client_guid;
+	pass_info0.src_server_id = xconn->client->global->server_id;
+	pass_info0.dst_server_id = global->server_id;
+
+	reqlen = iov_buflen(SMBD_SMB2_IN_HDR_IOV(smb2req),
+			    SMBD_SMB2_NUM_IOV_PER_REQ - 1);
+	if (reqlen == -1) {
+		return NT_STATUS_INVALID_BUFFER_SIZE;
+	}
+
+	pass_info0.negotiate_request.data =
+		iov_buf(talloc_tos(), SMBD_SMB2_IN_HDR_IOV(smb2req),
+			SMBD_SMB2_NUM_IOV_PER_REQ - 1);
+	if (pass_info0.negotiate_request.data == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+	pass_info0.negotiate_request.length = reqlen;
+
+	ZERO_STRUCT(pass_blob);
+	pass_blob.version = smbXsrv_version_global_current();
+	pass_blob.info.info0 = &pass_info0;
+
+	if (DEBUGLVL(10)) {
+		NDR_PRINT_DEBUG(smbXsrv_connection_passB, &pass_blob);
+	}
+
+	ndr_err = ndr_push_struct_blob(&blob, talloc_tos(), &pass_blob,
+			(ndr_push_flags_fn_t)ndr_push_smbXsrv_connection_passB);
+	data_blob_free(&pass_info0.negotiate_request);
+	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+		status = ndr_map_error2ntstatus(ndr_err);
+		return status;
+	}
+
+	iov.iov_base = blob.data;
+	iov.iov_len = blob.length;
+
+	status = messaging_send_iov(xconn->msg_ctx,
+				    global->server_id,
+				    MSG_SMBXSRV_CONNECTION_PASS,
+				    &iov, 1,
+				    &xconn->transport.sock, 1);
+	data_blob_free(&blob);
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+
+	return NT_STATUS_OK;
+}
+
+static NTSTATUS smbXsrv_client_global_store(struct smbXsrv_client_global0 *global)
+{
+	struct smbXsrv_client_globalB global_blob;
+	DATA_BLOB blob = data_blob_null;
+	TDB_DATA key;
+	TDB_DATA val;
+	NTSTATUS status;
+	enum ndr_err_code ndr_err;
+
+	/*
+	 * TODO: if we use other versions than '0'
+	 * we would add glue code here, that would be able to
+	 * store the information in the old format.
+	 */
+
+	if (global->db_rec == NULL) {
+		return NT_STATUS_INTERNAL_ERROR;
+	}
+
+	key = dbwrap_record_get_key(global->db_rec);
+	val = dbwrap_record_get_value(global->db_rec);
+
+	ZERO_STRUCT(global_blob);
+	global_blob.version = smbXsrv_version_global_current();
+	if (val.dsize >= 8) {
+		global_blob.seqnum = IVAL(val.dptr, 4);
+	}
+	global_blob.seqnum += 1;
+	global_blob.info.info0 = global;
+
+	ndr_err = ndr_push_struct_blob(&blob, global->db_rec, &global_blob,
+			(ndr_push_flags_fn_t)ndr_push_smbXsrv_client_globalB);
+	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+		status = ndr_map_error2ntstatus(ndr_err);
+		DEBUG(1,("smbXsrv_client_global_store: key '%s' ndr_push - %s\n",
+			 hex_encode_talloc(global->db_rec, key.dptr, key.dsize),
+			 nt_errstr(status)));
+		TALLOC_FREE(global->db_rec);
+		return status;
+	}
+
+	val = make_tdb_data(blob.data, blob.length);
+	status = dbwrap_record_store(global->db_rec, val, TDB_REPLACE);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(1,("smbXsrv_client_global_store: key '%s' store - %s\n",
+			 hex_encode_talloc(global->db_rec, key.dptr, key.dsize),
+			 nt_errstr(status)));
+		TALLOC_FREE(global->db_rec);
+		return status;
+	}
+
+	global->stored = true;
+
+	if (DEBUGLVL(10)) {
+		DEBUG(10,("smbXsrv_client_global_store: key '%s' stored\n",
+			 hex_encode_talloc(global->db_rec, key.dptr, key.dsize)));
+		NDR_PRINT_DEBUG(smbXsrv_client_globalB, &global_blob);
+	}
+
+	TALLOC_FREE(global->db_rec);
+
+	return NT_STATUS_OK;
+}
+
+NTSTATUS smbXsrv_client_update(struct smbXsrv_client *client)
+{
+	struct smbXsrv_client_global0 *global = client->global;
+	struct smbXsrv_connection *xconn = client->connections;
+	NTSTATUS status;
+
+	if (global->db_rec != NULL) {
+		DEBUG(0, ("smbXsrv_client_update(%s): "
+			  "Called with db_rec != NULL'\n",
+			  GUID_string(talloc_tos(), &global->client_guid)));
+		return NT_STATUS_INTERNAL_ERROR;
+	}
+
+	status = smbXsrv_client_global_init();
+	if (!NT_STATUS_IS_OK(status)) {
+		return status;
+	}
+
+	if (global->local_address == NULL && xconn != NULL) {
+		global->local_address =
+			tsocket_address_string(xconn->local_address, global);
+		if (global->local_address == NULL) {
+			return NT_STATUS_NO_MEMORY;
+		}
+		global->remote_address =
+			tsocket_address_string(xconn->remote_address, global);
+		if (global->remote_address == NULL) {
+			return NT_STATUS_NO_MEMORY;
+		}
+		global->remote_name = talloc_strdup(global,
+						    xconn->remote_hostname);
+		if (global->remote_name == NULL) {
+			return NT_STATUS_NO_MEMORY;
+		}
+	}
+
+	global->db_rec = smbXsrv_client_global_fetch_locked(
+					smbXsrv_client_global_db_ctx,
+					&global->client_guid,
+					global /* TALLOC_CTX */);
+	if (global->db_rec == NULL) {
+		return NT_STATUS_INTERNAL_DB_ERROR;
+	}
+
+	status = smbXsrv_client_global_store(global);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(0,("smbXsrv_client_update: client_guid[%s] "
+			 "store failed - %s\n",
+			 GUID_string(talloc_tos(), &global->client_guid),
+			 nt_errstr(status)));
+		return status;
+	}
+
+	if (client->connection_pass_subreq == NULL) {
+		struct tevent_req *subreq = NULL;
+
+		subreq = messaging_filtered_read_send(client,
+					client->ev_ctx,
+					client->msg_ctx,
+					smbXsrv_client_connection_pass_filter,
+					client);
+		if (subreq == NULL) {
+			return NT_STATUS_NO_MEMORY;
+		}
+		tevent_req_set_callback(subreq,
+					smbXsrv_client_connection_pass_loop,
+					client);
+		client->connection_pass_subreq = subreq;
+	}
+
+	if (DEBUGLVL(10)) {
+		struct smbXsrv_clientB client_blob;
+
+		ZERO_STRUCT(client_blob);
+		client_blob.version = SMBXSRV_VERSION_0;
+		client_blob.info.info0 = client;
+
+		DEBUG(10,("smbXsrv_client_update: client_guid[%s] stored\n",
+			  GUID_string(talloc_tos(), &global->client_guid)));
+		NDR_PRINT_DEBUG(smbXsrv_clientB, &client_blob);
+	}
+
+	return NT_STATUS_OK;
+}
+
+static void smbXsrv_client_connection_pass_loop(struct tevent_req *subreq)
+{
+	struct smbXsrv_client *client =
+		tevent_req_callback_data(subreq,
+		struct smbXsrv_client);
+	struct smbXsrv_connection *xconn = NULL;
+	int ret;
+	struct messaging_rec *rec = NULL;
+	struct smbXsrv_connection_passB pass_blob;
+	enum ndr_err_code ndr_err;
+	struct smbXsrv_connection_pass0 *pass_info0 = NULL;
+	NTSTATUS status;
+	int sock_fd = -1;
+	uint8_t i;
+
+	client->connection_pass_subreq = NULL;
+
+	ret = messaging_filtered_read_recv(subreq, talloc_tos(), &rec);
+	TALLOC_FREE(subreq);
+	if (ret != 0) {
+		goto next;
+	}
+
+	if (rec->num_fds != 1) {
+		DEBUG(0,("smbXsrv_client_connection_pass_loop: "
+			 "MSG_SMBXSRV_CONNECTION_PASS with num_fds[%u] - "
+			 "ignoring\n", (unsigned)rec->num_fds));
+		goto next;
+	}
+
+	ndr_err = ndr_pull_struct_blob(&rec->buf, rec, &pass_blob,
+			(ndr_pull_flags_fn_t)ndr_pull_smbXsrv_connection_passB);
+	if (!NDR_ERR_CODE_IS_SUCCESS(ndr_err)) {
+		status = ndr_map_error2ntstatus(ndr_err);
+		DEBUG(1,("smbXsrv_client_connection_pass_loop: "
+			 "ndr_pull_struct_blob - %s\n",
+			 nt_errstr(status)));
+		goto next;
+	}
+
+	DEBUG(10,("smbXsrv_client_connection_pass_loop: "
+		  "MSG_SMBXSRV_CONNECTION_PASS\n"));
+	if (DEBUGLVL(10)) {
+		NDR_PRINT_DEBUG(smbXsrv_connection_passB, &pass_blob);
+	}
+
+	if (pass_blob.version != SMBXSRV_VERSION_0) {
+		DEBUG(0,("smbXsrv_client_connection_pass_loop: "
+			 "ignore invalid version %u\n", pass_blob.version));
+		NDR_PRINT_DEBUG(smbXsrv_connection_passB, &pass_blob);
+		goto next;
+	}
+
+	pass_info0 = pass_blob.info.info0;
+	if (pass_info0 == NULL) {
+		DEBUG(0,("smbXsrv_client_connection_pass_loop: "
+			 "ignore NULL info %u\n", pass_blob.version));
+		NDR_PRINT_DEBUG(smbXsrv_connection_passB, &pass_blob);
+		goto next;
+	}
+
+	if (!GUID_equal(&client->global->client_guid, &pass_info0->client_guid))
+	{
+		DEBUG(0,("smbXsrv_client_connection_pass_loop: "
+			 "client_guid mismatch\n"));
+		NDR_PRINT_DEBUG(smbXsrv_connection_passB, &pass_blob);
+		goto next;
+	}
+
+	if (client->global->initial_connect_time !=
+	    pass_info0->initial_connect_time)
+	{
+		DEBUG(0,("smbXsrv_client_connection_pass_loop: "
+			 "initial_connect_time mismatch\n"));
+		NDR_PRINT_DEBUG(smbXsrv_connection_passB, &pass_blob);
+		goto next;
+	}
+
+	sock_fd = rec->fds[0];
+	rec->fds[0] = -1;
+
+	DEBUG(10,("smbXsrv_client_connection_pass_loop: "
+		  "got connection sockfd[%d]\n", sock_fd));
+
+	status = smbd_add_connection(client, sock_fd, &xconn);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(1,("smbXsrv_client_connection_pass_loop: "
+			 "smbd_add_connection - %s\n",
+			 nt_errstr(status)));
+		if (xconn == NULL) {
+			close(sock_fd);
+			goto next;
+		}
+		/*
+		 * The connection is already linked into
+		 * client->connections, so we just drop it.
+		 */
+		smbd_server_connection_terminate(xconn, nt_errstr(status));
+		goto next;
+	}
+
+	/*
+	 * The client guid was already verified
+	 * by the sending process.
+	 */
+	xconn->smb2.client.guid_verified = true;
+
+	/*
+	 * Set up the new connection as if the passed negprot
+	 * request was the first packet it got.
+	 */
+	smbd_smb2_first_negprot(xconn,
+				pass_info0->negotiate_request.data,
+				pass_info0->negotiate_request.length);
+
+next:
+	if (rec != NULL) {
+		for (i=0; i < rec->num_fds; i++) {
+			if (rec->fds[i] != -1) {
+				close(rec->fds[i]);
+				rec->fds[i] = -1;
+			}
+		}
+	}
+	TALLOC_FREE(rec);
+
+	subreq = messaging_filtered_read_send(client,
+					client->ev_ctx,
+					client->msg_ctx,
+					smbXsrv_client_connection_pass_filter,
+					client);
+	if (subreq == NULL) {
+		const char *r;
+		r = "messaging_filtered_read_send(MSG_SMBXSRV_CONNECTION_PASS) failed";
+		exit_server_cleanly(r);
+		return;
+	}
+	tevent_req_set_callback(subreq,
+				smbXsrv_client_connection_pass_loop,
+				client);
+	client->connection_pass_subreq = subreq;
+}
+
+NTSTATUS smbXsrv_client_remove(struct smbXsrv_client *client)
+{
+	struct smbXsrv_client_global0 *global = client->global;
+	NTSTATUS status;
+
+	if (!global->stored) {
+		return NT_STATUS_OK;
+	}
+
+	TALLOC_FREE(client->connection_pass_subreq);
+
+	global->db_rec = smbXsrv_client_global_fetch_locked(
+					smbXsrv_client_global_db_ctx,
+					&global->client_guid,
+					global /* TALLOC_CTX */);
+	if (global->db_rec == NULL) {
+		return NT_STATUS_INTERNAL_DB_ERROR;
+	}
+
+	status = dbwrap_record_delete(global->db_rec);
+	TALLOC_FREE(global->db_rec);
+	if (!NT_STATUS_IS_OK(status)) {
+		DEBUG(0,("smbXsrv_client_remove: client_guid[%s] "
+			 "delete failed - %s\n",
+			 GUID_string(talloc_tos(), &global->client_guid),
+			 nt_errstr(status)));
+		return status;
+	}
+
+	global->stored = false;
+
+	DEBUG(10,("smbXsrv_client_remove: client_guid[%s] removed\n",
+		  GUID_string(talloc_tos(), &global->client_guid)));
+
+	return NT_STATUS_OK;
+}
@@ -42,6 +42,8 @@ struct smbXsrv_open_table {
 	} local;
 	struct {
 		struct db_context *db_ctx;
+		/* id smbXsrv_open_create_prefetch_key() migrated for us */
+		uint32_t prefetched_id;
 	} global;
 };
 
@@ -464,7 +466,21 @@ static void smbXsrv_open_global_verify_record(struct db_record *db_rec,
 					TALLOC_CTX *mem_ctx,
 					struct smbXsrv_open_global0 **_g);
 
+static uint32_t smbXsrv_open_global_random_id(void)
+{
+	uint32_t id = generate_random();
+
+	if (id == 0) {
+		id++;
+	}
+	if (id == UINT32_MAX) {
+		id--;
+	}
+	return id;
+}
+
 static NTSTATUS smbXsrv_open_global_allocate(struct db_context *db,
+					uint32_t first_id,
 					TALLOC_CTX *mem_ctx,
 					struct smbXsrv_open_global0 **_global)
 {
@@ -496,14 +512,10 @@ static NTSTATUS smbXsrv_open_global_allocate(struct db_context *db,
 
 		if (i >= min_tries && last_free != 0) {
 			id = last_free;
+		} else if (i == 0 && first_id != 0) {
+			id = first_id;
 		} else {
-			id = generate_random();
-		}
-		if (id == 0) {
-			id++;
-		}
-		if (id == UINT32_MAX) {
-			id--;
+			id = smbXsrv_open_global_random_id();
 		}
 
 		key = smbXsrv_open_global_id_to_key(id, key_buf);
@@ -815,7 +827,9 @@ NTSTATUS smbXsrv_open_create(struct smbXsrv_connection *conn,
 	op->idle_time = now;
 
 	status = smbXsrv_open_global_allocate(table->global.db_ctx,
+					      table->global.prefetched_id,
 					      op, &global);
+	table->global.prefetched_id = 0;
 	if (!NT_STATUS_IS_OK(status)) {
 		TALLOC_FREE(op);
 		return status;
@@ -951,6 +965,62 @@ NTSTATUS smbXsrv_open_update(struct smbXsrv_open *op)
 	return NT_STATUS_OK;
 }
 
+/*
+ * Pick the global id the next smbXsrv_open_create on conn tries first
+ * and return database and key of its record, for dbwrap_prefetch_locked.
+ */
+bool smbXsrv_open_create_prefetch_key(TALLOC_CTX *mem_ctx,
+				      struct smbXsrv_connection *conn,
+				      struct db_context **db, TDB_DATA *key)
+{
+	struct smbXsrv_open_table *table = conn->client->open_table;
+	uint8_t *key_buf;
+
+	if (table == NULL) {
+		return false;
+	}
+
+	key_buf = talloc_array(mem_ctx, uint8_t,
+			       SMBXSRV_OPEN_GLOBAL_TDB_KEY_SIZE);
+	if (key_buf == NULL) {
+		return false;
+	}
+
+	table->global.prefetched_id = smbXsrv_open_global_random_id();
+
+	*db = table->global.db_ctx;
+	*key = smbXsrv_open_global_id_to_key(table->global.prefetched_id,
+					     key_buf);
+	return true;
+}
+
+/*
+ * Database and key of the global record smbXsrv_open_close will have to
+ * lock for op, for dbwrap_prefetch_locked. Returns false if the record
+ * is locked already.
+ */
+bool smbXsrv_open_close_prefetch_key(TALLOC_CTX *mem_ctx,
+				     struct smbXsrv_open *op,
+				     struct db_context **db, TDB_DATA *key)
+{
+	uint8_t *key_buf;
+
+	if ((op->table == NULL) || (op->global->db_rec != NULL)) {
+		return false;
+	}
+
+	key_buf = talloc_array(mem_ctx, uint8_t,
+			       SMBXSRV_OPEN_GLOBAL_TDB_KEY_SIZE);
+	if (key_buf == NULL) {
+		return false;
+	}
+
+	*db = op->table->global.db_ctx;
+	*key = smbXsrv_open_global_id_to_key(op->global->open_global_id,
+					     key_buf);
+	return true;
+}
+
 NTSTATUS smbXsrv_open_close(struct smbXsrv_open *op, NTTIME now)
 {
 	struct smbXsrv_open_table *table;
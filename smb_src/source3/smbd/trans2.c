@@ -1449,6 +1449,7 @@ static bool check_msdfs_link(connection_struct *conn,
 
 struct smbd_dirptr_lanman2_state {
 	connection_struct *conn;
+	struct dptr_struct *dirptr;
 	uint32_t info_level;
 	bool check_mangled_names;
 	bool has_wild;
@@ -1560,6 +1561,7 @@ static bool smbd_dirptr_lanman2_mode_fn(TALLOC_CTX *ctx,
 		(struct smbd_dirptr_lanman2_state *)private_data;
 	bool ms_dfs_link = false;
 	uint32_t mode = 0;
+	DATA_BLOB dosattrib;
 
 	if (INFO_LEVEL_IS_UNIX(state->info_level)) {
 		if (SMB_VFS_LSTAT(state->conn, smb_fname) != 0) {
@@ -1586,8 +1588,18 @@ static bool smbd_dirptr_lanman2_mode_fn(TALLOC_CTX *ctx,
 		}
 	}
 
+	if (!INFO_LEVEL_IS_UNIX(state->info_level) && !ms_dfs_link) {
+		/* Before dos_mode() changes the create time */
+		const char *p = strrchr_m(smb_fname->base_name, '/');
+		dptr_set_entry_stat(state->dirptr,
+				    p ? p + 1 : smb_fname->base_name,
+				    &smb_fname->st);
+	}
+
 	if (ms_dfs_link) {
 		mode = dos_mode_msdfs(state->conn, smb_fname);
+	} else if (dptr_prefetched_dosattrib(state->dirptr, &dosattrib)) {
+		mode = dos_mode_prefetched(state->conn, smb_fname, &dosattrib);
 	} else {
 		mode = dos_mode(state->conn, smb_fname);
 	}
@@ -2322,6 +2334,7 @@ NTSTATUS smbd_dirptr_lanman2_entry(TALLOC_CTX *ctx,
 
 	ZERO_STRUCT(state);
 	state.conn = conn;
+	state.dirptr = dirptr;
 	state.info_level = info_level;
 	state.check_mangled_names = lp_mangled_names(conn->params);
 	state.has_wild = dptr_has_wild(dirptr);
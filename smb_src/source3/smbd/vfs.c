@@ -1847,6 +1847,167 @@ int smb_vfs_call_lstat(struct vfs_handle_struct *handle,
 	return handle->fns->lstat_fn(handle, smb_filename);
 }
 
+/*
+ * Walk down to the module implementing either the async or the
+ * sync variant of a call. A module implementing only the sync
+ * variant would be bypassed by the async call, so in that case
+ * the sync call is done right away.
+ */
+#define VFS_FIND_ASYNC(__fn__) \
+	while ((handle->fns->__fn__##_send_fn == NULL) && \
+	       (handle->fns->__fn__##_fn == NULL)) { \
+		handle = handle->next; \
+	}
+
+struct smb_vfs_call_stat_state {
+	int (*recv_fn)(struct tevent_req *req, int *err);
+	int retval;
+};
+
+static struct tevent_req *smb_vfs_call_stat_sync(struct tevent_req *req,
+						 struct tevent_context *ev,
+						 int ret)
+{
+	if (ret == -1) {
+		tevent_req_error(req, errno);
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_done(req);
+	return tevent_req_post(req, ev);
+}
+
+static void smb_vfs_call_stat_done(struct tevent_req *subreq);
+
+struct tevent_req *smb_vfs_call_stat_send(struct vfs_handle_struct *handle,
+					  TALLOC_CTX *mem_ctx,
+					  struct tevent_context *ev,
+					  struct smb_filename *smb_fname)
+{
+	struct tevent_req *req, *subreq;
+	struct smb_vfs_call_stat_state *state;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct smb_vfs_call_stat_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	VFS_FIND_ASYNC(stat);
+	if (handle->fns->stat_send_fn == NULL) {
+		return smb_vfs_call_stat_sync(
+			req, ev, handle->fns->stat_fn(handle, smb_fname));
+	}
+	state->recv_fn = handle->fns->stat_recv_fn;
+
+	subreq = handle->fns->stat_send_fn(handle, state, ev, smb_fname);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, smb_vfs_call_stat_done, req);
+	return req;
+}
+
+struct tevent_req *smb_vfs_call_fstat_send(struct vfs_handle_struct *handle,
+					   TALLOC_CTX *mem_ctx,
+					   struct tevent_context *ev,
+					   struct files_struct *fsp,
+					   SMB_STRUCT_STAT *sbuf)
+{
+	struct tevent_req *req, *subreq;
+	struct smb_vfs_call_stat_state *state;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct smb_vfs_call_stat_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	VFS_FIND_ASYNC(fstat);
+	if (handle->fns->fstat_send_fn == NULL) {
+		return smb_vfs_call_stat_sync(
+			req, ev, handle->fns->fstat_fn(handle, fsp, sbuf));
+	}
+	state->recv_fn = handle->fns->fstat_recv_fn;
+
+	subreq = handle->fns->fstat_send_fn(handle, state, ev, fsp, sbuf);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, smb_vfs_call_stat_done, req);
+	return req;
+}
+
+struct tevent_req *smb_vfs_call_lstat_send(struct vfs_handle_struct *handle,
+					   TALLOC_CTX *mem_ctx,
+					   struct tevent_context *ev,
+					   struct smb_filename *smb_fname)
+{
+	struct tevent_req *req, *subreq;
+	struct smb_vfs_call_stat_state *state;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct smb_vfs_call_stat_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	VFS_FIND_ASYNC(lstat);
+	if (handle->fns->lstat_send_fn == NULL) {
+		return smb_vfs_call_stat_sync(
+			req, ev, handle->fns->lstat_fn(handle, smb_fname));
+	}
+	state->recv_fn = handle->fns->lstat_recv_fn;
+
+	subreq = handle->fns->lstat_send_fn(handle, state, ev, smb_fname);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, smb_vfs_call_stat_done, req);
+	return req;
+}
+
+static void smb_vfs_call_stat_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct smb_vfs_call_stat_state *state = tevent_req_data(
+		req, struct smb_vfs_call_stat_state);
+	int err;
+
+	state->retval = state->recv_fn(subreq, &err);
+	TALLOC_FREE(subreq);
+	if (state->retval == -1) {
+		tevent_req_error(req, err);
+		return;
+	}
+	tevent_req_done(req);
+}
+
+static int smb_vfs_call_stat_recv(struct tevent_req *req, int *perrno)
+{
+	struct smb_vfs_call_stat_state *state = tevent_req_data(
+		req, struct smb_vfs_call_stat_state);
+	int err;
+
+	if (tevent_req_is_unix_error(req, &err)) {
+		*perrno = err;
+		return -1;
+	}
+	return state->retval;
+}
+
+int SMB_VFS_STAT_RECV(struct tevent_req *req, int *perrno)
+{
+	return smb_vfs_call_stat_recv(req, perrno);
+}
+
+int SMB_VFS_FSTAT_RECV(struct tevent_req *req, int *perrno)
+{
+	return smb_vfs_call_stat_recv(req, perrno);
+}
+
+int SMB_VFS_LSTAT_RECV(struct tevent_req *req, int *perrno)
+{
+	return smb_vfs_call_stat_recv(req, perrno);
+}
+
 uint64_t smb_vfs_call_get_alloc_size(struct vfs_handle_struct *handle,
 				     struct files_struct *fsp,
 				     const SMB_STRUCT_STAT *sbuf)
@@ -2355,6 +2516,80 @@ ssize_t smb_vfs_call_getxattr(struct vfs_handle_struct *handle,
 	return handle->fns->getxattr_fn(handle, path, name, value, size);
 }
 
+struct smb_vfs_call_getxattr_state {
+	ssize_t (*recv_fn)(struct tevent_req *req, int *err);
+	ssize_t retval;
+};
+
+static void smb_vfs_call_getxattr_done(struct tevent_req *subreq);
+
+struct tevent_req *smb_vfs_call_getxattr_send(struct vfs_handle_struct *handle,
+					      TALLOC_CTX *mem_ctx,
+					      struct tevent_context *ev,
+					      const char *path,
+					      const char *name,
+					      void *value, size_t size)
+{
+	struct tevent_req *req, *subreq;
+	struct smb_vfs_call_getxattr_state *state;
+
+	req = tevent_req_create(mem_ctx, &state,
+				struct smb_vfs_call_getxattr_state);
+	if (req == NULL) {
+		return NULL;
+	}
+	VFS_FIND_ASYNC(getxattr);
+	if (handle->fns->getxattr_send_fn == NULL) {
+		state->retval = handle->fns->getxattr_fn(handle, path, name,
+							 value, size);
+		if (state->retval == -1) {
+			tevent_req_error(req, errno);
+			return tevent_req_post(req, ev);
+		}
+		tevent_req_done(req);
+		return tevent_req_post(req, ev);
+	}
+	state->recv_fn = handle->fns->getxattr_recv_fn;
+
+	subreq = handle->fns->getxattr_send_fn(handle, state, ev, path, name,
+					       value, size);
+	if (tevent_req_nomem(subreq, req)) {
+		return tevent_req_post(req, ev);
+	}
+	tevent_req_set_callback(subreq, smb_vfs_call_getxattr_done, req);
+	return req;
+}
+
+static void smb_vfs_call_getxattr_done(struct tevent_req *subreq)
+{
+	struct tevent_req *req = tevent_req_callback_data(
+		subreq, struct tevent_req);
+	struct smb_vfs_call_getxattr_state *state = tevent_req_data(
+		req, struct smb_vfs_call_getxattr_state);
+	int err;
+
+	state->retval = state->recv_fn(subreq, &err);
+	TALLOC_FREE(subreq);
+	if (state->retval == -1) {
+		tevent_req_error(req, err);
+		return;
+	}
+	tevent_req_done(req);
+}
+
+ssize_t SMB_VFS_GETXATTR_RECV(struct tevent_req *req, int *perrno)
+{
+	struct smb_vfs_call_getxattr_state *state = tevent_req_data(
+		req, struct smb_vfs_call_getxattr_state);
+	int err;
+
+	if (tevent_req_is_unix_error(req, &err)) {
+		*perrno = err;
+		return -1;
+	}
+	return state->retval;
+}
+
 ssize_t smb_vfs_call_fgetxattr(struct vfs_handle_struct *handle,
 			       struct files_struct *fsp, const char *name,
 			       void *value, size_t size)
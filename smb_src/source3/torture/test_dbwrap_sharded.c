@@ -0,0 +1,120 @@
+/*
+   Unix SMB/CIFS implementation.
+   Test sharded dbwrap databases
+   Copyright (C) The Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "includes.h"
+#include "torture/proto.h"
+#include "system/filesys.h"
+#include "lib/dbwrap/dbwrap.h"
+#include "lib/dbwrap/dbwrap_open.h"
+#include "lib/util/util_tdb.h"
+
+#define NUM_KEYS 1000
+
+static int delete_fn(struct db_record *rec, void *private_data)
+{
+	NTSTATUS status;
+
+	status = dbwrap_record_delete(rec);
+	if (!NT_STATUS_IS_OK(status)) {
+		fprintf(stderr, "dbwrap_record_delete failed: %s\n",
+			nt_errstr(status));
+		return -1;
+	}
+	return 0;
+}
+
+static int count_fn(struct db_record *rec, void *private_data)
+{
+	return 0;
+}
+
+bool run_local_dbwrap_sharded(int dummy)
+{
+	struct db_context *db = NULL;
+	NTSTATUS status;
+	int i, count;
+	bool ret = false;
+
+	db = db_open_shards(talloc_tos(), "test_sharded.tdb", 4, 0,
+			    TDB_CLEAR_IF_FIRST|TDB_INCOMPATIBLE_HASH,
+			    O_CREAT|O_RDWR, 0644, DBWRAP_LOCK_ORDER_1,
+			    DBWRAP_FLAG_NONE);
+	if (db == NULL) {
+		fprintf(stderr, "db_open_shards failed: %s\n",
+			strerror(errno));
+		goto fail;
+	}
+
+	for (i=0; i<NUM_KEYS; i++) {
+		char keystr[32];
+
+		snprintf(keystr, sizeof(keystr), "key%d", i);
+		status = dbwrap_store_int32_bystring(db, keystr, i);
+		if (!NT_STATUS_IS_OK(status)) {
+			fprintf(stderr, "dbwrap_store_int32 failed: %s\n",
+				nt_errstr(status));
+			goto fail;
+		}
+	}
+
+	for (i=0; i<NUM_KEYS; i++) {
+		char keystr[32];
+		int32_t val;
+
+		snprintf(keystr, sizeof(keystr), "key%d", i);
+		status = dbwrap_fetch_int32_bystring(db, keystr, &val);
+		if (!NT_STATUS_IS_OK(status)) {
+			fprintf(stderr, "dbwrap_fetch_int32 failed: %s\n",
+				nt_errstr(status));
+			goto fail;
+		}
+		if (val != i) {
+			fprintf(stderr, "got %d for %s\n", (int)val, keystr);
+			goto fail;
+		}
+	}
+
+	status = dbwrap_traverse(db, delete_fn, NULL, &count);
+	if (!NT_STATUS_IS_OK(status)) {
+		fprintf(stderr, "dbwrap_traverse failed: %s\n",
+			nt_errstr(status));
+		goto fail;
+	}
+	if (count != NUM_KEYS) {
+		fprintf(stderr, "traversed %d records, expected %d\n",
+			count, NUM_KEYS);
+		goto fail;
+	}
+
+	status = dbwrap_traverse_read(db, count_fn, NULL, &count);
+	if (!NT_STATUS_IS_OK(status)) {
+		fprintf(stderr, "dbwrap_traverse_read failed: %s\n",
+			nt_errstr(status));
+		goto fail;
+	}
+	if (count != 0) {
+		fprintf(stderr, "%d records left after delete\n", count);
+		goto fail;
+	}
+
+	ret = true;
+fail:
+	TALLOC_FREE(db);
+	return ret;
+}
@@ -0,0 +1,209 @@
+/*
+   Unix SMB/CIFS implementation.
+   Test the write-behind dbwrap layer
+   Copyright (C) The Samba Team 2015
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "includes.h"
+#include "torture/proto.h"
+#include "system/filesys.h"
+#include "lib/dbwrap/dbwrap.h"
+#include "lib/dbwrap/dbwrap_open.h"
+#include "lib/dbwrap/dbwrap_writebehind.h"
+#include "lib/util/util_tdb.h"
+
+#define NUM_KEYS 50
+#define MAX_PENDING 100
+
+static bool check_values(struct db_context *db, int start, int end,
+			 int offset)
+{
+	int i;
+
+	for (i=start; i<end; i++) {
+		char keystr[32];
+		int32_t val;
+		NTSTATUS status;
+
+		snprintf(keystr, sizeof(keystr), "key%d", i);
+		status = dbwrap_fetch_int32_bystring(db, keystr, &val);
+		if (!NT_STATUS_IS_OK(status)) {
+			fprintf(stderr, "dbwrap_fetch_int32 %s failed: %s\n",
+				keystr, nt_errstr(status));
+			return false;
+		}
+		if (val != i + offset) {
+			fprintf(stderr, "got %d for %s\n", (int)val, keystr);
+			return false;
+		}
+	}
+	return true;
+}
+
+static int count_fn(struct db_record *rec, void *private_data)
+{
+	return 0;
+}
+
+bool run_local_dbwrap_writebehind(int dummy)
+{
+	struct tevent_context *ev = NULL;
+	struct db_context *backing = NULL;
+	struct db_context *db = NULL;
+	struct dbwrap_writebehind_stats stats;
+	NTSTATUS status;
+	int i, count;
+	bool ret = false;
+
+	ev = samba_tevent_context_init(talloc_tos());
+	if (ev == NULL) {
+		fprintf(stderr, "samba_tevent_context_init failed\n");
+		goto fail;
+	}
+
+	/* No TDB_CLEAR_IF_FIRST: persistent, committed in transactions */
+	backing = db_open(talloc_tos(), "test_writebehind.tdb", 0,
+			  TDB_DEFAULT, O_CREAT|O_RDWR, 0644,
+			  DBWRAP_LOCK_ORDER_1, DBWRAP_FLAG_NONE);
+	if (backing == NULL) {
+		fprintf(stderr, "db_open failed: %s\n", strerror(errno));
+		goto fail;
+	}
+	dbwrap_wipe(backing);
+
+	db = db_open_writebehind(talloc_tos(), ev, &backing, 60000,
+				 MAX_PENDING);
+	if (db == NULL) {
+		fprintf(stderr, "db_open_writebehind failed\n");
+		goto fail;
+	}
+
+	for (i=0; i<NUM_KEYS; i++) {
+		char keystr[32];
+
+		snprintf(keystr, sizeof(keystr), "key%d", i);
+		status = dbwrap_store_int32_bystring(db, keystr, i);
+		if (!NT_STATUS_IS_OK(status)) {
+			fprintf(stderr, "dbwrap_store_int32 failed: %s\n",
+				nt_errstr(status));
+			goto fail;
+		}
+	}
+
+	/* Each of these is a transaction of its own */
+	for (i=0; i<10; i++) {
+		char keystr[32];
+
+		snprintf(keystr, sizeof(keystr), "key%d", i);
+		status = dbwrap_trans_store_int32_bystring(db, keystr, i + 1);
+		if (!NT_STATUS_IS_OK(status)) {
+			fprintf(stderr, "dbwrap_trans_store_int32 failed: "
+				"%s\n", nt_errstr(status));
+			goto fail;
+		}
+	}
+
+	if (!check_values(db, 0, 10, 1) ||
+	    !check_values(db, 10, NUM_KEYS, 0)) {
+		goto fail;
+	}
+
+	status = dbwrap_delete_bystring(db, "key49");
+	if (!NT_STATUS_IS_OK(status)) {
+		fprintf(stderr, "dbwrap_delete failed: %s\n",
+			nt_errstr(status));
+		goto fail;
+	}
+	if (dbwrap_exists(db, string_term_tdb_data("key49"))) {
+		fprintf(stderr, "key49 still exists\n");
+		goto fail;
+	}
+
+	dbwrap_writebehind_stats(db, &stats);
+	if ((stats.commits != 0) || (stats.transactions != 10) ||
+	    (stats.queued != NUM_KEYS + 10 + 1)) {
+		fprintf(stderr, "unexpected stats before flush: commits=%d "
+			"transactions=%d queued=%d\n", (int)stats.commits,
+			(int)stats.transactions, (int)stats.queued);
+		goto fail;
+	}
+
+	status = dbwrap_flush(db);
+	if (!NT_STATUS_IS_OK(status)) {
+		fprintf(stderr, "dbwrap_flush failed: %s\n",
+			nt_errstr(status));
+		goto fail;
+	}
+
+	/*
+	 * 50 stores, 10 transactions and a delete went out with a
+	 * single transaction commit.
+	 */
+	dbwrap_writebehind_stats(db, &stats);
+	if ((stats.commits != 1) || (stats.records != NUM_KEYS) ||
+	    (stats.fsyncs_saved != NUM_KEYS + 10)) {
+		fprintf(stderr, "unexpected stats after flush: commits=%d "
+			"records=%d fsyncs_saved=%d\n", (int)stats.commits,
+			(int)stats.records, (int)stats.fsyncs_saved);
+		goto fail;
+	}
+
+	if (!check_values(db, 0, 10, 1) ||
+	    !check_values(db, 10, NUM_KEYS - 1, 0)) {
+		goto fail;
+	}
+
+	/* Filling the buffer commits without waiting for the timer */
+	for (i=0; i<MAX_PENDING; i++) {
+		char keystr[32];
+
+		snprintf(keystr, sizeof(keystr), "key%d", i);
+		status = dbwrap_store_int32_bystring(db, keystr, i + 2);
+		if (!NT_STATUS_IS_OK(status)) {
+			fprintf(stderr, "dbwrap_store_int32 failed: %s\n",
+				nt_errstr(status));
+			goto fail;
+		}
+	}
+	dbwrap_writebehind_stats(db, &stats);
+	if (stats.commits != 2) {
+		fprintf(stderr, "expected 2 commits, got %d\n",
+			(int)stats.commits);
+		goto fail;
+	}
+
+	status = dbwrap_traverse_read(db, count_fn, NULL, &count);
+	if (!NT_STATUS_IS_OK(status)) {
+		fprintf(stderr, "dbwrap_traverse_read failed: %s\n",
+			nt_errstr(status));
+		goto fail;
+	}
+	if (count != MAX_PENDING) {
+		fprintf(stderr, "traversed %d records, expected %d\n",
+			count, MAX_PENDING);
+		goto fail;
+	}
+	if (!check_values(db, 0, MAX_PENDING, 2)) {
+		goto fail;
+	}
+
+	ret = true;
+fail:
+	TALLOC_FREE(db);
+	TALLOC_FREE(backing);
+	TALLOC_FREE(ev);
+	return ret;
+}
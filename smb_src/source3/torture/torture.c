@@ -6549,6 +6549,69 @@ static bool run_sesssetup_bench(int dummy)
 	return true;
 }
 
+/*
+ * All processes open, query and close the same file, stressing the
+ * share mode record of it in locking.tdb. Run with -N to set the
+ * number of processes, -o for the number of opens of each.
+ */
+static bool run_open_bench(int dummy)
+{
+	struct cli_state *cli = current_cli;
+	const char *fname = "\\openbench.dat";
+	struct timeval start;
+	double secs;
+	uint16_t fnum;
+	NTSTATUS status;
+	bool correct = true;
+	int i;
+
+	smbXcli_conn_set_sockopt(cli->conn, sockops);
+
+	start = timeval_current();
+
+	for (i=0; i<torture_numops; i++) {
+		struct timespec write_time;
+
+		status = cli_ntcreate(cli, fname, 0,
+				      FILE_READ_DATA|FILE_READ_ATTRIBUTES,
+				      FILE_ATTRIBUTE_NORMAL,
+				      FILE_SHARE_READ|FILE_SHARE_WRITE|
+				      FILE_SHARE_DELETE,
+				      FILE_OPEN_IF, 0, 0, &fnum, NULL);
+		if (!NT_STATUS_IS_OK(status)) {
+			printf("open of %s failed (%s)\n", fname,
+			       nt_errstr(status));
+			correct = false;
+			break;
+		}
+
+		status = cli_qfileinfo_basic(cli, fnum, NULL, NULL, NULL,
+					     NULL, &write_time, NULL, NULL);
+		if (!NT_STATUS_IS_OK(status)) {
+			printf("qfileinfo of %s failed (%s)\n", fname,
+			       nt_errstr(status));
+			correct = false;
+		}
+
+		status = cli_close(cli, fnum);
+		if (!NT_STATUS_IS_OK(status)) {
+			printf("close of %s failed (%s)\n", fname,
+			       nt_errstr(status));
+			correct = false;
+			break;
+		}
+	}
+
+	secs = timeval_elapsed(&start);
+	printf("client %d: %d opens in %g secs, %g opens/sec\n",
+	       procnum, i, secs, secs > 0 ? i / secs : 0.0);
+
+	if (!torture_close_connection(cli)) {
+		correct = false;
+	}
+	return correct;
+}
+
 static bool subst_test(const char *str, const char *user, const char *domain,
 		       uid_t uid, gid_t gid, const char *expected)
 {
@@ -9570,6 +9633,7 @@ static struct {
 	{"FDSESS", run_fdsesstest, 0},
 	{ "EATEST", run_eatest, 0},
 	{ "SESSSETUP_BENCH", run_sesssetup_bench, 0},
+	{ "OPEN-BENCH", run_open_bench, FLAG_MULTIPROC},
 	{ "CHAIN1", run_chain1, 0},
 	{ "CHAIN2", run_chain2, 0},
 	{ "CHAIN3", run_chain3, 0},
@@ -9628,6 +9692,8 @@ static struct {
 	{ "local-tdb-opener", run_local_tdb_opener, 0 },
 	{ "local-tdb-writer", run_local_tdb_writer, 0 },
 	{ "LOCAL-DBWRAP-CTDB", run_local_dbwrap_ctdb, 0 },
+	{ "LOCAL-DBWRAP-SHARDED", run_local_dbwrap_sharded, 0 },
+	{ "LOCAL-DBWRAP-WRITEBEHIND", run_local_dbwrap_writebehind, 0 },
 	{ "LOCAL-BENCH-PTHREADPOOL", run_bench_pthreadpool, 0 },
 	{ "qpathinfo-bufsize", run_qpathinfo_bufsize, 0 },
 	{NULL, NULL, 0}};
@@ -121,6 +121,21 @@ bool status_profile_dump(bool verbose)
 	d_printf("symlink_count:                  %u\n", profile_p->syscall_symlink_count);
 	d_printf("symlink_time:                   %u\n", profile_p->syscall_symlink_time);
 
+	profile_separator("SMB2 Read Buffers");
+	d_printf("buffer_hits:                    %u\n", profile_p->smb2_read_buffer_hits);
+	d_printf("buffer_misses:                  %u\n", profile_p->smb2_read_buffer_misses);
+	d_printf("read_copied_bytes:              %u\n", profile_p->smb2_read_copied_bytes);
+	d_printf("dyn_copied_bytes:               %u\n", profile_p->smb2_dyn_copied_bytes);
+
+	profile_separator("SMB2 Send Queue");
+	d_printf("writev_calls:                   %u\n", profile_p->smb2_send_writev_calls);
+	d_printf("responses:                      %u\n", profile_p->smb2_send_responses);
+
+	profile_separator("Directory Cache");
+	d_printf("hits:                           %u\n", profile_p->dircache_hits);
+	d_printf("misses:                         %u\n", profile_p->dircache_misses);
+	d_printf("invalidations:                  %u\n", profile_p->dircache_invalidations);
+
 	profile_separator("Stat Cache");
 	d_printf("lookups:                        %u\n", profile_p->statcache_lookups);
 	d_printf("misses:                         %u\n", profile_p->statcache_misses);
@@ -445,6 +445,49 @@ NTSTATUS idmap_tdb_common_unixid_to_sid(struct idmap_domain * dom,
 	return ret;
 }
 
+/**********************************
+ Decode a sid to id mapping record.
+**********************************/
+
+static NTSTATUS idmap_tdb_common_sid_record_to_unixid(struct idmap_domain *dom,
+						      const char *keystr,
+						      const char *value,
+						      struct id_map *map)
+{
+	unsigned long rec_id = 0;
+
+	/* What type of record is this ? */
+	if (sscanf(value, "UID %lu", &rec_id) == 1) {
+		/* Try a UID record. */
+		map->xid.id = rec_id;
+		map->xid.type = ID_TYPE_UID;
+		DEBUG(10,
+		      ("Found uid record %s -> %s \n", keystr, value));
+
+	} else if (sscanf(value, "GID %lu", &rec_id) == 1) {
+		/* Try a GID record. */
+		map->xid.id = rec_id;
+		map->xid.type = ID_TYPE_GID;
+		DEBUG(10,
+		      ("Found gid record %s -> %s \n", keystr, value));
+
+	} else {		/* Unknown record type ! */
+		DEBUG(2,
+		      ("Found INVALID record %s -> %s\n", keystr, value));
+		return NT_STATUS_INTERNAL_DB_ERROR;
+	}
+
+	/* apply filters before returning result */
+	if (!idmap_unix_id_is_in_range(map->xid.id, dom)) {
+		DEBUG(5,
+		      ("Requested id (%u) out of range (%u - %u). Filtered!\n",
+		       map->xid.id, dom->low_id, dom->high_id));
+		return NT_STATUS_NONE_MAPPED;
+	}
+
+	return NT_STATUS_OK;
+}
+
 /**********************************
  Single sid to id lookup function.
 **********************************/
@@ -455,7 +498,6 @@ NTSTATUS idmap_tdb_common_sid_to_unixid(struct idmap_domain * dom,
 	NTSTATUS ret;
 	TDB_DATA data;
 	char *keystr;
-	unsigned long rec_id = 0;
 	struct idmap_tdb_common_context *ctx;
 	TALLOC_CTX *tmp_ctx = talloc_stackframe();
 
@@ -485,40 +527,8 @@ NTSTATUS idmap_tdb_common_sid_to_unixid(struct idmap_domain * dom,
 		goto done;
 	}
 
-	/* What type of record is this ? */
-	if (sscanf((const char *)data.dptr, "UID %lu", &rec_id) == 1) {
-		/* Try a UID record. */
-		map->xid.id = rec_id;
-		map->xid.type = ID_TYPE_UID;
-		DEBUG(10,
-		      ("Found uid record %s -> %s \n", keystr,
-		       (const char *)data.dptr));
-		ret = NT_STATUS_OK;
-
-	} else if (sscanf((const char *)data.dptr, "GID %lu", &rec_id) == 1) {
-		/* Try a GID record. */
-		map->xid.id = rec_id;
-		map->xid.type = ID_TYPE_GID;
-		DEBUG(10,
-		      ("Found gid record %s -> %s \n", keystr,
-		       (const char *)data.dptr));
-		ret = NT_STATUS_OK;
-
-	} else {		/* Unknown record type ! */
-		DEBUG(2,
-		      ("Found INVALID record %s -> %s\n", keystr,
-		       (const char *)data.dptr));
-		ret = NT_STATUS_INTERNAL_DB_ERROR;
-		goto done;
-	}
-
-	/* apply filters before returning result */
-	if (!idmap_unix_id_is_in_range(map->xid.id, dom)) {
-		DEBUG(5,
-		      ("Requested id (%u) out of range (%u - %u). Filtered!\n",
-		       map->xid.id, dom->low_id, dom->high_id));
-		ret = NT_STATUS_NONE_MAPPED;
-	}
+	ret = idmap_tdb_common_sid_record_to_unixid(
+		dom, keystr, (const char *)data.dptr, map);
 
       done:
 	talloc_free(tmp_ctx);
@@ -537,12 +547,114 @@ struct idmap_tdb_common_sids_to_unixids_context {
 				      struct id_map * map);
 };
 
+struct idmap_tdb_common_sids_lookup_state {
+	struct idmap_domain *dom;
+	struct id_map **ids;
+	char **keystrs;
+	int *idxs;
+	NTSTATUS *results;
+};
+
+static void idmap_tdb_common_sids_lookup_parser(size_t i, TDB_DATA key,
+						TDB_DATA data,
+						void *private_data)
+{
+	struct idmap_tdb_common_sids_lookup_state *state =
+		(struct idmap_tdb_common_sids_lookup_state *)private_data;
+	int idx = state->idxs[i];
+
+	if ((data.dsize == 0) || (data.dptr[data.dsize-1] != '\0')) {
+		DEBUG(2, ("Found INVALID record %s\n", state->keystrs[i]));
+		state->results[idx] = NT_STATUS_INTERNAL_DB_ERROR;
+		return;
+	}
+
+	state->results[idx] = idmap_tdb_common_sid_record_to_unixid(
+		state->dom, state->keystrs[i], (const char *)data.dptr,
+		state->ids[idx]);
+}
+
+/*
+ * Look up the sid records of all ids still to be mapped with one
+ * dbwrap_parse_records call. Fills in what
+ * idmap_tdb_common_sid_to_unixid would have returned for each of them.
+ */
+static NTSTATUS idmap_tdb_common_sids_lookup(struct db_context *db,
+					     struct idmap_domain *dom,
+					     struct id_map **ids,
+					     TALLOC_CTX *mem_ctx,
+					     NTSTATUS **presults)
+{
+	struct idmap_tdb_common_sids_lookup_state state;
+	TDB_DATA *keys;
+	int i, num_ids, num_keys;
+	NTSTATUS status;
+
+	for (num_ids = 0; ids[num_ids]; num_ids++) {
+		;
+	}
+
+	state.dom = dom;
+	state.ids = ids;
+	state.results = talloc_array(mem_ctx, NTSTATUS, num_ids);
+	if (state.results == NULL) {
+		return NT_STATUS_NO_MEMORY;
+	}
+	state.keystrs = talloc_array(state.results, char *, num_ids);
+	state.idxs = talloc_array(state.results, int, num_ids);
+	keys = talloc_array(state.results, TDB_DATA, num_ids);
+	if ((state.keystrs == NULL) || (state.idxs == NULL) ||
+	    (keys == NULL)) {
+		TALLOC_FREE(state.results);
+		return NT_STATUS_NO_MEMORY;
+	}
+
+	num_keys = 0;
+
+	for (i = 0; i < num_ids; i++) {
+		char *keystr;
+
+		state.results[i] = NT_STATUS_NONE_MAPPED;
+
+		if ((ids[i]->status != ID_UNKNOWN) &&
+		    (ids[i]->status != ID_UNMAPPED)) {
+			continue;
+		}
+
+		keystr = sid_string_talloc(state.keystrs, ids[i]->sid);
+		if (keystr == NULL) {
+			TALLOC_FREE(state.results);
+			return NT_STATUS_NO_MEMORY;
+		}
+		state.keystrs[num_keys] = keystr;
+		state.idxs[num_keys] = i;
+		keys[num_keys] = string_term_tdb_data(keystr);
+		num_keys += 1;
+	}
+
+	status = dbwrap_parse_records(db, keys, num_keys,
+				      idmap_tdb_common_sids_lookup_parser,
+				      &state);
+	if (!NT_STATUS_IS_OK(status)) {
+		TALLOC_FREE(state.results);
+		return status;
+	}
+
+	TALLOC_FREE(keys);
+	TALLOC_FREE(state.keystrs);
+	TALLOC_FREE(state.idxs);
+
+	*presults = state.results;
+	return NT_STATUS_OK;
+}
+
 static NTSTATUS idmap_tdb_common_sids_to_unixids_action(struct db_context *db,
 							void *private_data)
 {
 	struct idmap_tdb_common_sids_to_unixids_context *state;
 	int i, num_mapped = 0;
 	NTSTATUS ret = NT_STATUS_OK;
+	NTSTATUS *results = NULL;
 
 	state = (struct idmap_tdb_common_sids_to_unixids_context *)private_data;
 
@@ -550,14 +662,31 @@ static NTSTATUS idmap_tdb_common_sids_to_unixids_action(struct db_context *db,
 		   " domain: [%s], allocate: %s\n",
 		   state->dom->name, state->allocate_unmapped ? "yes" : "no"));
 
+	if (state->sid_to_unixid_fn == idmap_tdb_common_sid_to_unixid) {
+		NTSTATUS status;
+
+		status = idmap_tdb_common_sids_lookup(
+			db, state->dom, state->ids, talloc_tos(), &results);
+		if (!NT_STATUS_IS_OK(status)) {
+			DEBUG(10, ("idmap_tdb_common_sids_lookup failed: %s, "
+				   "looking up one by one\n",
+				   nt_errstr(status)));
+			results = NULL;
+		}
+	}
+
 	for (i = 0; state->ids[i]; i++) {
 		if ((state->ids[i]->status == ID_UNKNOWN) ||
 		    /* retry if we could not map in previous run: */
 		    (state->ids[i]->status == ID_UNMAPPED)) {
 			NTSTATUS ret2;
 
-			ret2 = state->sid_to_unixid_fn(state->dom,
-					state->ids[i]);
+			if (results != NULL) {
+				ret2 = results[i];
+			} else {
+				ret2 = state->sid_to_unixid_fn(state->dom,
+							       state->ids[i]);
+			}
 
 			if (!NT_STATUS_IS_OK(ret2)) {
 
@@ -599,6 +728,7 @@ static NTSTATUS idmap_tdb_common_sids_to_unixids_action(struct db_context *db,
 	}
 
 done:
+	TALLOC_FREE(results);
 
 	if (NT_STATUS_IS_OK(ret) ||
 	    NT_STATUS_EQUAL(ret, STATUS_SOME_UNMAPPED)) {
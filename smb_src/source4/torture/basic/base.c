@@ -1972,6 +1972,8 @@ NTSTATUS torture_base_init(void)
 	torture_suite_add_1smb_test(suite, "bench-holdopen", torture_holdopen);
 	torture_suite_add_simple_test(suite, "bench-readwrite", run_benchrw);
 	torture_suite_add_smb_multi_test(suite, "bench-torture", run_torture);
+	torture_suite_add_2smb_test(suite, "bench-manylocks",
+				    torture_locktest_manylocks);
 	torture_suite_add_1smb_test(suite, "scan-pipe_number", run_pipe_number);
 	torture_suite_add_1smb_test(suite, "scan-ioctl", torture_ioctl_test);
 	torture_suite_add_1smb_test(suite, "scan-maxfid", torture_maxfid_test);
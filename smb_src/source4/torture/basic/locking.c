@@ -796,6 +796,100 @@ fail:
 	return correct;
 }
 
+/*
+  lock-heavy benchmark: one client holds many byte range locks on a
+  file while a second client does I/O and lock attempts between and on
+  top of them. Every such request has to be checked against all the
+  locks held.
+*/
+bool torture_locktest_manylocks(struct torture_context *tctx,
+				struct smbcli_state *cli1,
+				struct smbcli_state *cli2)
+{
+	const char *fname = BASEDIR "\\manylocks.lck";
+	int numlocks = torture_setting_int(tctx, "numlocks", 1000);
+	int numops = torture_setting_int(tctx, "numops", 1000);
+	int fnum1, fnum2;
+	struct timeval tv;
+	uint8_t buf[1];
+	int i;
+
+	torture_assert(tctx, torture_setup_dir(cli1, BASEDIR),
+		       talloc_asprintf(tctx, "Unable to set up %s", BASEDIR));
+
+	fnum1 = smbcli_open(cli1->tree, fname, O_RDWR|O_CREAT|O_EXCL, DENY_NONE);
+	torture_assert(tctx, fnum1 != -1, talloc_asprintf(tctx,
+		"open of %s failed (%s)", fname, smbcli_errstr(cli1->tree)));
+	fnum2 = smbcli_open(cli2->tree, fname, O_RDWR, DENY_NONE);
+	torture_assert(tctx, fnum2 != -1, talloc_asprintf(tctx,
+		"open2 of %s failed (%s)", fname, smbcli_errstr(cli2->tree)));
+
+	torture_comment(tctx, "Taking %d locks\n", numlocks);
+
+	tv = timeval_current();
+	for (i=0; i<numlocks; i++) {
+		torture_assert_ntstatus_ok(tctx,
+			smbcli_lock(cli1->tree, fnum1, i*2, 1, 0, WRITE_LOCK),
+			talloc_asprintf(tctx, "lock %d failed (%s)", i,
+					smbcli_errstr(cli1->tree)));
+	}
+	torture_comment(tctx, "%.0f locks/sec\n",
+			numlocks / timeval_elapsed(&tv));
+
+	tv = timeval_current();
+	for (i=0; i<numops; i++) {
+		int n = random() % numlocks;
+
+		torture_assert(tctx,
+			smbcli_write(cli2->tree, fnum2, 0, buf, n*2+1, 1) == 1,
+			talloc_asprintf(tctx, "write at %d failed (%s)", n*2+1,
+					smbcli_errstr(cli2->tree)));
+	}
+	torture_comment(tctx, "%.0f unlocked writes/sec\n",
+			numops / timeval_elapsed(&tv));
+
+	tv = timeval_current();
+	for (i=0; i<numops; i++) {
+		int n = random() % numlocks;
+
+		torture_assert(tctx,
+			smbcli_read(cli2->tree, fnum2, buf, n*2, 1) == -1,
+			talloc_asprintf(tctx, "read at %d succeeded! This is "
+					"a locking bug", n*2));
+	}
+	torture_comment(tctx, "%.0f conflicting reads/sec\n",
+			numops / timeval_elapsed(&tv));
+
+	tv = timeval_current();
+	for (i=0; i<numops; i++) {
+		int n = random() % numlocks;
+
+		torture_assert(tctx,
+			!NT_STATUS_IS_OK(smbcli_lock(cli2->tree, fnum2, n*2, 1,
+						     0, READ_LOCK)),
+			talloc_asprintf(tctx, "lock at %d succeeded! This is "
+					"a locking bug", n*2));
+	}
+	torture_comment(tctx, "%.0f conflicting locks/sec\n",
+			numops / timeval_elapsed(&tv));
+
+	tv = timeval_current();
+	for (i=0; i<numlocks; i++) {
+		torture_assert_ntstatus_ok(tctx,
+			smbcli_unlock(cli1->tree, fnum1, i*2, 1),
+			talloc_asprintf(tctx, "unlock %d failed (%s)", i,
+					smbcli_errstr(cli1->tree)));
+	}
+	torture_comment(tctx, "%.0f unlocks/sec\n",
+			numlocks / timeval_elapsed(&tv));
+
+	smbcli_close(cli1->tree, fnum1);
+	smbcli_close(cli2->tree, fnum2);
+	smbcli_unlink(cli1->tree, fname);
+
+	return true;
+}
+
 struct torture_suite *torture_base_locktest(TALLOC_CTX *mem_ctx)
 {
 	struct torture_suite *suite = torture_suite_create(mem_ctx, "lock");
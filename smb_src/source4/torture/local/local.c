@@ -69,6 +69,7 @@
 	torture_dsdb_syntax,
 	torture_registry,
 	torture_local_verif_trailer,
+	torture_local_smb2_signing,
 	NULL
 };
 
@@ -87,8 +88,16 @@ NTSTATUS torture_local_init(void)
 				      torture_local_crypto_md5);
 	torture_suite_add_simple_test(suite, "crypto.hmacmd5", 
 				      torture_local_crypto_hmacmd5);
+	torture_suite_add_simple_test(suite, "crypto.hmacsha256",
+				      torture_local_crypto_hmacsha256);
 	torture_suite_add_simple_test(suite, "crypto.aes_cmac_128",
 				      torture_local_crypto_aes_cmac_128);
+	torture_suite_add_simple_test(suite, "crypto.aes_ccm_128",
+				      torture_local_crypto_aes_ccm_128);
+	torture_suite_add_simple_test(suite, "crypto.aes_gcm_128",
+				      torture_local_crypto_aes_gcm_128);
+	torture_suite_add_simple_test(suite, "crypto.aes_128_bench",
+				      torture_local_crypto_aes_128_bench);
 
 	for (i = 0; suite_generators[i]; i++)
 		torture_suite_add_suite(suite,
@@ -865,6 +865,102 @@ done:
     return ret;
 }
 
+#define PIPELINED_NUM_CREATES 15
+#define PIPELINED_BATCH_USECS 500
+
+/*
+ * Send an echo followed by a number of creates without waiting for
+ * the responses. smbd processes requests that are already waiting in
+ * the socket buffer as a batch and sends their responses together, but
+ * the echo response must not be held back until all of the creates
+ * are done.
+ */
+static bool test_compound_pipelined_latency(struct torture_context *tctx,
+					    struct smb2_tree *tree)
+{
+	struct smb2_transport *transport = tree->session->transport;
+	const char *dname = "pipelined_latency_dir";
+	struct smb2_request *echo_req;
+	struct smb2_request *req[PIPELINED_NUM_CREATES];
+	struct smb2_create cr[PIPELINED_NUM_CREATES];
+	bool opened[PIPELINED_NUM_CREATES];
+	struct smb2_handle h;
+	struct timeval start;
+	double first_usecs, all_usecs;
+	NTSTATUS status;
+	bool ret = true;
+	int i;
+
+	ZERO_STRUCT(opened);
+
+	smb2_deltree(tree, dname);
+	status = torture_smb2_testdir(tree, dname, &h);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	smb2_util_close(tree, h);
+
+	/* we need enough credits to have all requests in flight */
+	smb2_transport_credits_ask_num(transport, PIPELINED_NUM_CREATES + 2);
+	status = smb2_keepalive(transport);
+	CHECK_STATUS(status, NT_STATUS_OK);
+	status = smb2_keepalive(transport);
+	CHECK_STATUS(status, NT_STATUS_OK);
+
+	start = timeval_current();
+
+	echo_req = smb2_keepalive_send(transport);
+	torture_assert_goto(tctx, echo_req != NULL, ret, done,
+			    "smb2_keepalive_send failed\n");
+
+	for (i = 0; i < PIPELINED_NUM_CREATES; i++) {
+		ZERO_STRUCT(cr[i]);
+		cr[i].in.desired_access = SEC_RIGHTS_FILE_ALL;
+		cr[i].in.file_attributes = FILE_ATTRIBUTE_NORMAL;
+		cr[i].in.share_access = NTCREATEX_SHARE_ACCESS_READ |
+					NTCREATEX_SHARE_ACCESS_WRITE |
+					NTCREATEX_SHARE_ACCESS_DELETE;
+		cr[i].in.create_disposition = NTCREATEX_DISP_CREATE;
+		cr[i].in.fname = talloc_asprintf(tctx, "%s\\file%d.dat",
+						 dname, i);
+		req[i] = smb2_create_send(tree, &cr[i]);
+		torture_assert_goto(tctx, req[i] != NULL, ret, done,
+				    "smb2_create_send failed\n");
+	}
+
+	status = smb2_keepalive_recv(echo_req);
+	first_usecs = timeval_elapsed(&start) * 1000000;
+	CHECK_STATUS(status, NT_STATUS_OK);
+
+	for (i = 0; i < PIPELINED_NUM_CREATES; i++) {
+		status = smb2_create_recv(req[i], tctx, &cr[i]);
+		CHECK_STATUS(status, NT_STATUS_OK);
+		opened[i] = true;
+	}
+	all_usecs = timeval_elapsed(&start) * 1000000;
+
+	torture_comment(tctx, "echo response after %.0f usecs, "
+			"all responses after %.0f usecs\n",
+			first_usecs, all_usecs);
+
+	if (all_usecs < 4 * PIPELINED_BATCH_USECS) {
+		torture_comment(tctx, "The creates were too fast to "
+				"tell if the echo response was held back\n");
+		goto done;
+	}
+
+	torture_assert_goto(tctx, first_usecs < all_usecs / 2, ret, done,
+			    "echo response held back until all creates "
+			    "were done\n");
+
+done:
+	for (i = 0; i < PIPELINED_NUM_CREATES; i++) {
+		if (opened[i]) {
+			smb2_util_close(tree, cr[i].out.file.handle);
+		}
+	}
+	smb2_deltree(tree, dname);
+	return ret;
+}
+
 struct torture_suite *torture_smb2_compound_init(void)
 {
 	struct torture_suite *suite = torture_suite_create(talloc_autofree_context(), "compound");
@@ -880,6 +976,8 @@ struct torture_suite *torture_smb2_compound_init(void)
 	torture_suite_add_1smb2_test(suite, "interim1",  test_compound_interim1);
 	torture_suite_add_1smb2_test(suite, "interim2",  test_compound_interim2);
 	torture_suite_add_1smb2_test(suite, "compound-break", test_compound_break);
+	torture_suite_add_1smb2_test(suite, "pipelined-latency",
+				     test_compound_pipelined_latency);
 
 	suite->description = talloc_strdup(suite, "SMB2-COMPOUND tests");
 